@@ -0,0 +1,205 @@
+/* LZ4 block format compressor and decompressor, see lz4.h.
+ *
+ * A block is a sequence of:
+ *
+ *   <token> [literal length bytes] <literals> <offset> [match length bytes]
+ *
+ * The high 4 bits of the token are the number of literals and the low 4
+ * bits the length of the match minus 4, the value 15 meaning that more
+ * bytes follow, each one added to the length until a byte is not 255.
+ * The offset is 2 bytes little endian. The last sequence only has the
+ * literals, and the format requires the last 5 bytes to be literals and
+ * the last match to start at least 12 bytes before the end.
+ *
+ * The compressor is the classic greedy LZ4 one: a hash table of the
+ * positions of 4 bytes sequences finds the match candidates, and the
+ * search skips faster and faster in data that doesn't compress.
+ *
+ * Released under the BSD license like Redis itself.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "lz4.h"
+
+#define MINMATCH 4
+#define LASTLITERALS 5
+#define MFLIMIT 12
+#define MAX_DISTANCE 65535
+#define ML_BITS 4
+#define ML_MASK ((1U<<ML_BITS)-1)
+#define RUN_MASK ML_MASK
+#define HASH_LOG 12             /* 16k of hash table on the stack. */
+#define SKIP_TRIGGER 6          /* Skip faster after 2^6 misses. */
+
+static uint32_t lz4Read32(const unsigned char *p) {
+    uint32_t v;
+
+    memcpy(&v,p,sizeof(v));
+    return v;
+}
+
+static unsigned int lz4Hash(uint32_t seq) {
+    return (seq * 2654435761U) >> (32-HASH_LOG);
+}
+
+/* Write a length of the token as a sequence of bytes, see the top comment. */
+static unsigned char *lz4WriteLength(unsigned char *op, size_t len) {
+    while (len >= 255) {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = (unsigned char)len;
+    return op;
+}
+
+int LZ4_compressBound(int inputSize) {
+    return LZ4_COMPRESSBOUND(inputSize);
+}
+
+int LZ4_compress_default(const char *src, char *dst, int srcSize, int dstCapacity) {
+    const unsigned char *base = (const unsigned char*)src;
+    const unsigned char *ip = base, *anchor = base;
+    const unsigned char *iend = base+srcSize;
+    const unsigned char *mflimit = iend-MFLIMIT;
+    const unsigned char *matchlimit = iend-LASTLITERALS;
+    unsigned char *op = (unsigned char*)dst, *oend = op+dstCapacity;
+    uint32_t table[1<<HASH_LOG];
+    unsigned int misses = 0;
+    size_t litlen;
+
+    if (srcSize < 0 || srcSize > LZ4_MAX_INPUT_SIZE || dstCapacity <= 0)
+        return 0;
+    memset(table,0,sizeof(table));
+
+    /* Shorter inputs are just literals. */
+    if (srcSize >= MFLIMIT+1) {
+        while (ip <= mflimit) {
+            uint32_t seq = lz4Read32(ip);
+            unsigned int h = lz4Hash(seq);
+            const unsigned char *ref = base+table[h];
+            const unsigned char *mp, *rp;
+            unsigned char *token;
+            size_t matchlen, offset;
+
+            table[h] = (uint32_t)(ip-base);
+            if (ref >= ip || ip-ref > MAX_DISTANCE || lz4Read32(ref) != seq) {
+                ip += 1 + (misses++ >> SKIP_TRIGGER);
+                continue;
+            }
+            misses = 0;
+
+            /* Extend the match backward, then forward. */
+            while (ip > anchor && ref > base && ip[-1] == ref[-1]) {
+                ip--;
+                ref--;
+            }
+            mp = ip+MINMATCH;
+            rp = ref+MINMATCH;
+            while (mp < matchlimit && *mp == *rp) {
+                mp++;
+                rp++;
+            }
+            litlen = ip-anchor;
+            matchlen = mp-ip-MINMATCH;
+            offset = ip-ref;
+
+            /* Token, literals, offset, match length. */
+            if ((size_t)(oend-op) < 1+litlen/255+1+litlen+2+matchlen/255+1)
+                return 0;
+            token = op++;
+            if (litlen >= RUN_MASK) {
+                *token = RUN_MASK<<ML_BITS;
+                op = lz4WriteLength(op,litlen-RUN_MASK);
+            } else {
+                *token = (unsigned char)(litlen<<ML_BITS);
+            }
+            memcpy(op,anchor,litlen);
+            op += litlen;
+            *op++ = (unsigned char)(offset & 0xff);
+            *op++ = (unsigned char)(offset >> 8);
+            if (matchlen >= ML_MASK) {
+                *token |= ML_MASK;
+                op = lz4WriteLength(op,matchlen-ML_MASK);
+            } else {
+                *token |= (unsigned char)matchlen;
+            }
+            ip = anchor = mp;
+
+            /* Index a position inside the match, it helps the ratio of
+             * repetitive data. */
+            table[lz4Hash(lz4Read32(ip-2))] = (uint32_t)(ip-2-base);
+        }
+    }
+
+    /* Last literals. */
+    litlen = iend-anchor;
+    if ((size_t)(oend-op) < 1+litlen/255+1+litlen) return 0;
+    if (litlen >= RUN_MASK) {
+        *op++ = RUN_MASK<<ML_BITS;
+        op = lz4WriteLength(op,litlen-RUN_MASK);
+    } else {
+        *op++ = (unsigned char)(litlen<<ML_BITS);
+    }
+    memcpy(op,anchor,litlen);
+    op += litlen;
+    return (int)(op-(unsigned char*)dst);
+}
+
+/* Read the rest of a length, see the top comment. Returns 0 on short read
+ * or if the length overflows. */
+static int lz4ReadLength(const unsigned char **ip, const unsigned char *iend, size_t *len) {
+    unsigned int s;
+
+    do {
+        if (*ip >= iend) return 0;
+        s = *(*ip)++;
+        *len += s;
+        if (*len > LZ4_MAX_INPUT_SIZE) return 0;
+    } while (s == 255);
+    return 1;
+}
+
+int LZ4_decompress_safe(const char *src, char *dst, int compressedSize, int dstCapacity) {
+    const unsigned char *ip = (const unsigned char*)src;
+    const unsigned char *iend = ip+compressedSize;
+    unsigned char *op = (unsigned char*)dst, *oend = op+dstCapacity;
+
+    if (compressedSize <= 0 || dstCapacity < 0) return -1;
+    while (1) {
+        unsigned int token;
+        size_t len, offset;
+        const unsigned char *match;
+
+        /* Literals. */
+        if (ip >= iend) return -1;
+        token = *ip++;
+        len = token >> ML_BITS;
+        if (len == RUN_MASK && !lz4ReadLength(&ip,iend,&len)) return -1;
+        if ((size_t)(iend-ip) < len || (size_t)(oend-op) < len) return -1;
+        memcpy(op,ip,len);
+        op += len;
+        ip += len;
+        if (ip == iend) break; /* The last sequence has no match. */
+
+        /* Match. */
+        if (iend-ip < 2) return -1;
+        offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op-(unsigned char*)dst))
+            return -1;
+        len = token & ML_MASK;
+        if (len == ML_MASK && !lz4ReadLength(&ip,iend,&len)) return -1;
+        len += MINMATCH;
+        if ((size_t)(oend-op) < len) return -1;
+        match = op-offset;
+        if (offset >= len) {
+            memcpy(op,match,len);
+            op += len;
+        } else {
+            /* Overlapping copy, repeating the last 'offset' bytes. */
+            while (len--) *op++ = *match++;
+        }
+    }
+    return (int)(op-(unsigned char*)dst);
+}
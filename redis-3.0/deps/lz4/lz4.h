@@ -0,0 +1,33 @@
+/* LZ4 block format compressor and decompressor.
+ *
+ * This is a small implementation of the LZ4 block format, exporting the
+ * same names and semantics of the equivalent functions of the reference
+ * library (lz4.h), so that the output can be decompressed by any LZ4
+ * implementation and the reference sources can be dropped in place of
+ * this one if the other parts of its API are ever needed.
+ *
+ * Released under the BSD license like Redis itself.
+ */
+
+#ifndef __LZ4_H
+#define __LZ4_H
+
+#define LZ4_MAX_INPUT_SIZE 0x7E000000   /* 2 113 929 216 bytes */
+#define LZ4_COMPRESSBOUND(isize) ((unsigned)(isize) > (unsigned)LZ4_MAX_INPUT_SIZE ? 0 : (isize) + ((isize)/255) + 16)
+
+/* Return the max size of the compressed output of 'inputSize' bytes, or 0
+ * if the input is too big. */
+int LZ4_compressBound(int inputSize);
+
+/* Compress 'srcSize' bytes of 'src' into 'dst', that has room for
+ * 'dstCapacity' bytes. Returns the number of bytes written, or 0 if the
+ * compressed output doesn't fit into 'dst'. */
+int LZ4_compress_default(const char *src, char *dst, int srcSize, int dstCapacity);
+
+/* Decompress the 'compressedSize' bytes of 'src' into 'dst', that has
+ * room for 'dstCapacity' bytes. Returns the number of bytes written into
+ * 'dst', or a negative number if the input is malformed or the output
+ * doesn't fit: this function never reads or writes outside the buffers. */
+int LZ4_decompress_safe(const char *src, char *dst, int compressedSize, int dstCapacity);
+
+#endif
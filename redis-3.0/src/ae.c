@@ -30,6 +30,8 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include "fmacros.h"
+
 #include <stdio.h>
 #include <sys/time.h>
 #include <sys/types.h>
@@ -44,11 +46,19 @@
 #include "zmalloc.h"
 #include "config.h"
 
+/* If zero the io_uring backend falls back to epoll, see aeUseIoUring().
+ *
+ * Ϊ 0 ʱʹ io_uring ʹ epoll */
+static int aeIoUringEnabled = 1;
+
 /* Include the best multiplexing layer supported by this system.
  * The following should be ordered by performances, descending. */
 #ifdef HAVE_EVPORT
 #include "ae_evport.c"
 #else
+    #ifdef HAVE_IO_URING
+    #include "ae_iouring.c"
+    #else
     #ifdef HAVE_EPOLL
     #include "ae_epoll.c"
     #else
@@ -58,6 +68,7 @@
         #include "ae_select.c"
         #endif
     #endif
+    #endif
 #endif
 
 /*
@@ -80,7 +91,13 @@ aeEventLoop *aeCreateEventLoop(int setsize) {
     eventLoop->lastTime = time(NULL);
 
     // ʼʱ¼ṹ
-    eventLoop->timeEventHead = NULL;
+    eventLoop->timeEventHeap = NULL;
+    eventLoop->timeEventStash = NULL;
+    eventLoop->timeEventCount = 0;
+    eventLoop->timeEventStashCount = 0;
+    eventLoop->timeEventHeapSize = 0;
+    eventLoop->timeEventTable = NULL;
+    eventLoop->timeEventTableSize = 0;
     eventLoop->timeEventNextId = 0;
 
     eventLoop->stop = 0;
@@ -150,9 +167,16 @@ int aeResizeSetSize(aeEventLoop *eventLoop, int setsize) {
  * ɾ¼
  */
 void aeDeleteEventLoop(aeEventLoop *eventLoop) {
+    int j;
+
     aeApiFree(eventLoop);
     zfree(eventLoop->events);
     zfree(eventLoop->fired);
+    for (j = 0; j < eventLoop->timeEventCount; j++)
+        zfree(eventLoop->timeEventHeap[j]);
+    zfree(eventLoop->timeEventHeap);
+    zfree(eventLoop->timeEventStash);
+    zfree(eventLoop->timeEventTable);
     zfree(eventLoop);
 }
 
@@ -277,6 +301,183 @@ static void aeAddMillisecondsToNow(long long milliseconds, long *sec, long *ms)
     *ms = when_ms;
 }
 
+/* Time events are kept in a binary min-heap ordered by fire time, so that
+ * the nearest timer is always eventLoop->timeEventHeap[0] and insertion,
+ * deletion and rescheduling are O(log(N)). A small hash table indexed by
+ * the event id makes aeDeleteTimeEvent() able to locate the event without
+ * scanning all the timers.
+ *
+ * ʱ¼ԵʱСУ
+ * ʱ¼λڶѶ롢ɾµȵĸӶȶΪ O(log(N)) 
+ * ʹһ id ΪĹϣ aeDeleteTimeEvent ʱ¼ */
+
+#define AE_TIME_TABLE_INITIAL_SIZE 16
+#define AE_TIME_HEAP_INITIAL_SIZE 16
+
+/* Return non zero if the time event 'a' should fire before 'b'. */
+static int aeTimeEventBefore(aeTimeEvent *a, aeTimeEvent *b) {
+    if (a->when_sec != b->when_sec) return a->when_sec < b->when_sec;
+    if (a->when_ms != b->when_ms) return a->when_ms < b->when_ms;
+    return a->id < b->id;
+}
+
+/* Store 'te' at position 'j' of the heap, updating its back reference. */
+static void aeTimeHeapSet(aeEventLoop *eventLoop, int j, aeTimeEvent *te) {
+    eventLoop->timeEventHeap[j] = te;
+    te->heap_index = j;
+}
+
+/* Move the element at position 'j' towards the root while it fires before
+ * its parent. */
+static void aeTimeHeapSiftUp(aeEventLoop *eventLoop, int j) {
+    aeTimeEvent **heap = eventLoop->timeEventHeap;
+    aeTimeEvent *te = heap[j];
+
+    while (j > 0) {
+        int parent = (j-1)/2;
+
+        if (!aeTimeEventBefore(te,heap[parent])) break;
+        aeTimeHeapSet(eventLoop,j,heap[parent]);
+        j = parent;
+    }
+    aeTimeHeapSet(eventLoop,j,te);
+}
+
+/* Move the element at position 'j' towards the leaves while one of its
+ * children fires before it. */
+static void aeTimeHeapSiftDown(aeEventLoop *eventLoop, int j) {
+    aeTimeEvent **heap = eventLoop->timeEventHeap;
+    aeTimeEvent *te = heap[j];
+    int count = eventLoop->timeEventCount;
+
+    while (1) {
+        int child = j*2+1;
+
+        if (child >= count) break;
+        if (child+1 < count && aeTimeEventBefore(heap[child+1],heap[child]))
+            child++;
+        if (!aeTimeEventBefore(heap[child],te)) break;
+        aeTimeHeapSet(eventLoop,j,heap[child]);
+        j = child;
+    }
+    aeTimeHeapSet(eventLoop,j,te);
+}
+
+/* Make sure the heap and the stash can hold one more time event. */
+static int aeTimeHeapReserve(aeEventLoop *eventLoop) {
+    int needed = eventLoop->timeEventCount + eventLoop->timeEventStashCount + 1;
+    int size = eventLoop->timeEventHeapSize;
+    aeTimeEvent **heap, **stash;
+
+    if (needed <= size) return AE_OK;
+    size = size ? size*2 : AE_TIME_HEAP_INITIAL_SIZE;
+    heap = zrealloc(eventLoop->timeEventHeap,sizeof(aeTimeEvent*)*size);
+    if (heap == NULL) return AE_ERR;
+    eventLoop->timeEventHeap = heap;
+    stash = zrealloc(eventLoop->timeEventStash,sizeof(aeTimeEvent*)*size);
+    if (stash == NULL) return AE_ERR;
+    eventLoop->timeEventStash = stash;
+    eventLoop->timeEventHeapSize = size;
+    return AE_OK;
+}
+
+/* Add 'te' to the heap. Space must already be reserved. */
+static void aeTimeHeapInsert(aeEventLoop *eventLoop, aeTimeEvent *te) {
+    int j = eventLoop->timeEventCount++;
+
+    aeTimeHeapSet(eventLoop,j,te);
+    aeTimeHeapSiftUp(eventLoop,j);
+}
+
+/* Remove 'te' from the heap. */
+static void aeTimeHeapRemove(aeEventLoop *eventLoop, aeTimeEvent *te) {
+    int j = te->heap_index;
+    int last = --eventLoop->timeEventCount;
+
+    te->heap_index = -1;
+    if (j == last) return;
+
+    /* Fill the hole with the last element and restore the heap property,
+     * that may be violated in either direction. */
+    aeTimeHeapSet(eventLoop,j,eventLoop->timeEventHeap[last]);
+    aeTimeHeapSiftDown(eventLoop,j);
+    aeTimeHeapSiftUp(eventLoop,eventLoop->timeEventHeap[j]->heap_index);
+}
+
+/* Restore the heap property of the whole array in O(N). */
+static void aeTimeHeapBuild(aeEventLoop *eventLoop) {
+    int j;
+
+    for (j = eventLoop->timeEventCount/2-1; j >= 0; j--)
+        aeTimeHeapSiftDown(eventLoop,j);
+}
+
+/* Return the bucket of the id table where the event with the given id
+ * is stored. */
+static aeTimeEvent **aeTimeTableBucket(aeEventLoop *eventLoop, long long id) {
+    return &eventLoop->timeEventTable[(unsigned long)id &
+                                      (eventLoop->timeEventTableSize-1)];
+}
+
+/* Lookup the time event with the specified id. NULL is returned if the
+ * event does not exist. */
+static aeTimeEvent *aeTimeTableFind(aeEventLoop *eventLoop, long long id) {
+    aeTimeEvent *te;
+
+    if (eventLoop->timeEventTableSize == 0) return NULL;
+    te = *aeTimeTableBucket(eventLoop,id);
+    while(te) {
+        if (te->id == id) return te;
+        te = te->next;
+    }
+    return NULL;
+}
+
+/* Add 'te' to the id table, doubling the table when the number of time
+ * events exceeds the number of buckets. */
+static int aeTimeTableAdd(aeEventLoop *eventLoop, aeTimeEvent *te) {
+    unsigned long events = eventLoop->timeEventCount +
+                           eventLoop->timeEventStashCount + 1;
+    aeTimeEvent **bucket;
+
+    if (events > eventLoop->timeEventTableSize) {
+        unsigned long size = eventLoop->timeEventTableSize, j;
+        unsigned long newsize = size ? size*2 : AE_TIME_TABLE_INITIAL_SIZE;
+        aeTimeEvent **old = eventLoop->timeEventTable;
+        aeTimeEvent **table = zmalloc(sizeof(aeTimeEvent*)*newsize);
+
+        if (table == NULL) return AE_ERR;
+        memset(table,0,sizeof(aeTimeEvent*)*newsize);
+        eventLoop->timeEventTable = table;
+        eventLoop->timeEventTableSize = newsize;
+        for (j = 0; j < size; j++) {
+            aeTimeEvent *e = old[j], *next;
+
+            while(e) {
+                next = e->next;
+                bucket = aeTimeTableBucket(eventLoop,e->id);
+                e->next = *bucket;
+                *bucket = e;
+                e = next;
+            }
+        }
+        zfree(old);
+    }
+    bucket = aeTimeTableBucket(eventLoop,te->id);
+    te->next = *bucket;
+    *bucket = te;
+    return AE_OK;
+}
+
+/* Unlink 'te' from the id table. */
+static void aeTimeTableRemove(aeEventLoop *eventLoop, aeTimeEvent *te) {
+    aeTimeEvent **link = aeTimeTableBucket(eventLoop,te->id);
+
+    while(*link != te) link = &(*link)->next;
+    *link = te->next;
+    te->next = NULL;
+}
+
 /*
  * ʱ¼
  */ //ļ¼aeCreateFileEvent   ʱ¼aeCreateTimeEvent aeProcessEventsִļʱ¼
@@ -285,11 +486,12 @@ long long aeCreateTimeEvent(aeEventLoop *eventLoop, long long milliseconds,
         aeEventFinalizerProc *finalizerProc)
 {
     // ʱ
-    long long id = eventLoop->timeEventNextId++;
+    long long id = eventLoop->timeEventNextId;
 
     // ʱ¼ṹ
     aeTimeEvent *te;
 
+    if (aeTimeHeapReserve(eventLoop) == AE_ERR) return AE_ERR;
     te = zmalloc(sizeof(*te));
     if (te == NULL) return AE_ERR;
 
@@ -304,46 +506,49 @@ long long aeCreateTimeEvent(aeEventLoop *eventLoop, long long milliseconds,
     // ˽
     te->clientData = clientData;
 
-    // ¼ͷ
-    te->next = eventLoop->timeEventHead;
-    eventLoop->timeEventHead = te;
+    // ¼ id ԼС
+    if (aeTimeTableAdd(eventLoop,te) == AE_ERR) {
+        zfree(te);
+        return AE_ERR;
+    }
+    aeTimeHeapInsert(eventLoop,te);
+    eventLoop->timeEventNextId++;
 
     return id;
 }
 
 /*
  * ɾ id ʱ¼
+ *
+ * Events that are currently being processed by processTimeEvents() are
+ * out of the heap: they are only flagged as deleted here and released
+ * by processTimeEvents() itself, so it is safe for a timer callback to
+ * delete itself or other timers.
  */
 int aeDeleteTimeEvent(aeEventLoop *eventLoop, long long id)
 {
-    aeTimeEvent *te, *prev = NULL;
-
-    // 
-    te = eventLoop->timeEventHead;
-    while(te) {
-
-        // Ŀ¼ɾ
-        if (te->id == id) {
+    aeTimeEvent *te;
 
-            if (prev == NULL)
-                eventLoop->timeEventHead = te->next;
-            else
-                prev->next = te->next;
+    // ͨ id Ŀ¼
+    if (id == AE_DELETED_EVENT_ID ||
+        (te = aeTimeTableFind(eventLoop,id)) == NULL)
+        return AE_ERR; /* NO event with the specified ID found */
 
-            // ִ
-            if (te->finalizerProc)
-                te->finalizerProc(eventLoop, te->clientData);
+    aeTimeTableRemove(eventLoop,te);
 
-            // ͷʱ¼
-            zfree(te);
+    // ִ
+    if (te->finalizerProc)
+        te->finalizerProc(eventLoop, te->clientData);
 
-            return AE_OK;
-        }
-        prev = te;
-        te = te->next;
+    if (te->heap_index == -1) {
+        // ¼ڱ processTimeEvents ͷ
+        te->id = AE_DELETED_EVENT_ID;
+    } else {
+        // ӶƳͷʱ¼
+        aeTimeHeapRemove(eventLoop,te);
+        zfree(te);
     }
-
-    return AE_ERR; /* NO event with the specified ID found */
+    return AE_OK;
 }
 
 /* Search the first timer to fire.
@@ -351,27 +556,14 @@ int aeDeleteTimeEvent(aeEventLoop *eventLoop, long long id)
  * put in sleep without to delay any event.
  * If there are no timers NULL is returned.
  *
- * Note that's O(N) since time events are unsorted.
- * Possible optimizations (not needed by Redis so far, but...):
- * 1) Insert the event in order, so that the nearest is just the head.
- *    Much better but still insertion or deletion of timers is O(N).
- * 2) Use a skiplist to have this operation as O(1) and insertion as O(log(N)).
+ * This is O(1) since time events are stored in a min-heap.
  */
 // ѰĿǰʱʱ¼
-// ΪģԲҸӶΪ ON
+// Ϊʱ¼СУֱӷضѶɣӶΪ O(1)
 static aeTimeEvent *aeSearchNearestTimer(aeEventLoop *eventLoop)
 {
-    aeTimeEvent *te = eventLoop->timeEventHead;
-    aeTimeEvent *nearest = NULL;
-
-    while(te) {
-        if (!nearest || te->when_sec < nearest->when_sec ||
-                (te->when_sec == nearest->when_sec &&
-                 te->when_ms < nearest->when_ms))
-            nearest = te;
-        te = te->next;
-    }
-    return nearest;
+    if (eventLoop->timeEventCount == 0) return NULL;
+    return eventLoop->timeEventHeap[0];
 }
 
 /* Process time events
@@ -379,7 +571,7 @@ static aeTimeEvent *aeSearchNearestTimer(aeEventLoop *eventLoop)
  * ѵʱ¼
  */ // //ļ¼aeCreateFileEvent   ʱ¼aeCreateTimeEvent aeProcessEventsִļʱ¼
 static int processTimeEvents(aeEventLoop *eventLoop) {
-    int processed = 0;
+    int processed = 0, stashed, j;
     aeTimeEvent *te;
     long long maxId;
     time_t now = time(NULL);
@@ -395,80 +587,77 @@ static int processTimeEvents(aeEventLoop *eventLoop) {
     // ͨ¼ʱ䣬
     // ֹʱ䴩壨skewɵ¼
     if (now < eventLoop->lastTime) {
-        te = eventLoop->timeEventHead;
-        while(te) {
-            te->when_sec = 0;
-            te = te->next;
-        }
+        for (j = 0; j < eventLoop->timeEventCount; j++)
+            eventLoop->timeEventHeap[j]->when_sec = 0;
+        aeTimeHeapBuild(eventLoop);
     }
     // һδʱ¼ʱ
     eventLoop->lastTime = now;
 
-    // 
-    // ִЩѾ¼
-    te = eventLoop->timeEventHead;
+    /* Pop from the heap every event that is due. Every popped event is
+     * moved into the stash, so that it fires at most once per call even
+     * if its handler reschedules it with a zero period, and it is put back
+     * into the heap only at the end. Events registered by the handlers
+     * themselves (id > maxId) are stashed without being processed, in order
+     * to don't loop forever.
+     *
+     * ӶѶʼѵ¼ݴ浽 stash У
+     * ֤ÿ¼һεִһΣ֮ٷŻضС */
+    stashed = eventLoop->timeEventStashCount;
     maxId = eventLoop->timeEventNextId-1;
-    while(te) {
+    while(eventLoop->timeEventCount) {
         long now_sec, now_ms;
         long long id;
+        int retval;
+
+        te = eventLoop->timeEventHeap[0];
 
-        // Ч¼
-        if (te->id > maxId) {
-            te = te->next;
-            continue;
-        }
-        
         // ȡǰʱ
         aeGetTime(&now_sec, &now_ms);
 
-        // ǰʱڻ¼ִʱ䣬ô˵¼ѵִ¼
-        if (now_sec > te->when_sec ||
-            (now_sec == te->when_sec && now_ms >= te->when_ms))
-        {
-            int retval;
+        // Ѷ¼δô¼Ҳûе
+        if (now_sec < te->when_sec ||
+            (now_sec == te->when_sec && now_ms < te->when_ms)) break;
 
-            id = te->id;
-            // ִ¼ȡֵ
-            retval = te->timeProc(eventLoop, id, te->clientData);
-            processed++;
-            /* After an event is processed our time event list may
-             * no longer be the same, so we restart from head.
-             * Still we make sure to don't process events registered
-             * by event handlers itself in order to don't loop forever.
-             * To do so we saved the max ID we want to handle.
-             *
-             * FUTURE OPTIMIZATIONS:
-             * Note that this is NOT great algorithmically. Redis uses
-             * a single time event so it's not a problem but the right
-             * way to do this is to add the new elements on head, and
-             * to flag deleted elements in a special way for later
-             * deletion (putting references to the nodes to delete into
-             * another linked list). */
-            /*
+        aeTimeHeapRemove(eventLoop,te);
+        eventLoop->timeEventStash[eventLoop->timeEventStashCount++] = te;
+
+        // ڱδд¼
+        if (te->id > maxId) continue;
+
+        id = te->id;
+        // ִ¼ȡֵ
+        retval = te->timeProc(eventLoop, id, te->clientData);
+        processed++;
+
+        // ¼Ѿڴбɾ
+        if (te->id == AE_DELETED_EVENT_ID) continue;
+
+        /*
  ¼AE_NOMOREô¼Ϊʱ¼¼ڴﵽһ֮ͻᱻɾ֮ٵ
  ¼һAE NOMOREֵô¼Ϊʱ䣺һʱ¼֮󣬷¼صֵ
  ʱ¼whenԽи£¼һʱ֮ٴεַʽһֱ²ȥ
  ˵һʱ¼ĸֵ30ôӦöʱ¼и£¼30֮ٴε
-
-
- * ʱ¼ǷҪִе flag
  */
-            // ¼ǷҪѭִ¼ʱ
-            if (retval != AE_NOMORE) {
-                // ǵģ retval ִ֮ʱ¼
-                aeAddMillisecondsToNow(retval,&te->when_sec,&te->when_ms);
-            } else {
-                // ¼ɾ
-                aeDeleteTimeEvent(eventLoop, id);
-            }
-
-            // Ϊִ¼֮¼бѾı
-            // Ҫ te Żرͷʼִ¼
-            te = eventLoop->timeEventHead;
+        // ¼ǷҪѭִ¼ʱ
+        if (retval != AE_NOMORE) {
+            // ǵģ retval ִ֮ʱ¼
+            aeAddMillisecondsToNow(retval,&te->when_sec,&te->when_ms);
         } else {
-            te = te->next;
+            // ¼ɾ
+            aeDeleteTimeEvent(eventLoop, id);
         }
     }
+
+    // ݴ¼ŻضУͷѱɾ¼
+    for (j = stashed; j < eventLoop->timeEventStashCount; j++) {
+        te = eventLoop->timeEventStash[j];
+        if (te->id == AE_DELETED_EVENT_ID)
+            zfree(te);
+        else
+            aeTimeHeapInsert(eventLoop,te);
+    }
+    eventLoop->timeEventStashCount = stashed;
     return processed;
 }
 
@@ -658,9 +847,283 @@ char *aeGetApiName(void) {
     return aeApiName();
 }
 
+/*
+ * ֮󴴽¼Ƿʹ io_uring
+ *
+ * Only meaningful when compiled with io_uring support (USE_IO_URING=yes):
+ * event loops created after aeUseIoUring(0) use epoll instead.
+ */
+void aeUseIoUring(int enable) {
+    aeIoUringEnabled = enable;
+}
+
 /*
  * ô¼ǰҪִеĺ
  */
 void aeSetBeforeSleepProc(aeEventLoop *eventLoop, aeBeforeSleepProc *beforesleep) {
     eventLoop->beforesleep = beforesleep;
 }
+
+#ifdef AE_TEST_MAIN
+#include <assert.h>
+#include <sys/socket.h>
+
+/* Build with:
+ *
+ *   cc -O2 -DAE_TEST_MAIN ae.c zmalloc.c -o ae-test
+ *
+ * Add -DUSE_IO_URING to test the io_uring backend as well.
+ *
+ * ʱ¼ļ¼ȷԲԣÿ¼ѭʱ¼仯
+ * ׼ԣԼ·ʵֵĻ׼ */
+
+static long long usec(void) {
+    struct timeval tv;
+    gettimeofday(&tv,NULL);
+    return (((long long)tv.tv_sec)*1000000)+tv.tv_usec;
+}
+
+static int fired[8];
+
+static int testRecordProc(aeEventLoop *el, long long id, void *clientData) {
+    AE_NOTUSED(el);
+    AE_NOTUSED(id);
+    fired[(long)clientData]++;
+    return AE_NOMORE;
+}
+
+static int testSelfDeleteProc(aeEventLoop *el, long long id, void *clientData) {
+    fired[(long)clientData]++;
+    assert(aeDeleteTimeEvent(el,id) == AE_OK);
+    return 0;
+}
+
+static int testTickProc(aeEventLoop *el, long long id, void *clientData) {
+    AE_NOTUSED(el);
+    AE_NOTUSED(id);
+    (*(long long*)clientData)++;
+    return 0; /* Fire again at every loop iteration. */
+}
+
+static int testIdleProc(aeEventLoop *el, long long id, void *clientData) {
+    AE_NOTUSED(el);
+    AE_NOTUSED(id);
+    AE_NOTUSED(clientData);
+    return 1000000;
+}
+
+static int fdfired[2];
+
+static void testFileProc(aeEventLoop *el, int fd, void *clientData, int mask) {
+    AE_NOTUSED(el);
+    AE_NOTUSED(fd);
+    AE_NOTUSED(clientData);
+    if (mask & AE_READABLE) fdfired[0]++;
+    if (mask & AE_WRITABLE) fdfired[1]++;
+}
+
+/* Like a client: read the request, install the write handler, that writes
+ * the reply and removes itself. */
+static void testEchoWriteProc(aeEventLoop *el, int fd, void *clientData, int mask) {
+    AE_NOTUSED(clientData);
+    AE_NOTUSED(mask);
+    assert(write(fd,"+",1) == 1);
+    aeDeleteFileEvent(el,fd,AE_WRITABLE);
+}
+
+static void testEchoReadProc(aeEventLoop *el, int fd, void *clientData, int mask) {
+    char c;
+    AE_NOTUSED(mask);
+    if (read(fd,&c,1) == 1)
+        aeCreateFileEvent(el,fd,AE_WRITABLE,testEchoWriteProc,clientData);
+}
+
+/* Run the file event tests against the backend selected by aeUseIoUring(). */
+static void testFileEvents(void) {
+    aeEventLoop *el;
+    int p[2], q[2];
+    char c;
+
+    el = aeCreateEventLoop(1024);
+    printf("[%s] Readable and writable events: ", aeGetApiName()); {
+        assert(pipe(p) == 0);
+        memset(fdfired,0,sizeof(fdfired));
+        aeCreateFileEvent(el,p[0],AE_READABLE,testFileProc,NULL);
+        aeCreateFileEvent(el,p[1],AE_WRITABLE,testFileProc,NULL);
+        aeProcessEvents(el,AE_FILE_EVENTS|AE_DONT_WAIT);
+        assert(fdfired[0] == 0 && fdfired[1] == 1);
+        assert(write(p[1],"x",1) == 1);
+        aeProcessEvents(el,AE_FILE_EVENTS|AE_DONT_WAIT);
+        assert(fdfired[0] == 1 && fdfired[1] == 2);
+        /* Level triggered: fires again while the data is not read. */
+        aeProcessEvents(el,AE_FILE_EVENTS|AE_DONT_WAIT);
+        assert(fdfired[0] == 2 && fdfired[1] == 3);
+        assert(read(p[0],&c,1) == 1);
+        aeProcessEvents(el,AE_FILE_EVENTS|AE_DONT_WAIT);
+        assert(fdfired[0] == 2 && fdfired[1] == 4);
+        printf("OK\n");
+    }
+
+    printf("[%s] Deleted events no longer fire: ", aeGetApiName()); {
+        memset(fdfired,0,sizeof(fdfired));
+        aeDeleteFileEvent(el,p[1],AE_WRITABLE);
+        assert(write(p[1],"x",1) == 1);
+        aeProcessEvents(el,AE_FILE_EVENTS|AE_DONT_WAIT);
+        assert(fdfired[0] == 1 && fdfired[1] == 0);
+        aeDeleteFileEvent(el,p[0],AE_READABLE);
+        aeProcessEvents(el,AE_FILE_EVENTS|AE_DONT_WAIT);
+        assert(fdfired[0] == 1 && fdfired[1] == 0);
+        printf("OK\n");
+    }
+
+    printf("[%s] Reused descriptors: ", aeGetApiName()); {
+        /* The old pipe is closed while having data pending, and its fds
+         * are reused by a new, empty, pipe. */
+        aeCreateFileEvent(el,p[0],AE_READABLE,testFileProc,NULL);
+        aeProcessEvents(el,AE_FILE_EVENTS|AE_DONT_WAIT);
+        aeDeleteFileEvent(el,p[0],AE_READABLE);
+        close(p[0]);
+        close(p[1]);
+        assert(pipe(q) == 0 && q[0] == p[0]);
+        memset(fdfired,0,sizeof(fdfired));
+        aeCreateFileEvent(el,q[0],AE_READABLE,testFileProc,NULL);
+        aeProcessEvents(el,AE_FILE_EVENTS|AE_DONT_WAIT);
+        assert(fdfired[0] == 0);
+        assert(write(q[1],"x",1) == 1);
+        assert(aeProcessEvents(el,AE_FILE_EVENTS) == 1);
+        assert(fdfired[0] == 1);
+        close(q[0]);
+        close(q[1]);
+        aeDeleteEventLoop(el);
+        printf("OK\n");
+    }
+
+    printf("[%s] Request/reply round trips:\n", aeGetApiName()); {
+        int conns[] = {1, 10, 100}, c, j, k;
+
+        for (c = 0; c < (int)(sizeof(conns)/sizeof(conns[0])); c++) {
+            int sv[100][2], rounds = 20000/conns[c];
+            char reply;
+            long long start, elapsed;
+
+            el = aeCreateEventLoop(1024);
+            for (j = 0; j < conns[c]; j++) {
+                assert(socketpair(AF_UNIX,SOCK_STREAM,0,sv[j]) == 0);
+                aeCreateFileEvent(el,sv[j][0],AE_READABLE,testEchoReadProc,
+                                  NULL);
+            }
+            start = usec();
+            for (k = 0; k < rounds; k++) {
+                for (j = 0; j < conns[c]; j++)
+                    assert(write(sv[j][1],"*",1) == 1);
+                /* One iteration reads the requests, the next one writes the
+                 * replies. */
+                aeProcessEvents(el,AE_FILE_EVENTS);
+                aeProcessEvents(el,AE_FILE_EVENTS);
+                for (j = 0; j < conns[c]; j++)
+                    assert(read(sv[j][1],&reply,1) == 1);
+            }
+            elapsed = usec()-start;
+            printf("  %3d connections: %7.1f ns/request\n",
+                   conns[c],(double)elapsed*1000/(rounds*conns[c]));
+            for (j = 0; j < conns[c]; j++) {
+                close(sv[j][0]);
+                close(sv[j][1]);
+            }
+            aeDeleteEventLoop(el);
+        }
+    }
+}
+
+int main(void) {
+    aeEventLoop *el;
+    long long id, ids[4];
+    int j;
+
+    printf("Heap keeps nearest timer on top: "); {
+        el = aeCreateEventLoop(64);
+        for (j = 0; j < 1000; j++)
+            aeCreateTimeEvent(el,100000+(rand()%100000),testIdleProc,NULL,NULL);
+        id = aeCreateTimeEvent(el,50000,testIdleProc,NULL,NULL);
+        assert(aeSearchNearestTimer(el)->id == id);
+        assert(aeDeleteTimeEvent(el,id) == AE_OK);
+        assert(aeDeleteTimeEvent(el,id) == AE_ERR);
+        assert(aeSearchNearestTimer(el)->id != id);
+        for (j = 1; j < el->timeEventCount; j++)
+            assert(!aeTimeEventBefore(el->timeEventHeap[j],
+                                      el->timeEventHeap[(j-1)/2]));
+        aeDeleteEventLoop(el);
+        printf("OK\n");
+    }
+
+    printf("Due timers fire once and are released: "); {
+        el = aeCreateEventLoop(64);
+        memset(fired,0,sizeof(fired));
+        ids[0] = aeCreateTimeEvent(el,0,testRecordProc,(void*)0,NULL);
+        ids[1] = aeCreateTimeEvent(el,0,testSelfDeleteProc,(void*)1,NULL);
+        ids[2] = aeCreateTimeEvent(el,100000,testRecordProc,(void*)2,NULL);
+        usleep(2000);
+        aeProcessEvents(el,AE_TIME_EVENTS|AE_DONT_WAIT);
+        aeProcessEvents(el,AE_TIME_EVENTS|AE_DONT_WAIT);
+        assert(fired[0] == 1 && fired[1] == 1 && fired[2] == 0);
+        assert(el->timeEventCount == 1 && el->timeEventStashCount == 0);
+        assert(aeDeleteTimeEvent(el,ids[0]) == AE_ERR);
+        assert(aeDeleteTimeEvent(el,ids[1]) == AE_ERR);
+        assert(aeDeleteTimeEvent(el,ids[2]) == AE_OK);
+        aeDeleteEventLoop(el);
+        printf("OK\n");
+    }
+
+    testFileEvents();
+#ifdef HAVE_IO_URING
+    aeUseIoUring(0);
+    testFileEvents();
+    aeUseIoUring(1);
+#endif
+
+    printf("Per-iteration cost vs. timer count:\n"); {
+        int counts[] = {1, 10, 100, 1000, 10000, 100000, 1000000};
+        int iterations = 100000, c;
+
+        for (c = 0; c < (int)(sizeof(counts)/sizeof(counts[0])); c++) {
+            long long ticks = 0, start, loop_us, churn_us;
+
+            el = aeCreateEventLoop(64);
+            for (j = 0; j < counts[c]; j++)
+                aeCreateTimeEvent(el,100000+(rand()%100000),testIdleProc,
+                                  NULL,NULL);
+            aeCreateTimeEvent(el,0,testTickProc,&ticks,NULL);
+
+            /* Every iteration does the timer work of aeProcessEvents():
+             * it looks for the nearest timer to compute the poll timeout
+             * and fires the tick timer, that reschedules itself. The
+             * poll() itself is left out since it does not depend on the
+             * number of timers. */
+            start = usec();
+            for (j = 0; j < iterations; j++) {
+                assert(aeSearchNearestTimer(el) != NULL);
+                aeProcessEvents(el,AE_TIME_EVENTS|AE_DONT_WAIT);
+            }
+            loop_us = usec()-start;
+
+            /* Create and delete a timer, as a per-client timeout would. */
+            start = usec();
+            for (j = 0; j < iterations; j++) {
+                id = aeCreateTimeEvent(el,100000+(rand()%100000),
+                                       testIdleProc,NULL,NULL);
+                aeDeleteTimeEvent(el,id);
+            }
+            churn_us = usec()-start;
+
+            printf("  %7d timers: %7.1f ns/iteration, "
+                   "%7.1f ns/create+delete (%lld ticks)\n",
+                   counts[c],
+                   (double)loop_us*1000/iterations,
+                   (double)churn_us*1000/iterations,
+                   ticks);
+            aeDeleteEventLoop(el);
+        }
+    }
+    return 0;
+}
+#endif
@@ -74,6 +74,11 @@
  */
 #define AE_NOMORE -1
 
+/*
+ * ѱɾȴ processTimeEvents ͷŵʱ¼ id
+ */
+#define AE_DELETED_EVENT_ID -1
+
 /* Macros */
 #define AE_NOTUSED(V) ((void) V)
 
@@ -135,8 +140,11 @@ typedef struct aeTimeEvent {
     // ·ÿ˽
     void *clientData;
 
-    // ָ¸ʱ¼ṹγ
-    struct aeTimeEvent *next;
+    // ¼Се±꣬ڶʱΪ -1
+    int heap_index; /* index in eventLoop->timeEventHeap, -1 if not there */
+
+    // ָ id ͬһͰе¸ʱ¼
+    struct aeTimeEvent *next; /* next event in the same id table bucket */
 
 } aeTimeEvent;
 
@@ -180,8 +188,18 @@ typedef struct aeEventLoop {
     // Ѿļ¼
     aeFiredEvent *fired; /* Fired events */
 
-    // ʱ¼
-    aeTimeEvent *timeEventHead;
+    // ʱ¼СѣѶΪ絽ʱ¼
+    aeTimeEvent **timeEventHeap; /* binary min-heap ordered by fire time */
+    int timeEventCount;          /* number of time events in the heap */
+    int timeEventStashCount;     /* events temporarily out of the heap */
+    int timeEventHeapSize;       /* allocated slots of heap and stash */
+
+    //  processTimeEvents дʱƳѵʱ¼
+    aeTimeEvent **timeEventStash;
+
+    //  id Ϊʱ¼СΪ 2 
+    aeTimeEvent **timeEventTable; /* id -> event, chained by te->next */
+    unsigned long timeEventTableSize;
 
     // ¼Ŀ
     int stop;
@@ -210,6 +228,7 @@ int aeProcessEvents(aeEventLoop *eventLoop, int flags);
 int aeWait(int fd, int mask, long long milliseconds);
 void aeMain(aeEventLoop *eventLoop);
 char *aeGetApiName(void);
+void aeUseIoUring(int enable);
 void aeSetBeforeSleepProc(aeEventLoop *eventLoop, aeBeforeSleepProc *beforesleep);
 int aeGetSetSize(aeEventLoop *eventLoop);
 int aeResizeSetSize(aeEventLoop *eventLoop, int setsize);
@@ -44,6 +44,12 @@ typedef struct aeApiState {
 
 } aeApiState;
 
+/* Where the state is stored in the event loop. ae_iouring.c overrides it
+ * since it keeps the epoll state inside its own when falling back. */
+#ifndef AE_API_STATE
+#define AE_API_STATE(eventLoop) ((eventLoop)->apidata)
+#endif
+
 /*
  * һµ epoll ʵֵ eventLoop
  */
@@ -69,7 +75,7 @@ static int aeApiCreate(aeEventLoop *eventLoop) {
     }
 
     // ֵ eventLoop
-    eventLoop->apidata = state;
+    AE_API_STATE(eventLoop) = state;
     return 0;
 }
 
@@ -77,7 +83,7 @@ static int aeApiCreate(aeEventLoop *eventLoop) {
  * ¼۴С
  */
 static int aeApiResize(aeEventLoop *eventLoop, int setsize) {
-    aeApiState *state = eventLoop->apidata;
+    aeApiState *state = AE_API_STATE(eventLoop);
 
     state->events = zrealloc(state->events, sizeof(struct epoll_event)*setsize);
     return 0;
@@ -87,7 +93,7 @@ static int aeApiResize(aeEventLoop *eventLoop, int setsize) {
  * ͷ epoll ʵ¼
  */
 static void aeApiFree(aeEventLoop *eventLoop) {
-    aeApiState *state = eventLoop->apidata;
+    aeApiState *state = AE_API_STATE(eventLoop);
 
     close(state->epfd);
     zfree(state->events);
@@ -98,7 +104,7 @@ static void aeApiFree(aeEventLoop *eventLoop) {
  * ¼ fd
  */
 static int aeApiAddEvent(aeEventLoop *eventLoop, int fd, int mask) {
-    aeApiState *state = eventLoop->apidata;
+    aeApiState *state = AE_API_STATE(eventLoop);
     struct epoll_event ee;
 
     /* If the fd was already monitored for some event, we need a MOD
@@ -128,7 +134,7 @@ static int aeApiAddEvent(aeEventLoop *eventLoop, int fd, int mask) {
  *  fd ɾ¼
  */
 static void aeApiDelEvent(aeEventLoop *eventLoop, int fd, int delmask) {
-    aeApiState *state = eventLoop->apidata;
+    aeApiState *state = AE_API_STATE(eventLoop);
     struct epoll_event ee;
 
     int mask = eventLoop->events[fd].mask & (~delmask);
@@ -151,7 +157,7 @@ static void aeApiDelEvent(aeEventLoop *eventLoop, int fd, int delmask) {
  * ȡִ¼
  */ ////ļ¼aeCreateFileEvent   ʱ¼aeCreateTimeEvent aeProcessEventsִļʱ¼
 static int aeApiPoll(aeEventLoop *eventLoop, struct timeval *tvp) {
-    aeApiState *state = eventLoop->apidata;
+    aeApiState *state = AE_API_STATE(eventLoop);
     int retval, numevents = 0;
 
     // ȴʱ
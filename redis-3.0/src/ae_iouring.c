@@ -0,0 +1,485 @@
+/* Linux io_uring(7) based ae.c module.
+ *
+ *  Linux io_uring Ķ·ʵ
+ *
+ * The ring is used as a batched readiness multiplexer: the interest in a
+ * file descriptor is expressed with a one-shot IORING_OP_POLL_ADD request,
+ * that is armed again after it fires. All the registrations, re-arms and
+ * removals queued during an event loop iteration are submitted, together
+ * with the wait for new events, by a single io_uring_enter(2) call, where
+ * the epoll backend needs an epoll_ctl(2) for every change (for instance
+ * for every write handler installed and removed while serving a request)
+ * plus the epoll_wait(2).
+ *
+ * ͨ io_uring ύδ POLL_ADD 
+ * ÿ¼ѭеעᡢעɾ
+ * ͬȴ¼ֻҪһ io_uring_enter(2) ϵͳã
+ *  epoll ÿ޸ĶҪһ epoll_ctl(2) 
+ *
+ * A poll request reports the readiness the fd has at the time it is armed,
+ * so arming it again after every completion gives the same level triggered
+ * semantics of the other backends. The reads and writes themselves are
+ * still performed by the file event handlers.
+ *
+ * When the kernel lacks io_uring or one of the features used here (Linux
+ * 5.11 or greater is needed), or when it was disabled with aeUseIoUring(),
+ * the epoll backend is used instead.
+ *
+ * ں˲֧ io_uring Ҫ 5.11 ϰ汾 io_uring 
+ * aeUseIoUring() ʱʹ epoll ʵ֡
+ */
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <endian.h>
+
+/* The state of the io_uring multiplexer.
+ *
+ * ¼״̬ */
+typedef struct aeIoUringState {
+
+    // ʹ io_uring ʱepoll ʵֵ״̬
+    void *epoll;                /* epoll state when falling back, or NULL. */
+
+    // io_uring ʵ
+    int ringfd;
+
+    // ύ
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned sq_entries;
+    struct io_uring_sqe *sqes;
+    unsigned sq_queued;         /* SQEs queued but not yet submitted. */
+
+    // ɶ
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    // ӳڴ
+    void *rings;
+    size_t rings_size, sqes_size;
+
+    // ÿڵȴ poll ʹ
+    // ںѾȡ滻¼
+    unsigned char *armed;       /* AE mask of the in-flight poll, or AE_NONE. */
+    unsigned *gen;              /* Generation of the in-flight poll. */
+
+    // Ҫ´ aeApiPoll() ʱע
+    unsigned char *dirty;       /* Non zero if the fd is in dirtyfds. */
+    int *dirtyfds;
+    int ndirty;
+
+} aeIoUringState;
+
+/* The epoll backend is compiled in as well, with its own names, to be used
+ * as fallback. Its state is kept inside the io_uring one. */
+#define aeApiState aeEpollApiState
+#define aeApiCreate aeEpollApiCreate
+#define aeApiResize aeEpollApiResize
+#define aeApiFree aeEpollApiFree
+#define aeApiAddEvent aeEpollApiAddEvent
+#define aeApiDelEvent aeEpollApiDelEvent
+#define aeApiPoll aeEpollApiPoll
+#define aeApiName aeEpollApiName
+#define AE_API_STATE(eventLoop) (((aeIoUringState*)(eventLoop)->apidata)->epoll)
+#include "ae_epoll.c"
+#undef aeApiState
+#undef aeApiCreate
+#undef aeApiResize
+#undef aeApiFree
+#undef aeApiAddEvent
+#undef aeApiDelEvent
+#undef aeApiPoll
+#undef aeApiName
+#undef AE_API_STATE
+
+/* Size of the submission queue. When it gets full in the middle of an
+ * event loop iteration the queued requests are submitted. */
+#define AE_IOURING_SQ_ENTRIES 1024
+#define AE_IOURING_MAX_CQ_ENTRIES 65536
+
+/* user_data of the POLL_REMOVE requests, whose completions are ignored.
+ * Poll requests use the fd in the low 32 bits and the generation in the
+ * high ones. */
+#define AE_IOURING_REMOVE_DATA 0xffffffffffffffffULL
+#define AE_IOURING_DATA(fd,gen) ((((unsigned long long)(gen))<<32)|(unsigned)(fd))
+
+// Ƿʹ io_uring  aeApiName()
+static int aeIoUringActive = 0;
+
+/* Release the ring, if any. */
+static void aeIoUringRelease(aeIoUringState *state) {
+    if (state->sqes) munmap(state->sqes,state->sqes_size);
+    if (state->rings) munmap(state->rings,state->rings_size);
+    if (state->ringfd != -1) close(state->ringfd);
+    state->sqes = NULL;
+    state->rings = NULL;
+    state->ringfd = -1;
+}
+
+/* Create and map the ring. Returns -1 if io_uring, or one of the features
+ * we rely on, is not available.
+ *
+ *  io_uring ʵӳύкɶ */
+static int aeIoUringSetup(aeIoUringState *state, int setsize) {
+    struct io_uring_params p;
+    unsigned cq_entries = 1;
+    size_t sq_size, cq_size;
+    char *rings;
+
+    /* Every registered fd has at most a poll request in flight: size the
+     * completion queue so that it rarely overflows (the kernel keeps the
+     * overflowed completions anyway, see IORING_FEAT_NODROP). */
+    while (cq_entries < (unsigned)setsize*2 &&
+           cq_entries < AE_IOURING_MAX_CQ_ENTRIES) cq_entries <<= 1;
+
+    memset(&p,0,sizeof(p));
+    p.flags = IORING_SETUP_CQSIZE;
+    p.cq_entries = cq_entries;
+    state->ringfd = syscall(__NR_io_uring_setup,AE_IOURING_SQ_ENTRIES,&p);
+    if (state->ringfd == -1) return -1;
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP) ||
+        !(p.features & IORING_FEAT_NODROP) ||
+        !(p.features & IORING_FEAT_EXT_ARG)) goto err;
+
+    /* With IORING_FEAT_SINGLE_MMAP both the rings live in one mapping. */
+    sq_size = p.sq_off.array + p.sq_entries*sizeof(unsigned);
+    cq_size = p.cq_off.cqes + p.cq_entries*sizeof(struct io_uring_cqe);
+    state->rings_size = sq_size > cq_size ? sq_size : cq_size;
+    state->rings = mmap(NULL,state->rings_size,PROT_READ|PROT_WRITE,
+                        MAP_SHARED,state->ringfd,IORING_OFF_SQ_RING);
+    if (state->rings == MAP_FAILED) {
+        state->rings = NULL;
+        goto err;
+    }
+    state->sqes_size = p.sq_entries*sizeof(struct io_uring_sqe);
+    state->sqes = mmap(NULL,state->sqes_size,PROT_READ|PROT_WRITE,
+                       MAP_SHARED,state->ringfd,IORING_OFF_SQES);
+    if (state->sqes == MAP_FAILED) {
+        state->sqes = NULL;
+        goto err;
+    }
+
+    rings = state->rings;
+    state->sq_head = (unsigned*)(rings+p.sq_off.head);
+    state->sq_tail = (unsigned*)(rings+p.sq_off.tail);
+    state->sq_mask = (unsigned*)(rings+p.sq_off.ring_mask);
+    state->sq_array = (unsigned*)(rings+p.sq_off.array);
+    state->sq_entries = p.sq_entries;
+    state->sq_queued = 0;
+    state->cq_head = (unsigned*)(rings+p.cq_off.head);
+    state->cq_tail = (unsigned*)(rings+p.cq_off.tail);
+    state->cq_mask = (unsigned*)(rings+p.cq_off.ring_mask);
+    state->cqes = (struct io_uring_cqe*)(rings+p.cq_off.cqes);
+    return 0;
+
+err:
+    aeIoUringRelease(state);
+    return -1;
+}
+
+/* Submit the queued requests and, if 'wait' is non zero, wait for at least
+ * one completion or for the 'tvp' timeout (forever if NULL).
+ *
+ * ύе󣬲 wait Ϊ 0 ʱȴһ¼ */
+static int aeIoUringEnter(aeIoUringState *state, int wait, struct timeval *tvp) {
+    struct io_uring_getevents_arg arg;
+    struct __kernel_timespec ts;
+    unsigned flags = IORING_ENTER_EXT_ARG;
+    int retval;
+
+    memset(&arg,0,sizeof(arg));
+    if (wait) {
+        flags |= IORING_ENTER_GETEVENTS;
+        if (tvp) {
+            ts.tv_sec = tvp->tv_sec;
+            ts.tv_nsec = tvp->tv_usec*1000;
+            arg.ts = (unsigned long long)(unsigned long)&ts;
+        }
+    }
+    retval = syscall(__NR_io_uring_enter,state->ringfd,state->sq_queued,
+                     wait ? 1 : 0,flags,&arg,sizeof(arg));
+    /* On success the number of submitted requests is returned. */
+    if (retval > 0) state->sq_queued -= retval;
+    return retval;
+}
+
+/* Get a free submission queue entry, submitting the queued ones if the
+ * queue is full. Returns NULL if no entry could be made available. */
+static struct io_uring_sqe *aeIoUringGetSqe(aeIoUringState *state) {
+    unsigned tail = *state->sq_tail, idx;
+    struct io_uring_sqe *sqe;
+
+    if (tail - __atomic_load_n(state->sq_head,__ATOMIC_ACQUIRE) ==
+        state->sq_entries)
+    {
+        aeIoUringEnter(state,0,NULL);
+        if (tail - __atomic_load_n(state->sq_head,__ATOMIC_ACQUIRE) ==
+            state->sq_entries) return NULL;
+    }
+    idx = tail & *state->sq_mask;
+    sqe = &state->sqes[idx];
+    memset(sqe,0,sizeof(*sqe));
+    state->sq_array[idx] = idx;
+    __atomic_store_n(state->sq_tail,tail+1,__ATOMIC_RELEASE);
+    state->sq_queued++;
+    return sqe;
+}
+
+/* Queue a poll request for the events in 'mask'. Returns -1 if the
+ * submission queue is not available. */
+static int aeIoUringArm(aeIoUringState *state, int fd, int mask) {
+    struct io_uring_sqe *sqe = aeIoUringGetSqe(state);
+    unsigned events = 0;
+
+    if (sqe == NULL) return -1;
+    if (mask & AE_READABLE) events |= POLLIN;
+    if (mask & AE_WRITABLE) events |= POLLOUT;
+#if __BYTE_ORDER == __BIG_ENDIAN
+    events = (events << 16) | (events >> 16);
+#endif
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = events;
+    sqe->user_data = AE_IOURING_DATA(fd,++state->gen[fd]);
+    state->armed[fd] = mask;
+    return 0;
+}
+
+/* Cancel the poll request in flight for 'fd'. Its completion, if any, is
+ * ignored from now on since the fd is no longer armed with that
+ * generation. */
+static void aeIoUringDisarm(aeIoUringState *state, int fd) {
+    struct io_uring_sqe *sqe = aeIoUringGetSqe(state);
+
+    if (sqe) {
+        sqe->opcode = IORING_OP_POLL_REMOVE;
+        sqe->fd = -1;
+        sqe->addr = AE_IOURING_DATA(fd,state->gen[fd]);
+        sqe->user_data = AE_IOURING_REMOVE_DATA;
+    }
+    state->gen[fd]++;
+    state->armed[fd] = AE_NONE;
+}
+
+/* Remember that the poll request of 'fd' must be checked by the next
+ * aeApiPoll(). */
+static void aeIoUringMarkDirty(aeIoUringState *state, int fd) {
+    if (state->dirty[fd]) return;
+    state->dirty[fd] = 1;
+    state->dirtyfds[state->ndirty++] = fd;
+}
+
+/* Make the poll request in flight for every dirty fd match the events
+ * currently registered in the event loop.
+ *
+ * ʹÿϵ poll ¼ѭע¼һ */
+static void aeIoUringArmDirty(aeEventLoop *eventLoop, aeIoUringState *state) {
+    int j, kept = 0;
+
+    for (j = 0; j < state->ndirty; j++) {
+        int fd = state->dirtyfds[j];
+        int mask = eventLoop->events[fd].mask;
+
+        if (mask == state->armed[fd]) {
+            state->dirty[fd] = 0;
+            continue;
+        }
+        if (state->armed[fd] != AE_NONE) aeIoUringDisarm(state,fd);
+        if (mask != AE_NONE && aeIoUringArm(state,fd,mask) == -1) {
+            /* Retry at the next iteration. */
+            state->dirtyfds[kept++] = fd;
+            continue;
+        }
+        state->dirty[fd] = 0;
+    }
+    state->ndirty = kept;
+}
+
+/*
+ * һµ io_uring ʵֵ eventLoop
+ */
+static int aeApiCreate(aeEventLoop *eventLoop) {
+    aeIoUringState *state = zmalloc(sizeof(aeIoUringState));
+
+    if (!state) return -1;
+    memset(state,0,sizeof(*state));
+    state->ringfd = -1;
+    eventLoop->apidata = state;
+
+    // ʹ io_uring ʱʹ epoll
+    if (!aeIoUringEnabled ||
+        aeIoUringSetup(state,eventLoop->setsize) == -1)
+    {
+        if (aeEpollApiCreate(eventLoop) == -1) {
+            zfree(state);
+            return -1;
+        }
+        aeIoUringActive = 0;
+        return 0;
+    }
+
+    state->armed = zcalloc(eventLoop->setsize);
+    state->gen = zcalloc(sizeof(unsigned)*eventLoop->setsize);
+    state->dirty = zcalloc(eventLoop->setsize);
+    state->dirtyfds = zmalloc(sizeof(int)*eventLoop->setsize);
+    state->ndirty = 0;
+    aeIoUringActive = 1;
+    return 0;
+}
+
+/*
+ * ¼۴С
+ */
+static int aeApiResize(aeEventLoop *eventLoop, int setsize) {
+    aeIoUringState *state = eventLoop->apidata;
+    int j, kept = 0, oldsize = eventLoop->setsize;
+
+    if (state->epoll) return aeEpollApiResize(eventLoop,setsize);
+
+    /* Fds over the new size are no longer registered, but they may still
+     * be in the dirty list. */
+    for (j = 0; j < state->ndirty; j++) {
+        if (state->dirtyfds[j] < setsize)
+            state->dirtyfds[kept++] = state->dirtyfds[j];
+    }
+    state->ndirty = kept;
+
+    state->armed = zrealloc(state->armed,setsize);
+    state->gen = zrealloc(state->gen,sizeof(unsigned)*setsize);
+    state->dirty = zrealloc(state->dirty,setsize);
+    state->dirtyfds = zrealloc(state->dirtyfds,sizeof(int)*setsize);
+    if (setsize > oldsize) {
+        memset(state->armed+oldsize,0,setsize-oldsize);
+        memset(state->gen+oldsize,0,sizeof(unsigned)*(setsize-oldsize));
+        memset(state->dirty+oldsize,0,setsize-oldsize);
+    }
+    return 0;
+}
+
+/*
+ * ͷ io_uring ʵ¼
+ */
+static void aeApiFree(aeEventLoop *eventLoop) {
+    aeIoUringState *state = eventLoop->apidata;
+
+    if (state->epoll) {
+        aeEpollApiFree(eventLoop);
+    } else {
+        aeIoUringRelease(state);
+        zfree(state->armed);
+        zfree(state->gen);
+        zfree(state->dirty);
+        zfree(state->dirtyfds);
+    }
+    zfree(state);
+}
+
+/*
+ * ¼ fd
+ *
+ * ֻ´ aeApiPoll() ʱύ
+ */
+static int aeApiAddEvent(aeEventLoop *eventLoop, int fd, int mask) {
+    aeIoUringState *state = eventLoop->apidata;
+
+    if (state->epoll) return aeEpollApiAddEvent(eventLoop,fd,mask);
+    aeIoUringMarkDirty(state,fd);
+    return 0;
+}
+
+/*
+ *  fd ɾ¼
+ */
+static void aeApiDelEvent(aeEventLoop *eventLoop, int fd, int delmask) {
+    aeIoUringState *state = eventLoop->apidata;
+
+    if (state->epoll) {
+        aeEpollApiDelEvent(eventLoop,fd,delmask);
+        return;
+    }
+
+    /* When the fd is no longer monitored at all the poll request is
+     * cancelled right away: the fd is usually closed next, and the pending
+     * request would keep the file open (a socket would not be closed for
+     * the peer) and could report events for it after the fd is reused. */
+    if ((eventLoop->events[fd].mask & ~delmask) == AE_NONE &&
+        state->armed[fd] != AE_NONE)
+    {
+        aeIoUringDisarm(state,fd);
+        aeIoUringEnter(state,0,NULL);
+    } else {
+        aeIoUringMarkDirty(state,fd);
+    }
+}
+
+/*
+ * ȡִ¼
+ */
+static int aeApiPoll(aeEventLoop *eventLoop, struct timeval *tvp) {
+    aeIoUringState *state = eventLoop->apidata;
+    unsigned head, tail;
+    int wait, numevents = 0;
+
+    if (state->epoll) return aeEpollApiPoll(eventLoop,tvp);
+
+    // עѾԼ¼˱仯
+    aeIoUringArmDirty(eventLoop,state);
+
+    /* Don't wait if there are completions already, or if we were asked
+     * not to block. */
+    head = *state->cq_head;
+    tail = __atomic_load_n(state->cq_tail,__ATOMIC_ACQUIRE);
+    wait = head == tail && !(tvp && tvp->tv_sec == 0 && tvp->tv_usec == 0);
+
+    // ύ󲢵ȴ¼ֻҪһϵͳ
+    if (state->sq_queued || wait) aeIoUringEnter(state,wait,tvp);
+
+    // ΪѾ¼Ӧģʽ
+    // 뵽 eventLoop  fired 
+    tail = __atomic_load_n(state->cq_tail,__ATOMIC_ACQUIRE);
+    while (head != tail && numevents < eventLoop->setsize) {
+        struct io_uring_cqe *cqe = &state->cqes[head & *state->cq_mask];
+        int fd = (int)(cqe->user_data & 0xffffffff);
+        unsigned gen = (unsigned)(cqe->user_data >> 32);
+        int mask = 0;
+
+        head++;
+        /* Skip the completions of removals, and of poll requests that were
+         * cancelled or replaced in the meantime. */
+        if (cqe->user_data == AE_IOURING_REMOVE_DATA ||
+            fd >= eventLoop->setsize ||
+            state->armed[fd] == AE_NONE ||
+            state->gen[fd] != gen) continue;
+
+        if (cqe->res < 0) {
+            mask = AE_READABLE|AE_WRITABLE;
+        } else {
+            if (cqe->res & POLLIN) mask |= AE_READABLE;
+            if (cqe->res & POLLOUT) mask |= AE_WRITABLE;
+            if (cqe->res & (POLLERR|POLLHUP)) mask |= AE_READABLE|AE_WRITABLE;
+        }
+        mask &= state->armed[fd];
+
+        /* The request is one-shot: arm it again at the next call. */
+        state->armed[fd] = AE_NONE;
+        aeIoUringMarkDirty(state,fd);
+
+        if (mask) {
+            eventLoop->fired[numevents].fd = fd;
+            eventLoop->fired[numevents].mask = mask;
+            numevents++;
+        }
+    }
+    __atomic_store_n(state->cq_head,head,__ATOMIC_RELEASE);
+
+    // Ѿ¼
+    return numevents;
+}
+
+/*
+ * صǰʹõ poll 
+ */
+static char *aeApiName(void) {
+    return aeIoUringActive ? "io_uring" : aeEpollApiName();
+}
@@ -72,6 +72,9 @@ typedef struct aofrwblock {
      // ʹֽͿֽ
     unsigned long used, free;
 
+    // Ѿͨܵ͸ӽ̵ֽ
+    unsigned long sent;     /* Bytes already sent to the rewrite child. */
+
      // 
     char buf[AOF_RW_BUF_BLOCK_SIZE];
 
@@ -102,20 +105,66 @@ void aofRewriteBufferReset(void) {
 
  */
 unsigned long aofRewriteBufferSize(void) {
+    listNode *ln;
+    listIter li;
+    unsigned long size = 0;
 
-    // ȡĻ
-    listNode *ln = listLast(server.aof_rewrite_buf_blocks);
-    aofrwblock *block = ln ? ln->value : NULL;
-
-     // ûл汻ʹ
-    if (block == NULL) return 0;
+    // Ѿ͸ӽ̵ݲټ
+    listRewind(server.aof_rewrite_buf_blocks,&li);
+    while((ln = listNext(&li))) {
+        aofrwblock *block = listNodeValue(ln);
+        size += block->used - block->sent;
+    }
+    return size;
+}
 
-   // ܻС = -1 * AOF_RW_BUF_BLOCK_SIZE + һĴС
-    unsigned long size =
-        (listLength(server.aof_rewrite_buf_blocks)-1) * AOF_RW_BUF_BLOCK_SIZE;
-    size += block->used;
+/* Event handler used to send data to the child process doing the AOF
+ * rewrite. We send pieces of our AOF differences buffer so that the final
+ * write when the child finishes the rewrite will be small.
+ *
+ *  AOF деݷ͸ڽдӽ̣
+ * ӽдʱҪдĲͻС
+ *
+ * Sent data is not memmoved: every block keeps the offset of the bytes
+ * already sent, and fully sent blocks are released (or reused if it is
+ * the last one).
+ *
+ * ѷ͵ݲᱻƶÿ¼ѷݵƫ
+ * ȫ͵Ļᱻͷţһ飬ôᱻã */
+void aofChildWriteDiffData(aeEventLoop *el, int fd, void *privdata, int mask) {
+    listNode *ln;
+    aofrwblock *block;
+    ssize_t nwritten;
+    REDIS_NOTUSED(el);
+    REDIS_NOTUSED(fd);
+    REDIS_NOTUSED(privdata);
+    REDIS_NOTUSED(mask);
 
-    return size;
+    while(1) {
+        ln = listFirst(server.aof_rewrite_buf_blocks);
+        block = ln ? ln->value : NULL;
+        if (server.aof_stop_sending_diff || !block ||
+            (block->sent == block->used && ln == listLast(server.aof_rewrite_buf_blocks)))
+        {
+            aeDeleteFileEvent(server.el,server.aof_pipe_write_data_to_child,
+                              AE_WRITABLE);
+            return;
+        }
+        if (block->sent < block->used) {
+            nwritten = write(server.aof_pipe_write_data_to_child,
+                             block->buf+block->sent,block->used-block->sent);
+            if (nwritten <= 0) return;
+            block->sent += nwritten;
+        }
+        if (block->sent == block->used) {
+            if (ln == listLast(server.aof_rewrite_buf_blocks)) {
+                block->used = block->sent = 0;
+                block->free = AOF_RW_BUF_BLOCK_SIZE;
+            } else {
+                listDelNode(server.aof_rewrite_buf_blocks,ln);
+            }
+        }
+    }
 }
 
 /* Append data to the AOF rewrite buffer, allocating new blocks if needed. 
@@ -155,6 +204,7 @@ void aofRewriteBufferAppend(unsigned char *s, unsigned long len) {
             block = zmalloc(sizeof(*block));
             block->free = AOF_RW_BUF_BLOCK_SIZE;
             block->used = 0;
+            block->sent = 0;
 
              // ӵĩβ
             listAddNodeTail(server.aof_rewrite_buf_blocks,block);
@@ -173,6 +223,17 @@ void aofRewriteBufferAppend(unsigned char *s, unsigned long len) {
             }
         }
     }
+
+    /* Install a file event to send data to the rewrite child if there is
+     * not one already.
+     *
+     * ûаװӽ̷ݵ¼ôװ */
+    if (!server.aof_stop_sending_diff &&
+        aeGetFileEvents(server.el,server.aof_pipe_write_data_to_child) == 0)
+    {
+        aeCreateFileEvent(server.el, server.aof_pipe_write_data_to_child,
+            AE_WRITABLE, aofChildWriteDiffData, NULL);
+    }
 }
 
 /* Write the buffer (possibly composed of multiple blocks) into the specified
@@ -196,11 +257,12 @@ ssize_t aofRewriteBufferWrite(int fd) {
         aofrwblock *block = listNodeValue(ln);
         ssize_t nwritten;
 
-        if (block->used) {
+        // ֻд뻹ûз͸ӽ̵
+        if (block->used > block->sent) {
 
             // д뻺ݵ fd
-            nwritten = write(fd,block->buf,block->used);
-            if (nwritten != block->used) {
+            nwritten = write(fd,block->buf+block->sent,block->used-block->sent);
+            if (nwritten != (ssize_t)(block->used-block->sent)) {
                 if (nwritten == 0) errno = EIO;
                 return -1;
             }
@@ -227,6 +289,164 @@ void aof_background_fsync(int fd) {
     bioCreateBackgroundJob(REDIS_BIO_AOF_FSYNC,(void*)(long)fd,NULL,NULL);
 }
 
+/* ----------------------------------------------------------------------------
+ * AOF group commit
+ *
+ * AOF ύ
+ *
+ * With "appendfsync always" and "aof-group-commit yes" the fsync of the AOF
+ * is not performed by flushAppendOnlyFile() in the main thread: it is
+ * submitted to the REDIS_BIO_AOF_FSYNC thread, while the replies of the
+ * commands written to the AOF are held until the fsync covering them
+ * completes. The event loop keeps serving clients in the meantime, and all
+ * the writes performed while an fsync is in progress are acknowledged by
+ * the next one, so many commands are made durable by a single fsync.
+ *
+ *  appendfsync always Լ aof-group-commit ʱ
+ * flushAppendOnlyFile() ִ߳ fsync ǽ̨̣߳
+ * д AOF Ļظֱǵ fsync Ϊֹ
+ * ڴڼ¼ѭͻˣ
+ * fsync ִڼ䷢д붼һ fsync һȷϡ
+ *
+ * Writes are counted by server.aof_write_seq, and every held client
+ * remembers the write containing its last command, so it is released as
+ * soon as an fsync started after that write completes.
+ *
+ * server.aof_write_seq ¼ write ĴĿͻ˼¼һ
+ *  write ţ write ֮ʼ fsync ʱͻ˾ͱͷš
+ * ------------------------------------------------------------------------- */
+
+/* Submit the fsync of all the writes performed so far to the bio thread.
+ *
+ * ĿǰΪֹ write  fsync  bio ִ߳ */
+static void aofGroupCommitStartFsync(void) {
+    server.aof_fsync_pending_seq = server.aof_write_seq;
+    server.stat_aof_group_fsyncs++;
+    /* The non NULL arg2 asks the bio thread to call
+     * aofGroupCommitFsyncDone() after the fsync. */
+    bioCreateBackgroundJob(REDIS_BIO_AOF_FSYNC,
+        (void*)(long)server.aof_fd,(void*)1,NULL);
+}
+
+/* Called by the bio thread after a group commit fsync.
+ *
+ *  bio ߳ύ fsync ɺ */
+void aofGroupCommitFsyncDone(void) {
+    char ack = 1;
+
+    /* There is at most a single fsync in progress, so the pipe can't be
+     * full and the write can't block. */
+    while (write(server.aof_fsync_ack_pipe[1],&ack,1) == -1 &&
+           errno == EINTR);
+}
+
+/* Event handler of the ack pipe: the fsync submitted last is done.
+ *
+ * ܵĶ¼ύ fsync Ѿ */
+static void aofGroupCommitAckHandler(aeEventLoop *el, int fd, void *privdata,
+                                     int mask)
+{
+    char buf[16];
+    unsigned long long seq = server.aof_fsync_pending_seq;
+    REDIS_NOTUSED(el);
+    REDIS_NOTUSED(privdata);
+    REDIS_NOTUSED(mask);
+
+    if (read(fd,buf,sizeof(buf)) <= 0) return;
+    server.aof_fsync_pending_seq = 0;
+    aofGroupCommitRelease(seq);
+
+    /* The writes performed while the fsync was in progress are covered
+     * by the next one. */
+    // fsync ִڼ䷢д룬һ fsync ȷ
+    if (server.aof_state == REDIS_AOF_ON &&
+        server.aof_write_seq > server.aof_fsynced_seq &&
+        server.aof_fsync == AOF_FSYNC_ALWAYS && server.aof_group_commit)
+    {
+        aofGroupCommitStartFsync();
+    }
+}
+
+/* Create the pipe used by the bio thread to wake up the event loop when a
+ * group commit fsync completes.
+ *
+ *  bio ߳ύ fsync ʱ¼ѭʹõĹܵ */
+void aofGroupCommitInit(void) {
+    if (pipe(server.aof_fsync_ack_pipe) == -1 ||
+        anetNonBlock(NULL,server.aof_fsync_ack_pipe[0]) != ANET_OK ||
+        aeCreateFileEvent(server.el,server.aof_fsync_ack_pipe[0],AE_READABLE,
+                          aofGroupCommitAckHandler,NULL) == AE_ERR)
+    {
+        redisLog(REDIS_WARNING,
+            "Can't create the AOF group commit pipe: %s", strerror(errno));
+        exit(1);
+    }
+}
+
+/* Hold the reply of the client until the AOF buffer it was just written in
+ * is fsynced. Called by call() when the command was written in the buffer.
+ *
+ * ͻ˵Ļظֱд AOF  fsync Ϊֹ
+ * д뻺ʱ call() á */
+void aofGroupCommitHoldClient(redisClient *c) {
+    if (!server.aof_group_commit || server.aof_fsync != AOF_FSYNC_ALWAYS ||
+        server.aof_state != REDIS_AOF_ON) return;
+
+    /* Fake clients, replication links and monitors never wait. */
+    if (c->fd <= 0 ||
+        c->flags & (REDIS_LUA_CLIENT|REDIS_MASTER|REDIS_SLAVE|REDIS_MONITOR))
+        return;
+
+    /* The command is written by the next flushAppendOnlyFile() call. */
+    c->aof_fsync_seq = server.aof_write_seq+1;
+    if (c->flags & REDIS_AOF_FSYNC_WAIT) return;
+    c->flags |= REDIS_AOF_FSYNC_WAIT;
+    listAddNodeTail(server.aof_fsync_clients,c);
+
+    /* Take back the reply already scheduled for writing. The client was
+     * just queued for the I/O threads, so look for it from the tail. */
+    // ѾдĻظ
+    if (c->flags & REDIS_PENDING_WRITE) {
+        listIter li;
+        listNode *ln;
+
+        listRewindTail(server.clients_pending_write,&li);
+        while ((ln = listNext(&li)) && listNodeValue(ln) != c);
+        redisAssert(ln != NULL);
+        listDelNode(server.clients_pending_write,ln);
+        c->flags &= ~REDIS_PENDING_WRITE;
+    } else {
+        aeDeleteFileEvent(server.el,c->fd,AE_WRITABLE);
+    }
+}
+
+/* The AOF writes up to 'seq' are on disk (or the fsync policy does not
+ * require them to be): release the replies waiting for them.
+ *
+ * Ų seq  AOF дѾд̣ fsync ԲҪȴ
+ * ͷŵȴǵĻظ */
+void aofGroupCommitRelease(unsigned long long seq) {
+    listIter li;
+    listNode *ln;
+
+    if (seq > server.aof_fsynced_seq) server.aof_fsynced_seq = seq;
+    if (listLength(server.aof_fsync_clients) == 0) return;
+
+    listRewind(server.aof_fsync_clients,&li);
+    while ((ln = listNext(&li))) {
+        redisClient *c = listNodeValue(ln);
+
+        if (c->aof_fsync_seq > server.aof_fsynced_seq) continue;
+        c->flags &= ~REDIS_AOF_FSYNC_WAIT;
+        listDelNode(server.aof_fsync_clients,ln);
+        if ((c->bufpos || listLength(c->reply)) &&
+            clientInstallWriteHandler(c) == REDIS_ERR)
+        {
+            freeClientAsync(c);
+        }
+    }
+}
+
 /* Called when the user switches from "appendonly yes" to "appendonly no"
  * at runtime using the CONFIG command. 
  *
@@ -244,6 +464,7 @@ void stopAppendOnly(void) {
 
    // ϴ AOF ļ
     aof_fsync(server.aof_fd);
+    aofGroupCommitRelease(server.aof_write_seq);
 
     // ر AOF ļ
     close(server.aof_fd);
@@ -274,6 +495,8 @@ void stopAppendOnly(void) {
         aofRemoveTempFile(server.aof_child_pid);
         server.aof_child_pid = -1;
         server.aof_rewrite_time_start = -1;
+        /* Close pipes used for IPC between the two processes. */
+        aofClosePipes();
     }
 }
 
@@ -523,6 +746,7 @@ void flushAppendOnlyFile(int force) {
 
     // д AOF ļС
     server.aof_current_size += nwritten;
+    server.aof_write_seq++;
 
     /* Re-use AOF buffer when it is small enough. The maximum comes from the
      * arena size of 4k minus some overhead (but is otherwise arbitrary). 
@@ -548,18 +772,28 @@ void flushAppendOnlyFile(int force) {
      */
     if (server.aof_no_fsync_on_rewrite &&
         (server.aof_child_pid != -1 || server.rdb_child_pid != -1))
-            return;
+    {
+        aofGroupCommitRelease(server.aof_write_seq);
+        return;
+    }
 
     /* Perform the fsync if needed. */
 
-    // ִ fsnyc
-    if (server.aof_fsync == AOF_FSYNC_ALWAYS) {
+    // ִ fsnyc ύʱɺִ̨߳
+    if (server.aof_fsync == AOF_FSYNC_ALWAYS && server.aof_group_commit) {
+        /* If an fsync is already in progress this write is covered by the
+         * next one, started as soon as it completes. */
+        // Ѿ fsync ִʱɺʼһ fsync ȷд
+        if (server.aof_fsync_pending_seq == 0) aofGroupCommitStartFsync();
+        server.aof_last_fsync = server.unixtime;
+    } else if (server.aof_fsync == AOF_FSYNC_ALWAYS) {
         /* aof_fsync is defined as fdatasync() for Linux in order to avoid
          * flushing metadata. */
         aof_fsync(server.aof_fd); /* Let's try to get this data on the disk */
 
          // һִ fsnyc ʱ
         server.aof_last_fsync = server.unixtime;
+        aofGroupCommitRelease(server.aof_write_seq);
 
      // Ϊÿ fsnyc Ҿϴ fsync Ѿ 1 
     } else if ((server.aof_fsync == AOF_FSYNC_EVERYSEC &&
@@ -570,6 +804,12 @@ void flushAppendOnlyFile(int force) {
         server.aof_last_fsync = server.unixtime;
     }
 
+    /* Replies held by the group commit before switching to a policy that
+     * does not wait for the fsync are released now that they are written. */
+    // лȴ fsync Ĳ֮ǰĻظд֮ͷ
+    if (server.aof_fsync != AOF_FSYNC_ALWAYS)
+        aofGroupCommitRelease(server.aof_write_seq);
+
      // ʵִ if ֻ else ֶҪ fsync ʱ    
      // ԽŲ   
      // server.aof_last_fsync = server.unixtime;
@@ -782,8 +1022,11 @@ struct redisClient *createFakeClient(void) {
     c->name = NULL;
     c->querybuf = sdsempty();
     c->querybuf_peak = 0;
+    c->qb_pos = 0;
     c->argc = 0;
     c->argv = NULL;
+    c->argv_len = 0;
+    memset(c->argv_cache,0,sizeof(c->argv_cache));
     c->bufpos = 0;
     c->flags = 0;
     c->btype = REDIS_BLOCKED_NONE;
@@ -1041,9 +1284,9 @@ int rioWriteBulkObject(rio *r, robj *obj) {
 int rewriteListObject(rio *r, robj *key, robj *o) {
     long long count = 0, items = listTypeLength(o);
 
-    if (o->encoding == REDIS_ENCODING_ZIPLIST) {
+    if (o->encoding == REDIS_ENCODING_LISTPACK) {
         unsigned char *zl = o->ptr;
-        unsigned char *p = ziplistIndex(zl,0);
+        unsigned char *p = lpFirst(zl);
         unsigned char *vstr;
         unsigned int vlen;
         long long vlong;
@@ -1051,7 +1294,7 @@ int rewriteListObject(rio *r, robj *key, robj *o) {
         // ȹһ RPUSH key         
         // Ȼ ZIPLIST ȡ REDIS_AOF_REWRITE_ITEMS_PER_CMD Ԫ        
         // ֮ظһֱ ZIPLIST Ϊ
-        while(ziplistGet(p,&vstr,&vlen,&vlong)) {
+        while(lpGet(p,&vstr,&vlen,&vlong)) {
             if (count == 0) {
                 int cmd_items = (items > REDIS_AOF_REWRITE_ITEMS_PER_CMD) ?
                     REDIS_AOF_REWRITE_ITEMS_PER_CMD : items;
@@ -1067,39 +1310,46 @@ int rewriteListObject(rio *r, robj *key, robj *o) {
                 if (rioWriteBulkLongLong(r,vlong) == 0) return 0;
             }
              // ƶָ룬㱻ȡԪص
-            p = ziplistNext(zl,p);
+            p = lpNext(zl,p);
             if (++count == REDIS_AOF_REWRITE_ITEMS_PER_CMD) count = 0;
             items--;
         }
-    } else if (o->encoding == REDIS_ENCODING_LINKEDLIST) {
-        list *list = o->ptr;
-        listNode *ln;
-        listIter li;
+    } else if (o->encoding == REDIS_ENCODING_QUICKLIST) {
+        quicklistIter *qi = quicklistGetIterator(o->ptr,AL_START_HEAD);
+        quicklistEntry entry;
 
          // ȹһ RPUSH key         
-         // Ȼ˫ȡ REDIS_AOF_REWRITE_ITEMS_PER_CMD Ԫ        
-         // ֮ظһֱΪ
-        listRewind(list,&li);
-        while((ln = listNext(&li))) {
-            robj *eleobj = listNodeValue(ln);
-
+         // Ȼ quicklist ȡ REDIS_AOF_REWRITE_ITEMS_PER_CMD Ԫ        
+         // ֮ظһֱ quicklist Ϊ
+        while(quicklistNext(qi,&entry)) {
             if (count == 0) {
                 int cmd_items = (items > REDIS_AOF_REWRITE_ITEMS_PER_CMD) ?
                     REDIS_AOF_REWRITE_ITEMS_PER_CMD : items;
 
-                if (rioWriteBulkCount(r,'*',2+cmd_items) == 0) return 0;
-                if (rioWriteBulkString(r,"RPUSH",5) == 0) return 0;
-                if (rioWriteBulkObject(r,key) == 0) return 0;
+                if (rioWriteBulkCount(r,'*',2+cmd_items) == 0) goto werr;
+                if (rioWriteBulkString(r,"RPUSH",5) == 0) goto werr;
+                if (rioWriteBulkObject(r,key) == 0) goto werr;
             }
 
             // ȡֵ
-            if (rioWriteBulkObject(r,eleobj) == 0) return 0;
+            if (entry.value) {
+                if (rioWriteBulkString(r,(char*)entry.value,entry.sz) == 0)
+                    goto werr;
+            } else {
+                if (rioWriteBulkLongLong(r,entry.longval) == 0) goto werr;
+            }
 
             // Ԫؼ
             if (++count == REDIS_AOF_REWRITE_ITEMS_PER_CMD) count = 0;
 
             items--;
         }
+        quicklistReleaseIterator(qi);
+        return 1;
+
+werr:
+        quicklistReleaseIterator(qi);
+        return 0;
     } else {
         redisPanic("Unknown list encoding");
     }
@@ -1170,7 +1420,7 @@ int rewriteSetObject(rio *r, robj *key, robj *o) {
 int rewriteSortedSetObject(rio *r, robj *key, robj *o) {
     long long count = 0, items = zsetLength(o);
 
-    if (o->encoding == REDIS_ENCODING_ZIPLIST) {
+    if (o->encoding == REDIS_ENCODING_LISTPACK) {
         unsigned char *zl = o->ptr;
         unsigned char *eptr, *sptr;
         unsigned char *vstr;
@@ -1178,13 +1428,13 @@ int rewriteSortedSetObject(rio *r, robj *key, robj *o) {
         long long vll;
         double score;
 
-        eptr = ziplistIndex(zl,0);
+        eptr = lpFirst(zl);
         redisAssert(eptr != NULL);
-        sptr = ziplistNext(zl,eptr);
+        sptr = lpNext(zl,eptr);
         redisAssert(sptr != NULL);
 
         while (eptr != NULL) {
-            redisAssert(ziplistGet(eptr,&vstr,&vlen,&vll));
+            redisAssert(lpGet(eptr,&vstr,&vlen,&vll));
             score = zzlGetScore(sptr);
 
             if (count == 0) {
@@ -1205,14 +1455,15 @@ int rewriteSortedSetObject(rio *r, robj *key, robj *o) {
             if (++count == REDIS_AOF_REWRITE_ITEMS_PER_CMD) count = 0;
             items--;
         }
-    } else if (o->encoding == REDIS_ENCODING_SKIPLIST) {
+    } else if (o->encoding == REDIS_ENCODING_SKIPLIST ||
+               o->encoding == REDIS_ENCODING_BTREE) {
         zset *zs = o->ptr;
         dictIterator *di = dictGetIterator(zs->dict);
         dictEntry *de;
 
         while((de = dictNext(di)) != NULL) {
             robj *eleobj = dictGetKey(de);
-            double *score = dictGetVal(de);
+            double score = dictGetDoubleVal(de);
 
             if (count == 0) {
                 int cmd_items = (items > REDIS_AOF_REWRITE_ITEMS_PER_CMD) ?
@@ -1222,7 +1473,7 @@ int rewriteSortedSetObject(rio *r, robj *key, robj *o) {
                 if (rioWriteBulkString(r,"ZADD",4) == 0) return 0;
                 if (rioWriteBulkObject(r,key) == 0) return 0;
             }
-            if (rioWriteBulkDouble(r,*score) == 0) return 0;
+            if (rioWriteBulkDouble(r,score) == 0) return 0;
             if (rioWriteBulkObject(r,eleobj) == 0) return 0;
             if (++count == REDIS_AOF_REWRITE_ITEMS_PER_CMD) count = 0;
             items--;
@@ -1257,12 +1508,12 @@ int rewriteSortedSetObject(rio *r, robj *key, robj *o) {
  */
 static int rioWriteHashIteratorCursor(rio *r, hashTypeIterator *hi, int what) {
 
-    if (hi->encoding == REDIS_ENCODING_ZIPLIST) {
+    if (hi->encoding == REDIS_ENCODING_LISTPACK) {
         unsigned char *vstr = NULL;
         unsigned int vlen = UINT_MAX;
         long long vll = LLONG_MAX;
 
-        hashTypeCurrentFromZiplist(hi, what, &vstr, &vlen, &vll);
+        hashTypeCurrentFromListpack(hi, what, &vstr, &vlen, &vll);
         if (vstr) {
             return rioWriteBulkString(r, (char*)vstr, vlen);
         } else {
@@ -1328,6 +1579,24 @@ int rewriteHashObject(rio *r, robj *key, robj *o) {
  * Redis ᾡܵʹýܿɱ RPUSH SADD  ZADD ȡ *
  * ÿδԪܳ REDIS_AOF_REWRITE_ITEMS_PER_CMD 
  */
+/* This function is called by the child rewriting the AOF file to read
+ * the difference accumulated from the parent into a buffer, that is
+ * concatenated at the end of the rewrite.
+ *
+ * ɽ AOF дӽ̵ã̷͹Ĳ뵽У
+ * д׷ӵ AOF ļĩβ */
+ssize_t aofReadDiffFromParent(void) {
+    char buf[65536]; /* Default pipe buffer size on most Linux systems. */
+    ssize_t nread, total = 0;
+
+    while ((nread =
+            read(server.aof_pipe_read_data_from_parent,buf,sizeof(buf))) > 0) {
+        server.aof_child_diff = sdscatlen(server.aof_child_diff,buf,nread);
+        total += nread;
+    }
+    return total;
+}
+
 int rewriteAppendOnlyFile(char *filename) {
     dictIterator *di = NULL;
     dictEntry *de;
@@ -1336,6 +1605,8 @@ int rewriteAppendOnlyFile(char *filename) {
     char tmpfile[256];
     int j;
     long long now = mstime();
+    char byte;
+    size_t processed = 0;
 
     /* Note that we have to use a different temp name here compared to the
      * one used by rewriteAppendOnlyFileBackground() function. 
@@ -1352,6 +1623,7 @@ int rewriteAppendOnlyFile(char *filename) {
 
     // ʼļ io
     rioInitWithFile(&aof,fp);
+    server.aof_child_diff = sdsempty();
 
     // ÿд REDIS_AOF_AUTOSYNC_BYTES ֽ    
     // ִһ FSYNC     
@@ -1444,12 +1716,77 @@ int rewriteAppendOnlyFile(char *filename) {
                 if (rioWriteBulkObject(&aof,&key) == 0) goto werr;
                 if (rioWriteBulkLongLong(&aof,expiretime) == 0) goto werr;
             }
+
+            /* Read some diff from the parent in order to accumulate it
+             * while we write the dataset, so that the parent buffer (and
+             * the final write it performs) stays small.
+             *
+             * ÿд 10 KB ҵݣͶһθ̷͵Ĳ */
+            if (aof.processed_bytes > processed+1024*10) {
+                processed = aof.processed_bytes;
+                aofReadDiffFromParent();
+            }
         }
 
        // ͷŵ
         dictReleaseIterator(di);
     }
 
+    /* Do an initial slow fsync here while the parent is still sending
+     * data, in order to make the next final fsync faster.
+     *
+     * ڸڷʱִһν fsync  fsync  */
+    if (fflush(fp) == EOF) goto werr;
+    if (aof_fsync(fileno(fp)) == -1) goto werr;
+
+    /* Read again a few times to get more data from the parent.
+     * We can't read forever (the server may receive data from clients
+     * faster than it is able to send data to the child), so we try to read
+     * some more data in a loop as soon as there is a good chance more data
+     * will come. If it looks like we are wasting time, we abort (this
+     * happens after 20 ms without new data).
+     *
+     * ٴӸ̶ȡݡΪտͻݵٶȿܱȷ͸
+     * ӽ̵ٶȸ죬Բһֱȥȡ 1 룬
+     *  20 붼ûݣôֹͣȡ */
+    int nodata = 0;
+    mstime_t start = mstime();
+    while(mstime()-start < 1000 && nodata < 20) {
+        if (aeWait(server.aof_pipe_read_data_from_parent, AE_READABLE, 1) <= 0)
+        {
+            nodata++;
+            continue;
+        }
+        nodata = 0; /* Start counting from zero, we stop on N *contiguous*
+                       timeouts. */
+        aofReadDiffFromParent();
+    }
+
+    /* Ask the master to stop sending diffs.
+     *
+     * Ҫ󸸽ֹͣͲ죬ȴ̵ȷ */
+    if (write(server.aof_pipe_write_ack_to_parent,"!",1) != 1) goto werr;
+    if (anetNonBlock(NULL,server.aof_pipe_read_ack_from_parent) != ANET_OK)
+        goto werr;
+    /* We read the ACK from the server using a 10 seconds timeout. Normally
+     * it should reply ASAP, but just in case we lose its reply, we are sure
+     * the child will eventually get terminated. */
+    if (syncRead(server.aof_pipe_read_ack_from_parent,&byte,1,5000) != 1 ||
+        byte != '!') goto werr;
+    redisLog(REDIS_NOTICE,"Parent agreed to stop sending diffs. Finalizing AOF...");
+
+    /* Read the final diff if any.
+     *
+     * Ĳ죬д뵽 AOF ļ */
+    aofReadDiffFromParent();
+
+    /* Write the received diff to the file. */
+    redisLog(REDIS_NOTICE,
+        "Concatenating %.2f MB of AOF diff received from parent.",
+        (double) sdslen(server.aof_child_diff) / (1024*1024));
+    if (rioWrite(&aof,server.aof_child_diff,sdslen(server.aof_child_diff)) == 0)
+        goto werr;
+
     /* Make sure data will not remain on the OS's output buffers */
     // ϴر AOF ļ
     if (fflush(fp) == EOF) goto werr;
@@ -1479,6 +1816,97 @@ werr:
     return REDIS_ERR;
 }
 
+/* ----------------------------------------------------------------------------
+ * AOF rewrite pipes for IPC
+ * -------------------------------------------------------------------------- */
+
+/* This event handler is called when the AOF rewriting child sends us a
+ * single '!' char to signal we should stop sending buffer diffs. The
+ * parent sends a '!' as well to acknowledge.
+ *
+ * ӽ̷һ '!' ַҪ󸸽ֹͣͲʱ
+ * ͬһ '!' Ϊȷϡ */
+void aofChildPipeReadable(aeEventLoop *el, int fd, void *privdata, int mask) {
+    char byte;
+    REDIS_NOTUSED(el);
+    REDIS_NOTUSED(privdata);
+    REDIS_NOTUSED(mask);
+
+    if (read(fd,&byte,1) == 1 && byte == '!') {
+        redisLog(REDIS_NOTICE,"AOF rewrite child asks to stop sending diffs.");
+        server.aof_stop_sending_diff = 1;
+        if (write(server.aof_pipe_write_ack_to_child,"!",1) != 1) {
+            /* If we can't send the ack, inform the user, but don't try again
+             * since in the other side the children will use a timeout if the
+             * kernel can't buffer our write, or, the children was
+             * terminated. */
+            redisLog(REDIS_WARNING,"Can't send ACK to AOF child: %s",
+                strerror(errno));
+        }
+    }
+    /* Remove the handler since this can be called only one time during a
+     * rewrite. */
+    aeDeleteFileEvent(server.el,server.aof_pipe_read_ack_from_child,AE_READABLE);
+}
+
+/* Create the pipes used for parent - child process IPC during rewrite.
+ * We have a data pipe used to send AOF incremental diffs to the child,
+ * and two other pipes used by the children to signal it finished with
+ * the rewrite so no more data should be written, and another for the
+ * parent to acknowledge it understood this new condition.
+ *
+ * дڼ丸ӽͨʹõĹܵ
+ * һݹܵӽ̷ AOF 죬
+ * ܵӽֹ֪ͨͣݣԼȷϡ */
+int aofCreatePipes(void) {
+    int fds[6] = {-1, -1, -1, -1, -1, -1};
+    int j;
+
+    if (pipe(fds) == -1) goto error; /* parent -> children data. */
+    if (pipe(fds+2) == -1) goto error; /* children -> parent ack. */
+    if (pipe(fds+4) == -1) goto error; /* parent -> children ack. */
+    /* Parent -> children data is non blocking. */
+    if (anetNonBlock(NULL,fds[0]) != ANET_OK) goto error;
+    if (anetNonBlock(NULL,fds[1]) != ANET_OK) goto error;
+    if (aeCreateFileEvent(server.el, fds[2], AE_READABLE, aofChildPipeReadable, NULL) == AE_ERR) goto error;
+
+    server.aof_pipe_write_data_to_child = fds[1];
+    server.aof_pipe_read_data_from_parent = fds[0];
+    server.aof_pipe_write_ack_to_parent = fds[3];
+    server.aof_pipe_read_ack_from_child = fds[2];
+    server.aof_pipe_write_ack_to_child = fds[5];
+    server.aof_pipe_read_ack_from_parent = fds[4];
+    server.aof_stop_sending_diff = 0;
+    return REDIS_OK;
+
+error:
+    redisLog(REDIS_WARNING,"Error opening /setting AOF rewrite IPC pipes: %s",
+        strerror(errno));
+    for (j = 0; j < 6; j++) if(fds[j] != -1) close(fds[j]);
+    return REDIS_ERR;
+}
+
+/* Close the pipes created by aofCreatePipes(), if any.
+ *
+ * ر aofCreatePipes() Ĺܵ */
+void aofClosePipes(void) {
+    if (server.aof_pipe_write_data_to_child == -1) return;
+    aeDeleteFileEvent(server.el,server.aof_pipe_read_ack_from_child,AE_READABLE);
+    aeDeleteFileEvent(server.el,server.aof_pipe_write_data_to_child,AE_WRITABLE);
+    close(server.aof_pipe_write_data_to_child);
+    close(server.aof_pipe_read_data_from_parent);
+    close(server.aof_pipe_write_ack_to_parent);
+    close(server.aof_pipe_read_ack_from_child);
+    close(server.aof_pipe_write_ack_to_child);
+    close(server.aof_pipe_read_ack_from_parent);
+    server.aof_pipe_write_data_to_child = -1;
+    server.aof_pipe_read_data_from_parent = -1;
+    server.aof_pipe_write_ack_to_parent = -1;
+    server.aof_pipe_read_ack_from_child = -1;
+    server.aof_pipe_write_ack_to_child = -1;
+    server.aof_pipe_read_ack_from_parent = -1;
+}
+
 /* This is how rewriting of the append only file in background works:
  * 
  * 以下是后台重写 AOF 文件（BGREWRITEAOF）的工作步骤：
@@ -1513,6 +1941,9 @@ int rewriteAppendOnlyFileBackground(void) {
     // Ѿнڽ AOF д
     if (server.aof_child_pid != -1) return REDIS_ERR;
 
+    // ӽ̷ͲʹõĹܵ
+    if (aofCreatePipes() != REDIS_OK) return REDIS_ERR;
+
     // ¼ fork ʼǰʱ䣬 fork ʱ
     start = ustime();
 
@@ -1552,6 +1983,7 @@ int rewriteAppendOnlyFileBackground(void) {
             redisLog(REDIS_WARNING,
                 "Can't rewrite append only file in background: fork: %s",
                 strerror(errno));
+            aofClosePipes();
             return REDIS_ERR;
         }
 
@@ -1673,6 +2105,7 @@ void backgroundRewriteDoneHandler(int exitcode, int bysignal) {
             goto cleanup;
         }
 
+        server.aof_last_rewrite_diff_bytes = aofRewriteBufferSize();
         redisLog(REDIS_NOTICE,
             "Parent diff successfully flushed to the rewritten AOF (%lu bytes)", aofRewriteBufferSize());
 
@@ -1774,6 +2207,12 @@ void backgroundRewriteDoneHandler(int exitcode, int bysignal) {
             else if (server.aof_fsync == AOF_FSYNC_EVERYSEC)
                 aof_background_fsync(newfd);
 
+            /* The AOF buffer, cleared below, is in the new file as well:
+             * count it as written and release the replies held for it. */
+            // 汻յ AOF ҲѾдļͷŵȴĻظ
+            server.aof_write_seq++;
+            aofGroupCommitRelease(server.aof_write_seq);
+
              // ǿ SELECT
             server.aof_selected_db = -1; /* Make sure SELECT is re-issued */
 
@@ -1809,8 +2248,10 @@ void backgroundRewriteDoneHandler(int exitcode, int bysignal) {
          */
         if (oldfd != -1) bioCreateBackgroundJob(REDIS_BIO_CLOSE_FILE,(void*)(long)oldfd,NULL,NULL);
 
+        server.aof_last_rewrite_done_us = ustime()-now;
         redisLog(REDIS_VERBOSE,
-            "Background AOF rewrite signal handler took %lldus", ustime()-now);
+            "Background AOF rewrite signal handler took %lldus",
+            server.aof_last_rewrite_done_us);
 
      // BGREWRITEAOF д
     } else if (!bysignal && exitcode != 0) {
@@ -1829,6 +2270,9 @@ void backgroundRewriteDoneHandler(int exitcode, int bysignal) {
 
 cleanup:
 
+    // رӽͨŵĹܵ
+    aofClosePipes();
+
     //  AOF 
     aofRewriteBufferReset();
 
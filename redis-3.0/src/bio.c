@@ -250,6 +250,13 @@ void *bioProcessBackgroundJobs(void *arg) {
 
         } else if (type == REDIS_BIO_AOF_FSYNC) {
             aof_fsync((long)job->arg1);
+            /* A non NULL arg2 asks to notify the main thread, used by the
+             * AOF group commit to release the replies held for the fsync. */
+            // arg2 Ϊ NULL ʱ֪̣ͨ߳AOF ύݴͷűĻظ
+            if (job->arg2) aofGroupCommitFsyncDone();
+
+        } else if (type == REDIS_BIO_DICT_ALLOC) {
+            dictBackgroundAlloc(job->arg1);
 
         } else {
             redisPanic("Wrong job type in bioProcessBackgroundJobs().");
@@ -57,12 +57,43 @@ static int getBitOffsetFromArgument(redisClient *c, robj *o, size_t *offset) {
     return REDIS_OK;
 }
 
+/* Bitmap kernels:
+ *
+ * BITCOUNT, BITPOS and BITOP spend nearly all their time in three loops
+ * over the bitmap: counting the set bits, skipping the leading words that
+ * are all zeros (or all ones), and combining the source bitmaps. Each loop
+ * has a portable scalar kernel and, on x86-64, faster kernels using the
+ * POPCNT instruction and AVX2. The best kernels the CPU supports are
+ * selected by bitopsInitKernels() at startup, until then (and on other
+ * platforms) the scalar ones are used.
+ *
+ * λͼںˣ
+ *
+ * BITCOUNT  BITPOS  BITOP еʱ䶼ѭϣ
+ * 㱻õλͷȫΪ 0 ȫΪ 1֣
+ * Լλͼλ㡣
+ *
+ * ÿѭһֲıںˣ
+ *  x86-64 ϻʹ POPCNT ָ AVX2 ĸںˡ
+ * ʱ bitopsInitKernels() ѡ CPU ֵ֧ںˣ
+ * ڴ֮ǰԼƽ̨ϣʹñںˡ
+ */
+#define BITOP_AND   0
+#define BITOP_OR    1
+#define BITOP_XOR   2
+#define BITOP_NOT   3
+
+typedef size_t bitopsPopcountFunc(unsigned char *p, long count);
+typedef long bitopsSkipFunc(unsigned char *p, long count, int bit);
+typedef long bitopsOpFunc(int op, unsigned char *res, unsigned char **src,
+                          long numkeys, long len);
+
 /* Count number of bits set in the binary array pointed by 's' and long
  * 'count' bytes. The implementation of this function is required to
  * work with a input string length up to 512 MB. */
 // 㳤Ϊ count Ķָ s Ϊ 1 λ
 // ֻΪ 512 MB ַʹ
-size_t redisPopcount(void *s, long count) {
+static size_t redisPopcountScalar(unsigned char *s, long count) {
     size_t bits = 0;
     unsigned char *p = s;
     uint32_t *p4;
@@ -114,6 +145,275 @@ size_t redisPopcount(void *s, long count) {
     return bits;
 }
 
+/* Skip the leading full words of the 'count' bytes at 'p' that are all
+ * zeros (if 'bit' is 1) or all ones (if 'bit' is 0), returning the number
+ * of bytes skipped. 'p' must be aligned to sizeof(unsigned long). */
+//  p ͷȫΪ 0  bit Ϊ 1 ʱȫΪ 1  bit Ϊ 0 ʱ֣
+// رֽ p 뵽 sizeof(unsigned long)
+static long bitopsSkipScalar(unsigned char *p, long count, int bit) {
+    unsigned long *l = (unsigned long*) p;
+    unsigned long skipval = bit ? 0 : ULONG_MAX;
+    long skipped = 0;
+
+    while (count >= sizeof(*l)) {
+        if (*l != skipval) break;
+        l++;
+        count -= sizeof(*l);
+        skipped += sizeof(*l);
+    }
+    return skipped;
+}
+
+/* Compute the first 'len' bytes of the result of the bit operation 'op'
+ * between the 'numkeys' (at most 16) source strings into 'res', processing
+ * full words of the sources. Returns the number of bytes computed, the
+ * caller processes the remaining ones byte by byte. */
+// Ϊλ numkeys  16 ַǰ len ִֽλ op 
+// 浽 res Ѿֽʣµֽɵ
+static long bitopsOpScalar(int op, unsigned char *res, unsigned char **src,
+                           long numkeys, long len)
+{
+    unsigned long *lp[16];
+    unsigned long *lres = (unsigned long*) res;
+    long i, j = 0;
+
+    /* Note: sds pointer is always aligned to 8 byte boundary. */
+    memcpy(lp,src,sizeof(unsigned long*)*numkeys);
+    memcpy(res,src[0],len);
+
+    /* Different branches per different operations for speed (sorry). */
+    // Ҫλڵ 32 λʱ
+    // ÿ 4*8 = 32 λȻЩλм㣬û棬м
+    if (op == BITOP_AND) {
+        while(len >= sizeof(unsigned long)*4) {
+            for (i = 1; i < numkeys; i++) {
+                lres[0] &= lp[i][0];
+                lres[1] &= lp[i][1];
+                lres[2] &= lp[i][2];
+                lres[3] &= lp[i][3];
+                lp[i]+=4;
+            }
+            lres+=4;
+            j += sizeof(unsigned long)*4;
+            len -= sizeof(unsigned long)*4;
+        }
+    } else if (op == BITOP_OR) {
+        while(len >= sizeof(unsigned long)*4) {
+            for (i = 1; i < numkeys; i++) {
+                lres[0] |= lp[i][0];
+                lres[1] |= lp[i][1];
+                lres[2] |= lp[i][2];
+                lres[3] |= lp[i][3];
+                lp[i]+=4;
+            }
+            lres+=4;
+            j += sizeof(unsigned long)*4;
+            len -= sizeof(unsigned long)*4;
+        }
+    } else if (op == BITOP_XOR) {
+        while(len >= sizeof(unsigned long)*4) {
+            for (i = 1; i < numkeys; i++) {
+                lres[0] ^= lp[i][0];
+                lres[1] ^= lp[i][1];
+                lres[2] ^= lp[i][2];
+                lres[3] ^= lp[i][3];
+                lp[i]+=4;
+            }
+            lres+=4;
+            j += sizeof(unsigned long)*4;
+            len -= sizeof(unsigned long)*4;
+        }
+    } else if (op == BITOP_NOT) {
+        while(len >= sizeof(unsigned long)*4) {
+            lres[0] = ~lres[0];
+            lres[1] = ~lres[1];
+            lres[2] = ~lres[2];
+            lres[3] = ~lres[3];
+            lres+=4;
+            j += sizeof(unsigned long)*4;
+            len -= sizeof(unsigned long)*4;
+        }
+    }
+    return j;
+}
+
+#ifdef HAVE_X86_SIMD
+#include <immintrin.h>
+
+/* Loads that do not assume any alignment of the strings. */
+static inline uint64_t bitopsLoad64(const unsigned char *p) {
+    uint64_t v;
+    memcpy(&v,p,sizeof(v));
+    return v;
+}
+
+__attribute__((target("popcnt")))
+static size_t redisPopcountPOPCNT(unsigned char *p, long count) {
+    uint64_t a = 0, b = 0, c = 0, d = 0;
+
+    /* Four counters so that the POPCNT instructions are independent. */
+    // ʹĸø POPCNT ָ
+    while(count >= 32) {
+        a += __builtin_popcountll(bitopsLoad64(p));
+        b += __builtin_popcountll(bitopsLoad64(p+8));
+        c += __builtin_popcountll(bitopsLoad64(p+16));
+        d += __builtin_popcountll(bitopsLoad64(p+24));
+        p += 32;
+        count -= 32;
+    }
+    while(count >= 8) {
+        a += __builtin_popcountll(bitopsLoad64(p));
+        p += 8;
+        count -= 8;
+    }
+    while(count--) a += __builtin_popcount(*p++);
+    return a+b+c+d;
+}
+
+/* The bits of every byte are counted looking up its two nibbles in a 16
+ * entries table with VPSHUFB. The byte counts of four vectors (at most 32
+ * per byte) are summed, then added into four 64 bit counters with VPSADBW.
+ *
+ * ÿֽڵλ VPSHUFB һ 16 ıвֽڵó
+ * ĸֽڼÿֽΪ 32֮
+ *  VPSADBW ۼӵĸ 64 λС */
+__attribute__((target("avx2,popcnt")))
+static size_t redisPopcountAVX2(unsigned char *p, long count) {
+    const __m256i table = _mm256_setr_epi8(0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4,
+                                           0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4);
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    __m256i acc = _mm256_setzero_si256(), sum, x;
+    uint64_t lanes[4];
+    int k;
+
+    while(count >= 128) {
+        sum = _mm256_setzero_si256();
+        for (k = 0; k < 4; k++) {
+            x = _mm256_loadu_si256((const __m256i*)(p+k*32));
+            sum = _mm256_add_epi8(sum,_mm256_shuffle_epi8(table,
+                    _mm256_and_si256(x,nibble)));
+            sum = _mm256_add_epi8(sum,_mm256_shuffle_epi8(table,
+                    _mm256_and_si256(_mm256_srli_epi16(x,4),nibble)));
+        }
+        acc = _mm256_add_epi64(acc,
+                _mm256_sad_epu8(sum,_mm256_setzero_si256()));
+        p += 128;
+        count -= 128;
+    }
+    _mm256_storeu_si256((__m256i*)lanes,acc);
+    return lanes[0]+lanes[1]+lanes[2]+lanes[3]+
+           redisPopcountPOPCNT(p,count);
+}
+
+/* Skip 128 bytes at a time while they are all zeros or all ones, then 32
+ * bytes at a time, leaving the rest to the scalar kernel. */
+// ÿ 128 ֽڣȻÿ 32 ֽڣʣµĽں
+__attribute__((target("avx2")))
+static long bitopsSkipAVX2(unsigned char *p, long count, int bit) {
+    const __m256i ones = _mm256_set1_epi8(-1);
+    __m256i x;
+    long j = 0;
+
+    for (; j+128 <= count; j += 128) {
+        const __m256i *v = (const __m256i*)(p+j);
+        if (bit) {
+            x = _mm256_or_si256(
+                _mm256_or_si256(_mm256_loadu_si256(v),
+                                _mm256_loadu_si256(v+1)),
+                _mm256_or_si256(_mm256_loadu_si256(v+2),
+                                _mm256_loadu_si256(v+3)));
+            if (!_mm256_testz_si256(x,x)) break;
+        } else {
+            x = _mm256_and_si256(
+                _mm256_and_si256(_mm256_loadu_si256(v),
+                                 _mm256_loadu_si256(v+1)),
+                _mm256_and_si256(_mm256_loadu_si256(v+2),
+                                 _mm256_loadu_si256(v+3)));
+            if (!_mm256_testc_si256(x,ones)) break;
+        }
+    }
+    for (; j+32 <= count; j += 32) {
+        x = _mm256_loadu_si256((const __m256i*)(p+j));
+        if (bit ? !_mm256_testz_si256(x,x) : !_mm256_testc_si256(x,ones))
+            break;
+    }
+    return j + bitopsSkipScalar(p+j,count-j,bit);
+}
+
+/* Same as bitopsOpScalar(), processing 128 bytes of every source at a
+ * time. The operation is applied while loading the sources, so there is
+ * no initial copy of the first source into 'res'. */
+//  bitopsOpScalar() һÿδÿ 128 ֽڣ
+// λͬʱУԲҪȰѵһ븴Ƶ res
+__attribute__((target("avx2")))
+static long bitopsOpAVX2(int op, unsigned char *res, unsigned char **src,
+                         long numkeys, long len)
+{
+    const __m256i ones = _mm256_set1_epi8(-1);
+    __m256i x0, x1, x2, x3, *r;
+    const __m256i *v;
+    long i, j;
+
+#define BITOP_AVX2_APPLY(instr) do { \
+    x0 = instr(x0,_mm256_loadu_si256(v)); \
+    x1 = instr(x1,_mm256_loadu_si256(v+1)); \
+    x2 = instr(x2,_mm256_loadu_si256(v+2)); \
+    x3 = instr(x3,_mm256_loadu_si256(v+3)); \
+} while(0)
+
+    for (j = 0; j+128 <= len; j += 128) {
+        v = (const __m256i*)(src[0]+j);
+        x0 = _mm256_loadu_si256(v);
+        x1 = _mm256_loadu_si256(v+1);
+        x2 = _mm256_loadu_si256(v+2);
+        x3 = _mm256_loadu_si256(v+3);
+        if (op == BITOP_NOT) {
+            x0 = _mm256_xor_si256(x0,ones);
+            x1 = _mm256_xor_si256(x1,ones);
+            x2 = _mm256_xor_si256(x2,ones);
+            x3 = _mm256_xor_si256(x3,ones);
+        }
+        for (i = 1; i < numkeys; i++) {
+            v = (const __m256i*)(src[i]+j);
+            if (op == BITOP_AND) BITOP_AVX2_APPLY(_mm256_and_si256);
+            else if (op == BITOP_OR) BITOP_AVX2_APPLY(_mm256_or_si256);
+            else BITOP_AVX2_APPLY(_mm256_xor_si256);
+        }
+        r = (__m256i*)(res+j);
+        _mm256_storeu_si256(r,x0);
+        _mm256_storeu_si256(r+1,x1);
+        _mm256_storeu_si256(r+2,x2);
+        _mm256_storeu_si256(r+3,x3);
+    }
+#undef BITOP_AVX2_APPLY
+    return j;
+}
+#endif
+
+static bitopsPopcountFunc *bitopsPopcount = redisPopcountScalar;
+static bitopsSkipFunc *bitopsSkip = bitopsSkipScalar;
+static bitopsOpFunc *bitopsOp = bitopsOpScalar;
+
+/* Select the fastest kernels the CPU supports.
+ *
+ * ѡ CPU ֵ֧ںˡ */
+void bitopsInitKernels(void) {
+#ifdef HAVE_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+        bitopsPopcount = redisPopcountAVX2;
+        bitopsSkip = bitopsSkipAVX2;
+        bitopsOp = bitopsOpAVX2;
+    } else if (__builtin_cpu_supports("popcnt")) {
+        bitopsPopcount = redisPopcountPOPCNT;
+    }
+#endif
+}
+
+size_t redisPopcount(void *s, long count) {
+    return bitopsPopcount(s,count);
+}
+
 /* Return the position of the first bit set to one (if 'bit' is 1) or
  * zero (if 'bit' is 0) in the bitmap starting at 's' and long 'count' bytes.
  *
@@ -126,6 +426,7 @@ long redisBitpos(void *s, long count, int bit) {
     unsigned char *c;
     unsigned long skipval, word = 0, one;
     long pos = 0; /* Position of bit, to return to the caller. */
+    long skipped;
     int j;
 
     /* Process whole words first, seeking for first word that is not
@@ -148,14 +449,11 @@ long redisBitpos(void *s, long count, int bit) {
     }
 
     /* Skip bits with full word step. */
-    skipval = bit ? 0 : ULONG_MAX;
-    l = (unsigned long*) c;
-    while (count >= sizeof(*l)) {
-        if (*l != skipval) break;
-        l++;
-        count -= sizeof(*l);
-        pos += sizeof(*l)*8;
-    }
+    // ֣Ϊλ
+    skipped = bitopsSkip(c,count,bit);
+    l = (unsigned long*) (c+skipped);
+    count -= skipped;
+    pos += skipped*8;
 
     /* Load bytes into "word" considering the first byte as the most significant
      * (we basically consider it as written in big endian, since we consider the
@@ -205,11 +503,6 @@ long redisBitpos(void *s, long count, int bit) {
  * Bits related string commands: GETBIT, SETBIT, BITCOUNT, BITOP.
  * -------------------------------------------------------------------------- */
 
-#define BITOP_AND   0
-#define BITOP_OR    1
-#define BITOP_XOR   2
-#define BITOP_NOT   3
-
 /* SETBIT key offset bitvalue */
 void setbitCommand(redisClient *c) {
     robj *o;
@@ -427,68 +720,7 @@ void bitopCommand(redisClient *c) {
          * vanilla algorithm. */
         // ڼȽʱŻ
         j = 0;
-        if (minlen && numkeys <= 16) {
-            unsigned long *lp[16];
-            unsigned long *lres = (unsigned long*) res;
-
-            /* Note: sds pointer is always aligned to 8 byte boundary. */
-            memcpy(lp,src,sizeof(unsigned long*)*numkeys);
-            memcpy(res,src[0],minlen);
-
-            /* Different branches per different operations for speed (sorry). */
-            // Ҫλڵ 32 λʱ
-            // ÿ 4*8 = 32 λȻЩλм㣬û棬м
-            if (op == BITOP_AND) {
-                while(minlen >= sizeof(unsigned long)*4) {
-                    for (i = 1; i < numkeys; i++) {
-                        lres[0] &= lp[i][0];
-                        lres[1] &= lp[i][1];
-                        lres[2] &= lp[i][2];
-                        lres[3] &= lp[i][3];
-                        lp[i]+=4;
-                    }
-                    lres+=4;
-                    j += sizeof(unsigned long)*4;
-                    minlen -= sizeof(unsigned long)*4;
-                }
-            } else if (op == BITOP_OR) {
-                while(minlen >= sizeof(unsigned long)*4) {
-                    for (i = 1; i < numkeys; i++) {
-                        lres[0] |= lp[i][0];
-                        lres[1] |= lp[i][1];
-                        lres[2] |= lp[i][2];
-                        lres[3] |= lp[i][3];
-                        lp[i]+=4;
-                    }
-                    lres+=4;
-                    j += sizeof(unsigned long)*4;
-                    minlen -= sizeof(unsigned long)*4;
-                }
-            } else if (op == BITOP_XOR) {
-                while(minlen >= sizeof(unsigned long)*4) {
-                    for (i = 1; i < numkeys; i++) {
-                        lres[0] ^= lp[i][0];
-                        lres[1] ^= lp[i][1];
-                        lres[2] ^= lp[i][2];
-                        lres[3] ^= lp[i][3];
-                        lp[i]+=4;
-                    }
-                    lres+=4;
-                    j += sizeof(unsigned long)*4;
-                    minlen -= sizeof(unsigned long)*4;
-                }
-            } else if (op == BITOP_NOT) {
-                while(minlen >= sizeof(unsigned long)*4) {
-                    lres[0] = ~lres[0];
-                    lres[1] = ~lres[1];
-                    lres[2] = ~lres[2];
-                    lres[3] = ~lres[3];
-                    lres+=4;
-                    j += sizeof(unsigned long)*4;
-                    minlen -= sizeof(unsigned long)*4;
-                }
-            }
-        }
+        if (minlen && numkeys <= 16) j = bitopsOp(op,res,src,numkeys,minlen);
 
         /* j is set to the next byte to process by the previous loop. */
         // ʽִλ
@@ -120,7 +120,9 @@ void processUnblockedClients(void) {
         c->btype = REDIS_BLOCKED_NONE;
 
         /* Process remaining data in the input buffer. */
-        if (c->querybuf && sdslen(c->querybuf) > 0) {
+        if ((c->querybuf && sdslen(c->querybuf) > 0) ||
+            (c->flags & REDIS_PENDING_COMMAND))
+        {
             server.current_client = c;
             processInputBuffer(c);
             server.current_client = NULL;
@@ -136,6 +138,8 @@ void unblockClient(redisClient *c) {
         unblockClientWaitingData(c);
     } else if (c->btype == REDIS_BLOCKED_WAIT) {
         unblockClientWaitingReplicas(c);
+    } else if (c->btype == REDIS_BLOCKED_ZSET_AGGR) {
+        zsetAggrUnblockClient(c);
     } else {
         redisPanic("Unknown btype in unblockClient().");
     }
@@ -66,6 +66,19 @@ int yesnotoi(char *s) {
     else return -1;
 }
 
+/* Parse the argument of rdbcompression, 'yes' meaning LZF. Returns the
+ * REDIS_RDB_COMPRESSION_* codec, or -1 if it's not valid. */
+static int rdbCompressionFromString(char *s) {
+    if (!strcasecmp(s,"yes") || !strcasecmp(s,"lzf"))
+        return REDIS_RDB_COMPRESSION_LZF;
+    else if (!strcasecmp(s,"no")) return REDIS_RDB_COMPRESSION_NO;
+    else if (!strcasecmp(s,"lz4")) return REDIS_RDB_COMPRESSION_LZ4;
+#ifdef HAVE_ZSTD
+    else if (!strcasecmp(s,"zstd")) return REDIS_RDB_COMPRESSION_ZSTD;
+#endif
+    else return -1;
+}
+
 void appendServerSaveParams(time_t seconds, int changes) {
     server.saveparams = zrealloc(server.saveparams,sizeof(struct saveparam)*(server.saveparamslen+1));
     server.saveparams[server.saveparamslen].seconds = seconds;
@@ -140,6 +153,17 @@ void loadServerConfigFromString(char *config) {
             if (server.tcp_backlog < 0) {
                 err = "Invalid backlog value"; goto loaderr;
             }
+        } else if (!strcasecmp(argv[0],"io-threads") && argc == 2) {
+            server.io_threads_num = atoi(argv[1]);
+            if (server.io_threads_num < 1 ||
+                server.io_threads_num > REDIS_IO_THREADS_MAX)
+            {
+                err = "Invalid number of I/O threads"; goto loaderr;
+            }
+        } else if (!strcasecmp(argv[0],"io-uring") && argc == 2) {
+            if ((server.io_uring = yesnotoi(argv[1])) == -1) {
+                err = "argument must be 'yes' or 'no'"; goto loaderr;
+            }
         } else if (!strcasecmp(argv[0],"bind") && argc >= 2) {
             int j, addresses = argc-1;
 
@@ -323,13 +347,33 @@ slave-serve-stale-data yes
             }
         } else if (!strcasecmp(argv[0],"rdbcompression") && argc == 2) { 
             //ڰkey-valueдrdbļʱǷѹ   #лǷУ
-            if ((server.rdb_compression = yesnotoi(argv[1])) == -1) {
-                err = "argument must be 'yes' or 'no'"; goto loaderr;
+            if ((server.rdb_compression =
+                 rdbCompressionFromString(argv[1])) == -1) {
+#ifdef HAVE_ZSTD
+                err = "argument must be 'yes', 'no', 'lzf', 'lz4' or 'zstd'";
+#else
+                err = "argument must be 'yes', 'no', 'lzf' or 'lz4' (zstd needs to build with USE_ZSTD=yes)";
+#endif
+                goto loaderr;
             }
         } else if (!strcasecmp(argv[0],"rdbchecksum") && argc == 2) {
             if ((server.rdb_checksum = yesnotoi(argv[1])) == -1) {
                 err = "argument must be 'yes' or 'no'"; goto loaderr;
             }
+        } else if (!strcasecmp(argv[0],"rdb-load-threads") && argc == 2) {
+            server.rdb_load_threads = atoi(argv[1]);
+            if (server.rdb_load_threads < 0 ||
+                server.rdb_load_threads > REDIS_RDB_LOAD_THREADS_MAX)
+            {
+                err = "Invalid number of RDB load threads"; goto loaderr;
+            }
+        } else if (!strcasecmp(argv[0],"rdb-save-threads") && argc == 2) {
+            server.rdb_save_threads = atoi(argv[1]);
+            if (server.rdb_save_threads < 0 ||
+                server.rdb_save_threads > REDIS_RDB_SAVE_THREADS_MAX)
+            {
+                err = "Invalid number of RDB save threads"; goto loaderr;
+            }
         } else if (!strcasecmp(argv[0],"activerehashing") && argc == 2) {
             if ((server.activerehashing = yesnotoi(argv[1])) == -1) {
                 err = "argument must be 'yes' or 'no'"; goto loaderr;
@@ -401,6 +445,10 @@ slave-serve-stale-data yes
             if ((server.aof_rewrite_incremental_fsync = yesnotoi(argv[1])) == -1) {
                 err = "argument must be 'yes' or 'no'"; goto loaderr;
             }
+        } else if (!strcasecmp(argv[0],"aof-group-commit") && argc == 2) {
+            if ((server.aof_group_commit = yesnotoi(argv[1])) == -1) {
+                err = "argument must be 'yes' or 'no'"; goto loaderr;
+            }
         } else if (!strcasecmp(argv[0],"requirepass") && argc == 2) {
             if (strlen(argv[1]) > REDIS_AUTHPASS_MAX_LEN) {
                 err = "Password is longer than REDIS_AUTHPASS_MAX_LEN";
@@ -425,12 +473,34 @@ slave-serve-stale-data yes
             server.list_max_ziplist_entries = memtoll(argv[1], NULL);
         } else if (!strcasecmp(argv[0],"list-max-ziplist-value") && argc == 2) {
             server.list_max_ziplist_value = memtoll(argv[1], NULL);
+        } else if (!strcasecmp(argv[0],"list-max-ziplist-size") && argc == 2) {
+            server.list_max_ziplist_size = atoi(argv[1]);
+            if (server.list_max_ziplist_size == 0 ||
+                server.list_max_ziplist_size < -5 ||
+                server.list_max_ziplist_size > 32767)
+            {
+                err = "list-max-ziplist-size must be a positive number of "
+                      "entries or a size class between -1 and -5"; goto loaderr;
+            }
+        } else if (!strcasecmp(argv[0],"list-compress-depth") && argc == 2) {
+            server.list_compress_depth = atoi(argv[1]);
+            if (server.list_compress_depth < 0 ||
+                server.list_compress_depth > 65535)
+            {
+                err = "Invalid list-compress-depth"; goto loaderr;
+            }
         } else if (!strcasecmp(argv[0],"set-max-intset-entries") && argc == 2) {
             server.set_max_intset_entries = memtoll(argv[1], NULL);
         } else if (!strcasecmp(argv[0],"zset-max-ziplist-entries") && argc == 2) {
             server.zset_max_ziplist_entries = memtoll(argv[1], NULL);
         } else if (!strcasecmp(argv[0],"zset-max-ziplist-value") && argc == 2) {
             server.zset_max_ziplist_value = memtoll(argv[1], NULL);
+        } else if (!strcasecmp(argv[0],"zset-btree") && argc == 2) {
+            if ((server.zset_btree = yesnotoi(argv[1])) == -1) {
+                err = "argument must be 'yes' or 'no'"; goto loaderr;
+            }
+        } else if (!strcasecmp(argv[0],"zset-async-aggregate-threshold") && argc == 2) {
+            server.zset_async_aggregate_threshold = memtoll(argv[1], NULL);
         } else if (!strcasecmp(argv[0],"hll-sparse-max-bytes") && argc == 2) {
             server.hll_sparse_max_bytes = memtoll(argv[1], NULL);
         } else if (!strcasecmp(argv[0],"rename-command") && argc == 3) {
@@ -776,6 +846,11 @@ void configSetCommand(redisClient *c) {
 
         if (yn == -1) goto badfmt;
         server.aof_rewrite_incremental_fsync = yn;
+    } else if (!strcasecmp(c->argv[2]->ptr,"aof-group-commit")) {
+        int yn = yesnotoi(o->ptr);
+
+        if (yn == -1) goto badfmt;
+        server.aof_group_commit = yn;
     } else if (!strcasecmp(c->argv[2]->ptr,"save")) { //CONFIG SET SAVE ""ʾrdb    rdbʹCONFIG SET save "1 900 10 2000"
         int vlen, j;
         sds *v = sdssplitlen(o->ptr,sdslen(o->ptr)," ",1,&vlen);
@@ -837,6 +912,14 @@ void configSetCommand(redisClient *c) {
     } else if (!strcasecmp(c->argv[2]->ptr,"list-max-ziplist-value")) {
         if (getLongLongFromObject(o,&ll) == REDIS_ERR || ll < 0) goto badfmt;
         server.list_max_ziplist_value = ll;
+    } else if (!strcasecmp(c->argv[2]->ptr,"list-max-ziplist-size")) {
+        if (getLongLongFromObject(o,&ll) == REDIS_ERR ||
+            ll == 0 || ll < -5 || ll > 32767) goto badfmt;
+        server.list_max_ziplist_size = ll;
+    } else if (!strcasecmp(c->argv[2]->ptr,"list-compress-depth")) {
+        if (getLongLongFromObject(o,&ll) == REDIS_ERR ||
+            ll < 0 || ll > 65535) goto badfmt;
+        server.list_compress_depth = ll;
     } else if (!strcasecmp(c->argv[2]->ptr,"set-max-intset-entries")) {
         if (getLongLongFromObject(o,&ll) == REDIS_ERR || ll < 0) goto badfmt;
         server.set_max_intset_entries = ll;
@@ -846,6 +929,15 @@ void configSetCommand(redisClient *c) {
     } else if (!strcasecmp(c->argv[2]->ptr,"zset-max-ziplist-value")) {
         if (getLongLongFromObject(o,&ll) == REDIS_ERR || ll < 0) goto badfmt;
         server.zset_max_ziplist_value = ll;
+    } else if (!strcasecmp(c->argv[2]->ptr,"zset-btree")) {
+        int yn = yesnotoi(o->ptr);
+
+        if (yn == -1) goto badfmt;
+        // ֻ֮󴴽򼯺Че򼯺ϱԭı
+        server.zset_btree = yn;
+    } else if (!strcasecmp(c->argv[2]->ptr,"zset-async-aggregate-threshold")) {
+        if (getLongLongFromObject(o,&ll) == REDIS_ERR || ll < 0) goto badfmt;
+        server.zset_async_aggregate_threshold = ll;
     } else if (!strcasecmp(c->argv[2]->ptr,"hll-sparse-max-bytes")) {
         if (getLongLongFromObject(o,&ll) == REDIS_ERR || ll < 0) goto badfmt;
         server.hll_sparse_max_bytes = ll;
@@ -941,10 +1033,18 @@ void configSetCommand(redisClient *c) {
         else
             disableWatchdog();
     } else if (!strcasecmp(c->argv[2]->ptr,"rdbcompression")) {
-        int yn = yesnotoi(o->ptr);
+        int codec = rdbCompressionFromString(o->ptr);
 
-        if (yn == -1) goto badfmt;
-        server.rdb_compression = yn;
+        if (codec == -1) goto badfmt;
+        server.rdb_compression = codec;
+    } else if (!strcasecmp(c->argv[2]->ptr,"rdb-load-threads")) {
+        if (getLongLongFromObject(o,&ll) == REDIS_ERR ||
+            ll < 0 || ll > REDIS_RDB_LOAD_THREADS_MAX) goto badfmt;
+        server.rdb_load_threads = ll;
+    } else if (!strcasecmp(c->argv[2]->ptr,"rdb-save-threads")) {
+        if (getLongLongFromObject(o,&ll) == REDIS_ERR ||
+            ll < 0 || ll > REDIS_RDB_SAVE_THREADS_MAX) goto badfmt;
+        server.rdb_save_threads = ll;
     } else if (!strcasecmp(c->argv[2]->ptr,"notify-keyspace-events")) {
         int flags = keyspaceEventsStringToFlags(o->ptr);
 
@@ -1059,12 +1159,18 @@ void configGetCommand(redisClient *c) { //config get
             server.list_max_ziplist_entries);
     config_get_numerical_field("list-max-ziplist-value",
             server.list_max_ziplist_value);
+    config_get_numerical_field("list-max-ziplist-size",
+            server.list_max_ziplist_size);
+    config_get_numerical_field("list-compress-depth",
+            server.list_compress_depth);
     config_get_numerical_field("set-max-intset-entries",
             server.set_max_intset_entries);
     config_get_numerical_field("zset-max-ziplist-entries",
             server.zset_max_ziplist_entries);
     config_get_numerical_field("zset-max-ziplist-value",
             server.zset_max_ziplist_value);
+    config_get_numerical_field("zset-async-aggregate-threshold",
+            server.zset_async_aggregate_threshold);
     config_get_numerical_field("hll-sparse-max-bytes",
             server.hll_sparse_max_bytes);
     config_get_numerical_field("lua-time-limit",server.lua_time_limit);
@@ -1074,6 +1180,7 @@ void configGetCommand(redisClient *c) { //config get
             server.slowlog_max_len);
     config_get_numerical_field("port",server.port);
     config_get_numerical_field("tcp-backlog",server.tcp_backlog);
+    config_get_numerical_field("io-threads",server.io_threads_num);
     config_get_numerical_field("databases",server.dbnum);
     config_get_numerical_field("repl-ping-slave-period",server.repl_ping_slave_period);
     config_get_numerical_field("repl-timeout",server.repl_timeout);
@@ -1085,6 +1192,8 @@ void configGetCommand(redisClient *c) { //config get
     config_get_numerical_field("min-slaves-to-write",server.repl_min_slaves_to_write);
     config_get_numerical_field("min-slaves-max-lag",server.repl_min_slaves_max_lag);
     config_get_numerical_field("hz",server.hz);
+    config_get_numerical_field("rdb-load-threads",server.rdb_load_threads);
+    config_get_numerical_field("rdb-save-threads",server.rdb_save_threads);
     config_get_numerical_field("cluster-node-timeout",server.cluster_node_timeout);
     config_get_numerical_field("cluster-migration-barrier",server.cluster_migration_barrier);
 
@@ -1093,18 +1202,20 @@ void configGetCommand(redisClient *c) { //config get
             server.aof_no_fsync_on_rewrite);
     config_get_bool_field("slave-serve-stale-data",
             server.repl_serve_stale_data);
+    config_get_bool_field("io-uring",server.io_uring);
     config_get_bool_field("slave-read-only",
             server.repl_slave_ro);
     config_get_bool_field("stop-writes-on-bgsave-error",
             server.stop_writes_on_bgsave_err);
     config_get_bool_field("daemonize", server.daemonize);
-    config_get_bool_field("rdbcompression", server.rdb_compression);
     config_get_bool_field("rdbchecksum", server.rdb_checksum);
     config_get_bool_field("activerehashing", server.activerehashing);
+    config_get_bool_field("zset-btree", server.zset_btree);
     config_get_bool_field("repl-disable-tcp-nodelay",
             server.repl_disable_tcp_nodelay);
     config_get_bool_field("aof-rewrite-incremental-fsync",
             server.aof_rewrite_incremental_fsync);
+    config_get_bool_field("aof-group-commit",server.aof_group_commit);
 
     /* Everything we can't handle with macros follows. */
 
@@ -1139,6 +1250,20 @@ void configGetCommand(redisClient *c) { //config get
         addReplyBulkCString(c,s);
         matches++;
     }
+    if (stringmatch(pattern,"rdbcompression",0)) {
+        char *codec;
+
+        switch(server.rdb_compression) {
+        case REDIS_RDB_COMPRESSION_NO: codec = "no"; break;
+        case REDIS_RDB_COMPRESSION_LZF: codec = "yes"; break;
+        case REDIS_RDB_COMPRESSION_LZ4: codec = "lz4"; break;
+        case REDIS_RDB_COMPRESSION_ZSTD: codec = "zstd"; break;
+        default: codec = "unknown"; break; /* too harmless to panic */
+        }
+        addReplyBulkCString(c,"rdbcompression");
+        addReplyBulkCString(c,codec);
+        matches++;
+    }
     if (stringmatch(pattern,"appendfsync",0)) {
         char *policy;
 
@@ -1796,6 +1921,8 @@ int rewriteConfig(char *path) { //config rewrite
     rewriteConfigStringOption(state,"pidfile",server.pidfile,REDIS_DEFAULT_PID_FILE);
     rewriteConfigNumericalOption(state,"port",server.port,REDIS_SERVERPORT);
     rewriteConfigNumericalOption(state,"tcp-backlog",server.tcp_backlog,REDIS_TCP_BACKLOG);
+    rewriteConfigNumericalOption(state,"io-threads",server.io_threads_num,REDIS_DEFAULT_IO_THREADS);
+    rewriteConfigYesNoOption(state,"io-uring",server.io_uring,REDIS_DEFAULT_IO_URING);
     rewriteConfigBindOption(state);
     rewriteConfigStringOption(state,"unixsocket",server.unixsocket,NULL);
     rewriteConfigOctalOption(state,"unixsocketperm",server.unixsocketperm,REDIS_DEFAULT_UNIX_SOCKET_PERM);
@@ -1814,8 +1941,15 @@ int rewriteConfig(char *path) { //config rewrite
     rewriteConfigSaveOption(state);
     rewriteConfigNumericalOption(state,"databases",server.dbnum,REDIS_DEFAULT_DBNUM);
     rewriteConfigYesNoOption(state,"stop-writes-on-bgsave-error",server.stop_writes_on_bgsave_err,REDIS_DEFAULT_STOP_WRITES_ON_BGSAVE_ERROR);
-    rewriteConfigYesNoOption(state,"rdbcompression",server.rdb_compression,REDIS_DEFAULT_RDB_COMPRESSION);
+    rewriteConfigEnumOption(state,"rdbcompression",server.rdb_compression,
+        "no", REDIS_RDB_COMPRESSION_NO,
+        "yes", REDIS_RDB_COMPRESSION_LZF,
+        "lz4", REDIS_RDB_COMPRESSION_LZ4,
+        "zstd", REDIS_RDB_COMPRESSION_ZSTD,
+        NULL, REDIS_DEFAULT_RDB_COMPRESSION);
     rewriteConfigYesNoOption(state,"rdbchecksum",server.rdb_checksum,REDIS_DEFAULT_RDB_CHECKSUM);
+    rewriteConfigNumericalOption(state,"rdb-load-threads",server.rdb_load_threads,REDIS_DEFAULT_RDB_LOAD_THREADS);
+    rewriteConfigNumericalOption(state,"rdb-save-threads",server.rdb_save_threads,REDIS_DEFAULT_RDB_SAVE_THREADS);
     rewriteConfigStringOption(state,"dbfilename",server.rdb_filename,REDIS_DEFAULT_RDB_FILENAME);
     rewriteConfigDirOption(state);
     rewriteConfigSlaveofOption(state);
@@ -1865,14 +1999,19 @@ int rewriteConfig(char *path) { //config rewrite
     rewriteConfigNumericalOption(state,"hash-max-ziplist-value",server.hash_max_ziplist_value,REDIS_HASH_MAX_ZIPLIST_VALUE);
     rewriteConfigNumericalOption(state,"list-max-ziplist-entries",server.list_max_ziplist_entries,REDIS_LIST_MAX_ZIPLIST_ENTRIES);
     rewriteConfigNumericalOption(state,"list-max-ziplist-value",server.list_max_ziplist_value,REDIS_LIST_MAX_ZIPLIST_VALUE);
+    rewriteConfigNumericalOption(state,"list-max-ziplist-size",server.list_max_ziplist_size,REDIS_LIST_MAX_ZIPLIST_SIZE);
+    rewriteConfigNumericalOption(state,"list-compress-depth",server.list_compress_depth,REDIS_LIST_COMPRESS_DEPTH);
     rewriteConfigNumericalOption(state,"set-max-intset-entries",server.set_max_intset_entries,REDIS_SET_MAX_INTSET_ENTRIES);
     rewriteConfigNumericalOption(state,"zset-max-ziplist-entries",server.zset_max_ziplist_entries,REDIS_ZSET_MAX_ZIPLIST_ENTRIES);
     rewriteConfigNumericalOption(state,"zset-max-ziplist-value",server.zset_max_ziplist_value,REDIS_ZSET_MAX_ZIPLIST_VALUE);
+    rewriteConfigYesNoOption(state,"zset-btree",server.zset_btree,REDIS_DEFAULT_ZSET_BTREE);
+    rewriteConfigNumericalOption(state,"zset-async-aggregate-threshold",server.zset_async_aggregate_threshold,REDIS_DEFAULT_ZSET_ASYNC_AGGREGATE_THRESHOLD);
     rewriteConfigNumericalOption(state,"hll-sparse-max-bytes",server.hll_sparse_max_bytes,REDIS_DEFAULT_HLL_SPARSE_MAX_BYTES);
     rewriteConfigYesNoOption(state,"activerehashing",server.activerehashing,REDIS_DEFAULT_ACTIVE_REHASHING);
     rewriteConfigClientoutputbufferlimitOption(state);
     rewriteConfigNumericalOption(state,"hz",server.hz,REDIS_DEFAULT_HZ);
     rewriteConfigYesNoOption(state,"aof-rewrite-incremental-fsync",server.aof_rewrite_incremental_fsync,REDIS_DEFAULT_AOF_REWRITE_INCREMENTAL_FSYNC);
+    rewriteConfigYesNoOption(state,"aof-group-commit",server.aof_group_commit,REDIS_DEFAULT_AOF_GROUP_COMMIT);
     if (server.sentinel_mode) rewriteConfigSentinelOption(state);
 
     /* Step 3: remove all the orphaned lines in the old file, that is, lines
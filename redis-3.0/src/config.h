@@ -65,6 +65,18 @@
 #define HAVE_EPOLL 1
 #endif
 
+/* io_uring needs Linux 5.11 or greater at runtime, and is only used when
+ * compiled with USE_IO_URING=yes. Otherwise epoll is used. */
+#if defined(__linux__) && defined(USE_IO_URING)
+#define HAVE_IO_URING 1
+#endif
+
+/* zstd is not shipped in deps/ like LZ4: "rdbcompression zstd" is only
+ * available when compiled with USE_ZSTD=yes, linking the system libzstd. */
+#ifdef USE_ZSTD
+#define HAVE_ZSTD 1
+#endif
+
 #if (defined(__APPLE__) && defined(MAC_OS_X_VERSION_10_6)) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined (__NetBSD__)
 #define HAVE_KQUEUE 1
 #endif
@@ -83,6 +95,14 @@
 #define aof_fsync fsync
 #endif
 
+/* Define redis_prefetch to a prefetch-for-read hint when the compiler has
+ * one, otherwise it does nothing. */
+#if defined(__GNUC__)
+#define redis_prefetch(p) __builtin_prefetch(p)
+#else
+#define redis_prefetch(p) ((void)(p))
+#endif
+
 /* Define rdb_fsync_range to sync_file_range() on Linux, otherwise we use
  * the plain fsync() call. */
 #ifdef __linux__
@@ -191,6 +211,12 @@ void setproctitle(const char *fmt, ...);
 #if (GNUC_VERSION >= 40100) || defined(__clang__)
 #define HAVE_ATOMIC
 #endif
+
+/* Test for x86-64 SIMD kernels, compiled with the target attribute and
+ * selected at runtime with __builtin_cpu_supports(). */
+#if defined(__x86_64__) && ((GNUC_VERSION >= 40900) || defined(__clang__))
+#define HAVE_X86_SIMD
+#endif
 #endif
 
 #endif
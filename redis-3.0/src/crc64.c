@@ -180,12 +180,68 @@ uint64_t crc64(uint64_t crc, const unsigned char *s, uint64_t l) {
     return crc;
 }
 
+/* Multiply the 64x64 GF(2) matrix 'mat' by the vector 'vec'. */
+static uint64_t crc64_matrix_times(const uint64_t *mat, uint64_t vec) {
+    uint64_t sum = 0;
+
+    while (vec) {
+        if (vec & 1) sum ^= *mat;
+        vec >>= 1;
+        mat++;
+    }
+    return sum;
+}
+
+/* Store in 'square' the matrix 'mat' multiplied by itself. */
+static void crc64_matrix_square(uint64_t *square, const uint64_t *mat) {
+    int n;
+
+    for (n = 0; n < 64; n++) square[n] = crc64_matrix_times(mat, mat[n]);
+}
+
+/* Return the CRC64 of the concatenation of two blocks, given the CRC64 of
+ * the first block, 'crc1', the CRC64 of the second block, 'crc2', and the
+ * length of the second block, 'len2'.
+ *
+ * This is the same approach of zlib crc32_combine(): feeding a zero byte
+ * into the CRC is a linear operator, so the effect of the 'len2' bytes of
+ * the second block on 'crc1' is computed in O(log(len2)) squaring the
+ * operator, and since the initial value is 0 the CRC of the second block
+ * is just added to it. */
+uint64_t crc64_combine(uint64_t crc1, uint64_t crc2, uint64_t len2) {
+    uint64_t even[64], odd[64];
+    int n;
+
+    if (len2 == 0) return crc1 ^ crc2;
+
+    /* Operator for one zero byte. */
+    for (n = 0; n < 64; n++) {
+        uint64_t c = (uint64_t)1 << n;
+        odd[n] = crc64_tab[(uint8_t)c] ^ (c >> 8);
+    }
+
+    /* Apply the operator for every bit set in len2, squaring it at every
+     * step: odd is the operator for 1, 2, 4, 8, ... zero bytes. */
+    while (1) {
+        if (len2 & 1) crc1 = crc64_matrix_times(odd, crc1);
+        len2 >>= 1;
+        if (len2 == 0) break;
+        crc64_matrix_square(even, odd);
+        for (n = 0; n < 64; n++) odd[n] = even[n];
+    }
+    return crc1 ^ crc2;
+}
+
 /* Test main */
 #ifdef TEST_MAIN
 #include <stdio.h>
 int main(void) {
     printf("e9c6d914c4b8d9ca == %016llx\n",
         (unsigned long long) crc64(0,(unsigned char*)"123456789",9));
+    printf("e9c6d914c4b8d9ca == %016llx\n",
+        (unsigned long long) crc64_combine(
+            crc64(0,(unsigned char*)"1234",4),
+            crc64(0,(unsigned char*)"56789",5),5));
     return 0;
 }
 #endif
@@ -4,5 +4,6 @@
 #include <stdint.h>
 
 uint64_t crc64(uint64_t crc, const unsigned char *s, uint64_t l);
+uint64_t crc64_combine(uint64_t crc1, uint64_t crc2, uint64_t len2);
 
 #endif
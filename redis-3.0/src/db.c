@@ -117,6 +117,68 @@ robj *lookupKeyWrite(redisDb *db, robj *key) {
     return lookupKey(db,key);
 }
 
+/*
+ * Look up the 'count' (at most REDIS_LOOKUP_BATCH) keys keys[0],
+ * keys[step], keys[2*step]..., storing their values in vals[0..count-1].
+ * This is the same as calling lookupKeyWrite() for every key, but the
+ * keyspace lookups are done at once by dictFindBatch(), so that commands
+ * about many keys don't wait for every cache miss in turn.
+ *
+ * The values are valid until the keyspace is modified, so callers handle
+ * the keys REDIS_LOOKUP_BATCH at a time.
+ *
+ * һβҶЧͶÿ lookupKeyWrite() ͬ
+ * ԼռĲ dictFindBatch() 
+ */
+void lookupKeysWrite(redisDb *db, robj **keys, int count, int step, robj **vals) {
+    void *ptrs[REDIS_LOOKUP_BATCH];
+    dictEntry *des[REDIS_LOOKUP_BATCH];
+    int j;
+
+    redisAssert(count <= REDIS_LOOKUP_BATCH);
+
+    /* Expired keys are deleted before any lookup, since deleting them
+     * changes the keyspace. */
+    // ɾڵļΪɾ޸ļռ
+    for (j = 0; j < count; j++) {
+        expireIfNeeded(db,keys[j*step]);
+        ptrs[j] = keys[j*step]->ptr;
+    }
+
+    dictFindBatch(db->dict,ptrs,count,des);
+
+    for (j = 0; j < count; j++) {
+        robj *val = des[j] ? dictGetVal(des[j]) : NULL;
+
+        /* Update the access time as lookupKey() does. */
+        if (val && server.rdb_child_pid == -1 && server.aof_child_pid == -1)
+            val->lru = LRU_CLOCK();
+        vals[j] = val;
+    }
+}
+
+/*
+ * Like lookupKeysWrite(), but updating the keyspace hits/misses stats as
+ * lookupKeyRead() does. The strings the values point to are prefetched,
+ * since the caller is likely going to reply with them.
+ *
+ *  lookupKeysWrite() һ lookupKeyRead() /Ϣ
+ */
+void lookupKeysRead(redisDb *db, robj **keys, int count, int step, robj **vals) {
+    int j;
+
+    lookupKeysWrite(db,keys,count,step,vals);
+    for (j = 0; j < count; j++) {
+        if (vals[j] == NULL) {
+            server.stat_keyspace_misses++;
+        } else {
+            server.stat_keyspace_hits++;
+            if (vals[j]->encoding == REDIS_ENCODING_RAW)
+                redis_prefetch(vals[j]->ptr);
+        }
+    }
+}
+
 /*
  * Ϊִжȡݿвҷ key ֵ
  *
@@ -294,6 +356,10 @@ robj *dbRandomKey(redisDb *db) {
  */
 int dbDelete(redisDb *db, robj *key) {
 
+    /* Pending aggregations reading the key complete before it goes away. */
+    // ɶȡ ZUNIONSTORE / ZINTERSTORE Ƭ
+    zsetAggrFinishJobs(db,key,1);
+
     /* Deleting an entry from the expires dict will not free the sds of
      * the key, because it is shared with the main dictionary. */
     // ɾĹʱ
@@ -355,6 +421,9 @@ long long emptyDb(void(callback)(void*)) { //ע
     int j;
     long long removed = 0;
 
+    // зƬִе ZUNIONSTORE / ZINTERSTORE
+    zsetAggrFinishJobs(NULL,NULL,0);
+
     // ݿ
     for (j = 0; j < server.dbnum; j++) {
 
@@ -526,16 +595,22 @@ redis> DEL name type website
 
 */
 void delCommand(redisClient *c) {
-    int deleted = 0, j;
+    robj *vals[REDIS_LOOKUP_BATCH];
+    int deleted = 0, j, n = 0;
 
     // 
     for (j = 1; j < c->argc; j++) {
 
-        // ɾڵļ
-        expireIfNeeded(c->db,c->argv[j]);
+        // ҽһɾйڵļ
+        if ((j-1) % REDIS_LOOKUP_BATCH == 0) {
+            n = c->argc-j;
+            if (n > REDIS_LOOKUP_BATCH) n = REDIS_LOOKUP_BATCH;
+            lookupKeysWrite(c->db,c->argv+j,n,1,vals);
+        }
 
-        // ɾ
-        if (dbDelete(c->db,c->argv[j])) {
+        // ɾʱٲ
+        if (vals[(j-1) % REDIS_LOOKUP_BATCH] != NULL &&
+            dbDelete(c->db,c->argv[j])) {
 
             // ɾɹ֪ͨ
 
@@ -762,7 +837,7 @@ void scanCallback(void *privdata, const dictEntry *de) {
     } else if (o->type == REDIS_ZSET) {
         key = dictGetKey(de);
         incrRefCount(key);
-        val = createStringObjectFromLongDouble(*(double*)dictGetVal(de));
+        val = createStringObjectFromLongDouble(dictGetDoubleVal(de));
     } else {
         redisPanic("Type not handled in SCAN callback.");
     }
@@ -892,15 +967,15 @@ void scanGenericCommand(redisClient *c, robj *o, unsigned long cursor) { /* curs
 
     /* Step 2: Iterate the collection.
      *
-     * Note that if the object is encoded with a ziplist, intset, or any other
+     * Note that if the object is encoded with a listpack, intset, or any other
      * representation that is not a hash table, we are sure that it is also
      * composed of a small number of elements. So to avoid taking state we
      * just return everything inside the object in a single call, setting the
      * cursor to zero to signal the end of the iteration. */
-     // ĵײʵΪ ziplist intset ǹϣ
+     // ĵײʵΪ listpack intset ǹϣ
      // ôЩӦֻԪأ
      // Ϊ˱ֲ÷¼״̬
-     // ǽ ziplist  intset Ԫضһηظ
+     // ǽ listpack  intset Ԫضһηظ
      // ߷α꣨cursor 0
 
     /* Handle the case of a hash table. */
@@ -915,7 +990,8 @@ void scanGenericCommand(redisClient *c, robj *o, unsigned long cursor) { /* curs
         // ĿΪ HT Ĺϣ
         ht = o->ptr;
         count *= 2; /* We return key / value for this type. */
-    } else if (o->type == REDIS_ZSET && o->encoding == REDIS_ENCODING_SKIPLIST) {
+    } else if (o->type == REDIS_ZSET && (o->encoding == REDIS_ENCODING_SKIPLIST ||
+                                         o->encoding == REDIS_ENCODING_BTREE)) {
         // ĿΪ HT Ծ
         zset *zs = o->ptr;
         ht = zs->dict;
@@ -945,17 +1021,17 @@ void scanGenericCommand(redisClient *c, robj *o, unsigned long cursor) { /* curs
             listAddNodeTail(keys,createStringObjectFromLongLong(ll));
         cursor = 0;
     } else if (o->type == REDIS_HASH || o->type == REDIS_ZSET) {
-        unsigned char *p = ziplistIndex(o->ptr,0);
+        unsigned char *p = lpFirst(o->ptr);
         unsigned char *vstr;
         unsigned int vlen;
         long long vll;
 
         while(p) {
-            ziplistGet(p,&vstr,&vlen,&vll);
+            lpGet(p,&vstr,&vlen,&vll);
             listAddNodeTail(keys,
                 (vstr != NULL) ? createStringObject((char*)vstr,vlen) :
                                  createStringObjectFromLongLong(vll));
-            p = ziplistNext(o->ptr,p);
+            p = lpNext(o->ptr,p);
         }
         cursor = 0;
     } else {
@@ -166,7 +166,7 @@ void computeDatasetDigest(unsigned char *final) {
             } else if (o->type == REDIS_ZSET) {
                 unsigned char eledigest[20];
 
-                if (o->encoding == REDIS_ENCODING_ZIPLIST) {
+                if (o->encoding == REDIS_ENCODING_LISTPACK) {
                     unsigned char *zl = o->ptr;
                     unsigned char *eptr, *sptr;
                     unsigned char *vstr;
@@ -174,13 +174,13 @@ void computeDatasetDigest(unsigned char *final) {
                     long long vll;
                     double score;
 
-                    eptr = ziplistIndex(zl,0);
+                    eptr = lpFirst(zl);
                     redisAssert(eptr != NULL);
-                    sptr = ziplistNext(zl,eptr);
+                    sptr = lpNext(zl,eptr);
                     redisAssert(sptr != NULL);
 
                     while (eptr != NULL) {
-                        redisAssert(ziplistGet(eptr,&vstr,&vlen,&vll));
+                        redisAssert(lpGet(eptr,&vstr,&vlen,&vll));
                         score = zzlGetScore(sptr);
 
                         memset(eledigest,0,20);
@@ -196,16 +196,17 @@ void computeDatasetDigest(unsigned char *final) {
                         xorDigest(digest,eledigest,20);
                         zzlNext(zl,&eptr,&sptr);
                     }
-                } else if (o->encoding == REDIS_ENCODING_SKIPLIST) {
+                } else if (o->encoding == REDIS_ENCODING_SKIPLIST ||
+                           o->encoding == REDIS_ENCODING_BTREE) {
                     zset *zs = o->ptr;
                     dictIterator *di = dictGetIterator(zs->dict);
                     dictEntry *de;
 
                     while((de = dictNext(di)) != NULL) {
                         robj *eleobj = dictGetKey(de);
-                        double *score = dictGetVal(de);
+                        double score = dictGetDoubleVal(de);
 
-                        snprintf(buf,sizeof(buf),"%.17g",*score);
+                        snprintf(buf,sizeof(buf),"%.17g",score);
                         memset(eledigest,0,20);
                         mixObjectDigest(eledigest,eleobj);
                         mixDigest(eledigest,buf,strlen(buf));
@@ -257,6 +258,7 @@ void debugCommand(redisClient *c) {
         if (c->argc >= 3) c->argv[2] = tryObjectEncoding(c->argv[2]);
         redisAssertWithInfo(c,c->argv[0],1 == 2);
     } else if (!strcasecmp(c->argv[1]->ptr,"reload")) {
+        zsetAggrFinishJobs(NULL,NULL,0);
         if (rdbSave(server.rdb_filename) != REDIS_OK) {
             addReply(c,shared.err);
             return;
@@ -364,6 +366,13 @@ void debugCommand(redisClient *c) {
     {
         server.active_expire_enabled = atoi(c->argv[2]->ptr);
         addReply(c,shared.ok);
+    } else if (!strcasecmp(c->argv[1]->ptr,"set-dict-bg-alloc") &&
+               c->argc == 3)
+    {
+        /* Minimum size of the hash tables allocated by a bio thread. */
+        dictSetBackgroundAlloc(strtoull(c->argv[2]->ptr,NULL,10),
+                               submitDictTableAlloc);
+        addReply(c,shared.ok);
     } else if (!strcasecmp(c->argv[1]->ptr,"cmdkeys") && c->argc >= 3) {
         struct redisCommand *cmd = lookupCommand(c->argv[2]->ptr);
         int *keys, numkeys, j;
@@ -455,6 +464,8 @@ void redisLogObjectDebugInfo(robj *o) {
         redisLog(REDIS_WARNING,"Sorted set size: %d", (int) zsetLength(o));
         if (o->encoding == REDIS_ENCODING_SKIPLIST)
             redisLog(REDIS_WARNING,"Skiplist level: %d", (int) ((zset*)o->ptr)->zsl->level);
+        else if (o->encoding == REDIS_ENCODING_BTREE)
+            redisLog(REDIS_WARNING,"B+tree height: %d", ((zset*)o->ptr)->zbt->height);
     }
 }
 
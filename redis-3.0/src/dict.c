@@ -42,8 +42,13 @@
 #include <limits.h>
 #include <sys/time.h>
 #include <ctype.h>
+#include <pthread.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include "dict.h"
+#include "config.h"
 #include "zmalloc.h"
 #include "redisassert.h"
 
@@ -78,6 +83,10 @@ static int _dictExpandIfNeeded(dict *ht);
 static unsigned long _dictNextPower(unsigned long size);
 static int _dictKeyIndex(dict *ht, const void *key);
 static int _dictInit(dict *ht, dictType *type, void *privDataPtr);
+static int _dictRequestTable(dict *d, unsigned long size);
+static int _dictInstallTable(dict *d);
+static int _dictExpandAllowed(dict *d, unsigned long size);
+static void _dictCancelTable(dict *d);
 
 /* -------------------------- hash functions -------------------------------- */
 
@@ -193,6 +202,445 @@ static void _dictReset(dictht *ht)
     ht->size = 0;
     ht->sizemask = 0;
     ht->used = 0;
+    ht->ctrl = NULL;
+    ht->deleted = 0;
+}
+
+/* ------------------------ open addressing tables -------------------------- */
+
+/* Dictionaries whose type sets 'openAddressing' don't allocate a dictEntry
+ * per element: the key and the value are stored in an array of slots, and
+ * every slot has a control byte in a separate array, that is either
+ * DICT_CTRL_EMPTY, DICT_CTRL_DELETED, or the top 7 bits of the hash of the
+ * key stored in the slot.
+ *
+ * ѰַϣΪÿԪط dictEntry ֱֵӱڲλУ
+ * ÿλڿֽһֽڣաɾ߼Ĺϣֵĸ 7 λ
+ *
+ * Slots are grouped by DICT_GROUP_SIZE. The home group of a key is
+ * hash & (groups-1), the same way the bucket of a key is hash & sizemask
+ * in a chained table, and the key is stored in the first group with a free
+ * slot starting from the home group. A lookup compares the control bytes
+ * of a whole group with the hash of the key with a few SSE2 instructions,
+ * so it only compares the keys that are very likely to match, and it stops
+ * at the first group that has an empty slot.
+ *
+ * λΪλʼɹϣֵʽϣͰһ
+ * ڴʼ鿪ʼһпвλС
+ * ʱһαȽĿֽڣֱһпղλΪֹ
+ *
+ * Compared to chaining there is no allocation per element, no 'next'
+ * pointer and no bucket array, and a lookup doesn't follow a chain of
+ * entries, so large tables use less memory and lookups have less cache
+ * misses.
+ *
+ * Removing a key marks its slot as deleted, unless the group still has an
+ * empty slot: in that case no lookup ever went past the group, so the slot
+ * can become empty again. Deleted slots are reclaimed rehashing the table.
+ *
+ * ɾʱλΪɾпղλôûвԽ飬
+ * λֱӱΪաɾĲλ rehash ʱա
+ *
+ * Rehashing is incremental as with chained tables, one group per step.
+ * Slots moved to the new table are removed from the old one the same way
+ * keys are deleted, so the keys not moved yet are still found. dictScan()
+ * visits the home groups with the same cursor, so it provides the same
+ * guarantees. */
+
+#define DICT_GROUP_SIZE 16
+#define DICT_CTRL_EMPTY 0x80
+#define DICT_CTRL_DELETED 0xfe
+
+/* Smallest open addressing table, one group. */
+#define DICT_OPEN_INITIAL_SIZE DICT_GROUP_SIZE
+
+/* Number of full or deleted slots that triggers a rehash: 7/8 of the table. */
+#define DICT_OPEN_MAX_FILL(ht) ((ht)->size - (ht)->size/8)
+
+/* Fill a table can reach while waiting for a bigger one: 15/16. */
+#define DICT_OPEN_HARD_FILL(ht) ((ht)->size - (ht)->size/16)
+
+#define dictOpenSlots(ht) ((dictSlot*)((ht)->ctrl+(ht)->size))
+#define dictOpenGroupMask(ht) ((ht)->sizemask/DICT_GROUP_SIZE)
+#define dictOpenCtrl(h) ((unsigned char)((h) >> 25))
+
+/* Returns a bitmap of the slots of the group whose control byte is 'c'. */
+static inline unsigned int _dictGroupMatch(const unsigned char *ctrl, unsigned char c) {
+#if defined(__SSE2__)
+    __m128i group = _mm_loadu_si128((const __m128i*)ctrl);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(group,_mm_set1_epi8(c)));
+#else
+    unsigned int mask = 0;
+    int j;
+
+    for (j = 0; j < DICT_GROUP_SIZE; j++)
+        if (ctrl[j] == c) mask |= 1<<j;
+    return mask;
+#endif
+}
+
+/* Returns a bitmap of the empty or deleted slots of the group. */
+static inline unsigned int _dictGroupFree(const unsigned char *ctrl) {
+#if defined(__SSE2__)
+    return _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)ctrl));
+#else
+    unsigned int mask = 0;
+    int j;
+
+    for (j = 0; j < DICT_GROUP_SIZE; j++)
+        if (ctrl[j] & 0x80) mask |= 1<<j;
+    return mask;
+#endif
+}
+
+/* Index of the lowest bit set in a non zero group bitmap. */
+static inline int _dictGroupFirst(unsigned int mask) {
+#if defined(__GNUC__)
+    return __builtin_ctz(mask);
+#else
+    int j = 0;
+
+    while (!(mask & 1)) {
+        mask >>= 1;
+        j++;
+    }
+    return j;
+#endif
+}
+
+/* Returns the number of slots of the smallest open addressing table that
+ * can hold 'size' keys. */
+static unsigned long _dictOpenNextSize(unsigned long size) {
+    unsigned long i = DICT_OPEN_INITIAL_SIZE;
+
+    while(size > i - i/8) {
+        if (i >= LONG_MAX/2) return LONG_MAX/2+1;
+        i *= 2;
+    }
+    return i;
+}
+
+/* Allocate an open addressing table of 'size' slots, all empty. */
+static void _dictOpenInitTable(dictht *ht, unsigned long size) {
+    ht->ctrl = zmalloc(size+size*sizeof(dictSlot));
+    memset(ht->ctrl,DICT_CTRL_EMPTY,size);
+    ht->table = NULL;
+    ht->size = size;
+    ht->sizemask = size-1;
+    ht->used = 0;
+    ht->deleted = 0;
+}
+
+/* Returns the slot of 'key', with hash 'h', in the table, or NULL. */
+static dictSlot *_dictOpenFind(dict *d, dictht *ht, const void *key, unsigned int h) {
+    unsigned long gmask = dictOpenGroupMask(ht), g = h & gmask, probes;
+    unsigned char c = dictOpenCtrl(h);
+
+    for (probes = 0; probes <= gmask; probes++) {
+        unsigned char *ctrl = ht->ctrl+g*DICT_GROUP_SIZE;
+        unsigned int match = _dictGroupMatch(ctrl,c);
+
+        while (match) {
+            dictSlot *s = dictOpenSlots(ht)+g*DICT_GROUP_SIZE+_dictGroupFirst(match);
+
+            if (dictCompareKeys(d, key, s->key)) return s;
+            match &= match-1;
+        }
+        if (_dictGroupMatch(ctrl,DICT_CTRL_EMPTY)) break;
+        g = (g+1) & gmask;
+    }
+    return NULL;
+}
+
+/* Looks up 'key' in both tables if we are rehashing, like dictFind(). */
+static dictSlot *_dictOpenLookup(dict *d, const void *key, unsigned int h) {
+    dictSlot *s = NULL;
+
+    if (d->ht[0].used) s = _dictOpenFind(d,&d->ht[0],key,h);
+    if (!s && dictIsRehashing(d)) s = _dictOpenFind(d,&d->ht[1],key,h);
+    return s;
+}
+
+/* Takes the first free slot for a key with hash 'h', that must not be
+ * already in the table, and returns it. The caller sets the key. */
+static dictSlot *_dictOpenInsert(dictht *ht, unsigned int h) {
+    unsigned long gmask = dictOpenGroupMask(ht), g = h & gmask;
+    unsigned char *ctrl;
+    unsigned int avail;
+    int j;
+
+    assert(ht->used < ht->size);
+    while ((avail = _dictGroupFree(ht->ctrl+g*DICT_GROUP_SIZE)) == 0)
+        g = (g+1) & gmask;
+    j = g*DICT_GROUP_SIZE+_dictGroupFirst(avail);
+    ctrl = ht->ctrl+j;
+    if (*ctrl == DICT_CTRL_DELETED) ht->deleted--;
+    *ctrl = dictOpenCtrl(h);
+    ht->used++;
+    return dictOpenSlots(ht)+j;
+}
+
+/* Frees slot 's' of the table. Lookups for other keys may have probed past
+ * its group only if the group has no empty slot. */
+static void _dictOpenRemove(dictht *ht, dictSlot *s) {
+    unsigned long j = s-dictOpenSlots(ht);
+    unsigned char *group = ht->ctrl+(j & ~(unsigned long)(DICT_GROUP_SIZE-1));
+
+    if (_dictGroupMatch(group,DICT_CTRL_EMPTY)) {
+        ht->ctrl[j] = DICT_CTRL_EMPTY;
+    } else {
+        ht->ctrl[j] = DICT_CTRL_DELETED;
+        ht->deleted++;
+    }
+    ht->used--;
+}
+
+/* Creates the table of 'size' slots, or the table to rehash to. */
+static void _dictOpenExpand(dict *d, unsigned long size) {
+    _dictCancelTable(d);
+    if (d->ht[0].ctrl == NULL) {
+        _dictOpenInitTable(&d->ht[0],size);
+    } else {
+        _dictOpenInitTable(&d->ht[1],size);
+        d->rehashidx = 0;
+    }
+}
+
+/* Makes room for a new key. A full table is rehashed to a table twice as
+ * big, or to a table of the same size if most of the slots are deleted
+ * ones. As keys can't be chained, this happens even if resizing is
+ * disabled. While a big table is allocated in background, or while the
+ * dictionary type doesn't allow to allocate it, the current one can be
+ * filled up to 15/16. After that a table that can't grow is only cleaned
+ * of its deleted slots, unless they are too few. */
+static void _dictOpenExpandIfNeeded(dict *d) {
+    dictht *ht = &d->ht[0];
+
+    if (dictIsRehashing(d)) {
+        /* The new table has room for twice the keys of the old one and
+         * every insertion moves a group, so it gets full only if safe
+         * iterators stop the rehashing for very long. */
+        if (d->ht[1].used+d->ht[1].deleted < DICT_OPEN_MAX_FILL(&d->ht[1]) ||
+            d->iterators) return;
+        while (dictRehash(d,100));
+    }
+    if (ht->size == 0) {
+        _dictOpenExpand(d,DICT_OPEN_INITIAL_SIZE);
+    } else if (ht->used+ht->deleted >= DICT_OPEN_MAX_FILL(ht)) {
+        unsigned long size = (ht->used >= ht->size/2) ? ht->size*2 : ht->size;
+
+        if (_dictInstallTable(d)) return;
+        if (size > ht->size && !_dictExpandAllowed(d,size)) {
+            if (ht->used+ht->deleted < DICT_OPEN_HARD_FILL(ht)) return;
+            if (ht->used < DICT_OPEN_MAX_FILL(ht)) size = ht->size;
+        }
+        if (ht->used+ht->deleted < DICT_OPEN_HARD_FILL(ht) &&
+            _dictRequestTable(d,size)) return;
+        _dictOpenExpand(d,size);
+    }
+}
+
+/* Moves 'n' groups to the new table, see dictRehash(). */
+static int _dictOpenRehash(dict *d, int n) {
+    while(n--) {
+        dictSlot *slots;
+        unsigned char *ctrl;
+        int j;
+
+        if (d->ht[0].used == 0) {
+            zfree(d->ht[0].ctrl);
+            d->ht[0] = d->ht[1];
+            _dictReset(&d->ht[1]);
+            d->rehashidx = -1;
+            return 0;
+        }
+
+        assert(d->ht[0].size > (unsigned long)d->rehashidx*DICT_GROUP_SIZE);
+        ctrl = d->ht[0].ctrl+d->rehashidx*DICT_GROUP_SIZE;
+        slots = dictOpenSlots(&d->ht[0])+d->rehashidx*DICT_GROUP_SIZE;
+        for (j = 0; j < DICT_GROUP_SIZE; j++) {
+            if (ctrl[j] & 0x80) continue;
+            *_dictOpenInsert(&d->ht[1],dictHashKey(d, slots[j].key)) = slots[j];
+            _dictOpenRemove(&d->ht[0],slots+j);
+        }
+        d->rehashidx++;
+    }
+    return 1;
+}
+
+/* Calls 'fn' for the keys of the table whose home group is 'g'. They are
+ * in the groups that follow it, up to the first one with an empty slot. */
+static void _dictOpenScanGroup(dict *d, dictht *ht, unsigned long g,
+                               dictScanFunction *fn, void *privdata)
+{
+    unsigned long gmask = dictOpenGroupMask(ht), probes, home = g;
+
+    for (probes = 0; probes <= gmask; probes++) {
+        unsigned char *ctrl = ht->ctrl+g*DICT_GROUP_SIZE;
+        dictSlot *slots = dictOpenSlots(ht)+g*DICT_GROUP_SIZE;
+        int j;
+
+        for (j = 0; j < DICT_GROUP_SIZE; j++) {
+            if (ctrl[j] & 0x80) continue;
+            if ((dictHashKey(d, slots[j].key) & gmask) == home)
+                fn(privdata, (dictEntry*)(slots+j));
+        }
+        if (_dictGroupMatch(ctrl,DICT_CTRL_EMPTY)) break;
+        g = (g+1) & gmask;
+    }
+}
+
+/* Frees the keys and the values of an open addressing table, see
+ * _dictClear(). */
+static void _dictOpenClear(dict *d, dictht *ht, void(callback)(void *)) {
+    dictSlot *slots = dictOpenSlots(ht);
+    unsigned long i;
+
+    for (i = 0; i < ht->size && ht->used > 0; i++) {
+        if (callback && (i & 65535) == 0) callback(d->privdata);
+        if (ht->ctrl[i] & 0x80) continue;
+        dictFreeKey(d, slots+i);
+        dictFreeVal(d, slots+i);
+        ht->used--;
+    }
+    zfree(ht->ctrl);
+    _dictReset(ht);
+}
+
+/* ----------------------- background table allocation ---------------------- */
+
+/* Growing a dictionary allocates a table twice as big, and clears it. For
+ * huge dictionaries this is hundreds of megabytes written at once, and the
+ * page faults alone stop the server for a long time. When a function to
+ * submit jobs to a background thread is set with dictSetBackgroundAlloc(),
+ * tables bigger than the threshold are requested to the thread instead:
+ * the dictionary keeps using its current table, a chained table just gets
+ * longer chains and an open addressing one fills a bit more of its slots,
+ * and the next time it should grow the new table is installed, if ready,
+ * and incrementally rehashed as usual. If the current table gets too full
+ * before the thread is done, the table is allocated synchronously and the
+ * request canceled.
+ *
+ * ֵʱ¹ϣɺ̷̨߳䲢ʼֵڴڼʹþɹϣ
+ * ´Ҫʱ¹ϣѾôͰװʼʽ rehash 
+ * ɹϣڴ֮ǰ̫ôͬ¹ϣȡ̨ */
+
+static size_t dict_bg_alloc_threshold = 0;
+static void (*dict_bg_alloc_submit)(dictTableAlloc *req) = NULL;
+#ifndef HAVE_ATOMIC
+static pthread_mutex_t dict_alloc_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+/* Tables of 'threshold' bytes or more are allocated calling submit(req),
+ * that must call dictBackgroundAlloc(req) from another thread. A NULL
+ * 'submit' allocates every table synchronously. */
+void dictSetBackgroundAlloc(size_t threshold, void (*submit)(dictTableAlloc *req)) {
+    dict_bg_alloc_threshold = threshold;
+    dict_bg_alloc_submit = submit;
+}
+
+/* Atomically move the request from state 'from' to state 'to', returning 1
+ * on success and 0 if it was not in state 'from'. */
+static int _dictAllocSetState(dictTableAlloc *req, int from, int to) {
+#ifdef HAVE_ATOMIC
+    return __sync_bool_compare_and_swap(&req->state,from,to);
+#else
+    int ok;
+
+    pthread_mutex_lock(&dict_alloc_mutex);
+    ok = (req->state == from);
+    if (ok) req->state = to;
+    pthread_mutex_unlock(&dict_alloc_mutex);
+    return ok;
+#endif
+}
+
+/* Allocate and initialize the table of a request. Called by the background
+ * thread. The bytes that don't need to be initialized are cleared anyway,
+ * so that the page faults are taken here and not by the main thread while
+ * it rehashes. */
+void dictBackgroundAlloc(dictTableAlloc *req) {
+    unsigned char *table = zmalloc(req->bytes);
+
+    memset(table,req->fillbyte,req->fill);
+    memset(table+req->fill,0,req->bytes-req->fill);
+    req->table = table;
+    if (!_dictAllocSetState(req,DICT_ALLOC_PENDING,DICT_ALLOC_READY)) {
+        /* The dictionary doesn't want it anymore. */
+        zfree(table);
+        zfree(req);
+    }
+}
+
+/* Bytes allocated for a table of 'size' buckets or slots. */
+static size_t _dictTableBytes(dict *d, unsigned long size) {
+    return d->type->openAddressing ? size+size*sizeof(dictSlot) :
+                                     size*sizeof(dictEntry*);
+}
+
+/* Returns 0 if the dictionary type doesn't want a table of 'size' buckets
+ * or slots to be allocated now, see dictType.expandAllowed. */
+static int _dictExpandAllowed(dict *d, unsigned long size) {
+    if (d->type->expandAllowed == NULL) return 1;
+    return d->type->expandAllowed(_dictTableBytes(d,size));
+}
+
+/* Request a table of 'size' buckets or slots to the background thread, if
+ * it is big enough. Returns 1 if the table is requested, or was already,
+ * and 0 if the caller should allocate it now. */
+static int _dictRequestTable(dict *d, unsigned long size) {
+    dictTableAlloc *req;
+    size_t bytes = _dictTableBytes(d,size);
+
+    if (d->alloc) return 1;
+    if (dict_bg_alloc_submit == NULL || bytes < dict_bg_alloc_threshold)
+        return 0;
+
+    req = zmalloc(sizeof(*req));
+    req->size = size;
+    req->bytes = bytes;
+    req->fill = d->type->openAddressing ? size : bytes;
+    req->fillbyte = d->type->openAddressing ? DICT_CTRL_EMPTY : 0;
+    req->table = NULL;
+    req->state = DICT_ALLOC_PENDING;
+    d->alloc = req;
+    dict_bg_alloc_submit(req);
+    return 1;
+}
+
+/* If the requested table is ready, start rehashing to it and return 1.
+ * Otherwise return 0. */
+static int _dictInstallTable(dict *d) {
+    dictTableAlloc *req = d->alloc;
+    dictht *n = &d->ht[1];
+
+    if (req == NULL || dictIsRehashing(d) ||
+        !_dictAllocSetState(req,DICT_ALLOC_READY,DICT_ALLOC_READY)) return 0;
+
+    _dictReset(n);
+    if (d->type->openAddressing)
+        n->ctrl = req->table;
+    else
+        n->table = req->table;
+    n->size = req->size;
+    n->sizemask = req->size-1;
+    d->rehashidx = 0;
+    d->alloc = NULL;
+    zfree(req);
+    return 1;
+}
+
+/* Drop the requested table, if any. */
+static void _dictCancelTable(dict *d) {
+    dictTableAlloc *req = d->alloc;
+
+    if (req == NULL) return;
+    d->alloc = NULL;
+    /* If the thread is still working, it frees the request when done. */
+    if (!_dictAllocSetState(req,DICT_ALLOC_PENDING,DICT_ALLOC_CANCELED)) {
+        zfree(req->table);
+        zfree(req);
+    }
 }
 
 /* Create a new hash table */
@@ -237,6 +685,9 @@ int _dictInit(dict *d, dictType *type,
     // ֵİȫ
     d->iterators = 0;
 
+    // ų̂߳ϣ
+    d->alloc = NULL;
+
     return DICT_OK;
 }
 
@@ -294,6 +745,14 @@ int dictExpand(dict *d, unsigned long size)
     // T = O(1)
     unsigned long realsize = _dictNextPower(size);
 
+    // ѰַϣλҪ size 
+    if (d->type->openAddressing) {
+        if (dictIsRehashing(d) || d->ht[0].used > size)
+            return DICT_ERR;
+        _dictOpenExpand(d,_dictOpenNextSize(size));
+        return DICT_OK;
+    }
+
     /* the size is invalid if it is smaller than the number of
      * elements already inside the hash table */
     // ֵ rehash ʱ
@@ -301,6 +760,9 @@ int dictExpand(dict *d, unsigned long size)
     if (dictIsRehashing(d) || d->ht[0].used > size)
         return DICT_ERR;
 
+    // ȡ̨߳Ĺϣ
+    _dictCancelTable(d);
+
     /* Allocate the new hash table and initialize all pointers to NULL */
     // Ϊϣռ䣬ָָ NULL
     n.size = realsize;
@@ -366,6 +828,9 @@ int dictRehash(dict *d, int n) {
     // ֻ rehash ʱִ
     if (!dictIsRehashing(d)) return 0;
 
+    // ѰַϣÿǨһλ
+    if (d->type->openAddressing) return _dictOpenRehash(d,n);
+
     //  N Ǩ
     // T = O(N)
     while(n--) {
@@ -442,6 +907,18 @@ long long timeInMilliseconds(void) {
     return (((long long)tv.tv_sec)*1000)+(tv.tv_usec/1000);
 }
 
+/*
+ * ΢Ϊλ UNIX ʱ
+ *
+ * T = O(1)
+ */
+static long long timeInMicroseconds(void) {
+    struct timeval tv;
+
+    gettimeofday(&tv,NULL);
+    return (((long long)tv.tv_sec)*1000000)+tv.tv_usec;
+}
+
 /* Rehash for an amount of time between ms milliseconds and ms+1 milliseconds */
 /*
  * ڸڣ 100 Ϊλֵ rehash 
@@ -451,14 +928,20 @@ long long timeInMilliseconds(void) {
     //rehashΪrehashdictRehashMillisecondsҲǶʱȥrehashеKVʱ䲻һֱǨƵht[1],
     //һɿͻ˷ʵʱ򱻶rehash_dictRehashStep
 int dictRehashMilliseconds(dict *d, int ms) {
+    return dictRehashMicroseconds(d,(long long)ms*1000);
+}
+
+/* Rehash for an amount of time between us and us+(time of 100 steps)
+ * microseconds. Returns the number of steps done. */
+int dictRehashMicroseconds(dict *d, long long us) {
     // ¼ʼʱ
-    long long start = timeInMilliseconds();
+    long long start = timeInMicroseconds();
     int rehashes = 0;
 
     while(dictRehash(d,100)) {
         rehashes += 100;
         // ʱѹ
-        if (timeInMilliseconds()-start > ms) break;
+        if (timeInMicroseconds()-start > us) break;
     }
 
     return rehashes;
@@ -552,6 +1035,18 @@ dictEntry *dictAddRaw(dict *d, void *key)
     // T = O(1)
     if (dictIsRehashing(d)) _dictRehashStep(d);
 
+    // Ѱַϣʱռһвλ
+    if (d->type->openAddressing) {
+        unsigned int h = dictHashKey(d, key);
+        dictSlot *s;
+
+        if (_dictOpenLookup(d,key,h)) return NULL;
+        _dictOpenExpandIfNeeded(d);
+        s = _dictOpenInsert(dictIsRehashing(d) ? &d->ht[1] : &d->ht[0],h);
+        dictSetKey(d, s, key);
+        return (dictEntry*)s;
+    }
+
     /* Get the index of the new element, or -1 if
      * the element already exists. */
     // ڹϣеֵ
@@ -681,6 +1176,26 @@ static int dictGenericDelete(dict *d, const void *key, int nofree)
     // ϣֵ
     h = dictHashKey(d, key);
 
+    // ѰַϣͷżֵȻͷŲλ
+    if (d->type->openAddressing) {
+        for (table = 0; table <= 1; table++) {
+            dictSlot *s;
+
+            if (d->ht[table].used &&
+                (s = _dictOpenFind(d,&d->ht[table],key,h)) != NULL)
+            {
+                if (!nofree) {
+                    dictFreeKey(d, s);
+                    dictFreeVal(d, s);
+                }
+                _dictOpenRemove(&d->ht[table],s);
+                return DICT_OK;
+            }
+            if (!dictIsRehashing(d)) break;
+        }
+        return DICT_ERR; /* not found */
+    }
+
     // ϣ
     // T = O(1)
     for (table = 0; table <= 1; table++) {
@@ -766,6 +1281,11 @@ int dictDeleteNoFree(dict *ht, const void *key) {
 int _dictClear(dict *d, dictht *ht, void(callback)(void *)) {
     unsigned long i;
 
+    if (d->type->openAddressing) {
+        _dictOpenClear(d,ht,callback);
+        return DICT_OK;
+    }
+
     /* Free all the elements */
     // ϣ
     // T = O(N)
@@ -815,6 +1335,7 @@ int _dictClear(dict *d, dictht *ht, void(callback)(void *)) {
  */
 void dictRelease(dict *d)
 {
+    _dictCancelTable(d);
     // ɾϣ
     _dictClear(d,&d->ht[0],NULL);
     _dictClear(d,&d->ht[1],NULL);
@@ -842,6 +1363,10 @@ dictEntry *dictFind(dict *d, const void *key)
 
     // Ĺϣֵ
     h = dictHashKey(d, key);
+
+    if (d->type->openAddressing)
+        return (dictEntry*)_dictOpenLookup(d,key,h);
+
     // ֵĹϣв
     // T = O(1)
     for (table = 0; table <= 1; table++) {
@@ -870,6 +1395,161 @@ dictEntry *dictFind(dict *d, const void *key)
     return NULL;
 }
 
+
+/* Number of keys dictFindBatch() looks up in parallel. */
+#define DICT_FIND_BATCH 16
+
+/* dictFindBatch() for open addressing tables: first the control bytes of
+ * the home groups are prefetched, then the slots whose control byte
+ * matches, then their key and value. */
+static void _dictOpenFindBatch(dict *d, void **keys, int count, dictEntry **entries) {
+    unsigned int h[DICT_FIND_BATCH];
+    int start, n, j, table, tables = dictIsRehashing(d) ? 2 : 1;
+
+    for (start = 0; start < count; start += n) {
+        n = count-start;
+        if (n > DICT_FIND_BATCH) n = DICT_FIND_BATCH;
+
+        /* Hash the keys and prefetch the control bytes of their groups. */
+        // ĹϣֵԤȡʼĿֽ
+        for (j = 0; j < n; j++) {
+            h[j] = dictHashKey(d, keys[start+j]);
+            for (table = 0; table < tables; table++) {
+                dictht *ht = &d->ht[table];
+
+                redis_prefetch(ht->ctrl+(h[j] & dictOpenGroupMask(ht))*DICT_GROUP_SIZE);
+            }
+        }
+
+        /* Prefetch the first matching slot of every group, then its key
+         * and its value. */
+        // ԤȡֽƥĲλȻԤȡλļֵ
+        for (j = 0; j < n; j++) {
+            for (table = 0; table < tables; table++) {
+                dictht *ht = &d->ht[table];
+                unsigned long g = h[j] & dictOpenGroupMask(ht);
+                unsigned int match = _dictGroupMatch(ht->ctrl+g*DICT_GROUP_SIZE,dictOpenCtrl(h[j]));
+
+                if (match) redis_prefetch(dictOpenSlots(ht)+g*DICT_GROUP_SIZE+_dictGroupFirst(match));
+            }
+        }
+        for (j = 0; j < n; j++) {
+            for (table = 0; table < tables; table++) {
+                dictht *ht = &d->ht[table];
+                unsigned long g = h[j] & dictOpenGroupMask(ht);
+                unsigned int match = _dictGroupMatch(ht->ctrl+g*DICT_GROUP_SIZE,dictOpenCtrl(h[j]));
+
+                if (match) {
+                    dictSlot *s = dictOpenSlots(ht)+g*DICT_GROUP_SIZE+_dictGroupFirst(match);
+
+                    redis_prefetch(s->key);
+                    redis_prefetch(s->v.val);
+                }
+            }
+        }
+
+        /* Compare the keys. */
+        // ȶԼ
+        for (j = 0; j < n; j++)
+            entries[start+j] = (dictEntry*)_dictOpenLookup(d,keys[start+j],h[j]);
+    }
+}
+
+/*
+ * Look up 'count' keys at once, setting entries[j] to the entry of keys[j],
+ * or to NULL if the key is not there. The result is the same as calling
+ * dictFind() for every key.
+ *
+ * һβҶͶÿ dictFind() ͬ
+ *
+ * A single lookup is a chain of dependent cache misses: the bucket, the
+ * entry, the key to compare. Here every step is done for a group of keys
+ * before the next one, prefetching what the next step reads: first all
+ * the keys are hashed and their buckets prefetched, then the first entry
+ * of every bucket, then the key and value of those entries, and finally
+ * the keys are compared. The misses of a group overlap, so lookups of
+ * many keys that are not in the cache are bound by memory bandwidth
+ * rather than by memory latency.
+ *
+ * һ໥ĻȱʧͰڵ㡢
+ * ÿһһУԤȡһҪȡڴ棬ʹȱʧ໥ص
+ *
+ * T = O(N)
+ */
+void dictFindBatch(dict *d, void **keys, int count, dictEntry **entries) {
+    unsigned long idx[DICT_FIND_BATCH][2];
+    dictEntry *he;
+    int start, n, j, table, tables;
+
+    /* Do the same rehashing work 'count' calls to dictFind() would do, but
+     * before the lookups, so that the tables don't change under them. */
+    //  count  dictFind() һе rehash ڲ֮ǰ
+    for (j = 0; j < count && dictIsRehashing(d); j++) _dictRehashStep(d);
+
+    // ֵ䣨ĹϣΪ
+    if (d->ht[0].size == 0) {
+        for (j = 0; j < count; j++) entries[j] = NULL;
+        return;
+    }
+    if (d->type->openAddressing) {
+        _dictOpenFindBatch(d,keys,count,entries);
+        return;
+    }
+    tables = dictIsRehashing(d) ? 2 : 1;
+
+    for (start = 0; start < count; start += n) {
+        n = count-start;
+        if (n > DICT_FIND_BATCH) n = DICT_FIND_BATCH;
+
+        /* Hash the keys and prefetch their buckets. */
+        // ĹϣֵԤȡӦͰ
+        for (j = 0; j < n; j++) {
+            unsigned int h = dictHashKey(d, keys[start+j]);
+
+            for (table = 0; table < tables; table++) {
+                idx[j][table] = h & d->ht[table].sizemask;
+                redis_prefetch(&d->ht[table].table[idx[j][table]]);
+            }
+        }
+
+        /* Prefetch the first entry of every bucket. */
+        // ԤȡͰеĵһڵ
+        for (j = 0; j < n; j++) {
+            for (table = 0; table < tables; table++) {
+                he = d->ht[table].table[idx[j][table]];
+                if (he) redis_prefetch(he);
+            }
+        }
+
+        /* Prefetch the key and the value of those entries. */
+        // Ԥȡڵļֵ
+        for (j = 0; j < n; j++) {
+            for (table = 0; table < tables; table++) {
+                he = d->ht[table].table[idx[j][table]];
+                if (he) {
+                    redis_prefetch(he->key);
+                    redis_prefetch(he->v.val);
+                }
+            }
+        }
+
+        /* Compare the keys, walking the rest of the chains if needed. */
+        // ȶԼҪĻеڵ
+        for (j = 0; j < n; j++) {
+            entries[start+j] = NULL;
+            for (table = 0; table < tables; table++) {
+                he = d->ht[table].table[idx[j][table]];
+                while(he && !dictCompareKeys(d, keys[start+j], he->key))
+                    he = he->next;
+                if (he) {
+                    entries[start+j] = he;
+                    break;
+                }
+            }
+        }
+    }
+}
+
 /*
  * ȡĽڵֵ
  *
@@ -897,10 +1577,11 @@ long long dictFingerprint(dict *d) {
     long long integers[6], hash = 0;
     int j;
 
-    integers[0] = (long) d->ht[0].table;
+    /* Only one of 'table' and 'ctrl' is set, depending on the dict type. */
+    integers[0] = (long) d->ht[0].table + (long) d->ht[0].ctrl;
     integers[1] = d->ht[0].size;
     integers[2] = d->ht[0].used;
-    integers[3] = (long) d->ht[1].table;
+    integers[3] = (long) d->ht[1].table + (long) d->ht[1].ctrl;
     integers[4] = d->ht[1].size;
     integers[5] = d->ht[1].used;
 
@@ -1006,7 +1687,11 @@ dictEntry *dictNext(dictIterator *iter)
 
             // е˵ϣδ
             // ½ڵָ룬ָ¸ıͷڵ
-            iter->entry = ht->table[iter->index];
+            if (iter->d->type->openAddressing)
+                iter->entry = (ht->ctrl[iter->index] & 0x80) ? NULL :
+                              (dictEntry*)(dictOpenSlots(ht)+iter->index);
+            else
+                iter->entry = ht->table[iter->index];
         } else {
             // ִе˵ڵĳ
             // ڵָָ¸ڵ
@@ -1018,7 +1703,8 @@ dictEntry *dictNext(dictIterator *iter)
         if (iter->entry) {
             /* We need to save the 'next' here, the iterator user
              * may delete the entry we are returning. */
-            iter->nextEntry = iter->entry->next;
+            iter->nextEntry = iter->d->type->openAddressing ?
+                              NULL : iter->entry->next;
             return iter->entry;
         }
     }
@@ -1069,6 +1755,26 @@ dictEntry *dictGetRandomKey(dict *d)
     // е rehash
     if (dictIsRehashing(d)) _dictRehashStep(d);
 
+    // Ѱַϣѡλֱҵһǿղλ
+    if (d->type->openAddressing) {
+        dictht *ht;
+        unsigned long i;
+
+        do {
+            ht = &d->ht[0];
+            if (dictIsRehashing(d)) {
+                i = random() % (d->ht[0].size+d->ht[1].size);
+                if (i >= ht->size) {
+                    i -= ht->size;
+                    ht = &d->ht[1];
+                }
+            } else {
+                i = random() & ht->sizemask;
+            }
+        } while(ht->ctrl[i] & 0x80);
+        return (dictEntry*)(dictOpenSlots(ht)+i);
+    }
+
     //  rehash ô 1 ŹϣҲΪҵĿ
     if (dictIsRehashing(d)) {
         // T = O(N)
@@ -1142,7 +1848,20 @@ int dictGetRandomKeys(dict *d, dictEntry **des, int count) {
 
             /* Make sure to visit every bucket by iterating 'size' times. */
             while(size--) {
-                dictEntry *he = d->ht[j].table[i];
+                dictEntry *he;
+
+                if (d->type->openAddressing) {
+                    /* Collect the full slots. */
+                    if (!(d->ht[j].ctrl[i] & 0x80)) {
+                        *des = (dictEntry*)(dictOpenSlots(&d->ht[j])+i);
+                        des++;
+                        stored++;
+                        if (stored == count) return stored;
+                    }
+                    i = (i+1) & d->ht[j].sizemask;
+                    continue;
+                }
+                he = d->ht[j].table[i];
                 while (he) {
                     /* Collect all the elements of the buckets found non
                      * empty while iterating. */
@@ -1174,6 +1893,28 @@ static unsigned long rev(unsigned long v) {
     return v;
 }
 
+/* The buckets dictScan() iterates are the home groups of the keys in open
+ * addressing tables. */
+#define _dictScanMask(d,ht) \
+    ((d)->type->openAddressing ? dictOpenGroupMask(ht) : (ht)->sizemask)
+
+/* Calls 'fn' for every element of bucket 'idx'. */
+static void _dictScanBucket(dict *d, dictht *ht, unsigned long idx,
+                            dictScanFunction *fn, void *privdata)
+{
+    const dictEntry *de;
+
+    if (d->type->openAddressing) {
+        _dictOpenScanGroup(d,ht,idx,fn,privdata);
+        return;
+    }
+    de = ht->table[idx];
+    while (de) {
+        fn(privdata, de);
+        de = de->next;
+    }
+}
+
 /* dictScan() is used to iterate over the elements of a dictionary.
  *
  * dictScan() ڵֵеԪء
@@ -1318,7 +2059,6 @@ unsigned long dictScan(dict *d,
                        void *privdata)
 {
     dictht *t0, *t1;
-    const dictEntry *de;
     unsigned long m0, m1;
 
     // ֵ
@@ -1331,16 +2071,11 @@ unsigned long dictScan(dict *d,
         t0 = &(d->ht[0]);
 
         // ¼ mask
-        m0 = t0->sizemask;
+        m0 = _dictScanMask(d,t0);
 
         /* Emit entries at cursor */
-        // ָϣͰ
-        de = t0->table[v & m0];
         // Ͱенڵ
-        while (de) {
-            fn(privdata, de);
-            de = de->next;
-        }
+        _dictScanBucket(d,t0,v & m0,fn,privdata);
 
     // ϣֵ
     } else {
@@ -1357,16 +2092,12 @@ unsigned long dictScan(dict *d,
         }
 
         // ¼
-        m0 = t0->sizemask;
-        m1 = t1->sizemask;
+        m0 = _dictScanMask(d,t0);
+        m1 = _dictScanMask(d,t1);
 
         /* Emit entries at cursor */
         // ָͰͰенڵ
-        de = t0->table[v & m0];
-        while (de) {
-            fn(privdata, de);
-            de = de->next;
-        }
+        _dictScanBucket(d,t0,v & m0,fn,privdata);
 
         /* Iterate over indices in larger table that are the expansion
          * of the index pointed to by the cursor in the smaller table */
@@ -1376,11 +2107,7 @@ unsigned long dictScan(dict *d,
         do {
             /* Emit entries at cursor */
             // ָͰͰенڵ
-            de = t1->table[v & m1];
-            while (de) {
-                fn(privdata, de);
-                de = de->next;
-            }
+            _dictScanBucket(d,t1,v & m1,fn,privdata);
 
             /* Increment bits not covered by the smaller mask */
             v = (((v | m0) + 1) & ~m0) | (v & m0);
@@ -1433,6 +2160,16 @@ static int _dictExpandIfNeeded(dict *d)
         (dict_can_resize ||
          d->ht[0].used/d->ht[0].size > dict_force_resize_ratio))
     {
+        // ̷̨߳¹ϣѾʼ rehash
+        if (_dictInstallTable(d)) return DICT_OK;
+
+        // ϣɺ̷̨߳䣬ֵʱ¹ϣʱ
+        // Ա䳤ֱʳ dict_force_resize_ratio
+        if (d->ht[0].used/d->ht[0].size <= dict_force_resize_ratio &&
+            (!_dictExpandAllowed(d, _dictNextPower(d->ht[0].used*2)) ||
+             _dictRequestTable(d, _dictNextPower(d->ht[0].used*2))))
+            return DICT_OK;
+
         // ¹ϣĴСĿǰʹýڵ
         // T = O(N)
         return dictExpand(d, d->ht[0].used*2);
@@ -1521,6 +2258,7 @@ static int _dictKeyIndex(dict *d, const void *key) //
  */
 void dictEmpty(dict *d, void(callback)(void*)) {
 
+    _dictCancelTable(d);
     // ɾϣϵнڵ
     // T = O(N)
     _dictClear(d,&d->ht[0],callback);
@@ -1672,3 +2410,283 @@ dictType dictTypeHeapStringCopyKeyValue = {
     _dictStringDestructor,         /* val destructor */
 };
 #endif
+
+#ifdef DICT_BENCHMARK_MAIN
+/* Build with:
+ *
+ *   cc -O2 -DDICT_BENCHMARK_MAIN dict.c sds.c zmalloc.c -o dict-benchmark
+ *
+ * './dict-benchmark [keys]' first checks open addressing dictionaries
+ * against chained ones and the tables allocated in background, then fills
+ * a chained and an open addressing dictionary with 'keys' sds keys (four
+ * millions by default, much more than the CPU caches), reports the memory
+ * used per key, and looks up groups of 100 and 1000 random keys reading
+ * every value, like MGET does, with dictFind() and with dictFindBatch(). */
+#include "sds.h"
+
+/* Normally provided by debug.c. */
+void _redisAssert(char *estr, char *file, int line) {
+    fprintf(stderr,"=== ASSERTION FAILED ===\n");
+    fprintf(stderr,"==> %s:%d '%s' is not true\n",file,line,estr);
+    exit(1);
+}
+
+static unsigned int benchHashCallback(const void *key) {
+    return dictGenHashFunction((unsigned char*)key, sdslen((sds)key));
+}
+
+static int benchCompareCallback(void *privdata, const void *key1,
+        const void *key2)
+{
+    DICT_NOTUSED(privdata);
+    return sdslen((sds)key1) == sdslen((sds)key2) &&
+           memcmp(key1, key2, sdslen((sds)key1)) == 0;
+}
+
+static dictType benchDictType = {
+    benchHashCallback,     /* hash function */
+    NULL,                  /* key dup */
+    NULL,                  /* val dup */
+    benchCompareCallback,  /* key compare */
+    NULL,                  /* key destructor */
+    NULL,                  /* val destructor */
+    0                      /* open addressing */
+};
+
+static dictType benchOpenDictType = {
+    benchHashCallback,     /* hash function */
+    NULL,                  /* key dup */
+    NULL,                  /* val dup */
+    benchCompareCallback,  /* key compare */
+    NULL,                  /* key destructor */
+    NULL,                  /* val destructor */
+    1                      /* open addressing */
+};
+
+static long long benchUstime(void) {
+    struct timeval tv;
+
+    gettimeofday(&tv,NULL);
+    return ((long long)tv.tv_sec)*1000000+tv.tv_usec;
+}
+
+#define BENCH_POOL 100000
+#define BENCH_LOOKUPS 4000000
+
+/* Check dictFindBatch() against dictFind() while the dictionary grows, so
+ * that lookups are also done while it is rehashing. */
+static void benchCheckBatch(dictType *type) {
+    dict *d = dictCreate(type,NULL);
+    void *keys[200];
+    dictEntry *entries[200];
+    int j, k, rehashing = 0;
+
+    for (j = 0; j < 200; j++) {
+        /* Half of the keys looked up are missing. */
+        keys[j] = sdscatprintf(sdsempty(),"key:%d",j);
+        if (j % 2) dictAdd(d,keys[j],NULL);
+        if (dictIsRehashing(d)) rehashing++;
+        dictFindBatch(d,keys,j+1,entries);
+        for (k = 0; k <= j; k++) assert(entries[k] == dictFind(d,keys[k]));
+    }
+    assert(rehashing > 0);
+}
+
+#define CHECK_KEYS 5000
+
+static void benchScanCallback(void *privdata, const dictEntry *de) {
+    unsigned char *seen = privdata;
+
+    seen[atoi((char*)dictGetKey(de)+4)] = 1;
+}
+
+/* Run random additions and deletions against an open addressing and a
+ * chained dictionary, growing and shrinking them, and check they always
+ * have the same content, that a safe iterator can delete while iterating,
+ * and that a scan returns all the keys that are never deleted during it. */
+static void benchCheckOpen(void) {
+    dict *d = dictCreate(&benchOpenDictType,NULL);
+    dict *ref = dictCreate(&benchDictType,NULL);
+    void *keys[CHECK_KEYS];
+    unsigned char seen[CHECK_KEYS], present[100];
+    unsigned long cursor = 0;
+    int j, k, round, scans = 0;
+
+    for (j = 0; j < CHECK_KEYS; j++)
+        keys[j] = sdscatprintf(sdsempty(),"key:%d",j);
+
+    for (round = 0; round < 40; round++) {
+        /* Even rounds fill the dictionaries, odd rounds empty them, and
+         * the multiples of 10 shrink them like serverCron() does. */
+        int fill = (round % 2) == 0, ops = CHECK_KEYS*2;
+        dictIterator *di;
+        dictEntry *de;
+
+        for (j = 0; j < ops; j++) {
+            /* Keys below 100 are never deleted. */
+            k = random() % CHECK_KEYS;
+            if (k >= 100 && (fill ? random() % 4 == 0 : random() % 4 != 0)) {
+                assert(dictDelete(d,keys[k]) == dictDelete(ref,keys[k]));
+            } else {
+                assert(dictAdd(d,keys[k],(void*)(long)k) ==
+                       dictAdd(ref,keys[k],(void*)(long)k));
+            }
+            k = random() % CHECK_KEYS;
+            de = dictFind(d,keys[k]);
+            assert((de != NULL) == (dictFind(ref,keys[k]) != NULL));
+            assert(de == NULL || dictGetVal(de) == (void*)(long)k);
+            assert(dictSize(d) == dictSize(ref));
+
+            /* Scan a few buckets from time to time. */
+            if (j % 50 == 0) {
+                if (cursor == 0) {
+                    for (k = 0; k < 100; k++)
+                        present[k] = dictFind(d,keys[k]) != NULL;
+                    memset(seen,0,sizeof(seen));
+                }
+                cursor = dictScan(d,cursor,benchScanCallback,seen);
+                if (cursor == 0) {
+                    for (k = 0; k < 100; k++) assert(!present[k] || seen[k]);
+                    scans++;
+                }
+            }
+        }
+        if (round % 10 == 0) {
+            dictResize(d);
+            while (dictIsRehashing(d)) dictRehash(d,1);
+        }
+
+        /* Iterate deleting every other key, and check the rest. */
+        k = 0;
+        di = dictGetSafeIterator(d);
+        while ((de = dictNext(di)) != NULL) {
+            assert(dictFind(ref,dictGetKey(de)) != NULL);
+            if (k++ % 2 && (long)dictGetVal(de) >= 100) {
+                dictDelete(ref,dictGetKey(de));
+                dictDelete(d,dictGetKey(de));
+            }
+        }
+        dictReleaseIterator(di);
+        assert(dictSize(d) == dictSize(ref));
+        for (j = 0; j < CHECK_KEYS; j++)
+            assert((dictFind(d,keys[j]) != NULL) == (dictFind(ref,keys[j]) != NULL));
+    }
+    assert(scans > 0);
+    dictRelease(d);
+    dictRelease(ref);
+}
+
+static dictTableAlloc *benchAllocs[16];
+static int benchAllocsPending = 0;
+
+/* Keep the requests, the test completes them later like a thread would. */
+static void benchSubmitAlloc(dictTableAlloc *req) {
+    assert(benchAllocsPending < 16);
+    benchAllocs[benchAllocsPending++] = req;
+}
+
+static void benchCompleteAllocs(void) {
+    while (benchAllocsPending)
+        dictBackgroundAlloc(benchAllocs[--benchAllocsPending]);
+}
+
+/* Grow dictionaries with tables allocated in background, completing the
+ * requests at random times, also after the dictionary canceled them. */
+static void benchCheckBackground(dictType *type) {
+    dict *d = dictCreate(type,NULL);
+    int j, installed = 0, pending = 0;
+
+    dictSetBackgroundAlloc(1,benchSubmitAlloc);
+    for (j = 0; j < 100000; j++) {
+        void *key = sdscatprintf(sdsempty(),"key:%d",j);
+        int rehashing = dictIsRehashing(d);
+
+        dictAdd(d,key,NULL);
+        if (!rehashing && dictIsRehashing(d)) installed++;
+        if (dictIsTablePending(d)) pending++;
+        if (random() % 1000 == 0) benchCompleteAllocs();
+        if (j % 10000 == 0) {
+            /* Resizing cancels any request. */
+            while (dictIsRehashing(d)) dictRehash(d,100);
+            dictResize(d);
+        }
+        assert(dictFind(d,key) != NULL);
+    }
+    for (j = 0; j < 100000; j += 97) {
+        sds key = sdscatprintf(sdsempty(),"key:%d",j);
+
+        assert(dictFind(d,key) != NULL);
+        sdsfree(key);
+    }
+    assert(dictSize(d) == 100000 && installed > 0 && pending > 0);
+    dictRelease(d);
+    benchCompleteAllocs();
+    dictSetBackgroundAlloc(0,NULL);
+}
+
+int main(int argc, char **argv) {
+    long keys = (argc > 1) ? atol(argv[1]) : 4000000, j;
+    int sizes[] = {100, 1000}, s, k, batch, t;
+    dictType *types[] = {&benchDictType, &benchOpenDictType};
+    void **pool = zmalloc(sizeof(void*)*BENCH_POOL);
+    dictEntry **entries = zmalloc(sizeof(dictEntry*)*1000);
+
+    benchCheckBatch(&benchDictType);
+    benchCheckBatch(&benchOpenDictType);
+    printf("dictFindBatch() returns the same entries as dictFind()\n");
+    benchCheckOpen();
+    printf("Open addressing dictionaries behave like chained ones\n");
+    benchCheckBackground(&benchDictType);
+    benchCheckBackground(&benchOpenDictType);
+    printf("Tables allocated in background are installed when ready\n");
+
+    /* The keys to look up are copies, like the arguments of a command,
+     * and fit in the cache. */
+    for (j = 0; j < BENCH_POOL; j++)
+        pool[j] = sdscatprintf(sdsempty(),"key:%ld",random() % keys);
+
+    printf("%ld keys, %d random lookups per test:\n", keys, BENCH_LOOKUPS);
+    for (t = 0; t < 2; t++) {
+        dict *d = dictCreate(types[t],NULL);
+        size_t used = zmalloc_used_memory();
+
+        for (j = 0; j < keys; j++) {
+            long *val = zmalloc(sizeof(long));
+
+            *val = j;
+            dictAdd(d,sdscatprintf(sdsempty(),"key:%ld",j),val);
+        }
+        while (dictIsRehashing(d)) dictRehash(d,100);
+        printf("%s: %.1f bytes/key for the table, keys and values\n",
+            t ? "open addressing" : "chained",
+            (double)(zmalloc_used_memory()-used)/keys);
+
+        for (s = 0; s < 2; s++) {
+            for (batch = 0; batch <= 1; batch++) {
+                long long start, elapsed, sum = 0;
+
+                /* Same keys for every test, so the checksums match. */
+                srandom(s);
+                start = benchUstime();
+                for (j = 0; j < BENCH_LOOKUPS/sizes[s]; j++) {
+                    void **query = pool+(random() % (BENCH_POOL-sizes[s]));
+
+                    if (batch) {
+                        dictFindBatch(d,query,sizes[s],entries);
+                    } else {
+                        for (k = 0; k < sizes[s]; k++)
+                            entries[k] = dictFind(d,query[k]);
+                    }
+                    for (k = 0; k < sizes[s]; k++)
+                        sum += *(long*)dictGetVal(entries[k]);
+                }
+                elapsed = benchUstime()-start;
+                printf("  groups of %4d keys, %-15s %6.1f ns/key (checksum %lld)\n",
+                    sizes[s], batch ? "dictFindBatch():" : "dictFind():",
+                    (double)elapsed*1000/BENCH_LOOKUPS, sum);
+            }
+        }
+    }
+    return 0;
+}
+#endif
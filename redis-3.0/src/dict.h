@@ -93,6 +93,7 @@ typedef struct dictEntry {
         void *val;
         uint64_t u64;
         int64_t s64;//һ¼ǹڼdb->expiresÿĹʱ  λms
+        double d;//򼯺ֵгԱķֵ
     } v;//Ӧһrobj
 
     
@@ -103,6 +104,26 @@ typedef struct dictEntry {
 
 } dictEntry;
 
+/*
+ * ѰַϣĲλ
+ *
+ * Slot of an open addressing table. It has the same layout as the start of
+ * dictEntry, so the functions of an open addressing dictionary return slots
+ * as dictEntry pointers, and the dictGetKey() / dictGetVal() family of
+ * macros works with both. The 'next' field of those entries must not be
+ * used. A slot moves when its table is rehashed, so these entries are only
+ * valid until the next operation on the dictionary.
+ */
+typedef struct dictSlot {
+    void *key;
+    union {
+        void *val;
+        uint64_t u64;
+        int64_t s64;
+        double d;
+    } v;
+} dictSlot;
+
 
 /*
  * ֵض
@@ -127,6 +148,13 @@ typedef struct dictType {//
     // ֵĺ // ֵ͹  dictFreeVal  ɾhashеkeyڵʱִиúɾvalue
     void (*valDestructor)(void *privdata, void *obj);//dictFreeVal
 
+    // ΪʱʹÿѰַϣ dict.c е open addressing tables
+    int openAddressing;
+
+    // ѡ 0 ʱݲ moreMem ֽڵĸϣ
+    // ȻԼ䣬ֱشﵽ
+    int (*expandAllowed)(size_t moreMem);
+
 } dictType;
 
 
@@ -282,6 +310,12 @@ typedef struct dictht {//dictht hashͰ
     // ùϣнڵ
     unsigned long used;
 
+    // ѰַϣĿֽ飬λ
+    unsigned char *ctrl;
+
+    // ѰַϣбΪɾĲλ
+    unsigned long deleted;
+
 } dictht;
 
 /*
@@ -342,6 +376,9 @@ typedef struct dict {//dictCreate
     // Ŀǰеİȫ
     int iterators; /* number of iterators currently running */
 
+    // ̨߳¹ϣûʱΪ NULL
+    struct dictTableAlloc *alloc; /* table being allocated in background */
+
 } dict; //dictռ䴴ʼdictExpandһ_dictExpandIfNeededif->dictExpand(d, DICT_HT_INITIAL_SIZE);
 
 /* If safe is set to 1 this is a safe iterator, that means, you can call
@@ -379,6 +416,27 @@ typedef struct dictIterator {
 
 typedef void (dictScanFunction)(void *privdata, const dictEntry *de);
 
+/*
+ * ɺ̷̨߳Ĺϣ
+ *
+ * A hash table allocated and initialized by a background thread, so that
+ * growing a big dictionary doesn't stop the main thread. The dictionary
+ * keeps using its current table until the new one is ready, see
+ * dictSetBackgroundAlloc().
+ */
+#define DICT_ALLOC_PENDING 0    /* The thread didn't allocate it yet. */
+#define DICT_ALLOC_READY 1      /* The thread set 'table'. */
+#define DICT_ALLOC_CANCELED 2   /* The dictionary doesn't want it anymore. */
+
+typedef struct dictTableAlloc {
+    unsigned long size;     /* Buckets or slots of the table. */
+    size_t bytes;           /* Bytes to allocate. */
+    size_t fill;            /* Bytes to set to 'fillbyte' from the start. */
+    int fillbyte;
+    void *table;            /* The table, once allocated. */
+    int state;              /* DICT_ALLOC_* */
+} dictTableAlloc;
+
 /* This is the initial size of every hash table */
 /*
  * ϣĳʼС
@@ -407,6 +465,10 @@ typedef void (dictScanFunction)(void *privdata, const dictEntry *de);
 #define dictSetUnsignedIntegerVal(entry, _val_) \
     do { entry->v.u64 = _val_; } while(0)
 
+// һ˫ȸΪڵֵ
+#define dictSetDoubleVal(entry, _val_) \
+    do { entry->v.d = _val_; } while(0)
+
 //dictTypeҪxxxDictType(dbDictType zsetDictType setDictType)
 // ͷŸֵڵļ
 #define dictFreeKey(d, entry) \
@@ -441,12 +503,20 @@ typedef void (dictScanFunction)(void *privdata, const dictEntry *de);
 #define dictGetSignedIntegerVal(he) ((he)->v.s64)
 // ظڵ޷ֵ
 #define dictGetUnsignedIntegerVal(he) ((he)->v.u64)
+// ظڵ˫ȸֵ
+#define dictGetDoubleVal(he) ((he)->v.d)
 // ظֵĴС   hashͰĸ
 #define dictSlots(d) ((d)->ht[0].size+(d)->ht[1].size)
 // ֵнڵ  Ͱнڵ֮
 #define dictSize(d) ((d)->ht[0].used+(d)->ht[1].used)
 // 鿴ֵǷ rehash
 #define dictIsRehashing(ht) ((ht)->rehashidx != -1)
+// 鿴ֵǷڵȴ̷̨߳¹ϣ
+#define dictIsTablePending(d) ((d)->alloc != NULL)
+// ͣ/ֵָĽʽ rehash ͣڼҲ޸ֵ䣬
+// ˶߳̿ͬʱȡֵ
+#define dictPauseRehashing(d) ((d)->iterators++)
+#define dictResumeRehashing(d) ((d)->iterators--)
 
 /* API */
 dict *dictCreate(dictType *type, void *privDataPtr);
@@ -459,6 +529,7 @@ int dictDelete(dict *d, const void *key);
 int dictDeleteNoFree(dict *d, const void *key);
 void dictRelease(dict *d);
 dictEntry * dictFind(dict *d, const void *key);
+void dictFindBatch(dict *d, void **keys, int count, dictEntry **entries);
 void *dictFetchValue(dict *d, const void *key);
 int dictResize(dict *d);
 dictIterator *dictGetIterator(dict *d);
@@ -475,6 +546,9 @@ void dictEnableResize(void);
 void dictDisableResize(void);
 int dictRehash(dict *d, int n);
 int dictRehashMilliseconds(dict *d, int ms);
+int dictRehashMicroseconds(dict *d, long long us);
+void dictSetBackgroundAlloc(size_t threshold, void (*submit)(dictTableAlloc *req));
+void dictBackgroundAlloc(dictTableAlloc *req);
 void dictSetHashFunctionSeed(unsigned int initval);
 unsigned int dictGetHashFunctionSeed(void);
 unsigned long dictScan(dict *d, unsigned long v, dictScanFunction *fn, void *privdata);
@@ -497,64 +497,130 @@ int hllDenseAdd(uint8_t *registers, unsigned char *ele, size_t elesize) {
     }
 }
 
-/* Compute SUM(2^-reg) in the dense representation.
- * PE is an array with a pre-computer table of values 2^-reg indexed by reg.
- * As a side effect the integer pointed by 'ezp' is set to the number
- * of zero registers. */
-double hllDenseSum(uint8_t *registers, double *PE, int *ezp) {
-    double E = 0;
-    int j, ez = 0;
-
-    /* Redis default is to use 16384 registers 6 bits each. The code works
-     * with other values by modifying the defines, but for our target value
-     * we take a faster path with unrolled loops. */
-    if (HLL_REGISTERS == 16384 && HLL_BITS == 6) {
-        uint8_t *r = registers;
-        unsigned long r0, r1, r2, r3, r4, r5, r6, r7, r8, r9,
-                      r10, r11, r12, r13, r14, r15;
-        for (j = 0; j < 1024; j++) {
-            /* Handle 16 registers per iteration. */
-            r0 = r[0] & 63; if (r0 == 0) ez++;
-            r1 = (r[0] >> 6 | r[1] << 2) & 63; if (r1 == 0) ez++;
-            r2 = (r[1] >> 4 | r[2] << 4) & 63; if (r2 == 0) ez++;
-            r3 = (r[2] >> 2) & 63; if (r3 == 0) ez++;
-            r4 = r[3] & 63; if (r4 == 0) ez++;
-            r5 = (r[3] >> 6 | r[4] << 2) & 63; if (r5 == 0) ez++;
-            r6 = (r[4] >> 4 | r[5] << 4) & 63; if (r6 == 0) ez++;
-            r7 = (r[5] >> 2) & 63; if (r7 == 0) ez++;
-            r8 = r[6] & 63; if (r8 == 0) ez++;
-            r9 = (r[6] >> 6 | r[7] << 2) & 63; if (r9 == 0) ez++;
-            r10 = (r[7] >> 4 | r[8] << 4) & 63; if (r10 == 0) ez++;
-            r11 = (r[8] >> 2) & 63; if (r11 == 0) ez++;
-            r12 = r[9] & 63; if (r12 == 0) ez++;
-            r13 = (r[9] >> 6 | r[10] << 2) & 63; if (r13 == 0) ez++;
-            r14 = (r[10] >> 4 | r[11] << 4) & 63; if (r14 == 0) ez++;
-            r15 = (r[11] >> 2) & 63; if (r15 == 0) ez++;
-
-            /* Additional parens will allow the compiler to optimize the
-             * code more with a loss of precision that is not very relevant
-             * here (floating point math is not commutative!). */
-            E += (PE[r0] + PE[r1]) + (PE[r2] + PE[r3]) + (PE[r4] + PE[r5]) +
-                 (PE[r6] + PE[r7]) + (PE[r8] + PE[r9]) + (PE[r10] + PE[r11]) +
-                 (PE[r12] + PE[r13]) + (PE[r14] + PE[r15]);
-            r += 12;
-        }
+/* Dense register kernels.
+ *
+ * PFCOUNT with multiple keys and PFMERGE unpack the 6 bit registers of every
+ * dense HLL into an array of bytes, computing MAX(max[i],reg[i]). Every 3
+ * bytes hold 4 registers, so the scalar kernel unpacks 4 registers per step.
+ * On x86-64 the AVX2 kernel unpacks 32 registers per step: the 24 bytes are
+ * spread into 8 lanes of 32 bits with a shuffle, then every register is
+ * shifted to its own byte and merged with a single VPMAXUB. The best kernel
+ * the CPU supports is selected by hllInitKernels() at startup.
+ *
+ * The kernels require HLL_BITS to be 6 and HLL_REGISTERS to be a multiple
+ * of 32, other configurations use the generic HLL_DENSE_GET_REGISTER loop. */
+typedef void hllDenseMergeFunc(uint8_t *max, uint8_t *registers);
+
+static void hllDenseMergeScalar(uint8_t *max, uint8_t *registers) {
+    uint8_t *r = registers;
+    uint8_t r0, r1, r2, r3;
+    int i;
+
+    for (i = 0; i < HLL_REGISTERS; i += 4) {
+        r0 = r[0] & 63;
+        r1 = (r[0] >> 6 | r[1] << 2) & 63;
+        r2 = (r[1] >> 4 | r[2] << 4) & 63;
+        r3 = (r[2] >> 2) & 63;
+        if (r0 > max[i]) max[i] = r0;
+        if (r1 > max[i+1]) max[i+1] = r1;
+        if (r2 > max[i+2]) max[i+2] = r2;
+        if (r3 > max[i+3]) max[i+3] = r3;
+        r += 3;
+    }
+}
+
+#ifdef HAVE_X86_SIMD
+#include <immintrin.h>
+
+__attribute__((target("avx2")))
+static void hllDenseMergeAVX2(uint8_t *max, uint8_t *registers) {
+    const __m256i shuffle = _mm256_setr_epi8(
+        0,1,2,-1,3,4,5,-1,6,7,8,-1,9,10,11,-1,
+        0,1,2,-1,3,4,5,-1,6,7,8,-1,9,10,11,-1);
+    const __m256i mask0 = _mm256_set1_epi32(0x0000003f);
+    const __m256i mask1 = _mm256_set1_epi32(0x00003f00);
+    const __m256i mask2 = _mm256_set1_epi32(0x003f0000);
+    const __m256i mask3 = _mm256_set1_epi32(0x3f000000);
+    uint8_t *r = registers;
+    __m256i x, v;
+    int i;
+
+    /* Every step loads 16 bytes at r and at r+12, that is 4 bytes more
+     * than the 24 it uses: the last 32 registers are left to the scalar
+     * loop so that we never read past the end of the registers. */
+    for (i = 0; i < HLL_REGISTERS-32; i += 32) {
+        x = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm_loadu_si128((__m128i*)r)),
+                _mm_loadu_si128((__m128i*)(r+12)),1);
+        x = _mm256_shuffle_epi8(x,shuffle);
+        v = _mm256_or_si256(
+            _mm256_or_si256(_mm256_and_si256(x,mask0),
+                _mm256_and_si256(_mm256_slli_epi32(x,2),mask1)),
+            _mm256_or_si256(_mm256_and_si256(_mm256_slli_epi32(x,4),mask2),
+                _mm256_and_si256(_mm256_slli_epi32(x,6),mask3)));
+        x = _mm256_loadu_si256((__m256i*)(max+i));
+        _mm256_storeu_si256((__m256i*)(max+i),_mm256_max_epu8(x,v));
+        r += 24;
+    }
+    for (; i < HLL_REGISTERS; i += 4) {
+        uint8_t r0 = r[0] & 63;
+        uint8_t r1 = (r[0] >> 6 | r[1] << 2) & 63;
+        uint8_t r2 = (r[1] >> 4 | r[2] << 4) & 63;
+        uint8_t r3 = (r[2] >> 2) & 63;
+        if (r0 > max[i]) max[i] = r0;
+        if (r1 > max[i+1]) max[i+1] = r1;
+        if (r2 > max[i+2]) max[i+2] = r2;
+        if (r3 > max[i+3]) max[i+3] = r3;
+        r += 3;
+    }
+}
+#endif
+
+static hllDenseMergeFunc *hllDenseMergeKernel = hllDenseMergeScalar;
+
+/* Select the fastest kernels the CPU supports. */
+void hllInitKernels(void) {
+#ifdef HAVE_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        hllDenseMergeKernel = hllDenseMergeAVX2;
+#endif
+}
+
+/* Set max[i] to MAX(max[i],reg[i]) for every register of the dense
+ * representation 'registers'. */
+void hllDenseMerge(uint8_t *max, uint8_t *registers) {
+    if (HLL_BITS == 6 && HLL_REGISTERS % 32 == 0) {
+        hllDenseMergeKernel(max,registers);
     } else {
-        for (j = 0; j < HLL_REGISTERS; j++) {
-            unsigned long reg;
+        uint8_t val;
+        int i;
 
-            HLL_DENSE_GET_REGISTER(reg,registers,j);
-            if (reg == 0) {
-                ez++;
-                /* Increment E at the end of the loop. */
-            } else {
-                E += PE[reg]; /* Precomputed 2^(-reg[j]). */
-            }
+        for (i = 0; i < HLL_REGISTERS; i++) {
+            HLL_DENSE_GET_REGISTER(val,registers,i);
+            if (val > max[i]) max[i] = val;
+        }
+    }
+}
+
+/* Write the HLL_REGISTERS registers in the array of bytes 'raw' into the
+ * dense representation 'registers'. This is the inverse of hllDenseMerge()
+ * against a zeroed array, packing 4 registers into 3 bytes per step. */
+void hllDenseSetRegisters(uint8_t *registers, uint8_t *raw) {
+    int i;
+
+    if (HLL_BITS == 6 && HLL_REGISTERS % 4 == 0) {
+        uint8_t *r = registers;
+        for (i = 0; i < HLL_REGISTERS; i += 4) {
+            r[0] = raw[i] | raw[i+1] << 6;
+            r[1] = raw[i+1] >> 2 | raw[i+2] << 4;
+            r[2] = raw[i+2] >> 4 | raw[i+3] << 2;
+            r += 3;
         }
-        E += ez; /* Add 2^0 'ez' times. */
+    } else {
+        for (i = 0; i < HLL_REGISTERS; i++)
+            HLL_DENSE_SET_REGISTER(registers,i,raw[i]);
     }
-    *ezp = ez;
-    return E;
 }
 
 /* ================== Sparse representation implementation  ================= */
@@ -881,76 +947,90 @@ promote: /* Promote to dense representation. */
     return dense_retval;
 }
 
-/* Compute SUM(2^-reg) in the sparse representation.
- * PE is an array with a pre-computer table of values 2^-reg indexed by reg.
- * As a side effect the integer pointed by 'ezp' is set to the number
- * of zero registers. */
-double hllSparseSum(uint8_t *sparse, int sparselen, double *PE, int *ezp, int *invalid) {
-    double E = 0;
-    int ez = 0, idx = 0, runlen, regval;
+/* Compute the register histogram of the sparse representation: as a side
+ * effect reghisto[v] is incremented by the number of registers set to v.
+ * Every opcode describes a run of registers, so the histogram is updated
+ * once per opcode. If the representation does not cover exactly
+ * HLL_REGISTERS registers the integer pointed by 'invalid' is set to 1. */
+void hllSparseRegHisto(uint8_t *sparse, int sparselen, int *invalid, int *reghisto) {
+    int idx = 0, runlen, regval;
     uint8_t *end = sparse+sparselen, *p = sparse;
 
     while(p < end) {
         if (HLL_SPARSE_IS_ZERO(p)) {
             runlen = HLL_SPARSE_ZERO_LEN(p);
             idx += runlen;
-            ez += runlen;
-            /* Increment E at the end of the loop. */
+            reghisto[0] += runlen;
             p++;
         } else if (HLL_SPARSE_IS_XZERO(p)) {
             runlen = HLL_SPARSE_XZERO_LEN(p);
             idx += runlen;
-            ez += runlen;
-            /* Increment E at the end of the loop. */
+            reghisto[0] += runlen;
             p += 2;
         } else {
             runlen = HLL_SPARSE_VAL_LEN(p);
             regval = HLL_SPARSE_VAL_VALUE(p);
             idx += runlen;
-            E += PE[regval]*runlen;
+            reghisto[regval] += runlen;
             p++;
         }
     }
     if (idx != HLL_REGISTERS && invalid) *invalid = 1;
-    E += ez; /* Add 2^0 'ez' times. */
-    *ezp = ez;
-    return E;
 }
 
 /* ========================= HyperLogLog Count ==============================
  * This is the core of the algorithm where the approximated count is computed.
- * The function uses the lower level hllDenseSum() and hllSparseSum() functions
- * as helpers to compute the SUM(2^-reg) part of the computation, which is
- * representation-specific, while all the rest is common. */
-
-/* Implements the SUM operation for uint8_t data type which is only used
- * internally as speedup for PFCOUNT with multiple keys. */
-double hllRawSum(uint8_t *registers, double *PE, int *ezp) {
-    double E = 0;
-    int j, ez = 0;
-    uint64_t *word = (uint64_t*) registers;
-    uint8_t *bytes;
-
+ * The function uses the lower level hllDenseRegHisto(), hllSparseRegHisto()
+ * and hllRawRegHisto() functions as helpers to compute the histogram of the
+ * register values, which is representation-specific, while all the rest is
+ * common.
+ *
+ * SUM(2^-reg) is computed from the histogram. Since every term is a power
+ * of two, the sum is exact in any order as long as no register is greater
+ * than 38 (53 bits of mantissa for sums up to 2^14), so the result is the
+ * same as summing the registers one by one would produce. */
+
+/* Compute the register histogram of an uint8_t array of HLL_REGISTERS
+ * registers, which is only used internally as speedup for PFCOUNT with
+ * multiple keys. Four histograms are updated in turn so that consecutive
+ * registers with the same value do not wait for each other, and words of
+ * 8 zero registers are counted at once. */
+void hllRawRegHisto(uint8_t *registers, int *reghisto) {
+    int histo[4][HLL_REGISTER_MAX+1];
+    int j, v, ez = 0;
+    uint64_t word;
+    uint8_t *bytes = registers;
+
+    memset(histo,0,sizeof(histo));
     for (j = 0; j < HLL_REGISTERS/8; j++) {
-        if (*word == 0) {
+        memcpy(&word,bytes,sizeof(word));
+        if (word == 0) {
             ez += 8;
         } else {
-            bytes = (uint8_t*) word;
-            if (bytes[0]) E += PE[bytes[0]]; else ez++;
-            if (bytes[1]) E += PE[bytes[1]]; else ez++;
-            if (bytes[2]) E += PE[bytes[2]]; else ez++;
-            if (bytes[3]) E += PE[bytes[3]]; else ez++;
-            if (bytes[4]) E += PE[bytes[4]]; else ez++;
-            if (bytes[5]) E += PE[bytes[5]]; else ez++;
-            if (bytes[6]) E += PE[bytes[6]]; else ez++;
-            if (bytes[7]) E += PE[bytes[7]]; else ez++;
+            histo[0][bytes[0]]++;
+            histo[1][bytes[1]]++;
+            histo[2][bytes[2]]++;
+            histo[3][bytes[3]]++;
+            histo[0][bytes[4]]++;
+            histo[1][bytes[5]]++;
+            histo[2][bytes[6]]++;
+            histo[3][bytes[7]]++;
         }
-        word++;
+        bytes += 8;
     }
-    E += ez; /* 2^(-reg[j]) is 1 when m is 0, add it 'ez' times for every
-                zero register in the HLL. */
-    *ezp = ez;
-    return E;
+    reghisto[0] += ez;
+    for (v = 0; v <= HLL_REGISTER_MAX; v++)
+        reghisto[v] += histo[0][v]+histo[1][v]+histo[2][v]+histo[3][v];
+}
+
+/* Compute the register histogram of the dense representation, unpacking
+ * the registers with the merge kernel first. */
+void hllDenseRegHisto(uint8_t *registers, int *reghisto) {
+    uint8_t raw[HLL_REGISTERS];
+
+    memset(raw,0,sizeof(raw));
+    hllDenseMerge(raw,registers);
+    hllRawRegHisto(raw,reghisto);
 }
 
 /* Return the approximated cardinality of the set based on the armonic
@@ -968,6 +1048,7 @@ uint64_t hllCount(struct hllhdr *hdr, int *invalid) {
     double m = HLL_REGISTERS;
     double E, alpha = 0.7213/(1+1.079/m);
     int j, ez; /* Number of registers equal to 0. */
+    int reghisto[HLL_REGISTER_MAX+1] = {0};
 
     /* We precompute 2^(-reg[j]) in a small table in order to
      * speedup the computation of SUM(2^-register[0..i]). */
@@ -982,18 +1063,24 @@ uint64_t hllCount(struct hllhdr *hdr, int *invalid) {
         initialized = 1;
     }
 
-    /* Compute SUM(2^-register[0..i]). */
+    /* Compute the histogram of the registers. */
     if (hdr->encoding == HLL_DENSE) {
-        E = hllDenseSum(hdr->registers,PE,&ez);
+        hllDenseRegHisto(hdr->registers,reghisto);
     } else if (hdr->encoding == HLL_SPARSE) {
-        E = hllSparseSum(hdr->registers,
-                         sdslen((sds)hdr)-HLL_HDR_SIZE,PE,&ez,invalid);
+        hllSparseRegHisto(hdr->registers,
+                          sdslen((sds)hdr)-HLL_HDR_SIZE,invalid,reghisto);
     } else if (hdr->encoding == HLL_RAW) {
-        E = hllRawSum(hdr->registers,PE,&ez);
+        hllRawRegHisto(hdr->registers,reghisto);
     } else {
         redisPanic("Unknown HyperLogLog encoding in hllCount()");
     }
 
+    /* Compute SUM(2^-register[0..i]), starting from the smallest terms. */
+    E = 0;
+    for (j = HLL_REGISTER_MAX; j >= 1; j--) E += PE[j]*reghisto[j];
+    ez = reghisto[0];
+    E += ez; /* Add 2^0 'ez' times. */
+
     /* Muliply the inverse of E for alpha_m * m^2 to have the raw estimate. */
     E = (1/E)*alpha*m*m;
 
@@ -1046,12 +1133,7 @@ int hllMerge(uint8_t *max, robj *hll) {
     int i;
 
     if (hdr->encoding == HLL_DENSE) {
-        uint8_t val;
-
-        for (i = 0; i < HLL_REGISTERS; i++) {
-            HLL_DENSE_GET_REGISTER(val,hdr->registers,i);
-            if (val > max[i]) max[i] = val;
-        }
+        hllDenseMerge(max,hdr->registers);
     } else {
         uint8_t *p = hll->ptr, *end = p + sdslen(hll->ptr);
         long runlen, regval;
@@ -1329,9 +1411,7 @@ void pfmergeCommand(redisClient *c) {
     /* Write the resulting HLL to the destination HLL registers and
      * invalidate the cached value. */
     hdr = o->ptr;
-    for (j = 0; j < HLL_REGISTERS; j++) {
-        HLL_DENSE_SET_REGISTER(hdr->registers,j,max[j]);
-    }
+    hllDenseSetRegisters(hdr->registers,max);
     HLL_INVALIDATE_CACHE(hdr);
 
     signalModifiedKey(c->db,c->argv[1]);
@@ -1353,7 +1433,19 @@ void pfselftestCommand(redisClient *c) {
     sds bitcounters = sdsnewlen(NULL,HLL_DENSE_SIZE);
     struct hllhdr *hdr = (struct hllhdr*) bitcounters, *hdr2;
     robj *o = NULL;
-    uint8_t bytecounters[HLL_REGISTERS];
+    uint8_t bytecounters[HLL_REGISTERS], rawcounters[HLL_REGISTERS];
+    struct {
+        char *name;
+        hllDenseMergeFunc *func;
+        int supported;
+    } kernels[] = {
+        {"scalar",hllDenseMergeScalar,1},
+#ifdef HAVE_X86_SIMD
+        {"avx2",hllDenseMergeAVX2,__builtin_cpu_supports("avx2")},
+#endif
+        {NULL,NULL,0}
+    };
+    int k;
 
     /* Test 1: access registers.
      * The test is conceived to test that the different counters of our data
@@ -1380,6 +1472,24 @@ void pfselftestCommand(redisClient *c) {
                 goto cleanup;
             }
         }
+        /* Check that every merge kernel unpacks the same values, and that
+         * packing them back produces the same registers. */
+        for (k = 0; kernels[k].name; k++) {
+            if (!kernels[k].supported) continue;
+            memset(rawcounters,0,sizeof(rawcounters));
+            kernels[k].func(rawcounters,hdr->registers);
+            if (memcmp(rawcounters,bytecounters,sizeof(rawcounters))) {
+                addReplyErrorFormat(c,
+                    "TESTFAILED %s merge kernel disagrees", kernels[k].name);
+                goto cleanup;
+            }
+        }
+        memcpy(rawcounters,hdr->registers,HLL_DENSE_SIZE-HLL_HDR_SIZE);
+        hllDenseSetRegisters(hdr->registers,bytecounters);
+        if (memcmp(rawcounters,hdr->registers,HLL_DENSE_SIZE-HLL_HDR_SIZE)) {
+            addReplyError(c,"TESTFAILED packing registers disagrees");
+            goto cleanup;
+        }
     }
 
     /* Test 2: approximation error.
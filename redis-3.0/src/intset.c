@@ -173,6 +173,139 @@ static intset *intsetResize(intset *is, uint32_t len) {
     return is;
 }
 
+/* Lookup kernels.
+ *
+ * The binary search in intsetSearch() stops once the range left is about
+ * INTSET_SCAN_BYTES long, and the range is then scanned by a kernel that
+ * counts the elements smaller than the value. The count is the position
+ * of the value, or the position where it can be inserted. The scan has
+ * no data dependent branches, so on small sets (and on the last steps of
+ * the search on big ones) it is faster than the branches it replaces.
+ *
+ * ںˣ
+ *
+ * intsetSearch() Ķֲʣ෶ΧС INTSET_SCAN_BYTES ֽʱֹͣ
+ * ֮ںɨΧб value СԪص
+ *  value ڣ߿Բ룩λá
+ *
+ * ɨ費ݵķ֧ԶСϣԼ󼯺ϲҵ󼸲
+ * Ҫȱ滻ĶֲҸ졣
+ *
+ * The SSE4.2 and AVX2 kernels are only compiled on x86-64, and the best
+ * one the CPU supports is selected by intsetInitSearch() at startup.
+ * Until then, and on other platforms, the scalar kernel is used.
+ *
+ * SSE4.2  AVX2 ںֻ x86-64 ϱ룬
+ * ʱ intsetInitSearch() ѡ CPU ֵ֧ںˣ
+ * ڴ֮ǰԼƽ̨ϣʹñںˡ
+ */
+#ifndef INTSET_SCAN_BYTES
+#define INTSET_SCAN_BYTES 128
+#endif
+
+/* Return how many of the 'count' elements of 'enc' size at 'p' are smaller
+ * than 'value'. 'value' always fits in 'enc'.
+ *
+ *  p  count Ϊ enc ԪУ value СԪص */
+typedef uint32_t intsetCountLessFunc(const int8_t *p, uint8_t enc,
+                                     uint32_t count, int64_t value);
+
+static uint32_t intsetCountLessScalar(const int8_t *p, uint8_t enc,
+                                      uint32_t count, int64_t value)
+{
+    uint32_t j, less = 0;
+
+    if (enc == INTSET_ENC_INT64) {
+        int64_t v64;
+        for (j = 0; j < count; j++) {
+            memcpy(&v64,((int64_t*)p)+j,sizeof(v64));
+            memrev64ifbe(&v64);
+            less += v64 < value;
+        }
+    } else if (enc == INTSET_ENC_INT32) {
+        int32_t v32;
+        for (j = 0; j < count; j++) {
+            memcpy(&v32,((int32_t*)p)+j,sizeof(v32));
+            memrev32ifbe(&v32);
+            less += v32 < value;
+        }
+    } else {
+        int16_t v16;
+        for (j = 0; j < count; j++) {
+            memcpy(&v16,((int16_t*)p)+j,sizeof(v16));
+            memrev16ifbe(&v16);
+            less += v16 < value;
+        }
+    }
+    return less;
+}
+
+#ifdef HAVE_X86_SIMD
+#include <immintrin.h>
+
+/* Each lane where value > element sets all the bytes of the lane in the
+ * compare mask, so the number of such lanes is popcount(movemask)/enc.
+ *
+ * ȽϽ value Ԫصÿ lane ֽڶᱻλ
+ *  lane Ϊ popcount(movemask)/enc  */
+__attribute__((target("sse4.2,popcnt")))
+static uint32_t intsetCountLessSSE42(const int8_t *p, uint8_t enc,
+                                     uint32_t count, int64_t value)
+{
+    uint32_t j = 0, bits = 0, lanes = 16/enc;
+    __m128i v, x;
+
+    if (enc == INTSET_ENC_INT64) v = _mm_set1_epi64x(value);
+    else if (enc == INTSET_ENC_INT32) v = _mm_set1_epi32((int32_t)value);
+    else v = _mm_set1_epi16((int16_t)value);
+
+    for (; j+lanes <= count; j += lanes) {
+        x = _mm_loadu_si128((const __m128i*)(p+j*enc));
+        if (enc == INTSET_ENC_INT64) x = _mm_cmpgt_epi64(v,x);
+        else if (enc == INTSET_ENC_INT32) x = _mm_cmpgt_epi32(v,x);
+        else x = _mm_cmpgt_epi16(v,x);
+        bits += __builtin_popcount(_mm_movemask_epi8(x));
+    }
+    return bits/enc + intsetCountLessScalar(p+j*enc,enc,count-j,value);
+}
+
+__attribute__((target("avx2,popcnt")))
+static uint32_t intsetCountLessAVX2(const int8_t *p, uint8_t enc,
+                                    uint32_t count, int64_t value)
+{
+    uint32_t j = 0, bits = 0, lanes = 32/enc;
+    __m256i v, x;
+
+    if (enc == INTSET_ENC_INT64) v = _mm256_set1_epi64x(value);
+    else if (enc == INTSET_ENC_INT32) v = _mm256_set1_epi32((int32_t)value);
+    else v = _mm256_set1_epi16((int16_t)value);
+
+    for (; j+lanes <= count; j += lanes) {
+        x = _mm256_loadu_si256((const __m256i*)(p+j*enc));
+        if (enc == INTSET_ENC_INT64) x = _mm256_cmpgt_epi64(v,x);
+        else if (enc == INTSET_ENC_INT32) x = _mm256_cmpgt_epi32(v,x);
+        else x = _mm256_cmpgt_epi16(v,x);
+        bits += __builtin_popcount((uint32_t)_mm256_movemask_epi8(x));
+    }
+    return bits/enc + intsetCountLessScalar(p+j*enc,enc,count-j,value);
+}
+#endif
+
+static intsetCountLessFunc *intsetCountLess = intsetCountLessScalar;
+
+/* Select the fastest lookup kernel the CPU supports.
+ *
+ * ѡ CPU ֵ֧Ĳںˡ */
+void intsetInitSearch(void) {
+#ifdef HAVE_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        intsetCountLess = intsetCountLessAVX2;
+    else if (__builtin_cpu_supports("sse4.2"))
+        intsetCountLess = intsetCountLessSSE42;
+#endif
+}
+
 /* Search for the position of "value".
  * 
  * ڼ is ĵײвֵ value ڵ
@@ -192,6 +325,7 @@ static intset *intsetResize(intset *is, uint32_t len) {
  */
 static uint8_t intsetSearch(intset *is, int64_t value, uint32_t *pos) {
     int min = 0, max = intrev32ifbe(is->length)-1, mid = -1;
+    uint8_t enc = intrev32ifbe(is->encoding);
     int64_t cur = -1;
 
     /* The value can never be found when the set is empty */
@@ -217,28 +351,28 @@ static uint8_t intsetSearch(intset *is, int64_t value, uint32_t *pos) {
         }
     }
 
-    // нжֲ
+    // нжֲңֱʣķΧ㹻С
     // T = O(log N)
-    while(max >= min) {
+    while(max-min+1 > INTSET_SCAN_BYTES/enc) {
         mid = (min+max)/2;
-        cur = _intsetGet(is,mid);
+        cur = _intsetGetEncoded(is,mid,enc);
         if (value > cur) {
             min = mid+1;
         } else if (value < cur) {
             max = mid-1;
         } else {
-            break;
+            if (pos) *pos = mid;
+            return 1;
         }
     }
 
-    // ǷѾҵ value
-    if (value == cur) {
-        if (pos) *pos = mid;
-        return 1;
-    } else {
-        if (pos) *pos = min;
-        return 0;
-    }
+    /* Scan what is left: the elements smaller than the value give its
+     * position, then check if the value is there. */
+    // ɨʣķΧ value СԪص value λã
+    // ȻλϵԪǷ value
+    mid = min + intsetCountLess(is->contents+min*enc,enc,max-min+1,value);
+    if (pos) *pos = mid;
+    return mid <= max && _intsetGetEncoded(is,mid,enc) == value;
 }
 
 /* Upgrades the intset to a larger encoding and inserts the given integer. 
@@ -610,8 +744,168 @@ size_t intsetBlobLen(intset *is) {
     return sizeof(intset)+intrev32ifbe(is->length)*intrev32ifbe(is->encoding);
 }
 
+/* Return the position of the first element not smaller than 'value',
+ * looking from 'from' on. The search gallops from 'from', so that a
+ * sequence of growing values is looked up in O(log distance) each, and
+ * ends with the lookup kernel.
+ *
+ *  from ʼصһС value Ԫصλá
+ *
+ * Ҵ from ʼָĲǰ
+ * ԶһֵвʱÿβҵĸӶֻβ֮ľйأ
+ * ķΧɲں˽ɨ衣
+ *
+ * T = O(log N)
+ */
+static uint32_t intsetSeek(intset *is, uint32_t from, int64_t value) {
+    uint32_t len = intrev32ifbe(is->length), lo = from, hi = from, mid;
+    uint32_t step = 1;
+    uint8_t enc = intrev32ifbe(is->encoding);
+
+    /* A value that doesn't fit the encoding is out of the range of the
+     * elements, either after all of them or before all of them. */
+    // ܱϵı뱣ֵҪôԪضҪôԪضС
+    if (_intsetValueEncoding(value) > enc) return (value > 0) ? len : from;
+
+    while (hi < len && _intsetGetEncoded(is,hi,enc) < value) {
+        lo = hi+1;
+        hi += step;
+        step <<= 1;
+    }
+    if (hi > len) hi = len;
+
+    // λ [lo,hi] ֮УöֲСΧںɨ
+    while (hi-lo > INTSET_SCAN_BYTES/enc) {
+        mid = lo+(hi-lo)/2;
+        if (_intsetGetEncoded(is,mid,enc) < value)
+            lo = mid+1;
+        else
+            hi = mid;
+    }
+    return lo + intsetCountLess(is->contents+lo*enc,enc,hi-lo,value);
+}
+
+/* Return a new intset with the intersection of the 'num' given intsets.
+ * It is faster when the first one is the smallest.
+ *
+ * The elements of the first set are looked up in the others in order, so
+ * every lookup starts where the previous one stopped.
+ *
+ * һµϣ num ϵĽ
+ * һΪСļʱٶ졣
+ *
+ * ˳вҵһϵԪأ
+ * ÿβҶϴβֹͣĵطʼ
+ *
+ * T = O(N*M*log(K/N)) N ΪһϵĴСM Ϊϵ
+ * K ΪϵĴС
+ */
+intset *intsetIntersect(intset **sets, unsigned long num) {
+    uint32_t *pos = zcalloc(sizeof(uint32_t)*num);
+    uint32_t i, len = intrev32ifbe(sets[0]->length), count = 0;
+    uint8_t enc = intrev32ifbe(sets[0]->encoding);
+    unsigned long j;
+    int64_t value;
+    intset *is;
+
+    /* The result only holds values that fit every set, so it uses the
+     * smallest encoding of them. */
+    // еԪؿԱмϵı뱣棬ʹСı
+    for (j = 1; j < num; j++) {
+        if (intrev32ifbe(sets[j]->encoding) < enc)
+            enc = intrev32ifbe(sets[j]->encoding);
+    }
+    is = intsetNew();
+    is->encoding = intrev32ifbe(enc);
+    is = intsetResize(is,len);
+
+    for (i = 0; i < len; i++) {
+        value = _intsetGet(sets[0],i);
+        if (_intsetValueEncoding(value) > enc) continue;
+
+        for (j = 1; j < num; j++) {
+            if (sets[j] == sets[0]) continue;
+            pos[j] = intsetSeek(sets[j],pos[j],value);
+            // ѾûиԪأ
+            if (pos[j] == intrev32ifbe(sets[j]->length)) goto done;
+            if (_intsetGet(sets[j],pos[j]) != value) break;
+        }
+        if (j == num) _intsetSet(is,count++,value);
+    }
+
+done:
+    zfree(pos);
+    is->length = intrev32ifbe(count);
+    return intsetResize(is,count);
+}
+
+/* Return a new intset with the union of the 'num' given intsets.
+ *
+ * The sets are merged one at a time into the result, like in the merge
+ * step of merge sort.
+ *
+ * һµϣ num ϵĲ
+ *
+ * 鲢ϺϲС
+ *
+ * T = O(N*M) N ΪмϵĴС֮ͣM Ϊϵ
+ */
+intset *intsetUnion(intset **sets, unsigned long num) {
+    intset *is = intsetNew(), *merged;
+    uint32_t i, k, alen, blen, count;
+    uint8_t enc;
+    unsigned long j;
+    int64_t a, b;
+
+    for (j = 0; j < num; j++) {
+        alen = intrev32ifbe(is->length);
+        blen = intrev32ifbe(sets[j]->length);
+        enc = intrev32ifbe(is->encoding);
+        if (intrev32ifbe(sets[j]->encoding) > enc)
+            enc = intrev32ifbe(sets[j]->encoding);
+
+        merged = intsetNew();
+        merged->encoding = intrev32ifbe(enc);
+        merged = intsetResize(merged,alen+blen);
+
+        i = k = count = 0;
+        while (i < alen && k < blen) {
+            a = _intsetGet(is,i);
+            b = _intsetGet(sets[j],k);
+            if (a < b) {
+                _intsetSet(merged,count++,a);
+                i++;
+            } else if (a > b) {
+                _intsetSet(merged,count++,b);
+                k++;
+            } else {
+                _intsetSet(merged,count++,a);
+                i++;
+                k++;
+            }
+        }
+        for (; i < alen; i++) _intsetSet(merged,count++,_intsetGet(is,i));
+        for (; k < blen; k++) _intsetSet(merged,count++,_intsetGet(sets[j],k));
+
+        zfree(is);
+        merged->length = intrev32ifbe(count);
+        is = intsetResize(merged,count);
+    }
+    return is;
+}
+
 #ifdef INTSET_TEST_MAIN
+/* Build with:
+ *
+ *   cc -O2 -DINTSET_TEST_MAIN intset.c zmalloc.c -o intset-test
+ *
+ * Besides the unit tests, './intset-test' checks every lookup kernel the
+ * CPU supports against the scalar one, and times them on sets of
+ * different sizes and encodings. Building with -DINTSET_SCAN_BYTES=0
+ * gives the plain binary search, for comparison. Last it checks and
+ * times intsetIntersect() and intsetUnion(). */
 #include <sys/time.h>
+#include <time.h>
 
 void intsetRepr(intset *is) {
     int i;
@@ -661,7 +955,7 @@ intset *createSet(int bits, int size) {
 void checkConsistency(intset *is) {
     int i;
 
-    for (i = 0; i < (intrev32ifbe(is->length)-1); i++) {
+    for (i = 0; i+1 < intrev32ifbe(is->length); i++) {
         uint32_t encoding = intrev32ifbe(is->encoding);
 
         if (encoding == INTSET_ENC_INT16) {
@@ -681,7 +975,7 @@ int main(int argc, char **argv) {
     uint8_t success;
     int i;
     intset *is;
-    sranddev();
+    srand(time(NULL));
 
     printf("Value encodings: "); {
         assert(_intsetValueEncoding(-32768) == INTSET_ENC_INT16);
@@ -808,5 +1102,170 @@ int main(int argc, char **argv) {
         checkConsistency(is);
         ok();
     }
+
+    printf("Lookup kernels: "); {
+        struct {
+            char *name;
+            intsetCountLessFunc *func;
+            int supported;
+        } kernels[] = {
+            {"scalar",intsetCountLessScalar,1},
+#ifdef HAVE_X86_SIMD
+            {"sse4.2",intsetCountLessSSE42,__builtin_cpu_supports("sse4.2")},
+            {"avx2",intsetCountLessAVX2,__builtin_cpu_supports("avx2")},
+#endif
+            {NULL,NULL,0}
+        };
+        int sizes[] = {8, 64, 512, 4096};
+        int bits[] = {15, 31, 63};
+        int k, s, b, j;
+        long num = 1000000;
+        int64_t *keys = malloc(sizeof(int64_t)*num);
+        uint32_t pos1, pos2;
+        uint8_t found1, found2;
+        long long start;
+
+        /* Every kernel must agree with the scalar one. */
+        for (k = 1; kernels[k].name; k++) {
+            if (!kernels[k].supported) continue;
+            for (i = 0; i < 1000; i++) {
+                int64_t v, mask;
+                b = bits[rand() % 3];
+                mask = b == 63 ? INT64_MAX : ((int64_t)1<<b)-1;
+                is = intsetNew();
+                s = rand() % 300;
+                for (j = 0; j < s; j++) {
+                    v = (((int64_t)rand()<<32)^rand()) & mask;
+                    if (rand() & 1) v = -v;
+                    is = intsetAdd(is,v,NULL);
+                }
+                for (j = 0; j < 100; j++) {
+                    v = (((int64_t)rand()<<32)^rand()) & mask;
+                    if (rand() & 1) v = -v;
+                    if (j & 1 && intrev32ifbe(is->length))
+                        v = _intsetGet(is,rand() % intrev32ifbe(is->length));
+                    if (_intsetValueEncoding(v) > intrev32ifbe(is->encoding))
+                        continue;
+                    intsetCountLess = intsetCountLessScalar;
+                    found1 = intsetSearch(is,v,&pos1);
+                    intsetCountLess = kernels[k].func;
+                    found2 = intsetSearch(is,v,&pos2);
+                    assert(found1 == found2 && pos1 == pos2);
+                }
+                zfree(is);
+            }
+        }
+        ok();
+
+        /* Half of the lookups are hits. */
+        for (b = 0; b < 3; b++) {
+            for (s = 0; s < 4; s++) {
+                int64_t mask = ((int64_t)1<<bits[b])-1;
+                is = intsetNew();
+                while (intrev32ifbe(is->length) < sizes[s])
+                    is = intsetAdd(is,(((int64_t)rand()<<32)^rand())&mask,NULL);
+                for (i = 0; i < num; i++) {
+                    keys[i] = (i & 1) ?
+                        _intsetGet(is,rand() % sizes[s]) :
+                        (((int64_t)rand()<<32)^rand())&mask;
+                }
+                printf("  int%d, %4d elements:", (int)intrev32ifbe(is->encoding)*8,
+                    sizes[s]);
+                for (k = 0; kernels[k].name; k++) {
+                    if (!kernels[k].supported) continue;
+                    intsetCountLess = kernels[k].func;
+                    start = usec();
+                    for (i = 0; i < num; i++) intsetFind(is,keys[i]);
+                    printf(" %s %lldns", kernels[k].name,
+                        (usec()-start)*1000/num);
+                }
+                printf("\n");
+                zfree(is);
+            }
+        }
+        free(keys);
+    }
+
+    printf("Intersection and union: "); {
+        intset *sets[3], *inter, *uni;
+        int64_t v;
+        uint32_t l;
+        int k, n;
+
+        for (i = 0; i < 1000; i++) {
+            n = 1 + rand() % 3;
+            for (k = 0; k < n; k++) {
+                int b = (rand() % 3 == 0) ? 40 : 12;
+                int size = rand() % (k ? 500 : 50);
+                sets[k] = intsetNew();
+                while (size--) {
+                    v = (((int64_t)rand()<<32)^rand()) & (((int64_t)1<<b)-1);
+                    if (rand() & 1) v = -v;
+                    sets[k] = intsetAdd(sets[k],v,NULL);
+                }
+            }
+            inter = intsetIntersect(sets,n);
+            uni = intsetUnion(sets,n);
+            checkConsistency(inter);
+            checkConsistency(uni);
+            for (k = 0; k < n; k++) {
+                for (l = 0; l < intrev32ifbe(sets[k]->length); l++) {
+                    int m, all = 1;
+                    v = _intsetGet(sets[k],l);
+                    for (m = 0; m < n; m++)
+                        if (!intsetFind(sets[m],v)) all = 0;
+                    assert(intsetFind(uni,v));
+                    assert(intsetFind(inter,v) == all);
+                }
+            }
+            for (l = 0; l < intrev32ifbe(uni->length); l++) {
+                int m, any = 0;
+                v = _intsetGet(uni,l);
+                for (m = 0; m < n; m++)
+                    if (intsetFind(sets[m],v)) any = 1;
+                assert(any);
+            }
+            for (k = 0; k < n; k++) zfree(sets[k]);
+            zfree(inter);
+            zfree(uni);
+        }
+        ok();
+    }
+
+    printf("Intersection, lookups vs intsetIntersect:\n"); {
+        int sizes[][2] = {{100,100}, {100,10000}, {10000,10000}, {500,500000}};
+        int k, rounds;
+        long long start, lookups, merge;
+        intset *sets[2], *inter;
+
+        for (k = 0; k < 4; k++) {
+            sets[0] = createSet(20,sizes[k][0]);
+            sets[1] = createSet(sizes[k][1] > 100000 ? 31 : 20,sizes[k][1]);
+            rounds = 2000000/(sizes[k][0]+sizes[k][1]);
+            if (rounds == 0) rounds = 1;
+
+            start = usec();
+            for (i = 0; i < rounds; i++) {
+                uint32_t l, len = intrev32ifbe(sets[0]->length);
+                inter = intsetNew();
+                for (l = 0; l < len; l++) {
+                    int64_t v = _intsetGet(sets[0],l);
+                    if (intsetFind(sets[1],v)) inter = intsetAdd(inter,v,NULL);
+                }
+                zfree(inter);
+            }
+            lookups = usec()-start;
+
+            start = usec();
+            for (i = 0; i < rounds; i++) zfree(intsetIntersect(sets,2));
+            merge = usec()-start;
+
+            printf("  %6d x %6d elements: %8.1f usec lookups, %8.1f usec intersect\n",
+                intrev32ifbe(sets[0]->length), intrev32ifbe(sets[1]->length),
+                (double)lookups/rounds, (double)merge/rounds);
+            zfree(sets[0]);
+            zfree(sets[1]);
+        }
+    }
 }
 #endif
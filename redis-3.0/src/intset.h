@@ -97,5 +97,8 @@ int64_t intsetRandom(intset *is);
 uint8_t intsetGet(intset *is, uint32_t pos, int64_t *value);
 uint32_t intsetLen(intset *is);
 size_t intsetBlobLen(intset *is);
+intset *intsetIntersect(intset **sets, unsigned long num);
+intset *intsetUnion(intset **sets, unsigned long num);
+void intsetInitSearch(void);
 
 #endif // __INTSET_H
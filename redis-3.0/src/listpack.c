@@ -0,0 +1,1127 @@
+/* Listpack -- A list of strings serialization format
+ *
+ * Listpack  ַблʽ
+ *
+ * The listpack is the compact encoding used by small lists, hashes and
+ * sorted sets, in place of the ziplist. It stores strings and integers in
+ * a single allocation, like the ziplist does, but every entry only
+ * describes itself: instead of the length of the previous entry, an entry
+ * ends with its own length, written so that it can be read right to left.
+ *
+ * listpack СбСϣС򼯺ʹõĽձ룬 ziplist 
+ *
+ *  ziplist һһڴбַ
+ * ÿڵֻ¼Ϣ
+ * ڵĩβǽڵĳȣԴȡǰýڵĳȡ
+ *
+ * In a ziplist an entry whose size crosses 254 bytes changes the size of
+ * the prevlen field of the next entry, which may cross 254 bytes in turn,
+ * so a single insertion or deletion can rewrite the whole list (see
+ * __ziplistCascadeUpdate()). In a listpack an insertion or a deletion
+ * only moves the bytes after it, with one memmove().
+ *
+ *  ziplist Уһڵĳȿ 254 ֽʱýڵ prevlen 
+ * ҲҪı䣬ֿܵٺĽڵҲҪı䣬
+ * һβɾпдб£
+ *  listpack ĲɾֻҪһ memmove() ƶ֮ݡ
+ *
+ * LISTPACK OVERALL LAYOUT:
+ * LISTPACK 岼֣
+ *
+ * <tot-bytes><num-elements><element-1>...<element-N><end-byte>
+ *
+ * <tot-bytes> is an unsigned 32 bit integer holding the total size of the
+ * listpack, header and end byte included.
+ *
+ * <tot-bytes>  32 λ޷ listpack ռõȫֽ
+ *
+ * <num-elements> is an unsigned 16 bit integer holding the number of
+ * elements. When it is equal to 65535 the number is unknown and the list
+ * must be traversed to count them.
+ *
+ * <num-elements>  16 λ޷ڵ
+ * ֵΪ 65535 ʱڵδ֪Ҫбܼ
+ *
+ * <end-byte> is a single byte equal to 255 marking the end of the list.
+ *
+ * <end-byte> Ϊ 1 ֽڣֵΪ 255 ʶбĩβ
+ *
+ * LISTPACK ENTRIES:
+ * LISTPACK ڵ㣺
+ *
+ * <encoding-type><element-data><element-tot-len>
+ *
+ * The encoding type tells if the element is an integer or a string, and
+ * for strings also holds the length:
+ *
+ * encoding-type ʶڵ㱣ַַڵ㻹ַĳȣ
+ *
+ * |0xxxxxxx| 7 bit unsigned integer, 0 .. 127.
+ *      7 λ޷
+ * |10xxxxxx| <string> string up to 63 bytes.
+ *      Ȳ 63 ֽڵַ
+ * |110xxxxx|yyyyyyyy| 13 bit signed integer.
+ *      13 λз
+ * |1110xxxx|yyyyyyyy| <string> string up to 4095 bytes.
+ *      Ȳ 4095 ֽڵַ
+ * |11110000| <4 bytes len> <string> string up to 2^32-1 bytes.
+ *      ȸַ
+ * |11110001| <2 bytes> 16 bit signed integer.
+ * |11110010| <3 bytes> 24 bit signed integer.
+ * |11110011| <4 bytes> 32 bit signed integer.
+ * |11110100| <8 bytes> 64 bit signed integer.
+ *      16  24  32  64 λз
+ *
+ * Multi byte integers and lengths are stored little endian.
+ *
+ * ֽڵͳС򱣴档
+ *
+ * <element-tot-len> is the size of <encoding-type> plus <element-data>,
+ * stored in 1 to 5 bytes holding 7 bits each, the least significant ones
+ * in the rightmost byte. Every byte but the leftmost one has the most
+ * significant bit set, so reading from the right we know when to stop.
+ * Going back from an entry to the previous one is then: read the length
+ * ending right before the entry, add the size of the length itself, and
+ * move back by that many bytes.
+ *
+ * <element-tot-len>  encoding-type  element-data ĳȣ
+ * ʹ 1  5 ֽڣÿֽڱ 7 λұߵֽڱ͵ 7 λ
+ * ߵֽ⣬ÿֽڵλΪ 1 
+ * Դȡʱ֪ʱ
+ * һڵ˵ǰýڵʱֻǰڵǰĳȣ
+ * ռõֽȻӦֽɡ
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include "zmalloc.h"
+#include "util.h"
+#include "listpack.h"
+#include "endianconv.h"
+#include "redisassert.h"
+
+/* Size of the header, and value of <num-elements> when it is unknown. */
+#define LP_HDR_SIZE 6
+#define LP_HDR_NUMELE_UNKNOWN UINT16_MAX
+
+/* End of listpack marker. */
+#define LP_EOF 0xFF
+
+/* Biggest encoded integer and encoded element length. */
+#define LP_MAX_INT_ENCODING_LEN 9
+#define LP_MAX_BACKLEN_SIZE 5
+
+/* Encoding types, see the top comment. */
+#define LP_ENCODING_7BIT_UINT 0
+#define LP_ENCODING_7BIT_UINT_MASK 0x80
+#define LP_ENCODING_IS_7BIT_UINT(byte) (((byte)&LP_ENCODING_7BIT_UINT_MASK)==LP_ENCODING_7BIT_UINT)
+
+#define LP_ENCODING_6BIT_STR 0x80
+#define LP_ENCODING_6BIT_STR_MASK 0xC0
+#define LP_ENCODING_IS_6BIT_STR(byte) (((byte)&LP_ENCODING_6BIT_STR_MASK)==LP_ENCODING_6BIT_STR)
+
+#define LP_ENCODING_13BIT_INT 0xC0
+#define LP_ENCODING_13BIT_INT_MASK 0xE0
+#define LP_ENCODING_IS_13BIT_INT(byte) (((byte)&LP_ENCODING_13BIT_INT_MASK)==LP_ENCODING_13BIT_INT)
+
+#define LP_ENCODING_12BIT_STR 0xE0
+#define LP_ENCODING_12BIT_STR_MASK 0xF0
+#define LP_ENCODING_IS_12BIT_STR(byte) (((byte)&LP_ENCODING_12BIT_STR_MASK)==LP_ENCODING_12BIT_STR)
+
+#define LP_ENCODING_32BIT_STR 0xF0
+#define LP_ENCODING_16BIT_INT 0xF1
+#define LP_ENCODING_24BIT_INT 0xF2
+#define LP_ENCODING_32BIT_INT 0xF3
+#define LP_ENCODING_64BIT_INT 0xF4
+
+/* Access the header fields. */
+#define LP_BYTES(lp)        (*((uint32_t*)(lp)))
+#define LP_LENGTH(lp)       (*((uint16_t*)((lp)+sizeof(uint32_t))))
+#define LP_ENTRY_HEAD(lp)   ((lp)+LP_HDR_SIZE)
+#define LP_ENTRY_END(lp)    ((lp)+intrev32ifbe(LP_BYTES(lp))-1)
+
+/* Check if the string 's' can be stored as an integer, and if so store it
+ * in '*v'. Only the canonical representation of the number is accepted,
+ * so the string read back is always the same.
+ *
+ * ַ s ܷΪԵĻ浽 *v С */
+static int lpStringToInt64(unsigned char *s, unsigned int slen, long long *v) {
+    if (slen == 0 || slen >= 21) return 0;
+    return string2ll((char*)s,slen,v);
+}
+
+/* Encode the integer 'v' in 'buf', returning the number of bytes used.
+ *
+ *  v 뵽 buf Уʹõֽ */
+static unsigned int lpEncodeInteger(unsigned char *buf, long long v) {
+    uint64_t uv = v;
+    unsigned int size, j;
+
+    if (v >= 0 && v <= 127) {
+        buf[0] = v;
+        return 1;
+    } else if (v >= -4096 && v <= 4095) {
+        uv &= 0x1fff;
+        buf[0] = (uv>>8)|LP_ENCODING_13BIT_INT;
+        buf[1] = uv&0xff;
+        return 2;
+    } else if (v >= INT16_MIN && v <= INT16_MAX) {
+        buf[0] = LP_ENCODING_16BIT_INT;
+        size = 3;
+    } else if (v >= -8388608 && v <= 8388607) {
+        buf[0] = LP_ENCODING_24BIT_INT;
+        size = 4;
+    } else if (v >= INT32_MIN && v <= INT32_MAX) {
+        buf[0] = LP_ENCODING_32BIT_INT;
+        size = 5;
+    } else {
+        buf[0] = LP_ENCODING_64BIT_INT;
+        size = 9;
+    }
+    for (j = 1; j < size; j++) {
+        buf[j] = uv&0xff;
+        uv >>= 8;
+    }
+    return size;
+}
+
+/* Decode the integer entry at 'p'.
+ *
+ * ȡ p ָڵֵ */
+static long long lpDecodeInteger(unsigned char *p) {
+    uint64_t uv = 0;
+    unsigned int bits, j;
+
+    if (LP_ENCODING_IS_7BIT_UINT(p[0])) return p[0];
+
+    if (LP_ENCODING_IS_13BIT_INT(p[0])) {
+        uv = ((p[0]&0x1f)<<8)|p[1];
+        bits = 13;
+    } else {
+        switch(p[0]) {
+        case LP_ENCODING_16BIT_INT: bits = 16; break;
+        case LP_ENCODING_24BIT_INT: bits = 24; break;
+        case LP_ENCODING_32BIT_INT: bits = 32; break;
+        case LP_ENCODING_64BIT_INT: bits = 64; break;
+        default: assert(NULL); return 0;
+        }
+        for (j = bits/8; j > 0; j--) uv = (uv<<8)|p[j];
+    }
+
+    /* Negative numbers are stored in two's complement. */
+    if (bits < 64 && (uv >> (bits-1)))
+        return -(long long)(((uint64_t)1<<bits)-uv);
+    return (long long)uv;
+}
+
+/* Encode the header of a string of 'len' bytes in 'buf', returning the
+ * number of bytes used.
+ *
+ * Ϊ len ַ encoding-type 뵽 buf Уʹõֽ */
+static unsigned int lpEncodeStringHeader(unsigned char *buf, uint32_t len) {
+    if (len < 64) {
+        buf[0] = len|LP_ENCODING_6BIT_STR;
+        return 1;
+    } else if (len < 4096) {
+        buf[0] = (len>>8)|LP_ENCODING_12BIT_STR;
+        buf[1] = len&0xff;
+        return 2;
+    } else {
+        buf[0] = LP_ENCODING_32BIT_STR;
+        buf[1] = len&0xff;
+        buf[2] = (len>>8)&0xff;
+        buf[3] = (len>>16)&0xff;
+        buf[4] = len>>24;
+        return 5;
+    }
+}
+
+/* If the entry at 'p' is a string, return a pointer to it and store its
+ * length in '*len'. Otherwise return NULL.
+ *
+ *  p ָĽڵ㱣ַôַȱ浽 *len 
+ * 򷵻 NULL  */
+static unsigned char *lpGetString(unsigned char *p, uint32_t *len) {
+    if (LP_ENCODING_IS_6BIT_STR(p[0])) {
+        *len = p[0]&0x3f;
+        return p+1;
+    } else if (LP_ENCODING_IS_12BIT_STR(p[0])) {
+        *len = ((p[0]&0xf)<<8)|p[1];
+        return p+2;
+    } else if (p[0] == LP_ENCODING_32BIT_STR) {
+        *len = (uint32_t)p[1]|((uint32_t)p[2]<<8)|
+               ((uint32_t)p[3]<<16)|((uint32_t)p[4]<<24);
+        return p+5;
+    }
+    return NULL;
+}
+
+/* Return the size of <encoding-type> plus <element-data> of the entry at 'p'.
+ *
+ *  p ָڵ encoding-type  element-data ܳȡ */
+static uint32_t lpEncodedSize(unsigned char *p) {
+    unsigned char *s;
+    uint32_t len;
+
+    if (LP_ENCODING_IS_7BIT_UINT(p[0])) return 1;
+    if (LP_ENCODING_IS_13BIT_INT(p[0])) return 2;
+    if ((s = lpGetString(p,&len)) != NULL) return (s-p)+len;
+    switch(p[0]) {
+    case LP_ENCODING_16BIT_INT: return 3;
+    case LP_ENCODING_24BIT_INT: return 4;
+    case LP_ENCODING_32BIT_INT: return 5;
+    case LP_ENCODING_64BIT_INT: return 9;
+    case LP_EOF: return 1;
+    }
+    assert(NULL);
+    return 0;
+}
+
+/* Store in 'buf', if not NULL, the <element-tot-len> for an element of
+ * 'l' bytes. Returns the number of bytes used.
+ *
+ *  l Ϊ element-tot-len 浽 buf У buf Ϊ NULL
+ * ʹõֽ */
+static unsigned int lpEncodeBacklen(unsigned char *buf, uint64_t l) {
+    unsigned int size, j;
+
+    if (l < (1<<7)) size = 1;
+    else if (l < (1<<14)) size = 2;
+    else if (l < (1<<21)) size = 3;
+    else if (l < (1<<28)) size = 4;
+    else size = 5;
+
+    if (buf) {
+        for (j = size-1; j > 0; j--) {
+            buf[j] = (l&127)|128;
+            l >>= 7;
+        }
+        buf[0] = l;
+    }
+    return size;
+}
+
+/* Decode the <element-tot-len> whose last byte is at 'p'.
+ *
+ *  p ָһֽڿʼ element-tot-len  */
+static uint64_t lpDecodeBacklen(unsigned char *p) {
+    uint64_t val = 0;
+    unsigned int shift = 0;
+
+    while(1) {
+        val |= (uint64_t)(p[0]&127) << shift;
+        if (!(p[0]&128)) break;
+        shift += 7;
+        p--;
+        assert(shift <= 28);
+    }
+    return val;
+}
+
+/* Return the total size of the entry at 'p'.
+ *
+ *  p ָڵռõֽ */
+static uint32_t lpEntrySize(unsigned char *p) {
+    uint32_t len = lpEncodedSize(p);
+    return len+lpEncodeBacklen(NULL,len);
+}
+
+/* Add 'incr', that may be negative, to the number of elements, unless it
+ * is unknown.
+ *
+ * ڽڵ֪£ incr  */
+static void lpIncrLength(unsigned char *lp, long incr) {
+    uint16_t num = intrev16ifbe(LP_LENGTH(lp));
+
+    if (num == LP_HDR_NUMELE_UNKNOWN) return;
+    if ((long)num+incr >= LP_HDR_NUMELE_UNKNOWN) num = LP_HDR_NUMELE_UNKNOWN;
+    else num += incr;
+    LP_LENGTH(lp) = intrev16ifbe(num);
+}
+
+/* Create a new empty listpack.
+ *
+ * һµĿ listpack
+ *
+ * T = O(1)
+ */
+unsigned char *lpNew(void) {
+    unsigned char *lp = zmalloc(LP_HDR_SIZE+1);
+
+    LP_BYTES(lp) = intrev32ifbe(LP_HDR_SIZE+1);
+    LP_LENGTH(lp) = 0;
+    lp[LP_HDR_SIZE] = LP_EOF;
+    return lp;
+}
+
+/* Store the element 's' at 'p', that may point to the end byte. When
+ * 'replace' is true the entry at 'p' is overwritten, otherwise the new
+ * entry is inserted before it.
+ *
+ * ֵ s 浽 p ָλãp ָбĩˣ
+ * replace Ϊʱ p ָĽڵ㣬½ڵ뵽 p ֮ǰ
+ *
+ * T = O(N)
+ */
+static unsigned char *lpStore(unsigned char *lp, unsigned char *p, unsigned char *s, unsigned int slen, int replace) {
+    unsigned char hdr[LP_MAX_INT_ENCODING_LEN], backlen[LP_MAX_BACKLEN_SIZE];
+    unsigned int hdrlen, datalen, backlen_size;
+    uint32_t bytes = intrev32ifbe(LP_BYTES(lp)), oldsize = 0, newsize;
+    size_t offset = p-lp;
+    uint64_t newbytes;
+    long long v;
+
+    // ܱΪֵʹ룬ʹַ
+    if (lpStringToInt64(s,slen,&v)) {
+        hdrlen = lpEncodeInteger(hdr,v);
+        datalen = 0;
+    } else {
+        hdrlen = lpEncodeStringHeader(hdr,slen);
+        datalen = slen;
+    }
+    backlen_size = lpEncodeBacklen(backlen,hdrlen+datalen);
+    newsize = hdrlen+datalen+backlen_size;
+    if (replace) oldsize = lpEntrySize(p);
+
+    newbytes = (uint64_t)bytes-oldsize+newsize;
+    assert(newbytes <= UINT32_MAX);
+
+    /* Only the bytes after the entry are moved: the entries around it are
+     * never touched, so there is nothing like the ziplist cascade update. */
+    // ֻҪƶڵ֮ݣǰڵ㶼Ҫ޸
+    if (newsize > oldsize) {
+        lp = zrealloc(lp,newbytes);
+        p = lp+offset;
+    }
+    memmove(p+newsize,p+oldsize,bytes-offset-oldsize);
+    if (newsize < oldsize) {
+        lp = zrealloc(lp,newbytes);
+        p = lp+offset;
+    }
+
+    memcpy(p,hdr,hdrlen);
+    if (datalen) memcpy(p+hdrlen,s,datalen);
+    memcpy(p+hdrlen+datalen,backlen,backlen_size);
+
+    LP_BYTES(lp) = intrev32ifbe((uint32_t)newbytes);
+    if (!replace) lpIncrLength(lp,1);
+    return lp;
+}
+
+/* Insert the element 's' before the entry at 'p', that may also point to
+ * the end byte to append it.
+ *
+ * ֵ s ½ڵ뵽 p ָĽڵ֮ǰ
+ * p ָбĩʱڵӵβ
+ *
+ * T = O(N)
+ */
+unsigned char *lpInsert(unsigned char *lp, unsigned char *p, unsigned char *s, unsigned int slen) {
+    return lpStore(lp,p,s,slen,0);
+}
+
+/* Replace the entry at '*p' with the element 's'. '*p' is updated to point
+ * to the new entry.
+ *
+ * ֵ s 滻 *p ָĽڵ㣬 *p ָ½ڵ㡣
+ *
+ * T = O(N)
+ */
+unsigned char *lpReplace(unsigned char *lp, unsigned char **p, unsigned char *s, unsigned int slen) {
+    size_t offset = *p-lp;
+
+    lp = lpStore(lp,*p,s,slen,1);
+    *p = lp+offset;
+    return lp;
+}
+
+/* Add the element 's' at the head or at the tail of the listpack.
+ *
+ * ֵ s ӵͷβ
+ *
+ * T = O(N)
+ */
+unsigned char *lpPush(unsigned char *lp, unsigned char *s, unsigned int slen, int where) {
+    unsigned char *p;
+
+    p = (where == LISTPACK_HEAD) ? LP_ENTRY_HEAD(lp) : LP_ENTRY_END(lp);
+    return lpStore(lp,p,s,slen,0);
+}
+
+/* Delete 'num' entries starting at 'p'.
+ *
+ *  p ʼɾ num ڵ㡣 */
+static unsigned char *lpDeleteAt(unsigned char *lp, unsigned char *p, unsigned long num) {
+    uint32_t bytes = intrev32ifbe(LP_BYTES(lp));
+    unsigned char *q = p;
+    unsigned long deleted = 0;
+    size_t size;
+
+    while (deleted < num && q[0] != LP_EOF) {
+        q += lpEntrySize(q);
+        deleted++;
+    }
+    if (deleted == 0) return lp;
+
+    size = q-p;
+    memmove(p,q,bytes-(q-lp));
+    lp = zrealloc(lp,bytes-size);
+    LP_BYTES(lp) = intrev32ifbe(bytes-size);
+    lpIncrLength(lp,-(long)deleted);
+    return lp;
+}
+
+/* Delete the entry at '*p'. '*p' is updated to point to the entry that
+ * followed it, or to the end byte, so that entries can be deleted while
+ * iterating.
+ *
+ * ɾ *p ָĽڵ㣬ԭظ *p ʹָýڵ㣨бĩˣ
+ * ʹÿڵбĹжԽڵɾ
+ *
+ * T = O(N)
+ */
+unsigned char *lpDelete(unsigned char *lp, unsigned char **p) {
+    size_t offset = *p-lp;
+
+    lp = lpDeleteAt(lp,*p,1);
+    *p = lp+offset;
+    return lp;
+}
+
+/* Delete 'num' entries starting at the one at 'index'.
+ *
+ *  index ָĽڵ㿪ʼɾ num ڵ㡣
+ *
+ * T = O(N)
+ */
+unsigned char *lpDeleteRange(unsigned char *lp, long index, unsigned long num) {
+    unsigned char *p = lpSeek(lp,index);
+
+    return (p == NULL) ? lp : lpDeleteAt(lp,p,num);
+}
+
+/* Return the first entry, or NULL if the listpack is empty.
+ *
+ * رͷڵ㣬бΪʱ NULL  */
+unsigned char *lpFirst(unsigned char *lp) {
+    unsigned char *p = LP_ENTRY_HEAD(lp);
+
+    return (p[0] == LP_EOF) ? NULL : p;
+}
+
+/* Return the entry after 'p', or NULL if 'p' is the last entry or the end
+ * byte.
+ *
+ *  p ָڵĺýڵ㡣
+ *  p Ϊĩˣ p ѾǱβڵ㣬ô NULL 
+ *
+ * T = O(1)
+ */
+unsigned char *lpNext(unsigned char *lp, unsigned char *p) {
+    ((void) lp);
+
+    if (p[0] == LP_EOF) return NULL;
+    p += lpEntrySize(p);
+    return (p[0] == LP_EOF) ? NULL : p;
+}
+
+/* Return the entry before 'p', or NULL if 'p' is the first entry. When 'p'
+ * is the end byte the last entry is returned.
+ *
+ *  p ָڵǰýڵ㣬p ѾǱͷڵʱ NULL 
+ *  p ָбĩˣôرβڵ㡣
+ *
+ * T = O(1)
+ */
+unsigned char *lpPrev(unsigned char *lp, unsigned char *p) {
+    uint64_t prevlen;
+
+    if (p == LP_ENTRY_HEAD(lp)) return NULL;
+    p--;
+    prevlen = lpDecodeBacklen(p);
+    prevlen += lpEncodeBacklen(NULL,prevlen);
+    return p-prevlen+1;
+}
+
+/* Return the last entry, or NULL if the listpack is empty.
+ *
+ * رβڵ㣬бΪʱ NULL  */
+unsigned char *lpLast(unsigned char *lp) {
+    return lpPrev(lp,LP_ENTRY_END(lp));
+}
+
+/* Return the entry at 'index', counting from the tail when it is negative,
+ * or NULL if there is no such entry. When the number of elements is known
+ * the list is walked from the closest end.
+ *
+ * ݸؽڵ㣬Ϊʱӱβʼ㡣
+ * Χʱ NULL 
+ * ڵ֪ʱӾϽһ˿ʼ
+ *
+ * T = O(N)
+ */
+unsigned char *lpSeek(unsigned char *lp, long index) {
+    unsigned long numele = intrev16ifbe(LP_LENGTH(lp));
+    unsigned char *p;
+
+    if (numele != LP_HDR_NUMELE_UNKNOWN) {
+        if (index < 0) index += (long)numele;
+        if (index < 0 || (unsigned long)index >= numele) return NULL;
+        if ((unsigned long)index > numele/2) index -= (long)numele;
+    }
+
+    if (index >= 0) {
+        p = LP_ENTRY_HEAD(lp);
+        while (index-- > 0 && p[0] != LP_EOF) p += lpEntrySize(p);
+        return (p[0] == LP_EOF) ? NULL : p;
+    } else {
+        p = lpLast(lp);
+        while (++index < 0 && p != NULL) p = lpPrev(lp,p);
+        return p;
+    }
+}
+
+/* Get the entry at 'p'. A string is stored in '*sstr' and '*slen', an
+ * integer in '*sval', and '*sstr' is set to NULL so the caller can tell
+ * which one was set. Returns 0 if 'p' is NULL or the end byte, 1 otherwise.
+ *
+ * ȡ p ָڵֵ
+ *
+ * - ڵ㱣ַôֵַָ뱣浽 *sstr Уַȱ浽 *slen
+ *
+ * - ڵ㱣ô浽 *sval
+ *
+ * ͨ *sstr ǷΪ NULL ֵַ
+ *
+ *  p Ϊգ p ָбĩˣô 0 򷵻 1 
+ *
+ * T = O(1)
+ */
+unsigned int lpGet(unsigned char *p, unsigned char **sstr, unsigned int *slen, long long *sval) {
+    unsigned char *s;
+    uint32_t len;
+
+    if (p == NULL || p[0] == LP_EOF) return 0;
+    if (sstr) *sstr = NULL;
+
+    if ((s = lpGetString(p,&len)) != NULL) {
+        if (sstr) {
+            *slen = len;
+            *sstr = s;
+        }
+    } else {
+        if (sval) *sval = lpDecodeInteger(p);
+    }
+    return 1;
+}
+
+/* Compare the entry at 'p' with the element 's'. Returns 1 if equal.
+ *
+ *  p ָĽڵֵ s жԱȣȷ 1 ȷ 0 
+ *
+ * T = O(N)
+ */
+unsigned int lpCompare(unsigned char *p, unsigned char *s, unsigned int slen) {
+    unsigned char *str;
+    uint32_t len;
+    long long v;
+
+    if (p[0] == LP_EOF) return 0;
+    if ((str = lpGetString(p,&len)) != NULL)
+        return len == slen && memcmp(str,s,slen) == 0;
+    return lpStringToInt64(s,slen,&v) && lpDecodeInteger(p) == v;
+}
+
+/* Return the first entry equal to the element 's', starting at 'p' and
+ * skipping 'skip' entries between every comparison, or NULL if there is
+ * none.
+ *
+ *  p ʼѰҽڵֵ s ȵĽڵ㣬ظýڵָ롣
+ * ÿαȶ֮ǰ skip ڵ㡣
+ * ҲӦĽڵ㣬򷵻 NULL 
+ *
+ * T = O(N)
+ */
+unsigned char *lpFind(unsigned char *p, unsigned char *s, unsigned int slen, unsigned int skip) {
+    unsigned int skipcnt = 0;
+    int sencoded = -1;
+    long long sval = 0;
+    /* Short strings and small integers are the bulk of the entries of
+     * small hashes and sets: both have a one byte header and a one byte
+     * <element-tot-len>, so they are skipped and compared without calling
+     * the generic decoding functions. A short string only matches when its
+     * header byte is the one 's' would have, and its first byte is the
+     * same as the one of 's', so memcmp() is rarely called. */
+    // ַССϣСĽڵ㣬
+    // ǵͷ element-tot-len ֻռһֽڣ
+    // ԿԲͨõĽ뺯ֱӶǽбȽϺ
+    // ֻͷֽں s ͷֽͬҵһֽҲͬʱ
+    // Ҫ memcmp() Աȶַ
+    unsigned char shdr = (slen < 64) ? (LP_ENCODING_6BIT_STR|slen) : 0;
+
+    while (p[0] != LP_EOF) {
+        if (LP_ENCODING_IS_6BIT_STR(p[0])) {
+            if (skipcnt == 0) {
+                if (p[0] == shdr &&
+                    (slen == 0 || (p[1] == s[0] && memcmp(p+1,s,slen) == 0)))
+                    return p;
+                skipcnt = skip;
+            } else {
+                skipcnt--;
+            }
+            p += (p[0]&0x3f)+2;
+            continue;
+        } else if (LP_ENCODING_IS_7BIT_UINT(p[0])) {
+            if (skipcnt == 0) {
+                if (sencoded == -1) sencoded = lpStringToInt64(s,slen,&sval);
+                if (sencoded && sval == p[0]) return p;
+                skipcnt = skip;
+            } else {
+                skipcnt--;
+            }
+            p += 2;
+            continue;
+        }
+
+        if (skipcnt == 0) {
+            unsigned char *str;
+            uint32_t len;
+
+            if ((str = lpGetString(p,&len)) != NULL) {
+                if (len == slen && memcmp(str,s,slen) == 0) return p;
+            } else {
+                /* Try to encode the searched element as an integer only
+                 * once, the first time an integer entry is found. */
+                // һڵʱԽ s Ϊֻһ
+                if (sencoded == -1) sencoded = lpStringToInt64(s,slen,&sval);
+                if (sencoded && lpDecodeInteger(p) == sval) return p;
+            }
+            skipcnt = skip;
+        } else {
+            skipcnt--;
+        }
+        p += lpEntrySize(p);
+    }
+    return NULL;
+}
+
+/* Return the number of elements. When it isn't stored in the header the
+ * list is traversed, and the header updated if the count fits.
+ *
+ *  listpack еĽڵ
+ * ͷûм¼ڵʱҪб
+ *
+ * T = O(N)
+ */
+unsigned long lpLength(unsigned char *lp) {
+    unsigned long num = intrev16ifbe(LP_LENGTH(lp));
+    unsigned char *p;
+
+    if (num != LP_HDR_NUMELE_UNKNOWN) return num;
+
+    num = 0;
+    p = LP_ENTRY_HEAD(lp);
+    while (p[0] != LP_EOF) {
+        p += lpEntrySize(p);
+        num++;
+    }
+    if (num < LP_HDR_NUMELE_UNKNOWN) LP_LENGTH(lp) = intrev16ifbe(num);
+    return num;
+}
+
+/* Return the size of the listpack in bytes.
+ *
+ *  listpack ռõڴֽ
+ *
+ * T = O(1)
+ */
+size_t lpBytes(unsigned char *lp) {
+    return intrev32ifbe(LP_BYTES(lp));
+}
+
+void lpRepr(unsigned char *lp) {
+    unsigned char *p, *s;
+    unsigned int slen;
+    long long v;
+    int index = 0;
+
+    printf("{total bytes %u} {num elements %u}\n",
+        intrev32ifbe(LP_BYTES(lp)), intrev16ifbe(LP_LENGTH(lp)));
+    p = LP_ENTRY_HEAD(lp);
+    while (p[0] != LP_EOF) {
+        lpGet(p,&s,&slen,&v);
+        printf("{addr 0x%08lx, index %2d, offset %5ld, entry size %5u, ",
+            (long unsigned)p, index, (long)(p-lp), lpEntrySize(p));
+        if (s) {
+            printf("string %u bytes: ", slen);
+            if (fwrite(s,slen > 40 ? 40 : slen,1,stdout) == 0) perror("fwrite");
+            if (slen > 40) printf("...");
+        } else {
+            printf("integer %lld", v);
+        }
+        printf("}\n");
+        p += lpEntrySize(p);
+        index++;
+    }
+    printf("{end}\n\n");
+}
+
+#ifdef LISTPACK_TEST_MAIN
+/* Build with:
+ *
+ *   cc -O2 -DLISTPACK_TEST_MAIN listpack.c ziplist.c util.c sds.c zmalloc.c -lm -o listpack-test
+ *
+ * './listpack-test [seed]' checks the listpack against an array of strings
+ * with random operations, then times the insertions and deletions that
+ * make a ziplist cascade update, and the field lookups of small hashes,
+ * on a ziplist and on a listpack. */
+#include <sys/time.h>
+#include <time.h>
+#include "sds.h"
+#include "ziplist.h"
+
+/* Normally provided by debug.c. */
+void _redisAssert(char *estr, char *file, int line) {
+    fprintf(stderr,"=== ASSERTION FAILED ===\n");
+    fprintf(stderr,"==> %s:%d '%s' is not true\n",file,line,estr);
+    exit(1);
+}
+
+static long long usec(void) {
+    struct timeval tv;
+    gettimeofday(&tv,NULL);
+    return (((long long)tv.tv_sec)*1000000)+tv.tv_usec;
+}
+
+/* Return the entry at 'p' as a new sds string. */
+static sds lpEntryToSds(unsigned char *p) {
+    unsigned char *s;
+    unsigned int slen;
+    long long v;
+
+    assert(lpGet(p,&s,&slen,&v));
+    return s ? sdsnewlen(s,slen) : sdsfromlonglong(v);
+}
+
+/* Check that 'lp' holds the 'len' strings of 'ref', walking it in both
+ * directions and seeking every index. */
+static void checkListpack(unsigned char *lp, sds *ref, long len) {
+    unsigned char *p;
+    long j;
+
+    assert(lpLength(lp) == (unsigned long)len);
+    for (p = lpFirst(lp), j = 0; p; p = lpNext(lp,p), j++) {
+        sds s = lpEntryToSds(p);
+        assert(sdscmp(s,ref[j]) == 0);
+        assert(lpCompare(p,(unsigned char*)ref[j],sdslen(ref[j])));
+        sdsfree(s);
+    }
+    assert(j == len);
+    for (p = lpLast(lp), j = len-1; p; p = lpPrev(lp,p), j--) {
+        sds s = lpEntryToSds(p);
+        assert(sdscmp(s,ref[j]) == 0);
+        sdsfree(s);
+    }
+    assert(j == -1);
+    for (j = 0; j < len; j += 1+len/50) {
+        assert(lpSeek(lp,j) == lpSeek(lp,j-len));
+        assert(lpCompare(lpSeek(lp,j),(unsigned char*)ref[j],sdslen(ref[j])));
+    }
+    assert(lpSeek(lp,len) == NULL && lpSeek(lp,-len-1) == NULL);
+}
+
+/* A random element: an integer of random size, or a string of random length
+ * crossing the boundaries of the string and backlen encodings. */
+static sds randomElement(void) {
+    static const int lens[] = {0, 1, 63, 64, 126, 127, 4095, 4096, 16380, 16390};
+    sds s;
+    int j;
+
+    switch(rand() % 3) {
+    case 0:
+        return sdsfromlonglong(((long long)rand() << 32 | rand()) >> (rand() % 64));
+    case 1:
+        return sdsfromlonglong(-(((long long)rand() << 32 | rand()) >> (rand() % 64)));
+    default:
+        s = sdsempty();
+        j = lens[rand() % 10] + (rand() % 3) - 1;
+        if (j < 0) j = 0;
+        s = sdsgrowzero(s,j);
+        for (j = 0; j < (int)sdslen(s); j++) s[j] = 'a'+rand()%26;
+        return s;
+    }
+}
+
+#define CHECK_OPS 4000
+#define CHECK_MAX 300
+
+static void checkRandomOps(void) {
+    unsigned char *lp = lpNew(), *p;
+    sds ref[CHECK_MAX+1];
+    long len = 0, j, k;
+    int op;
+
+    for (op = 0; op < CHECK_OPS; op++) {
+        int action = rand() % 6;
+
+        if (len == CHECK_MAX) action = 3;
+        if (len == 0) action = 0;
+        j = len ? rand() % len : 0;
+        switch(action) {
+        case 0: /* Insert, possibly at the end. */
+            j = rand() % (len+1);
+            memmove(ref+j+1,ref+j,sizeof(sds)*(len-j));
+            ref[j] = randomElement();
+            if (j == len) lp = lpPush(lp,(unsigned char*)ref[j],sdslen(ref[j]),LISTPACK_TAIL);
+            else lp = lpInsert(lp,lpSeek(lp,j),(unsigned char*)ref[j],sdslen(ref[j]));
+            len++;
+            break;
+        case 1: /* Push at the head. */
+            memmove(ref+1,ref,sizeof(sds)*len);
+            ref[0] = randomElement();
+            lp = lpPush(lp,(unsigned char*)ref[0],sdslen(ref[0]),LISTPACK_HEAD);
+            len++;
+            break;
+        case 2: /* Replace. */
+            p = lpSeek(lp,j);
+            sdsfree(ref[j]);
+            ref[j] = randomElement();
+            lp = lpReplace(lp,&p,(unsigned char*)ref[j],sdslen(ref[j]));
+            assert(lpCompare(p,(unsigned char*)ref[j],sdslen(ref[j])));
+            break;
+        case 3: /* Delete. */
+            p = lpSeek(lp,j);
+            lp = lpDelete(lp,&p);
+            assert(j == len-1 ? lpNext(lp,p) == NULL : lpCompare(p,(unsigned char*)ref[j+1],sdslen(ref[j+1])));
+            sdsfree(ref[j]);
+            memmove(ref+j,ref+j+1,sizeof(sds)*(len-j-1));
+            len--;
+            break;
+        case 4: /* Delete a range, possibly past the end. */
+            k = rand() % 5;
+            lp = lpDeleteRange(lp,j-len,k);
+            if (k > len-j) k = len-j;
+            for (; k > 0; k--) {
+                sdsfree(ref[j]);
+                memmove(ref+j,ref+j+1,sizeof(sds)*(len-j-1));
+                len--;
+            }
+            break;
+        case 5: /* Find, only the entries at even offsets. */
+            p = lpFind(lpFirst(lp),(unsigned char*)ref[j],sdslen(ref[j]),1);
+            for (k = 0; k < len; k += 2)
+                if (sdscmp(ref[k],ref[j]) == 0) break;
+            assert(k < len ? p == lpSeek(lp,k) : p == NULL);
+            break;
+        }
+        checkListpack(lp,ref,len);
+    }
+    for (j = 0; j < len; j++) sdsfree(ref[j]);
+    zfree(lp);
+}
+
+/* Integers must be read back as they were written, in the smallest
+ * encoding, and strings that aren't canonical numbers stay strings. */
+static void checkIntegers(void) {
+    static const char *ints[] = {"0", "127", "128", "-1", "-4096", "4095",
+        "4096", "-4097", "32767", "-32768", "32768", "8388607", "-8388608",
+        "8388608", "2147483647", "-2147483648", "2147483648",
+        "9223372036854775807", "-9223372036854775808"};
+    static const unsigned int sizes[] = {2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5,
+        5, 6, 6, 6, 10, 10, 10};
+    static const char *strs[] = {"", "-", "01", "+1", " 1", "1 ", "-0",
+        "9223372036854775808", "1.5"};
+    unsigned char *lp = lpNew(), *p, *s;
+    unsigned int slen, j;
+    long long v;
+
+    for (j = 0; j < sizeof(ints)/sizeof(ints[0]); j++) {
+        lp = lpPush(lp,(unsigned char*)ints[j],strlen(ints[j]),LISTPACK_TAIL);
+        p = lpLast(lp);
+        assert(lpGet(p,&s,&slen,&v) && s == NULL);
+        assert(v == strtoll(ints[j],NULL,10));
+        assert(lpEntrySize(p) == sizes[j]);
+    }
+    for (j = 0; j < sizeof(strs)/sizeof(strs[0]); j++) {
+        lp = lpPush(lp,(unsigned char*)strs[j],strlen(strs[j]),LISTPACK_TAIL);
+        assert(lpGet(lpLast(lp),&s,&slen,&v) && s != NULL);
+        assert(slen == strlen(strs[j]) && memcmp(s,strs[j],slen) == 0);
+    }
+    zfree(lp);
+}
+
+/* Past 65534 elements the count isn't kept in the header. */
+static void checkManyElements(void) {
+    unsigned char *lp = lpNew();
+    long j;
+
+    for (j = 0; j < 70000; j++)
+        lp = lpPush(lp,(unsigned char*)"x",1,LISTPACK_TAIL);
+    assert(lpLength(lp) == 70000);
+    assert(lpSeek(lp,-1) == lpLast(lp) && lpSeek(lp,69999) == lpLast(lp));
+    lp = lpDeleteRange(lp,0,10000);
+    assert(lpLength(lp) == 60000);
+    lp = lpDeleteRange(lp,-1,1);
+    assert(lpLength(lp) == 59999 && lpSeek(lp,59999) == NULL);
+    zfree(lp);
+}
+
+#define BENCH_ROUNDS 20
+
+/* Time the operations that trigger the worst ziplist cascade update, on a
+ * list of 'len' entries of 250 bytes each, just below the 254 bytes that
+ * make the next entry use a 5 bytes prevlen:
+ *
+ * - insert a 300 bytes entry at the head;
+ * - delete the small entry that separates a 300 bytes head from the rest.
+ *
+ * Every entry after the change grows by 4 bytes in the ziplist, so the
+ * whole list is rewritten, while the listpack only moves the bytes once.
+ * The lists are built again before every round, out of the timing. */
+static void benchCascade(int len) {
+    char big[300], entry[250];
+    long long zlinsert = 0, zldelete = 0, lpinsert = 0, lpdelete = 0, start;
+    int round, j;
+
+    memset(big,'b',sizeof(big));
+    memset(entry,'e',sizeof(entry));
+    for (round = 0; round < BENCH_ROUNDS; round++) {
+        unsigned char *zl = ziplistNew(), *lp = lpNew(), *p;
+
+        for (j = 0; j < len; j++) {
+            zl = ziplistPush(zl,(unsigned char*)entry,sizeof(entry),ZIPLIST_TAIL);
+            lp = lpPush(lp,(unsigned char*)entry,sizeof(entry),LISTPACK_TAIL);
+        }
+
+        start = usec();
+        zl = ziplistPush(zl,(unsigned char*)big,sizeof(big),ZIPLIST_HEAD);
+        zlinsert += usec()-start;
+        start = usec();
+        lp = lpPush(lp,(unsigned char*)big,sizeof(big),LISTPACK_HEAD);
+        lpinsert += usec()-start;
+        zfree(zl);
+        zfree(lp);
+
+        /* Now a small entry after the big one: deleting it makes the next
+         * entry follow a big one. */
+        zl = ziplistNew();
+        lp = lpNew();
+        zl = ziplistPush(zl,(unsigned char*)big,sizeof(big),ZIPLIST_TAIL);
+        zl = ziplistPush(zl,(unsigned char*)"small",5,ZIPLIST_TAIL);
+        lp = lpPush(lp,(unsigned char*)big,sizeof(big),LISTPACK_TAIL);
+        lp = lpPush(lp,(unsigned char*)"small",5,LISTPACK_TAIL);
+        for (j = 0; j < len; j++) {
+            zl = ziplistPush(zl,(unsigned char*)entry,sizeof(entry),ZIPLIST_TAIL);
+            lp = lpPush(lp,(unsigned char*)entry,sizeof(entry),LISTPACK_TAIL);
+        }
+
+        start = usec();
+        p = ziplistIndex(zl,1);
+        zl = ziplistDelete(zl,&p);
+        zldelete += usec()-start;
+        start = usec();
+        p = lpSeek(lp,1);
+        lp = lpDelete(lp,&p);
+        lpdelete += usec()-start;
+        zfree(zl);
+        zfree(lp);
+    }
+    printf("%6d entries: insert at head %8.1f usec ziplist, %6.1f usec listpack; "
+           "delete %8.1f usec ziplist, %6.1f usec listpack\n", len,
+        (double)zlinsert/BENCH_ROUNDS, (double)lpinsert/BENCH_ROUNDS,
+        (double)zldelete/BENCH_ROUNDS, (double)lpdelete/BENCH_ROUNDS);
+}
+
+/* Time the lookup of every field of a hash of 'len' fields stored as a
+ * ziplist and as a listpack, the way HGET and HEXISTS do it, then the
+ * same number of lookups of missing fields. */
+static void benchFind(int len) {
+    unsigned char *zl = ziplistNew(), *lp = lpNew(), *p;
+    char **fields = malloc(sizeof(char*)*len);
+    long long start, zlhit, lphit, zlmiss, lpmiss;
+    int j, k, l, rounds = 200000/len;
+    char buf[32];
+
+    for (j = 0; j < len; j++) {
+        l = snprintf(buf,sizeof(buf),"field:%d",j);
+        fields[j] = strdup(buf);
+        zl = ziplistPush(zl,(unsigned char*)buf,l,ZIPLIST_TAIL);
+        lp = lpPush(lp,(unsigned char*)buf,l,LISTPACK_TAIL);
+        l = (j & 1) ? snprintf(buf,sizeof(buf),"%d",j*10) :
+                      snprintf(buf,sizeof(buf),"value:%d",j);
+        zl = ziplistPush(zl,(unsigned char*)buf,l,ZIPLIST_TAIL);
+        lp = lpPush(lp,(unsigned char*)buf,l,LISTPACK_TAIL);
+    }
+
+    start = usec();
+    for (k = 0; k < rounds; k++) {
+        for (j = 0; j < len; j++) {
+            p = ziplistFind(ziplistIndex(zl,ZIPLIST_HEAD),
+                (unsigned char*)fields[j],strlen(fields[j]),1);
+            assert(p != NULL);
+        }
+    }
+    zlhit = usec()-start;
+    start = usec();
+    for (k = 0; k < rounds; k++) {
+        for (j = 0; j < len; j++) {
+            p = lpFind(lpFirst(lp),(unsigned char*)fields[j],
+                strlen(fields[j]),1);
+            assert(p != NULL);
+        }
+    }
+    lphit = usec()-start;
+
+    start = usec();
+    for (k = 0; k < rounds; k++) {
+        for (j = 0; j < len; j++) {
+            p = ziplistFind(ziplistIndex(zl,ZIPLIST_HEAD),
+                (unsigned char*)"missing",7,1);
+            assert(p == NULL);
+        }
+    }
+    zlmiss = usec()-start;
+    start = usec();
+    for (k = 0; k < rounds; k++) {
+        for (j = 0; j < len; j++) {
+            p = lpFind(lpFirst(lp),(unsigned char*)"missing",7,1);
+            assert(p == NULL);
+        }
+    }
+    lpmiss = usec()-start;
+
+    printf("%6d fields: hit %6.1f ns ziplist, %6.1f ns listpack; "
+           "miss %6.1f ns ziplist, %6.1f ns listpack\n", len,
+        (double)zlhit*1000/rounds/len, (double)lphit*1000/rounds/len,
+        (double)zlmiss*1000/rounds/len, (double)lpmiss*1000/rounds/len);
+    for (j = 0; j < len; j++) free(fields[j]);
+    free(fields);
+    zfree(zl);
+    zfree(lp);
+}
+
+int main(int argc, char **argv) {
+    int sizes[] = {64, 256, 1024, 4096}, j;
+    int fields[] = {8, 32, 128, 512};
+
+    /* If an argument is given, use it as the random seed. */
+    srand(argc == 2 ? atoi(argv[1]) : time(NULL));
+
+    checkIntegers();
+    printf("Integers are stored in the smallest encoding: ok\n");
+    checkManyElements();
+    printf("Listpacks with more than 65534 elements: ok\n");
+    checkRandomOps();
+    printf("Random operations against an array of strings: ok\n");
+
+    printf("Cascade update worst case, average of %d rounds:\n", BENCH_ROUNDS);
+    for (j = 0; j < 4; j++) benchCascade(sizes[j]);
+
+    printf("Field lookups, average per lookup:\n");
+    for (j = 0; j < 4; j++) benchFind(fields[j]);
+    return 0;
+}
+#endif
@@ -0,0 +1,32 @@
+/* Listpack -- A list of strings serialization format, see listpack.c.
+ *
+ * Listpack  ַблʽ listpack.c
+ */
+
+#ifndef __LISTPACK_H
+#define __LISTPACK_H
+
+#include <stdlib.h>
+
+#define LISTPACK_HEAD 0
+#define LISTPACK_TAIL 1
+
+unsigned char *lpNew(void);
+unsigned char *lpPush(unsigned char *lp, unsigned char *s, unsigned int slen, int where);
+unsigned char *lpSeek(unsigned char *lp, long index);
+unsigned char *lpFirst(unsigned char *lp);
+unsigned char *lpLast(unsigned char *lp);
+unsigned char *lpNext(unsigned char *lp, unsigned char *p);
+unsigned char *lpPrev(unsigned char *lp, unsigned char *p);
+unsigned int lpGet(unsigned char *p, unsigned char **sval, unsigned int *slen, long long *lval);
+unsigned char *lpInsert(unsigned char *lp, unsigned char *p, unsigned char *s, unsigned int slen);
+unsigned char *lpReplace(unsigned char *lp, unsigned char **p, unsigned char *s, unsigned int slen);
+unsigned char *lpDelete(unsigned char *lp, unsigned char **p);
+unsigned char *lpDeleteRange(unsigned char *lp, long index, unsigned long num);
+unsigned int lpCompare(unsigned char *p, unsigned char *s, unsigned int slen);
+unsigned char *lpFind(unsigned char *p, unsigned char *s, unsigned int slen, unsigned int skip);
+unsigned long lpLength(unsigned char *lp);
+size_t lpBytes(unsigned char *lp);
+void lpRepr(unsigned char *lp);
+
+#endif
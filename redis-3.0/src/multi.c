@@ -167,7 +167,7 @@ void execCommandPropagateMulti(redisClient *c) {
 void execCommand(redisClient *c) {
     int j;
     robj **orig_argv;
-    int orig_argc;
+    int orig_argc, orig_argv_len;
     struct redisCommand *orig_cmd;
     int must_propagate = 0; /* Need to propagate MULTI/EXEC to AOF / slaves? */
 
@@ -217,6 +217,7 @@ void execCommand(redisClient *c) {
     // ΪȷشҪֱЩͲ
     orig_argv = c->argv;
     orig_argc = c->argc;
+    orig_argv_len = c->argv_len;
     orig_cmd = c->cmd;
 
     addReplyMultiBulkLen(c,c->mstate.count);
@@ -265,6 +266,7 @@ void execCommand(redisClient *c) {
     // ԭ
     c->argv = orig_argv;
     c->argc = orig_argc;
+    c->argv_len = orig_argv_len;
     c->cmd = orig_cmd;
 
     // ״̬
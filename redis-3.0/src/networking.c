@@ -31,7 +31,17 @@
 #include <sys/uio.h>
 #include <math.h>
 
-static void setProtocolError(redisClient *c, int pos);
+/* Max number of buffers flushed by a single writev() call. */
+#if defined(IOV_MAX) && IOV_MAX < 1024
+#define REDIS_IOV_MAX IOV_MAX
+#else
+#define REDIS_IOV_MAX 1024
+#endif
+
+static void setProtocolError(const char *errstr, redisClient *c, int pos);
+static int postponeClientRead(redisClient *c);
+static void readClientSocket(redisClient *c);
+static void processClientReadResult(redisClient *c);
 
 /* To evaluate the output buffer size of a client we need to get size of
  * allocated objects, however we can't used zmalloc_size() directly on sds
@@ -39,7 +49,7 @@ static void setProtocolError(redisClient *c, int pos);
  * returned pointer), so we use this helper function. */
 // ĴС 
 size_t zmalloc_size_sds(sds s) {
-    return zmalloc_size(s-sizeof(struct sdshdr));
+    return zmalloc_size(sdsAllocPtr(s));
 }
 
 /* Return the amount of memory used by the sds string at object->ptr
@@ -117,12 +127,16 @@ redisClient *createClient(int fd) { //createClient
     c->querybuf = sdsempty();
     // ѯֵ
     c->querybuf_peak = 0;
+    // ѯѽݵĳ
+    c->qb_pos = 0;
     // 
     c->reqtype = 0;
     // 
     c->argc = 0;
     // 
     c->argv = NULL;
+    c->argv_len = 0;
+    memset(c->argv_cache,0,sizeof(c->argv_cache));
     // ǰִеһִе
     c->cmd = c->lastcmd = NULL;
     // ѯδ
@@ -168,12 +182,20 @@ redisClient *createClient(int fd) { //createClient
     c->bpop.numreplicas = 0;
     c->bpop.reploffset = 0;
     c->woff = 0;
+    c->aof_fsync_seq = 0;
     // ʱӵļ
     c->watched_keys = listCreate();
     // ĵƵģʽ
     c->pubsub_channels = dictCreate(&setDictType,NULL);
     c->pubsub_patterns = listCreate();
     c->peerid = NULL;
+    c->io_nread = 0;
+    c->io_errno = 0;
+    c->io_sentnodes = 0;
+    c->io_sentbuf = 0;
+    c->io_writecalls = 0;
+    c->io_written = 0;
+    c->io_protoerr = NULL;
     listSetFreeMethod(c->pubsub_patterns,decrRefCountVoid);
     listSetMatchMethod(c->pubsub_patterns,listMatchObjects);
     // αͻˣôӵĿͻ
@@ -214,6 +236,30 @@ redisClient *createClient(int fd) { //createClient
  * ͨÿظʱã REDIS_ERR 
  * ôûݻᱻ׷ӵ
  */
+/* Arrange for the pending reply of the client to be written: either queue
+ * the client for the I/O threads or install the write handler.
+ *
+ * дͻ˵Ļظ I/O ̣߳߰װд */
+int clientInstallWriteHandler(redisClient *c) {
+    /* With threaded I/O the reply is written by the I/O threads from
+     * beforeSleep(), so there is no need to install the write handler
+     * unless the threads are not able to write it all at once. */
+    //  I/O ߳ʱظ beforeSleep()  I/O ߳д
+    if (server.io_threads_num > 1 &&
+        !(c->flags & (REDIS_SLAVE|REDIS_MASTER)))
+    {
+        if (!(c->flags & REDIS_PENDING_WRITE)) {
+            c->flags |= REDIS_PENDING_WRITE;
+            listAddNodeTail(server.clients_pending_write,c);
+        }
+    } else if (aeCreateFileEvent(server.el, c->fd, AE_WRITABLE,
+               sendReplyToClient, c) == AE_ERR)
+    {
+        return REDIS_ERR;
+    }
+    return REDIS_OK;
+}
+
 int prepareClientToWrite(redisClient *c) {
 
     // LUA űʹõαͻǿд
@@ -227,12 +273,18 @@ int prepareClientToWrite(redisClient *c) {
     // ӵαͻǲд
     if (c->fd <= 0) return REDIS_ERR; /* Fake client */
 
+    /* The reply is held until the AOF is fsynced: just accumulate it,
+     * aofGroupCommitRelease() will install the write handler. */
+    // ظ AOF fsync Ϊֹֻۻظװд
+    if (c->flags & REDIS_AOF_FSYNC_WAIT) return REDIS_OK;
+
     // һΪͻ׽ְװд¼ѭ
     if (c->bufpos == 0 && listLength(c->reply) == 0 &&
         (c->replstate == REDIS_REPL_NONE ||
-         c->replstate == REDIS_REPL_ONLINE) &&
-        aeCreateFileEvent(server.el, c->fd, AE_WRITABLE,
-        sendReplyToClient, c) == AE_ERR) return REDIS_ERR;
+         c->replstate == REDIS_REPL_ONLINE))
+    {
+        if (clientInstallWriteHandler(c) == REDIS_ERR) return REDIS_ERR;
+    }
 
     return REDIS_OK;
 }
@@ -255,6 +307,21 @@ robj *dupLastObjectIfNeeded(list *reply) {
     return listNodeValue(ln);
 }
 
+/* Return true if 'len' bytes can be appended to the object at the tail of
+ * the reply list. Big string values referenced by the list instead of being
+ * copied (see _addReplyObjectToList()) are never appended to when still
+ * shared, since dupLastObjectIfNeeded() would then copy them anyway.
+ *
+ * жǷԽ len ֽڵƴӵظıβС
+ * βǱֱõĴַʱƴӣ⸴ */
+static int replyListTailHasRoom(robj *tail, size_t len) {
+    return tail->ptr != NULL &&
+           tail->encoding == REDIS_ENCODING_RAW &&
+           (tail->refcount == 1 ||
+            sdslen(tail->ptr) < REDIS_REPLY_ZEROCOPY_BYTES) &&
+           sdslen(tail->ptr)+len <= REDIS_REPLY_CHUNK_BYTES;
+}
+
 /* -----------------------------------------------------------------------------
  * Low level functions to add more data to output buffers.
  * -------------------------------------------------------------------------- */
@@ -286,6 +353,13 @@ int _addReplyToBuffer(redisClient *c, char *s, size_t len) {
 
 /*
  * ظһ SDS ӵ c->reply ظ
+ *
+ * String values of at least REDIS_REPLY_ZEROCOPY_BYTES are not copied:
+ * the list references the object itself, and its bytes are written to the
+ * socket straight from it.
+ *
+ * ȲС REDIS_REPLY_ZEROCOPY_BYTES Ķ󲻻ᱻƣ
+ * üֱӵУдظʱֱӴӶд׽
  */
 void _addReplyObjectToList(redisClient *c, robj *o) {
     robj *tail;
@@ -309,9 +383,8 @@ void _addReplyObjectToList(redisClient *c, robj *o) {
         /* Append to this object when possible. */
         // β SDS ÿռ϶ĳȣС REDIS_REPLY_CHUNK_BYTES
         // ô¶ƴӵβ SDS ĩβ
-        if (tail->ptr != NULL &&
-            tail->encoding == REDIS_ENCODING_RAW &&
-            sdslen(tail->ptr)+sdslen(o->ptr) <= REDIS_REPLY_CHUNK_BYTES)
+        if (sdslen(o->ptr) < REDIS_REPLY_ZEROCOPY_BYTES &&
+            replyListTailHasRoom(tail,sdslen(o->ptr)))
         {
             c->reply_bytes -= zmalloc_size_sds(tail->ptr);
             tail = dupLastObjectIfNeeded(c->reply);
@@ -349,9 +422,7 @@ void _addReplySdsToList(redisClient *c, sds s) {
         tail = listNodeValue(listLast(c->reply));
 
         /* Append to this object when possible. */
-        if (tail->ptr != NULL && tail->encoding == REDIS_ENCODING_RAW &&
-            sdslen(tail->ptr)+sdslen(s) <= REDIS_REPLY_CHUNK_BYTES)
-        {
+        if (replyListTailHasRoom(tail,sdslen(s))) {
             c->reply_bytes -= zmalloc_size_sds(tail->ptr);
             tail = dupLastObjectIfNeeded(c->reply);
             tail->ptr = sdscatlen(tail->ptr,s,sdslen(s));
@@ -380,9 +451,7 @@ void _addReplyStringToList(redisClient *c, char *s, size_t len) {
         tail = listNodeValue(listLast(c->reply));
 
         /* Append to this object when possible. */
-        if (tail->ptr != NULL && tail->encoding == REDIS_ENCODING_RAW &&
-            sdslen(tail->ptr)+len <= REDIS_REPLY_CHUNK_BYTES)
-        {
+        if (replyListTailHasRoom(tail,len)) {
             c->reply_bytes -= zmalloc_size_sds(tail->ptr);
             tail = dupLastObjectIfNeeded(c->reply);
             // ַƴӵһ SDS ֮
@@ -423,8 +492,13 @@ void addReply(redisClient *c, robj *obj) {
      * ôͿڲŪڴҳ£͸ͻˡ
      */
     if (sdsEncodedObject(obj)) {
+        // ֱӱظãƵ c->buf 
+        if (obj->encoding == REDIS_ENCODING_RAW &&
+            sdslen(obj->ptr) >= REDIS_REPLY_ZEROCOPY_BYTES)
+        {
+            _addReplyObjectToList(c,obj);
         // ȳԸݵ c->buf УԱڴ
-        if (_addReplyToBuffer(c,obj->ptr,sdslen(obj->ptr)) != REDIS_OK)
+        } else if (_addReplyToBuffer(c,obj->ptr,sdslen(obj->ptr)) != REDIS_OK)
             //  c->buf еĿռ䲻͸Ƶ c->reply 
             // ܻڴ
             _addReplyObjectToList(c,obj);
@@ -852,12 +926,65 @@ void acceptUnixHandler(aeEventLoop *el, int fd, void *privdata, int mask) {
  */
 static void freeClientArgv(redisClient *c) {
     int j;
-    for (j = 0; j < c->argc; j++)
-        decrRefCount(c->argv[j]);
+    for (j = 0; j < c->argc; j++) {
+        robj *o = c->argv[j];
+
+        /* Try to keep the object for the next command, see
+         * createClientArgObject(). The object must be small, SDS-encoded,
+         * and with refcount = 1 (we must be the only owner) for us to
+         * cache it. */
+        // СĲ󱣴ڽһʱ
+        if (j < REDIS_ARGV_CACHE_SIZE &&
+            o->refcount == 1 &&
+            (o->encoding == REDIS_ENCODING_RAW ||
+             o->encoding == REDIS_ENCODING_EMBSTR) &&
+            sdsalloc(o->ptr) <= REDIS_ARGV_CACHE_MAX_LEN)
+        {
+            if (c->argv_cache[j]) decrRefCount(c->argv_cache[j]);
+            c->argv_cache[j] = o;
+        } else {
+            decrRefCount(o);
+        }
+    }
     c->argc = 0;
     c->cmd = NULL;
 }
 
+/* Release the argument objects cached by freeClientArgv(). */
+// ͷſͻ˻Ĳ
+static void freeClientArgvCache(redisClient *c) {
+    int j;
+
+    for (j = 0; j < REDIS_ARGV_CACHE_SIZE; j++) {
+        if (c->argv_cache[j]) decrRefCount(c->argv_cache[j]);
+        c->argv_cache[j] = NULL;
+    }
+}
+
+/* Create the object of the argument 'j' of the command being parsed. The
+ * object that was argument 'j' of the previous command is reused when its
+ * SDS string is big enough, like luaRedisGenericCommand() does for the Lua
+ * client, so that pipelines of similar commands don't allocate anything.
+ *
+ *  j Ķһĵ j 㹻ôֱ */
+static robj *createClientArgObject(redisClient *c, int j, char *ptr, size_t len) {
+    robj *o;
+
+    if (j < REDIS_ARGV_CACHE_SIZE && (o = c->argv_cache[j]) != NULL &&
+        sdsalloc(o->ptr) >= len)
+    {
+        char *s = o->ptr;
+
+        c->argv_cache[j] = NULL;
+        memcpy(s,ptr,len);
+        s[len] = '\0';
+        sdssetlen(s,len);
+        o->lru = LRU_CLOCK();
+        return o;
+    }
+    return createStringObject(ptr,len);
+}
+
 /* Close all the slaves connections. This is useful in chained replication
  * when we resync with our own master and want to force all our slaves to
  * resync with us as well. */
@@ -1019,6 +1146,14 @@ void freeClient(redisClient *c, const char *func, unsigned int line) {
         listDelNode(server.unblocked_clients,ln);
     }
 
+    /* Remove from the list of clients waiting for the AOF fsync. */
+    // ɾȴ AOF fsync Ŀͻ
+    if (c->flags & REDIS_AOF_FSYNC_WAIT) {
+        ln = listSearchKey(server.aof_fsync_clients,c);
+        redisAssert(ln != NULL);
+        listDelNode(server.aof_fsync_clients,ln);
+    }
+
     /* Master/slave cleanup Case 1:
      * we lost the connection with a slave. */
     if (c->flags & REDIS_SLAVE) {
@@ -1050,11 +1185,26 @@ void freeClient(redisClient *c, const char *func, unsigned int line) {
         listDelNode(server.clients_to_close,ln);
     }
 
+    /* Remove the client from the threaded I/O queues. */
+    // ӵȴ I/O ̴߳ɾ
+    if (c->flags & REDIS_PENDING_READ) {
+        ln = listSearchKey(server.clients_pending_read,c);
+        redisAssert(ln != NULL);
+        listDelNode(server.clients_pending_read,ln);
+    }
+    if (c->flags & REDIS_PENDING_WRITE) {
+        ln = listSearchKey(server.clients_pending_write,c);
+        redisAssert(ln != NULL);
+        listDelNode(server.clients_pending_write,ln);
+    }
+    if (c->io_protoerr) sdsfree(c->io_protoerr);
+
     /* Release other dynamically allocated client structure fields,
      * and finally release the client structure itself. */
     if (c->name) decrRefCount(c->name);
     // ռ
     zfree(c->argv);
+    freeClientArgvCache(c);
     // ״̬Ϣ
     freeClientMultiState(c);
     sdsfree(c->peerid);
@@ -1089,80 +1239,37 @@ void freeClientsInAsyncFreeQueue(void) {
     }
 }
 
-/*
- * ظд
- */ //readQueryFromClientsendReplyToClientӦһգһ  //TCPacceptTcpHandler
- //һԷ64Mݹ
-void sendReplyToClient(aeEventLoop *el, int fd, void *privdata, int mask) {
-    redisClient *c = privdata;
-    int nwritten = 0, totwritten = 0, objlen;
-    size_t objmem;
+/* Write as much as possible of the client output buffers to its socket.
+ * The static buffer and the reply list nodes are flushed together with
+ * writev(), so that a client with many queued replies (pipelines, large
+ * multi bulk replies) costs a few system calls instead of one per node.
+ *
+ * Reply list nodes that were completely written are not released here, as
+ * the objects they hold may be shared and their reference count can only
+ * be touched by the main thread: their number is stored in c->io_sentnodes
+ * and clientWriteDone() drops them. This is what allows the function to
+ * run in an I/O thread as well.
+ *
+ * ͻ˵Ļظд׽֡ѾдĻظڵ㲻ɾ
+ * ֻ¼ c->io_sentnodes У߳ clientWriteDone() ɾ
+ * Ҳ I/O ִ߳С
+ */
+static void writeClientSocket(redisClient *c) {
+    struct iovec iov[REDIS_IOV_MAX];
+    listNode *ln = listFirst(c->reply), *next;
+    ssize_t nwritten = 0;
+    size_t totwritten = 0, iovbytes, remaining, left, sentlen;
+    int iovcnt, capped;
     robj *o;
-    REDIS_NOTUSED(el);
-    REDIS_NOTUSED(mask);
+
+    c->io_sentnodes = 0;
+    c->io_sentbuf = 0;
+    c->io_writecalls = 0;
 
     // һֱѭֱظΪ
     // ָΪֹ
-    while(c->bufpos > 0 || listLength(c->reply)) {
-
-        if (c->bufpos > 0) {
-
-            // c->bufpos > 0
-
-            // дݵ׽
-            // c->sentlen  short write 
-            //  short write дδһʱ
-            // c->buf+c->sentlen ͻƫƵȷδд룩ݵλϡ
-            nwritten = write(fd,c->buf+c->sentlen,c->bufpos-c->sentlen);
-            // 
-            if (nwritten <= 0) break;
-            // ɹдд
-            c->sentlen += nwritten;
-            totwritten += nwritten;
-
-            /* If the buffer was sent, set bufpos to zero to continue with
-             * the remainder of the reply. */
-            // еѾȫд
-            // ôտͻ˵
-            if (c->sentlen == c->bufpos) {
-                c->bufpos = 0;
-                c->sentlen = 0;
-            }
-        } else {
+    while(c->bufpos > 0 || ln) {
 
-            // listLength(c->reply) != 0
-
-            // ȡλǰĶ
-            o = listNodeValue(listFirst(c->reply));
-            objlen = sdslen(o->ptr);
-            objmem = getStringObjectSdsUsedMemory(o);
-
-            // Թն
-            if (objlen == 0) {
-                listDelNode(c->reply,listFirst(c->reply));
-                c->reply_bytes -= objmem;
-                continue;
-            }
-
-            // дݵ׽
-            // c->sentlen  short write 
-            //  short write дδһʱ
-            // c->buf+c->sentlen ͻƫƵȷδд룩ݵλϡ
-            nwritten = write(fd, ((char*)o->ptr)+c->sentlen,objlen-c->sentlen);
-            // д
-            if (nwritten <= 0) break;
-            // ɹдд
-            c->sentlen += nwritten;
-            totwritten += nwritten;
-
-            /* If we fully sent the object on head go to the next one */
-            // ȫдϣôɾдϵĽڵ
-            if (c->sentlen == objlen) {
-                listDelNode(c->reply,listFirst(c->reply));
-                c->sentlen = 0;
-                c->reply_bytes -= objmem;
-            }
-        }
         /* Note that we avoid to send more than REDIS_MAX_WRITE_PER_EVENT
          * bytes, in a single threaded server it's a good idea to serve
          * other clients as well, even if a very large request comes from
@@ -1183,24 +1290,124 @@ void sendReplyToClient(aeEventLoop *el, int fd, void *privdata, int mask) {
          * ʱʹд REDIS_MAX_WRITE_PER_EVENT 
          * Ҳд
          */
-        if (totwritten > REDIS_MAX_WRITE_PER_EVENT &&  //д64M
-            (server.maxmemory == 0 ||
-             zmalloc_used_memory() < server.maxmemory)) break;
+        capped = server.maxmemory == 0 ||
+                 zmalloc_used_memory() < server.maxmemory;
+
+        /* Gather the static buffer and as many reply list nodes as
+         * possible in a single writev() call. Like the single write()
+         * calls used before, the last buffer added may take the total
+         * over REDIS_MAX_WRITE_PER_EVENT.
+         *
+         * ̬;ܶĻظڵŵͬһ writev() д롣
+         * c->sentlen  short write ģ
+         * ǵһѾдֽ */
+        iovcnt = 0;
+        iovbytes = 0;
+        sentlen = c->sentlen;
+        if (c->bufpos > 0) {
+            iov[iovcnt].iov_base = c->buf+sentlen;
+            iov[iovcnt].iov_len = c->bufpos-sentlen;
+            iovbytes += iov[iovcnt++].iov_len;
+            sentlen = 0;
+        }
+        for (next = ln; next && iovcnt < REDIS_IOV_MAX;
+             next = listNextNode(next))
+        {
+            if (capped && totwritten+iovbytes > REDIS_MAX_WRITE_PER_EVENT)
+                break;
+            o = listNodeValue(next);
+            // Թն
+            if (sdslen(o->ptr) == 0) continue;
+            iov[iovcnt].iov_base = ((char*)o->ptr)+sentlen;
+            iov[iovcnt].iov_len = sdslen(o->ptr)-sentlen;
+            iovbytes += iov[iovcnt++].iov_len;
+            sentlen = 0;
+        }
+
+        // дݵ׽
+        if (iovcnt > 0) {
+            nwritten = writev(c->fd,iov,iovcnt);
+            c->io_writecalls++;
+            // 
+            if (nwritten <= 0) break;
+            // ɹдд
+            totwritten += nwritten;
+        }
+
+        /* Consume the written bytes: from the static buffer first, then
+         * from the reply list nodes, that are counted in c->io_sentnodes
+         * once fully sent.
+         *
+         * дֽ¾̬ͻظд */
+        remaining = iovcnt > 0 ? (size_t)nwritten : 0;
+        if (c->bufpos > 0) {
+            left = c->bufpos-c->sentlen;
+            if (remaining < left) {
+                c->sentlen += remaining;
+                remaining = 0;
+            } else {
+                // еѾȫд
+                remaining -= left;
+                c->bufpos = 0;
+                c->sentlen = 0;
+                c->io_sentbuf = 1;
+            }
+        }
+        while (c->bufpos == 0 && ln) {
+            o = listNodeValue(ln);
+            left = sdslen(o->ptr)-c->sentlen;
+            if (remaining < left) {
+                c->sentlen += remaining;
+                break;
+            }
+            // ȫдϣôתһڵ
+            remaining -= left;
+            c->sentlen = 0;
+            ln = listNextNode(ln);
+            c->io_sentnodes++;
+        }
+
+        /* A short write means the socket buffer is full: don't try again
+         * just to get EAGAIN. */
+        if (iovcnt > 0 && (size_t)nwritten < iovbytes) break;
+        if (capped && totwritten > REDIS_MAX_WRITE_PER_EVENT) break;
+    }
+
+    c->io_written = totwritten;
+    c->io_errno = (nwritten == -1 && errno != EAGAIN) ? errno : 0;
+}
+
+/* Finish from the main thread a write performed by writeClientSocket().
+ * Returns REDIS_ERR if the client was freed.
+ *
+ * ߳ writeClientSocket() д룺ɾѾдĻظڵ㣬
+ * дԼڻظȫдʱɾд
+ * ͻ˱ͷʱ REDIS_ERR 
+ */
+static int clientWriteDone(redisClient *c) {
+    listNode *ln;
+
+    // дϵͳúдظͳϢ
+    server.stat_reply_syscalls += c->io_writecalls;
+    server.stat_replies_sent += c->io_sentbuf + c->io_sentnodes;
+
+    // ɾѾдϵĽڵ
+    while (c->io_sentnodes > 0) {
+        ln = listFirst(c->reply);
+        c->reply_bytes -= getStringObjectSdsUsedMemory(listNodeValue(ln));
+        listDelNode(c->reply,ln);
+        c->io_sentnodes--;
     }
 
     // д
-    if (nwritten == -1) {
-        if (errno == EAGAIN) {
-            nwritten = 0;
-        } else {
-            redisLog(REDIS_VERBOSE,
-                "Error writing to client: %s", strerror(errno));
-            freeClient(c, NGX_FUNC_LINE);
-            return;
-        }
+    if (c->io_errno) {
+        redisLog(REDIS_VERBOSE,
+            "Error writing to client: %s", strerror(c->io_errno));
+        freeClient(c, NGX_FUNC_LINE);
+        return REDIS_ERR;
     }
 
-    if (totwritten > 0) {
+    if (c->io_written > 0) {
         /* For clients representing masters we don't count sending data
          * as an interaction, since we always send REPLCONF ACK commands
          * that take some time to just fill the socket output buffer.
@@ -1211,12 +1418,31 @@ void sendReplyToClient(aeEventLoop *el, int fd, void *privdata, int mask) {
         c->sentlen = 0;
 
         // ɾ write handler
-        aeDeleteFileEvent(server.el,c->fd,AE_WRITABLE);
+        if (aeGetFileEvents(server.el,c->fd) & AE_WRITABLE)
+            aeDeleteFileEvent(server.el,c->fd,AE_WRITABLE);
 
         /* Close connection after entire reply has been sent. */
         // ָд֮رտͻ FLAG ôرտͻ
-        if (c->flags & REDIS_CLOSE_AFTER_REPLY) freeClient(c, NGX_FUNC_LINE);
+        if (c->flags & REDIS_CLOSE_AFTER_REPLY) {
+            freeClient(c, NGX_FUNC_LINE);
+            return REDIS_ERR;
+        }
     }
+    return REDIS_OK;
+}
+
+/*
+ * ظд
+ */ //readQueryFromClientsendReplyToClientӦһգһ  //TCPacceptTcpHandler
+ //һԷ64Mݹ
+void sendReplyToClient(aeEventLoop *el, int fd, void *privdata, int mask) {
+    redisClient *c = privdata;
+    REDIS_NOTUSED(el);
+    REDIS_NOTUSED(fd);
+    REDIS_NOTUSED(mask);
+
+    writeClientSocket(c);
+    clientWriteDone(c);
 }
 
 /* resetClient prepare the client to process the next command */
@@ -1250,26 +1476,24 @@ void resetClient(redisClient *c) {
  * argv[2] = arg2
  */
 int processInlineBuffer(redisClient *c) {
-    char *newline;
+    char *newline, *start = c->querybuf+c->qb_pos;
     int argc, j;
     sds *argv, aux;
     size_t querylen;
 
     /* Search for end of line */
-    newline = strchr(c->querybuf,'\n');
+    newline = strchr(start,'\n');
 
     /* Nothing to do without a \r\n */
     // յĲѯݲЭʽ
     if (newline == NULL) {
-        if (sdslen(c->querybuf) > REDIS_INLINE_MAX_SIZE) {
-            addReplyError(c,"Protocol error: too big inline request");
-            setProtocolError(c,0);
-        }
+        if (sdslen(c->querybuf)-c->qb_pos > REDIS_INLINE_MAX_SIZE)
+            setProtocolError("Protocol error: too big inline request",c,c->qb_pos);
         return REDIS_ERR;
     }
 
     /* Handle the \r\n case. */
-    if (newline && newline != c->querybuf && *(newline-1) == '\r')
+    if (newline && newline != start && *(newline-1) == '\r')
         newline--;
 
     /* Split the input buffer up to the \r\n */
@@ -1279,13 +1503,12 @@ int processInlineBuffer(redisClient *c) {
     // argv[1] = msg
     // argv[2] = hello
     // argc = 3
-    querylen = newline-(c->querybuf);
-    aux = sdsnewlen(c->querybuf,querylen);
+    querylen = newline-start;
+    aux = sdsnewlen(start,querylen);
     argv = sdssplitargs(aux,&argc);
     sdsfree(aux);
     if (argv == NULL) {
-        addReplyError(c,"Protocol error: unbalanced quotes in request");
-        setProtocolError(c,0);
+        setProtocolError("Protocol error: unbalanced quotes in request",c,c->qb_pos);
         return REDIS_ERR;
     }
 
@@ -1299,14 +1522,17 @@ int processInlineBuffer(redisClient *c) {
 
     /* Leave data after the first line of the query in the buffer */
 
-    // ӻɾ argv Ѷȡ
-    // ʣδȡ
-    sdsrange(c->querybuf,querylen+2,-1);
+    // Ѷȡݣʣδȡ
+    c->qb_pos += querylen+2;
+    if (c->qb_pos > sdslen(c->querybuf)) c->qb_pos = sdslen(c->querybuf);
 
     /* Setup argv array on client structure */
     // Ϊͻ˵Ĳռ
-    if (c->argv) zfree(c->argv);
-    c->argv = zmalloc(sizeof(robj*)*argc);
+    if (c->argv_len < argc) {
+        zfree(c->argv);
+        c->argv = zmalloc(sizeof(robj*)*argc);
+        c->argv_len = argc;
+    }
 
     /* Create redis objects for all arguments. */
     // Ϊÿһַ
@@ -1326,18 +1552,36 @@ int processInlineBuffer(redisClient *c) {
     return REDIS_OK;
 }
 
-/* Helper function. Trims query buffer to make the function that processes
- * multi bulk requests idempotent. */
-// ڶЭʱݲЭ飬ô첽عرͻˡ
-static void setProtocolError(redisClient *c, int pos) {
+/* Log a protocol error of the client at VERBOSE level. */
+static void logProtocolError(redisClient *c) {
     if (server.verbosity >= REDIS_VERBOSE) {
         sds client = catClientInfoString(sdsempty(),c);
         redisLog(REDIS_VERBOSE,
             "Protocol error from client: %s", client);
         sdsfree(client);
     }
-    c->flags |= REDIS_CLOSE_AFTER_REPLY;
+}
+
+/* Helper function. Replies with 'errstr' and trims query buffer to make
+ * the function that processes multi bulk requests idempotent. 'pos' is the
+ * offset in the query buffer where the parsing stopped.
+ *
+ * When the client is being parsed by an I/O thread the error is only
+ * recorded in c->io_protoerr: the reply, the log line and the
+ * REDIS_CLOSE_AFTER_REPLY flag are left to the main thread, see
+ * processClientReadResult(). */
+// ڶЭʱݲЭ飬ô첽عرͻˡ
+//  I/O ߳нʱֻ¼̻߳ظ󲢼¼־
+static void setProtocolError(const char *errstr, redisClient *c, int pos) {
+    if (c->flags & REDIS_PENDING_READ) {
+        c->io_protoerr = sdsnew(errstr);
+    } else {
+        addReplyError(c,(char*)errstr);
+        logProtocolError(c);
+        c->flags |= REDIS_CLOSE_AFTER_REPLY;
+    }
     sdsrange(c->querybuf,pos,-1);
+    c->qb_pos = 0;
 }
 
 /*
@@ -1354,9 +1598,9 @@ static void setProtocolError(redisClient *c, int pos) {
 //RDBļ͸ʽַͨЭʽһ$length\r\n+ʵݣrdbļݷupdateSlavesWaitingBgsave->sendBulkToSlave
 //rdbͬ(ʽ)ݽպΪreadSyncBulkPayload(ʽͬ)սprocessMultibulkBuffer
 int processMultibulkBuffer(redisClient *c) {
-    char *newline = NULL;
-    int pos = 0, ok;
+    size_t pos = c->qb_pos;
     long long ll;
+    int n;
 
     // Ĳ
     //  *3\r\n$3\r\nSET\r\n...  c->multibulklen = 3
@@ -1365,30 +1609,23 @@ int processMultibulkBuffer(redisClient *c) {
         redisAssertWithInfo(c,NULL,c->argc == 0);
 
         /* Multi bulk length cannot be read without a \r\n */
-        // 黺ݵһ "\r\n"
-        newline = strchr(c->querybuf,'\r');
-        if (newline == NULL) {
-            if (sdslen(c->querybuf) > REDIS_INLINE_MAX_SIZE) {
-                addReplyError(c,"Protocol error: too big mbulk count string");
-                setProtocolError(c,0);
-            }
+        // 黺ݵһ "\r\n" 
+        // Ҳ * ֮ \r\n ֮ǰȡ浽 ll 
+        //  *3\r\n ô ll  3
+        n = parseProtocolLength(c->querybuf+pos,sdslen(c->querybuf)-pos,&ll);
+        if (n == 0) {
+            if (sdslen(c->querybuf)-pos > REDIS_INLINE_MAX_SIZE)
+                setProtocolError("Protocol error: too big mbulk count string",c,pos);
             return REDIS_ERR;
         }
-        /* Buffer should also contain \n */
-        if (newline-(c->querybuf) > ((signed)sdslen(c->querybuf)-2))
-            return REDIS_ERR;
 
-        /* We know for sure there is a whole line since newline != NULL,
-         * so go ahead and find out the multi bulk length. */
+        /* We know for sure there is a whole line since n != 0,
+         * so go ahead and check the multi bulk length. */
         // Эĵһַ '*'
-        redisAssertWithInfo(c,NULL,c->querybuf[0] == '*');
-        // Ҳ * ֮ \r\n ֮ǰȡ浽 ll 
-        //  *3\r\n ô ll  3
-        ok = string2ll(c->querybuf+1,newline-(c->querybuf+1),&ll);
+        redisAssertWithInfo(c,NULL,c->querybuf[pos] == '*');
         // 
-        if (!ok || ll > 1024*1024) {
-            addReplyError(c,"Protocol error: invalid multibulk length");
-            setProtocolError(c,pos);
+        if (n == -1 || ll > 1024*1024) {
+            setProtocolError("Protocol error: invalid multibulk length",c,pos);
             return REDIS_ERR;
         }
 
@@ -1398,14 +1635,14 @@ int processMultibulkBuffer(redisClient *c) {
         //                ^
         //                |
         //               pos
-        pos = (newline-c->querybuf)+2;
+        pos += n;
         //  ll <= 0 ôһհ
         // ôݴӲѯɾֻδĶǲ
         // Ϊʲôǿյأ
         // processInputBuffer ע͵ "Multibulk processing could see a <= 0 length"
         // ûϸ˵ԭ
         if (ll <= 0) {
-            sdsrange(c->querybuf,pos,-1);
+            c->qb_pos = pos;
             return REDIS_OK;
         }
 
@@ -1414,8 +1651,12 @@ int processMultibulkBuffer(redisClient *c) {
 
         /* Setup argv array on client structure */
         // ݲΪռ
-        if (c->argv) zfree(c->argv);
-        c->argv = zmalloc(sizeof(robj*)*c->multibulklen);
+        // ֮ãֻڲʱ·
+        if (c->argv_len < c->multibulklen) {
+            zfree(c->argv);
+            c->argv = zmalloc(sizeof(robj*)*c->multibulklen);
+            c->argv_len = c->multibulklen;
+        }
     }
 
     redisAssertWithInfo(c,NULL,c->multibulklen > 0);
@@ -1427,39 +1668,33 @@ int processMultibulkBuffer(redisClient *c) {
         // 
         if (c->bulklen == -1) {
 
-            // ȷ "\r\n" 
-            newline = strchr(c->querybuf+pos,'\r');
-            if (newline == NULL) {
-                if (sdslen(c->querybuf) > REDIS_INLINE_MAX_SIZE) {
-                    addReplyError(c,
-                        "Protocol error: too big bulk count string");
-                    setProtocolError(c,0);
+            // ȷ "\r\n" ڣȡ
+            //  $3\r\nSET\r\n  ll ֵ 3
+            n = parseProtocolLength(c->querybuf+pos,sdslen(c->querybuf)-pos,&ll);
+            if (n == 0) {
+                if (sdslen(c->querybuf)-pos > REDIS_INLINE_MAX_SIZE) {
+                    setProtocolError("Protocol error: too big bulk count string",c,pos);
                     return REDIS_ERR;
                 }
                 break;
             }
-            /* Buffer should also contain \n */
-            if (newline-(c->querybuf) > ((signed)sdslen(c->querybuf)-2))
-                break;
 
             //rdbݽպΪreadSyncBulkPayloadݽսprocessMultibulkBuffer
 
             // ȷЭϲʽе $...
             //  $3\r\nSET\r\n
             if (c->querybuf[pos] != '$') {
-                addReplyErrorFormat(c,
+                char buf[64];
+
+                snprintf(buf,sizeof(buf),
                     "Protocol error: expected '$', got '%c'",
                     c->querybuf[pos]);
-                setProtocolError(c,pos);
+                setProtocolError(buf,c,pos);
                 return REDIS_ERR;
             }
 
-            // ȡ
-            //  $3\r\nSET\r\n  ll ֵ 3
-            ok = string2ll(c->querybuf+pos+1,newline-(c->querybuf+pos+1),&ll);
-            if (!ok || ll < 0 || ll > 512*1024*1024) {//keyvalueַ512M
-                addReplyError(c,"Protocol error: invalid bulk length");
-                setProtocolError(c,pos);
+            if (n == -1 || ll < 0 || ll > 512*1024*1024) {//keyvalueַ512M
+                setProtocolError("Protocol error: invalid bulk length",c,pos);
                 return REDIS_ERR;
             }
 
@@ -1469,7 +1704,7 @@ int processMultibulkBuffer(redisClient *c) {
             //       ^
             //       |
             //      pos
-            pos += newline-(c->querybuf+pos)+2;
+            pos += n;
             // ǳôһЩԤʩŻĲƲ
             if (ll >= REDIS_MBULK_BIG_ARG) { //32K
                 size_t qblen;
@@ -1516,8 +1751,9 @@ int processMultibulkBuffer(redisClient *c) {
                 c->querybuf = sdsMakeRoomFor(c->querybuf,c->bulklen+2);
                 pos = 0;
             } else { //¿ٿռѿͻ˷͹ͨquerybufյ¿¿ٵĿռ䣬´μquerybufտͻ
-                c->argv[c->argc++] =
-                    createStringObject(c->querybuf+pos,c->bulklen); //argv[]ָӦset key valueеkeyvalueַ
+                c->argv[c->argc] = createClientArgObject(c,c->argc,
+                    c->querybuf+pos,c->bulklen); //argv[]ָӦset key valueеkeyvalueַ
+                c->argc++;
                 pos += c->bulklen+2;
             }
 
@@ -1529,10 +1765,11 @@ int processMultibulkBuffer(redisClient *c) {
         }
     }
 
-    /* Trim to pos */
-    //  querybuf ɾѱȡ
-    if (pos) //bufδݿڴͷ´μյݺһǷkeyvalueַ 
-        sdsrange(c->querybuf,pos,-1);
+    /* Skip to pos: processInputBuffer() trims the query buffer once all
+     * the pipelined commands it contains are processed. */
+    // ѱȡݣ processInputBuffer ڴһɾ
+    // ÿδݿڴͷ
+    c->qb_pos = pos;
 
     /* We're done when c->multibulk == 0 */
     // вѶȡ꣬ô
@@ -1552,21 +1789,23 @@ void processInputBuffer(redisClient *c) {
     // ȡ short read ôܻڶȡ
     // ЩҲһЭ
     // Ҫȴ´ζ¼ľ
-    while(sdslen(c->querybuf)) {
+    while(c->qb_pos < sdslen(c->querybuf) ||
+          (c->flags & REDIS_PENDING_COMMAND))
+    {
 
         /* Return if clients are paused. */
         // ͻͣ״̬ôֱӷ
-        if (!(c->flags & REDIS_SLAVE) && clientsArePaused()) return;//ڽcluster failoverֶתƣprocessInputBuffer->clientsArePausedͣͻ
+        if (!(c->flags & REDIS_SLAVE) && clientsArePaused()) break;//ڽcluster failoverֶתƣprocessInputBuffer->clientsArePausedͣͻ
 
         /* Immediately abort if the client is in the middle of something. */
         // REDIS_BLOCKED ״̬ʾͻڱ
-        if (c->flags & REDIS_BLOCKED) return;
+        if (c->flags & REDIS_BLOCKED) break;
 
         /* REDIS_CLOSE_AFTER_REPLY closes the connection once the reply is
          * written to the client. Make sure to not let the reply grow after
          * this flag has been set (i.e. don't process more commands). */
         // ͻѾ˹ر FLAG ûбҪ
-        if (c->flags & REDIS_CLOSE_AFTER_REPLY) return;
+        if (c->flags & REDIS_CLOSE_AFTER_REPLY) break;
 
         /* Determine request type when unknown. */
         // ж
@@ -1589,23 +1828,29 @@ ab
 һҲ*ʼ൱argc ʾм$ֱʾַмֽڡget a abһ3ֱget ,a,b 
 $3ʾget3ֽڡ
 */
-        if (!c->reqtype) {
-            if (c->querybuf[0] == '*') {
-                // ѯ
-                c->reqtype = REDIS_REQ_MULTIBULK;
-            } else {
-                // ѯ
-                c->reqtype = REDIS_REQ_INLINE;
+        if (c->flags & REDIS_PENDING_COMMAND) {
+            /* The command was already parsed by an I/O thread. */
+            // Ѿ I/O ߳̽ϣֱִ
+            c->flags &= ~REDIS_PENDING_COMMAND;
+        } else {
+            if (!c->reqtype) {
+                if (c->querybuf[c->qb_pos] == '*') {
+                    // ѯ
+                    c->reqtype = REDIS_REQ_MULTIBULK;
+                } else {
+                    // ѯ
+                    c->reqtype = REDIS_REQ_INLINE;
+                }
             }
-        }
 
-        // еתԼ
-        if (c->reqtype == REDIS_REQ_INLINE) {
-            if (processInlineBuffer(c) != REDIS_OK) break;
-        } else if (c->reqtype == REDIS_REQ_MULTIBULK) {
-            if (processMultibulkBuffer(c) != REDIS_OK) break;
-        } else {
-            redisPanic("Unknown request type");
+            // еתԼ
+            if (c->reqtype == REDIS_REQ_INLINE) {
+                if (processInlineBuffer(c) != REDIS_OK) break;
+            } else if (c->reqtype == REDIS_REQ_MULTIBULK) {
+                if (processMultibulkBuffer(c) != REDIS_OK) break;
+            } else {
+                redisPanic("Unknown request type");
+            }
         }
 
         /* Multibulk processing could see a <= 0 length. */
@@ -1618,6 +1863,13 @@ $3
                 resetClient(c);
         }
     }
+
+    /* Trim the commands parsed so far from the query buffer at once. */
+    // һɾѯѱ
+    if (c->qb_pos) {
+        sdsrange(c->querybuf,c->qb_pos,-1);
+        c->qb_pos = 0;
+    }
 }
 
 /* 
@@ -1627,91 +1879,16 @@ $3
 void readQueryFromClient(aeEventLoop *el, int fd, void *privdata, int mask) {
 // ȫͬɺ󣬱һclientʵʱKV,ͨreadQueryFromClientʵʱKV
     redisClient *c = (redisClient*) privdata;
-    int nread, readlen;
-    size_t qblen;
     REDIS_NOTUSED(el);
+    REDIS_NOTUSED(fd);
     REDIS_NOTUSED(mask);
 
-    // ÷ĵǰͻ
-    server.current_client = c;
-    
-    // 볤ȣĬΪ 16 MB
-    readlen = REDIS_IOBUF_LEN;
+    //  I/O ߳ʱȡͽƳٵ beforeSleep()  I/O ߳̽
+    if (postponeClientRead(c)) return;
 
-    /* If this is a multi bulk request, and we are processing a bulk reply
-     * that is large enough, try to maximize the probability that the query
-     * buffer contains exactly the SDS string representing the object, even
-     * at the risk of requiring more read(2) calls. This way the function
-     * processMultiBulkBuffer() can avoid copying buffers to create the
-     * Redis Object representing the argument. */
-    if (c->reqtype == REDIS_REQ_MULTIBULK && c->multibulklen && c->bulklen != -1
-        && c->bulklen >= REDIS_MBULK_BIG_ARG)
-    {
-        int remaining = (unsigned)(c->bulklen+2)-sdslen(c->querybuf);
-
-        if (remaining < readlen) readlen = remaining;
-    }
-
-    // ȡѯǰݵĳ
-    // ȡ short read ôܻڶȡ
-    // ЩҲһЭ
-    qblen = sdslen(c->querybuf);
-    // Ҫ»ݳȵķֵpeak
-    if (c->querybuf_peak < qblen) 
-        c->querybuf_peak = qblen;
-    // Ϊѯռ
-    c->querybuf = sdsMakeRoomFor(c->querybuf, readlen);
-    // ݵѯ
-    nread = read(fd, c->querybuf+qblen, readlen);
-
-    // 
-    if (nread == -1) {
-        if (errno == EAGAIN) {
-            nread = 0;
-        } else {
-            redisLog(REDIS_VERBOSE, "Reading from client: %s",strerror(errno));
-            freeClient(c, NGX_FUNC_LINE);
-            return;
-        }
-    //  EOF
-    } else if (nread == 0) {
-        redisLog(REDIS_VERBOSE, "Client closed connection");
-        freeClient(c, NGX_FUNC_LINE);
-        return;
-    }
-
-    if (nread) {
-        // ݣ²ѯSDS free  len 
-        //  '\0' ȷطŵݵ
-        sdsIncrLen(c->querybuf,nread);
-        // ¼Ϳͻһλʱ
-        c->lastinteraction = server.unixtime;
-        // ͻ master ĻĸƫҲǶԷmasterʵΪslave
-        if (c->flags & REDIS_MASTER) c->reploff += nread;
-    } else {
-        //  nread == -1  errno == EAGAIN ʱ
-        server.current_client = NULL;
-        return;
-    }
-
-    // ѯȳ󻺳
-    // ջͷſͻ
-    if (sdslen(c->querybuf) > server.client_max_querybuf_len) {
-        sds ci = catClientInfoString(sdsempty(),c), bytes = sdsempty();
-
-        bytes = sdscatrepr(bytes,c->querybuf,64);
-        redisLog(REDIS_WARNING,"Closing client that reached max query buffer length: %s (qbuf initial bytes: %s)", ci, bytes);
-        sdsfree(ci);
-        sdsfree(bytes);
-        freeClient(c, NGX_FUNC_LINE);
-        return;
-    }
-
-    // Ӳѯضȡݣִ
-    // ִееݶΪֹ
-    processInputBuffer(c);
-
-    server.current_client = NULL;
+    // ݵѯ棬Ȼִе
+    readClientSocket(c);
+    processClientReadResult(c);
 }
 
 // ȡͻĿǰһ黺ĴС
@@ -1830,7 +2007,7 @@ sds catClientInfoString(sds s, redisClient *client) {
         (int) dictSize(client->pubsub_channels),
         (int) listLength(client->pubsub_patterns),
         (client->flags & REDIS_MULTI) ? client->mstate.count : -1,
-        (unsigned long long) sdslen(client->querybuf),
+        (unsigned long long) (sdslen(client->querybuf)-client->qb_pos),
         (unsigned long long) sdsavail(client->querybuf),
         (unsigned long long) client->bufpos,
         (unsigned long long) listLength(client->reply),
@@ -1973,6 +2150,7 @@ void rewriteClientCommandVector(redisClient *c, int argc, ...) {
     // ²滻
     c->argv = argv;
     c->argc = argc;
+    c->argv_len = argc;
     c->cmd = lookupCommandOrOriginal(c->argv[0]->ptr);
     redisAssertWithInfo(c,NULL,c->cmd != NULL);
     va_end(ap);
@@ -2268,13 +2446,375 @@ int clientsArePaused(void) {//
  *
  * The function returns the total number of events processed. */
 // ÷ڱ£ȻĳЩ¼
+static int processing_events_while_blocked = 0;
+
 int processEventsWhileBlocked(void) {
     int iterations = 4; /* See the function top-comment. */
     int count = 0;
+
+    /* beforeSleep() is not called here: reads are not deferred to the
+     * I/O threads meanwhile, and queued replies are written explicitly. */
+    processing_events_while_blocked = 1;
     while (iterations--) {
         int events = aeProcessEvents(server.el, AE_FILE_EVENTS|AE_DONT_WAIT); //ֻFILE¼ᴦTIMEʱ
+        events += handleClientsWithPendingWritesUsingThreads();
         if (!events) break;
         count += events;
     }
+    processing_events_while_blocked = 0;
     return count;
 }
+
+/* ==================== Threaded I/O ==================== */
+
+/* When io-threads is greater than 1 the read(2)/write(2) calls of normal
+ * clients, and the parsing of the first command in the query buffer, are
+ * performed by a pool of I/O threads, while commands are still executed
+ * by the main thread only.
+ *
+ * The read and writable handlers just queue the clients (see
+ * postponeClientRead() and prepareClientToWrite()). From beforeSleep() the
+ * main thread splits the queued clients among itself and the I/O threads,
+ * does its own share, and waits for the threads to finish: no client is
+ * ever accessed by two threads at the same time. Then, back in the main
+ * thread, the parsed commands are executed and the replies written by the
+ * threads are released.
+ *
+ *  io-threads ͨͻ˵ read(2)/write(2) Լ׸Ľ
+ *  I/O ߳ɣȻִֻ߳С
+ * ߳ beforeSleep() нȴĿͻ˷Լ͸ I/O ̣߳
+ * ԼĲֺȴ߳̽ͬһʱֻһ̷߳ĳͻˡ
+ */
+
+#define REDIS_IO_THREADS_OP_READ 0
+#define REDIS_IO_THREADS_OP_WRITE 1
+
+// I/O ̣߳Լÿ̵߳Ŀͻ0 ̴߳
+static pthread_t io_threads[REDIS_IO_THREADS_MAX];
+static list *io_threads_list[REDIS_IO_THREADS_MAX];
+// ״̬Լ̵߳Ŀͻ
+static pthread_mutex_t io_threads_mutex = PTHREAD_MUTEX_INITIALIZER;
+// ʱ I/O ߳
+static pthread_cond_t io_threads_cond = PTHREAD_COND_INITIALIZER;
+//  I/O ̶߳ʱ߳
+static pthread_cond_t io_threads_done_cond = PTHREAD_COND_INITIALIZER;
+// ǰͣԼû߳
+static int io_threads_op;
+static int io_threads_pending;
+
+/* Read from the client socket into the query buffer. The result is stored
+ * in c->io_nread and c->io_errno, so that this can run in an I/O thread. */
+// ݵѯ c->io_nread  c->io_errno 
+static void readClientSocket(redisClient *c) {
+    int nread, readlen;
+    size_t qblen;
+
+    // 볤ȣĬΪ 16 KB
+    readlen = REDIS_IOBUF_LEN;
+
+    /* If this is a multi bulk request, and we are processing a bulk reply
+     * that is large enough, try to maximize the probability that the query
+     * buffer contains exactly the SDS string representing the object, even
+     * at the risk of requiring more read(2) calls. This way the function
+     * processMultiBulkBuffer() can avoid copying buffers to create the
+     * Redis Object representing the argument. */
+    if (c->reqtype == REDIS_REQ_MULTIBULK && c->multibulklen && c->bulklen != -1
+        && c->bulklen >= REDIS_MBULK_BIG_ARG)
+    {
+        int remaining = (unsigned)(c->bulklen+2)-sdslen(c->querybuf);
+
+        if (remaining < readlen) readlen = remaining;
+    }
+
+    // ȡѯǰݵĳ
+    // ȡ short read ôܻڶȡ
+    // ЩҲһЭ
+    qblen = sdslen(c->querybuf);
+    // Ҫ»ݳȵķֵpeak
+    if (c->querybuf_peak < qblen)
+        c->querybuf_peak = qblen;
+    // Ϊѯռ
+    c->querybuf = sdsMakeRoomFor(c->querybuf, readlen);
+    // ݵѯ
+    nread = read(c->fd, c->querybuf+qblen, readlen);
+
+    // ݣ²ѯSDS free  len 
+    //  '\0' ȷطŵݵ
+    if (nread > 0) sdsIncrLen(c->querybuf,nread);
+    c->io_nread = nread;
+    c->io_errno = (nread == -1) ? errno : 0;
+}
+
+/* Parse the first command of the query buffer from an I/O thread, so that
+ * the main thread only has to execute it. */
+//  I/O ߳нѯеĵһ
+static void parseClientCommand(redisClient *c) {
+    int ok;
+
+    if (!c->reqtype)
+        c->reqtype = (c->querybuf[c->qb_pos] == '*') ? REDIS_REQ_MULTIBULK :
+                                                       REDIS_REQ_INLINE;
+    if (c->reqtype == REDIS_REQ_INLINE)
+        ok = processInlineBuffer(c);
+    else
+        ok = processMultibulkBuffer(c);
+    if (c->qb_pos) {
+        sdsrange(c->querybuf,c->qb_pos,-1);
+        c->qb_pos = 0;
+    }
+    if (ok != REDIS_OK) return;
+
+    /* Multibulk processing could see a <= 0 length. */
+    if (c->argc == 0)
+        resetClient(c);
+    else
+        c->flags |= REDIS_PENDING_COMMAND;
+}
+
+/* Called by the I/O threads (and by the main thread for its own share). */
+static void processIOThreadList(list *clients, int op) {
+    listIter li;
+    listNode *ln;
+
+    listRewind(clients,&li);
+    while((ln = listNext(&li))) {
+        redisClient *c = listNodeValue(ln);
+
+        if (op == REDIS_IO_THREADS_OP_WRITE) {
+            writeClientSocket(c);
+        } else {
+            readClientSocket(c);
+            /* Clients that can't run commands right now are parsed later
+             * by processInputBuffer(), from the main thread. */
+            if (c->io_nread > 0 &&
+                !(c->flags & (REDIS_BLOCKED|REDIS_CLOSE_AFTER_REPLY|
+                              REDIS_PENDING_COMMAND)))
+                parseClientCommand(c);
+        }
+    }
+}
+
+/* Empty a client list without touching the clients. */
+static void emptyIOThreadList(list *clients) {
+    while (listLength(clients)) listDelNode(clients,listFirst(clients));
+}
+
+// I/O ߳
+static void *IOThreadMain(void *arg) {
+    long id = (long) arg;
+    sigset_t sigset;
+
+    /* Block SIGALRM so we are sure that only the main thread will
+     * receive the watchdog signal. */
+    sigemptyset(&sigset);
+    sigaddset(&sigset, SIGALRM);
+    if (pthread_sigmask(SIG_BLOCK, &sigset, NULL))
+        redisLog(REDIS_WARNING,
+            "Warning: can't mask SIGALRM in I/O thread: %s", strerror(errno));
+
+    pthread_mutex_lock(&io_threads_mutex);
+    while(1) {
+        /* The loop always starts with the lock hold. */
+        if (listLength(io_threads_list[id]) == 0) {
+            pthread_cond_wait(&io_threads_cond,&io_threads_mutex);
+            continue;
+        }
+        pthread_mutex_unlock(&io_threads_mutex);
+
+        processIOThreadList(io_threads_list[id],io_threads_op);
+
+        pthread_mutex_lock(&io_threads_mutex);
+        emptyIOThreadList(io_threads_list[id]);
+        if (--io_threads_pending == 0)
+            pthread_cond_signal(&io_threads_done_cond);
+    }
+    return NULL;
+}
+
+/* Spawn the I/O threads if io-threads is greater than 1. */
+//  io-threads ô I/O ߳
+void initThreadedIO(void) {
+    pthread_t thread;
+    long j;
+
+    io_threads_list[0] = listCreate();
+    if (server.io_threads_num == 1) return;
+
+    for (j = 1; j < server.io_threads_num; j++) {
+        io_threads_list[j] = listCreate();
+        if (pthread_create(&thread,NULL,IOThreadMain,(void*)j) != 0) {
+            redisLog(REDIS_WARNING,"Fatal: Can't initialize I/O threads.");
+            exit(1);
+        }
+        io_threads[j] = thread;
+    }
+    redisLog(REDIS_NOTICE,"Threaded I/O enabled: %d I/O threads.",
+        server.io_threads_num);
+}
+
+/* Perform 'op' for every client of the list, splitting the work among the
+ * main thread and the I/O threads. Returns when all the work is done. */
+// еĿͻ˷̺߳͸ I/O ̴߳ȫɺ󷵻
+static void runIOThreads(list *clients, int op) {
+    int active = server.io_threads_num, j = 0;
+    listIter li;
+    listNode *ln;
+
+    /* Waking up the threads is not worth it with just a few clients. */
+    // ͻ̫ʱ̶߳Դ
+    if (listLength(clients) < (unsigned long)active*2) active = 1;
+
+    if (active > 1) pthread_mutex_lock(&io_threads_mutex);
+    listRewind(clients,&li);
+    while((ln = listNext(&li))) {
+        listAddNodeTail(io_threads_list[j % active],listNodeValue(ln));
+        j++;
+    }
+    if (active > 1) {
+        io_threads_op = op;
+        io_threads_pending = active-1;
+        pthread_cond_broadcast(&io_threads_cond);
+        pthread_mutex_unlock(&io_threads_mutex);
+    }
+
+    // ̴߳ԼĲ
+    processIOThreadList(io_threads_list[0],op);
+    emptyIOThreadList(io_threads_list[0]);
+
+    // ȴ I/O ߳
+    if (active > 1) {
+        pthread_mutex_lock(&io_threads_mutex);
+        while (io_threads_pending)
+            pthread_cond_wait(&io_threads_done_cond,&io_threads_mutex);
+        pthread_mutex_unlock(&io_threads_mutex);
+    }
+}
+
+/* Defer the read of the client to beforeSleep() if threaded I/O is in use.
+ * Returns 1 if the read was deferred (or was already pending). */
+//  I/O ߳ʱͻ˵ĶȡƳٵ beforeSleep() н
+static int postponeClientRead(redisClient *c) {
+    if (c->flags & REDIS_PENDING_READ) return 1;
+    if (server.io_threads_num == 1 || processing_events_while_blocked)
+        return 0;
+    if (c->flags & (REDIS_MASTER|REDIS_SLAVE)) return 0;
+
+    /* Append, so that commands from different clients are executed in
+     * the order their read events fired, as without threaded I/O. */
+    c->flags |= REDIS_PENDING_READ;
+    listAddNodeTail(server.clients_pending_read,c);
+    return 1;
+}
+
+/* Handle from the main thread the result of readClientSocket(), and
+ * execute the commands in the query buffer. */
+// ߳д readClientSocket() Ľִвѯе
+static void processClientReadResult(redisClient *c) {
+    // ÷ĵǰͻ
+    server.current_client = c;
+
+    // 
+    if (c->io_nread == -1) {
+        if (c->io_errno != EAGAIN) {
+            redisLog(REDIS_VERBOSE, "Reading from client: %s",
+                strerror(c->io_errno));
+            freeClient(c, NGX_FUNC_LINE);
+            return;
+        }
+        //  nread == -1  errno == EAGAIN ʱ
+        server.current_client = NULL;
+        return;
+    //  EOF
+    } else if (c->io_nread == 0) {
+        redisLog(REDIS_VERBOSE, "Client closed connection");
+        freeClient(c, NGX_FUNC_LINE);
+        return;
+    }
+
+    // ¼Ϳͻһλʱ
+    c->lastinteraction = server.unixtime;
+    // ͻ master ĻĸƫҲǶԷmasterʵΪslave
+    if (c->flags & REDIS_MASTER) c->reploff += c->io_nread;
+
+    // ѯȳ󻺳
+    // ջͷſͻ
+    if (sdslen(c->querybuf) > server.client_max_querybuf_len) {
+        sds ci = catClientInfoString(sdsempty(),c), bytes = sdsempty();
+
+        bytes = sdscatrepr(bytes,c->querybuf,64);
+        redisLog(REDIS_WARNING,"Closing client that reached max query buffer length: %s (qbuf initial bytes: %s)", ci, bytes);
+        sdsfree(ci);
+        sdsfree(bytes);
+        freeClient(c, NGX_FUNC_LINE);
+        return;
+    }
+
+    // I/O ߳ڽʱЭ󣺻ظ󣬲ڻظ֮رտͻ
+    if (c->io_protoerr) {
+        addReplyErrorLength(c,c->io_protoerr,sdslen(c->io_protoerr));
+        sdsfree(c->io_protoerr);
+        c->io_protoerr = NULL;
+        logProtocolError(c);
+        c->flags |= REDIS_CLOSE_AFTER_REPLY;
+    }
+
+    // Ӳѯضȡݣִ
+    // ִееݶΪֹ
+    processInputBuffer(c);
+
+    server.current_client = NULL;
+}
+
+/* Read and parse with the I/O threads the clients queued by
+ * postponeClientRead(), then execute their commands. Called by
+ * beforeSleep(), returns the number of clients processed. */
+int handleClientsWithPendingReadsUsingThreads(void) {
+    int processed = listLength(server.clients_pending_read);
+
+    if (processed == 0) return 0;
+    runIOThreads(server.clients_pending_read,REDIS_IO_THREADS_OP_READ);
+    server.stat_io_reads_processed += processed;
+
+    /* Executing a command may free other clients of the list, so always
+     * pop the head. */
+    while (listLength(server.clients_pending_read)) {
+        listNode *ln = listFirst(server.clients_pending_read);
+        redisClient *c = listNodeValue(ln);
+
+        listDelNode(server.clients_pending_read,ln);
+        c->flags &= ~REDIS_PENDING_READ;
+        processClientReadResult(c);
+    }
+    return processed;
+}
+
+/* Write with the I/O threads the replies of the clients queued by
+ * prepareClientToWrite(). The write handler is installed only for the
+ * clients whose reply could not be written entirely. Called by
+ * beforeSleep(), returns the number of clients processed. */
+int handleClientsWithPendingWritesUsingThreads(void) {
+    int processed = listLength(server.clients_pending_write);
+
+    if (processed == 0) return 0;
+    runIOThreads(server.clients_pending_write,REDIS_IO_THREADS_OP_WRITE);
+    server.stat_io_writes_processed += processed;
+
+    while (listLength(server.clients_pending_write)) {
+        listNode *ln = listFirst(server.clients_pending_write);
+        redisClient *c = listNodeValue(ln);
+
+        listDelNode(server.clients_pending_write,ln);
+        c->flags &= ~REDIS_PENDING_WRITE;
+        if (clientWriteDone(c) == REDIS_ERR) continue;
+
+        // ظûȫд꣬װд sendReplyToClient д
+        if ((c->bufpos || listLength(c->reply)) &&
+            !(aeGetFileEvents(server.el,c->fd) & AE_WRITABLE) &&
+            aeCreateFileEvent(server.el,c->fd,AE_WRITABLE,
+                              sendReplyToClient,c) == AE_ERR)
+        {
+            freeClientAsync(c);
+        }
+    }
+    return processed;
+}
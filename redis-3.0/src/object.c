@@ -64,8 +64,8 @@ robj *createRawStringObject(char *ptr, size_t len) {
 // ַе sds ַ redisObject ṹһ
 // ַҲǲ޸ĵ
 robj *createEmbeddedStringObject(char *ptr, size_t len) {
-    robj *o = zmalloc(sizeof(robj)+sizeof(struct sdshdr)+len+1);
-    struct sdshdr *sh = (void*)(o+1);
+    robj *o = zmalloc(sizeof(robj)+sizeof(struct sdshdr8)+len+1);
+    struct sdshdr8 *sh = (void*)(o+1);
 
     o->type = REDIS_STRING;
     o->encoding = REDIS_ENCODING_EMBSTR;
@@ -73,8 +73,10 @@ robj *createEmbeddedStringObject(char *ptr, size_t len) {
     o->refcount = 1;
     o->lru = LRU_CLOCK();
 
+    // Ƕַ REDIS_ENCODING_EMBSTR_SIZE_LIMIT ʹ sdshdr8
     sh->len = len;
-    sh->free = 0;
+    sh->alloc = len;
+    sh->flags = SDS_TYPE_8;
     if (ptr) {
         memcpy(sh->buf,ptr,len);
         sh->buf[len] = '\0';
@@ -88,12 +90,14 @@ robj *createEmbeddedStringObject(char *ptr, size_t len) {
  * REIDS_ENCODING_EMBSTR_SIZE_LIMIT, otherwise the RAW encoding is
  * used.
  *
- * The current limit of 39 is chosen so that the biggest string object
- * we allocate as EMBSTR will still fit into the 64 byte arena of jemalloc. */
-#define REDIS_ENCODING_EMBSTR_SIZE_LIMIT 39
+ * The current limit of 44 is chosen so that the biggest string object
+ * we allocate as EMBSTR will still fit into the 64 byte arena of jemalloc:
+ * 16 bytes of robj, 3 bytes of sdshdr8, 44 bytes of string and the null
+ * term. */
+#define REDIS_ENCODING_EMBSTR_SIZE_LIMIT 44
 robj *createStringObject(char *ptr, size_t len) {
-    /* ַʽֽٵʱֱһԷzmalloc(sizeof(robj)+sizeof(struct sdshdr)+len+1) 
-        39ֱsizeof(robj)sizeof(struct sdshdr)+lenռ */
+    /* ַʽֽٵʱֱһԷzmalloc(sizeof(robj)+sizeof(struct sdshdr8)+len+1) 
+        44ֱsizeof(robj)sdsͷ+lenռ */
     if (len <= REDIS_ENCODING_EMBSTR_SIZE_LIMIT)
         return createEmbeddedStringObject(ptr,len);
     else
@@ -214,36 +218,35 @@ robj *dupStringObject(robj *o) {
 }
 
 /*
- * һ LINKEDLIST б
+ * һ QUICKLIST б
  */
-robj *createListObject(void) {
+robj *createQuicklistObject(void) {
 
-    list *l = listCreate();
+    quicklist *l = quicklistNew(server.list_max_ziplist_size,
+                                server.list_compress_depth);
 
     robj *o = createObject(REDIS_LIST,l);
 
-    listSetFreeMethod(l,decrRefCountVoid);
-
-    o->encoding = REDIS_ENCODING_LINKEDLIST;
+    o->encoding = REDIS_ENCODING_QUICKLIST;
 
     return o;
 }
 
 /*
- * һ ZIPLIST б
+ * һ LISTPACK б
  */
 
 /*
-lpushͨpushGenericCommand->createZiplistObjectб(Ĭϱ뷽ʽREDIS_ENCODING_ZIPLIST)ȻlistTypePush->listTypeTryConversion
-бнڵǷòlist_max_ziplist_value(Ĭ64)valueбֵѹΪ˫뷽ʽREDIS_ENCODING_LINKEDLISTlistTypePush->listTypeConvert
+lpushͨpushGenericCommand->createListpackObjectб(Ĭϱ뷽ʽREDIS_ENCODING_LISTPACK)ȻlistTypePush->listTypeTryConversion
+бнڵǷòlist_max_ziplist_value(Ĭ64)б listpack Ϊ뷽ʽREDIS_ENCODING_QUICKLISTlistTypePush->listTypeConvert
 */
-robj *createZiplistObject(void) {
+robj *createListpackObject(void) {
 
-    unsigned char *zl = ziplistNew();
+    unsigned char *zl = lpNew();
 
     robj *o = createObject(REDIS_LIST,zl);
 
-    o->encoding = REDIS_ENCODING_ZIPLIST;
+    o->encoding = REDIS_ENCODING_LISTPACK;
 
     return o;
 }
@@ -281,17 +284,18 @@ robj *createIntsetObject(void) {
  */
 robj *createHashObject(void) {
 
-    unsigned char *zl = ziplistNew();
+    unsigned char *zl = lpNew();
 
     robj *o = createObject(REDIS_HASH, zl);
 
-    o->encoding = REDIS_ENCODING_ZIPLIST;
+    o->encoding = REDIS_ENCODING_LISTPACK;
 
     return o;
 }
 
 /*
- * һ SKIPLIST 򼯺
+ * һ SKIPLIST 򼯺ϣ
+ *  zset-btree ѡʱ BTREE 򼯺
  */
 robj *createZsetObject(void) {
 
@@ -300,11 +304,17 @@ robj *createZsetObject(void) {
     robj *o;
 
     zs->dict = dictCreate(&zsetDictType,NULL);
-    zs->zsl = zslCreate();
+    if (server.zset_btree) {
+        zs->zsl = NULL;
+        zs->zbt = zbtCreate();
+    } else {
+        zs->zsl = zslCreate();
+        zs->zbt = NULL;
+    }
 
     o = createObject(REDIS_ZSET,zs);
 
-    o->encoding = REDIS_ENCODING_SKIPLIST;
+    o->encoding = zsetLargeEncoding();
 
     return o;
 }
@@ -312,13 +322,13 @@ robj *createZsetObject(void) {
 /*
  * һ ZIPLIST 򼯺
  */
-robj *createZsetZiplistObject(void) {
+robj *createZsetListpackObject(void) {
 
-    unsigned char *zl = ziplistNew();
+    unsigned char *zl = lpNew();
 
     robj *o = createObject(REDIS_ZSET,zl);
 
-    o->encoding = REDIS_ENCODING_ZIPLIST;
+    o->encoding = REDIS_ENCODING_LISTPACK;
 
     return o;
 }
@@ -339,11 +349,11 @@ void freeListObject(robj *o) {
 
     switch (o->encoding) {
 
-    case REDIS_ENCODING_LINKEDLIST:
-        listRelease((list*) o->ptr);
+    case REDIS_ENCODING_QUICKLIST:
+        quicklistRelease(o->ptr);
         break;
 
-    case REDIS_ENCODING_ZIPLIST:
+    case REDIS_ENCODING_LISTPACK:
         zfree(o->ptr);
         break;
 
@@ -388,7 +398,14 @@ void freeZsetObject(robj *o) {
         zfree(zs);
         break;
 
-    case REDIS_ENCODING_ZIPLIST:
+    case REDIS_ENCODING_BTREE:
+        zs = o->ptr;
+        dictRelease(zs->dict);
+        zbtFree(zs->zbt);
+        zfree(zs);
+        break;
+
+    case REDIS_ENCODING_LISTPACK:
         zfree(o->ptr);
         break;
 
@@ -408,7 +425,7 @@ void freeHashObject(robj *o) {
         dictRelease((dict*) o->ptr);
         break;
 
-    case REDIS_ENCODING_ZIPLIST:
+    case REDIS_ENCODING_LISTPACK:
         zfree(o->ptr);
         break;
 
@@ -418,11 +435,28 @@ void freeHashObject(robj *o) {
     }
 }
 
+/* Turn 'o' into an object that is never released: its reference count is
+ * pinned to REDIS_SHARED_REFCOUNT and incrRefCount() / decrRefCount() don't
+ * touch it anymore. This way objects shared by the whole server, like
+ * shared.integers, can be used by threads other than the main one (see the
+ * threaded RDB loading in rdb.c) without racing on the counter.
+ *
+ *  o ΪԶᱻͷŵĹ
+ * ü̶Ϊ REDIS_SHARED_REFCOUNT 
+ * incrRefCount()  decrRefCount() ޸
+ * ̣߳߳ rdb.c ж߳ RDB ̣߳
+ * Ҳʹ shared.integers ๲󣬶 */
+robj *makeObjectShared(robj *o) {
+    redisAssert(o->refcount == 1);
+    o->refcount = REDIS_SHARED_REFCOUNT;
+    return o;
+}
+
 /*
  * Ϊüһ
  */
 void incrRefCount(robj *o) {
-    o->refcount++;
+    if (o->refcount != REDIS_SHARED_REFCOUNT) o->refcount++;
 }
 
 /*
@@ -432,6 +466,7 @@ void incrRefCount(robj *o) {
  */
 void decrRefCount(robj *o) {
 
+    if (o->refcount == REDIS_SHARED_REFCOUNT) return;
     if (o->refcount <= 0) redisPanic("decrRefCount against refcount <= 0");
 
     // ͷŶ
@@ -584,7 +619,7 @@ robj *tryObjectEncoding(robj *o) {
      * in the same chunk of memory to save space and cache misses. */
     // Խ RAW ַΪ EMBSTR 
     if (len <= REDIS_ENCODING_EMBSTR_SIZE_LIMIT) { 
-    //ַС39֮ǰREDIS_ENCODING_EMBSTR(obj+sdshdr+data)ڴģתΪREDIS_ENCODING_EMBSTRڴ뷽ʽ
+    //ַ44֮ǰREDIS_ENCODING_EMBSTR(obj+sdshdr+data)ڴģתΪREDIS_ENCODING_EMBSTRڴ뷽ʽ
         robj *emb;
 
         if (o->encoding == REDIS_ENCODING_EMBSTR) return o;
@@ -1002,10 +1037,11 @@ char *strEncoding(int encoding) {
     case REDIS_ENCODING_RAW: return "raw";
     case REDIS_ENCODING_INT: return "int";
     case REDIS_ENCODING_HT: return "hashtable";
-    case REDIS_ENCODING_LINKEDLIST: return "linkedlist";
-    case REDIS_ENCODING_ZIPLIST: return "ziplist";
+    case REDIS_ENCODING_LISTPACK: return "listpack";
+    case REDIS_ENCODING_QUICKLIST: return "quicklist";
     case REDIS_ENCODING_INTSET: return "intset";
     case REDIS_ENCODING_SKIPLIST: return "skiplist";
+    case REDIS_ENCODING_BTREE: return "btree";
     case REDIS_ENCODING_EMBSTR: return "embstr";
     default: return "unknown";
     }
@@ -1066,10 +1102,10 @@ OBJECT 
 
 Զַʽ룺
 ?ַԱΪ raw (һַ) int (Ϊ˽Լڴ棬Redis Ὣַʾ 64 λзΪд棩
-?бԱΪ ziplist  linkedlist  ziplist ΪԼССбռʾ
+?бԱΪ listpack  linkedlist  listpack ΪԼССбռʾ
 ?ϿԱΪ intset  hashtable  intset ֵֻСϵʾ
 ?ϣԱΪ zipmap  hashtable  zipmap Сϣʾ
-?򼯺ϿԱΪ ziplist  skiplist ʽ ziplist ڱʾС򼯺ϣ skiplist ڱʾκδС򼯺ϡ
+?򼯺ϿԱΪ listpack  skiplist ʽ listpack ڱʾС򼯺ϣ skiplist ڱʾκδС򼯺ϡ
 
 
 ʲô Redis û취ʹýʡռıʱ(罫һֻ 1 ԪصļչΪһ 100 Ԫصļ)(specially encoded types)Զתͨ(general type)
@@ -0,0 +1,1402 @@
+/* quicklist.c - A doubly linked list of listpacks
+ *
+ * quicklist.c   listpack ɵ˫
+ *
+ * A quicklist is the encoding of big lists: a doubly linked list where every
+ * node holds a listpack with a bounded number of elements (or of bytes).
+ * Pushing and popping at both ends only touch the head or the tail
+ * listpack, while the per element overhead is the one of the listpack
+ * instead of a list node plus an object plus an sds string for every
+ * element.
+ *
+ * quicklist Ǵбʹõı룺һ˫ÿڵ㱣һ
+ * Ԫֽ޵ listpack 
+ *
+ * ˽͵ֻ޸ıͷβ listpack 
+ * ÿԪصĶ⿪ֻ listpack ڵĿ
+ * һڵһټһ sds ַ
+ *
+ * The listpacks of the nodes that are not near the ends of the list can be
+ * compressed with LZF: 'compress' is the number of nodes at each end left
+ * uncompressed, 0 disables compression. Those nodes are the ones accessed by
+ * LPUSH/RPUSH/LPOP/RPOP, so a queue never decompresses anything.
+ *
+ * б˵Ľڵ LZF ѹ
+ * compress Ϊͷͱβжٸڵ㲻ѹ 0 ʾѹ
+ * LPUSH/RPUSH/LPOP/RPOP ֻ˵Ľڵ㣬ебҪκνѹ
+ *
+ * Copyright (c) 2014, Matt Stancliff <matt@genges.com>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Redis nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h> /* for memcpy */
+#include "quicklist.h"
+#include "zmalloc.h"
+#include "listpack.h"
+#include "util.h" /* for ll2string */
+#include "lzf.h"
+#include "redisassert.h"
+
+/* Optimization levels for size-based filling:
+ * fill -1 is 4kb, -2 is 8kb, ..., -5 is 64kb per listpack.
+ *
+ * fill Ϊʱÿ listpack ֽ */
+static const size_t optimization_level[] = {4096, 8192, 16384, 32768, 65536};
+
+/* Maximum size in bytes of any multi-element listpack.
+ * Larger values will live in their own isolated listpacks.
+ *
+ * fill ΪʱԪص listpack ֽ
+ * Ԫصһ listpack  */
+#define SIZE_SAFETY_LIMIT 8192
+
+/* Minimum listpack size in bytes for attempting compression.
+ *
+ * Сֽ listpack ѹ */
+#define MIN_COMPRESS_BYTES 48
+
+/* Minimum size reduction in bytes to store compressed quicklistNode data.
+ * This also prevents us from storing compression if the compression
+ * resulted in a larger size than the original data.
+ *
+ * ѹҪԼôֽڣűѹݡ */
+#define MIN_COMPRESS_IMPROVE 8
+
+/* Bit field limits of the quicklist structure. */
+#define FILL_MAX ((1 << 15) - 1)
+#define COMPRESS_MAX ((1 << 16) - 1)
+
+/* Size of an empty listpack: header plus end byte. */
+#define LP_EMPTY_SIZE 7
+
+/* Create a new quicklist.
+ * Free with quicklistRelease().
+ *
+ * һµ quicklist ʹ 8kb Ľڵ㣬ѹ */
+quicklist *quicklistCreate(void) {
+    struct quicklist *quicklist;
+
+    quicklist = zmalloc(sizeof(*quicklist));
+    quicklist->head = quicklist->tail = NULL;
+    quicklist->len = 0;
+    quicklist->count = 0;
+    quicklist->compress = 0;
+    quicklist->fill = -2;
+    return quicklist;
+}
+
+void quicklistSetCompressDepth(quicklist *quicklist, int compress) {
+    if (compress > COMPRESS_MAX) {
+        compress = COMPRESS_MAX;
+    } else if (compress < 0) {
+        compress = 0;
+    }
+    quicklist->compress = compress;
+}
+
+void quicklistSetFill(quicklist *quicklist, int fill) {
+    if (fill > FILL_MAX) {
+        fill = FILL_MAX;
+    } else if (fill < -5) {
+        fill = -5;
+    } else if (fill == 0) {
+        fill = 1;
+    }
+    quicklist->fill = fill;
+}
+
+void quicklistSetOptions(quicklist *quicklist, int fill, int depth) {
+    quicklistSetFill(quicklist, fill);
+    quicklistSetCompressDepth(quicklist, depth);
+}
+
+/* Create a new quicklist with some default parameters.
+ *
+ * һʹø quicklist  */
+quicklist *quicklistNew(int fill, int compress) {
+    quicklist *quicklist = quicklistCreate();
+    quicklistSetOptions(quicklist, fill, compress);
+    return quicklist;
+}
+
+static quicklistNode *quicklistCreateNode(void) {
+    quicklistNode *node;
+    node = zmalloc(sizeof(*node));
+    node->lp = NULL;
+    node->count = 0;
+    node->sz = 0;
+    node->next = node->prev = NULL;
+    node->encoding = QUICKLIST_NODE_ENCODING_RAW;
+    node->recompress = 0;
+    node->attempted_compress = 0;
+    return node;
+}
+
+/* Return cached quicklist count */
+unsigned long quicklistCount(const quicklist *ql) { return ql->count; }
+
+/* Free entire quicklist.
+ *
+ * ͷ quicklist  */
+void quicklistRelease(quicklist *quicklist) {
+    quicklistNode *current, *next;
+
+    current = quicklist->head;
+    while (current) {
+        next = current->next;
+        zfree(current->lp);
+        zfree(current);
+        current = next;
+    }
+    zfree(quicklist);
+}
+
+/* Compress the listpack in 'node' and update encoding details.
+ * Returns 1 if listpack compressed successfully.
+ * Returns 0 if compression failed or if listpack too small to compress.
+ *
+ * ѹڵ listpack ѹɹ 1 
+ * ѹʧܻ listpack ̫Сֵѹʱ 0  */
+static int __quicklistCompressNode(quicklistNode *node) {
+    quicklistLZF *lzf;
+
+    node->attempted_compress = 1;
+    node->recompress = 0;
+
+    /* Don't bother compressing small values */
+    if (node->sz < MIN_COMPRESS_BYTES)
+        return 0;
+
+    lzf = zmalloc(sizeof(*lzf) + node->sz);
+
+    /* Cancel if compression fails or doesn't compress small enough */
+    if (((lzf->sz = lzf_compress(node->lp, node->sz, lzf->compressed,
+                                 node->sz)) == 0) ||
+        lzf->sz + MIN_COMPRESS_IMPROVE >= node->sz) {
+        /* lzf_compress aborts/rejects compression if value not compressable. */
+        zfree(lzf);
+        return 0;
+    }
+    lzf = zrealloc(lzf, sizeof(*lzf) + lzf->sz);
+    zfree(node->lp);
+    node->lp = (unsigned char *)lzf;
+    node->encoding = QUICKLIST_NODE_ENCODING_LZF;
+    return 1;
+}
+
+/* Compress only uncompressed nodes. */
+#define quicklistCompressNode(_node)                                           \
+    do {                                                                       \
+        if ((_node) && (_node)->encoding == QUICKLIST_NODE_ENCODING_RAW) {     \
+            __quicklistCompressNode((_node));                                  \
+        }                                                                      \
+    } while (0)
+
+/* Uncompress the listpack in 'node' and update encoding details.
+ *
+ * ѹڵ listpack  */
+static void __quicklistDecompressNode(quicklistNode *node) {
+    void *decompressed = zmalloc(node->sz);
+    quicklistLZF *lzf = (quicklistLZF *)node->lp;
+
+    node->attempted_compress = 0;
+    assert(lzf_decompress(lzf->compressed, lzf->sz, decompressed,
+                          node->sz) == node->sz);
+    zfree(lzf);
+    node->lp = decompressed;
+    node->encoding = QUICKLIST_NODE_ENCODING_RAW;
+}
+
+/* Decompress only compressed nodes. */
+#define quicklistDecompressNode(_node)                                         \
+    do {                                                                       \
+        if ((_node) && (_node)->encoding == QUICKLIST_NODE_ENCODING_LZF) {     \
+            __quicklistDecompressNode((_node));                                \
+        }                                                                      \
+    } while (0)
+
+/* Force node to not be immediately re-compresable
+ *
+ * Ϊʹöʱѹڵ㣬ʹ֮ᱻѹ */
+#define quicklistDecompressNodeForUse(_node)                                   \
+    do {                                                                       \
+        if ((_node) && (_node)->encoding == QUICKLIST_NODE_ENCODING_LZF) {     \
+            __quicklistDecompressNode((_node));                                \
+            (_node)->recompress = 1;                                           \
+        }                                                                      \
+    } while (0)
+
+/* Extract the raw LZF data from this quicklistNode.
+ * Pointer to LZF data is assigned to '*data'.
+ * Return value is the length of compressed LZF data.
+ *
+ * ȡڵ㱻ѹݣڲѹֱӱ浽 RDB  */
+size_t quicklistGetLzf(const quicklistNode *node, void **data) {
+    quicklistLZF *lzf = (quicklistLZF *)node->lp;
+    *data = lzf->compressed;
+    return lzf->sz;
+}
+
+#define quicklistAllowsCompression(_ql) ((_ql)->compress != 0)
+
+/* Force 'quicklist' to meet compression guidelines set by compress depth.
+ * The only way to guarantee interior nodes get compressed is to iterate
+ * to our "interior" compress depth then compress the next node we find.
+ * If compress depth is larger than the entire list, we return immediately.
+ *
+ *  quicklist ѹȵҪ
+ * ѹ compress ڵ㣬ѹ node ԼЩڵ֮Ľڵ㡣
+ *
+ * бĽڵѹȵôʲôѹֱӷء */
+static void __quicklistCompress(const quicklist *quicklist,
+                                quicklistNode *node) {
+    quicklistNode *forward, *reverse;
+    int depth = 0, in_depth = 0;
+
+    /* If length is less than our compress depth (from both sides),
+     * we can't compress anything. */
+    if (!quicklistAllowsCompression(quicklist) ||
+        quicklist->len < (unsigned int)(quicklist->compress * 2))
+        return;
+
+    /* Iterate until we reach compress depth for both sides of the list.
+     * Note: because we do length checks at the *top* of this function,
+     *       we can skip explicit null checks below. Everything exists. */
+    forward = quicklist->head;
+    reverse = quicklist->tail;
+    while (depth++ < quicklist->compress) {
+        /* Nodes near the ends stay uncompressed, also once they are
+         * released by whoever decompressed them for use. */
+        quicklistDecompressNode(forward);
+        quicklistDecompressNode(reverse);
+        forward->recompress = 0;
+        reverse->recompress = 0;
+
+        if (forward == node || reverse == node)
+            in_depth = 1;
+
+        if (forward == reverse || forward->next == reverse)
+            return;
+
+        forward = forward->next;
+        reverse = reverse->prev;
+    }
+
+    if (!in_depth)
+        quicklistCompressNode(node);
+
+    /* At this point, forward and reverse are one node beyond depth */
+    quicklistCompressNode(forward);
+    quicklistCompressNode(reverse);
+}
+
+#define quicklistCompress(_ql, _node)                                          \
+    do {                                                                       \
+        if ((_node)->recompress)                                               \
+            quicklistCompressNode((_node));                                    \
+        else                                                                   \
+            __quicklistCompress((_ql), (_node));                               \
+    } while (0)
+
+/* If we previously used quicklistDecompressNodeForUse(), just recompress. */
+#define quicklistRecompressOnly(_node)                                         \
+    do {                                                                       \
+        if ((_node)->recompress)                                               \
+            quicklistCompressNode((_node));                                    \
+    } while (0)
+
+/* Insert 'new_node' after 'old_node' if 'after' is 1.
+ * Insert 'new_node' before 'old_node' if 'after' is 0.
+ * Note: 'new_node' is *always* uncompressed, so if we assign it to
+ *       head or tail, we do not need to uncompress it.
+ *
+ * after Ϊ 1 ʱ new_node 뵽 old_node ֮Ϊ 0 ʱ뵽 old_node ֮ǰ */
+static void __quicklistInsertNode(quicklist *quicklist, quicklistNode *old_node,
+                                  quicklistNode *new_node, int after) {
+    if (after) {
+        new_node->prev = old_node;
+        if (old_node) {
+            new_node->next = old_node->next;
+            if (old_node->next)
+                old_node->next->prev = new_node;
+            old_node->next = new_node;
+        }
+        if (quicklist->tail == old_node)
+            quicklist->tail = new_node;
+    } else {
+        new_node->next = old_node;
+        if (old_node) {
+            new_node->prev = old_node->prev;
+            if (old_node->prev)
+                old_node->prev->next = new_node;
+            old_node->prev = new_node;
+        }
+        if (quicklist->head == old_node)
+            quicklist->head = new_node;
+    }
+    /* If this insert creates the only element so far, initialize head/tail. */
+    if (quicklist->len == 0) {
+        quicklist->head = quicklist->tail = new_node;
+    }
+    quicklist->len++;
+
+    /* Both nodes may have moved in or out of the compress depth. */
+    if (old_node)
+        quicklistCompress(quicklist, old_node);
+    quicklistCompress(quicklist, new_node);
+}
+
+/* Upper bound of the bytes a listpack entry adds to the string 'sz' bytes
+ * long: the encoding type and length, and the backlen.
+ *
+ * Ϊ sz ַ浽 listpack ʱռõֽ */
+static size_t _quicklistEntryOverhead(size_t sz) {
+    size_t hdr = (sz < 64) ? 1 : (sz < 4096) ? 2 : 5;
+    size_t backlen = (sz+hdr < 128) ? 1 : (sz+hdr < 16384) ? 2 : 5;
+    return hdr + backlen;
+}
+
+static int _quicklistNodeSizeMeetsOptimizationRequirement(const size_t sz,
+                                                          const int fill) {
+    size_t offset;
+
+    if (fill >= 0)
+        return 0;
+
+    offset = (-fill) - 1;
+    if (offset < (sizeof(optimization_level) / sizeof(*optimization_level))) {
+        if (sz <= optimization_level[offset]) {
+            return 1;
+        } else {
+            return 0;
+        }
+    } else {
+        return 0;
+    }
+}
+
+#define sizeMeetsSafetyLimit(sz) ((sz) <= SIZE_SAFETY_LIMIT)
+
+/* Can an element 'sz' bytes long be added to 'node' given the fill factor?
+ *
+ *  fill жܷ񽫳Ϊ sz Ԫӵڵ node С */
+static int _quicklistNodeAllowInsert(const quicklistNode *node, const int fill,
+                                     const size_t sz) {
+    size_t new_sz;
+
+    if (!node)
+        return 0;
+
+    new_sz = node->sz + sz + _quicklistEntryOverhead(sz);
+    if (_quicklistNodeSizeMeetsOptimizationRequirement(new_sz, fill))
+        return 1;
+    else if (!sizeMeetsSafetyLimit(new_sz))
+        return 0;
+    else if ((int)node->count < fill)
+        return 1;
+    else
+        return 0;
+}
+
+/* Can the listpacks of 'a' and 'b' be merged in a single node? */
+static int _quicklistNodeAllowMerge(const quicklistNode *a,
+                                    const quicklistNode *b, const int fill) {
+    size_t merge_sz;
+
+    if (!a || !b)
+        return 0;
+
+    /* approximate merged listpack size (- 7 to remove one listpack
+     * header/trailer) */
+    merge_sz = a->sz + b->sz - LP_EMPTY_SIZE;
+    if (_quicklistNodeSizeMeetsOptimizationRequirement(merge_sz, fill))
+        return 1;
+    else if (!sizeMeetsSafetyLimit(merge_sz))
+        return 0;
+    else if ((int)(a->count + b->count) <= fill)
+        return 1;
+    else
+        return 0;
+}
+
+#define quicklistNodeUpdateSz(node)                                            \
+    do {                                                                       \
+        (node)->sz = lpBytes((node)->lp);                                      \
+    } while (0)
+
+/* Add new entry to head node of quicklist.
+ *
+ * Returns 0 if used existing head.
+ * Returns 1 if new head created.
+ *
+ * Ԫ뵽ͷµıͷڵʱ 1 򷵻 0  */
+int quicklistPushHead(quicklist *quicklist, void *value, size_t sz) {
+    quicklistNode *orig_head = quicklist->head;
+
+    if (_quicklistNodeAllowInsert(quicklist->head, quicklist->fill, sz)) {
+        quicklist->head->lp =
+            lpPush(quicklist->head->lp, value, sz, LISTPACK_HEAD);
+        quicklistNodeUpdateSz(quicklist->head);
+    } else {
+        quicklistNode *node = quicklistCreateNode();
+        node->lp = lpPush(lpNew(), value, sz, LISTPACK_HEAD);
+
+        quicklistNodeUpdateSz(node);
+        __quicklistInsertNode(quicklist, quicklist->head, node, 0);
+    }
+    quicklist->count++;
+    quicklist->head->count++;
+    return (orig_head != quicklist->head);
+}
+
+/* Add new entry to tail node of quicklist.
+ *
+ * Returns 0 if used existing tail.
+ * Returns 1 if new tail created.
+ *
+ * Ԫ뵽βµıβڵʱ 1 򷵻 0  */
+int quicklistPushTail(quicklist *quicklist, void *value, size_t sz) {
+    quicklistNode *orig_tail = quicklist->tail;
+
+    if (_quicklistNodeAllowInsert(quicklist->tail, quicklist->fill, sz)) {
+        quicklist->tail->lp =
+            lpPush(quicklist->tail->lp, value, sz, LISTPACK_TAIL);
+        quicklistNodeUpdateSz(quicklist->tail);
+    } else {
+        quicklistNode *node = quicklistCreateNode();
+        node->lp = lpPush(lpNew(), value, sz, LISTPACK_TAIL);
+
+        quicklistNodeUpdateSz(node);
+        __quicklistInsertNode(quicklist, quicklist->tail, node, 1);
+    }
+    quicklist->count++;
+    quicklist->tail->count++;
+    return (orig_tail != quicklist->tail);
+}
+
+/* Wrapper to allow argument-based switching between HEAD/TAIL pop */
+void quicklistPush(quicklist *quicklist, void *value, const size_t sz,
+                   int where) {
+    if (where == QUICKLIST_HEAD) {
+        quicklistPushHead(quicklist, value, sz);
+    } else if (where == QUICKLIST_TAIL) {
+        quicklistPushTail(quicklist, value, sz);
+    }
+}
+
+/* Create new node consisting of a pre-formed listpack.
+ * Used for loading RDBs where entire listpacks have been stored
+ * to be retrieved later.
+ *
+ * һֳɵ listpack Ϊ½ڵӵβ RDB 
+ * listpack Ȩת quicklist  */
+void quicklistAppendListpack(quicklist *quicklist, unsigned char *lp) {
+    quicklistNode *node = quicklistCreateNode();
+
+    node->lp = lp;
+    node->count = lpLength(node->lp);
+    node->sz = lpBytes(lp);
+
+    __quicklistInsertNode(quicklist, quicklist->tail, node, 1);
+    quicklist->count += node->count;
+}
+
+/* Remove 'node' from the list, freeing it.
+ *
+ * бɾͷŽڵ node  */
+static void __quicklistDelNode(quicklist *quicklist, quicklistNode *node) {
+    if (node->next)
+        node->next->prev = node->prev;
+    if (node->prev)
+        node->prev->next = node->next;
+
+    if (node == quicklist->tail) {
+        quicklist->tail = node->prev;
+    }
+
+    if (node == quicklist->head) {
+        quicklist->head = node->next;
+    }
+
+    quicklist->len--;
+    quicklist->count -= node->count;
+
+    /* If we deleted a node within our compress depth, we
+     * now have compressed nodes needing to be decompressed. */
+    __quicklistCompress(quicklist, NULL);
+
+    zfree(node->lp);
+    zfree(node);
+}
+
+/* Delete one entry from list given the node for the entry and a pointer
+ * to the entry in the node.
+ *
+ * Note: quicklistDelIndex() *requires* uncompressed nodes because you
+ *       already had to get *p from an uncompressed node somewhere.
+ *
+ * Returns 1 if the entire node was deleted, 0 if node still exists.
+ * Also updates in/out param 'p' with the next offset in the listpack.
+ *
+ * ɾڵ node  p ָԪء
+ * ڵ㶼ɾˣô 1 򷵻 0  */
+static int quicklistDelIndex(quicklist *quicklist, quicklistNode *node,
+                             unsigned char **p) {
+    int gone = 0;
+
+    node->lp = lpDelete(node->lp, p);
+    node->count--;
+    if (node->count == 0) {
+        gone = 1;
+        __quicklistDelNode(quicklist, node);
+    } else {
+        quicklistNodeUpdateSz(node);
+    }
+    quicklist->count--;
+    /* If we deleted the node, the original node is no longer valid */
+    return gone ? 1 : 0;
+}
+
+/* Delete one element represented by 'entry'
+ *
+ * 'entry' stores enough metadata to delete the proper position in
+ * the correct listpack in the correct quicklist node.
+ *
+ * ɾصԪ entry µʹõԼС */
+void quicklistDelEntry(quicklistIter *iter, quicklistEntry *entry) {
+    quicklistNode *prev = entry->node->prev;
+    quicklistNode *next = entry->node->next;
+    int deleted_node = quicklistDelIndex((quicklist *)entry->quicklist,
+                                         entry->node, &entry->lp);
+
+    /* after delete, the lp is now invalid for any future usage. */
+    iter->lp = NULL;
+
+    /* If current node is deleted, we must update iterator node and offset. */
+    if (deleted_node) {
+        if (iter->direction == AL_START_HEAD) {
+            iter->current = next;
+            iter->offset = 0;
+        } else if (iter->direction == AL_START_TAIL) {
+            iter->current = prev;
+            iter->offset = -1;
+        }
+    }
+    /* else if (!deleted_node), no changes needed.
+     * we already reset iter->lp above, and the existing iter->offset
+     * doesn't move again because:
+     *   - [1, 2, 3] => delete offset 1 => [1, 3]: next element still offset 1
+     *   - [1, 2, 3] => delete offset 0 => [2, 3]: next element still offset 0
+     *  if we deleted the last element at offet N and now
+     *  length of this listpack is N-1, the next call into
+     *  quicklistNext() will jump to the next node.
+     * The same holds going backward, since backward iterators use negative
+     * offsets (see quicklistGetIteratorAtIdx()). */
+}
+
+/* Populate 'entry' with the element at the specified zero-based index
+ * where 0 is the head, 1 is the element next to head
+ * and so on. Negative integers are used in order to count
+ * from the tail, -1 is the last element, -2 the penultimate
+ * and so on. If the index is out of range 0 is returned.
+ *
+ * Returns 1 if element found
+ * Returns 0 if element not found
+ *
+ * The node of the element is left decompressed for use: the caller must
+ * recompress it (or delete it) when done.
+ *
+ * ҸϵԪأ浽 entry Сҵ 1 򷵻 0 
+ *
+ * ԪڵĽڵᱻʱѹʹ֮Ҫѹ */
+static int quicklistIndex(const quicklist *quicklist, const long long idx,
+                          quicklistEntry *entry) {
+    quicklistNode *n;
+    unsigned long long accum = 0;
+    unsigned long long index;
+    int forward = idx < 0 ? 0 : 1; /* < 0 -> reverse, 0+ -> forward */
+
+    entry->quicklist = quicklist;
+    entry->node = NULL;
+    entry->lp = NULL;
+    entry->value = NULL;
+    entry->longval = -123456789;
+    entry->sz = 0;
+    entry->offset = 123456789;
+
+    index = forward ? idx : (-idx) - 1;
+    if (index >= quicklist->count)
+        return 0;
+
+    n = forward ? quicklist->head : quicklist->tail;
+    while (n) {
+        if ((accum + n->count) > index) {
+            break;
+        } else {
+            accum += n->count;
+            n = forward ? n->next : n->prev;
+        }
+    }
+
+    if (!n)
+        return 0;
+
+    entry->node = n;
+    if (forward) {
+        /* forward = normal head-to-tail offset. */
+        entry->offset = index - accum;
+    } else {
+        /* reverse = need negative offset for tail-to-head, so undo
+         * the result of the original if (index < 0) above. */
+        entry->offset = (-index) - 1 + accum;
+    }
+
+    quicklistDecompressNodeForUse(entry->node);
+    entry->lp = lpSeek(entry->node->lp, entry->offset);
+    lpGet(entry->lp, &entry->value, &entry->sz, &entry->longval);
+    return 1;
+}
+
+/* Replace quicklist entry at offset 'index' by 'data' with length 'sz'.
+ *
+ * Returns 1 if replace happened.
+ * Returns 0 if replace failed and no changes happened.
+ *
+ *  index ϵԪ滻Ϊ data 滻ɹ 1 Χ 0  */
+int quicklistReplaceAtIndex(quicklist *quicklist, long index, void *data,
+                            int sz) {
+    quicklistEntry entry;
+
+    if (quicklistIndex(quicklist, index, &entry)) {
+        entry.node->lp = lpReplace(entry.node->lp, &entry.lp, data, sz);
+        quicklistNodeUpdateSz(entry.node);
+        quicklistCompress(quicklist, entry.node);
+        return 1;
+    } else {
+        return 0;
+    }
+}
+
+/* Split 'node' into two parts: 'node' keeps the elements before 'offset',
+ * the returned new node gets the ones from 'offset' to the end.
+ *
+ * The returned node is not linked in the list yet. 'node' must be
+ * uncompressed.
+ *
+ * ڵ node һΪ node  offset ֮ǰԪأ
+ * ½ڵ㱣 offset ʼֱĩβԪء½ڵɵ߲뵽бС */
+static quicklistNode *_quicklistSplitNode(quicklistNode *node, int offset) {
+    quicklistNode *new_node = quicklistCreateNode();
+
+    new_node->lp = zmalloc(node->sz);
+    memcpy(new_node->lp, node->lp, node->sz);
+
+    node->lp = lpDeleteRange(node->lp, offset, node->count - offset);
+    node->count = offset;
+    quicklistNodeUpdateSz(node);
+
+    new_node->lp = lpDeleteRange(new_node->lp, 0, offset);
+    new_node->count = lpLength(new_node->lp);
+    quicklistNodeUpdateSz(new_node);
+
+    return new_node;
+}
+
+/* Move the elements of the node following 'node' into 'node' when both
+ * fit in one node, then delete the emptied node.
+ *
+ *  node ĺýڵԺϲΪһڵ㣬
+ * ôýڵԪƶ node ɾýڵ㡣 */
+static void _quicklistMergeWithNext(quicklist *quicklist,
+                                    quicklistNode *node) {
+    quicklistNode *next = node->next;
+    unsigned char *p, *vstr;
+    unsigned int vlen;
+    long long vlong;
+    char buf[32];
+
+    if (!_quicklistNodeAllowMerge(node, next, quicklist->fill))
+        return;
+
+    quicklistDecompressNodeForUse(node);
+    quicklistDecompressNodeForUse(next);
+    for (p = lpFirst(next->lp); p; p = lpNext(next->lp, p)) {
+        lpGet(p, &vstr, &vlen, &vlong);
+        if (!vstr) {
+            vlen = ll2string(buf, sizeof(buf), vlong);
+            vstr = (unsigned char *)buf;
+        }
+        node->lp = lpPush(node->lp, vstr, vlen, LISTPACK_TAIL);
+    }
+    node->count += next->count;
+    quicklistNodeUpdateSz(node);
+
+    /* The elements now belong to 'node': don't count them as deleted. */
+    next->count = 0;
+    __quicklistDelNode(quicklist, next);
+    quicklistCompress(quicklist, node);
+}
+
+/* Insert a new entry before or after existing entry 'entry'.
+ *
+ * If after==1, the new value is inserted after 'entry', otherwise
+ * the new value is inserted before 'entry'.
+ *
+ * Ԫز뵽 entry ֮ǰafter Ϊ 0֮after Ϊ 1
+ *
+ *  entry ڵĽڵôԲ뵽ڵĽڵ㣬
+ * ڵĽڵҲ˵Ļʹ½ڵ㣬ߴӲλýڵһΪ */
+static void _quicklistInsert(quicklist *quicklist, quicklistEntry *entry,
+                             void *value, const size_t sz, int after) {
+    int full = 0, at_tail = 0, at_head = 0, full_next = 0, full_prev = 0;
+    int fill = quicklist->fill;
+    quicklistNode *node = entry->node;
+    quicklistNode *new_node = NULL;
+    unsigned char *p;
+    long offset;
+
+    if (!node) {
+        /* we have no reference node, so let's create only node in the list */
+        new_node = quicklistCreateNode();
+        new_node->lp = lpPush(lpNew(), value, sz, LISTPACK_HEAD);
+        new_node->count++;
+        quicklistNodeUpdateSz(new_node);
+        __quicklistInsertNode(quicklist, NULL, new_node, after);
+        quicklist->count++;
+        return;
+    }
+
+    /* Backward iterators use negative offsets. */
+    offset = entry->offset < 0 ? (long)node->count + entry->offset
+                               : entry->offset;
+
+    /* Populate accounting flags for easier boolean checks later */
+    if (!_quicklistNodeAllowInsert(node, fill, sz)) {
+        full = 1;
+    }
+
+    if (after && (offset == (long)node->count - 1)) {
+        at_tail = 1;
+        if (!_quicklistNodeAllowInsert(node->next, fill, sz)) {
+            full_next = 1;
+        }
+    }
+
+    if (!after && (offset == 0)) {
+        at_head = 1;
+        if (!_quicklistNodeAllowInsert(node->prev, fill, sz)) {
+            full_prev = 1;
+        }
+    }
+
+    /* Now determine where and how to insert the new element */
+    if (!full) {
+        /* Room in this node: insert before or after the entry. */
+        quicklistDecompressNodeForUse(node);
+        p = lpSeek(node->lp, offset);
+        if (after) {
+            p = lpNext(node->lp, p);
+            if (p == NULL) {
+                node->lp = lpPush(node->lp, value, sz, LISTPACK_TAIL);
+            } else {
+                node->lp = lpInsert(node->lp, p, value, sz);
+            }
+        } else {
+            node->lp = lpInsert(node->lp, p, value, sz);
+        }
+        node->count++;
+        quicklistNodeUpdateSz(node);
+        quicklistRecompressOnly(node);
+    } else if (at_tail && node->next && !full_next && after) {
+        /* If we are: at tail, next has free space, and inserting after:
+         *   - insert entry at head of next node. */
+        new_node = node->next;
+        quicklistDecompressNodeForUse(new_node);
+        new_node->lp = lpPush(new_node->lp, value, sz, LISTPACK_HEAD);
+        new_node->count++;
+        quicklistNodeUpdateSz(new_node);
+        quicklistRecompressOnly(new_node);
+    } else if (at_head && node->prev && !full_prev && !after) {
+        /* If we are: at head, previous has free space, and inserting before:
+         *   - insert entry at tail of previous node. */
+        new_node = node->prev;
+        quicklistDecompressNodeForUse(new_node);
+        new_node->lp = lpPush(new_node->lp, value, sz, LISTPACK_TAIL);
+        new_node->count++;
+        quicklistNodeUpdateSz(new_node);
+        quicklistRecompressOnly(new_node);
+    } else if ((at_tail && after) || (at_head && !after)) {
+        /* If we are: full, and our prev/next is full or missing:
+         *   - create new node and attach to quicklist */
+        new_node = quicklistCreateNode();
+        new_node->lp = lpPush(lpNew(), value, sz, LISTPACK_HEAD);
+        new_node->count++;
+        quicklistNodeUpdateSz(new_node);
+        __quicklistInsertNode(quicklist, node, new_node, after);
+    } else {
+        /* else, node is full we need to split it: the elements from the
+         * insertion point on move to a new node, the new element is put
+         * at its head, and the new node is linked after 'node'. 'node'
+         * itself is never freed here, since an iterator may point to it. */
+        quicklistDecompressNodeForUse(node);
+        new_node = _quicklistSplitNode(node, after ? offset + 1 : offset);
+        new_node->lp = lpPush(new_node->lp, value, sz, LISTPACK_HEAD);
+        new_node->count++;
+        quicklistNodeUpdateSz(new_node);
+        __quicklistInsertNode(quicklist, node, new_node, 1);
+        quicklistRecompressOnly(node);
+        _quicklistMergeWithNext(quicklist, new_node);
+    }
+
+    quicklist->count++;
+}
+
+void quicklistInsertBefore(quicklist *quicklist, quicklistEntry *entry,
+                           void *value, const size_t sz) {
+    _quicklistInsert(quicklist, entry, value, sz, 0);
+}
+
+void quicklistInsertAfter(quicklist *quicklist, quicklistEntry *entry,
+                          void *value, const size_t sz) {
+    _quicklistInsert(quicklist, entry, value, sz, 1);
+}
+
+/* Delete a range of elements from the quicklist.
+ *
+ * elements may span across multiple quicklistNodes, so we
+ * have to be careful about tracking where we start and end.
+ *
+ * Returns 1 if entries were deleted, 0 if nothing was deleted.
+ *
+ *  start ʼɾ count ԪأɾԪؿܿԽڵ㡣
+ * Ԫرɾʱ 1 򷵻 0  */
+int quicklistDelRange(quicklist *quicklist, const long start,
+                      const long count) {
+    quicklistEntry entry;
+    quicklistNode *node;
+    unsigned long extent;
+    long offset;
+
+    if (count <= 0)
+        return 0;
+
+    extent = count; /* range is inclusive of start position */
+
+    if (start >= 0 && extent > (quicklist->count - start)) {
+        /* if requesting delete more elements than exist, limit to list size. */
+        extent = quicklist->count - start;
+    } else if (start < 0 && extent > (unsigned long)(-start)) {
+        /* else, if at negative offset, limit max size to rest of list. */
+        extent = -start; /* c.f. LREM -29 29; just delete until end. */
+    }
+
+    if (!quicklistIndex(quicklist, start, &entry))
+        return 0;
+
+    node = entry.node;
+    offset = entry.offset < 0 ? (long)node->count + entry.offset
+                              : entry.offset;
+
+    /* iterate over next nodes until everything is deleted. */
+    while (extent) {
+        quicklistNode *next = node->next;
+        unsigned long del;
+
+        if (offset == 0 && extent >= node->count) {
+            /* If we are deleting more than the count of this node, we
+             * can just delete the entire node without listpack math. */
+            extent -= node->count;
+            __quicklistDelNode(quicklist, node);
+        } else {
+            /* Delete from 'offset' up to the end of the node, or just
+             * 'extent' elements when the range ends inside the node. */
+            del = node->count - offset;
+            if (del > extent)
+                del = extent;
+
+            quicklistDecompressNodeForUse(node);
+            node->lp = lpDeleteRange(node->lp, offset, del);
+            quicklistNodeUpdateSz(node);
+            node->count -= del;
+            quicklist->count -= del;
+            extent -= del;
+            quicklistRecompressOnly(node);
+        }
+
+        node = next;
+        offset = 0;
+    }
+    return 1;
+}
+
+/* Passthrough to lpCompare() */
+int quicklistCompare(unsigned char *p1, unsigned char *p2, int p2_len) {
+    return lpCompare(p1, p2, p2_len);
+}
+
+/* Returns a quicklist iterator 'iter'. After the initialization every
+ * call to quicklistNext() will return the next element of the quicklist.
+ *
+ * һ direction Ϊ AL_START_HEAD ʱӱͷβ
+ * Ϊ AL_START_TAIL ʱӱβͷ */
+quicklistIter *quicklistGetIterator(const quicklist *quicklist, int direction) {
+    quicklistIter *iter;
+
+    iter = zmalloc(sizeof(*iter));
+
+    if (direction == AL_START_HEAD) {
+        iter->current = quicklist->head;
+        iter->offset = 0;
+    } else if (direction == AL_START_TAIL) {
+        iter->current = quicklist->tail;
+        iter->offset = -1;
+    }
+
+    iter->direction = direction;
+    iter->quicklist = quicklist;
+
+    iter->lp = NULL;
+
+    return iter;
+}
+
+/* Initialize an iterator at a specific offset 'idx' and make the iterator
+ * return nodes in 'direction' direction.
+ *
+ * Returns NULL when 'idx' is out of range.
+ *
+ * һ idx ʼĵΧʱ NULL  */
+quicklistIter *quicklistGetIteratorAtIdx(const quicklist *quicklist,
+                                         const int direction,
+                                         const long long idx) {
+    quicklistEntry entry;
+
+    if (quicklistIndex(quicklist, idx, &entry)) {
+        quicklistIter *base = quicklistGetIterator(quicklist, direction);
+        base->lp = NULL;
+        base->current = entry.node;
+        /* Forward iterators use offsets from the head of the listpack,
+         * backward ones offsets from its tail, so that deleting the
+         * current entry leaves the offset of the next one unchanged. */
+        base->offset = entry.offset;
+        if (direction == AL_START_HEAD && base->offset < 0)
+            base->offset += entry.node->count;
+        else if (direction == AL_START_TAIL && base->offset >= 0)
+            base->offset -= entry.node->count;
+        return base;
+    } else {
+        return NULL;
+    }
+}
+
+/* Release iterator.
+ * If we still have a valid current node, then re-encode current node.
+ *
+ * ͷŵѹǰڵĽڵ㡣 */
+void quicklistReleaseIterator(quicklistIter *iter) {
+    if (!iter)
+        return;
+    if (iter->current)
+        quicklistCompress(iter->quicklist, iter->current);
+
+    zfree(iter);
+}
+
+/* Get next element in iterator.
+ *
+ * Note: You must NOT insert into the list while iterating over it.
+ * You *may* delete from the list while iterating using the
+ * quicklistDelEntry() function.
+ * If you insert into the quicklist while iterating, you should
+ * re-create the iterator after your addition.
+ *
+ * Populates 'entry' with values for this iteration.
+ * Returns 0 when iteration is complete or if iteration not possible.
+ * If return value is 0, the contents of 'entry' are not valid.
+ *
+ * ȡһԪأ浽 entry С
+ * ʱ 0 ʱ entry Ч
+ *
+ * Ĺпͨ quicklistDelEntry() ɾԪأ
+ * ܲԪأ֮Ҫ´ */
+int quicklistNext(quicklistIter *iter, quicklistEntry *entry) {
+    int forward;
+
+    entry->quicklist = iter->quicklist;
+    entry->node = iter->current;
+    entry->lp = NULL;
+    entry->value = NULL;
+    entry->longval = -123456789;
+    entry->sz = 0;
+
+    if (!iter->current)
+        return 0;
+
+    forward = iter->direction == AL_START_HEAD;
+    if (!iter->lp) {
+        /* If !lp, use current index. */
+        quicklistDecompressNodeForUse(iter->current);
+        iter->lp = lpSeek(iter->current->lp, iter->offset);
+    } else {
+        /* else, use existing iterator offset and get prev/next as necessary. */
+        if (forward) {
+            iter->lp = lpNext(iter->current->lp, iter->lp);
+            iter->offset += 1;
+        } else {
+            iter->lp = lpPrev(iter->current->lp, iter->lp);
+            iter->offset -= 1;
+        }
+    }
+
+    entry->lp = iter->lp;
+    entry->offset = iter->offset;
+
+    if (iter->lp) {
+        /* Populate value from existing listpack position */
+        lpGet(entry->lp, &entry->value, &entry->sz, &entry->longval);
+        return 1;
+    } else {
+        /* We ran out of listpack entries.
+         * Pick next node, update offset, then re-run retrieval. */
+        quicklistCompress(iter->quicklist, iter->current);
+        if (forward) {
+            /* Forward traversal */
+            iter->current = iter->current->next;
+            iter->offset = 0;
+        } else {
+            /* Reverse traversal */
+            iter->current = iter->current->prev;
+            iter->offset = -1;
+        }
+        iter->lp = NULL;
+        return quicklistNext(iter, entry);
+    }
+}
+
+/* Default pop function
+ *
+ * Returns malloc'd value from quicklist */
+static void *_quicklistSaver(unsigned char *data, unsigned int sz) {
+    unsigned char *vstr;
+    if (data) {
+        vstr = zmalloc(sz);
+        memcpy(vstr, data, sz);
+        return vstr;
+    }
+    return NULL;
+}
+
+/* pop from quicklist and return result in 'data' ptr.  Value of 'data'
+ * is the return value of 'saver' function pointer if the data is NOT a number.
+ *
+ * If the quicklist element is a long long, then the return value is returned in
+ * 'sval'.
+ *
+ * Return value of 0 means no elements available.
+ * Return value of 1 means check 'data' and 'sval' for values.
+ * If 'data' is set, use 'data' and 'sz'.  Otherwise, use 'sval'.
+ *
+ * ӱͷβһԪءбΪʱ 0 
+ *
+ * ַԪ saver 棨ĬϸƵһ·ڴ棩
+ *  data  sz УԪر sval Уʱ data Ϊ NULL  */
+int quicklistPopCustom(quicklist *quicklist, int where, unsigned char **data,
+                       unsigned int *sz, long long *sval,
+                       void *(*saver)(unsigned char *data, unsigned int sz)) {
+    unsigned char *p;
+    unsigned char *vstr;
+    unsigned int vlen;
+    long long vlong;
+    int pos = (where == QUICKLIST_HEAD) ? 0 : -1;
+    quicklistNode *node;
+
+    if (quicklist->count == 0)
+        return 0;
+
+    if (data)
+        *data = NULL;
+    if (sz)
+        *sz = 0;
+    if (sval)
+        *sval = -123456789;
+
+    if (!saver)
+        saver = _quicklistSaver;
+
+    if (where == QUICKLIST_HEAD && quicklist->head) {
+        node = quicklist->head;
+    } else if (where == QUICKLIST_TAIL && quicklist->tail) {
+        node = quicklist->tail;
+    } else {
+        return 0;
+    }
+
+    /* The ends are never compressed, unless the depth was just changed. */
+    quicklistDecompressNode(node);
+    p = lpSeek(node->lp, pos);
+    if (lpGet(p, &vstr, &vlen, &vlong)) {
+        if (vstr) {
+            if (data)
+                *data = saver(vstr, vlen);
+            if (sz)
+                *sz = vlen;
+        } else {
+            if (data)
+                *data = NULL;
+            if (sval)
+                *sval = vlong;
+        }
+        quicklistDelIndex(quicklist, node, &p);
+        return 1;
+    }
+    return 0;
+}
+
+#ifdef QUICKLIST_TEST_MAIN
+/* Build with:
+ *
+ *   cc -O2 -DQUICKLIST_TEST_MAIN quicklist.c listpack.c lzf_c.c lzf_d.c util.c sds.c zmalloc.c -lm -o quicklist-test
+ *
+ * './quicklist-test [seed]' checks quicklists with several fill factors and
+ * compress depths against an array of strings, using random operations. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "sds.h"
+
+/* Normally provided by debug.c. */
+void _redisAssert(char *estr, char *file, int line) {
+    fprintf(stderr,"=== ASSERTION FAILED ===\n");
+    fprintf(stderr,"==> %s:%d '%s' is not true\n",file,line,estr);
+    exit(1);
+}
+
+#define CHECK_OPS 20000
+#define CHECK_MAX 2000
+
+/* Return the element in 'entry' as a new sds string. */
+static sds entryToSds(quicklistEntry *entry) {
+    return entry->value ? sdsnewlen(entry->value,entry->sz) :
+                          sdsfromlonglong(entry->longval);
+}
+
+/* Check the structure of 'ql': links, counters, node sizes, and that only
+ * the nodes beyond the compress depth are compressed. Then check that it
+ * holds the 'len' strings of 'ref', iterating it in both directions. */
+static void checkQuicklist(quicklist *ql, sds *ref, long len) {
+    quicklistNode *node, *prev = NULL;
+    quicklistIter *iter;
+    quicklistEntry entry;
+    unsigned long count = 0, nodes = 0;
+    long j;
+
+    for (node = ql->head; node; prev = node, node = node->next, nodes++) {
+        unsigned char *lp = node->lp;
+        int interior = nodes >= ql->compress &&
+                       nodes + ql->compress < ql->len;
+
+        assert(node->prev == prev);
+        assert(node->count > 0);
+        assert(!node->recompress);
+        count += node->count;
+        if (quicklistNodeIsCompressed(node)) {
+            assert(ql->compress && interior);
+            continue;
+        }
+        /* Interior nodes not compressed were too small or random data. */
+        assert(!ql->compress || !interior || node->attempted_compress);
+        assert(node->sz == lpBytes(lp));
+        assert(node->count == lpLength(lp));
+    }
+    assert(prev == ql->tail);
+    assert(nodes == ql->len);
+    assert(count == ql->count);
+
+    iter = quicklistGetIterator(ql,AL_START_HEAD);
+    for (j = 0; quicklistNext(iter,&entry); j++) {
+        sds s = entryToSds(&entry);
+        assert(j < len && sdscmp(s,ref[j]) == 0);
+        assert(quicklistCompare(entry.lp,(unsigned char*)ref[j],sdslen(ref[j])));
+        sdsfree(s);
+    }
+    quicklistReleaseIterator(iter);
+    assert(j == len && (unsigned long)len == quicklistCount(ql));
+
+    iter = quicklistGetIterator(ql,AL_START_TAIL);
+    for (j = len-1; quicklistNext(iter,&entry); j--) {
+        sds s = entryToSds(&entry);
+        assert(j >= 0 && sdscmp(s,ref[j]) == 0);
+        sdsfree(s);
+    }
+    quicklistReleaseIterator(iter);
+    assert(j == -1);
+}
+
+/* A random element: a small integer, or a string that compresses well
+ * most of the times, sometimes a long one. */
+static sds randomElement(void) {
+    sds s;
+    int j, len;
+
+    if (rand() % 4 == 0) return sdsfromlonglong(rand() % 100000 - 50000);
+    len = (rand() % 20 == 0) ? rand() % 10000 : rand() % 40;
+    s = sdsgrowzero(sdsempty(),len);
+    for (j = 0; j < len; j++) s[j] = (rand() % 8) ? 'a' : 'a'+rand()%26;
+    return s;
+}
+
+static void checkRandomOps(int fill, int depth) {
+    quicklist *ql = quicklistNew(fill,depth);
+    static sds ref[CHECK_MAX+1];
+    long len = 0, j, k, start, num;
+    int op;
+
+    for (op = 0; op < CHECK_OPS; op++) {
+        int action = rand() % 10;
+
+        if (len == 0 || (len < CHECK_MAX && action < 4)) {
+            /* Push at the head or at the tail. */
+            sds s = randomElement();
+            if (rand() % 2) {
+                quicklistPushHead(ql,s,sdslen(s));
+                memmove(ref+1,ref,sizeof(sds)*len);
+                ref[0] = s;
+            } else {
+                quicklistPushTail(ql,s,sdslen(s));
+                ref[len] = s;
+            }
+            len++;
+        } else if (action < 6) {
+            /* Pop from the head or from the tail. */
+            unsigned char *data;
+            unsigned int sz;
+            long long sval;
+            sds s;
+            int head = rand() % 2;
+
+            assert(quicklistPopCustom(ql,head ? QUICKLIST_HEAD : QUICKLIST_TAIL,
+                                      &data,&sz,&sval,NULL));
+            s = data ? sdsnewlen(data,sz) : sdsfromlonglong(sval);
+            zfree(data);
+            j = head ? 0 : len-1;
+            assert(sdscmp(s,ref[j]) == 0);
+            sdsfree(s);
+            sdsfree(ref[j]);
+            memmove(ref+j,ref+j+1,sizeof(sds)*(len-j-1));
+            len--;
+        } else if (action < 7 && len < CHECK_MAX) {
+            /* Insert before or after a random element, found iterating
+             * forward or backward. */
+            quicklistIter *iter;
+            quicklistEntry entry;
+            sds s = randomElement();
+            int after = rand() % 2;
+
+            j = rand() % len;
+            if (rand() % 2) {
+                iter = quicklistGetIteratorAtIdx(ql,AL_START_HEAD,j);
+            } else {
+                iter = quicklistGetIteratorAtIdx(ql,AL_START_TAIL,j-len);
+            }
+            assert(quicklistNext(iter,&entry));
+            if (after) {
+                quicklistInsertAfter(ql,&entry,s,sdslen(s));
+                j++;
+            } else {
+                quicklistInsertBefore(ql,&entry,s,sdslen(s));
+            }
+            quicklistReleaseIterator(iter);
+            memmove(ref+j+1,ref+j,sizeof(sds)*(len-j));
+            ref[j] = s;
+            len++;
+        } else if (action < 8) {
+            /* Replace a random element. */
+            sds s = randomElement();
+
+            j = rand() % len;
+            assert(quicklistReplaceAtIndex(ql,(rand() % 2) ? j : j-len,
+                                           s,sdslen(s)));
+            sdsfree(ref[j]);
+            ref[j] = s;
+        } else if (action < 9) {
+            /* Delete the elements equal to a random one while iterating,
+             * in either direction, like LREM does. */
+            quicklistIter *iter;
+            quicklistEntry entry;
+            sds target = sdsdup(ref[rand() % len]);
+            int forward = rand() % 2;
+
+            iter = forward ? quicklistGetIteratorAtIdx(ql,AL_START_HEAD,0) :
+                             quicklistGetIteratorAtIdx(ql,AL_START_TAIL,-1);
+            while (quicklistNext(iter,&entry)) {
+                if (quicklistCompare(entry.lp,(unsigned char*)target,
+                                     sdslen(target)))
+                    quicklistDelEntry(iter,&entry);
+            }
+            quicklistReleaseIterator(iter);
+            for (j = 0, k = 0; j < len; j++) {
+                if (sdscmp(ref[j],target) == 0) {
+                    sdsfree(ref[j]);
+                } else {
+                    ref[k++] = ref[j];
+                }
+            }
+            len = k;
+            sdsfree(target);
+        } else {
+            /* Delete a random range, like LTRIM does. */
+            start = rand() % len;
+            num = rand() % (len-start) + 1;
+            assert(quicklistDelRange(ql,(rand() % 2) ? start : start-len,num));
+            for (j = start; j < start+num; j++) sdsfree(ref[j]);
+            memmove(ref+start,ref+start+num,sizeof(sds)*(len-start-num));
+            len -= num;
+        }
+        if (op % 500 == 0 || len < 50) checkQuicklist(ql,ref,len);
+    }
+    checkQuicklist(ql,ref,len);
+    for (j = 0; j < len; j++) sdsfree(ref[j]);
+    quicklistRelease(ql);
+}
+
+int main(int argc, char **argv) {
+    int fills[] = {1, 2, 4, 32, 128, -1, -2, -5}, depths[] = {0, 1, 2, 4};
+    unsigned int f, d;
+
+    /* If an argument is given, use it as the random seed. */
+    srand(argc == 2 ? atoi(argv[1]) : time(NULL));
+
+    for (f = 0; f < sizeof(fills)/sizeof(*fills); f++) {
+        for (d = 0; d < sizeof(depths)/sizeof(*depths); d++) {
+            checkRandomOps(fills[f],depths[d]);
+            printf("Random operations, fill %d, compress depth %d: ok\n",
+                fills[f], depths[d]);
+        }
+    }
+    return 0;
+}
+#endif
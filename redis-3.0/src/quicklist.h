@@ -0,0 +1,155 @@
+/* quicklist.h - A doubly linked list of listpacks
+ *
+ * quicklist.h   listpack ɵ˫ quicklist.c
+ */
+
+#ifndef __QUICKLIST_H__
+#define __QUICKLIST_H__
+
+/* Node, quicklist, and Iterator are the only data structures used currently. */
+
+/* quicklistNode is a 32 byte struct describing a listpack for a quicklist.
+ * We use bit fields keep the quicklistNode at 32 bytes.
+ *
+ * quicklist ڵ㣬ÿڵ㱣һ listpack 
+ *
+ * count: 16 bits, max 65536 (max lp bytes is 65k, so max count actually < 32k).
+ * encoding: 2 bits, RAW=1, LZF=2.
+ * recompress: 1 bit, bool, true if node is temporarily decompressed for usage.
+ * attempted_compress: 1 bit, boolean, used for verifying during testing.
+ */
+typedef struct quicklistNode {
+
+    // ǰýڵͺýڵ
+    struct quicklistNode *prev;
+    struct quicklistNode *next;
+
+    // ڵ㱣 listpack ѹʱָ quicklistLZF ṹ
+    unsigned char *lp;
+
+    // listpack δѹʱֽ
+    unsigned int sz;             /* listpack size in bytes */
+
+    // listpack еԪ
+    unsigned int count : 16;     /* count of items in listpack */
+
+    // ڵı룺 RAW  LZF
+    unsigned int encoding : 2;   /* RAW==1 or LZF==2 */
+
+    // ڵǷΪʹöʱѹ
+    unsigned int recompress : 1; /* was this node previous compressed? */
+
+    // ڵǷΪ̫Сûбѹ
+    unsigned int attempted_compress : 1; /* node can't compress; too small */
+
+    unsigned int extra : 12; /* more bits to steal for future usage */
+
+} quicklistNode;
+
+/* quicklistLZF is a 4+N byte struct holding 'sz' followed by 'compressed'.
+ * 'sz' is byte length of 'compressed' field.
+ * 'compressed' is LZF data with total (compressed) length 'sz'
+ *
+ *  LZF ѹ listpack  sz Ϊѹݵĳȡ
+ * δѹʱĳȱڽڵ sz  */
+typedef struct quicklistLZF {
+    unsigned int sz; /* LZF size in bytes*/
+    char compressed[];
+} quicklistLZF;
+
+/* quicklist is a 32 byte struct (on 64-bit systems) describing a quicklist.
+ * 'count' is the number of total entries.
+ * 'len' is the number of quicklist nodes.
+ * 'compress' is: 0 if compression disabled, otherwise it's the number
+ *                of quicklistNodes to leave uncompressed at ends of quicklist.
+ * 'fill' is the user-requested (or default) fill factor.
+ *
+ * quicklist ṹ
+ *
+ * count Ϊ listpack Ԫص len Ϊڵ
+ *
+ * compress Ϊ 0 ʱѹʾͷͱβжٸڵ㲻ѹ
+ *
+ * fill ÿڵĴСʾÿڵౣԪ
+ * ʾÿڵ listpack ֽ -1 Ϊ 4kb  -2 Ϊ 8kb Դƣ */
+typedef struct quicklist {
+    quicklistNode *head;
+    quicklistNode *tail;
+    unsigned long count;        /* total count of all entries in all listpacks */
+    unsigned int len;           /* number of quicklistNodes */
+    int fill : 16;              /* fill factor for individual nodes */
+    unsigned int compress : 16; /* depth of end nodes not to compress;0=off */
+} quicklist;
+
+/*  */
+typedef struct quicklistIter {
+    const quicklist *quicklist;
+    quicklistNode *current;
+    unsigned char *lp;
+    long offset; /* offset in current listpack */
+    int direction;
+} quicklistIter;
+
+/* صԪأַ value/sz У longval  */
+typedef struct quicklistEntry {
+    const quicklist *quicklist;
+    quicklistNode *node;
+    unsigned char *lp;
+    unsigned char *value;
+    long long longval;
+    unsigned int sz;
+    int offset;
+} quicklistEntry;
+
+#define QUICKLIST_HEAD 0
+#define QUICKLIST_TAIL 1
+
+/* quicklist node encodings */
+#define QUICKLIST_NODE_ENCODING_RAW 1
+#define QUICKLIST_NODE_ENCODING_LZF 2
+
+/* quicklist compression disable */
+#define QUICKLIST_NOCOMPRESS 0
+
+/* Iterator directions, the same as the adlist.h ones */
+#ifndef AL_START_HEAD
+#define AL_START_HEAD 0
+#define AL_START_TAIL 1
+#endif
+
+#define quicklistNodeIsCompressed(node)                                        \
+    ((node)->encoding == QUICKLIST_NODE_ENCODING_LZF)
+
+/* Prototypes */
+quicklist *quicklistCreate(void);
+quicklist *quicklistNew(int fill, int compress);
+void quicklistSetCompressDepth(quicklist *quicklist, int depth);
+void quicklistSetFill(quicklist *quicklist, int fill);
+void quicklistSetOptions(quicklist *quicklist, int fill, int depth);
+void quicklistRelease(quicklist *quicklist);
+int quicklistPushHead(quicklist *quicklist, void *value, const size_t sz);
+int quicklistPushTail(quicklist *quicklist, void *value, const size_t sz);
+void quicklistPush(quicklist *quicklist, void *value, const size_t sz,
+                   int where);
+void quicklistAppendListpack(quicklist *quicklist, unsigned char *lp);
+void quicklistInsertBefore(quicklist *quicklist, quicklistEntry *entry,
+                           void *value, const size_t sz);
+void quicklistInsertAfter(quicklist *quicklist, quicklistEntry *entry,
+                          void *value, const size_t sz);
+void quicklistDelEntry(quicklistIter *iter, quicklistEntry *entry);
+int quicklistReplaceAtIndex(quicklist *quicklist, long index, void *data,
+                            int sz);
+int quicklistDelRange(quicklist *quicklist, const long start, const long count);
+quicklistIter *quicklistGetIterator(const quicklist *quicklist, int direction);
+quicklistIter *quicklistGetIteratorAtIdx(const quicklist *quicklist,
+                                         int direction, const long long idx);
+int quicklistNext(quicklistIter *iter, quicklistEntry *node);
+void quicklistReleaseIterator(quicklistIter *iter);
+int quicklistPopCustom(quicklist *quicklist, int where, unsigned char **data,
+                       unsigned int *sz, long long *sval,
+                       void *(*saver)(unsigned char *data, unsigned int sz));
+unsigned long quicklistCount(const quicklist *ql);
+int quicklistCompare(unsigned char *p1, unsigned char *p2, int p2_len);
+size_t quicklistGetLzf(const quicklistNode *node, void **data);
+
+#endif /* __QUICKLIST_H__ */
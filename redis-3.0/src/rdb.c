@@ -29,8 +29,13 @@
 
 #include "redis.h"
 #include "lzf.h"    /* LZF compression library */
+#include "lz4.h"    /* LZ4 compression library */
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
 #include "zipmap.h"
 #include "endianconv.h"
+#include "crc64.h"
 
 #include <math.h>
 #include <sys/types.h>
@@ -301,6 +306,51 @@ int rdbTryIntegerEncoding(char *s, size_t len, unsigned char *enc) {
     return rdbEncodeInteger(value,enc);
 }
 
+/*
+ * Ѿ enctype ָ㷨ѹ data 浽 rdb У
+ * compress_len Ϊѹĳȣ original_len Ϊѹǰĳȡ
+ *
+ * ڳɹʱдֽдʧʱ -1 
+ */
+static int rdbSaveCompressedBlob(rio *rdb, int enctype, void *data,
+                                 size_t compress_len, size_t original_len) {
+    unsigned char byte;
+    int n, nwritten = 0;
+
+    /* Data compressed! Let's save it on disk 
+     *
+     * ѹַ rdb 
+     */
+
+    // дͣ˵һ LZF / LZ4 / zstd ѹַ
+    byte = (REDIS_RDB_ENCVAL<<6)|enctype;
+    if ((n = rdbWriteRaw(rdb,&byte,1)) == -1) return -1;
+    nwritten += n;
+
+    // дַѹĳ
+    if ((n = rdbSaveLen(rdb,compress_len)) == -1) return -1;
+    nwritten += n;
+    
+    // дַδѹʱĳ
+    if ((n = rdbSaveLen(rdb,original_len)) == -1) return -1;
+    nwritten += n;
+
+    // дѹַ
+    if ((n = rdbWriteRaw(rdb,data,compress_len)) == -1) return -1;
+    nwritten += n;
+
+    return nwritten;
+}
+
+/*
+ * Ѿ LZF ѹ data 浽 rdb С
+ */
+int rdbSaveLzfBlob(rio *rdb, void *data, size_t compress_len,
+                   size_t original_len) {
+    return rdbSaveCompressedBlob(rdb,REDIS_RDB_ENC_LZF,data,compress_len,
+                                 original_len);
+}
+
 /*
  * Զַ s ѹ
  * ѹɹôѹַ浽 rdb С
@@ -311,9 +361,8 @@ int rdbTryIntegerEncoding(char *s, size_t len, unsigned char *enc) {
  */
 int rdbSaveLzfStringObject(rio *rdb, unsigned char *s, size_t len) {
     size_t comprlen, outlen;
-    unsigned char byte;
-    int n, nwritten = 0;
     void *out;
+    int nwritten;
 
     /* We require at least four bytes compression for this to be worth it */
     // ѹַ
@@ -326,41 +375,98 @@ int rdbSaveLzfStringObject(rio *rdb, unsigned char *s, size_t len) {
         return 0;
     }
 
-    /* Data compressed! Let's save it on disk 
-     *
-     * ѹַ rdb 
-     */
+    nwritten = rdbSaveLzfBlob(rdb,out,comprlen,len);
+    zfree(out);
+    return nwritten;
+}
 
-    // дͣ˵һ LZF ѹַ
-    byte = (REDIS_RDB_ENCVAL<<6)|REDIS_RDB_ENC_LZF;
-    if ((n = rdbWriteRaw(rdb,&byte,1)) == -1) goto writeerr;
-    nwritten += n;
+#ifdef HAVE_ZSTD
+/* zstd contexts are expensive to create, so every thread saving or loading
+ * RDB files keeps its own ones. */
+#define RDB_ZSTD_LEVEL 3
 
-    // дַѹĳ
-    if ((n = rdbSaveLen(rdb,comprlen)) == -1) goto writeerr;
-    nwritten += n;
-    
-    // дַδѹʱĳ
-    if ((n = rdbSaveLen(rdb,len)) == -1) goto writeerr;
-    nwritten += n;
+typedef struct rdbZstdContext {
+    ZSTD_CCtx *cctx;
+    ZSTD_DCtx *dctx;
+} rdbZstdContext;
 
-    // дѹַ
-    if ((n = rdbWriteRaw(rdb,out,comprlen)) == -1) goto writeerr;
-    nwritten += n;
+static pthread_key_t rdbZstdKey;
+static pthread_once_t rdbZstdOnce = PTHREAD_ONCE_INIT;
 
-    zfree(out);
+static void rdbZstdFreeContext(void *ptr) {
+    rdbZstdContext *ctx = ptr;
 
-    return nwritten;
+    if (ctx->cctx) ZSTD_freeCCtx(ctx->cctx);
+    if (ctx->dctx) ZSTD_freeDCtx(ctx->dctx);
+    zfree(ctx);
+}
+
+static void rdbZstdCreateKey(void) {
+    pthread_key_create(&rdbZstdKey,rdbZstdFreeContext);
+}
+
+/* Return the zstd contexts of the calling thread, creating them if needed. */
+static rdbZstdContext *rdbZstdGetContext(void) {
+    rdbZstdContext *ctx;
+
+    pthread_once(&rdbZstdOnce,rdbZstdCreateKey);
+    if ((ctx = pthread_getspecific(rdbZstdKey)) == NULL) {
+        ctx = zmalloc(sizeof(*ctx));
+        ctx->cctx = ZSTD_createCCtx();
+        ctx->dctx = ZSTD_createDCtx();
+        pthread_setspecific(rdbZstdKey,ctx);
+    }
+    return ctx;
+}
+#endif
+
+/*
+ * ʹ rdbcompression ѡָ㷨ѹַ s 
+ * ѹɹôѹַ浽 rdb С
+ *
+ * ֵ rdbSaveLzfStringObject() ͬ
+ */
+int rdbSaveCompressedStringObject(rio *rdb, unsigned char *s, size_t len) {
+    size_t comprlen = 0, outlen;
+    int enctype, nwritten;
+    void *out;
+
+    if (server.rdb_compression == REDIS_RDB_COMPRESSION_LZF)
+        return rdbSaveLzfStringObject(rdb,s,len);
+
+    /* Like LZF we require at least four bytes compression. */
+    if (len <= 4) return 0;
+    outlen = len-4;
+    if ((out = zmalloc(outlen+1)) == NULL) return 0;
+    if (server.rdb_compression == REDIS_RDB_COMPRESSION_LZ4) {
+        enctype = REDIS_RDB_ENC_LZ4;
+        if (len <= LZ4_MAX_INPUT_SIZE)
+            comprlen = LZ4_compress_default((char*)s,out,len,outlen);
+    } else {
+#ifdef HAVE_ZSTD
+        enctype = REDIS_RDB_ENC_ZSTD;
+        comprlen = ZSTD_compressCCtx(rdbZstdGetContext()->cctx,out,outlen,
+                                     s,len,RDB_ZSTD_LEVEL);
+        if (ZSTD_isError(comprlen)) comprlen = 0;
+#else
+        redisPanic("Unknown RDB compression codec");
+#endif
+    }
+    if (comprlen == 0) {
+        zfree(out);
+        return 0;
+    }
 
-writeerr:
+    nwritten = rdbSaveCompressedBlob(rdb,enctype,out,comprlen,len);
     zfree(out);
-    return -1;
+    return nwritten;
 }
 
 /*
- *  rdb 뱻 LZF ѹַѹӦַ
+ *  rdb 뱻 LZF / LZ4 / zstd ѹַ
+ * ѹӦַ
  */
-robj *rdbLoadLzfStringObject(rio *rdb) {
+static robj *rdbLoadCompressedStringObject(rio *rdb, int enctype) {
     unsigned int len, clen;
     unsigned char *c = NULL;
     sds val = NULL;
@@ -378,7 +484,19 @@ robj *rdbLoadLzfStringObject(rio *rdb) {
     if (rioRead(rdb,c,clen) == 0) goto err;
 
     // ѹ棬óַ
-    if (lzf_decompress(c,clen,val,len) == 0) goto err;
+    if (enctype == REDIS_RDB_ENC_LZF) {
+        if (lzf_decompress(c,clen,val,len) == 0) goto err;
+    } else if (enctype == REDIS_RDB_ENC_LZ4) {
+        if (LZ4_decompress_safe((char*)c,val,clen,len) != (int)len) goto err;
+    } else {
+#ifdef HAVE_ZSTD
+        if (ZSTD_decompressDCtx(rdbZstdGetContext()->dctx,val,len,c,clen)
+            != len) goto err;
+#else
+        redisLog(REDIS_WARNING,"The RDB file has zstd compressed strings: zstd support is not compiled in, build with USE_ZSTD=yes.");
+        goto err;
+#endif
+    }
     zfree(c);
 
     // ַ
@@ -425,7 +543,7 @@ int rdbSaveRawString(rio *rdb, unsigned char *s, size_t len) {
     if (server.rdb_compression && len > 20) {
 
         // ѹ
-        n = rdbSaveLzfStringObject(rdb,s,len);
+        n = rdbSaveCompressedStringObject(rdb,s,len);
 
         if (n == -1) return -1;
         if (n > 0) return n;
@@ -537,9 +655,11 @@ robj *rdbGenericLoadStringObject(rio *rdb, int encode) {
         case REDIS_RDB_ENC_INT32:
             return rdbLoadIntegerObject(rdb,len,encode);
 
-        // LZF ѹ
+        // LZF / LZ4 / zstd ѹ
         case REDIS_RDB_ENC_LZF:
-            return rdbLoadLzfStringObject(rdb);
+        case REDIS_RDB_ENC_LZ4:
+        case REDIS_RDB_ENC_ZSTD:
+            return rdbLoadCompressedStringObject(rdb,len);
 
         default:
             redisPanic("Unknown RDB encoding type");
@@ -664,10 +784,10 @@ int rdbSaveObjectType(rio *rdb, robj *o) {
         return rdbSaveType(rdb,REDIS_RDB_TYPE_STRING);
 
     case REDIS_LIST:
-        if (o->encoding == REDIS_ENCODING_ZIPLIST)
-            return rdbSaveType(rdb,REDIS_RDB_TYPE_LIST_ZIPLIST);
-        else if (o->encoding == REDIS_ENCODING_LINKEDLIST)
-            return rdbSaveType(rdb,REDIS_RDB_TYPE_LIST);
+        if (o->encoding == REDIS_ENCODING_LISTPACK)
+            return rdbSaveType(rdb,REDIS_RDB_TYPE_LIST_LISTPACK);
+        else if (o->encoding == REDIS_ENCODING_QUICKLIST)
+            return rdbSaveType(rdb,REDIS_RDB_TYPE_LIST_QUICKLIST);
         else
             redisPanic("Unknown list encoding");
 
@@ -680,16 +800,17 @@ int rdbSaveObjectType(rio *rdb, robj *o) {
             redisPanic("Unknown set encoding");
 
     case REDIS_ZSET:
-        if (o->encoding == REDIS_ENCODING_ZIPLIST)
-            return rdbSaveType(rdb,REDIS_RDB_TYPE_ZSET_ZIPLIST);
-        else if (o->encoding == REDIS_ENCODING_SKIPLIST)
+        if (o->encoding == REDIS_ENCODING_LISTPACK)
+            return rdbSaveType(rdb,REDIS_RDB_TYPE_ZSET_LISTPACK);
+        else if (o->encoding == REDIS_ENCODING_SKIPLIST ||
+                 o->encoding == REDIS_ENCODING_BTREE)
             return rdbSaveType(rdb,REDIS_RDB_TYPE_ZSET);
         else
             redisPanic("Unknown sorted set encoding");
 
     case REDIS_HASH:
-        if (o->encoding == REDIS_ENCODING_ZIPLIST)
-            return rdbSaveType(rdb,REDIS_RDB_TYPE_HASH_ZIPLIST);
+        if (o->encoding == REDIS_ENCODING_LISTPACK)
+            return rdbSaveType(rdb,REDIS_RDB_TYPE_HASH_LISTPACK);
         else if (o->encoding == REDIS_ENCODING_HT)
             return rdbSaveType(rdb,REDIS_RDB_TYPE_HASH);
         else
@@ -731,27 +852,33 @@ int rdbSaveObject(rio *rdb, robj *o) {
     // б
     } else if (o->type == REDIS_LIST) {
         /* Save a list value */
-        if (o->encoding == REDIS_ENCODING_ZIPLIST) {
-            size_t l = ziplistBlobLen((unsigned char*)o->ptr);
+        if (o->encoding == REDIS_ENCODING_LISTPACK) {
+            size_t l = lpBytes((unsigned char*)o->ptr);
 
-            // ַʽ ZIPLIST б
+            // ַʽ LISTPACK б
             if ((n = rdbSaveRawString(rdb,o->ptr,l)) == -1) return -1;
             nwritten += n;
-        } else if (o->encoding == REDIS_ENCODING_LINKEDLIST) {
-            list *list = o->ptr;
-            listIter li;
-            listNode *ln;
+        } else if (o->encoding == REDIS_ENCODING_QUICKLIST) {
+            quicklist *ql = o->ptr;
+            quicklistNode *node = ql->head;
 
-            if ((n = rdbSaveLen(rdb,listLength(list))) == -1) return -1;
+            // ȱڵ
+            if ((n = rdbSaveLen(rdb,ql->len)) == -1) return -1;
             nwritten += n;
 
-            // б
-            listRewind(list,&li);
-            while((ln = listNext(&li))) {
-                robj *eleobj = listNodeValue(ln);
-                // ַʽб
-                if ((n = rdbSaveStringObject(rdb,eleobj)) == -1) return -1;
-                nwritten += n;
+            // Ȼַʽÿڵ listpack 
+            // ѹĽڵֱӱѹݣҪѹ
+            while(node) {
+                if (quicklistNodeIsCompressed(node)) {
+                    void *data;
+                    size_t compress_len = quicklistGetLzf(node, &data);
+                    if ((n = rdbSaveLzfBlob(rdb,data,compress_len,node->sz)) == -1) return -1;
+                    nwritten += n;
+                } else {
+                    if ((n = rdbSaveRawString(rdb,node->lp,node->sz)) == -1) return -1;
+                    nwritten += n;
+                }
+                node = node->next;
             }
         } else {
             redisPanic("Unknown list encoding");
@@ -789,13 +916,14 @@ int rdbSaveObject(rio *rdb, robj *o) {
     // 򼯶
     } else if (o->type == REDIS_ZSET) {
         /* Save a sorted set value */
-        if (o->encoding == REDIS_ENCODING_ZIPLIST) {
-            size_t l = ziplistBlobLen((unsigned char*)o->ptr);
+        if (o->encoding == REDIS_ENCODING_LISTPACK) {
+            size_t l = lpBytes((unsigned char*)o->ptr);
 
-            // ַʽ ZIPLIST 
+            // ַʽ LISTPACK 
             if ((n = rdbSaveRawString(rdb,o->ptr,l)) == -1) return -1;
             nwritten += n;
-        } else if (o->encoding == REDIS_ENCODING_SKIPLIST) {
+        } else if (o->encoding == REDIS_ENCODING_SKIPLIST ||
+                   o->encoding == REDIS_ENCODING_BTREE) {
             zset *zs = o->ptr;
             dictIterator *di = dictGetIterator(zs->dict);
             dictEntry *de;
@@ -806,7 +934,7 @@ int rdbSaveObject(rio *rdb, robj *o) {
             // 
             while((de = dictNext(di)) != NULL) {
                 robj *eleobj = dictGetKey(de);
-                double *score = dictGetVal(de);
+                double score = dictGetDoubleVal(de);
 
                 // ַʽ漯ϳԱ
                 if ((n = rdbSaveStringObject(rdb,eleobj)) == -1) return -1;
@@ -814,7 +942,7 @@ int rdbSaveObject(rio *rdb, robj *o) {
 
                 // Աֵһ˫ȸᱻתַ
                 // Ȼ󱣴浽 rdb 
-                if ((n = rdbSaveDoubleValue(rdb,*score)) == -1) return -1;
+                if ((n = rdbSaveDoubleValue(rdb,score)) == -1) return -1;
                 nwritten += n;
             }
             dictReleaseIterator(di);
@@ -826,10 +954,10 @@ int rdbSaveObject(rio *rdb, robj *o) {
     } else if (o->type == REDIS_HASH) {
 
         /* Save a hash value */
-        if (o->encoding == REDIS_ENCODING_ZIPLIST) {
-            size_t l = ziplistBlobLen((unsigned char*)o->ptr);
+        if (o->encoding == REDIS_ENCODING_LISTPACK) {
+            size_t l = lpBytes((unsigned char*)o->ptr);
 
-            // ַʽ ZIPLIST ϣ
+            // ַʽ LISTPACK ϣ
             if ((n = rdbSaveRawString(rdb,o->ptr,l)) == -1) return -1;
             nwritten += n;
 
@@ -917,6 +1045,230 @@ int rdbSaveKeyValuePair(rio *rdb, robj *key, robj *val,
     return 1;
 }
 
+/* Block SIGALRM so we are sure that only the main thread will receive the
+ * watchdog signal. Called by the threads saving and loading RDB files. */
+static void rdbThreadInit(void) {
+    sigset_t sigset;
+
+    sigemptyset(&sigset);
+    sigaddset(&sigset, SIGALRM);
+    if (pthread_sigmask(SIG_BLOCK, &sigset, NULL))
+        redisLog(REDIS_WARNING,
+            "Warning: can't mask SIGALRM in RDB thread: %s",
+            strerror(errno));
+}
+
+/* ----------------------------- Sectioned saving ----------------------------
+ *
+ * When rdb-save-threads is greater than zero rdbSave() splits the databases
+ * in 'rdb-save-threads' sections, every one written by its own thread into
+ * a temporary file: section N contains the N-th slice of the keys of every
+ * database, each slice preceded by a SELECTDB opcode. The file is then
+ * composed this way:
+ *
+ *   REDIS0009 SECTIONS <count> <len,crc64> * count <section> * count EOF <crc64>
+ *
+ * The index lets a loader read the sections in parallel, checking every
+ * one with its own checksum, while a loader that reads the file serially
+ * just skips the index: the sections are a plain sequence of SELECTDB,
+ * EXPIRETIME and key value pairs. The final checksum still covers the
+ * whole file, it is computed combining the checksums of the sections
+ * instead of reading them again.
+ *
+ * While the threads run the rehashing of the databases is paused, so that
+ * looking up the expires does not modify the tables.
+ *
+ *  rdb-save-threads  0 ʱ rdbSave() ݿΪ rdb-save-threads
+ * ֶΣÿֶһ߳дһʱļ
+ *  N ֶΰÿݿĵ N ּÿ֮ǰһ SELECTDB 
+ * ļĸʽΪ
+ *
+ *   REDIS0009 SECTIONS <> <,crc64> *  <ֶ> *  EOF <crc64>
+ *
+ * ԸжֶΣֱÿֶεУͣ
+ * жʱֱɣΪֶֻͨ SELECTDB 
+ * EXPIRETIME ͼֵС
+ * ļУȻļɸֶεУͺϲõ
+ * ҪٴζȡֶΡ
+ *
+ * ߳ڼݿ rehash ᱻͣҹʱʱ޸Ĺϣ
+ */
+
+/* lzf_compress() keeps its hash table on the stack. */
+#define RDB_SAVE_THREAD_STACK_SIZE (1024*1024*4)
+
+typedef struct rdbSaveSection {
+    pthread_t thread;
+    int id, count;          /* This is section 'id' of 'count'. */
+    long long now;          /* Keys expired before this are not saved. */
+    char tmpfile[256];
+    uint64_t len;           /* Bytes of the section. */
+    uint64_t cksum;         /* Checksum of the section, 0 if disabled. */
+    int err;                /* errno of the failure, or 0. */
+} rdbSaveSection;
+
+/* Thread writing a section into its temporary file.
+ *
+ * һֶдʱļ߳ */
+static void *rdbSaveSectionMain(void *arg) {
+    rdbSaveSection *sec = arg;
+    dictIterator *di = NULL;
+    dictEntry *de;
+    FILE *fp;
+    rio rdb;
+    int j;
+
+    rdbThreadInit();
+    if ((fp = fopen(sec->tmpfile,"w")) == NULL) {
+        sec->err = errno;
+        return NULL;
+    }
+    rioInitWithFile(&rdb,fp);
+    if (server.rdb_checksum)
+        rdb.update_cksum = rioGenericUpdateChecksum;
+
+    for (j = 0; j < server.dbnum; j++) {
+        redisDb *db = server.db+j;
+        unsigned long size = dictSize(db->dict), pos = 0;
+        unsigned long first = size*sec->id/sec->count;
+        unsigned long last = size*(sec->id+1)/sec->count;
+
+        if (first == last) continue;
+        if (rdbSaveType(&rdb,REDIS_RDB_OPCODE_SELECTDB) == -1) goto werr;
+        if (rdbSaveLen(&rdb,j) == -1) goto werr;
+
+        /* The iterator is not safe, nothing modifies the tables. */
+        di = dictGetIterator(db->dict);
+        while(pos < last && (de = dictNext(di)) != NULL) {
+            sds keystr = dictGetKey(de);
+            robj key, *o = dictGetVal(de);
+
+            if (pos++ < first) continue;
+            initStaticStringObject(key,keystr);
+            if (rdbSaveKeyValuePair(&rdb,&key,o,getExpire(db,&key),
+                                    sec->now) == -1) goto werr;
+        }
+        dictReleaseIterator(di);
+        di = NULL;
+    }
+    if (fflush(fp) == EOF) goto werr;
+    if (fclose(fp) == EOF) {
+        sec->err = errno ? errno : EIO;
+        return NULL;
+    }
+    sec->len = rdb.processed_bytes;
+    sec->cksum = rdb.cksum;
+    return NULL;
+
+werr:
+    sec->err = errno ? errno : EIO;
+    if (di) dictReleaseIterator(di);
+    fclose(fp);
+    return NULL;
+}
+
+/* Copy the temporary file of a section at the end of 'rdb'. The checksum
+ * of 'rdb' is not updated, see rdbSaveSections(). */
+static int rdbCopySection(rio *rdb, rdbSaveSection *sec) {
+    void (*update_cksum)(struct _rio *, const void *, size_t);
+    char buf[64*1024];
+    uint64_t left = sec->len;
+    size_t nread;
+    FILE *fp;
+
+    if ((fp = fopen(sec->tmpfile,"r")) == NULL) return -1;
+    update_cksum = rdb->update_cksum;
+    rdb->update_cksum = NULL;
+    while (left) {
+        nread = fread(buf,1,left < sizeof(buf) ? left : sizeof(buf),fp);
+        if (nread == 0 || rdbWriteRaw(rdb,buf,nread) == -1) break;
+        left -= nread;
+    }
+    rdb->update_cksum = update_cksum;
+    if (left && !errno) errno = EIO;
+    fclose(fp);
+    return left ? -1 : 0;
+}
+
+/* Save every database in server.rdb_save_threads sections written in
+ * parallel, after the header already written in 'rdb'. Returns -1 on
+ * error, with errno set.
+ *
+ * ʹ server.rdb_save_threads ̲߳бݿ⣬
+ * ļͷѾд rdb Сʱ -1  errno  */
+static int rdbSaveSections(rio *rdb, long long now) {
+    int count = server.rdb_save_threads, j, err = 0;
+    rdbSaveSection *secs = zcalloc(sizeof(rdbSaveSection)*count);
+    pthread_attr_t attr;
+    size_t stacksize;
+
+    for (j = 0; j < server.dbnum; j++) {
+        dictPauseRehashing(server.db[j].dict);
+        dictPauseRehashing(server.db[j].expires);
+    }
+    pthread_attr_init(&attr);
+    pthread_attr_getstacksize(&attr,&stacksize);
+    if (!stacksize) stacksize = 1; /* The world is full of Solaris Fixes */
+    while (stacksize < RDB_SAVE_THREAD_STACK_SIZE) stacksize *= 2;
+    pthread_attr_setstacksize(&attr, stacksize);
+
+    for (j = 0; j < count; j++) {
+        rdbSaveSection *sec = secs+j;
+
+        sec->id = j;
+        sec->count = count;
+        sec->now = now;
+        snprintf(sec->tmpfile,sizeof(sec->tmpfile),"temp-%d-%d.rdb",
+            (int) getpid(), j);
+        if (pthread_create(&sec->thread,&attr,rdbSaveSectionMain,sec) != 0)
+        {
+            /* Write it in this thread. */
+            rdbSaveSectionMain(sec);
+            sec->thread = pthread_self();
+        }
+    }
+    for (j = 0; j < count; j++) {
+        if (!pthread_equal(secs[j].thread,pthread_self()))
+            pthread_join(secs[j].thread,NULL);
+        if (secs[j].err && !err) err = secs[j].err;
+    }
+    pthread_attr_destroy(&attr);
+    for (j = 0; j < server.dbnum; j++) {
+        dictResumeRehashing(server.db[j].dict);
+        dictResumeRehashing(server.db[j].expires);
+    }
+    if (err) goto werr;
+
+    /* Write the index, then the sections. */
+    if (rdbSaveType(rdb,REDIS_RDB_OPCODE_SECTIONS) == -1) goto werr;
+    if (rdbSaveLen(rdb,count) == -1) goto werr;
+    for (j = 0; j < count; j++) {
+        uint64_t entry[2];
+
+        entry[0] = secs[j].len;
+        entry[1] = secs[j].cksum;
+        memrev64ifbe(entry);
+        memrev64ifbe(entry+1);
+        if (rdbWriteRaw(rdb,entry,sizeof(entry)) == -1) goto werr;
+    }
+    for (j = 0; j < count; j++) {
+        if (rdbCopySection(rdb,secs+j) == -1) goto werr;
+        if (server.rdb_checksum)
+            rdb->cksum = crc64_combine(rdb->cksum,secs[j].cksum,secs[j].len);
+    }
+
+    for (j = 0; j < count; j++) unlink(secs[j].tmpfile);
+    zfree(secs);
+    return 0;
+
+werr:
+    err = errno;
+    for (j = 0; j < count; j++) unlink(secs[j].tmpfile);
+    zfree(secs);
+    errno = err;
+    return -1;
+}
+
 /* Save the DB on disk. Return REDIS_ERR on error, REDIS_OK on success 
  *
  * ݿⱣ浽ϡ
@@ -931,7 +1283,7 @@ int rdbSave(char *filename) { //loadDataFromDisk
     dictEntry *de;
     char tmpfile[256];
     char magic[10];
-    int j;
+    int j, sections = server.rdb_save_threads > 0;
     long long now = mstime();
     FILE *fp;
     rio rdb;
@@ -957,8 +1309,12 @@ int rdbSave(char *filename) { //loadDataFromDisk
     snprintf(magic,sizeof(magic),"REDIS%04d",REDIS_RDB_VERSION);
     if (rdbWriteRaw(&rdb,magic,9) == -1) goto werr; //REDIS0006 9ֽдݿrdb
 
+    /* Save the databases in sections written by multiple threads if
+     * configured to do so, instead of the loop below. */
+    if (sections && rdbSaveSections(&rdb,now) == -1) goto werr;
+
     // ݿ
-    for (j = 0; j < server.dbnum; j++) {
+    for (j = 0; !sections && j < server.dbnum; j++) {
 
         // ָݿ
         redisDb *db = server.db+j;
@@ -1181,8 +1537,38 @@ COW
 void rdbRemoveTempFile(pid_t childpid) {
     char tmpfile[256];
 
+    int j;
+
     snprintf(tmpfile,256,"temp-%d.rdb", (int) childpid);
     unlink(tmpfile);
+
+    /* Sections of a child saving with rdb-save-threads. */
+    for (j = 0; j < REDIS_RDB_SAVE_THREADS_MAX; j++) {
+        snprintf(tmpfile,256,"temp-%d-%d.rdb", (int) childpid, j);
+        unlink(tmpfile);
+    }
+}
+
+/* Return a new listpack with the entries of the ziplist 'zl'.
+ *
+ * һ ziplist zl нڵ listpack  */
+static unsigned char *rdbZiplistToListpack(unsigned char *zl) {
+    unsigned char *lp = lpNew();
+    unsigned char *p = ziplistIndex(zl,0), *vstr;
+    unsigned int vlen;
+    long long vll;
+    char buf[32];
+
+    while (ziplistGet(p,&vstr,&vlen,&vll)) {
+        if (vstr) {
+            lp = lpPush(lp,vstr,vlen,LISTPACK_TAIL);
+        } else {
+            vlen = ll2string(buf,sizeof(buf),vll);
+            lp = lpPush(lp,(unsigned char*)buf,vlen,LISTPACK_TAIL);
+        }
+        p = ziplistNext(zl,p);
+    }
+    return lp;
 }
 
 /* Load a Redis object of the specified type from the specified file.
@@ -1213,14 +1599,14 @@ robj *rdbLoadObject(int rdbtype, rio *rdb) {
          */
         if ((len = rdbLoadLen(rdb,NULL)) == REDIS_RDB_LENERR) return NULL;
 
-        /* Use a real list when there are too many entries 
+        /* Use a quicklist when there are too many entries 
          *
          * ݽڵı
          */
         if (len > server.list_max_ziplist_entries) {
-            o = createListObject();
+            o = createQuicklistObject();
         } else {
-            o = createZiplistObject();
+            o = createListpackObject();
         }
 
         /* Load every single element of the list 
@@ -1232,31 +1618,56 @@ robj *rdbLoadObject(int rdbtype, rio *rdb) {
             // ַ
             if ((ele = rdbLoadEncodedStringObject(rdb)) == NULL) return NULL;
 
-            /* If we are using a ziplist and the value is too big, convert
-             * the object to a real list. 
+            /* If we are using a listpack and the value is too big, convert
+             * the object to a quicklist. 
              *
              * ַ
-             * ǷҪб ZIPLIST תΪ LINKEDLIST 
+             * ǷҪб LISTPACK תΪ QUICKLIST 
              */
-            if (o->encoding == REDIS_ENCODING_ZIPLIST &&
+            if (o->encoding == REDIS_ENCODING_LISTPACK &&
                 sdsEncodedObject(ele) &&
                 sdslen(ele->ptr) > server.list_max_ziplist_value)
-                    listTypeConvert(o,REDIS_ENCODING_LINKEDLIST);
+                    listTypeConvert(o,REDIS_ENCODING_QUICKLIST);
 
-            // ZIPLIST
-            if (o->encoding == REDIS_ENCODING_ZIPLIST) {
-                dec = getDecodedObject(ele);
+            dec = getDecodedObject(ele);
 
-                // ֵַ ZIPLIST ĩβؽб
-                o->ptr = ziplistPush(o->ptr,dec->ptr,sdslen(dec->ptr),REDIS_TAIL);
-
-                decrRefCount(dec);
-                decrRefCount(ele);
+            // LISTPACK
+            if (o->encoding == REDIS_ENCODING_LISTPACK) {
+                // ֵַ LISTPACK ĩβؽб
+                o->ptr = lpPush(o->ptr,dec->ptr,sdslen(dec->ptr),LISTPACK_TAIL);
             } else {
-                // б뵽ĩβ
-                ele = tryObjectEncoding(ele);
-                listAddNodeTail(o->ptr,ele);
+                // б뵽 quicklist ĩβ
+                quicklistPushTail(o->ptr,dec->ptr,sdslen(dec->ptr));
             }
+
+            decrRefCount(dec);
+            decrRefCount(ele);
+        }
+
+    //  quicklist б
+    } else if (rdbtype == REDIS_RDB_TYPE_LIST_QUICKLIST) {
+
+        // ڵ
+        if ((len = rdbLoadLen(rdb,NULL)) == REDIS_RDB_LENERR) return NULL;
+
+        o = createQuicklistObject();
+
+        // ÿڵ㶼һַʽ listpack
+        while (len--) {
+            robj *aux = rdbLoadStringObject(rdb);
+            unsigned char *lp;
+
+            if (aux == NULL) return NULL;
+            lp = zmalloc(sdslen(aux->ptr));
+            memcpy(lp,aux->ptr,sdslen(aux->ptr));
+            decrRefCount(aux);
+
+            // յ listpack 浽 quicklist 
+            if (lpLength(lp) == 0) {
+                zfree(lp);
+                continue;
+            }
+            quicklistAppendListpack(o->ptr,lp);
         }
 
     // 뼯϶
@@ -1332,7 +1743,6 @@ robj *rdbLoadObject(int rdbtype, rio *rdb) {
         while(zsetlen--) {
             robj *ele;
             double score;
-            zskiplistNode *znode;
 
             // ԪسԱ
             if ((ele = rdbLoadEncodedStringObject(rdb)) == NULL) return NULL;
@@ -1346,22 +1756,19 @@ robj *rdbLoadObject(int rdbtype, rio *rdb) {
             if (sdsEncodedObject(ele) && sdslen(ele->ptr) > maxelelen)
                 maxelelen = sdslen(ele->ptr);
 
-            // Ԫز뵽Ծ
-            znode = zslInsert(zs->zsl,score,ele);
-            // Ԫعֵ
-            dictAdd(zs->dict,ele,&znode->score);
-
-            incrRefCount(ele); /* added to skiplist */
+            // Ԫز뵽ֵ
+            zsetInsert(zs,score,ele);
+            decrRefCount(ele);
         }
 
         /* Convert *after* loading, since sorted sets are not stored ordered. 
          *
-         * 򼯺ϷĻתΪ ZIPLIST 
+         * 򼯺ϷĻתΪ LISTPACK 
          * Լռ
          */
         if (zsetLength(o) <= server.zset_max_ziplist_entries &&
             maxelelen <= server.zset_max_ziplist_value)
-                zsetConvert(o,REDIS_ENCODING_ZIPLIST);
+                zsetConvert(o,REDIS_ENCODING_LISTPACK);
 
     // ϣ
     } else if (rdbtype == REDIS_RDB_TYPE_HASH) {
@@ -1376,16 +1783,16 @@ robj *rdbLoadObject(int rdbtype, rio *rdb) {
         o = createHashObject();
 
         /* Too many entries? Use a hash table.
-         * ݽڵѡʹ ZIPLIST 뻹 HT 
+         * ݽڵѡʹ LISTPACK 뻹 HT 
          */
         if (len > server.hash_max_ziplist_entries)
             hashTypeConvert(o, REDIS_ENCODING_HT);
 
-        /* Load every field and value into the ziplist 
+        /* Load every field and value into the listpack 
          *
-         * ֵ뵽 ZIPLIST 
+         * ֵ뵽 LISTPACK 
          */
-        while (o->encoding == REDIS_ENCODING_ZIPLIST && len > 0) {
+        while (o->encoding == REDIS_ENCODING_LISTPACK && len > 0) {
             robj *field, *value;
 
             len--;
@@ -1400,14 +1807,14 @@ robj *rdbLoadObject(int rdbtype, rio *rdb) {
             if (value == NULL) return NULL;
             redisAssert(sdsEncodedObject(value));
 
-            /* Add pair to ziplist 
+            /* Add pair to listpack 
              *
-             * ֵ뵽 ZIPLIST ĩβ
+             * ֵ뵽 LISTPACK ĩβ
              *
              * ֵ
              */
-            o->ptr = ziplistPush(o->ptr, field->ptr, sdslen(field->ptr), ZIPLIST_TAIL);
-            o->ptr = ziplistPush(o->ptr, value->ptr, sdslen(value->ptr), ZIPLIST_TAIL);
+            o->ptr = lpPush(o->ptr, field->ptr, sdslen(field->ptr), LISTPACK_TAIL);
+            o->ptr = lpPush(o->ptr, value->ptr, sdslen(value->ptr), LISTPACK_TAIL);
 
             /* Convert to hash table if size threshold is exceeded 
              *
@@ -1460,7 +1867,10 @@ robj *rdbLoadObject(int rdbtype, rio *rdb) {
                rdbtype == REDIS_RDB_TYPE_LIST_ZIPLIST ||
                rdbtype == REDIS_RDB_TYPE_SET_INTSET   ||
                rdbtype == REDIS_RDB_TYPE_ZSET_ZIPLIST ||
-               rdbtype == REDIS_RDB_TYPE_HASH_ZIPLIST)
+               rdbtype == REDIS_RDB_TYPE_HASH_ZIPLIST ||
+               rdbtype == REDIS_RDB_TYPE_LIST_LISTPACK ||
+               rdbtype == REDIS_RDB_TYPE_ZSET_LISTPACK ||
+               rdbtype == REDIS_RDB_TYPE_HASH_LISTPACK)
     {
         // ַ
         robj *aux = rdbLoadStringObject(rdb);
@@ -1472,6 +1882,19 @@ robj *rdbLoadObject(int rdbtype, rio *rdb) {
         memcpy(o->ptr,aux->ptr,sdslen(aux->ptr));
         decrRefCount(aux);
 
+        /* Ziplists saved by older versions are converted to listpacks,
+         * that are used in memory in their place. */
+        // ɰ汾 ZIPLIST תΪ LISTPACK
+        if (rdbtype == REDIS_RDB_TYPE_LIST_ZIPLIST ||
+            rdbtype == REDIS_RDB_TYPE_ZSET_ZIPLIST ||
+            rdbtype == REDIS_RDB_TYPE_HASH_ZIPLIST)
+        {
+            unsigned char *lp = rdbZiplistToListpack(o->ptr);
+
+            zfree(o->ptr);
+            o->ptr = lp;
+        }
+
         /* Fix the object encoding, and make sure to convert the encoded
          * data type into the base type if accordingly to the current
          * configuration there are too many elements in the encoded data
@@ -1488,25 +1911,25 @@ robj *rdbLoadObject(int rdbtype, rio *rdb) {
 
             // ZIPMAP Ĺϣ
             case REDIS_RDB_TYPE_HASH_ZIPMAP:
-                /* Convert to ziplist encoded hash. This must be deprecated
+                /* Convert to listpack encoded hash. This must be deprecated
                  * when loading dumps created by Redis 2.4 gets deprecated. */
                 {
-                    //  ZIPLIST
-                    unsigned char *zl = ziplistNew();
+                    //  LISTPACK
+                    unsigned char *zl = lpNew();
                     unsigned char *zi = zipmapRewind(o->ptr);
                     unsigned char *fstr, *vstr;
                     unsigned int flen, vlen;
                     unsigned int maxlen = 0;
 
                     //  2.6 ʼ HASH ʹ ZIPMAP б
-                    //  ZIPMAP ֵʱҪתΪ ZIPLIST
+                    //  ZIPMAP ֵʱҪתΪ LISTPACK
 
-                    // ַȡ ZIPMAP ֵȻ뵽 ZIPLIST 
+                    // ַȡ ZIPMAP ֵȻ뵽 LISTPACK 
                     while ((zi = zipmapNext(zi, &fstr, &flen, &vstr, &vlen)) != NULL) {
                         if (flen > maxlen) maxlen = flen;
                         if (vlen > maxlen) maxlen = vlen;
-                        zl = ziplistPush(zl, fstr, flen, ZIPLIST_TAIL);
-                        zl = ziplistPush(zl, vstr, vlen, ZIPLIST_TAIL);
+                        zl = lpPush(zl, fstr, flen, LISTPACK_TAIL);
+                        zl = lpPush(zl, vstr, vlen, LISTPACK_TAIL);
                     }
 
                     zfree(o->ptr);
@@ -1514,9 +1937,9 @@ robj *rdbLoadObject(int rdbtype, rio *rdb) {
                     // ֵָ͡
                     o->ptr = zl;
                     o->type = REDIS_HASH;
-                    o->encoding = REDIS_ENCODING_ZIPLIST;
+                    o->encoding = REDIS_ENCODING_LISTPACK;
 
-                    // ǷҪ ZIPLIST תΪ HT 
+                    // ǷҪ LISTPACK תΪ HT 
                     if (hashTypeLength(o) > server.hash_max_ziplist_entries ||
                         maxlen > server.hash_max_ziplist_value)
                     {
@@ -1525,15 +1948,16 @@ robj *rdbLoadObject(int rdbtype, rio *rdb) {
                 }
                 break;
 
-            // ZIPLIST б
+            // ZIPLIST  LISTPACK б
             case REDIS_RDB_TYPE_LIST_ZIPLIST:
+            case REDIS_RDB_TYPE_LIST_LISTPACK:
 
                 o->type = REDIS_LIST;
-                o->encoding = REDIS_ENCODING_ZIPLIST;
+                o->encoding = REDIS_ENCODING_LISTPACK;
 
                 // ǷҪת
-                if (ziplistLen(o->ptr) > server.list_max_ziplist_entries)
-                    listTypeConvert(o,REDIS_ENCODING_LINKEDLIST);
+                if (lpLength(o->ptr) > server.list_max_ziplist_entries)
+                    listTypeConvert(o,REDIS_ENCODING_QUICKLIST);
                 break;
 
             // INTSET ļ
@@ -1547,22 +1971,24 @@ robj *rdbLoadObject(int rdbtype, rio *rdb) {
                     setTypeConvert(o,REDIS_ENCODING_HT);
                 break;
 
-            // ZIPLIST 򼯺
+            // ZIPLIST  LISTPACK 򼯺
             case REDIS_RDB_TYPE_ZSET_ZIPLIST:
+            case REDIS_RDB_TYPE_ZSET_LISTPACK:
 
                 o->type = REDIS_ZSET;
-                o->encoding = REDIS_ENCODING_ZIPLIST;
+                o->encoding = REDIS_ENCODING_LISTPACK;
 
                 // ǷҪת
                 if (zsetLength(o) > server.zset_max_ziplist_entries)
-                    zsetConvert(o,REDIS_ENCODING_SKIPLIST);
+                    zsetConvert(o,zsetLargeEncoding());
                 break;
 
-            // ZIPLIST  HASH
+            // ZIPLIST  LISTPACK  HASH
             case REDIS_RDB_TYPE_HASH_ZIPLIST:
+            case REDIS_RDB_TYPE_HASH_LISTPACK:
 
                 o->type = REDIS_HASH;
-                o->encoding = REDIS_ENCODING_ZIPLIST;
+                o->encoding = REDIS_ENCODING_LISTPACK;
 
                 // ǷҪת
                 if (hashTypeLength(o) > server.hash_max_ziplist_entries)
@@ -1622,6 +2048,21 @@ void stopLoading(void) {
     server.loading = 0;
 }
 
+/* Handle events while loading, 'pos' being the bytes of the file loaded
+ * so far.
+ *
+ * ڼ䴦¼ pos ΪĿǰѾļֽ */
+static void rdbLoadProcessEvents(off_t pos) {
+    /* The DB can take some non trivial amount of time to load. Update
+     * our cached time since it is used to create and update the last
+     * interaction time with clients and for other important things. */
+    updateCachedTime();
+    if (server.masterhost && server.repl_state == REDIS_REPL_TRANSFER)
+        replicationSendNewlineToMaster();
+    loadingProgress(pos);
+    processEventsWhileBlocked(); //עڼRDBʱ򣬻ǿԴ¼ͷʱ
+}
+
 /* Track loading progress in order to serve client's from time to time
    and if needed calculate rdb checksum  */
 // ¼ϢԱÿͻ˽вѯ
@@ -1632,15 +2073,652 @@ void rdbLoadProgressCallback(rio *r, const void *buf, size_t len) { //rdbLoadPro
     if (server.loading_process_events_interval_bytes &&
         (r->processed_bytes + len)/server.loading_process_events_interval_bytes > r->processed_bytes/server.loading_process_events_interval_bytes)
     {
-        /* The DB can take some non trivial amount of time to load. Update
-         * our cached time since it is used to create and update the last
-         * interaction time with clients and for other important things. */
-        updateCachedTime();
-        if (server.masterhost && server.repl_state == REDIS_REPL_TRANSFER)
-            replicationSendNewlineToMaster();
-        loadingProgress(r->processed_bytes);
-        processEventsWhileBlocked(); //עڼRDBʱ򣬻ǿԴ¼ͷʱ
+        rdbLoadProcessEvents(r->processed_bytes);
+    }
+}
+
+/* ---------------------------- Threaded loading ----------------------------
+ *
+ * When rdb-load-threads is greater than zero rdbLoad() uses a pipeline:
+ *
+ * 1) A reader thread reads the file, computes the checksum, and splits it
+ *    into batches of records. It doesn't create any object: the raw bytes
+ *    of the key and the value of every record are just copied into the
+ *    batch, and the value is skipped using the lengths in the file, so LZF
+ *    compressed strings are not decompressed here. Keys already expired
+ *    are dropped by the reader.
+ * 2) 'rdb-load-threads' worker threads take the batches and decode them
+ *    with rdbLoadStringObject() / rdbLoadObject(), exactly like the serial
+ *    loading does, doing the decompression, the ziplist conversions and
+ *    the construction of the values.
+ * 3) The main thread only adds the decoded keys to the databases, batch
+ *    after batch in file order, and handles events while it waits.
+ *
+ * The objects created by the workers may reference the shared integers,
+ * that are never released, see makeObjectShared().
+ *
+ * A file saved in sections (see rdbSaveSections()) is read by one reader
+ * per section, every one with its own FILE, and the main thread adds the
+ * batches in the order they are read, since a key is only in one section.
+ * The checksum of every section is verified by its reader, and the main
+ * thread combines them to verify the checksum of the whole file.
+ *
+ *  rdb-load-threads  0 ʱ rdbLoad() ʹˮ߽룺
+ *
+ * 1) ̶߳ļУͣļзΪһ¼
+ *    ̲߳κζֻÿ¼ļֵԭʼֽڸƵУ
+ *    ֵļеĳϢ LZF ѹַѹ
+ *    Ѿڵļɶֱ߳Ӷ
+ * 2) rdb-load-threads ߳ȡΣ
+ *    һʹ rdbLoadStringObject()  rdbLoadObject() н룬
+ *    ѹ ziplist תԼֵĴЩ߳ɡ
+ * 3) ̰߳ļе˳ļӵݿУ
+ *    ڵȴڼ䴦¼
+ *
+ * ̴߳Ķù󣬹Զᱻͷţ
+ * μ makeObjectShared() 
+ *
+ * ֶαļμ rdbSaveSections() ÿֶһĶ̶߳룬
+ * ÿ߳ʹԼ FILE һֻһֶУ
+ * ̰߳ζȺ˳ǡ
+ * ÿֶεУĶ̼߳飬
+ * ߳ϲЩУͣļУ͡
+ */
+
+#define RDB_LOAD_BATCH_BYTES (1024*1024)  /* Max raw bytes of a batch. */
+#define RDB_LOAD_BATCH_KEYS 1024          /* Max records of a batch. */
+
+/* Batch states. */
+#define RDB_LOAD_BATCH_READ 0      /* Read, waiting for a worker. */
+#define RDB_LOAD_BATCH_DECODING 1  /* A worker is decoding it. */
+#define RDB_LOAD_BATCH_DECODED 2   /* Ready to be added to the databases. */
+
+typedef struct rdbLoadRecord {
+    int type;               /* RDB type of the value. */
+    int dbid;               /* Database of the key. */
+    long long expiretime;   /* Expire time in milliseconds, or -1. */
+    robj *key, *val;        /* Decoded by the workers. */
+} rdbLoadRecord;
+
+typedef struct rdbLoadBatch {
+    sds buf;                /* Raw key and value of every record. */
+    rdbLoadRecord *records;
+    int count;              /* Number of records. */
+    int state;              /* RDB_LOAD_BATCH_* */
+    int err;                /* Short read, or the records failed to decode. */
+    int last;               /* Last batch of its reader. */
+    off_t processed;        /* Bytes of the file read for this batch. */
+} rdbLoadBatch;
+
+typedef struct rdbLoadReader {
+    rio rdb;                /* Must be the first field, see rdbSkipBytes(). */
+    int section;            /* Reads a section instead of up to EOF. */
+    off_t offset;           /* Offset of the section in the file. */
+    uint64_t len;           /* Length of the section. */
+    uint64_t expected;      /* Checksum of the section in the index. */
+    int type;               /* Opcode already read, or -1. */
+    sds *capture;           /* Where the reader copies the bytes read. */
+    off_t queued;           /* Bytes read up to the last batch queued. */
+    int baddb;              /* Database number out of range, or -1. */
+    int cksum;              /* See RDB_LOAD_CKSUM_*. */
+    pthread_t thread;
+} rdbLoadReader;
+
+static struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    list *batches;          /* Batches not yet added, in file order. */
+    int maxbatches;         /* Max batches the readers can queue. */
+    int stop;               /* Asks the workers to exit. */
+    char *filename;         /* Opened again by the readers of sections. */
+    int rdbver;
+    long long now;          /* Keys expired before this are dropped. */
+} rdbLoader;
+
+#define RDB_LOAD_CKSUM_OK 0
+#define RDB_LOAD_CKSUM_NONE 1      /* Saved with checksum disabled. */
+#define RDB_LOAD_CKSUM_WRONG 2
+
+static rdbLoadBatch *rdbLoadBatchCreate(void) {
+    rdbLoadBatch *batch = zmalloc(sizeof(*batch));
+
+    batch->buf = sdsempty();
+    batch->records = zmalloc(sizeof(rdbLoadRecord)*RDB_LOAD_BATCH_KEYS);
+    batch->count = 0;
+    batch->state = RDB_LOAD_BATCH_READ;
+    batch->err = 0;
+    batch->last = 0;
+    batch->processed = 0;
+    return batch;
+}
+
+static void rdbLoadBatchFree(rdbLoadBatch *batch) {
+    sdsfree(batch->buf);
+    zfree(batch->records);
+    zfree(batch);
+}
+
+/* rio callback of the readers: update the checksum and copy what was read
+ * into the current batch, if any. */
+static void rdbLoadReaderCallback(rio *r, const void *buf, size_t len) {
+    rdbLoadReader *reader = (rdbLoadReader*)r;
+
+    if (server.rdb_checksum)
+        rioGenericUpdateChecksum(r, buf, len);
+    if (reader->capture)
+        *reader->capture = sdscatlen(*reader->capture,buf,len);
+}
+
+/* Read and discard 'len' bytes. Returns 0 on short read. The bytes are
+ * read straight into the batch being captured, if any. 'rdb' is always
+ * the rio of a reader. */
+static int rdbSkipBytes(rio *rdb, size_t len) {
+    rdbLoadReader *reader = (rdbLoadReader*)rdb;
+    char buf[16*1024];
+    sds *capture = reader->capture;
+
+    if (capture) {
+        int ok;
+
+        *capture = sdsMakeRoomFor(*capture,len);
+        reader->capture = NULL;
+        ok = rioRead(rdb,*capture+sdslen(*capture),len);
+        reader->capture = capture;
+        if (ok) sdsIncrLen(*capture,len);
+        return ok;
+    }
+    while (len) {
+        size_t chunk = len < sizeof(buf) ? len : sizeof(buf);
+
+        if (rioRead(rdb,buf,chunk) == 0) return 0;
+        len -= chunk;
+    }
+    return 1;
+}
+
+/* Skip a string saved by rdbSaveRawString() without decoding it.
+ *
+ * һַн */
+static int rdbSkipStringObject(rio *rdb) {
+    int isencoded;
+    uint32_t len, clen;
+
+    len = rdbLoadLen(rdb,&isencoded);
+    if (isencoded) {
+        switch(len) {
+        case REDIS_RDB_ENC_INT8: return rdbSkipBytes(rdb,1);
+        case REDIS_RDB_ENC_INT16: return rdbSkipBytes(rdb,2);
+        case REDIS_RDB_ENC_INT32: return rdbSkipBytes(rdb,4);
+        case REDIS_RDB_ENC_LZF:
+        case REDIS_RDB_ENC_LZ4:
+        case REDIS_RDB_ENC_ZSTD:
+            if ((clen = rdbLoadLen(rdb,NULL)) == REDIS_RDB_LENERR) return 0;
+            if (rdbLoadLen(rdb,NULL) == REDIS_RDB_LENERR) return 0;
+            return rdbSkipBytes(rdb,clen);
+        default:
+            redisPanic("Unknown RDB encoding type");
+        }
+    }
+    if (len == REDIS_RDB_LENERR) return 0;
+    return rdbSkipBytes(rdb,len);
+}
+
+/* Skip an object of the specified type, see rdbLoadObject().
+ * Returns 0 on short read.
+ *
+ * һָ͵Ķ󣬶ʧʱ 0 */
+static int rdbSkipObject(int rdbtype, rio *rdb) {
+    uint32_t len;
+    double score;
+
+    if (rdbtype == REDIS_RDB_TYPE_STRING) {
+        return rdbSkipStringObject(rdb);
+    } else if (rdbtype == REDIS_RDB_TYPE_LIST ||
+               rdbtype == REDIS_RDB_TYPE_LIST_QUICKLIST ||
+               rdbtype == REDIS_RDB_TYPE_SET ||
+               rdbtype == REDIS_RDB_TYPE_ZSET ||
+               rdbtype == REDIS_RDB_TYPE_HASH)
+    {
+        if ((len = rdbLoadLen(rdb,NULL)) == REDIS_RDB_LENERR) return 0;
+        while(len--) {
+            if (rdbSkipStringObject(rdb) == 0) return 0;
+            if (rdbtype == REDIS_RDB_TYPE_ZSET &&
+                rdbLoadDoubleValue(rdb,&score) == -1) return 0;
+            if (rdbtype == REDIS_RDB_TYPE_HASH &&
+                rdbSkipStringObject(rdb) == 0) return 0;
+        }
+        return 1;
+    } else if (rdbtype == REDIS_RDB_TYPE_HASH_ZIPMAP  ||
+               rdbtype == REDIS_RDB_TYPE_LIST_ZIPLIST ||
+               rdbtype == REDIS_RDB_TYPE_SET_INTSET   ||
+               rdbtype == REDIS_RDB_TYPE_ZSET_ZIPLIST ||
+               rdbtype == REDIS_RDB_TYPE_HASH_ZIPLIST ||
+               rdbtype == REDIS_RDB_TYPE_LIST_LISTPACK ||
+               rdbtype == REDIS_RDB_TYPE_ZSET_LISTPACK ||
+               rdbtype == REDIS_RDB_TYPE_HASH_LISTPACK)
+    {
+        return rdbSkipStringObject(rdb);
+    } else {
+        redisPanic("Unknown object type");
+    }
+    return 0; /* Just to avoid warning */
+}
+
+/* Queue a batch read by a reader, waiting if too many batches are queued
+ * already. Returns 0, releasing the batch, if the load was stopped because
+ * of an error. */
+static int rdbLoadQueueBatch(rdbLoadReader *reader, rdbLoadBatch *batch) {
+    batch->processed = reader->rdb.processed_bytes-reader->queued;
+    reader->queued = reader->rdb.processed_bytes;
+    pthread_mutex_lock(&rdbLoader.mutex);
+    while (!rdbLoader.stop &&
+           listLength(rdbLoader.batches) >= (unsigned)rdbLoader.maxbatches)
+        pthread_cond_wait(&rdbLoader.cond,&rdbLoader.mutex);
+    if (rdbLoader.stop) {
+        pthread_mutex_unlock(&rdbLoader.mutex);
+        rdbLoadBatchFree(batch);
+        return 0;
+    }
+    listAddNodeTail(rdbLoader.batches,batch);
+    pthread_cond_broadcast(&rdbLoader.cond);
+    pthread_mutex_unlock(&rdbLoader.mutex);
+    return 1;
+}
+
+/* Reader thread: split the file, or a section of it, into batches of raw
+ * records.
+ *
+ * ̣߳ļļһֶзΪһδļ¼ */
+static void *rdbLoadReaderMain(void *arg) {
+    rdbLoadReader *reader = arg;
+    rio *rdb = &reader->rdb;
+    rdbLoadBatch *batch = rdbLoadBatchCreate();
+    FILE *fp = NULL;
+    int type;
+    uint32_t dbid = 0;
+    long long expiretime;
+    size_t start;
+
+    rdbThreadInit();
+    if (reader->section) {
+        if ((fp = fopen(rdbLoader.filename,"r")) == NULL ||
+            fseeko(fp,reader->offset,SEEK_SET) == -1) goto eoferr;
+        rioInitWithFile(rdb,fp);
+        rdb->update_cksum = rdbLoadReaderCallback;
+        reader->queued = 0;
+    }
+    while(1) {
+        expiretime = -1;
+
+        /* Same opcodes handling of rdbLoad(). */
+        if (reader->section && rdb->processed_bytes >= reader->len) break;
+        if (reader->type != -1) {
+            type = reader->type;
+            reader->type = -1;
+        } else if ((type = rdbLoadType(rdb)) == -1) {
+            goto eoferr;
+        }
+        if (type == REDIS_RDB_OPCODE_EXPIRETIME) {
+            if ((expiretime = rdbLoadTime(rdb)) == -1) goto eoferr;
+            if ((type = rdbLoadType(rdb)) == -1) goto eoferr;
+            expiretime *= 1000;
+        } else if (type == REDIS_RDB_OPCODE_EXPIRETIME_MS) {
+            if ((expiretime = rdbLoadMillisecondTime(rdb)) == -1) goto eoferr;
+            if ((type = rdbLoadType(rdb)) == -1) goto eoferr;
+        }
+        if (type == REDIS_RDB_OPCODE_EOF) {
+            if (reader->section) goto eoferr;
+            break;
+        }
+        if (type == REDIS_RDB_OPCODE_SELECTDB) {
+            if ((dbid = rdbLoadLen(rdb,NULL)) == REDIS_RDB_LENERR)
+                goto eoferr;
+            if (dbid >= (unsigned)server.dbnum) {
+                reader->baddb = dbid;
+                goto eoferr;
+            }
+            continue;
+        }
+
+        /* Copy the key and the value into the batch. */
+        start = sdslen(batch->buf);
+        reader->capture = &batch->buf;
+        if (rdbSkipStringObject(rdb) == 0) goto eoferr;
+        if (rdbSkipObject(type,rdb) == 0) goto eoferr;
+        reader->capture = NULL;
+
+        /* Drop keys already expired, see rdbLoad(). */
+        if (server.masterhost == NULL && expiretime != -1 &&
+            expiretime < rdbLoader.now)
+        {
+            sdssetlen(batch->buf,start);
+            continue;
+        }
+
+        batch->records[batch->count].type = type;
+        batch->records[batch->count].dbid = dbid;
+        batch->records[batch->count].expiretime = expiretime;
+        batch->count++;
+        if (batch->count == RDB_LOAD_BATCH_KEYS ||
+            sdslen(batch->buf) >= RDB_LOAD_BATCH_BYTES)
+        {
+            if (!rdbLoadQueueBatch(reader,batch)) goto cleanup;
+            batch = rdbLoadBatchCreate();
+        }
+    }
+
+    if (reader->section) {
+        /* A record crossing the end of the section means it's corrupted.
+         * The checksum in the index is 0 if checksum was disabled. */
+        if (rdb->processed_bytes != reader->len) goto eoferr;
+        if (server.rdb_checksum && reader->expected &&
+            rdb->cksum != reader->expected)
+            reader->cksum = RDB_LOAD_CKSUM_WRONG;
+    } else if (rdbLoader.rdbver >= 5 && server.rdb_checksum) {
+        /* Verify the checksum if RDB version is >= 5 */
+        uint64_t cksum, expected = rdb->cksum;
+
+        if (rioRead(rdb,&cksum,8) == 0) goto eoferr;
+        memrev64ifbe(&cksum);
+        if (cksum == 0)
+            reader->cksum = RDB_LOAD_CKSUM_NONE;
+        else if (cksum != expected)
+            reader->cksum = RDB_LOAD_CKSUM_WRONG;
+    }
+    batch->last = 1;
+    rdbLoadQueueBatch(reader,batch);
+    goto cleanup;
+
+eoferr:
+    reader->capture = NULL;
+    batch->err = 1;
+    batch->last = 1;
+    rdbLoadQueueBatch(reader,batch);
+
+cleanup:
+    if (fp) fclose(fp);
+    return NULL;
+}
+
+/* Decode the keys and the values of a batch.
+ *
+ * һемֵ */
+static void rdbLoadDecodeBatch(rdbLoadBatch *batch) {
+    rio rdb;
+    int j;
+
+    rioInitWithBuffer(&rdb,batch->buf);
+    for (j = 0; j < batch->count; j++) {
+        rdbLoadRecord *rec = batch->records+j;
+
+        if ((rec->key = rdbLoadStringObject(&rdb)) == NULL ||
+            (rec->val = rdbLoadObject(rec->type,&rdb)) == NULL)
+        {
+            batch->err = 1;
+            return;
+        }
+    }
+}
+
+/* Worker thread: decode the batches queued by the reader.
+ *
+ * ̷̣߳߳е */
+static void *rdbLoadWorkerMain(void *arg) {
+    listIter li;
+    listNode *ln;
+    rdbLoadBatch *batch;
+    REDIS_NOTUSED(arg);
+
+    rdbThreadInit();
+    pthread_mutex_lock(&rdbLoader.mutex);
+    while(!rdbLoader.stop) {
+        /* The loop always starts with the lock hold. */
+        batch = NULL;
+        listRewind(rdbLoader.batches,&li);
+        while((ln = listNext(&li)) != NULL) {
+            rdbLoadBatch *b = ln->value;
+
+            if (b->state == RDB_LOAD_BATCH_READ) {
+                batch = b;
+                break;
+            }
+        }
+        if (batch == NULL) {
+            pthread_cond_wait(&rdbLoader.cond,&rdbLoader.mutex);
+            continue;
+        }
+        batch->state = RDB_LOAD_BATCH_DECODING;
+        pthread_mutex_unlock(&rdbLoader.mutex);
+
+        if (!batch->err) rdbLoadDecodeBatch(batch);
+
+        pthread_mutex_lock(&rdbLoader.mutex);
+        batch->state = RDB_LOAD_BATCH_DECODED;
+        pthread_cond_broadcast(&rdbLoader.cond);
     }
+    pthread_mutex_unlock(&rdbLoader.mutex);
+    return NULL;
+}
+
+/* Read the index of a file saved in sections, that follows the SECTIONS
+ * opcode. Returns the index, with the number of sections in '*count', or
+ * NULL on short read.
+ *
+ * ֶֶ浽 *count Уʧܷ NULL */
+static rdbLoadReader *rdbLoadSectionIndex(rio *rdb, uint32_t *count) {
+    rdbLoadReader *sections;
+    uint32_t j;
+
+    if ((*count = rdbLoadLen(rdb,NULL)) == REDIS_RDB_LENERR ||
+        *count > REDIS_RDB_SAVE_THREADS_MAX) return NULL;
+    sections = zcalloc(sizeof(rdbLoadReader)*(*count ? *count : 1));
+    for (j = 0; j < *count; j++) {
+        uint64_t entry[2];
+
+        if (rioRead(rdb,entry,sizeof(entry)) == 0) {
+            zfree(sections);
+            return NULL;
+        }
+        memrev64ifbe(entry);
+        memrev64ifbe(entry+1);
+        sections[j].section = 1;
+        sections[j].len = entry[0];
+        sections[j].expected = entry[1];
+    }
+    return sections;
+}
+
+/* Load the rest of the file, after the header already read from 'rdb', with
+ * a reader thread, or a reader thread per section, and rdb-load-threads
+ * decoding threads. Returns REDIS_ERR on short read or corrupted data.
+ *
+ * ʹһֶ̣߳αļÿֶһ̣߳
+ * rdb-load-threads ߳ļʣಿ
+ * ļͷѾ rdb ж룩
+ * 벻ʱ REDIS_ERR  */
+static int rdbLoadThreaded(rio *rdb, int rdbver, char *filename) {
+    int nthreads = server.rdb_load_threads, j, last = 0, err = 0;
+    pthread_t *workers = zmalloc(sizeof(pthread_t)*nthreads);
+    rdbLoadReader *readers;
+    uint32_t nreaders = 1;
+    off_t processed;
+    int type, cksum = RDB_LOAD_CKSUM_OK;
+
+    if ((type = rdbLoadType(rdb)) == -1) {
+        zfree(workers);
+        return REDIS_ERR;
+    }
+    if (type == REDIS_RDB_OPCODE_SECTIONS) {
+        off_t offset;
+
+        if ((readers = rdbLoadSectionIndex(rdb,&nreaders)) == NULL) {
+            zfree(workers);
+            return REDIS_ERR;
+        }
+        offset = rioTell(rdb);
+        for (j = 0; j < (int)nreaders; j++) {
+            readers[j].offset = offset;
+            readers[j].type = -1;
+            readers[j].baddb = -1;
+            offset += readers[j].len;
+        }
+        /* Go past the sections, to the EOF opcode. */
+        if (fseeko(rdb->io.file.fp,offset,SEEK_SET) == -1) {
+            zfree(readers);
+            zfree(workers);
+            return REDIS_ERR;
+        }
+    } else {
+        /* A single reader continues reading 'rdb', starting from the
+         * opcode just read. */
+        readers = zcalloc(sizeof(rdbLoadReader));
+        readers->rdb = *rdb;
+        readers->rdb.update_cksum = rdbLoadReaderCallback;
+        readers->type = type;
+        readers->queued = rdb->processed_bytes;
+        readers->baddb = -1;
+    }
+    processed = rdb->processed_bytes;
+
+    pthread_mutex_init(&rdbLoader.mutex,NULL);
+    pthread_cond_init(&rdbLoader.cond,NULL);
+    rdbLoader.batches = listCreate();
+    rdbLoader.maxbatches = nthreads*2+nreaders+1;
+    rdbLoader.stop = 0;
+    rdbLoader.filename = filename;
+    rdbLoader.rdbver = rdbver;
+    rdbLoader.now = mstime();
+
+    for (j = 0; j < (int)nreaders; j++) {
+        if (pthread_create(&readers[j].thread,NULL,rdbLoadReaderMain,
+                           readers+j) != 0)
+        {
+            redisLog(REDIS_WARNING,"Fatal: Can't initialize RDB load threads.");
+            exit(1);
+        }
+    }
+    for (j = 0; j < nthreads; j++) {
+        if (pthread_create(workers+j,NULL,rdbLoadWorkerMain,NULL) != 0) {
+            redisLog(REDIS_WARNING,"Fatal: Can't initialize RDB load threads.");
+            exit(1);
+        }
+    }
+
+    while(last < (int)nreaders) {
+        rdbLoadBatch *batch;
+        listNode *ln;
+
+        /* Wait for the next batch in file order to be decoded, handling
+         * events from time to time meanwhile. */
+        pthread_mutex_lock(&rdbLoader.mutex);
+        while ((ln = listFirst(rdbLoader.batches)) == NULL ||
+               ((rdbLoadBatch*)ln->value)->state != RDB_LOAD_BATCH_DECODED)
+        {
+            struct timespec ts;
+            long long when = ustime()+100000;
+
+            ts.tv_sec = when/1000000;
+            ts.tv_nsec = (when%1000000)*1000;
+            if (pthread_cond_timedwait(&rdbLoader.cond,&rdbLoader.mutex,&ts)
+                == ETIMEDOUT)
+            {
+                pthread_mutex_unlock(&rdbLoader.mutex);
+                rdbLoadProcessEvents(processed);
+                pthread_mutex_lock(&rdbLoader.mutex);
+            }
+        }
+        batch = ln->value;
+        listDelNode(rdbLoader.batches,ln);
+        pthread_cond_broadcast(&rdbLoader.cond);
+        pthread_mutex_unlock(&rdbLoader.mutex);
+
+        last += batch->last;
+        if (batch->err) {
+            err = 1;
+            last = nreaders;
+        } else {
+            /* Add the new objects in the hash tables, see rdbLoad(). */
+            for (j = 0; j < batch->count; j++) {
+                rdbLoadRecord *rec = batch->records+j;
+                redisDb *db = server.db+rec->dbid;
+
+                dbAdd(db,rec->key,rec->val);
+                if (rec->expiretime != -1)
+                    setExpire(db,rec->key,rec->expiretime);
+                decrRefCount(rec->key);
+            }
+        }
+
+        if (server.loading_process_events_interval_bytes &&
+            (processed+batch->processed)/server.loading_process_events_interval_bytes >
+            processed/server.loading_process_events_interval_bytes)
+        {
+            rdbLoadProcessEvents(processed+batch->processed);
+        }
+        processed += batch->processed;
+        rdbLoadBatchFree(batch);
+    }
+
+    /* Stop the threads. The readers already returned after queueing their
+     * last batch, or return as soon as they see 'stop' after an error. */
+    pthread_mutex_lock(&rdbLoader.mutex);
+    rdbLoader.stop = 1;
+    pthread_cond_broadcast(&rdbLoader.cond);
+    pthread_mutex_unlock(&rdbLoader.mutex);
+    for (j = 0; j < (int)nreaders; j++) pthread_join(readers[j].thread,NULL);
+    for (j = 0; j < nthreads; j++) pthread_join(workers[j],NULL);
+    zfree(workers);
+    while (listLength(rdbLoader.batches)) {
+        rdbLoadBatchFree(listFirst(rdbLoader.batches)->value);
+        listDelNode(rdbLoader.batches,listFirst(rdbLoader.batches));
+    }
+    listRelease(rdbLoader.batches);
+    pthread_cond_destroy(&rdbLoader.cond);
+    pthread_mutex_destroy(&rdbLoader.mutex);
+
+    for (j = 0; j < (int)nreaders; j++) {
+        if (readers[j].baddb != -1) {
+            redisLog(REDIS_WARNING,"FATAL: Data file was created with a Redis server configured to handle more than %d databases. Exiting\n", server.dbnum);
+            exit(1);
+        }
+        if (readers[j].cksum != RDB_LOAD_CKSUM_OK) cksum = readers[j].cksum;
+    }
+
+    /* After the sections there is the EOF opcode and the checksum of the
+     * whole file: the sections are not read again, their checksums are
+     * combined with the one of the header and the index. */
+    if (!err && readers->section) {
+        if (server.rdb_checksum) {
+            for (j = 0; j < (int)nreaders; j++)
+                rdb->cksum = crc64_combine(rdb->cksum,readers[j].rdb.cksum,
+                                           readers[j].len);
+        }
+        if (rdbLoadType(rdb) != REDIS_RDB_OPCODE_EOF) {
+            err = 1;
+        } else if (server.rdb_checksum) {
+            uint64_t filecksum, expected = rdb->cksum;
+
+            if (rioRead(rdb,&filecksum,8) == 0) {
+                err = 1;
+            } else {
+                memrev64ifbe(&filecksum);
+                if (filecksum == 0)
+                    cksum = RDB_LOAD_CKSUM_NONE;
+                else if (filecksum != expected)
+                    cksum = RDB_LOAD_CKSUM_WRONG;
+            }
+        }
+    }
+    zfree(readers);
+
+    if (err) return REDIS_ERR;
+    if (cksum == RDB_LOAD_CKSUM_NONE) {
+        redisLog(REDIS_WARNING,"RDB file was saved with checksum disabled: no check performed.");
+    } else if (cksum == RDB_LOAD_CKSUM_WRONG) {
+        redisLog(REDIS_WARNING,"Wrong RDB checksum. Aborting now.");
+        exit(1);
+    }
+    return REDIS_OK;
 }
 
 /*
@@ -1684,6 +2762,15 @@ int rdbLoad(char *filename) {//
 
     // ״̬ʼ״̬
     startLoading(fp);
+
+    /* Decode the objects in other threads if configured to do so. */
+    if (server.rdb_load_threads > 0) {
+        if (rdbLoadThreaded(&rdb,rdbver,filename) == REDIS_ERR) goto eoferr;
+        fclose(fp);
+        stopLoading();
+        return REDIS_OK;
+    }
+
     while(1) {
         robj *key, *val;
         expiretime = -1;
@@ -1735,6 +2822,19 @@ int rdbLoad(char *filename) {//
         if (type == REDIS_RDB_OPCODE_EOF)
             break;
 
+        /* The sections of a file saved by rdb-save-threads just follow
+         * their index, that is not needed loading them serially.
+         *
+         * ֶαļʱֶ */
+        if (type == REDIS_RDB_OPCODE_SECTIONS) {
+            uint32_t count;
+            rdbLoadReader *sections = rdbLoadSectionIndex(&rdb,&count);
+
+            if (sections == NULL) goto eoferr;
+            zfree(sections);
+            continue;
+        }
+
         /* Handle SELECT DB opcode as a special case 
          *
          * лݿָʾ
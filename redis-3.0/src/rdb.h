@@ -41,7 +41,7 @@
  *
  * RDB İ汾°汾Ͱ汾ʱһ
  */
-#define REDIS_RDB_VERSION 6
+#define REDIS_RDB_VERSION 10
 
 /* Defines related to the dump file format. To store 32 bits lengths for short
  * keys requires a lot of space, so we check the most significant 2 bits of
@@ -88,6 +88,8 @@
 #define REDIS_RDB_ENC_INT16 1       /* 16 bit signed integer */
 #define REDIS_RDB_ENC_INT32 2       /* 32 bit signed integer */
 #define REDIS_RDB_ENC_LZF 3         /* string compressed with FASTLZ *///key-valueݿʱѹʽ洢
+#define REDIS_RDB_ENC_LZ4 4         /* string compressed with LZ4 */
+#define REDIS_RDB_ENC_ZSTD 5        /* string compressed with zstd */
 
 /* Dup object types to RDB object types. Only reason is readability (are we
  * dealing with RDB types or with in-memory object types?).
@@ -109,17 +111,23 @@
 #define REDIS_RDB_TYPE_SET_INTSET    11
 #define REDIS_RDB_TYPE_ZSET_ZIPLIST  12
 #define REDIS_RDB_TYPE_HASH_ZIPLIST  13
+#define REDIS_RDB_TYPE_LIST_LISTPACK 14
+#define REDIS_RDB_TYPE_ZSET_LISTPACK 15
+#define REDIS_RDB_TYPE_HASH_LISTPACK 16
+#define REDIS_RDB_TYPE_LIST_QUICKLIST 17
 
 /* Test if a type is an object type.
  *
  * Ƿ
  */
-#define rdbIsObjectType(t) ((t >= 0 && t <= 4) || (t >= 9 && t <= 13))
+#define rdbIsObjectType(t) ((t >= 0 && t <= 4) || (t >= 9 && t <= 17))
 
 /* Special RDB opcodes (saved/loaded with rdbSaveType/rdbLoadType).
  *
  * ݿʶ
  */
+// ֶ֮ŲдĸֶΣ RDB 汾 9 
+#define REDIS_RDB_OPCODE_SECTIONS   251
 //  MS Ĺʱ
 #define REDIS_RDB_OPCODE_EXPIRETIME_MS 252
 // Ĺʱ
@@ -39,8 +39,13 @@
 #include <arpa/inet.h>
 #include <stdint.h>
 #include <limits.h>
+#include "config.h"
 #include "lzf.h"
+#include "lz4.h"
 #include "crc64.h"
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
 
 /*
  *    ȡֵ洢redisObject->type
@@ -104,6 +109,10 @@ TYPE 
 #define REDIS_SET_INTSET 11
 #define REDIS_ZSET_ZIPLIST 12
 #define REDIS_HASH_ZIPLIST 13
+#define REDIS_LIST_LISTPACK 14
+#define REDIS_ZSET_LISTPACK 15
+#define REDIS_HASH_LISTPACK 16
+#define REDIS_LIST_QUICKLIST 17
 
 
 /*
@@ -205,6 +214,7 @@ Redis 
 #define REDIS_ENCODING_HT 3     /* Encoded as a hash table */
 
 /* Object types only used for dumping to disk */
+#define REDIS_SECTIONS 251 //RDBļֶıʶֻļͷ֮
 #define REDIS_EXPIRETIME_MS 252
 #define REDIS_EXPIRETIME 253
 #define REDIS_SELECTDB 254  //RDBļѡDBŵıʶ
@@ -236,6 +246,8 @@ Redis 
 #define REDIS_RDB_ENC_INT16 1       /* 16 bit signed integer */
 #define REDIS_RDB_ENC_INT32 2       /* 32 bit signed integer */
 #define REDIS_RDB_ENC_LZF 3         /* string compressed with FASTLZ */
+#define REDIS_RDB_ENC_LZ4 4         /* string compressed with LZ4 */
+#define REDIS_RDB_ENC_ZSTD 5        /* string compressed with zstd */
 
 #define ERROR(...) { \
     printf(__VA_ARGS__); \
@@ -283,14 +295,24 @@ static double R_Zero, R_PosInf, R_NegInf, R_Nan;
 /* store string types for output */
 static char types[256][16];
 
+/* Index of a file saved in sections, see rdbSaveSections() */
+#define MAX_SECTIONS 64
+typedef struct {
+    uint64_t offset;
+    uint64_t len;
+    uint64_t crc;
+} section;
+static section sections[MAX_SECTIONS];
+static uint32_t num_sections = 0;
+
 /* Return true if 't' is a valid object type. */
 int checkType(unsigned char t) {
     /* In case a new object type is added, update the following 
      * condition as necessary. */
     return
-        (t >= REDIS_HASH_ZIPMAP && t <= REDIS_HASH_ZIPLIST) ||
+        (t >= REDIS_HASH_ZIPMAP && t <= REDIS_LIST_QUICKLIST) ||
         t <= REDIS_HASH ||
-        t >= REDIS_EXPIRETIME_MS;
+        t >= REDIS_SECTIONS;
 }
 
 /* when number of bytes to read is negative, do a peek */
@@ -322,7 +344,7 @@ int processHeader() {
     }
 
     dump_version = (int)strtol(buf + 5, NULL, 10);
-    if (dump_version < 1 || dump_version > 6) {
+    if (dump_version < 1 || dump_version > 10) {
         ERROR("Unknown RDB format version: %d\n", dump_version);
     }
     return dump_version;
@@ -355,6 +377,18 @@ int peekType() {
     return -1;
 }
 
+/* read a little endian 64 bit integer */
+uint64_t loadUint64(unsigned char *p) {
+    return ((uint64_t)p[0] << 0) |
+           ((uint64_t)p[1] << 8) |
+           ((uint64_t)p[2] << 16) |
+           ((uint64_t)p[3] << 24) |
+           ((uint64_t)p[4] << 32) |
+           ((uint64_t)p[5] << 40) |
+           ((uint64_t)p[6] << 48) |
+           ((uint64_t)p[7] << 56);
+}
+
 /* discard time, just consume the bytes */
 int processTime(int type) {
     uint32_t offset = CURR_OFFSET;
@@ -429,9 +463,12 @@ char *loadIntegerObject(int enctype) {
     return buf;
 }
 
-char* loadLzfStringObject() {
+/* load a string compressed with LZF, LZ4 or zstd. Without zstd support
+ * zstd strings are skipped, and returned as empty strings */
+char* loadCompressedStringObject(int enctype) {
     unsigned int slen, clen;
     char *c, *s;
+    int ok;
 
     if ((clen = loadLength(NULL)) == REDIS_RDB_LENERR) return NULL;
     if ((slen = loadLength(NULL)) == REDIS_RDB_LENERR) return NULL;
@@ -443,10 +480,23 @@ char* loadLzfStringObject() {
     }
 
     s = malloc(slen+1);
-    if (lzf_decompress(c,clen,s,slen) == 0) {
+    if (enctype == REDIS_RDB_ENC_LZF) {
+        ok = lzf_decompress(c,clen,s,slen) == slen;
+    } else if (enctype == REDIS_RDB_ENC_LZ4) {
+        ok = LZ4_decompress_safe(c,s,clen,slen) == (int)slen;
+    } else {
+#ifdef HAVE_ZSTD
+        ok = ZSTD_decompress(s,slen,c,clen) == slen;
+#else
+        ok = 1;
+        slen = 0;
+#endif
+    }
+    if (!ok) {
         free(c); free(s);
         return NULL;
     }
+    s[slen] = '\0';
 
     free(c);
     return s;
@@ -466,7 +516,9 @@ char* loadStringObject() {
         case REDIS_RDB_ENC_INT32:
             return loadIntegerObject(len);
         case REDIS_RDB_ENC_LZF:
-            return loadLzfStringObject();
+        case REDIS_RDB_ENC_LZ4:
+        case REDIS_RDB_ENC_ZSTD:
+            return loadCompressedStringObject(len);
         default:
             /* unknown encoding */
             SHIFT_ERROR(offset, "Unknown string encoding (0x%02x)", len);
@@ -485,6 +537,44 @@ char* loadStringObject() {
     return buf;
 }
 
+/* load the index of the sections, following the SECTIONS opcode */
+int processSections(void) {
+    uint32_t offset = CURR_OFFSET, count, i;
+    uint64_t start;
+    unsigned char buf[16];
+
+    if ((count = loadLength(NULL)) == REDIS_RDB_LENERR) {
+        SHIFT_ERROR(offset, "Error reading number of sections");
+        return 0;
+    }
+    if (count > MAX_SECTIONS) {
+        SHIFT_ERROR(offset, "Number of sections out of range (%u)", count);
+        return 0;
+    }
+    for (i = 0; i < count; i++) {
+        offset = CURR_OFFSET;
+        if (!readBytes(buf, 16)) {
+            SHIFT_ERROR(offset, "Could not read section %u of the index", i);
+            return 0;
+        }
+        sections[i].len = loadUint64(buf);
+        sections[i].crc = loadUint64(buf+8);
+    }
+
+    /* the sections follow the index */
+    start = CURR_OFFSET;
+    for (i = 0; i < count; i++) {
+        sections[i].offset = start;
+        start += sections[i].len;
+        if (start > positions[level].size) {
+            SHIFT_ERROR(offset, "Section %u ends past the end of file", i);
+            return 0;
+        }
+    }
+    num_sections = count;
+    return 1;
+}
+
 int processStringObject(char** store) {
     unsigned long offset = CURR_OFFSET;
     char *key = loadStringObject();
@@ -557,6 +647,7 @@ int loadPair(entry *e) {
 
     uint32_t length = 0;
     if (e->type == REDIS_LIST ||
+        e->type == REDIS_LIST_QUICKLIST ||
         e->type == REDIS_SET  ||
         e->type == REDIS_ZSET ||
         e->type == REDIS_HASH) {
@@ -573,12 +664,16 @@ int loadPair(entry *e) {
     case REDIS_SET_INTSET:
     case REDIS_ZSET_ZIPLIST:
     case REDIS_HASH_ZIPLIST:
+    case REDIS_LIST_LISTPACK:
+    case REDIS_ZSET_LISTPACK:
+    case REDIS_HASH_LISTPACK:
         if (!processStringObject(NULL)) {
             SHIFT_ERROR(offset, "Error reading entry value");
             return 0;
         }
     break;
     case REDIS_LIST:
+    case REDIS_LIST_QUICKLIST:
     case REDIS_SET:
         for (i = 0; i < length; i++) {
             offset = CURR_OFFSET;
@@ -647,6 +742,13 @@ entry loadEntry() {
             SHIFT_ERROR(offset[1], "Database number out of range (%d)", length);
             return e;
         }
+    } else if (e.type == REDIS_SECTIONS) {
+        /* the index is only valid right after the header */
+        if (offset[0] != 9) {
+            SHIFT_ERROR(offset[0], "Sections index not after the header");
+            return e;
+        }
+        if (!processSections()) return e;
     } else if (e.type == REDIS_EOF) {
         if (positions[level].offset < positions[level].size) {
             SHIFT_ERROR(offset[0], "Unexpected EOF");
@@ -819,19 +921,31 @@ void process() {
         num_errors++;
     }
 
+    /* Verify the checksum of every section, 0 if saved without checksum */
+    if (num_sections) {
+        uint32_t i, bad = 0;
+
+        for (i = 0; i < num_sections; i++) {
+            unsigned char *p = (unsigned char*)positions[0].data+sections[i].offset;
+
+            if (sections[i].crc &&
+                crc64(0,p,sections[i].len) != sections[i].crc)
+            {
+                printf("Section %u (0x%08llx, %llu bytes): CRC64 does not match\n",
+                    i, (unsigned long long) sections[i].offset,
+                    (unsigned long long) sections[i].len);
+                bad++;
+            }
+        }
+        if (!bad) printf("CRC64 of %u sections is OK\n", num_sections);
+    }
+
     /* Verify checksum */
     if (dump_version >= 5) {
         uint64_t crc = crc64(0,positions[0].data,positions[0].size);
         uint64_t crc2;
         unsigned char *p = (unsigned char*)positions[0].data+positions[0].size;
-        crc2 = ((uint64_t)p[0] << 0) |
-               ((uint64_t)p[1] << 8) |
-               ((uint64_t)p[2] << 16) |
-               ((uint64_t)p[3] << 24) |
-               ((uint64_t)p[4] << 32) |
-               ((uint64_t)p[5] << 40) |
-               ((uint64_t)p[6] << 48) |
-               ((uint64_t)p[7] << 56);
+        crc2 = loadUint64(p);
         if (crc != crc2) {
             SHIFT_ERROR(positions[0].offset, "RDB CRC64 does not match.");
         } else {
@@ -892,6 +1006,7 @@ int main(int argc, char **argv) {
     sprintf(types[REDIS_HASH], "HASH");
 
     /* Object types only used for dumping to disk */
+    sprintf(types[REDIS_SECTIONS], "SECTIONS");
     sprintf(types[REDIS_EXPIRETIME], "EXPIRETIME");
     sprintf(types[REDIS_SELECTDB], "SELECTDB");
     sprintf(types[REDIS_EOF], "EOF");
@@ -715,6 +715,14 @@ unsigned int dictEncObjHash(const void *key) {
     }
 }
 
+/* Hash tables can't be evicted: when a bigger table for the keyspace would
+ * take the server over maxmemory, keep filling the current one, so that
+ * evicting keys can still free enough memory for the new writes. */
+static int dictExpandAllowed(size_t moreMem) {
+    if (!server.maxmemory) return 1;
+    return zmalloc_used_memory()+moreMem <= server.maxmemory;
+}
+
 /* Sets type hash table */
 dictType setDictType = {
     dictEncObjHash,            /* hash function */
@@ -742,7 +750,9 @@ dictType dbDictType = {
     NULL,                       /* val dup */
     dictSdsKeyCompare,          /* key compare */
     dictSdsDestructor,          /* key destructor */
-    dictRedisObjectDestructor   /* val destructor */
+    dictRedisObjectDestructor,  /* val destructor */
+    1,                          /* open addressing */
+    dictExpandAllowed           /* expand allowed */
 };
 
 /* server.lua_scripts sha (as sds string) -> scripts (as robj) cache. */
@@ -762,7 +772,9 @@ dictType keyptrDictType = {
     NULL,                      /* val dup */
     dictSdsKeyCompare,         /* key compare */
     NULL,                      /* key destructor */
-    NULL                       /* val destructor */
+    NULL,                      /* val destructor */
+    1,                         /* open addressing */
+    dictExpandAllowed          /* expand allowed */
 };
 
 /* Command table. sds string -> command struct pointer. */
@@ -867,8 +879,9 @@ void tryResizeHashTables(int dbid) {
 
 /* Our hash table implementation performs rehashing incrementally while
  * we write/read from the hash table. Still if the server is idle, the hash
- * table will use two tables for a long time. So we try to use 1 millisecond
- * of CPU time at every call of this function to perform some rehahsing.
+ * table will use two tables for a long time. So we try to use 'us'
+ * microseconds of CPU time at every call of this function to perform some
+ * rehahsing.
  *
  * Ȼڶݿִжȡ/дʱݿнʽ rehash 
  * ûִĻݿֵ rehash Ϳһֱû취ɣ
@@ -879,21 +892,31 @@ void tryResizeHashTables(int dbid) {
  *
  * ִ rehash ʱ 1 򷵻 0 
  */
-int incrementallyRehash(int dbid) {
+int incrementallyRehash(int dbid, long long us) {
+    dict *d = NULL;
+    long long start;
 
     /* Keys dictionary */
-    if (dictIsRehashing(server.db[dbid].dict)) {
-        dictRehashMilliseconds(server.db[dbid].dict,1);
-        return 1; /* already used our millisecond for this loop... */
-    }
-
+    if (dictIsRehashing(server.db[dbid].dict))
+        d = server.db[dbid].dict;
     /* Expires */
-    if (dictIsRehashing(server.db[dbid].expires)) {
-        dictRehashMilliseconds(server.db[dbid].expires,1);
-        return 1; /* already used our millisecond for this loop... */
-    }
+    else if (dictIsRehashing(server.db[dbid].expires))
+        d = server.db[dbid].expires;
+    else
+        return 0;
 
-    return 0;
+    start = ustime();
+    dictRehashMicroseconds(d,us);
+    server.stat_rehash_time += ustime()-start;
+    return 1; /* already used our time for this loop... */
+}
+
+/* Big hash tables are allocated and cleared by a bio thread, see
+ * dictSetBackgroundAlloc() in dict.c.
+ *
+ * ϣķ㽻ִ̨߳С */
+void submitDictTableAlloc(dictTableAlloc *req) {
+    bioCreateBackgroundJob(REDIS_BIO_DICT_ALLOC,req,NULL,NULL);
 }
 
 /* This function is called once a background process of some kind terminates,
@@ -1425,8 +1448,22 @@ void databasesCron(void) {
         /* Rehash */
         // ֵнʽ rehash
         if (server.activerehashing) {
+            /* When clients are served we only use REDIS_REHASH_CRON_BUDGET
+             * to keep the latency low, while an idle server can use up to
+             * 10% of the time between two cron calls, so that big
+             * dictionaries don't stay with two tables for a long time.
+             *
+             * æʱֻʹ 1  rehash 
+             * ʱʹ cron ֮ 10% ʱ䡣 */
+            static long long last_numcommands = 0;
+            long long us = REDIS_REHASH_CRON_BUDGET;
+
+            if (server.stat_numcommands == last_numcommands &&
+                100000/server.hz > us) us = 100000/server.hz;
+            last_numcommands = server.stat_numcommands;
+
             for (j = 0; j < dbs_per_call; j++) {
-                int work_done = incrementallyRehash(rehash_db % server.dbnum);
+                int work_done = incrementallyRehash(rehash_db % server.dbnum,us);
                 rehash_db++;
                 if (work_done) {
                     /* If the function did some work, stop here, we'll do
@@ -1760,6 +1797,11 @@ int serverCron(struct aeEventLoop *eventLoop, long long id, void *clientData) {
 void beforeSleep(struct aeEventLoop *eventLoop) {
     REDIS_NOTUSED(eventLoop);
 
+    /* Handle the clients whose reads were deferred to the I/O threads:
+     * the threads read and parse, the commands are executed here. */
+    //  I/O ̶߳ȡƳٵĿͻִ߳
+    handleClientsWithPendingReadsUsingThreads();
+
     /* Run a fast expire cycle (the called function will return
      * ASAP if a fast cycle is not needed). */
     // ִһοٵڼ
@@ -1797,6 +1839,11 @@ void beforeSleep(struct aeEventLoop *eventLoop) {
     /* Call the Redis Cluster before sleep function. */
     // ڽ¸¼ѭǰִһЩȺβ
     if (server.cluster_enabled) clusterBeforeSleep();
+
+    /* Write the pending replies using the I/O threads. This is done as
+     * the last thing so that the AOF buffer was already written. */
+    //  I/O ߳дظʱ AOF Ѿдļ
+    handleClientsWithPendingWritesUsingThreads();
 }
 
 /* =========================== Server initialization ======================== */
@@ -1885,7 +1932,8 @@ void createSharedObjects(void) { //
 
     // 
     for (j = 0; j < REDIS_SHARED_INTEGERS; j++) {
-        shared.integers[j] = createObject(REDIS_STRING,(void*)(long)j); //ӦȡֵοgetDecodedObject
+        shared.integers[j] =
+            makeObjectShared(createObject(REDIS_STRING,(void*)(long)j)); //ӦȡֵοgetDecodedObject
         shared.integers[j]->encoding = REDIS_ENCODING_INT;
     }
 
@@ -1931,6 +1979,8 @@ void initServerConfig() { //
     server.verbosity = REDIS_DEFAULT_VERBOSITY;
     server.maxidletime = REDIS_MAXIDLETIME;
     server.tcpkeepalive = REDIS_DEFAULT_TCP_KEEPALIVE;
+    server.io_threads_num = REDIS_DEFAULT_IO_THREADS;
+    server.io_uring = REDIS_DEFAULT_IO_URING;
     server.active_expire_enabled = 1;
     server.client_max_querybuf_len = REDIS_MAX_QUERYBUF_LEN;
     server.saveparams = NULL;
@@ -1956,12 +2006,18 @@ void initServerConfig() { //
     server.aof_selected_db = -1; /* Make sure the first time will not match */
     server.aof_flush_postponed_start = 0;
     server.aof_rewrite_incremental_fsync = REDIS_DEFAULT_AOF_REWRITE_INCREMENTAL_FSYNC;
+    server.aof_group_commit = REDIS_DEFAULT_AOF_GROUP_COMMIT;
+    server.aof_write_seq = 0;
+    server.aof_fsynced_seq = 0;
+    server.aof_fsync_pending_seq = 0;
     server.pidfile = zstrdup(REDIS_DEFAULT_PID_FILE);
     server.rdb_filename = zstrdup(REDIS_DEFAULT_RDB_FILENAME);
     server.aof_filename = zstrdup(REDIS_DEFAULT_AOF_FILENAME);
     server.requirepass = NULL;
     server.rdb_compression = REDIS_DEFAULT_RDB_COMPRESSION;
     server.rdb_checksum = REDIS_DEFAULT_RDB_CHECKSUM;
+    server.rdb_load_threads = REDIS_DEFAULT_RDB_LOAD_THREADS;
+    server.rdb_save_threads = REDIS_DEFAULT_RDB_SAVE_THREADS;
     server.stop_writes_on_bgsave_err = REDIS_DEFAULT_STOP_WRITES_ON_BGSAVE_ERROR;
     server.activerehashing = REDIS_DEFAULT_ACTIVE_REHASHING;
     server.notify_keyspace_events = 0;
@@ -1974,9 +2030,13 @@ void initServerConfig() { //
     server.hash_max_ziplist_value = REDIS_HASH_MAX_ZIPLIST_VALUE;
     server.list_max_ziplist_entries = REDIS_LIST_MAX_ZIPLIST_ENTRIES;
     server.list_max_ziplist_value = REDIS_LIST_MAX_ZIPLIST_VALUE;
+    server.list_max_ziplist_size = REDIS_LIST_MAX_ZIPLIST_SIZE;
+    server.list_compress_depth = REDIS_LIST_COMPRESS_DEPTH;
     server.set_max_intset_entries = REDIS_SET_MAX_INTSET_ENTRIES;
     server.zset_max_ziplist_entries = REDIS_ZSET_MAX_ZIPLIST_ENTRIES;
     server.zset_max_ziplist_value = REDIS_ZSET_MAX_ZIPLIST_VALUE;
+    server.zset_btree = REDIS_DEFAULT_ZSET_BTREE;
+    server.zset_async_aggregate_threshold = REDIS_DEFAULT_ZSET_ASYNC_AGGREGATE_THRESHOLD;
     server.hll_sparse_max_bytes = REDIS_DEFAULT_HLL_SPARSE_MAX_BYTES;
     server.shutdown_asap = 0;
     server.repl_ping_slave_period = REDIS_REPL_PING_SLAVE_PERIOD;
@@ -2228,10 +2288,17 @@ void resetServerStats(void) {
     server.stat_keyspace_misses = 0;
     server.stat_keyspace_hits = 0;
     server.stat_fork_time = 0;
+    server.stat_rehash_time = 0;
+    server.stat_zset_aggr_async = 0;
+    server.stat_aof_group_fsyncs = 0;
     server.stat_rejected_conn = 0;
     server.stat_sync_full = 0;
     server.stat_sync_partial_ok = 0;
     server.stat_sync_partial_err = 0;
+    server.stat_io_reads_processed = 0;
+    server.stat_io_writes_processed = 0;
+    server.stat_reply_syscalls = 0;
+    server.stat_replies_sent = 0;
     memset(server.ops_sec_samples,0,sizeof(server.ops_sec_samples));
     server.ops_sec_idx = 0;
     server.ops_sec_last_sample_time = mstime();
@@ -2256,18 +2323,24 @@ void initServer() {
     server.current_client = NULL;
     server.clients = listCreate();
     server.clients_to_close = listCreate();
+    server.clients_pending_read = listCreate();
+    server.clients_pending_write = listCreate();
     server.slaves = listCreate();
     server.monitors = listCreate();
     server.slaveseldb = -1; /* Force to emit the first SELECT command. */
     server.unblocked_clients = listCreate();
     server.ready_keys = listCreate();
+    server.zset_aggr_jobs = listCreate();
+    server.zset_aggr_timer = -1;
     server.clients_waiting_acks = listCreate();
+    server.aof_fsync_clients = listCreate();
     server.get_ack_from_slaves = 0;
     server.clients_paused = 0;
 
     // 
     createSharedObjects();
     adjustOpenFilesLimit();
+    aeUseIoUring(server.io_uring);
     server.el = aeCreateEventLoop(server.maxclients+REDIS_EVENTLOOP_FDSET_INCR);
     server.db = zmalloc(sizeof(redisDb)*server.dbnum);
 
@@ -2320,6 +2393,16 @@ void initServer() {
     server.aof_child_pid = -1;
     aofRewriteBufferReset();
     server.aof_buf = sdsempty();
+    server.aof_pipe_write_data_to_child = -1;
+    server.aof_pipe_read_data_from_parent = -1;
+    server.aof_pipe_write_ack_to_parent = -1;
+    server.aof_pipe_read_ack_from_child = -1;
+    server.aof_pipe_write_ack_to_child = -1;
+    server.aof_pipe_read_ack_from_parent = -1;
+    server.aof_stop_sending_diff = 0;
+    server.aof_child_diff = NULL;
+    server.aof_last_rewrite_diff_bytes = 0;
+    server.aof_last_rewrite_done_us = 0;
     server.lastsave = time(NULL); /* At startup we consider the DB saved. */
     server.lastbgsave_try = 0;    /* At startup we never tried to BGSAVE. */
     server.rdb_save_time_last = -1;
@@ -2398,6 +2481,13 @@ void initServer() {
 
     // ʼ BIO ϵͳ
     bioInit();
+    dictSetBackgroundAlloc(REDIS_DICT_BG_ALLOC_MIN,submitDictTableAlloc);
+
+    // ʼ AOF ύʹõ֪ͨܵ
+    aofGroupCommitInit();
+
+    //  io-threads  I/O ߳
+    initThreadedIO();
 }
 
 /* Populates the Redis Command Table starting from the hard coded list
@@ -2610,6 +2700,7 @@ void call(redisClient *c, int flags) {
     long long dirty, start, duration;
     // ¼ʼִǰ FLAG
     int client_old_flags = c->flags;
+    size_t aof_len;
 
     /* Sent the command to clients in MONITOR mode, only if the commands are
      * not generated from reading an AOF. */
@@ -2621,11 +2712,25 @@ void call(redisClient *c, int flags) {
         replicationFeedMonitors(c,server.monitors,c->db->id,c->argv,c->argc);
     }
 
+    /* A write command may touch the keys of a pending time sliced
+     * ZUNIONSTORE / ZINTERSTORE: complete it first, so that it is executed
+     * (and propagated) before this command and not as part of it. Scripts
+     * may touch any key, and are propagated as a whole, so they complete
+     * all the pending ones. */
+    // дܻ޸ڷƬִе ZUNIONSTORE / ZINTERSTORE ʹõļ
+    // Щ㣬֮ǰִУʹ
+    // űԷκμΪһ屻м
+    if (c->cmd->flags & REDIS_CMD_WRITE)
+        zsetAggrFinishJobsForCommand(c);
+    else if (c->cmd->proc == evalCommand || c->cmd->proc == evalShaCommand)
+        zsetAggrFinishJobs(NULL,NULL,0);
+
     /* Call the command. */
     c->flags &= ~(REDIS_FORCE_AOF|REDIS_FORCE_REPL);
     redisOpArrayInit(&server.also_propagate);
     //  dirty ֵ
     dirty = server.dirty;
+    aof_len = sdslen(server.aof_buf);
     // ʼִеʱ
     start = ustime();
   //Կִص󣬷ظͻ˵OKϢڸûص淵صģʱڸúpropagate
@@ -2706,6 +2811,11 @@ void call(redisClient *c, int flags) {
         }
         redisOpArrayFree(&server.also_propagate);
     }
+
+    /* If the command was written in the AOF buffer, with the AOF group
+     * commit its reply must wait for the fsync of the buffer. */
+    // д AOF  AOF ύʱظҪȴ fsync
+    if (sdslen(server.aof_buf) > aof_len) aofGroupCommitHoldClient(c);
     server.stat_numcommands++;
 }
 
@@ -3002,6 +3112,7 @@ void closeListeningSockets(int unlink_unix_socket) {
 int prepareForShutdown(int flags) {
     int save = flags & REDIS_SHUTDOWN_SAVE;
     int nosave = flags & REDIS_SHUTDOWN_NOSAVE;
+    int j;
 
     redisLog(REDIS_WARNING,"User requested shutdown...");
 
@@ -3052,6 +3163,19 @@ int prepareForShutdown(int flags) {
         unlink(server.pidfile);
     }
 
+    /* Remove the listening sockets from the event loop before closing
+     * them: with the io_uring backend a pending poll request keeps the
+     * socket open after close(), and new clients would still be accepted
+     * by the kernel until the process is gone. */
+    // ȴ¼ɾ׽֣ٹر
+    for (j = 0; j < server.ipfd_count; j++)
+        aeDeleteFileEvent(server.el,server.ipfd[j],AE_READABLE);
+    if (server.sofd != -1)
+        aeDeleteFileEvent(server.el,server.sofd,AE_READABLE);
+    if (server.cluster_enabled)
+        for (j = 0; j < server.cfd_count; j++)
+            aeDeleteFileEvent(server.el,server.cfd[j],AE_READABLE);
+
     /* Close the listening sockets. Apparently this allows faster restarts. */
     // رռ׽֣ʱһ
     closeListeningSockets(1);
@@ -3278,7 +3402,8 @@ sds genRedisInfoString(char *section) {
             "used_memory_peak_human:%s\r\n"
             "used_memory_lua:%lld\r\n"
             "mem_fragmentation_ratio:%.2f\r\n"
-            "mem_allocator:%s\r\n",
+            "mem_allocator:%s\r\n"
+            "total_allocations:%zu\r\n",
             zmalloc_used,
             hmem,
             server.resident_set_size,
@@ -3286,7 +3411,8 @@ sds genRedisInfoString(char *section) {
             peak_hmem,
             ((long long)lua_gc(server.lua,LUA_GCCOUNT,0))*1024LL,
             zmalloc_get_fragmentation_ratio(server.resident_set_size),
-            ZMALLOC_LIB
+            ZMALLOC_LIB,
+            zmalloc_alloc_calls()
             );
     }
 
@@ -3308,6 +3434,8 @@ sds genRedisInfoString(char *section) {
             "aof_last_rewrite_time_sec:%jd\r\n"
             "aof_current_rewrite_time_sec:%jd\r\n"
             "aof_last_bgrewrite_status:%s\r\n"
+            "aof_last_rewrite_diff_bytes:%lu\r\n"
+            "aof_last_rewrite_done_usec:%lld\r\n"
             "aof_last_write_status:%s\r\n",
             server.loading,
             server.dirty,
@@ -3324,6 +3452,8 @@ sds genRedisInfoString(char *section) {
             (intmax_t)((server.aof_child_pid == -1) ?
                 -1 : time(NULL)-server.aof_rewrite_time_start),
             (server.aof_lastbgrewrite_status == REDIS_OK) ? "ok" : "err",
+            server.aof_last_rewrite_diff_bytes,
+            server.aof_last_rewrite_done_us,
             (server.aof_last_write_status == REDIS_OK) ? "ok" : "err");
 
         if (server.aof_state != REDIS_AOF_OFF) {
@@ -3334,14 +3464,18 @@ sds genRedisInfoString(char *section) {
                 "aof_buffer_length:%zu\r\n"
                 "aof_rewrite_buffer_length:%lu\r\n"
                 "aof_pending_bio_fsync:%llu\r\n"
-                "aof_delayed_fsync:%lu\r\n",
+                "aof_delayed_fsync:%lu\r\n"
+                "aof_group_fsyncs:%lld\r\n"
+                "aof_fsync_waiting_clients:%lu\r\n",
                 (long long) server.aof_current_size,
                 (long long) server.aof_rewrite_base_size,
                 server.aof_rewrite_scheduled,
                 sdslen(server.aof_buf),
                 aofRewriteBufferSize(),
                 bioPendingJobsOfType(REDIS_BIO_AOF_FSYNC),
-                server.aof_delayed_fsync);
+                server.aof_delayed_fsync,
+                server.stat_aof_group_fsyncs,
+                listLength(server.aof_fsync_clients));
         }
 
         if (server.loading) {
@@ -3378,6 +3512,25 @@ sds genRedisInfoString(char *section) {
 
     /* Stats */
     if (allsections || defsections || !strcasecmp(section,"stats")) {
+        long rehashing = 0, pending_allocs = 0;
+        unsigned long long pending_keys = 0;
+
+        /* Progress of the incremental rehashing of the databases: the
+         * keys still in the old tables, and the tables being allocated
+         * by the bio thread. */
+        for (j = 0; j < server.dbnum; j++) {
+            dict *dicts[2] = {server.db[j].dict, server.db[j].expires};
+            int k;
+
+            for (k = 0; k < 2; k++) {
+                if (dictIsRehashing(dicts[k])) {
+                    rehashing++;
+                    pending_keys += dicts[k]->ht[0].used;
+                }
+                if (dictIsTablePending(dicts[k])) pending_allocs++;
+            }
+        }
+
         if (sections++) info = sdscat(info,"\r\n");
         info = sdscatprintf(info,
             "# Stats\r\n"
@@ -3395,7 +3548,19 @@ sds genRedisInfoString(char *section) {
             "pubsub_channels:%ld\r\n"
             "pubsub_patterns:%lu\r\n"
             "latest_fork_usec:%lld\r\n"
-            "migrate_cached_sockets:%ld\r\n",
+            "migrate_cached_sockets:%ld\r\n"
+            "io_threads_active:%d\r\n"
+            "io_threaded_reads_processed:%lld\r\n"
+            "io_threaded_writes_processed:%lld\r\n"
+            "total_reply_syscalls:%lld\r\n"
+            "total_replies_sent:%lld\r\n"
+            "syscalls_per_reply:%.2f\r\n"
+            "rehashing_dicts:%ld\r\n"
+            "rehash_pending_keys:%llu\r\n"
+            "rehash_pending_allocs:%ld\r\n"
+            "rehash_time_ms:%lld\r\n"
+            "zset_async_aggregations:%lld\r\n"
+            "zset_async_aggregations_pending:%lu\r\n",
             server.stat_numconnections,
             server.stat_numcommands,
             getOperationsPerSecond(),
@@ -3410,7 +3575,21 @@ sds genRedisInfoString(char *section) {
             dictSize(server.pubsub_channels),
             listLength(server.pubsub_patterns),
             server.stat_fork_time,
-            dictSize(server.migrate_cached_sockets));
+            dictSize(server.migrate_cached_sockets),
+            server.io_threads_num > 1,
+            server.stat_io_reads_processed,
+            server.stat_io_writes_processed,
+            server.stat_reply_syscalls,
+            server.stat_replies_sent,
+            server.stat_replies_sent ?
+                (double)server.stat_reply_syscalls/server.stat_replies_sent :
+                0,
+            rehashing,
+            pending_keys,
+            pending_allocs,
+            server.stat_rehash_time/1000,
+            server.stat_zset_aggr_async,
+            listLength(server.zset_aggr_jobs));
     }
 
     /* Replication */
@@ -3936,6 +4115,9 @@ int freeMemoryIfNeeded(void) {
                 long long delta;
 
                 robj *keyobj = createStringObject(bestkey,sdslen(bestkey));
+                /* Pending aggregations reading the key must complete
+                 * before the DEL is propagated. */
+                zsetAggrFinishJobs(db,keyobj,1);
                 propagateExpire(db,keyobj);
                 /* We compute the amount of memory freed by dbDelete() alone.
                  * It is possible that actually the memory needed to propagate
@@ -4194,6 +4376,9 @@ int main(int argc, char **argv) {
     srand(time(NULL)^getpid());
     gettimeofday(&tv,NULL);
     dictSetHashFunctionSeed(tv.tv_sec^tv.tv_usec^getpid());
+    intsetInitSearch();
+    bitopsInitKernels();
+    hllInitKernels();
 
     // Ƿ Sentinel ģʽ
     server.sentinel_mode = checkForSentinelMode(argc,argv);
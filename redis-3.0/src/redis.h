@@ -58,6 +58,8 @@
 #include "zmalloc.h" /* total memory usage aware version of malloc/free */
 #include "anet.h"    /* Networking the easy way */
 #include "ziplist.h" /* Compact list data structure */
+#include "listpack.h" /* Compact list data structure without cascade updates */
+#include "quicklist.h" /* Lists are encoded as linked lists of listpacks */
 #include "intset.h"  /* Compact integer set structure */
 #include "version.h" /* Version macro */
 #include "util.h"    /* Misc functions useful in many places */
@@ -80,9 +82,12 @@
 #define REDIS_DEFAULT_DBNUM     16
 #define REDIS_CONFIGLINE_MAX    1024
 #define REDIS_DBCRON_DBS_PER_CALL 16
+#define REDIS_REHASH_CRON_BUDGET 1000 /* Active rehash microseconds when busy. */
+#define REDIS_DICT_BG_ALLOC_MIN (16*1024*1024) /* Bigger tables allocated by bio. */
 #define REDIS_MAX_WRITE_PER_EVENT (1024*64)
 #define REDIS_SHARED_SELECT_CMDS 10
 #define REDIS_SHARED_INTEGERS 10000
+#define REDIS_SHARED_REFCOUNT INT_MAX /* Objects never released, see object.c */
 #define REDIS_SHARED_BULKHDR_LEN 32
 #define REDIS_MAX_LOGMSG_LEN    1024 /* Default maximum length of syslog messages */
 #define REDIS_AOF_REWRITE_PERC  100
@@ -120,12 +125,19 @@ SADD <set-key> <elem129> <elem130>  ~ ~ ~  <elem192>
 #define REDIS_DEFAULT_DAEMONIZE 0
 #define REDIS_DEFAULT_UNIX_SOCKET_PERM 0
 #define REDIS_DEFAULT_TCP_KEEPALIVE 0
+#define REDIS_DEFAULT_IO_THREADS 1      /* Threaded I/O disabled by default. */
+#define REDIS_IO_THREADS_MAX 128
+#define REDIS_DEFAULT_IO_URING 1        /* Used only if compiled with it. */
 #define REDIS_DEFAULT_LOGFILE ""
 #define REDIS_DEFAULT_SYSLOG_ENABLED 0
 #define REDIS_DEFAULT_STOP_WRITES_ON_BGSAVE_ERROR 1
-#define REDIS_DEFAULT_RDB_COMPRESSION 1
+#define REDIS_DEFAULT_RDB_COMPRESSION REDIS_RDB_COMPRESSION_LZF
 #define REDIS_DEFAULT_RDB_CHECKSUM 1
 #define REDIS_DEFAULT_RDB_FILENAME "dump.rdb"
+#define REDIS_DEFAULT_RDB_LOAD_THREADS 0 /* Serial RDB loading by default. */
+#define REDIS_RDB_LOAD_THREADS_MAX 64
+#define REDIS_DEFAULT_RDB_SAVE_THREADS 0 /* Classic single stream RDB. */
+#define REDIS_RDB_SAVE_THREADS_MAX 64
 #define REDIS_DEFAULT_SLAVE_SERVE_STALE_DATA 1
 #define REDIS_DEFAULT_SLAVE_READ_ONLY 1
 #define REDIS_DEFAULT_REPL_DISABLE_TCP_NODELAY 0
@@ -135,6 +147,7 @@ SADD <set-key> <elem129> <elem130>  ~ ~ ~  <elem192>
 #define REDIS_DEFAULT_AOF_NO_FSYNC_ON_REWRITE 0
 #define REDIS_DEFAULT_ACTIVE_REHASHING 1
 #define REDIS_DEFAULT_AOF_REWRITE_INCREMENTAL_FSYNC 1
+#define REDIS_DEFAULT_AOF_GROUP_COMMIT 0
 #define REDIS_DEFAULT_MIN_SLAVES_TO_WRITE 0
 #define REDIS_DEFAULT_MIN_SLAVES_MAX_LAG 10
 #define REDIS_IP_STR_LEN INET6_ADDRSTRLEN
@@ -148,12 +161,18 @@ SADD <set-key> <elem129> <elem130>  ~ ~ ~  <elem192>
 #define ACTIVE_EXPIRE_CYCLE_SLOW 0
 #define ACTIVE_EXPIRE_CYCLE_FAST 1
 
+#define REDIS_ZSET_AGGR_SLICE_DURATION 1000 /* Microseconds */
+
 /* Protocol and I/O related defines */
 #define REDIS_MAX_QUERYBUF_LEN  (1024*1024*1024) /* 1GB max query buffer. */
 #define REDIS_IOBUF_LEN         (1024*16)  /* Generic I/O buffer size */
 #define REDIS_REPLY_CHUNK_BYTES (16*1024) /* 16k output buffer */
+#define REDIS_REPLY_ZEROCOPY_BYTES (1024*4) /* Bigger values aren't copied. */
 #define REDIS_INLINE_MAX_SIZE   (1024*64) /* Max size of inline reads */
 #define REDIS_MBULK_BIG_ARG     (1024*32)
+#define REDIS_ARGV_CACHE_SIZE   8      /* Arguments recycled per client. */
+#define REDIS_ARGV_CACHE_MAX_LEN 64    /* Bigger arguments aren't recycled. */
+#define REDIS_LOOKUP_BATCH      16     /* Keys looked up at once, see db.c */
 #define REDIS_LONGSTR_SIZE      21          /* Bytes needed for long -> str */
 // ָʾ AOF ÿۻд
 // ִһʽ fsync
@@ -241,33 +260,34 @@ TYPE 
 REDIS_STRING    REDIS_ENCODING_INT ʹֵʵֵַ 
 REDIS_STRING    REDIS_ENCODING_EMBSTR ʹ embstr ļ򵥶ַ̬ʵֵַ 
 REDIS_STRING    REDIS_ENCODING_RAW ʹü򵥶ַ̬ʵֵַ 
-REDIS_LIST      REDIS_ENCODING_ZIPLIST ʹѹбʵֵб 
-REDIS_LIST      REDIS_ENCODING_LINKEDLIST ʹ˫ʵֵб 
-REDIS_HASH      REDIS_ENCODING_ZIPLIST ʹѹбʵֵĹϣ 
+REDIS_LIST      REDIS_ENCODING_LISTPACK ʹ listpack ʵֵб 
+REDIS_LIST      REDIS_ENCODING_QUICKLIST ʹ quicklist ʵֵб 
+REDIS_HASH      REDIS_ENCODING_LISTPACK ʹ listpack ʵֵĹϣ 
 REDIS_HASH      REDIS_ENCODING_HT ʹֵʵֵĹϣ 
 REDIS_SET       REDIS_ENCODING_INTSET ʹʵֵļ϶ 
 REDIS_SET       REDIS_ENCODING_HT ʹֵʵֵļ϶ 
-REDIS_ZSET      REDIS_ENCODING_ZIPLIST ʹѹбʵֵ򼯺϶ 
+REDIS_ZSET      REDIS_ENCODING_LISTPACK ʹ listpack ʵֵ򼯺϶ 
 REDIS_ZSET      REDIS_ENCODING_SKIPLIST ʹԾֵʵֵ򼯺϶ 
+REDIS_ZSET      REDIS_ENCODING_BTREE ʹ B+ ֵʵֵ򼯺϶ 
 */
 
 /* Object types */
 // 
 /*
 ַı REDIS_ENCODING_RAW  REDIS_ENCODING_EMBSTR REDIS_ENCODING_INT  ַ֣ΪREDIS_ENCODING_INT
-ַ󱣴һֵַ ֵַĳȴ 39 ֽڣ ñ뷽ʽREDIS_ENCODING_EMBSTRñ뷽ʽREDIS_ENCODING_RAW
+ַ󱣴һֵַ ֵַĳȴ 44 ֽڣ ñ뷽ʽREDIS_ENCODING_EMBSTRñ뷽ʽREDIS_ENCODING_RAW
 */
 #define REDIS_STRING 0 //οsetsetCommandִ
 
 /*
-бı뷽ʽREDIS_ENCODING_LINKEDLIST˫бREDIS_ENCODING_ZIPLISTѹĬREDIS_ENCODING_ZIPLIST,ʱ
-ʹ˫б뷽ʽ
+бı뷽ʽREDIS_ENCODING_QUICKLISTREDIS_ENCODING_LISTPACKĬREDIS_ENCODING_LISTPACK,ʱ
+ʹ quicklist 뷽ʽ
 
-бͬʱʱ бʹ ziplist 룺
+бͬʱʱ бʹ listpack 룺
 1.б󱣴ַԪصĳȶС 64 ֽڣ
 2.б󱣴ԪС 512 
 
-бҪʹ linkedlist 롣
+бҪʹ quicklist 롣
 */
 #define REDIS_LIST 1 //οlpushlpushCommandִ
 
@@ -300,7 +320,7 @@ REDIS_ZSET      REDIS_ENCODING_SKIPLIST ʹ
 #define REDIS_ZSET 3//οzaddzaddCommandִ
 
 /*
-ϣı ziplist(REDIS_ENCODING_ZIPLIST)  hashtable(REDIS_ENCODING_HT) 
+ϣı listpack(REDIS_ENCODING_LISTPACK)  hashtable(REDIS_ENCODING_HT) 
 ת: ĬʹREDIS_ENCODING_ZIPLIST뷽ʽΪREDIS_ENCODING_HT뷽ʽ
 
 ϣͬʱʱ ϣʹ ziplist 룺
@@ -320,15 +340,16 @@ REDIS_ZSET      REDIS_ENCODING_SKIPLIST ʹ
  REDIS_ENCODING_EMBSTR                  embstr ļ򵥶ַ̬ 
  REDIS_ENCODING_RAW                     򵥶ַ̬ 
  REDIS_ENCODING_HT                      ֵ 
- REDIS_ENCODING_LINKEDLIST              ˫ 
- REDIS_ENCODING_ZIPLIST                 ѹб 
+ REDIS_ENCODING_LISTPACK                listpack 
+ REDIS_ENCODING_QUICKLIST                listpack ɵ˫ 
  REDIS_ENCODING_INTSET                   
  REDIS_ENCODING_SKIPLIST                Ծ
+ REDIS_ENCODING_BTREE                    B+ 
 
  REDIS_ENCODING_EMBSTRREDIS_ENCODING_RAW?
- REDIS_ENCODING_RAW:ַ󱣴һֵַ ֵַĳȴ 39 ֽڣ ôַʹһ򵥶ַ̬SDS
+ REDIS_ENCODING_RAW:ַ󱣴һֵַ ֵַĳȴ 44 ֽڣ ôַʹһ򵥶ַ̬SDS
                     ֵַ ıΪ raw 
- REDIS_ENCODING_EMBSTR:ַ󱣴һֵַ ֵַĳСڵ 39 ֽڣ ôַʹ embstr ķʽ
+ REDIS_ENCODING_EMBSTR:ַ󱣴һֵַ ֵַĳСڵ 44 ֽڣ ôַʹ embstr ķʽ
                        ֵַ
 
     embstr רڱַһŻ뷽ʽ ֱ raw һ ʹ redisObject ṹ sdshdr ṹʾַ 
@@ -358,17 +379,18 @@ REDIS_ZSET      REDIS_ENCODING_SKIPLIST ʹ
  REDIS_STRING           REDIS_ENCODING_EMBSTR           ʹ embstr ļ򵥶ַ̬ʵֵַ 
  REDIS_STRING           REDIS_ENCODING_RAW              ʹü򵥶ַ̬ʵֵַ 
  
- REDIS_LIST             REDIS_ENCODING_ZIPLIST          ʹѹбʵֵб 
- REDIS_LIST             REDIS_ENCODING_LINKEDLIST       ʹ˫ʵֵб 
+ REDIS_LIST             REDIS_ENCODING_LISTPACK          ʹ listpack ʵֵб 
+ REDIS_LIST             REDIS_ENCODING_QUICKLIST        ʹ quicklist ʵֵб 
  
- REDIS_HASH             REDIS_ENCODING_ZIPLIST          ʹѹбʵֵĹϣ 
+ REDIS_HASH             REDIS_ENCODING_LISTPACK          ʹ listpack ʵֵĹϣ 
  REDIS_HASH             REDIS_ENCODING_HT               ʹֵʵֵĹϣ
  
  REDIS_SET              REDIS_ENCODING_INTSET           ʹʵֵļ϶ 
  REDIS_SET              REDIS_ENCODING_HT               ʹֵʵֵļ϶ 
  
- REDIS_ZSET             REDIS_ENCODING_ZIPLIST          ʹѹбʵֵ򼯺϶ 
+ REDIS_ZSET             REDIS_ENCODING_LISTPACK          ʹ listpack ʵֵ򼯺϶ 
  REDIS_ZSET             REDIS_ENCODING_SKIPLIST         ʹԾֵʵֵ򼯺϶ 
+ REDIS_ZSET             REDIS_ENCODING_BTREE            ʹ B+ ֵʵֵ򼯺϶ 
  
  ʹ OBJECT ENCODING Բ鿴һݿֵı룺
  
@@ -379,11 +401,12 @@ REDIS_ZSET      REDIS_ENCODING_SKIPLIST ʹ
                                    REDIS_ENCODING_INT           "int"           createStringObjectFromLongLong createIntsetObject tryObjectEncoding
 embstr ļ򵥶ַ̬SDS     REDIS_ENCODING_EMBSTR        "embstr"        createEmbeddedStringObject
 򵥶ַ̬                         REDIS_ENCODING_RAW           "raw"           createObject
-ֵ                                   REDIS_ENCODING_HT            "hashtable"     createSetObject  hashTypeConvertZiplist
-˫                               REDIS_ENCODING_LINKEDLIST    "linkedlist"    createListObject
-ѹб                               REDIS_ENCODING_ZIPLIST       "ziplist"       createZiplistObject createHashObject createZsetZiplistObject
+ֵ                                   REDIS_ENCODING_HT            "hashtable"     createSetObject  hashTypeConvertListpack
+quicklist                              REDIS_ENCODING_QUICKLIST     "quicklist"     createQuicklistObject
+listpack                               REDIS_ENCODING_LISTPACK       "listpack"      createListpackObject createHashObject createZsetListpackObject
                                REDIS_ENCODING_INTSET        "intset"        createIntsetObject
 Ծֵ                           REDIS_ENCODING_SKIPLIST      "skiplist"      createZsetObject
+B+ ֵ                            REDIS_ENCODING_BTREE         "btree"         createZsetObject
 
 
     ͨ encoding 趨ʹõı룬 Ϊض͵Ķһ̶ֹı룬  Redis ԺЧʣ Ϊ 
@@ -411,10 +434,10 @@ Redis 
 
 
 /*
-ַ󱣴һֵַ ֵַĳȴ 39 ֽڣ ôַʹһ򵥶ַ̬SDSֵַ ıΪ raw 
+ַ󱣴һֵַ ֵַĳȴ 44 ֽڣ ôַʹһ򵥶ַ̬SDSֵַ ıΪ raw 
 */
 #define REDIS_ENCODING_RAW 0     /* Raw representation */ //REDIS_ENCODING_EMBSTRREDIS_ENCODING_RAW뷽ʽcreateStringObject
-//key valueַС39ֽ REDIS_ENCODING_EMBSTR_SIZE_LIMITʹøͱ룬createStringObject
+//key valueַȲ44ֽ REDIS_ENCODING_EMBSTR_SIZE_LIMITʹøͱ룬createStringObject
 #define REDIS_ENCODING_EMBSTR 8  /* Embedded sds string encoding */  //REDIS_ENCODING_EMBSTRREDIS_ENCODING_RAW뷽ʽcreateStringObject
 
 
@@ -430,23 +453,29 @@ Redis 
 1.б󱣴ַԪصĳȶС 64 ֽڣ
 2.б󱣴ԪС 512 
 
-бҪʹ linkedlist 롣
+бҪʹ quicklist 롣
 
-lpushͨpushGenericCommand->createZiplistObjectб(Ĭϱ뷽ʽREDIS_ENCODING_ZIPLIST)ȻlistTypePush->listTypeTryConversion
-бнڵǷòlist_max_ziplist_value(Ĭ64)valueбֵѹΪ˫뷽ʽREDIS_ENCODING_LINKEDLISTlistTypePush->listTypeConvert
+lpushͨpushGenericCommand->createListpackObjectб(Ĭϱ뷽ʽREDIS_ENCODING_LISTPACK)ȻlistTypePush->listTypeTryConversion
+бнڵǷòlist_max_ziplist_value(Ĭ64)б listpack Ϊ뷽ʽREDIS_ENCODING_QUICKLISTlistTypePush->listTypeConvert
 */
-#define REDIS_ENCODING_LINKEDLIST 4 /* Encoded as regular linked list */
+#define REDIS_ENCODING_LINKEDLIST 4 /* No longer used: old list encoding. */
+// бʹ quicklist 
 /*
-lpushͨpushGenericCommand->createZiplistObjectб(Ĭϱ뷽ʽREDIS_ENCODING_ZIPLIST)ȻlistTypePush->listTypeTryConversion
-бнڵַǷòlist_max_ziplist_value(Ĭ64)valueбֵѹΪ˫뷽ʽREDIS_ENCODING_LINKEDLISTlistTypePush->listTypeConvert
+lpushͨpushGenericCommand->createListpackObjectб(Ĭϱ뷽ʽREDIS_ENCODING_LISTPACK)ȻlistTypePush->listTypeTryConversion
+бнڵַǷòlist_max_ziplist_value(Ĭ64)б listpack Ϊ뷽ʽREDIS_ENCODING_QUICKLISTlistTypePush->listTypeConvert
 */
-#define REDIS_ENCODING_ZIPLIST 5 /* Encoded as ziplist */
+#define REDIS_ENCODING_ZIPLIST 5 /* No longer used: old list/hash/zset encoding. */
+// ziplist Ѿ listpack 棬 RDB ʱתΪ listpack 
+#define REDIS_ENCODING_LISTPACK 9 /* Encoded as listpack */
+#define REDIS_ENCODING_QUICKLIST 10 /* Encoded as linked list of listpacks */
 
 
 
 #define REDIS_ENCODING_INTSET 6  /* Encoded as intset */
 //skiplist 򼯺϶ʹ zset ṹΪײʵ֣ һ zset ṹͬʱһֵһԾ
 #define REDIS_ENCODING_SKIPLIST 7  /* Encoded as skiplist */
+// btree 򼯺϶ʹ zset ṹΪײʵ֣ һ zset ṹͬʱһֵһ B+ 
+#define REDIS_ENCODING_BTREE 11  /* Encoded as order statistic B+tree */
 
 /* Defines related to the dump file format. To store 32 bits lengths for short
  * keys requires a lot of space, so we check the most significant 2 bits of
@@ -474,6 +503,16 @@ lpush
 #define REDIS_RDB_ENC_INT16 1       /* 16 bit signed integer */
 #define REDIS_RDB_ENC_INT32 2       /* 32 bit signed integer */
 #define REDIS_RDB_ENC_LZF 3         /* string compressed with FASTLZ */
+#define REDIS_RDB_ENC_LZ4 4         /* string compressed with LZ4 */
+#define REDIS_RDB_ENC_ZSTD 5        /* string compressed with zstd */
+
+/* Codecs of the rdbcompression option, 'yes' being LZF.
+ *
+ * rdbcompression ѡѡѹ㷨 yes  LZF */
+#define REDIS_RDB_COMPRESSION_NO 0
+#define REDIS_RDB_COMPRESSION_LZF 1
+#define REDIS_RDB_COMPRESSION_LZ4 2
+#define REDIS_RDB_COMPRESSION_ZSTD 3
 
 /* AOF states */
 #define REDIS_AOF_OFF 0             /* AOF is off */
@@ -547,12 +586,21 @@ EXEC
 // ޷ʹ PSYNC ҪӦıʶֵ
 #define REDIS_PRE_PSYNC (1<<16)   /* Instance don't understand PSYNC. */
 #define REDIS_READONLY (1<<17)    /* Cluster client is in read-only state. */
+// ͻ˵Ķ¼Ƴٵ beforeSleep()  I/O ̴߳
+#define REDIS_PENDING_READ (1<<18) /* Read deferred to the I/O threads. */
+// ͻ˵Ļظȴ beforeSleep()  I/O ߳д
+#define REDIS_PENDING_WRITE (1<<19) /* Reply queued for the I/O threads. */
+// argv  I/O ߳̽õȴִ߳
+#define REDIS_PENDING_COMMAND (1<<20) /* argv holds a parsed, unexecuted cmd. */
+// ͻ˵Ļظֱ AOF ĺ̨ fsync ɣaof-group-commit
+#define REDIS_AOF_FSYNC_WAIT (1<<21) /* Reply held until the AOF is fsynced. */
 
 /* Client block type (btype field in client structure)
  * if REDIS_BLOCKED flag is set. */
 #define REDIS_BLOCKED_NONE 0    /* Not blocked, no REDIS_BLOCKED flag set. */
 #define REDIS_BLOCKED_LIST 1    /* BLPOP & co. */
 #define REDIS_BLOCKED_WAIT 2    /* WAIT for synchronous replication. */
+#define REDIS_BLOCKED_ZSET_AGGR 3 /* Big ZUNIONSTORE / ZINTERSTORE. */
 
 /* Client request types */
 #define REDIS_REQ_INLINE 1 
@@ -613,6 +661,7 @@ EXEC
 
 #define ZSKIPLIST_MAXLEVEL 32 /* Should be enough for 2^32 elements */
 #define ZSKIPLIST_P 0.25      /* Skiplist P = 1/4 */
+#define ZBTREE_NODE_SIZE 64   /* Max entries / children of a B+tree node */
 
 /* Append only defines */
 #define AOF_FSYNC_NO 0
@@ -625,9 +674,13 @@ EXEC
 #define REDIS_HASH_MAX_ZIPLIST_VALUE 64
 #define REDIS_LIST_MAX_ZIPLIST_ENTRIES 512
 #define REDIS_LIST_MAX_ZIPLIST_VALUE 64
+#define REDIS_LIST_MAX_ZIPLIST_SIZE -2
+#define REDIS_LIST_COMPRESS_DEPTH 0
 #define REDIS_SET_MAX_INTSET_ENTRIES 512
 #define REDIS_ZSET_MAX_ZIPLIST_ENTRIES 128
 #define REDIS_ZSET_MAX_ZIPLIST_VALUE 64
+#define REDIS_DEFAULT_ZSET_BTREE 0
+#define REDIS_DEFAULT_ZSET_ASYNC_AGGREGATE_THRESHOLD 1000000
 
 /* HyperLogLog defines */
 #define REDIS_DEFAULT_HLL_SPARSE_MAX_BYTES 3000
@@ -759,17 +812,18 @@ typedef struct redisObject { //key value
      */
     // ֵָ   ptr ָָĵײʵݽṹ Щݽṹɶ encoding Ծ
     // ָʵֵָ  οcreateObjectĵطֵ
-    //ԲοcreateStringObject(ptrָsdsnewlen)  createListObject(ptrָlist) ȵȣÿtypeͿԶֱ뷽ʽ
+    //ԲοcreateStringObject(ptrָsdsnewlen)  createQuicklistObject(ptrָquicklist) ȵȣÿtypeͿԶֱ뷽ʽ
 
     /*  
                                         REDIS_ENCODING_INT           "int"           createStringObjectFromLongLong createIntsetObject tryObjectEncoding
      embstr ļ򵥶ַ̬SDS     REDIS_ENCODING_EMBSTR        "embstr"        createEmbeddedStringObject
      򵥶ַ̬                         REDIS_ENCODING_RAW           "raw"           createObject
-     ֵ                                   REDIS_ENCODING_HT            "hashtable"     createSetObject  hashTypeConvertZiplist  hashTypeConvertZiplist
-     ˫                               REDIS_ENCODING_LINKEDLIST    "linkedlist"    createListObject
-     ѹб                               REDIS_ENCODING_ZIPLIST       "ziplist"       createZiplistObject createHashObject createZsetZiplistObject
+     ֵ                                   REDIS_ENCODING_HT            "hashtable"     createSetObject  hashTypeConvertListpack  hashTypeConvertListpack
+     quicklist                              REDIS_ENCODING_QUICKLIST     "quicklist"     createQuicklistObject
+     listpack                               REDIS_ENCODING_LISTPACK       "listpack"      createListpackObject createHashObject createZsetListpackObject
                                     REDIS_ENCODING_INTSET        "intset"        createIntsetObject
      Ծֵ                           REDIS_ENCODING_SKIPLIST      "skiplist"      createZsetObject
+     B+ ֵ                            REDIS_ENCODING_BTREE         "btree"         createZsetObject
     */ //ֵcreateObject
     void *ptr;//Ǵ10000ֱַתΪREDIS_ENCODING_INT뷽ʽ洢tryObjectEncodingֱָ洢Ӧַַ
 
@@ -992,6 +1046,9 @@ typedef struct redisClient {   //redisServer
     // ѯȷֵ  querybufжȡĿͻݳ   querybufݳȵķֵ
     size_t querybuf_peak;   /* Recent (100ms or more) peak of querybuf size */
 
+    // ѯѽݵĳȣһԴӻɾ
+    size_t qb_pos;          /* Parsed bytes at the head of querybuf */
+
     /*
     ڷͻ˷͵󱣴浽ͻ״̬querybuf֮󣬷ݽзóԼ
 ĸֱ𱣴浽ͻ״̬argvԺargcԣͻ:set yang xxxargc=3,argv[0]Ϊsetargv[1]Ϊyang argv[2]Ϊxxx
@@ -1007,6 +1064,12 @@ typedef struct redisClient {   //redisServer
     //   resetClient->freeClientArgvͷſռ
     robj **argv; //ͻprocessMultibulkBuffer  ռ͸ֵprocessMultibulkBufferжٸmultibulklenʹٸrobj(redisObject)洢Ľṹ
 
+    // argv ĴСܴ argc ֮
+    int argv_len;           /* Size of the argv array, may be > argc. */
+
+    // һĲ󣬽һʱã freeClientArgv
+    robj *argv_cache[REDIS_ARGV_CACHE_SIZE];
+
     /*
     гɹҵargv[0]ӦredisCommandṹʱὫͻ״̬cmdָָṹ
     //redisServer->orig_commands redisServer->commands(populateCommandTable)ֵеԪݴredisCommandTableлȡ processCommand->lookupCommand
@@ -1131,6 +1194,9 @@ typedef struct redisClient {   //redisServer
     // дȫָƫ
     long long woff;         /* Last write global replication offset. */
 
+    // ظʱҪȴ fsync ɵ AOF д
+    unsigned long long aof_fsync_seq; /* AOF write to fsync before replying. */
+
     // ӵļ
     list *watched_keys;     /* Keys WATCHED for MULTI/EXEC CAS */
 
@@ -1145,6 +1211,18 @@ typedef struct redisClient {   //redisServer
     list *pubsub_patterns;  /* patterns a client is interested in (SUBSCRIBE) */
     sds peerid;             /* Cached peer ID. */
 
+    /* Threaded I/O state. Written by an I/O thread while the client sits in
+     * one of the pending lists, then consumed by the main thread.
+     *
+     * ̻߳ I/O Ľ I/O ߳д߳ beforeSleep() д */
+    int io_nread;           /* read(2) result, EAGAIN already mapped to 0. */
+    int io_errno;           /* errno of the failed read(2)/write(2), or 0. */
+    int io_sentnodes;       /* Reply list nodes fully written by the thread. */
+    int io_sentbuf;         /* 1 if the static buffer was fully written. */
+    int io_writecalls;      /* writev(2) calls done by the last write. */
+    size_t io_written;      /* Bytes written by the last threaded write. */
+    sds io_protoerr;        /* Protocol error found while parsing, or NULL. */
+
     /*
      ִõظᱻڿͻ״̬棬ÿͻ˶ãһĴСǹ̶ģ
  һĴСǿɱģڹ̶СĻڱЩȱȽСĻظOK̵ֵֵַظȵȡ
@@ -1279,6 +1357,87 @@ typedef struct zskiplist { //zslCreate
 
 } zskiplist;
 
+/* Sorted sets can also be indexed by an order statistic B+tree. Leaves keep
+ * up to ZBTREE_NODE_SIZE (score, member) pairs in two parallel arrays, so a
+ * range scan reads memory sequentially instead of chasing a pointer per
+ * element, and are linked together to be iterated in both directions.
+ *
+ * 򼯺Ҳʹô B+ Ϊ
+ * Ҷӽڵб ZBTREE_NODE_SIZE ֵԱԣ
+ * Χʱ˳ڴ棬ΪÿԪ׷һָ롣
+ * Ҷӽڵ֮ͨ˫ӣԴб
+ */
+typedef struct zbtreeLeaf {
+
+    // ǰһͺһҶӽڵ
+    struct zbtreeLeaf *prev, *next;
+
+    // ڵбԪ
+    int count;
+
+    // ֵԱԪ
+    double score[ZBTREE_NODE_SIZE];
+    robj *obj[ZBTREE_NODE_SIZE];
+
+} zbtreeLeaf;
+
+/* Inner nodes route lookups to their children. score[i] / obj[i] (i > 0) is
+ * a lower bound of every element in child[i] and is greater than every
+ * element in child[i-1]: it is the first element the child held when the
+ * separator was created, and the member object is shared with a reference
+ * of its own. size[i] is the number of elements under child[i], so the rank
+ * of an element is the sum of the sizes skipped on the way down.
+ *
+ * ڲڵ㸺𽫲·ɵӽڵ㡣
+ * score[i]  obj[i] i > 0 child[i] Ԫص½磬Ҵ child[i-1] еԪأ
+ * Աͨü
+ * size[i] ¼ child[i] ֮µԪʱۼԽСͿԵõλ
+ */
+typedef struct zbtreeInner {
+
+    // ӽڵ
+    int count;
+
+    // ָ score[0]  obj[0] ʹ
+    double score[ZBTREE_NODE_SIZE];
+    robj *obj[ZBTREE_NODE_SIZE];
+
+    // еԪ
+    unsigned long size[ZBTREE_NODE_SIZE];
+
+    // ӽڵ㣬height Ϊ 1 ʱָҶӽڵ
+    void *child[ZBTREE_NODE_SIZE];
+
+} zbtreeInner;
+
+/*
+ * B+ 
+ */
+typedef struct zbtree {
+
+    // ڵ㣬 height Ϊ 0 ʱڵһҶӽڵ
+    void *root;
+
+    // ڲڵĲ
+    int height;
+
+    // Ԫ
+    unsigned long length;
+
+    // һһҶӽڵ
+    zbtreeLeaf *head, *tail;
+
+} zbtree;
+
+/* Position of an element in a B+tree, valid until the tree is modified. */
+typedef struct zbtreeIter {
+    zbtreeLeaf *leaf;
+    int idx;
+} zbtreeIter;
+
+#define zbtIterScore(it) ((it)->leaf->score[(it)->idx])
+#define zbtIterObj(it) ((it)->leaf->obj[(it)->idx])
+
 /*
 Ϊʲô򼯺ҪͬʱʹԾֵʵ֣
 
@@ -1307,8 +1466,12 @@ typedef struct zset {
     // ԾֵԱ
     // ֧ƽӶΪ O(log N) İֵλԱ
     // ԼΧ
+    // Ϊ BTREE ʱΪ NULL
     zskiplist *zsl;
 
+    // B+ ֻڶΪ BTREE ʱʹãΪ NULL
+    zbtree *zbt;
+
 } zset;
 
 // ͻ˻
@@ -1472,6 +1635,9 @@ struct redisServer {//struct redisServer server;
     list *clients;               /* List of active clients */
     // дرյĿͻ
     list *clients_to_close;     /* Clients to close asynchronously */
+    // ȴ I/O ̶߳ȡ/дĿͻˣ beforeSleep()
+    list *clients_pending_read; /* Clients with reads deferred to I/O threads */
+    list *clients_pending_write;/* Clients with replies to be written */
 
     // дӷ
     list *slaves,  //עпܴӷ滹ҽӴӷ
@@ -1559,6 +1725,21 @@ struct redisServer {//struct redisServer server;
     // PSYNC ִʧܵĴ
     long long stat_sync_partial_err;/* Number of unaccepted PSYNC requests. */
 
+    // ̻߳ I/O ·Ķ/д
+    long long stat_io_reads_processed;  /* Reads handled by threaded I/O. */
+    long long stat_io_writes_processed; /* Writes handled by threaded I/O. */
+
+    // дظʱִеϵͳôԼдĻظ
+    // ÿдľ̬ظڵһظ
+    long long stat_reply_syscalls;  /* Write syscalls used to send replies. */
+    long long stat_replies_sent;    /* Output buffers and reply nodes sent. */
+
+    //  rehash ĵʱ䣨΢룩
+    long long stat_rehash_time;     /* Microseconds spent in active rehashing. */
+
+    // Ƭִɵ ZUNIONSTORE / ZINTERSTORE 
+    long long stat_zset_aggr_async; /* Time sliced ZUNIONSTORE/ZINTERSTORE. */
+
 
     /* slowlog */
 
@@ -1618,6 +1799,10 @@ struct redisServer {//struct redisServer server;
     */
     // Ƿ SO_KEEPALIVE ѡ  tcp-keepalive ãĬϲ
     int tcpkeepalive;               /* Set SO_KEEPALIVE if non-zero. */
+    // I/O ̣߳߳io-threads ãĬΪ 1 
+    int io_threads_num;             /* Number of I/O threads, 1 = disabled. */
+    // ʱ io_uring ֵ֧£Ƿʹ io_uring io-uring 
+    int io_uring;                   /* Use io_uring for the event loop. */
     //ĬϳʼΪ1
     int active_expire_enabled;      /* Can be disabled for testing purposes. */
     size_t client_max_querybuf_len; /* Limit for client query buffer length */ //REDIS_MAX_QUERYBUF_LEN
@@ -1704,6 +1889,41 @@ struct redisServer {//struct redisServer server;
     //ֻflushAppendOnlyFileʧܵʱŻREDIS_ERR  һ㶼ڴ治ߴ̿ռ䲻ʱERR
     int aof_last_write_status;      /* REDIS_OK or REDIS_ERR */
     int aof_last_write_errno;       /* Valid if aof_last_write_status is ERR */
+    /* AOF pipes used to communicate between parent and child during rewrite. */
+    // AOF дڼ丸̺ӽ֮ͨʹõĹܵ
+    int aof_pipe_write_data_to_child;
+    int aof_pipe_read_data_from_parent;
+    int aof_pipe_write_ack_to_parent;
+    int aof_pipe_read_ack_from_child;
+    int aof_pipe_write_ack_to_child;
+    int aof_pipe_read_ack_from_parent;
+    // Ϊʱֹͣӽ̷Ͳ
+    int aof_stop_sending_diff;     /* If true stop sending accumulated diffs
+                                      to child process. */
+    // ӽ̽յĲ
+    sds aof_child_diff;             /* AOF diff accumulator child side. */
+    // һдʱдĲСԼдʱ
+    unsigned long aof_last_rewrite_diff_bytes; /* Diff flushed by the parent. */
+    long long aof_last_rewrite_done_us; /* Time to finish the last rewrite. */
+    /* AOF group commit: with appendfsync always the fsync is performed by a
+     * bio thread and the replies of the commands written to the AOF are
+     * held until it completes, so a single fsync acknowledges all the
+     * writes performed while the previous one was in progress.
+     *
+     * AOF ύappendfsync always ʱɺִ̨߳ fsync 
+     * д AOF Ļظ fsync Ϊֹ
+     * һ fsync ȷһ fsync ڼִед */
+    int aof_group_commit;           /* aof-group-commit option. */
+    // ִе AOF write Լ֪д̵ write 
+    unsigned long long aof_write_seq;   /* AOF buffer writes performed. */
+    unsigned long long aof_fsynced_seq; /* Writes known to be on disk. */
+    // ִ̨е fsync ǵ write ţΪ 0 ʾû
+    unsigned long long aof_fsync_pending_seq; /* Covered by the bio fsync. */
+    // ظĿͻ
+    list *aof_fsync_clients;        /* Clients waiting for the fsync. */
+    // bio ֪߳ͨ߳ fsync ʹõĹܵ
+    int aof_fsync_ack_pipe[2];      /* bio thread -> main thread acks. */
+    long long stat_aof_group_fsyncs; /* Number of group commit fsyncs. */
     /* RDB persistence */
 
     /*
@@ -1734,9 +1954,13 @@ saveparams
     struct saveparam *saveparams;   /* Save points array for RDB */
     int saveparamslen;              /* Number of saving points */
     char *rdb_filename;             /* Name of RDB file */ //dbfilename XXX  ĬREDIS_DEFAULT_RDB_FILENAME
-    int rdb_compression;            /* Use compression in RDB? */ //rdbcompression  yes | off
+    int rdb_compression;            /* Codec of RDB strings, REDIS_RDB_COMPRESSION_* */ //rdbcompression  yes | no | lz4 | zstd
     //Ĭ1REDIS_DEFAULT_RDB_CHECKSUM
     int rdb_checksum;               /* Use RDB checksum? */
+    //  RDB ʱڽ߳ 0 ʾ߳д
+    int rdb_load_threads;           /* Threads decoding objects on RDB load. */
+    //  RDB ʱڲдֶε߳ 0 ʾֶ
+    int rdb_save_threads;           /* Threads saving RDB sections. */
 
     // һ SAVE ʱ lastsaveһUNIXʱ¼˷һγɹִSA VEBGSAVEʱ䡣
     time_t lastsave;                /* Unix time of last successful save */ //bgsaveִϺ󣬻backgroundSaveDoneHandler¸ֵ
@@ -1967,6 +2191,9 @@ saveparams
     unsigned int bpop_blocked_clients; /* Number of clients blocked by lists */
     list *unblocked_clients; /* list of clients to unblock before next loop */
     list *ready_keys;        /* List of readyList structures for BLPOP & co */
+    // ڷƬִе ZUNIONSTORE / ZINTERSTORE Լִǵʱ¼
+    list *zset_aggr_jobs;    /* Pending time sliced zset aggregations */
+    long long zset_aggr_timer; /* Time event id, -1 when there is none */
 
 
     /* Sort parameters - qsort_r() is only available under BSD so we
@@ -1982,9 +2209,17 @@ saveparams
     size_t hash_max_ziplist_value;
     size_t list_max_ziplist_entries;
     size_t list_max_ziplist_value; //Ĭ=REDIS_LIST_MAX_ZIPLIST_VALUEͨlist-max-ziplist-value
+    // quicklist ÿڵĴСΪԪΪֽ-2 Ϊ 8kb
+    int list_max_ziplist_size;
+    // quicklist ˲ѹĽڵ 0 ʾѹ
+    int list_compress_depth;
     size_t set_max_intset_entries;
     size_t zset_max_ziplist_entries;
     size_t zset_max_ziplist_value;
+    // Ϊʱ´Ĵ򼯺ʹ B+ ԾΪ
+    int zset_btree;
+    // Ԫﵽֵ ZUNIONSTORE / ZINTERSTORE ƬִУ 0 ʾƬ
+    unsigned long long zset_async_aggregate_threshold;
     size_t hll_sparse_max_bytes;
     /*
      ΪserverCronĬϻÿ100һεƵʸunixtimeԺmstimeԣԼ¼ʱľȷȲߣ
@@ -2195,11 +2430,11 @@ typedef struct {
     // ķ
     unsigned char direction; /* Iteration direction */
 
-    // ziplist  ziplist бʱʹ
+    // listpack  listpack бʱʹ
     unsigned char *zi;
 
-    // ڵָ룬˫бʱʹ
-    listNode *ln;
+    // quicklist  quicklist бʱʹ
+    quicklistIter *iter;
 
 } listTypeIterator;
 
@@ -2213,11 +2448,11 @@ typedef struct {
     // б
     listTypeIterator *li;
 
-    // ziplist ڵ
-    unsigned char *zi;  /* Entry in ziplist */
+    // listpack ڵ
+    unsigned char *zi;  /* Entry in listpack */
 
-    // ˫ڵָ
-    listNode *ln;       /* Entry in linked list */
+    // quicklist صԪ
+    quicklistEntry entry; /* Entry in quicklist */
 
 } listTypeEntry;
 
@@ -2296,6 +2531,8 @@ void getRandomHexChars(char *p, unsigned int len);
 uint64_t crc64(uint64_t crc, const unsigned char *s, uint64_t l);
 void exitFromChild(int retcode);
 size_t redisPopcount(void *s, long count);
+void bitopsInitKernels(void);
+void hllInitKernels(void);
 void redisSetProcTitle(char *title);
 
 /* networking.c -- Networking and Client related operations */
@@ -2305,6 +2542,7 @@ void freeClient(redisClient *c, const char *func, unsigned int line);
 void freeClientAsync(redisClient *c);
 void resetClient(redisClient *c);
 void sendReplyToClient(aeEventLoop *el, int fd, void *privdata, int mask);
+int clientInstallWriteHandler(redisClient *c);
 void addReply(redisClient *c, robj *obj);
 void *addDeferredMultiBulkLength(redisClient *c);
 void setDeferredMultiBulkLength(redisClient *c, void *node, long length);
@@ -2346,6 +2584,9 @@ int listenToPort(int port, int *fds, int *count);
 void pauseClients(mstime_t duration);
 int clientsArePaused(void);
 int processEventsWhileBlocked(void);
+void initThreadedIO(void);
+int handleClientsWithPendingReadsUsingThreads(void);
+int handleClientsWithPendingWritesUsingThreads(void);
 
 #ifdef __GNUC__
 void addReplyErrorFormat(redisClient *c, const char *fmt, ...)
@@ -2389,6 +2630,7 @@ void decrRefCount(robj *o);
 void decrRefCountVoid(void *o);
 void incrRefCount(robj *o);
 robj *resetRefCount(robj *obj);
+robj *makeObjectShared(robj *o);
 void freeStringObject(robj *o);
 void freeListObject(robj *o);
 void freeSetObject(robj *o);
@@ -2405,13 +2647,13 @@ robj *getDecodedObject(robj *o);
 size_t stringObjectLen(robj *o);
 robj *createStringObjectFromLongLong(long long value);
 robj *createStringObjectFromLongDouble(long double value);
-robj *createListObject(void);
-robj *createZiplistObject(void);
+robj *createQuicklistObject(void);
+robj *createListpackObject(void);
 robj *createSetObject(void);
 robj *createIntsetObject(void);
 robj *createHashObject(void);
 robj *createZsetObject(void);
-robj *createZsetZiplistObject(void);
+robj *createZsetListpackObject(void);
 int getLongFromObjectOrReply(redisClient *c, robj *o, long *target, const char *msg);
 int checkType(redisClient *c, robj *o, int type);
 int getLongLongFromObjectOrReply(redisClient *c, robj *o, long long *target, const char *msg);
@@ -2473,6 +2715,11 @@ int startAppendOnly(void);
 void backgroundRewriteDoneHandler(int exitcode, int bysignal);
 void aofRewriteBufferReset(void);
 unsigned long aofRewriteBufferSize(void);
+void aofClosePipes(void);
+void aofGroupCommitInit(void);
+void aofGroupCommitHoldClient(redisClient *c);
+void aofGroupCommitRelease(unsigned long long seq);
+void aofGroupCommitFsyncDone(void);
 
 /* Sorted sets data type */
 
@@ -2507,6 +2754,19 @@ void zzlPrev(unsigned char *zl, unsigned char **eptr, unsigned char **sptr);
 unsigned int zsetLength(robj *zobj);
 void zsetConvert(robj *zobj, int encoding);
 unsigned long zslGetRank(zskiplist *zsl, double score, robj *o);
+zbtree *zbtCreate(void);
+void zbtFree(zbtree *t);
+void zbtInsert(zbtree *t, double score, robj *obj);
+int zbtDelete(zbtree *t, double score, robj *obj);
+unsigned long zbtGetRank(zbtree *t, double score, robj *o);
+int zbtGetElementByRank(zbtree *t, unsigned long rank, zbtreeIter *it);
+int zbtNext(zbtreeIter *it);
+int zbtPrev(zbtreeIter *it);
+void zsetInsert(zset *zs, double score, robj *ele);
+int zsetLargeEncoding(void);
+void zsetAggrFinishJobs(redisDb *db, robj *key, int inputsonly);
+void zsetAggrFinishJobsForCommand(redisClient *c);
+void zsetAggrUnblockClient(redisClient *c);
 
 /* Core functions */
 int freeMemoryIfNeeded(void);
@@ -2531,6 +2791,7 @@ void redisLogFromHandler(int level, const char *msg);
 void usage();
 void updateDictResizePolicy(void);
 int htNeedsResize(dict *dict);
+void submitDictTableAlloc(dictTableAlloc *req);
 void oom(const char *msg);
 void populateCommandTable(void);
 void resetCommandTableStats(void);
@@ -2565,7 +2826,7 @@ unsigned long hashTypeLength(robj *o);
 hashTypeIterator *hashTypeInitIterator(robj *subject);
 void hashTypeReleaseIterator(hashTypeIterator *hi);
 int hashTypeNext(hashTypeIterator *hi);
-void hashTypeCurrentFromZiplist(hashTypeIterator *hi, int what,
+void hashTypeCurrentFromListpack(hashTypeIterator *hi, int what,
                                 unsigned char **vstr,
                                 unsigned int *vlen,
                                 long long *vll);
@@ -2602,6 +2863,8 @@ void setExpire(redisDb *db, robj *key, long long when);
 robj *lookupKey(redisDb *db, robj *key);
 robj *lookupKeyRead(redisDb *db, robj *key);
 robj *lookupKeyWrite(redisDb *db, robj *key);
+void lookupKeysRead(redisDb *db, robj **keys, int count, int step, robj **vals);
+void lookupKeysWrite(redisDb *db, robj **keys, int count, int step, robj **vals);
 robj *lookupKeyReadOrReply(redisClient *c, robj *key, robj *reply);
 robj *lookupKeyWriteOrReply(redisClient *c, robj *key, robj *reply);
 void dbAdd(redisDb *db, robj *key, robj *val);
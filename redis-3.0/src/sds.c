@@ -33,9 +33,50 @@
 #include <string.h>
 #include <ctype.h>
 #include <assert.h>
+#include <limits.h>
 #include "sds.h"
 #include "zmalloc.h"
 
+/*
+ *  type ͵ sds ͷĳ
+ *
+ * T = O(1)
+ */
+static inline int sdsHdrSize(char type) {
+    switch(type&SDS_TYPE_MASK) {
+        case SDS_TYPE_5:
+            return sizeof(struct sdshdr5);
+        case SDS_TYPE_8:
+            return sizeof(struct sdshdr8);
+        case SDS_TYPE_16:
+            return sizeof(struct sdshdr16);
+        case SDS_TYPE_32:
+            return sizeof(struct sdshdr32);
+        case SDS_TYPE_64:
+            return sizeof(struct sdshdr64);
+    }
+    return 0;
+}
+
+/*
+ * ܹ泤Ϊ string_size ַСͷ
+ *
+ * T = O(1)
+ */
+static inline char sdsReqType(size_t string_size) {
+    if (string_size < 1<<5)
+        return SDS_TYPE_5;
+    if (string_size < 1<<8)
+        return SDS_TYPE_8;
+    if (string_size < 1<<16)
+        return SDS_TYPE_16;
+#if (LONG_MAX == LLONG_MAX)
+    if (string_size < 1ll<<32)
+        return SDS_TYPE_32;
+#endif
+    return SDS_TYPE_64;
+}
+
 /*
  * ݸĳʼַ init ַ initlen
  * һµ sds
@@ -65,34 +106,78 @@
  * \0 characters in the middle, as the length is stored in the sds header. */
 sds sdsnewlen(const void *init, size_t initlen) {
 
-    struct sdshdr *sh;
+    void *sh;
+    sds s;
+    // ѡܹ initlen Сͷ
+    char type = sdsReqType(initlen);
+    int hdrlen;
+    unsigned char *fp; /* flags pointer. */
+
+    /* Empty strings are usually created in order to append. Use type 8
+     * since type 5 is not good at this. */
+    // ַͨΪ׷ݶģ 5 ޷¼ռ
+    if (type == SDS_TYPE_5 && initlen == 0) type = SDS_TYPE_8;
+    hdrlen = sdsHdrSize(type);
 
     // Ƿгʼݣѡʵڴ䷽ʽ
     // T = O(N)
     if (init) {
         // zmalloc ʼڴ
-        sh = zmalloc(sizeof(struct sdshdr)+initlen+1);
+        sh = zmalloc(hdrlen+initlen+1);
     } else {
         // zcalloc ڴȫʼΪ 0
-        sh = zcalloc(sizeof(struct sdshdr)+initlen+1);
+        sh = zcalloc(hdrlen+initlen+1);
     }
 
     // ڴʧܣ
     if (sh == NULL) return NULL;
 
-    // óʼ
-    sh->len = initlen;
-    //  sds Ԥκοռ
-    sh->free = 0;
-    // ָʼݣǸƵ sdshdr  buf 
+    // ͺͳʼȣ sds Ԥκοռ
+    s = (char*)sh+hdrlen;
+    fp = ((unsigned char*)s)-1;
+    switch(type) {
+        case SDS_TYPE_5: {
+            *fp = type | (initlen << SDS_TYPE_BITS);
+            break;
+        }
+        case SDS_TYPE_8: {
+            SDS_HDR_VAR(8,s);
+            sh->len = initlen;
+            sh->alloc = initlen;
+            *fp = type;
+            break;
+        }
+        case SDS_TYPE_16: {
+            SDS_HDR_VAR(16,s);
+            sh->len = initlen;
+            sh->alloc = initlen;
+            *fp = type;
+            break;
+        }
+        case SDS_TYPE_32: {
+            SDS_HDR_VAR(32,s);
+            sh->len = initlen;
+            sh->alloc = initlen;
+            *fp = type;
+            break;
+        }
+        case SDS_TYPE_64: {
+            SDS_HDR_VAR(64,s);
+            sh->len = initlen;
+            sh->alloc = initlen;
+            *fp = type;
+            break;
+        }
+    }
+    // ָʼݣǸƵ buf 
     // T = O(N)
     if (initlen && init)
-        memcpy(sh->buf, init, initlen);
+        memcpy(s, init, initlen);
     //  \0 β
-    sh->buf[initlen] = '\0';
+    s[initlen] = '\0';
 
-    //  buf ֣ sdshdr
-    return (char*)sh->buf;
+    //  buf ֣ͷ
+    return s;
 }
 
 /*
@@ -155,7 +240,7 @@ sds sdsdup(const sds s) {
 /* Free an sds string. No operation is performed if 's' is NULL. */
 void sdsfree(sds s) {
     if (s == NULL) return;
-    zfree(s-sizeof(struct sdshdr));
+    zfree((char*)s-sdsHdrSize(s[-1]));
 }
 
 // δʹúѷ
@@ -174,10 +259,8 @@ void sdsfree(sds s) {
  * the output will be "6" as the string was modified but the logical length
  * remains 6 bytes. */
 void sdsupdatelen(sds s) {
-    struct sdshdr *sh = (void*) (s-(sizeof(struct sdshdr)));
-    int reallen = strlen(s);
-    sh->free += (sh->len-reallen);
-    sh->len = reallen;
+    size_t reallen = strlen(s);
+    sdssetlen(s, reallen);
 }
 
 /*
@@ -193,15 +276,11 @@ void sdsupdatelen(sds s) {
  * number of bytes previously available. */
 void sdsclear(sds s) {
 
-    // ȡ sdshdr
-    struct sdshdr *sh = (void*) (s-(sizeof(struct sdshdr)));
-
     // ¼
-    sh->free += sh->len;
-    sh->len = 0;
+    sdssetlen(s, 0);
 
     // ŵǰ棨൱ڶԵɾ buf еݣ
-    sh->buf[0] = '\0';
+    s[0] = '\0';
 }
 
 /* Enlarge the free space at the end of the sds string so that the caller
@@ -242,42 +321,67 @@ SDS len 
  */
 sds sdsMakeRoomFor(sds s, size_t addlen) {
 
-    struct sdshdr *sh, *newsh;
+    void *sh, *newsh;
 
     // ȡ s ĿǰĿռ䳤
-    size_t free = sdsavail(s);
+    size_t avail = sdsavail(s);
 
     size_t len, newlen;
+    char type, oldtype = s[-1] & SDS_TYPE_MASK;
+    int hdrlen;
 
     // s ĿǰĿռѾ㹻ٽչֱӷ
-    if (free >= addlen) return s;
+    if (avail >= addlen) return s;
 
     // ȡ s Ŀǰռÿռĳ
     len = sdslen(s);
-    sh = (void*) (s-(sizeof(struct sdshdr)));
+    sh = (char*)s-sdsHdrSize(oldtype);
 
     // s Ҫĳ
     newlen = (len+addlen);
 
     // ³ȣΪ s ¿ռĴС
     if (newlen < SDS_MAX_PREALLOC)
-        // ³С SDS_MAX_PREALLOC 
+        // ³С SDS_MAX_PREALLOC
         // ôΪ賤ȵĿռ
         newlen *= 2;
     else
         // 򣬷䳤ΪĿǰȼ SDS_MAX_PREALLOC
         newlen += SDS_MAX_PREALLOC;
-    // T = O(N)
-    newsh = zrealloc(sh, sizeof(struct sdshdr)+newlen+1);
 
-    // ڴ治㣬ʧܣ
-    if (newsh == NULL) return NULL;
+    /* Don't use type 5: the user is appending to the string and type 5 is
+     * not able to remember empty space, so sdsMakeRoomFor() must be called
+     * at every appending operation. */
+    // ³ȿҪͷ 5 ܼ¼ռ䣬Բʹ
+    type = sdsReqType(newlen);
+    if (type == SDS_TYPE_5) type = SDS_TYPE_8;
 
-    //  sds Ŀ೤
-    newsh->free = newlen - len;
+    hdrlen = sdsHdrSize(type);
+    if (oldtype==type) {
+        // ͷ䣬ֱط
+        // T = O(N)
+        newsh = zrealloc(sh, hdrlen+newlen+1);
+        // ڴ治㣬ʧܣ
+        if (newsh == NULL) return NULL;
+        s = (char*)newsh+hdrlen;
+    } else {
+        /* Since the header size changes, need to move the string forward,
+         * and can't use realloc */
+        // ͷĴСıˣҪƶַԲʹ realloc
+        newsh = zmalloc(hdrlen+newlen+1);
+        if (newsh == NULL) return NULL;
+        memcpy((char*)newsh+hdrlen, s, len+1);
+        zfree(sh);
+        s = (char*)newsh+hdrlen;
+        s[-1] = type;
+        sdssetlen(s, len);
+    }
+
+    //  buf ܳ
+    sdssetalloc(s, newlen);
 
     //  sds
-    return newsh->buf;
+    return s;
 }
 
 /*
@@ -297,18 +401,36 @@ sds sdsMakeRoomFor(sds s, size_t addlen) {
  * After the call, the passed sds string is no longer valid and all the
  * references must be substituted with the new pointer returned by the call. */
 sds sdsRemoveFreeSpace(sds s) {
-    struct sdshdr *sh;
-
-    sh = (void*) (s-(sizeof(struct sdshdr)));
-
-    // ڴط䣬 buf ĳȽ㹻ַ
-    // T = O(N) ֮ǰĿռsizeof(struct sdshdr)+sh->len +10000zreallocֻǷsizeof(struct sdshdr)+sh->len10000ֽھͱϵͳ
-    sh = zrealloc(sh, sizeof(struct sdshdr)+sh->len+1);
+    void *sh, *newsh;
+    char type, oldtype = s[-1] & SDS_TYPE_MASK;
+    int hdrlen;
+    size_t len = sdslen(s);
+
+    sh = (char*)s-sdsHdrSize(oldtype);
+
+    // ַ֮󣬿ܿʹøСͷ
+    type = sdsReqType(len);
+    hdrlen = sdsHdrSize(type);
+    if (oldtype==type) {
+        // ڴط䣬 buf ĳȽ㹻ַ
+        // T = O(N) ֮ǰĿռhdrlen+len+10000zreallocֻǷhdrlen+len10000ֽھͱϵͳ
+        newsh = zrealloc(sh, hdrlen+len+1);
+        if (newsh == NULL) return NULL;
+        s = (char*)newsh+hdrlen;
+    } else {
+        newsh = zmalloc(hdrlen+len+1);
+        if (newsh == NULL) return NULL;
+        memcpy((char*)newsh+hdrlen, s, len+1);
+        zfree(sh);
+        s = (char*)newsh+hdrlen;
+        s[-1] = type;
+        sdssetlen(s, len);
+    }
 
     // ռΪ 0
-    sh->free = 0;
+    sdssetalloc(s, len);
 
-    return sh->buf;
+    return s;
 }
 
 /*
@@ -325,9 +447,20 @@ sds sdsRemoveFreeSpace(sds s) {
  * 4) The implicit null term.
  */
 size_t sdsAllocSize(sds s) {
-    struct sdshdr *sh = (void*) (s-(sizeof(struct sdshdr)));
+    size_t alloc = sdsalloc(s);
+    return sdsHdrSize(s[-1])+alloc+1;
+}
 
-    return sizeof(*sh)+sh->len+sh->free+1;
+/*
+ *  sds ͷҲǷõڴʼַ
+ *
+ * Ӷ
+ *  T = O(1)
+ */
+/* Return the pointer of the actual SDS allocation (normally SDS strings
+ * are referenced by the start of the string buffer). */
+void *sdsAllocPtr(const sds s) {
+    return (void*) (s-sdsHdrSize(s[-1]));
 }
 
 /* Increment the sds length and decrements the left free space at the
@@ -367,22 +500,49 @@ size_t sdsAllocSize(sds s) {
  * Ӷ
  *  T = O(1)
  */
-void sdsIncrLen(sds s, int incr) {
-    struct sdshdr *sh = (void*) (s-(sizeof(struct sdshdr)));
-
-    // ȷ sds ռ㹻
-    assert(sh->free >= incr);
-
-    // 
-    sh->len += incr;
-    sh->free -= incr;
+void sdsIncrLen(sds s, ssize_t incr) {
+    unsigned char flags = s[-1];
+    size_t len;
 
-    //  assert ʵԺ
-    // Ϊǰһ assert Ѿȷ sh->free - incr >= 0 
-    assert(sh->free >= 0);
+    // ȷ sds ռ㹻߽ضϺĳȲΪȻ
+    switch(flags&SDS_TYPE_MASK) {
+        case SDS_TYPE_5: {
+            unsigned char *fp = ((unsigned char*)s)-1;
+            unsigned char oldlen = SDS_TYPE_5_LEN(flags);
+            assert((incr >= 0 && oldlen+incr < 32) || (incr < 0 && oldlen >= (unsigned int)(-incr)));
+            *fp = SDS_TYPE_5 | ((oldlen+incr) << SDS_TYPE_BITS);
+            len = oldlen+incr;
+            break;
+        }
+        case SDS_TYPE_8: {
+            SDS_HDR_VAR(8,s);
+            assert((incr >= 0 && sh->alloc-sh->len >= incr) || (incr < 0 && sh->len >= (unsigned int)(-incr)));
+            len = (sh->len += incr);
+            break;
+        }
+        case SDS_TYPE_16: {
+            SDS_HDR_VAR(16,s);
+            assert((incr >= 0 && sh->alloc-sh->len >= incr) || (incr < 0 && sh->len >= (unsigned int)(-incr)));
+            len = (sh->len += incr);
+            break;
+        }
+        case SDS_TYPE_32: {
+            SDS_HDR_VAR(32,s);
+            assert((incr >= 0 && sh->alloc-sh->len >= (unsigned int)incr) || (incr < 0 && sh->len >= (unsigned int)(-incr)));
+            len = (sh->len += incr);
+            break;
+        }
+        case SDS_TYPE_64: {
+            SDS_HDR_VAR(64,s);
+            assert((incr >= 0 && sh->alloc-sh->len >= (uint64_t)incr) || (incr < 0 && sh->len >= (uint64_t)(-incr)));
+            len = (sh->len += incr);
+            break;
+        }
+        default: len = 0; /* Just to avoid compilation warnings. */
+    }
 
     // µĽβ
-    s[sh->len] = '\0';
+    s[len] = '\0';
 }
 
 /* Grow the sds to have the specified length. Bytes that were not part of
@@ -400,8 +560,7 @@ void sdsIncrLen(sds s, int incr) {
  *  T = O(N)
  */  // ÿַ SDS չȡ   O(N)  N Ϊչֽ 
 sds sdsgrowzero(sds s, size_t len) {
-    struct sdshdr *sh = (void*)(s-(sizeof(struct sdshdr)));
-    size_t totlen, curlen = sh->len;
+    size_t curlen = sdslen(s);
 
     //  len ַгС
     // ôֱӷأ
@@ -416,13 +575,10 @@ sds sdsgrowzero(sds s, size_t len) {
     /* Make sure added region doesn't contain garbage */
     // ·Ŀռ 0 䣬ֹ
     // T = O(N)
-    sh = (void*)(s-(sizeof(struct sdshdr)));
     memset(s+curlen,0,(len-curlen+1)); /* also set trailing \0 byte */
 
     // 
-    totlen = sh->len+sh->free;
-    sh->len = len;
-    sh->free = totlen-sh->len;
+    sdssetlen(s, len);
 
     // µ sds
     return s;
@@ -443,9 +599,7 @@ sds sdsgrowzero(sds s, size_t len) {
  * After the call, the passed sds string is no longer valid and all the
  * references must be substituted with the new pointer returned by the call. */
 sds sdscatlen(sds s, const void *t, size_t len) {
-    
-    struct sdshdr *sh;
-    
+
     // ԭַ
     size_t curlen = sdslen(s);
 
@@ -458,12 +612,10 @@ sds sdscatlen(sds s, const void *t, size_t len) {
 
     //  t еݵַ
     // T = O(N)
-    sh = (void*) (s-(sizeof(struct sdshdr)));
     memcpy(s+curlen, t, len);
 
     // 
-    sh->len = curlen+len;
-    sh->free = sh->free-len;
+    sdssetlen(s, curlen+len);
 
     // ½β
     s[curlen+len] = '\0';
@@ -541,18 +693,11 @@ sds sdscatsds(sds s, const sds t) {
  //  C ַƵ SDS 棬  SDS ԭеַ              O(N)  N Ϊ C ַĳȡ 
 sds sdscpylen(sds s, const char *t, size_t len) {
 
-    struct sdshdr *sh = (void*) (s-(sizeof(struct sdshdr)));
-
-    // sds  buf ĳ
-    size_t totlen = sh->free+sh->len;
-
     //  s  buf Ȳ len ôչ
-    if (totlen < len) {
+    if (sdsalloc(s) < len) {
         // T = O(N)
-        s = sdsMakeRoomFor(s,len-sh->len);
+        s = sdsMakeRoomFor(s,len-sdslen(s));
         if (s == NULL) return NULL;
-        sh = (void*) (s-(sizeof(struct sdshdr)));
-        totlen = sh->free+sh->len;
     }
 
     // 
@@ -563,8 +708,7 @@ sds sdscpylen(sds s, const char *t, size_t len) {
     s[len] = '\0';
 
     // 
-    sh->len = len;
-    sh->free = totlen-len;
+    sdssetlen(s, len);
 
     // µ sds
     return s;
@@ -759,7 +903,6 @@ sds sdscatprintf(sds s, const char *fmt, ...) {
  * %% - Verbatim "%" character.
  */
 sds sdscatfmt(sds s, char const *fmt, ...) {
-    struct sdshdr *sh = (void*) (s-(sizeof(struct sdshdr)));
     size_t initlen = sdslen(s);
     const char *f = fmt;
     int i;
@@ -775,9 +918,8 @@ sds sdscatfmt(sds s, char const *fmt, ...) {
         unsigned long long unum;
 
         /* Make sure there is always space for at least 1 char. */
-        if (sh->free == 0) {
+        if (sdsavail(s)==0) {
             s = sdsMakeRoomFor(s,1);
-            sh = (void*) (s-(sizeof(struct sdshdr)));
         }
 
         switch(*f) {
@@ -789,13 +931,11 @@ sds sdscatfmt(sds s, char const *fmt, ...) {
             case 'S':
                 str = va_arg(ap,char*);
                 l = (next == 's') ? strlen(str) : sdslen(str);
-                if (sh->free < l) {
+                if (sdsavail(s) < l) {
                     s = sdsMakeRoomFor(s,l);
-                    sh = (void*) (s-(sizeof(struct sdshdr)));
                 }
                 memcpy(s+i,str,l);
-                sh->len += l;
-                sh->free -= l;
+                sdsinclen(s,l);
                 i += l;
                 break;
             case 'i':
@@ -807,13 +947,11 @@ sds sdscatfmt(sds s, char const *fmt, ...) {
                 {
                     char buf[SDS_LLSTR_SIZE];
                     l = sdsll2str(buf,num);
-                    if (sh->free < l) {
+                    if (sdsavail(s) < l) {
                         s = sdsMakeRoomFor(s,l);
-                        sh = (void*) (s-(sizeof(struct sdshdr)));
                     }
                     memcpy(s+i,buf,l);
-                    sh->len += l;
-                    sh->free -= l;
+                    sdsinclen(s,l);
                     i += l;
                 }
                 break;
@@ -826,27 +964,23 @@ sds sdscatfmt(sds s, char const *fmt, ...) {
                 {
                     char buf[SDS_LLSTR_SIZE];
                     l = sdsull2str(buf,unum);
-                    if (sh->free < l) {
+                    if (sdsavail(s) < l) {
                         s = sdsMakeRoomFor(s,l);
-                        sh = (void*) (s-(sizeof(struct sdshdr)));
                     }
                     memcpy(s+i,buf,l);
-                    sh->len += l;
-                    sh->free -= l;
+                    sdsinclen(s,l);
                     i += l;
                 }
                 break;
             default: /* Handle %% and generally %<unknown>. */
                 s[i++] = next;
-                sh->len += 1;
-                sh->free -= 1;
+                sdsinclen(s,1);
                 break;
             }
             break;
         default:
             s[i++] = *f;
-            sh->len += 1;
-            sh->free -= 1;
+            sdsinclen(s,1);
             break;
         }
         f++;
@@ -894,7 +1028,6 @@ sds sdscatfmt(sds s, char const *fmt, ...) {
 //һ SDS һ C ַΪ  SDS ˷ֱƳ C ַгַֹ
 
 sds sdstrim(sds s, const char *cset) {
-    struct sdshdr *sh = (void*) (s-(sizeof(struct sdshdr)));
     char *start, *end, *sp, *ep;
     size_t len;
 
@@ -911,14 +1044,13 @@ sds sdstrim(sds s, const char *cset) {
     
     // Ҫǰַ
     // T = O(N)
-    if (sh->buf != sp) memmove(sh->buf, sp, len);
+    if (s != sp) memmove(s, sp, len);
 
     // ս
-    sh->buf[len] = '\0';
+    s[len] = '\0';
 
     // 
-    sh->free = sh->free+(sh->len-len);
-    sh->len = len;
+    sdssetlen(s,len);
 
     // ޼ sds
     return s;
@@ -950,8 +1082,7 @@ sds sdstrim(sds s, const char *cset) {
  * s = sdsnew("Hello World");
  * sdsrange(s,1,-1); => "ello World"
  */ //  SDS ڵݣ ڵݻᱻǻ            O(N)  N Ϊݵֽ 
-void sdsrange(sds s, int start, int end) {//bufδݿڴͷ´μյݺһǷkeyvalueַ
-    struct sdshdr *sh = (void*) (s-(sizeof(struct sdshdr)));
+void sdsrange(sds s, ssize_t start, ssize_t end) {//bufδݿڴͷ´μյݺһǷkeyvalueַ
     size_t newlen, len = sdslen(s);
 
     if (len == 0) 
@@ -970,9 +1101,9 @@ void sdsrange(sds s, int start, int end) {//
     }
     newlen = (start > end) ? 0 : (end-start)+1;
     if (newlen != 0) {
-        if (start >= (signed)len) {
+        if (start >= (ssize_t)len) {
             newlen = 0;
-        } else if (end >= (signed)len) { //endlenendֻΪlenĩβ
+        } else if (end >= (ssize_t)len) { //endlenendֻΪlenĩβ
             end = len-1;
             newlen = (start > end) ? 0 : (end-start)+1;
         }
@@ -983,14 +1114,13 @@ void sdsrange(sds s, int start, int end) {//
     // Ҫַƶ
     // T = O(N)
     if (start && newlen) 
-        memmove(sh->buf, sh->buf+start, newlen);
+        memmove(s, s+start, newlen);
 
     // ս
-    sh->buf[newlen] = 0;
+    s[newlen] = 0;
 
     // 
-    sh->free = sh->free+(sh->len-newlen);
-    sh->len = newlen;
+    sdssetlen(s,newlen);
 }
 
 /*
@@ -1441,7 +1571,6 @@ sds sdsjoin(char **argv, int argc, char *sep) {
 
 int main(void) {
     {
-        struct sdshdr *sh;
         sds x = sdsnew("foo"), y;
 
         test_cond("Create a string and obtain the length",
@@ -1552,21 +1681,63 @@ int main(void) {
             memcmp(y,"\"\\a\\n\\x00foo\\r\"",15) == 0)
 
         {
-            int oldfree;
+            char *p;
+            int step = 10, j, i;
 
             sdsfree(x);
+            sdsfree(y);
             x = sdsnew("0");
-            sh = (void*) (x-(sizeof(struct sdshdr)));
-            test_cond("sdsnew() free/len buffers", sh->len == 1 && sh->free == 0);
-            x = sdsMakeRoomFor(x,1);
-            sh = (void*) (x-(sizeof(struct sdshdr)));
-            test_cond("sdsMakeRoomFor()", sh->len == 1 && sh->free > 0);
-            oldfree = sh->free;
-            x[1] = '1';
-            sdsIncrLen(x,1);
-            test_cond("sdsIncrLen() -- content", x[0] == '0' && x[1] == '1');
-            test_cond("sdsIncrLen() -- len", sh->len == 2);
-            test_cond("sdsIncrLen() -- free", sh->free == oldfree-1);
+            test_cond("sdsnew() free/len buffers", sdslen(x) == 1 && sdsavail(x) == 0);
+
+            /* Run the test a few times in order to hit the first two
+             * SDS header types. */
+            for (i = 0; i < 10; i++) {
+                int oldlen = sdslen(x);
+                x = sdsMakeRoomFor(x,step);
+                int type = x[-1]&SDS_TYPE_MASK;
+
+                test_cond("sdsMakeRoomFor() len", sdslen(x) == oldlen);
+                if (type != SDS_TYPE_5) {
+                    test_cond("sdsMakeRoomFor() free", sdsavail(x) >= step);
+                }
+                p = x+oldlen;
+                for (j = 0; j < step; j++) {
+                    p[j] = 'A'+j;
+                }
+                sdsIncrLen(x,step);
+            }
+            test_cond("sdsMakeRoomFor() content",
+                memcmp("0ABCDEFGHIJABCDEFGHIJABCDEFGHIJABCDEFGHIJABCDEFGHIJABCDEFGHIJABCDEFGHIJABCDEFGHIJABCDEFGHIJABCDEFGHIJ",x,101) == 0);
+            test_cond("sdsMakeRoomFor() final length",sdslen(x)==101);
+
+            sdsfree(x);
+        }
+
+        {
+            /* Every header type keeps the length and the free space. */
+            size_t lens[] = {0, 1, 31, 32, 255, 256, 65535, 65536, 100000};
+            int k;
+
+            for (k = 0; k < (int)(sizeof(lens)/sizeof(lens[0])); k++) {
+                x = sdsnewlen(NULL,lens[k]);
+                test_cond("sdsnewlen() length of every header type",
+                    sdslen(x) == lens[k] && sdsavail(x) == 0);
+                x = sdscatlen(x,"abc",3);
+                test_cond("sdscatlen() across header types",
+                    sdslen(x) == lens[k]+3 && memcmp(x+lens[k],"abc",4) == 0);
+                x = sdsRemoveFreeSpace(x);
+                test_cond("sdsRemoveFreeSpace() across header types",
+                    sdslen(x) == lens[k]+3 && sdsavail(x) == 0 &&
+                    memcmp(x+lens[k],"abc",4) == 0);
+                sdsIncrLen(x,-3);
+                test_cond("sdsIncrLen() negative increment",
+                    sdslen(x) == lens[k] && x[lens[k]] == '\0');
+                sdsfree(x);
+            }
+            x = sdsnew("short");
+            test_cond("short strings use the smallest header",
+                (x[-1]&SDS_TYPE_MASK) == SDS_TYPE_5 && sdsAllocSize(x) == 7);
+            sdsfree(x);
         }
     }
     test_report()
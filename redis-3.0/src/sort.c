@@ -774,7 +774,7 @@ void sortCommand(redisClient *c) {
     if (sortval)
         incrRefCount(sortval);
     else
-        sortval = createListObject();
+        sortval = createQuicklistObject();
 
     /* The SORT command has an SQL-alike syntax, parse it */
 	// 벢 SORT ѡ
@@ -904,10 +904,11 @@ void sortCommand(redisClient *c) {
     }
 
     /* Destructively convert encoded sorted sets for SORT. */
-	// 򼯺ϱ SKIPLIST 
-    // ǵĻôת SKIPLIST 
-    if (sortval->type == REDIS_ZSET)
-        zsetConvert(sortval, REDIS_ENCODING_SKIPLIST);
+	// 򼯺ϱ SKIPLIST  BTREE 
+    //  LISTPACK Ļôתһ
+    if (sortval->type == REDIS_ZSET &&
+        sortval->encoding == REDIS_ENCODING_LISTPACK)
+        zsetConvert(sortval, zsetLargeEncoding());
 
     /* Objtain the length of the object to sort. */
 	// ȡҪĳ
@@ -983,6 +984,29 @@ void sortCommand(redisClient *c) {
 
 	//  dontsort Ϊ
 	// 򼯺ϵĲֳԱŽ
+    } else if (sortval->type == REDIS_ZSET && dontsort &&
+               sortval->encoding == REDIS_ENCODING_BTREE) {
+        /* Same as below, walking the leaves of the B+tree. */
+        zbtree *zbt = ((zset*)sortval->ptr)->zbt;
+        zbtreeIter it;
+        int valid, rangelen = vectorlen;
+
+        if (desc)
+            valid = zbtGetElementByRank(zbt,zbt->length-start,&it);
+        else
+            valid = zbtGetElementByRank(zbt,start+1,&it);
+
+        while(rangelen--) {
+            redisAssertWithInfo(c,sortval,valid);
+            vector[j].obj = zbtIterObj(&it);
+            vector[j].u.score = 0;
+            vector[j].u.cmpobj = NULL;
+            j++;
+            valid = desc ? zbtPrev(&it) : zbtNext(&it);
+        }
+        end -= start;
+        start = 0;
+
     } else if (sortval->type == REDIS_ZSET && dontsort) {
         /* Special handling for a sorted set, if 'dontsort' is true.
          * This makes sure we return elements in the sorted set original
@@ -1161,7 +1185,7 @@ void sortCommand(redisClient *c) {
             }
         }
     } else {
-        robj *sobj = createZiplistObject();
+        robj *sobj = createListpackObject();
 
         /* STORE option specified, set the sorting result as a List object */
 		//  STORE ѡ浽б
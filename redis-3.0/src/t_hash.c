@@ -35,10 +35,10 @@
  *----------------------------------------------------------------------------*/
 
 /* Check the length of a number of objects to see if we need to convert a
- * ziplist to a real hash. 
+ * listpack to a real hash. 
  *
  *  argv еĶм飬
- * ǷҪı REDIS_ENCODING_ZIPLIST ת REDIS_ENCODING_HT
+ * ǷҪı REDIS_ENCODING_LISTPACK ת REDIS_ENCODING_HT
  *
  * Note that we only check string encoded objects
  * as their string length can be queried in constant time. 
@@ -48,8 +48,8 @@
 void hashTypeTryConversion(robj *o, robj **argv, int start, int end) {
     int i;
 
-    //  ziplist 룬ôֱӷ
-    if (o->encoding != REDIS_ENCODING_ZIPLIST) return;
+    //  listpack 룬ôֱӷ
+    if (o->encoding != REDIS_ENCODING_LISTPACK) return;
 
     // 󣬿ǵֵַǷ񳬹ָ
     for (i = start; i <= end; i++) {
@@ -76,10 +76,10 @@ void hashTypeTryObjectEncoding(robj *subject, robj **o1, robj **o2) {
     }
 }
 
-/* Get the value from a ziplist encoded hash, identified by field.
+/* Get the value from a listpack encoded hash, identified by field.
  * Returns -1 when the field cannot be found. 
  *
- *  ziplist  hash ȡ field Ӧֵ
+ *  listpack  hash ȡ field Ӧֵ
  *
  * 
  *  field   
@@ -90,7 +90,7 @@ void hashTypeTryObjectEncoding(robj *subject, robj **o1, robj **o2) {
  * ʧʱ -1 
  * ҳɹʱ 0 
  */
-int hashTypeGetFromZiplist(robj *o, robj *field,
+int hashTypeGetFromListpack(robj *o, robj *field,
                            unsigned char **vstr,
                            unsigned int *vlen,
                            long long *vll)
@@ -99,30 +99,30 @@ int hashTypeGetFromZiplist(robj *o, robj *field,
     int ret;
 
     // ȷȷ
-    redisAssert(o->encoding == REDIS_ENCODING_ZIPLIST);
+    redisAssert(o->encoding == REDIS_ENCODING_LISTPACK);
 
     // ȡδ
     field = getDecodedObject(field);
 
-    //  ziplist λ
+    //  listpack λ
     zl = o->ptr;
-    fptr = ziplistIndex(zl, ZIPLIST_HEAD);
+    fptr = lpFirst(zl);
     if (fptr != NULL) {
         // λĽڵ
-        fptr = ziplistFind(fptr, field->ptr, sdslen(field->ptr), 1);
+        fptr = lpFind(fptr, field->ptr, sdslen(field->ptr), 1);
         if (fptr != NULL) {
             /* Grab pointer to the value (fptr points to the field) */
             // ѾҵȡӦֵλ
-            vptr = ziplistNext(zl, fptr);
+            vptr = lpNext(zl, fptr);
             redisAssert(vptr != NULL);
         }
     }
 
     decrRefCount(field);
 
-    //  ziplist ڵȡֵ
+    //  listpack ڵȡֵ
     if (vptr != NULL) {
-        ret = ziplistGet(vptr, vstr, vlen, vll);
+        ret = lpGet(vptr, vstr, vlen, vll);
         redisAssert(ret);
         return 0;
     }
@@ -171,13 +171,13 @@ int hashTypeGetFromHashTable(robj *o, robj *field, robj **value) {
 robj *hashTypeGetObject(robj *o, robj *field) {
     robj *value = NULL;
 
-    //  ziplist ȡֵ
-    if (o->encoding == REDIS_ENCODING_ZIPLIST) {
+    //  listpack ȡֵ
+    if (o->encoding == REDIS_ENCODING_LISTPACK) {
         unsigned char *vstr = NULL;
         unsigned int vlen = UINT_MAX;
         long long vll = LLONG_MAX;
 
-        if (hashTypeGetFromZiplist(o, field, &vstr, &vlen, &vll) == 0) {
+        if (hashTypeGetFromListpack(o, field, &vstr, &vlen, &vll) == 0) {
             // ֵ
             if (vstr) {
                 value = createStringObject((char*)vstr, vlen);
@@ -212,13 +212,13 @@ robj *hashTypeGetObject(robj *o, robj *field) {
  */
 int hashTypeExists(robj *o, robj *field) {
 
-    //  ziplist
-    if (o->encoding == REDIS_ENCODING_ZIPLIST) {
+    //  listpack
+    if (o->encoding == REDIS_ENCODING_LISTPACK) {
         unsigned char *vstr = NULL;
         unsigned int vlen = UINT_MAX;
         long long vll = LLONG_MAX;
 
-        if (hashTypeGetFromZiplist(o, field, &vstr, &vlen, &vll) == 0) return 1;
+        if (hashTypeGetFromListpack(o, field, &vstr, &vlen, &vll) == 0) return 1;
 
     // ֵ
     } else if (o->encoding == REDIS_ENCODING_HT) {
@@ -253,45 +253,41 @@ int hashTypeExists(robj *o, robj *field) {
 int hashTypeSet(robj *o, robj *field, robj *value) {
     int update = 0;
 
-    // ӵ ziplist
-    if (o->encoding == REDIS_ENCODING_ZIPLIST) {
+    // ӵ listpack
+    if (o->encoding == REDIS_ENCODING_LISTPACK) {
         unsigned char *zl, *fptr, *vptr;
 
         // ַ
         field = getDecodedObject(field);
         value = getDecodedObject(value);
 
-        //  ziplist ԲҲ field ѾڵĻ
+        //  listpack ԲҲ field ѾڵĻ
         zl = o->ptr;
-        fptr = ziplistIndex(zl, ZIPLIST_HEAD);
+        fptr = lpFirst(zl);
         if (fptr != NULL) {
             // λ field
-            fptr = ziplistFind(fptr, field->ptr, sdslen(field->ptr), 1);
+            fptr = lpFind(fptr, field->ptr, sdslen(field->ptr), 1);
             if (fptr != NULL) {
                 /* Grab pointer to the value (fptr points to the field) */
                 // λֵ
-                vptr = ziplistNext(zl, fptr);
+                vptr = lpNext(zl, fptr);
                 redisAssert(vptr != NULL);
 
                 // ʶβΪ²
                 update = 1;
 
-                /* Delete value */
-                // ɾɵļֵ
-                zl = ziplistDelete(zl, &vptr);
-
-                /* Insert new value */
-                // µļֵ
-                zl = ziplistInsert(zl, vptr, value->ptr, sdslen(value->ptr));
+                /* Replace value */
+                // ֵ滻ֵ
+                zl = lpReplace(zl, &vptr, value->ptr, sdslen(value->ptr));
             }
         }
 
         // ⲻǸ²ôһӲ
         if (!update) {
-            /* Push new field/value pair onto the tail of the ziplist */
-            // µ field-value 뵽 ziplist ĩβ
-            zl = ziplistPush(zl, field->ptr, sdslen(field->ptr), ZIPLIST_TAIL);
-            zl = ziplistPush(zl, value->ptr, sdslen(value->ptr), ZIPLIST_TAIL);
+            /* Push new field/value pair onto the tail of the listpack */
+            // µ field-value 뵽 listpack ĩβ
+            zl = lpPush(zl, field->ptr, sdslen(field->ptr), LISTPACK_TAIL);
+            zl = lpPush(zl, value->ptr, sdslen(value->ptr), LISTPACK_TAIL);
         }
         
         // ¶ָ
@@ -301,7 +297,7 @@ int hashTypeSet(robj *o, robj *field, robj *value) {
         decrRefCount(field);
         decrRefCount(value);
 
-        /* Check if the ziplist needs to be converted to a hash table */
+        /* Check if the listpack needs to be converted to a hash table */
         // Ӳ֮ǷҪ ZIPLIST ת HT 
         if (hashTypeLength(o) > server.hash_max_ziplist_entries)
             hashTypeConvert(o, REDIS_ENCODING_HT);
@@ -337,21 +333,21 @@ int hashTypeSet(robj *o, robj *field, robj *value) {
 int hashTypeDelete(robj *o, robj *field) {
     int deleted = 0;
 
-    //  ziplist ɾ
-    if (o->encoding == REDIS_ENCODING_ZIPLIST) {
+    //  listpack ɾ
+    if (o->encoding == REDIS_ENCODING_LISTPACK) {
         unsigned char *zl, *fptr;
 
         field = getDecodedObject(field);
 
         zl = o->ptr;
-        fptr = ziplistIndex(zl, ZIPLIST_HEAD);
+        fptr = lpFirst(zl);
         if (fptr != NULL) {
             // λ
-            fptr = ziplistFind(fptr, field->ptr, sdslen(field->ptr), 1);
+            fptr = lpFind(fptr, field->ptr, sdslen(field->ptr), 1);
             if (fptr != NULL) {
                 // ɾֵ
-                zl = ziplistDelete(zl,&fptr);
-                zl = ziplistDelete(zl,&fptr);
+                zl = lpDelete(zl,&fptr);
+                zl = lpDelete(zl,&fptr);
                 o->ptr = zl;
                 deleted = 1;
             }
@@ -382,9 +378,9 @@ int hashTypeDelete(robj *o, robj *field) {
 unsigned long hashTypeLength(robj *o) {
     unsigned long length = ULONG_MAX;
 
-    if (o->encoding == REDIS_ENCODING_ZIPLIST) {
-        // ziplist Уÿ field-value ԶҪʹڵ
-        length = ziplistLen(o->ptr) / 2;
+    if (o->encoding == REDIS_ENCODING_LISTPACK) {
+        // listpack Уÿ field-value ԶҪʹڵ
+        length = lpLength(o->ptr) / 2;
     } else if (o->encoding == REDIS_ENCODING_HT) {
         length = dictSize((dict*)o->ptr);
     } else {
@@ -413,8 +409,8 @@ hashTypeIterator *hashTypeInitIterator(robj *subject) {
     // ¼
     hi->encoding = subject->encoding;
 
-    //  ziplist ķʽʼ
-    if (hi->encoding == REDIS_ENCODING_ZIPLIST) {
+    //  listpack ķʽʼ
+    if (hi->encoding == REDIS_ENCODING_LISTPACK) {
         hi->fptr = NULL;
         hi->vptr = NULL;
 
@@ -440,7 +436,7 @@ void hashTypeReleaseIterator(hashTypeIterator *hi) {
         dictReleaseIterator(hi->di);
     }
 
-    // ͷ ziplist 
+    // ͷ listpack 
     zfree(hi);
 }
 
@@ -456,8 +452,8 @@ void hashTypeReleaseIterator(hashTypeIterator *hi) {
  */
 int hashTypeNext(hashTypeIterator *hi) {
 
-    //  ziplist
-    if (hi->encoding == REDIS_ENCODING_ZIPLIST) {
+    //  listpack
+    if (hi->encoding == REDIS_ENCODING_LISTPACK) {
         unsigned char *zl;
         unsigned char *fptr, *vptr;
 
@@ -469,21 +465,21 @@ int hashTypeNext(hashTypeIterator *hi) {
         if (fptr == NULL) {
             /* Initialize cursor */
             redisAssert(vptr == NULL);
-            fptr = ziplistIndex(zl, 0);
+            fptr = lpFirst(zl);
 
         // ȡһڵ
         } else {
             /* Advance cursor */
             redisAssert(vptr != NULL);
-            fptr = ziplistNext(zl, vptr);
+            fptr = lpNext(zl, vptr);
         }
 
-        // ϣ ziplist Ϊ
+        // ϣ listpack Ϊ
         if (fptr == NULL) return REDIS_ERR;
 
         /* Grab pointer to the value (fptr points to the field) */
         // ¼ֵָ
-        vptr = ziplistNext(zl, fptr);
+        vptr = lpNext(zl, fptr);
         redisAssert(vptr != NULL);
 
         /* fptr, vptr now point to the first or next pair */
@@ -505,11 +501,11 @@ int hashTypeNext(hashTypeIterator *hi) {
 }
 
 /* Get the field or value at iterator cursor, for an iterator on a hash value
- * encoded as a ziplist. Prototype is similar to `hashTypeGetFromZiplist`. 
+ * encoded as a listpack. Prototype is similar to `hashTypeGetFromListpack`. 
  *
- *  ziplist ĹϣУȡָ뵱ǰָڵֵ
+ *  listpack ĹϣУȡָ뵱ǰָڵֵ
  */
-void hashTypeCurrentFromZiplist(hashTypeIterator *hi, int what,
+void hashTypeCurrentFromListpack(hashTypeIterator *hi, int what,
                                 unsigned char **vstr,
                                 unsigned int *vlen,
                                 long long *vll)
@@ -517,22 +513,22 @@ void hashTypeCurrentFromZiplist(hashTypeIterator *hi, int what,
     int ret;
 
     // ȷȷ
-    redisAssert(hi->encoding == REDIS_ENCODING_ZIPLIST);
+    redisAssert(hi->encoding == REDIS_ENCODING_LISTPACK);
 
     // ȡ
     if (what & REDIS_HASH_KEY) {
-        ret = ziplistGet(hi->fptr, vstr, vlen, vll);
+        ret = lpGet(hi->fptr, vstr, vlen, vll);
         redisAssert(ret);
 
     // ȡֵ
     } else {
-        ret = ziplistGet(hi->vptr, vstr, vlen, vll);
+        ret = lpGet(hi->vptr, vstr, vlen, vll);
         redisAssert(ret);
     }
 }
 
 /* Get the field or value at iterator cursor, for an iterator on a hash value
- * encoded as a ziplist. Prototype is similar to `hashTypeGetFromHashTable`. 
+ * encoded as a listpack. Prototype is similar to `hashTypeGetFromHashTable`. 
  *
  * ݵָ룬ֵĹϣȡָڵ field  value 
  */
@@ -563,14 +559,14 @@ void hashTypeCurrentFromHashTable(hashTypeIterator *hi, int what, robj **dst) {
 robj *hashTypeCurrentObject(hashTypeIterator *hi, int what) {
     robj *dst;
 
-    // ziplist
-    if (hi->encoding == REDIS_ENCODING_ZIPLIST) {
+    // listpack
+    if (hi->encoding == REDIS_ENCODING_LISTPACK) {
         unsigned char *vstr = NULL;
         unsigned int vlen = UINT_MAX;
         long long vll = LLONG_MAX;
 
         // ȡֵ
-        hashTypeCurrentFromZiplist(hi, what, &vstr, &vlen, &vll);
+        hashTypeCurrentFromListpack(hi, what, &vstr, &vlen, &vll);
 
         // ֵĶ
         if (vstr) {
@@ -621,13 +617,13 @@ robj *hashTypeLookupWriteOrCreate(redisClient *c, robj *key) {
 }
 
 /*
- * һ ziplist Ĺϣ o ת
+ * һ listpack Ĺϣ o ת
  */
-void hashTypeConvertZiplist(robj *o, int enc) {
-    redisAssert(o->encoding == REDIS_ENCODING_ZIPLIST);
+void hashTypeConvertListpack(robj *o, int enc) {
+    redisAssert(o->encoding == REDIS_ENCODING_LISTPACK);
 
     //  ZIPLIST ô
-    if (enc == REDIS_ENCODING_ZIPLIST) {
+    if (enc == REDIS_ENCODING_LISTPACK) {
         /* Nothing to do... */
 
     // ת HT 
@@ -643,31 +639,31 @@ void hashTypeConvertZiplist(robj *o, int enc) {
         // հ׵ֵ
         dict = dictCreate(&hashDictType, NULL);
 
-        //  ziplist
+        //  listpack
         while (hashTypeNext(hi) != REDIS_ERR) {
             robj *field, *value;
 
-            // ȡ ziplist ļ
+            // ȡ listpack ļ
             field = hashTypeCurrentObject(hi, REDIS_HASH_KEY);
             field = tryObjectEncoding(field);
 
-            // ȡ ziplist ֵ
+            // ȡ listpack ֵ
             value = hashTypeCurrentObject(hi, REDIS_HASH_VALUE);
             value = tryObjectEncoding(value);
 
             // ֵӵֵ
             ret = dictAdd(dict, field, value);
             if (ret != DICT_OK) {
-                redisLogHexDump(REDIS_WARNING,"ziplist with dup elements dump",
-                    o->ptr,ziplistBlobLen(o->ptr));
+                redisLogHexDump(REDIS_WARNING,"listpack with dup elements dump",
+                    o->ptr,lpBytes(o->ptr));
                 redisAssert(ret == DICT_OK);
             }
         }
 
-        // ͷ ziplist ĵ
+        // ͷ listpack ĵ
         hashTypeReleaseIterator(hi);
 
-        // ͷŶԭ ziplist
+        // ͷŶԭ listpack
         zfree(o->ptr);
 
         // ¹ϣıֵ
@@ -686,8 +682,8 @@ void hashTypeConvertZiplist(robj *o, int enc) {
  */
 void hashTypeConvert(robj *o, int enc) {
 
-    if (o->encoding == REDIS_ENCODING_ZIPLIST) {
-        hashTypeConvertZiplist(o, enc);
+    if (o->encoding == REDIS_ENCODING_LISTPACK) {
+        hashTypeConvertListpack(o, enc);
 
     } else if (o->encoding == REDIS_ENCODING_HT) {
         redisPanic("Not implemented");
@@ -926,14 +922,14 @@ static void addHashFieldToReply(redisClient *c, robj *o, robj *field) {
         return;
     }
 
-    // ziplist 
-    if (o->encoding == REDIS_ENCODING_ZIPLIST) {
+    // listpack 
+    if (o->encoding == REDIS_ENCODING_LISTPACK) {
         unsigned char *vstr = NULL;
         unsigned int vlen = UINT_MAX;
         long long vll = LLONG_MAX;
 
         // ȡֵ
-        ret = hashTypeGetFromZiplist(o, field, &vstr, &vlen, &vll);
+        ret = hashTypeGetFromListpack(o, field, &vstr, &vlen, &vll);
         if (ret < 0) {
             addReply(c, shared.nullbulk);
         } else {
@@ -1055,12 +1051,12 @@ void hlenCommand(redisClient *c) {
 static void addHashIteratorCursorToReply(redisClient *c, hashTypeIterator *hi, int what) {
 
     //  ZIPLIST
-    if (hi->encoding == REDIS_ENCODING_ZIPLIST) {
+    if (hi->encoding == REDIS_ENCODING_LISTPACK) {
         unsigned char *vstr = NULL;
         unsigned int vlen = UINT_MAX;
         long long vll = LLONG_MAX;
 
-        hashTypeCurrentFromZiplist(hi, what, &vstr, &vlen, &vll);
+        hashTypeCurrentFromListpack(hi, what, &vstr, &vlen, &vll);
         if (vstr) {
             addReplyBulkCBuffer(c, vstr, vlen);
         } else {
@@ -35,11 +35,11 @@ void signalListAsReady(redisClient *c, robj *key);
  * List API
  *----------------------------------------------------------------------------*/
 
-/* Check the argument length to see if it requires us to convert the ziplist
- * to a real list. Only check raw-encoded objects because integer encoded
+/* Check the argument length to see if it requires us to convert the listpack
+ * to a quicklist. Only check raw-encoded objects because integer encoded
  * objects are never too long. 
  *
- * ֵ value м飬ǷҪ subject  ziplist תΪ˫
+ * ֵ value м飬ǷҪ subject  listpack תΪ quicklist 
  * Ա㱣ֵ value 
  *
  * ֻ REDIS_ENCODING_RAW  value м飬
@@ -48,13 +48,13 @@ void signalListAsReady(redisClient *c, robj *key);
 void listTypeTryConversion(robj *subject, robj *value) {
 
     // ȷ subject Ϊ ZIPLIST 
-    if (subject->encoding != REDIS_ENCODING_ZIPLIST) return;
+    if (subject->encoding != REDIS_ENCODING_LISTPACK) return;
 
     if (sdsEncodedObject(value) &&
         // ַǷ
         sdslen(value->ptr) > server.list_max_ziplist_value)
-            // תΪ˫
-            listTypeConvert(subject,REDIS_ENCODING_LINKEDLIST);
+            // תΪ quicklist
+            listTypeConvert(subject,REDIS_ENCODING_QUICKLIST);
 }
 
 /* The function pushes an element to the specified list object 'subject',
@@ -75,30 +75,28 @@ void listTypeTryConversion(robj *subject, robj *value) {
  */
 void listTypePush(robj *subject, robj *value, int where) {
 
-    /* Check if we need to convert the ziplist */
+    /* Check if we need to convert the listpack */
     // ǷҪת룿
     listTypeTryConversion(subject,value);
 
-    if (subject->encoding == REDIS_ENCODING_ZIPLIST &&
-        ziplistLen(subject->ptr) >= server.list_max_ziplist_entries)
-            listTypeConvert(subject,REDIS_ENCODING_LINKEDLIST);
+    if (subject->encoding == REDIS_ENCODING_LISTPACK &&
+        lpLength(subject->ptr) >= server.list_max_ziplist_entries)
+            listTypeConvert(subject,REDIS_ENCODING_QUICKLIST);
 
-    // ZIPLIST
-    if (subject->encoding == REDIS_ENCODING_ZIPLIST) {
-        int pos = (where == REDIS_HEAD) ? ZIPLIST_HEAD : ZIPLIST_TAIL;
-        // ȡֵΪ ZIPLIST ַֻܱ
+    // LISTPACK
+    if (subject->encoding == REDIS_ENCODING_LISTPACK) {
+        int pos = (where == REDIS_HEAD) ? LISTPACK_HEAD : LISTPACK_TAIL;
+        // ȡֵΪ LISTPACK ַֻܱ
         value = getDecodedObject(value);
-        subject->ptr = ziplistPush(subject->ptr,value->ptr,sdslen(value->ptr),pos);
+        subject->ptr = lpPush(subject->ptr,value->ptr,sdslen(value->ptr),pos);
         decrRefCount(value);
 
-    // ˫
-    } else if (subject->encoding == REDIS_ENCODING_LINKEDLIST) {
-        if (where == REDIS_HEAD) {
-            listAddNodeHead(subject->ptr,value);
-        } else {
-            listAddNodeTail(subject->ptr,value);
-        }
-        incrRefCount(value);
+    // QUICKLIST
+    } else if (subject->encoding == REDIS_ENCODING_QUICKLIST) {
+        int pos = (where == REDIS_HEAD) ? QUICKLIST_HEAD : QUICKLIST_TAIL;
+        value = getDecodedObject(value);
+        quicklistPush(subject->ptr,value->ptr,sdslen(value->ptr),pos);
+        decrRefCount(value);
 
     // δ֪
     } else {
@@ -106,6 +104,13 @@ void listTypePush(robj *subject, robj *value, int where) {
     }
 }
 
+/* Used by quicklistPopCustom() to create the object of the popped element.
+ *
+ * Ϊ quicklist ַԪش */
+static void *listPopSaver(unsigned char *data, unsigned int sz) {
+    return createStringObject((char*)data,sz);
+}
+
 /*
  * бıͷβеһԪء
  *
@@ -119,8 +124,8 @@ robj *listTypePop(robj *subject, int where) {
 
     robj *value = NULL;
 
-    // ZIPLIST
-    if (subject->encoding == REDIS_ENCODING_ZIPLIST) {
+    // LISTPACK
+    if (subject->encoding == REDIS_ENCODING_LISTPACK) {
         unsigned char *p;
         unsigned char *vstr;
         unsigned int vlen;
@@ -129,8 +134,8 @@ robj *listTypePop(robj *subject, int where) {
         // Ԫصλ
         int pos = (where == REDIS_HEAD) ? 0 : -1;
 
-        p = ziplistIndex(subject->ptr,pos);
-        if (ziplistGet(p,&vstr,&vlen,&vlong)) {
+        p = lpSeek(subject->ptr,pos);
+        if (lpGet(p,&vstr,&vlen,&vlong)) {
             // ΪԪش
             if (vstr) {
                 value = createStringObject((char*)vstr,vlen);
@@ -138,28 +143,19 @@ robj *listTypePop(robj *subject, int where) {
                 value = createStringObjectFromLongLong(vlong);
             }
             /* We only need to delete an element when it exists */
-            //  ziplist ɾԪ
-            subject->ptr = ziplistDelete(subject->ptr,&p);
+            //  listpack ɾԪ
+            subject->ptr = lpDelete(subject->ptr,&p);
         }
 
-    // ˫
-    } else if (subject->encoding == REDIS_ENCODING_LINKEDLIST) {
-
-        list *list = subject->ptr;
-
-        listNode *ln;
-
-        if (where == REDIS_HEAD) {
-            ln = listFirst(list);
-        } else {
-            ln = listLast(list);
-        }
+    // QUICKLIST
+    } else if (subject->encoding == REDIS_ENCODING_QUICKLIST) {
+        long long vlong;
+        int pos = (where == REDIS_HEAD) ? QUICKLIST_HEAD : QUICKLIST_TAIL;
 
-        // ɾڵ
-        if (ln != NULL) {
-            value = listNodeValue(ln);
-            incrRefCount(value);
-            listDelNode(list,ln);
+        // ַԪ listPopSaver Ԫﴴ
+        if (quicklistPopCustom(subject->ptr,pos,(unsigned char **)&value,
+                               NULL,&vlong,listPopSaver)) {
+            if (!value) value = createStringObjectFromLongLong(vlong);
         }
 
     // δ֪
@@ -176,13 +172,13 @@ robj *listTypePop(robj *subject, int where) {
  */
 unsigned long listTypeLength(robj *subject) {
 
-    // ZIPLIST
-    if (subject->encoding == REDIS_ENCODING_ZIPLIST) {
-        return ziplistLen(subject->ptr);
+    // LISTPACK
+    if (subject->encoding == REDIS_ENCODING_LISTPACK) {
+        return lpLength(subject->ptr);
 
-    // ˫
-    } else if (subject->encoding == REDIS_ENCODING_LINKEDLIST) {
-        return listLength((list*)subject->ptr);
+    // QUICKLIST
+    } else if (subject->encoding == REDIS_ENCODING_QUICKLIST) {
+        return quicklistCount(subject->ptr);
 
     // δ֪
     } else {
@@ -210,13 +206,18 @@ listTypeIterator *listTypeInitIterator(robj *subject, long index, unsigned char
 
     li->direction = direction;
 
-    // ZIPLIST
-    if (li->encoding == REDIS_ENCODING_ZIPLIST) {
-        li->zi = ziplistIndex(subject->ptr,index);
+    li->iter = NULL;
+
+    // LISTPACK
+    if (li->encoding == REDIS_ENCODING_LISTPACK) {
+        li->zi = lpSeek(subject->ptr,index);
 
-    // ˫
-    } else if (li->encoding == REDIS_ENCODING_LINKEDLIST) {
-        li->ln = listIndex(subject->ptr,index);
+    // QUICKLIST
+    } else if (li->encoding == REDIS_ENCODING_QUICKLIST) {
+        // REDIS_TAIL ʾӱͷβ
+        int iter_direction = (direction == REDIS_HEAD) ?
+                             AL_START_TAIL : AL_START_HEAD;
+        li->iter = quicklistGetIteratorAtIdx(subject->ptr,iter_direction,index);
 
     // δ֪
     } else {
@@ -231,6 +232,7 @@ listTypeIterator *listTypeInitIterator(robj *subject, long index, unsigned char
  * ͷŵ
  */
 void listTypeReleaseIterator(listTypeIterator *li) {
+    quicklistReleaseIterator(li->iter);
     zfree(li);
 }
 
@@ -248,8 +250,8 @@ int listTypeNext(listTypeIterator *li, listTypeEntry *entry) {
 
     entry->li = li;
 
-    //  ZIPLIST
-    if (li->encoding == REDIS_ENCODING_ZIPLIST) {
+    //  LISTPACK
+    if (li->encoding == REDIS_ENCODING_LISTPACK) {
 
         // ¼ǰڵ㵽 entry
         entry->zi = li->zi;
@@ -257,26 +259,17 @@ int listTypeNext(listTypeIterator *li, listTypeEntry *entry) {
         // ƶָ
         if (entry->zi != NULL) {
             if (li->direction == REDIS_TAIL)
-                li->zi = ziplistNext(li->subject->ptr,li->zi);
+                li->zi = lpNext(li->subject->ptr,li->zi);
             else
-                li->zi = ziplistPrev(li->subject->ptr,li->zi);
+                li->zi = lpPrev(li->subject->ptr,li->zi);
             return 1;
         }
 
-    // ˫
-    } else if (li->encoding == REDIS_ENCODING_LINKEDLIST) {
+    //  QUICKLIST
+    } else if (li->encoding == REDIS_ENCODING_QUICKLIST) {
 
-        // ¼ǰڵ㵽 entry
-        entry->ln = li->ln;
-
-        // ƶָ
-        if (entry->ln != NULL) {
-            if (li->direction == REDIS_TAIL)
-                li->ln = li->ln->next;
-            else
-                li->ln = li->ln->prev;
-            return 1;
-        }
+        // Ϊձʾʼ˷Χ
+        return li->iter && quicklistNext(li->iter,&entry->entry);
 
     // δ֪
     } else {
@@ -299,13 +292,13 @@ robj *listTypeGet(listTypeEntry *entry) {
 
     robj *value = NULL;
 
-    //  ZIPLIST ȡڵֵ
-    if (li->encoding == REDIS_ENCODING_ZIPLIST) {
+    //  LISTPACK ȡڵֵ
+    if (li->encoding == REDIS_ENCODING_LISTPACK) {
         unsigned char *vstr;
         unsigned int vlen;
         long long vlong;
         redisAssert(entry->zi != NULL);
-        if (ziplistGet(entry->zi,&vstr,&vlen,&vlong)) {
+        if (lpGet(entry->zi,&vstr,&vlen,&vlong)) {
             if (vstr) {
                 value = createStringObject((char*)vstr,vlen);
             } else {
@@ -313,11 +306,14 @@ robj *listTypeGet(listTypeEntry *entry) {
             }
         }
 
-    // ˫ȡڵֵ
-    } else if (li->encoding == REDIS_ENCODING_LINKEDLIST) {
-        redisAssert(entry->ln != NULL);
-        value = listNodeValue(entry->ln);
-        incrRefCount(value);
+    //  QUICKLIST ȡڵֵ
+    } else if (li->encoding == REDIS_ENCODING_QUICKLIST) {
+        if (entry->entry.value) {
+            value = createStringObject((char*)entry->entry.value,
+                                       entry->entry.sz);
+        } else {
+            value = createStringObjectFromLongLong(entry->entry.longval);
+        }
 
     } else {
         redisPanic("Unknown list encoding");
@@ -339,39 +335,41 @@ void listTypeInsert(listTypeEntry *entry, robj *value, int where) {
 
     robj *subject = entry->li->subject;
 
-    // 뵽 ZIPLIST
-    if (entry->li->encoding == REDIS_ENCODING_ZIPLIST) {
+    // 뵽 LISTPACK
+    if (entry->li->encoding == REDIS_ENCODING_LISTPACK) {
 
         // ضδֵ
         value = getDecodedObject(value);
 
         if (where == REDIS_TAIL) {
-            unsigned char *next = ziplistNext(subject->ptr,entry->zi);
+            unsigned char *next = lpNext(subject->ptr,entry->zi);
 
             /* When we insert after the current element, but the current element
              * is the tail of the list, we need to do a push. */
             if (next == NULL) {
                 // next Ǳβڵ㣬push ½ڵ㵽β
-                subject->ptr = ziplistPush(subject->ptr,value->ptr,sdslen(value->ptr),REDIS_TAIL);
+                subject->ptr = lpPush(subject->ptr,value->ptr,sdslen(value->ptr),REDIS_TAIL);
             } else {
                 // 뵽ڵ֮
-                subject->ptr = ziplistInsert(subject->ptr,next,value->ptr,sdslen(value->ptr));
+                subject->ptr = lpInsert(subject->ptr,next,value->ptr,sdslen(value->ptr));
             }
         } else {
-            subject->ptr = ziplistInsert(subject->ptr,entry->zi,value->ptr,sdslen(value->ptr));
+            subject->ptr = lpInsert(subject->ptr,entry->zi,value->ptr,sdslen(value->ptr));
         }
         decrRefCount(value);
 
-    // 뵽˫
-    } else if (entry->li->encoding == REDIS_ENCODING_LINKEDLIST) {
+    // 뵽 QUICKLIST
+    } else if (entry->li->encoding == REDIS_ENCODING_QUICKLIST) {
 
+        value = getDecodedObject(value);
         if (where == REDIS_TAIL) {
-            listInsertNode(subject->ptr,entry->ln,value,AL_START_TAIL);
+            quicklistInsertAfter(subject->ptr,&entry->entry,
+                                 value->ptr,sdslen(value->ptr));
         } else {
-            listInsertNode(subject->ptr,entry->ln,value,AL_START_HEAD);
+            quicklistInsertBefore(subject->ptr,&entry->entry,
+                                  value->ptr,sdslen(value->ptr));
         }
-
-        incrRefCount(value);
+        decrRefCount(value);
 
     } else {
         redisPanic("Unknown list encoding");
@@ -388,12 +386,13 @@ int listTypeEqual(listTypeEntry *entry, robj *o) {
 
     listTypeIterator *li = entry->li;
 
-    if (li->encoding == REDIS_ENCODING_ZIPLIST) {
+    if (li->encoding == REDIS_ENCODING_LISTPACK) {
         redisAssertWithInfo(NULL,o,sdsEncodedObject(o));
-        return ziplistCompare(entry->zi,o->ptr,sdslen(o->ptr));
+        return lpCompare(entry->zi,o->ptr,sdslen(o->ptr));
 
-    } else if (li->encoding == REDIS_ENCODING_LINKEDLIST) {
-        return equalStringObjects(o,listNodeValue(entry->ln));
+    } else if (li->encoding == REDIS_ENCODING_QUICKLIST) {
+        redisAssertWithInfo(NULL,o,sdsEncodedObject(o));
+        return quicklistCompare(entry->entry.lp,o->ptr,sdslen(o->ptr));
 
     } else {
         redisPanic("Unknown list encoding");
@@ -408,36 +407,25 @@ void listTypeDelete(listTypeEntry *entry) {
 
     listTypeIterator *li = entry->li;
 
-    // ZIPLIST
-    if (li->encoding == REDIS_ENCODING_ZIPLIST) {
+    // LISTPACK
+    if (li->encoding == REDIS_ENCODING_LISTPACK) {
 
         unsigned char *p = entry->zi;
 
-        li->subject->ptr = ziplistDelete(li->subject->ptr,&p);
+        li->subject->ptr = lpDelete(li->subject->ptr,&p);
 
         /* Update position of the iterator depending on the direction */
         // ɾڵ֮󣬸µָ
         if (li->direction == REDIS_TAIL)
             li->zi = p;
         else
-            li->zi = ziplistPrev(li->subject->ptr,p);
+            li->zi = lpPrev(li->subject->ptr,p);
 
-    // ˫
-    } else if (entry->li->encoding == REDIS_ENCODING_LINKEDLIST) {
+    // QUICKLIST
+    } else if (entry->li->encoding == REDIS_ENCODING_QUICKLIST) {
 
-        // ¼ýڵ
-        listNode *next;
-
-        if (li->direction == REDIS_TAIL)
-            next = entry->ln->next;
-        else
-            next = entry->ln->prev;
-
-        // ɾǰڵ
-        listDelNode(li->subject->ptr,entry->ln);
-
-        // ɾڵ֮󣬸µָ
-        li->ln = next;
+        // ɾǰԪأµ
+        quicklistDelEntry(li->iter,&entry->entry);
 
     } else {
         redisPanic("Unknown list encoding");
@@ -445,37 +433,44 @@ void listTypeDelete(listTypeEntry *entry) {
 }
 
 /*
- * бĵײ ziplist ת˫
+ * бĵײ listpack ת quicklist
  */
 void listTypeConvert(robj *subject, int enc) {
 
-    listTypeIterator *li;
-
-    listTypeEntry entry;
-
     redisAssertWithInfo(NULL,subject,subject->type == REDIS_LIST);
+    redisAssertWithInfo(NULL,subject,
+                        subject->encoding == REDIS_ENCODING_LISTPACK);
 
-    // ת˫
-    if (enc == REDIS_ENCODING_LINKEDLIST) {
-
-        list *l = listCreate();
-
-        listSetFreeMethod(l,decrRefCountVoid);
+    // ת quicklist
+    if (enc == REDIS_ENCODING_QUICKLIST) {
 
-        /* listTypeGet returns a robj with incremented refcount */
-        //  ziplist ֵȫӵ˫
-        li = listTypeInitIterator(subject,0,REDIS_TAIL);
-        while (listTypeNext(li,&entry)) listAddNodeTail(l,listTypeGet(&entry));
-        listTypeReleaseIterator(li);
+        quicklist *ql = quicklistNew(server.list_max_ziplist_size,
+                                     server.list_compress_depth);
+        unsigned char *p, *vstr;
+        unsigned int vlen;
+        long long vlong;
+        char buf[32];
+
+        /* Push the elements one by one, so that the nodes respect the
+         * configured size. */
+        //  listpack ֵȫӵ quicklist 
+        for (p = lpFirst(subject->ptr); p; p = lpNext(subject->ptr,p)) {
+            lpGet(p,&vstr,&vlen,&vlong);
+            if (!vstr) {
+                vlen = ll2string(buf,sizeof(buf),vlong);
+                vstr = (unsigned char*)buf;
+            }
+            quicklistPushTail(ql,vstr,vlen);
+        }
 
         // ±
-        subject->encoding = REDIS_ENCODING_LINKEDLIST;
+        subject->encoding = REDIS_ENCODING_QUICKLIST;
 
-        // ͷԭ ziplist
+        // ͷԭ listpack
         zfree(subject->ptr);
 
         // ¶ֵָ
-        subject->ptr = l;
+        subject->ptr = ql;
 
     } else {
         redisPanic("Unsupported list conversion");
@@ -486,8 +481,8 @@ void listTypeConvert(robj *subject, int enc) {
  * List Commands
  *----------------------------------------------------------------------------*/
 /*
-lpushͨpushGenericCommand->createZiplistObjectб(Ĭϱ뷽ʽREDIS_ENCODING_ZIPLIST)ȻlistTypePush->listTypeTryConversion
-бнڵǷòlist_max_ziplist_value(Ĭ64)valueбֵѹΪ˫뷽ʽREDIS_ENCODING_LINKEDLISTlistTypePush->listTypeConvert
+lpushͨpushGenericCommand->createListpackObjectб(Ĭϱ뷽ʽREDIS_ENCODING_LISTPACK)ȻlistTypePush->listTypeTryConversion
+бнڵǷòlist_max_ziplist_value(Ĭ64)б listpack Ϊ뷽ʽREDIS_ENCODING_QUICKLISTlistTypePush->listTypeConvert
 */
 void pushGenericCommand(redisClient *c, int where) {
 
@@ -515,10 +510,10 @@ void pushGenericCommand(redisClient *c, int where) {
 
         // б󲻴ڣôһݿ
         if (!lobj) {
-            lobj = createZiplistObject(); 
+            lobj = createListpackObject(); 
       /*
-        lpushͨpushGenericCommand->createZiplistObjectб(Ĭϱ뷽ʽREDIS_ENCODING_ZIPLIST)ȻlistTypePush->listTypeTryConversion
-        бнڵǷòlist_max_ziplist_value(Ĭ64)valueбֵѹΪ˫뷽ʽREDIS_ENCODING_LINKEDLISTlistTypePush->listTypeConvert
+        lpushͨpushGenericCommand->createListpackObjectб(Ĭϱ뷽ʽREDIS_ENCODING_LISTPACK)ȻlistTypePush->listTypeTryConversion
+        бнڵǷòlist_max_ziplist_value(Ĭ64)б listpack Ϊ뷽ʽREDIS_ENCODING_QUICKLISTlistTypePush->listTypeConvert
         */
             dbAdd(c->db,c->argv[1],lobj);
         }
@@ -570,8 +565,8 @@ void pushxGenericCommand(redisClient *c, robj *refval, robj *val, int where) {
          * convert the list inside the iterator. We don't want to loop over
          * the list twice (once to see if the value can be inserted and once
          * to do the actual insert), so we assume this value can be inserted
-         * and convert the ziplist to a regular list if necessary. */
-        // ֵ value ǷҪбתΪ˫
+         * and convert the listpack to a quicklist if necessary. */
+        // ֵ value ǷҪбתΪ quicklist
         listTypeTryConversion(subject,val);
 
         /* Seek refval from head to tail */
@@ -588,11 +583,11 @@ void pushxGenericCommand(redisClient *c, robj *refval, robj *val, int where) {
         listTypeReleaseIterator(iter);
 
         if (inserted) {
-            /* Check if the length exceeds the ziplist length threshold. */
-            // 鿴֮ǷҪתΪ˫
-            if (subject->encoding == REDIS_ENCODING_ZIPLIST &&
-                ziplistLen(subject->ptr) > server.list_max_ziplist_entries)
-                    listTypeConvert(subject,REDIS_ENCODING_LINKEDLIST);
+            /* Check if the length exceeds the listpack length threshold. */
+            // 鿴֮ǷҪתΪ quicklist
+            if (subject->encoding == REDIS_ENCODING_LISTPACK &&
+                lpLength(subject->ptr) > server.list_max_ziplist_entries)
+                    listTypeConvert(subject,REDIS_ENCODING_QUICKLIST);
 
             signalModifiedKey(c->db,c->argv[1]);
 
@@ -669,16 +664,16 @@ void lindexCommand(redisClient *c) {
     if ((getLongFromObjectOrReply(c, c->argv[2], &index, NULL) != REDIS_OK))
         return;
 
-    //  ziplist ֱָλ
-    if (o->encoding == REDIS_ENCODING_ZIPLIST) {
+    //  listpack ֱָλ
+    if (o->encoding == REDIS_ENCODING_LISTPACK) {
         unsigned char *p;
         unsigned char *vstr;
         unsigned int vlen;
         long long vlong;
 
-        p = ziplistIndex(o->ptr,index);
+        p = lpSeek(o->ptr,index);
 
-        if (ziplistGet(p,&vstr,&vlen,&vlong)) {
+        if (lpGet(p,&vstr,&vlen,&vlong)) {
             if (vstr) {
                 value = createStringObject((char*)vstr,vlen);
             } else {
@@ -690,17 +685,23 @@ void lindexCommand(redisClient *c) {
             addReply(c,shared.nullbulk);
         }
 
-    // ˫ֱָλ
-    } else if (o->encoding == REDIS_ENCODING_LINKEDLIST) {
+    // ҵ quicklist еĽڵ㣬Ȼڽڵ listpack в
+    } else if (o->encoding == REDIS_ENCODING_QUICKLIST) {
+        quicklistIter *iter;
+        quicklistEntry entry;
 
-        listNode *ln = listIndex(o->ptr,index);
-
-        if (ln != NULL) {
-            value = listNodeValue(ln);
-            addReplyBulk(c,value);
+        iter = quicklistGetIteratorAtIdx(o->ptr,AL_START_HEAD,index);
+        if (iter && quicklistNext(iter,&entry)) {
+            if (entry.value) {
+                addReplyBulkCBuffer(c,entry.value,entry.sz);
+            } else {
+                addReplyBulkLongLong(c,entry.longval);
+            }
         } else {
             addReply(c,shared.nullbulk);
         }
+        // ͷŵʱѹʵĽڵ
+        quicklistReleaseIterator(iter);
     } else {
         redisPanic("Unknown list encoding");
     }
@@ -724,19 +725,17 @@ void lsetCommand(redisClient *c) {
     // 鿴 value ֵǷҪתбĵײ
     listTypeTryConversion(o,value);
 
-    // õ ziplist
-    if (o->encoding == REDIS_ENCODING_ZIPLIST) {
+    // õ listpack
+    if (o->encoding == REDIS_ENCODING_LISTPACK) {
         unsigned char *p, *zl = o->ptr;
         // 
-        p = ziplistIndex(zl,index);
+        p = lpSeek(zl,index);
         if (p == NULL) {
             addReply(c,shared.outofrangeerr);
         } else {
-            // ɾеֵ
-            o->ptr = ziplistDelete(o->ptr,&p);
-            // ֵָ
+            // ֵ滻еֵ
             value = getDecodedObject(value);
-            o->ptr = ziplistInsert(o->ptr,p,value->ptr,sdslen(value->ptr));
+            o->ptr = lpReplace(o->ptr,&p,value->ptr,sdslen(value->ptr));
             decrRefCount(value);
 
             addReply(c,shared.ok);
@@ -745,20 +744,19 @@ void lsetCommand(redisClient *c) {
             server.dirty++;
         }
 
-    // õ˫
-    } else if (o->encoding == REDIS_ENCODING_LINKEDLIST) {
+    // õ quicklist
+    } else if (o->encoding == REDIS_ENCODING_QUICKLIST) {
+        int replaced;
 
-        listNode *ln = listIndex(o->ptr,index);
+        // ֵ滻еֵ
+        value = getDecodedObject(value);
+        replaced = quicklistReplaceAtIndex(o->ptr,index,
+                                           value->ptr,sdslen(value->ptr));
+        decrRefCount(value);
 
-        if (ln == NULL) {
+        if (!replaced) {
             addReply(c,shared.outofrangeerr);
         } else {
-            // ɾֵ
-            decrRefCount((robj*)listNodeValue(ln));
-            // ָ¶
-            listNodeValue(ln) = value;
-            incrRefCount(value);
-
             addReply(c,shared.ok);
             signalModifiedKey(c->db,c->argv[1]);
             notifyKeyspaceEvent(REDIS_NOTIFY_LIST,"lset",c->argv[1],c->db->id);
@@ -839,47 +837,51 @@ void lrangeCommand(redisClient *c) {
     /* Return the result in form of a multi-bulk reply */
     addReplyMultiBulkLen(c,rangelen);
 
-    if (o->encoding == REDIS_ENCODING_ZIPLIST) {
-        unsigned char *p = ziplistIndex(o->ptr,start);
+    if (o->encoding == REDIS_ENCODING_LISTPACK) {
+        unsigned char *p = lpSeek(o->ptr,start);
         unsigned char *vstr;
         unsigned int vlen;
         long long vlong;
 
-        //  ziplist ָϵֵӵظ
+        //  listpack ָϵֵӵظ
         while(rangelen--) {
-            ziplistGet(p,&vstr,&vlen,&vlong);
+            lpGet(p,&vstr,&vlen,&vlong);
             if (vstr) {
                 addReplyBulkCBuffer(c,vstr,vlen);
             } else {
                 addReplyBulkLongLong(c,vlong);
             }
-            p = ziplistNext(o->ptr,p);
+            p = lpNext(o->ptr,p);
         }
 
-    } else if (o->encoding == REDIS_ENCODING_LINKEDLIST) {
-        listNode *ln;
+    } else if (o->encoding == REDIS_ENCODING_QUICKLIST) {
+        quicklistIter *iter;
+        quicklistEntry entry;
 
         /* If we are nearest to the end of the list, reach the element
          * starting from tail and going backward, as it is faster. */
         if (start > llen/2) start -= llen;
-        ln = listIndex(o->ptr,start);
+        iter = quicklistGetIteratorAtIdx(o->ptr,AL_START_HEAD,start);
 
-        // ˫ָϵֵӵظ
+        //  quicklist ָϵֵӵظ
         while(rangelen--) {
-            addReplyBulk(c,ln->value);
-            ln = ln->next;
+            quicklistNext(iter,&entry);
+            if (entry.value) {
+                addReplyBulkCBuffer(c,entry.value,entry.sz);
+            } else {
+                addReplyBulkLongLong(c,entry.longval);
+            }
         }
+        quicklistReleaseIterator(iter);
 
     } else {
-        redisPanic("List encoding is not LINKEDLIST nor ZIPLIST!");
+        redisPanic("List encoding is not QUICKLIST nor LISTPACK!");
     }
 }
 
 void ltrimCommand(redisClient *c) {
     robj *o;
-    long start, end, llen, j, ltrim, rtrim;
-    list *list;
-    listNode *ln;
+    long start, end, llen, ltrim, rtrim;
 
     // ȡֵ start  end
     if ((getLongFromObjectOrReply(c, c->argv[2], &start, NULL) != REDIS_OK) ||
@@ -913,24 +915,17 @@ void ltrimCommand(redisClient *c) {
     /* Remove list elements to perform the trim */
     // ɾָб˵Ԫ
 
-    if (o->encoding == REDIS_ENCODING_ZIPLIST) {
+    if (o->encoding == REDIS_ENCODING_LISTPACK) {
         // ɾԪ
-        o->ptr = ziplistDeleteRange(o->ptr,0,ltrim);
+        o->ptr = lpDeleteRange(o->ptr,0,ltrim);
         // ɾҶԪ
-        o->ptr = ziplistDeleteRange(o->ptr,-rtrim,rtrim);
+        o->ptr = lpDeleteRange(o->ptr,-rtrim,rtrim);
 
-    } else if (o->encoding == REDIS_ENCODING_LINKEDLIST) {
-        list = o->ptr;
+    } else if (o->encoding == REDIS_ENCODING_QUICKLIST) {
         // ɾԪ
-        for (j = 0; j < ltrim; j++) {
-            ln = listFirst(list);
-            listDelNode(list,ln);
-        }
+        quicklistDelRange(o->ptr,0,ltrim);
         // ɾҶԪ
-        for (j = 0; j < rtrim; j++) {
-            ln = listLast(list);
-            listDelNode(list,ln);
-        }
+        quicklistDelRange(o->ptr,-rtrim,rtrim);
 
     } else {
         redisPanic("Unknown list encoding");
@@ -969,9 +964,8 @@ void lremCommand(redisClient *c) {
     subject = lookupKeyWriteOrReply(c,c->argv[1],shared.czero);
     if (subject == NULL || checkType(c,subject,REDIS_LIST)) return;
 
-    /* Make sure obj is raw when we're dealing with a ziplist */
-    if (subject->encoding == REDIS_ENCODING_ZIPLIST)
-        obj = getDecodedObject(obj);
+    /* Make sure obj is raw: both encodings compare listpack entries */
+    obj = getDecodedObject(obj);
 
     listTypeIterator *li;
 
@@ -996,8 +990,7 @@ void lremCommand(redisClient *c) {
     listTypeReleaseIterator(li);
 
     /* Clean up raw encoded object */
-    if (subject->encoding == REDIS_ENCODING_ZIPLIST)
-        decrRefCount(obj);
+    decrRefCount(obj);
 
     // ɾб
     if (listTypeLength(subject) == 0) dbDelete(c->db,c->argv[1]);
@@ -1027,7 +1020,7 @@ void rpoplpushHandlePush(redisClient *c, robj *dstkey, robj *dstobj, robj *value
     /* Create the list if the key does not exist */
     // Ŀбڣôһ
     if (!dstobj) {
-        dstobj = createZiplistObject();
+        dstobj = createListpackObject();
         dbAdd(c->db,dstkey,dstobj);
         signalListAsReady(c,dstkey);
     }
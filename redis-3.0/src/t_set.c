@@ -983,6 +983,36 @@ void sinterGenericCommand(redisClient *c, robj **setkeys, unsigned long setnum,
     // Ϊ֪жٸԪأûа취ֱûظ
     // ʹһСɣֱʹһ BUFF б
     // Ȼ֮Ļظӵб
+    /* When all the sets are intsets the sorted arrays are intersected
+     * directly, without creating an object for every element. */
+    // м϶ϣôֱӶ󽻼
+    // ΪÿԪش
+    for (j = 0; j < setnum; j++)
+        if (sets[j]->encoding != REDIS_ENCODING_INTSET) break;
+    if (j == setnum) {
+        intset **isets = zmalloc(sizeof(intset*)*setnum);
+        intset *is;
+
+        for (j = 0; j < setnum; j++) isets[j] = sets[j]->ptr;
+        is = intsetIntersect(isets,setnum);
+        zfree(isets);
+
+        if (!dstkey) {
+            addReplyMultiBulkLen(c,intsetLen(is));
+            for (j = 0; j < intsetLen(is); j++) {
+                intsetGet(is,j,&intobj);
+                addReplyBulkLongLong(c,intobj);
+            }
+            zfree(is);
+        } else {
+            dstset = createObject(REDIS_SET,is);
+            dstset->encoding = REDIS_ENCODING_INTSET;
+            if (intsetLen(is) > server.set_max_intset_entries)
+                setTypeConvert(dstset,REDIS_ENCODING_HT);
+        }
+        goto store;
+    }
+
     if (!dstkey) {
         replylen = addDeferredMultiBulkLength(c);
     } else {
@@ -1070,6 +1100,7 @@ void sinterGenericCommand(redisClient *c, robj **setkeys, unsigned long setnum,
     }
     setTypeReleaseIterator(si);
 
+store:
     // SINTERSTORE ݿ
     if (dstkey) {
         /* Store the resulting set into the target, if the intersection
@@ -1096,7 +1127,7 @@ void sinterGenericCommand(redisClient *c, robj **setkeys, unsigned long setnum,
         server.dirty++;
 
     // SINTER ظĻ
-    } else {
+    } else if (replylen) {
         setDeferredMultiBulkLength(c,replylen,cardinality);
     }
 
@@ -1127,6 +1158,7 @@ void sunionDiffGenericCommand(redisClient *c, robj **setkeys, int setnum, robj *
     robj *ele, *dstset = NULL;
     int j, cardinality = 0;
     int diff_algo = 1;
+    int merged = 0;
 
     // ȡм϶󣬲ӵ
     for (j = 0; j < setnum; j++) {
@@ -1208,8 +1240,30 @@ void sunionDiffGenericCommand(redisClient *c, robj **setkeys, int setnum, robj *
      */
     dstset = createIntsetObject();
 
-    // ִеǲ
+    /* Union of intsets only: merge the sorted arrays. */
+    // дڵļ϶ϣôֱӺϲ
     if (op == REDIS_OP_UNION) {
+        intset **isets = zmalloc(sizeof(intset*)*setnum);
+        int isetnum = 0;
+
+        for (j = 0; j < setnum; j++) {
+            if (!sets[j]) continue;
+            if (sets[j]->encoding != REDIS_ENCODING_INTSET) break;
+            isets[isetnum++] = sets[j]->ptr;
+        }
+        if (j == setnum) {
+            zfree(dstset->ptr);
+            dstset->ptr = intsetUnion(isets,isetnum);
+            cardinality = intsetLen(dstset->ptr);
+            if (cardinality > server.set_max_intset_entries)
+                setTypeConvert(dstset,REDIS_ENCODING_HT);
+            merged = 1;
+        }
+        zfree(isets);
+    }
+
+    // ִеǲ
+    if (op == REDIS_OP_UNION && !merged) {
         /* Union is trivial, just add every element of every set to the
          * temporary set. */
         // мϣԪӵͿ
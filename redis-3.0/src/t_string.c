@@ -553,30 +553,37 @@ void getrangeCommand(redisClient *c) {
 }
 
 void mgetCommand(redisClient *c) {
-    int j;
+    robj *vals[REDIS_LOOKUP_BATCH];
+    int j, k, n;
 
     addReplyMultiBulkLen(c,c->argc-1);
-    // Ҳֵ
-    for (j = 1; j < c->argc; j++) {
-        // Ҽ c->argc[j] ֵ
-        robj *o = lookupKeyRead(c->db,c->argv[j]);
-        if (o == NULL) {
-            // ֵڣͻ˷Ϳջظ
-            addReply(c,shared.nullbulk);
-        } else {
-            if (o->type != REDIS_STRING) {
-                // ֵڣַ
+    // Ҳֵÿһ
+    for (j = 1; j < c->argc; j += n) {
+        n = c->argc-j;
+        if (n > REDIS_LOOKUP_BATCH) n = REDIS_LOOKUP_BATCH;
+        lookupKeysRead(c->db,c->argv+j,n,1,vals);
+
+        for (k = 0; k < n; k++) {
+            robj *o = vals[k];
+            if (o == NULL) {
+                // ֵڣͻ˷Ϳջظ
                 addReply(c,shared.nullbulk);
             } else {
-                // ֵڣַ
-                addReplyBulk(c,o);
+                if (o->type != REDIS_STRING) {
+                    // ֵڣַ
+                    addReply(c,shared.nullbulk);
+                } else {
+                    // ֵڣַ
+                    addReplyBulk(c,o);
+                }
             }
         }
     }
 }
 
 void msetGenericCommand(redisClient *c, int nx) {
-    int j, busykeys = 0;
+    robj *vals[REDIS_LOOKUP_BATCH];
+    int j, k, n, busykeys = 0;
 
     // ֵǳɶԳֵģʽȷ
     if ((c->argc % 2) == 0) {
@@ -589,10 +596,12 @@ void msetGenericCommand(redisClient *c, int nx) {
     // ֻҪһǴڵģôͻ˷Ϳջظ
     // ִнò
     if (nx) {
-        for (j = 1; j < c->argc; j += 2) {
-            if (lookupKeyWrite(c->db,c->argv[j]) != NULL) {
-                busykeys++;
-            }
+        for (j = 1; j < c->argc; j += n*2) {
+            n = (c->argc-j)/2;
+            if (n > REDIS_LOOKUP_BATCH) n = REDIS_LOOKUP_BATCH;
+            lookupKeysWrite(c->db,c->argv+j,n,2,vals);
+            for (k = 0; k < n; k++)
+                if (vals[k] != NULL) busykeys++;
         }
         // 
         // Ϳհ׻ظִнò
@@ -605,6 +614,15 @@ void msetGenericCommand(redisClient *c, int nx) {
     // мֵ
     for (j = 1; j < c->argc; j += 2) {
 
+        /* Look up the next keys at once, so that setKey() finds them in
+         * the cache. */
+        // ҽһʹ setKey() Ĳл
+        if ((j-1) % (REDIS_LOOKUP_BATCH*2) == 0) {
+            n = (c->argc-j)/2;
+            if (n > REDIS_LOOKUP_BATCH) n = REDIS_LOOKUP_BATCH;
+            lookupKeysWrite(c->db,c->argv+j,n,2,vals);
+        }
+
         // ֵн
         c->argv[j+1] = tryObjectEncoding(c->argv[j+1]);
 
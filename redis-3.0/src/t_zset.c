@@ -981,7 +981,750 @@ zskiplistNode *zslLastInLexRange(zskiplist *zsl, zlexrangespec *range) {
 }
 
 /*-----------------------------------------------------------------------------
- * Ziplist-backed sorted set API
+ * B+tree sorted set index
+ *----------------------------------------------------------------------------*/
+
+/* Big sorted sets can be indexed by an order statistic B+tree instead of the
+ * skiplist (zset-btree yes). It offers the same operations as the zsl* API
+ * with the same complexity, but elements live in wide leaves: the index costs
+ * about one pointer per element instead of a node header plus a level array,
+ * and walking a range touches a new cache line only every few elements.
+ *
+ * 򼯺Ͽʹô B+ ԾΪzset-btree yes
+ * ṩ zsl* API ͬĲ͸ӶȣԪرڿҶӽڵУ
+ * ÿԪֻҪԼһָĶռ䣬һڵͷһ飬
+ * ΧʱÿԪزҪһµĻС
+ *
+ * Deletions don't borrow elements between siblings: a node that falls below
+ * ZBTREE_MIN_FILL entries is merged into a neighbour when both fit in a
+ * single node, and empty nodes are always removed, so only the root can be
+ * an empty leaf.
+ *
+ * ɾʱֵܽڵ֮䲻ụԪأ
+ * Ԫ ZBTREE_MIN_FILL Ľڵ㣬ܺڽڵŽͬһڵ㣬ͽкϲ
+ * սڵǻᱻɾֻиڵǿյҶӽڵ㡣
+ */
+
+#define ZBTREE_MIN_FILL (ZBTREE_NODE_SIZE/4)
+
+/* Compare two elements by score, then by member, like the skiplist. */
+static int zbtCompare(double s1, robj *o1, double s2, robj *o2) {
+    if (s1 < s2) return -1;
+    if (s1 > s2) return 1;
+    return compareStringObjects(o1,o2);
+}
+
+static zbtreeLeaf *zbtCreateLeaf(void) {
+    zbtreeLeaf *leaf = zmalloc(sizeof(*leaf));
+
+    leaf->prev = leaf->next = NULL;
+    leaf->count = 0;
+    return leaf;
+}
+
+/*
+ * һµ B+ 
+ *
+ * T = O(1)
+ */
+zbtree *zbtCreate(void) {
+    zbtree *t = zmalloc(sizeof(*t));
+
+    t->head = t->tail = zbtCreateLeaf();
+    t->root = t->head;
+    t->height = 0;
+    t->length = 0;
+    return t;
+}
+
+static void zbtFreeNode(void *node, int height) {
+    int j;
+
+    if (height == 0) {
+        zbtreeLeaf *leaf = node;
+
+        for (j = 0; j < leaf->count; j++) decrRefCount(leaf->obj[j]);
+    } else {
+        zbtreeInner *n = node;
+
+        for (j = 0; j < n->count; j++) {
+            if (j > 0) decrRefCount(n->obj[j]);
+            zbtFreeNode(n->child[j],height-1);
+        }
+    }
+    zfree(node);
+}
+
+/*
+ * ͷŸ B+ ԼеԪ
+ *
+ * T = O(N)
+ */
+void zbtFree(zbtree *t) {
+    zbtFreeNode(t->root,t->height);
+    zfree(t);
+}
+
+/* Number of entries of a leaf, or of children of an inner node. */
+static int zbtNodeCount(void *node, int height) {
+    return height ? ((zbtreeInner*)node)->count : ((zbtreeLeaf*)node)->count;
+}
+
+/* Number of elements stored under 'node'. */
+static unsigned long zbtNodeSize(void *node, int height) {
+    zbtreeInner *n = node;
+    unsigned long size = 0;
+    int j;
+
+    if (height == 0) return ((zbtreeLeaf*)node)->count;
+    for (j = 0; j < n->count; j++) size += n->size[j];
+    return size;
+}
+
+/* Return the index of the child of 'n' that can hold the given element,
+ * that is the last child whose separator is <= the element.
+ *
+ * ؿܰԪصӽڵ
+ * ҲһָСڵڸԪصӽڵ㡣
+ */
+static int zbtInnerFind(zbtreeInner *n, double score, robj *obj) {
+    int lo = 1, hi = n->count-1;
+
+    while (lo <= hi) {
+        int mid = (lo+hi)/2;
+
+        if (zbtCompare(n->score[mid],n->obj[mid],score,obj) <= 0)
+            lo = mid+1;
+        else
+            hi = mid-1;
+    }
+    return lo-1;
+}
+
+/* Return the index of the first element of 'leaf' that is >= the given one,
+ * or leaf->count if there is none.
+ *
+ * ҶӽڵеһڵڸԪصԪص
+ * ûԪʱ leaf->count 
+ */
+static int zbtLeafFind(zbtreeLeaf *leaf, double score, robj *obj) {
+    int lo = 0, hi = leaf->count;
+
+    while (lo < hi) {
+        int mid = (lo+hi)/2;
+
+        if (zbtCompare(leaf->score[mid],leaf->obj[mid],score,obj) < 0)
+            lo = mid+1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static void zbtLeafInsertAt(zbtreeLeaf *leaf, int pos, double score, robj *obj) {
+    memmove(leaf->score+pos+1,leaf->score+pos,sizeof(double)*(leaf->count-pos));
+    memmove(leaf->obj+pos+1,leaf->obj+pos,sizeof(robj*)*(leaf->count-pos));
+    leaf->score[pos] = score;
+    leaf->obj[pos] = obj;
+    leaf->count++;
+}
+
+/* Add 'child', the right half of the split child[pos-1], at position 'pos'
+ * of 'n' using score / obj as separator. The elements moved to the new node
+ * are no longer counted in the size of its left sibling. */
+static void zbtInnerInsertAt(zbtreeInner *n, int pos, double score, robj *obj,
+                             void *child, int height)
+{
+    int tail = n->count-pos;
+
+    memmove(n->score+pos+1,n->score+pos,sizeof(double)*tail);
+    memmove(n->obj+pos+1,n->obj+pos,sizeof(robj*)*tail);
+    memmove(n->size+pos+1,n->size+pos,sizeof(unsigned long)*tail);
+    memmove(n->child+pos+1,n->child+pos,sizeof(void*)*tail);
+    n->score[pos] = score;
+    n->obj[pos] = obj;
+    n->child[pos] = child;
+    n->size[pos] = zbtNodeSize(child,height);
+    n->size[pos-1] -= n->size[pos];
+    n->count++;
+}
+
+/* Insert the element under 'node'. When the node has to be split the new
+ * right sibling is returned, and its first element is stored in *sepscore
+ * and *sepobj (with a new reference) to be used as separator by the caller.
+ * Otherwise NULL is returned.
+ *
+ * Ԫز뵽 node ֮¡
+ * ڵҪѣô´ֵܽڵ㣬
+ * ĵһԪر浽 *sepscore  *sepobj УΪڵķָ
+ * 򷵻 NULL 
+ */
+static void *zbtInsertNode(zbtree *t, void *node, int height, double score,
+                           robj *obj, double *sepscore, robj **sepobj)
+{
+    int half;
+
+    if (height == 0) {
+        zbtreeLeaf *leaf = node, *right;
+        int pos = zbtLeafFind(leaf,score,obj);
+
+        if (leaf->count < ZBTREE_NODE_SIZE) {
+            zbtLeafInsertAt(leaf,pos,score,obj);
+            return NULL;
+        }
+
+        /* Split the leaf in two halves. When appending to the last leaf or
+         * prepending to the first one the full leaf is left untouched, so
+         * that elements added in order fill the leaves completely. */
+        // Ҷӽڵ
+        // һҶӽڵβһҶӽڵͷԪأ
+        // ôԭڵΪ״̬˳ӵԪؿҶӽڵ
+        if (pos == leaf->count && leaf->next == NULL)
+            half = leaf->count;
+        else if (pos == 0 && leaf->prev == NULL)
+            half = 0;
+        else
+            half = ZBTREE_NODE_SIZE/2;
+        right = zbtCreateLeaf();
+        right->count = leaf->count-half;
+        memcpy(right->score,leaf->score+half,sizeof(double)*right->count);
+        memcpy(right->obj,leaf->obj+half,sizeof(robj*)*right->count);
+        leaf->count = half;
+
+        // ½ڵӵԭڵ֮
+        right->prev = leaf;
+        right->next = leaf->next;
+        if (leaf->next)
+            leaf->next->prev = right;
+        else
+            t->tail = right;
+        leaf->next = right;
+
+        if (pos < half || (pos == half && half < ZBTREE_NODE_SIZE))
+            zbtLeafInsertAt(leaf,pos,score,obj);
+        else
+            zbtLeafInsertAt(right,pos-half,score,obj);
+
+        *sepscore = right->score[0];
+        *sepobj = right->obj[0];
+        incrRefCount(*sepobj);
+        return right;
+    } else {
+        zbtreeInner *n = node, *right;
+        int i = zbtInnerFind(n,score,obj);
+        double cscore;
+        robj *cobj;
+        void *child;
+
+        child = zbtInsertNode(t,n->child[i],height-1,score,obj,&cscore,&cobj);
+        n->size[i]++;
+        if (child == NULL) return NULL;
+
+        // ӽڵѾѣ½ڵӵĺ
+        if (n->count < ZBTREE_NODE_SIZE) {
+            zbtInnerInsertAt(n,i+1,cscore,cobj,child,height-1);
+            return NULL;
+        }
+
+        /* Split the inner node: the separator of the first child moved to
+         * the new node goes up to the parent. */
+        // ڲڵ㣬ƶ½ڵĵһӽڵķָڵ
+        half = ZBTREE_NODE_SIZE/2;
+        right = zmalloc(sizeof(*right));
+        right->count = n->count-half;
+        memcpy(right->score,n->score+half,sizeof(double)*right->count);
+        memcpy(right->obj,n->obj+half,sizeof(robj*)*right->count);
+        memcpy(right->size,n->size+half,sizeof(unsigned long)*right->count);
+        memcpy(right->child,n->child+half,sizeof(void*)*right->count);
+        n->count = half;
+        *sepscore = right->score[0];
+        *sepobj = right->obj[0];
+
+        if (i+1 <= half)
+            zbtInnerInsertAt(n,i+1,cscore,cobj,child,height-1);
+        else
+            zbtInnerInsertAt(right,i+1-half,cscore,cobj,child,height-1);
+        return right;
+    }
+}
+
+/*
+ * ԱͷֵԪӵ B+ У
+ * Ԫر벻Уӹܵ߶ obj һã zslInsert() һ
+ *
+ * Insert an element that is not already in the tree. Like zslInsert() the
+ * tree takes over a reference of 'obj'.
+ *
+ * T = O(log N)
+ */
+void zbtInsert(zbtree *t, double score, robj *obj) {
+    double sepscore;
+    robj *sepobj;
+    void *right;
+
+    right = zbtInsertNode(t,t->root,t->height,score,obj,&sepscore,&sepobj);
+
+    // ڵѾѣµĸڵ㣬ĸ߶һ
+    if (right) {
+        zbtreeInner *root = zmalloc(sizeof(*root));
+
+        root->count = 2;
+        root->child[0] = t->root;
+        root->size[0] = zbtNodeSize(t->root,t->height);
+        root->child[1] = right;
+        root->size[1] = zbtNodeSize(right,t->height);
+        root->score[1] = sepscore;
+        root->obj[1] = sepobj;
+        t->root = root;
+        t->height++;
+    }
+    t->length++;
+}
+
+/* Remove child 'j' of 'n' together with the separator that goes away with
+ * it. The separator reference is released unless 'keepsep' is true because
+ * the caller moved it somewhere else. */
+static void zbtInnerRemove(zbtreeInner *n, int j, int keepsep) {
+    /* When the first child goes away the separator of the second one is no
+     * longer needed, as it becomes the first child. */
+    int k = (j == 0) ? 1 : j;
+
+    if (k < n->count) {
+        if (!keepsep) decrRefCount(n->obj[k]);
+        memmove(n->score+k,n->score+k+1,sizeof(double)*(n->count-k-1));
+        memmove(n->obj+k,n->obj+k+1,sizeof(robj*)*(n->count-k-1));
+    }
+    memmove(n->size+j,n->size+j+1,sizeof(unsigned long)*(n->count-j-1));
+    memmove(n->child+j,n->child+j+1,sizeof(void*)*(n->count-j-1));
+    n->count--;
+}
+
+/* Merge child 'j' of 'n' into child j-1. Children are at level 'height'. */
+static void zbtMerge(zbtree *t, zbtreeInner *n, int j, int height) {
+    void *r = n->child[j];
+
+    if (height == 0) {
+        zbtreeLeaf *left = n->child[j-1], *right = r;
+
+        memcpy(left->score+left->count,right->score,sizeof(double)*right->count);
+        memcpy(left->obj+left->count,right->obj,sizeof(robj*)*right->count);
+        left->count += right->count;
+        left->next = right->next;
+        if (right->next)
+            right->next->prev = left;
+        else
+            t->tail = left;
+        n->size[j-1] += n->size[j];
+        zbtInnerRemove(n,j,0);
+    } else {
+        zbtreeInner *left = n->child[j-1], *right = r;
+        int c = left->count;
+
+        /* The separator of the right node in the parent now separates its
+         * first child from the last child of the left node. */
+        left->score[c] = n->score[j];
+        left->obj[c] = n->obj[j];
+        memcpy(left->score+c+1,right->score+1,sizeof(double)*(right->count-1));
+        memcpy(left->obj+c+1,right->obj+1,sizeof(robj*)*(right->count-1));
+        memcpy(left->size+c,right->size,sizeof(unsigned long)*right->count);
+        memcpy(left->child+c,right->child,sizeof(void*)*right->count);
+        left->count += right->count;
+        n->size[j-1] += n->size[j];
+        zbtInnerRemove(n,j,1);
+    }
+    zfree(r);
+}
+
+static int zbtDeleteNode(zbtree *t, void *node, int height, double score, robj *obj) {
+    if (height == 0) {
+        zbtreeLeaf *leaf = node;
+        int pos = zbtLeafFind(leaf,score,obj);
+
+        if (pos == leaf->count ||
+            zbtCompare(leaf->score[pos],leaf->obj[pos],score,obj) != 0)
+            return 0;
+        decrRefCount(leaf->obj[pos]);
+        memmove(leaf->score+pos,leaf->score+pos+1,sizeof(double)*(leaf->count-pos-1));
+        memmove(leaf->obj+pos,leaf->obj+pos+1,sizeof(robj*)*(leaf->count-pos-1));
+        leaf->count--;
+        return 1;
+    } else {
+        zbtreeInner *n = node;
+        int i = zbtInnerFind(n,score,obj), c;
+
+        if (!zbtDeleteNode(t,n->child[i],height-1,score,obj)) return 0;
+        n->size[i]--;
+
+        if (n->size[i] == 0) {
+            /* Drop the empty child. An empty inner node has no children
+             * left, as they were dropped the same way. */
+            // ɾӽڵ
+            if (height == 1) {
+                zbtreeLeaf *leaf = n->child[i];
+
+                if (leaf->prev)
+                    leaf->prev->next = leaf->next;
+                else
+                    t->head = leaf->next;
+                if (leaf->next)
+                    leaf->next->prev = leaf->prev;
+                else
+                    t->tail = leaf->prev;
+            }
+            zfree(n->child[i]);
+            zbtInnerRemove(n,i,0);
+        } else if ((c = zbtNodeCount(n->child[i],height-1)) < ZBTREE_MIN_FILL) {
+            // ӽڵԪع٣Ժڽڵϲ
+            if (i > 0 &&
+                zbtNodeCount(n->child[i-1],height-1)+c <= ZBTREE_NODE_SIZE)
+                zbtMerge(t,n,i,height-1);
+            else if (i+1 < n->count &&
+                c+zbtNodeCount(n->child[i+1],height-1) <= ZBTREE_NODE_SIZE)
+                zbtMerge(t,n,i+1,height-1);
+        }
+        return 1;
+    }
+}
+
+/*
+ *  B+ ɾԱͷֵԪأͷԳԱá
+ *
+ * Delete an element with matching score/object from the B+tree.
+ * Returns 1 if the element was found and deleted, 0 otherwise.
+ *
+ * T = O(log N)
+ */
+int zbtDelete(zbtree *t, double score, robj *obj) {
+    if (!zbtDeleteNode(t,t->root,t->height,score,obj)) return 0;
+    t->length--;
+
+    /* Remove the root while it has a single child. */
+    // ڵֻһӽڵʱĸ߶
+    while (t->height > 0 && ((zbtreeInner*)t->root)->count <= 1) {
+        zbtreeInner *root = t->root;
+
+        if (root->count == 0) {
+            /* The tree is empty, start again from an empty leaf. */
+            t->head = t->tail = zbtCreateLeaf();
+            t->root = t->head;
+            t->height = 0;
+        } else {
+            t->root = root->child[0];
+            t->height--;
+        }
+        zfree(root);
+    }
+    return 1;
+}
+
+/*
+ * ذԱͷֵԪ B+ еλλ 1 Ϊʼֵ
+ * Ԫزʱ 0 
+ *
+ * Find the 1-based rank of an element. Returns 0 when it is not found.
+ *
+ * T = O(log N)
+ */
+unsigned long zbtGetRank(zbtree *t, double score, robj *o) {
+    void *node = t->root;
+    unsigned long rank = 0;
+    int h, pos;
+    zbtreeLeaf *leaf;
+
+    for (h = t->height; h > 0; h--) {
+        zbtreeInner *n = node;
+        int i = zbtInnerFind(n,score,o), j;
+
+        // ۼԽԪ
+        for (j = 0; j < i; j++) rank += n->size[j];
+        node = n->child[i];
+    }
+
+    leaf = node;
+    pos = zbtLeafFind(leaf,score,o);
+    if (pos < leaf->count &&
+        zbtCompare(leaf->score[pos],leaf->obj[pos],score,o) == 0)
+        return rank+pos+1;
+    return 0;
+}
+
+/*
+ * λ 1 ΪʼֵλԪأҵʱ it  1 򷵻 0 
+ *
+ * Position 'it' at the element with the given 1-based rank. Returns 0 when
+ * the rank is out of range.
+ *
+ * T = O(log N)
+ */
+int zbtGetElementByRank(zbtree *t, unsigned long rank, zbtreeIter *it) {
+    void *node = t->root;
+    int h;
+
+    if (rank == 0 || rank > t->length) return 0;
+
+    /* Check if the element is trivial to find, before doing the lookup. */
+    if (rank == t->length) {
+        it->leaf = t->tail;
+        it->idx = t->tail->count-1;
+        return 1;
+    }
+
+    rank--;
+    for (h = t->height; h > 0; h--) {
+        zbtreeInner *n = node;
+        int i = 0;
+
+        while (rank >= n->size[i]) rank -= n->size[i++];
+        node = n->child[i];
+    }
+    it->leaf = node;
+    it->idx = rank;
+    return 1;
+}
+
+/* Move 'it' to the next / previous element. Return 0 when there is none. */
+int zbtNext(zbtreeIter *it) {
+    if (++it->idx < it->leaf->count) return 1;
+    it->leaf = it->leaf->next;
+    it->idx = 0;
+    return it->leaf != NULL;
+}
+
+int zbtPrev(zbtreeIter *it) {
+    if (--it->idx >= 0) return 1;
+    it->leaf = it->leaf->prev;
+    if (it->leaf == NULL) return 0;
+    it->idx = it->leaf->count-1;
+    return 1;
+}
+
+/* Move 'it' by 'offset' elements towards the tail (or the head when
+ * 'reverse' is true) with two rank lookups, instead of walking the leaves.
+ * A negative offset skips every element, as in the skiplist code. */
+static int zbtSkip(zbtree *t, zbtreeIter *it, long offset, int reverse) {
+    unsigned long rank;
+
+    if (offset < 0) return 0;
+    if (offset == 0) return 1;
+    rank = zbtGetRank(t,zbtIterScore(it),zbtIterObj(it));
+    if (reverse) {
+        if ((unsigned long)offset >= rank) return 0;
+        return zbtGetElementByRank(t,rank-offset,it);
+    }
+    return zbtGetElementByRank(t,rank+offset,it);
+}
+
+/* Range predicates, so that the same lookup serves score and lex ranges.
+ * 'gtemin' goes from false to true along the tree and 'ltemax' from true
+ * to false. */
+typedef int zbtRangeFunc(double score, robj *obj, void *spec);
+
+static int zbtValueGteMin(double score, robj *obj, void *spec) {
+    REDIS_NOTUSED(obj);
+    return zslValueGteMin(score,spec);
+}
+
+static int zbtValueLteMax(double score, robj *obj, void *spec) {
+    REDIS_NOTUSED(obj);
+    return zslValueLteMax(score,spec);
+}
+
+static int zbtLexValueGteMin(double score, robj *obj, void *spec) {
+    REDIS_NOTUSED(score);
+    return zslLexValueGteMin(obj,spec);
+}
+
+static int zbtLexValueLteMax(double score, robj *obj, void *spec) {
+    REDIS_NOTUSED(score);
+    return zslLexValueLteMax(obj,spec);
+}
+
+/* Position 'it' at the first element for which 'gtemin' is true.
+ *
+ * Every inner node sends the lookup to the last child whose separator is
+ * still below the range: the elements of the children before it are below
+ * the range too, and the first element of the following leaf is known to
+ * be in it, as it is >= a separator that is not below the range. */
+static int zbtSeekMin(zbtree *t, zbtRangeFunc *gtemin, void *spec, zbtreeIter *it) {
+    void *node = t->root;
+    zbtreeLeaf *leaf;
+    int h, lo, hi;
+
+    for (h = t->height; h > 0; h--) {
+        zbtreeInner *n = node;
+
+        lo = 1, hi = n->count-1;
+        while (lo <= hi) {
+            int mid = (lo+hi)/2;
+
+            if (gtemin(n->score[mid],n->obj[mid],spec))
+                hi = mid-1;
+            else
+                lo = mid+1;
+        }
+        node = n->child[lo-1];
+    }
+
+    leaf = node;
+    lo = 0, hi = leaf->count;
+    while (lo < hi) {
+        int mid = (lo+hi)/2;
+
+        if (gtemin(leaf->score[mid],leaf->obj[mid],spec))
+            hi = mid;
+        else
+            lo = mid+1;
+    }
+    if (lo == leaf->count) {
+        leaf = leaf->next;
+        lo = 0;
+        if (leaf == NULL) return 0;
+    }
+    it->leaf = leaf;
+    it->idx = lo;
+    return 1;
+}
+
+/* Position 'it' at the last element for which 'ltemax' is true, the mirror
+ * of zbtSeekMin(). */
+static int zbtSeekMax(zbtree *t, zbtRangeFunc *ltemax, void *spec, zbtreeIter *it) {
+    void *node = t->root;
+    zbtreeLeaf *leaf;
+    int h, lo, hi;
+
+    for (h = t->height; h > 0; h--) {
+        zbtreeInner *n = node;
+
+        lo = 1, hi = n->count-1;
+        while (lo <= hi) {
+            int mid = (lo+hi)/2;
+
+            if (ltemax(n->score[mid],n->obj[mid],spec))
+                lo = mid+1;
+            else
+                hi = mid-1;
+        }
+        node = n->child[lo-1];
+    }
+
+    leaf = node;
+    lo = 0, hi = leaf->count;
+    while (lo < hi) {
+        int mid = (lo+hi)/2;
+
+        if (ltemax(leaf->score[mid],leaf->obj[mid],spec))
+            lo = mid+1;
+        else
+            hi = mid;
+    }
+    if (lo == 0) {
+        leaf = leaf->prev;
+        if (leaf == NULL) return 0;
+        lo = leaf->count;
+    }
+    it->leaf = leaf;
+    it->idx = lo-1;
+    return 1;
+}
+
+/*
+ *  it λһֵ range ָΧԪء
+ * ûзϷΧԪأ 0 
+ *
+ * Find the first element that is contained in the specified range.
+ * Returns 0 when no element is contained in the range.
+ *
+ * T = O(log N)
+ */
+int zbtFirstInRange(zbtree *t, zrangespec *range, zbtreeIter *it) {
+    if (!zbtSeekMin(t,zbtValueGteMin,range,it)) return 0;
+    return zslValueLteMax(zbtIterScore(it),range);
+}
+
+/* Find the last element that is contained in the specified range.
+ * Returns 0 when no element is contained in the range.
+ *
+ *  it λһֵ range ָΧԪء
+ *
+ * T = O(log N)
+ */
+int zbtLastInRange(zbtree *t, zrangespec *range, zbtreeIter *it) {
+    if (!zbtSeekMax(t,zbtValueLteMax,range,it)) return 0;
+    return zslValueGteMin(zbtIterScore(it),range);
+}
+
+/* Find the first element that is contained in the specified lex range.
+ * Returns 0 when no element is contained in the range. */
+int zbtFirstInLexRange(zbtree *t, zlexrangespec *range, zbtreeIter *it) {
+    if (!zbtSeekMin(t,zbtLexValueGteMin,range,it)) return 0;
+    return zslLexValueLteMax(zbtIterObj(it),range);
+}
+
+/* Find the last element that is contained in the specified lex range.
+ * Returns 0 when no element is contained in the range. */
+int zbtLastInLexRange(zbtree *t, zlexrangespec *range, zbtreeIter *it) {
+    if (!zbtSeekMax(t,zbtLexValueLteMax,range,it)) return 0;
+    return zslLexValueGteMin(zbtIterObj(it),range);
+}
+
+/* Remove the element at 'it' from the tree and from the dictionary view of
+ * the sorted set. The dictionary goes first, the tree reference keeps the
+ * member alive until the tree lookup is done. */
+static void zbtDeleteFromSet(zbtree *t, zbtreeIter *it, dict *dict) {
+    double score = zbtIterScore(it);
+    robj *obj = zbtIterObj(it);
+
+    dictDelete(dict,obj);
+    zbtDelete(t,score,obj);
+}
+
+/* Delete all the elements with score in range from the B+tree and from the
+ * dictionary. Every deletion is a separate O(log N) lookup, as merging
+ * nodes would invalidate an iterator.
+ *
+ * ɾзֵڸΧ֮ڵԪأͬʱֵɾ
+ *
+ * ֵΪɾԪص
+ *
+ * T = O(M log N)  M ΪɾԪص
+ */
+unsigned long zbtDeleteRangeByScore(zbtree *t, zrangespec *range, dict *dict) {
+    unsigned long removed = 0;
+    zbtreeIter it;
+
+    while (zbtFirstInRange(t,range,&it)) {
+        zbtDeleteFromSet(t,&it,dict);
+        removed++;
+    }
+    return removed;
+}
+
+unsigned long zbtDeleteRangeByLex(zbtree *t, zlexrangespec *range, dict *dict) {
+    unsigned long removed = 0;
+    zbtreeIter it;
+
+    while (zbtFirstInLexRange(t,range,&it)) {
+        zbtDeleteFromSet(t,&it,dict);
+        removed++;
+    }
+    return removed;
+}
+
+/* Delete all the elements with rank between start and end (1-based,
+ * inclusive) from the B+tree and from the dictionary. */
+unsigned long zbtDeleteRangeByRank(zbtree *t, unsigned int start, unsigned int end, dict *dict) {
+    unsigned long removed = 0;
+    zbtreeIter it;
+
+    while (start+removed <= end && zbtGetElementByRank(t,start,&it)) {
+        zbtDeleteFromSet(t,&it,dict);
+        removed++;
+    }
+    return removed;
+}
+
+/*-----------------------------------------------------------------------------
+ * Listpack-backed sorted set API
  *----------------------------------------------------------------------------*/
 
 /*
@@ -996,7 +1739,7 @@ double zzlGetScore(unsigned char *sptr) {
 
     redisAssert(sptr != NULL);
     // ȡڵֵ
-    redisAssert(ziplistGet(sptr,&vstr,&vlen,&vlong));
+    redisAssert(lpGet(sptr,&vstr,&vlen,&vlong));
 
     if (vstr) {
         // ַת double
@@ -1011,16 +1754,16 @@ double zzlGetScore(unsigned char *sptr) {
     return score;
 }
 
-/* Return a ziplist element as a Redis string object.
+/* Return a listpack element as a Redis string object.
  * This simple abstraction can be used to simplifies some code at the
  * cost of some performance. */
-robj *ziplistGetObject(unsigned char *sptr) {
+robj *lpGetObject(unsigned char *sptr) {
     unsigned char *vstr;
     unsigned int vlen;
     long long vlong;
 
     redisAssert(sptr != NULL);
-    redisAssert(ziplistGet(sptr,&vstr,&vlen,&vlong));
+    redisAssert(lpGet(sptr,&vstr,&vlen,&vlong));
 
     if (vstr) {
         return createStringObject((char*)vstr,vlen);
@@ -1045,7 +1788,7 @@ int zzlCompareElements(unsigned char *eptr, unsigned char *cstr, unsigned int cl
     int minlen, cmp;
 
     // ȡڵеֵַԼĳ
-    redisAssert(ziplistGet(eptr,&vstr,&vlen,&vlong));
+    redisAssert(lpGet(eptr,&vstr,&vlen,&vlong));
     if (vstr == NULL) {
         /* Store string representation of long long in buf. */
         vlen = ll2string((char*)vbuf,sizeof(vbuf),vlong);
@@ -1063,7 +1806,7 @@ int zzlCompareElements(unsigned char *eptr, unsigned char *cstr, unsigned int cl
  * ԾԪ
  */
 unsigned int zzlLength(unsigned char *zl) {
-    return ziplistLen(zl)/2;
+    return lpLength(zl)/2;
 }
 
 /* Move to next entry based on the values in eptr and sptr. Both are set to
@@ -1079,10 +1822,10 @@ void zzlNext(unsigned char *zl, unsigned char **eptr, unsigned char **sptr) {
     redisAssert(*eptr != NULL && *sptr != NULL);
 
     // ָ¸Ա
-    _eptr = ziplistNext(zl,*sptr);
+    _eptr = lpNext(zl,*sptr);
     if (_eptr != NULL) {
         // ָ¸ֵ
-        _sptr = ziplistNext(zl,_eptr);
+        _sptr = lpNext(zl,_eptr);
         redisAssert(_sptr != NULL);
     } else {
         /* No next entry. */
@@ -1106,9 +1849,9 @@ void zzlPrev(unsigned char *zl, unsigned char **eptr, unsigned char **sptr) {
     unsigned char *_eptr, *_sptr;
     redisAssert(*eptr != NULL && *sptr != NULL);
 
-    _sptr = ziplistPrev(zl,*eptr);
+    _sptr = lpPrev(zl,*eptr);
     if (_sptr != NULL) {
-        _eptr = ziplistPrev(zl,_sptr);
+        _eptr = lpPrev(zl,_sptr);
         redisAssert(_eptr != NULL);
     } else {
         /* No previous entry. */
@@ -1119,10 +1862,133 @@ void zzlPrev(unsigned char *zl, unsigned char **eptr, unsigned char **sptr) {
     *sptr = _sptr;
 }
 
+/* Listpack entries have a variable length, so the pairs of a listpack
+ * sorted set can't be binary searched in place. zzlSearch() first walks
+ * the listpack hopping over the entries without decoding them, and keeps
+ * a sparse index of at most ZZL_INDEX_SIZE member pointers, one every
+ * 'step' pairs. Then it binary searches the index, and scans linearly at
+ * most 'step' pairs after the last index entry that did not match.
+ *
+ * Decoding a score (strtod() for non integer scores) or a member for lex
+ * ranges costs much more than hopping over an entry, so a search decodes
+ * O(log(N)+N/ZZL_INDEX_SIZE) entries instead of O(N), and big values of
+ * zset-max-ziplist-entries stay cheap.
+ *
+ *  listpack Ľڵ㳤Ȳ̶򼯺ϵԪ޷ֱӽжֲҡ
+ *
+ * zzlSearch() ڵ㣨룩һ listpack 
+ * ÿ step Ԫؼ¼һԱָ룬 ZZL_INDEX_SIZE ϡ
+ * ȻϽжֲңԵؼ step Ԫء
+ *
+ * ֵֵҪ strtod()߳ԱĴ۱һڵö࣬
+ * ԲֻҪ O(log(N)+N/ZZL_INDEX_SIZE) ڵ㣬 O(N) 
+ */
+#define ZZL_INDEX_SIZE 128
+
+/* Listpacks with less pairs than this are just scanned from the head,
+ * since the search may stop early.
+ *
+ * Ԫֵ listpack ֱӴӱͷʼԲҡ */
+#define ZZL_LINEAR_SEARCH 16
+
+/* 'pred' must be false for a prefix of the pairs and true for the rest.
+ *
+ * pred 򼯺ϿͷһԪطؼ٣֮Ԫط档 */
+typedef int (*zzlPredicate)(unsigned char *eptr, unsigned char *sptr, void *arg);
+
+/* Return the member of the first pair for which 'pred' is true, or NULL if
+ * there is no such pair. When 'rank' is not NULL the 0-based rank of that
+ * pair (the number of pairs when NULL is returned) is stored in '*rank'.
+ *
+ * صһʹ pred ΪԪصĳԱָ룬ûԪʱ NULL 
+ *
+ * rank Ϊ NULL ʱԪ 0 Ϊʼֵλ浽 *rank У
+ *  NULL ʱ *rank ΪԪص
+ */
+static unsigned char *zzlSearch(unsigned char *zl, zzlPredicate pred, void *arg, unsigned long *rank) {
+    unsigned char *index[ZZL_INDEX_SIZE];
+    unsigned char *eptr, *sptr;
+    unsigned long len = zzlLength(zl), step, slots = 0, lo, hi, r = 0;
+
+    eptr = lpFirst(zl);
+    if (len >= ZZL_LINEAR_SEARCH) {
+        unsigned char *last = lpSeek(zl,-2);
+        unsigned long skip = 0;
+
+        /* Check the first and the last pair before building the index, so
+         * that searches ending at the head or at the tail, like appending
+         * elements with growing scores, stay O(1). */
+        // ȼһһԪأ
+        // ڱͷ߱βĲң簴ķֵԪأҪ
+        if (pred(eptr,lpNext(zl,eptr),arg)) {
+            if (rank) *rank = 0;
+            return eptr;
+        }
+        if (!pred(last,lpNext(zl,last),arg)) {
+            if (rank) *rank = len;
+            return NULL;
+        }
+
+        // ϡ
+        step = (len+ZZL_INDEX_SIZE-1)/ZZL_INDEX_SIZE;
+        while (eptr != NULL) {
+            sptr = lpNext(zl,eptr);
+            if (skip-- == 0) {
+                index[slots++] = eptr;
+                skip = step-1;
+            }
+            eptr = lpNext(zl,sptr);
+        }
+
+        // вҵһʹ pred Ϊ
+        lo = 0;
+        hi = slots;
+        while (lo < hi) {
+            unsigned long mid = lo+(hi-lo)/2;
+
+            if (pred(index[mid],lpNext(zl,index[mid]),arg))
+                hi = mid;
+            else
+                lo = mid+1;
+        }
+
+        /* The first pair was already checked, so lo > 0. */
+        redisAssert(lo > 0);
+
+        // һһԪؿʼԲ
+        eptr = index[lo-1];
+        r = (lo-1)*step;
+        sptr = lpNext(zl,eptr);
+        eptr = lpNext(zl,sptr);
+        r++;
+    }
+
+    while (eptr != NULL) {
+        sptr = lpNext(zl,eptr);
+        redisAssert(sptr != NULL);
+        if (pred(eptr,sptr,arg)) break;
+        eptr = lpNext(zl,sptr);
+        r++;
+    }
+
+    if (rank) *rank = r;
+    return eptr;
+}
+
+static int zzlScoreGteMin(unsigned char *eptr, unsigned char *sptr, void *arg) {
+    REDIS_NOTUSED(eptr);
+    return zslValueGteMin(zzlGetScore(sptr),arg);
+}
+
+static int zzlScoreGtMax(unsigned char *eptr, unsigned char *sptr, void *arg) {
+    REDIS_NOTUSED(eptr);
+    return !zslValueLteMax(zzlGetScore(sptr),arg);
+}
+
 /* Returns if there is a part of the zset is in range. Should only be used
  * internally by zzlFirstInRange and zzlLastInRange. 
  *
- *  ziplist һڵ range ָķΧ
+ *  listpack һڵ range ָķΧ
  * ô 1 򷵻 0 
  */
 int zzlIsInRange(unsigned char *zl, zrangespec *range) {
@@ -1134,21 +2000,21 @@ int zzlIsInRange(unsigned char *zl, zrangespec *range) {
             (range->min == range->max && (range->minex || range->maxex)))
         return 0;
 
-    // ȡ ziplist еֵ range ֵԱ
-    p = ziplistIndex(zl,-1); /* Last score. */
+    // ȡ listpack еֵ range ֵԱ
+    p = lpSeek(zl,-1); /* Last score. */
     if (p == NULL) return 0; /* Empty sorted set */
     score = zzlGetScore(p);
     if (!zslValueGteMin(score,range))
         return 0;
 
-    // ȡ ziplist еСֵ range СֵжԱ
-    p = ziplistIndex(zl,1); /* First score. */
+    // ȡ listpack еСֵ range СֵжԱ
+    p = lpSeek(zl,1); /* First score. */
     redisAssert(p != NULL);
     score = zzlGetScore(p);
     if (!zslValueLteMax(score,range))
         return 0;
 
-    // ziplist һڵϷΧ
+    // listpack һڵϷΧ
     return 1;
 }
 
@@ -1162,34 +2028,19 @@ int zzlIsInRange(unsigned char *zl, zrangespec *range) {
  * ûнڵ score ֵڸΧ NULL 
  */
 unsigned char *zzlFirstInRange(unsigned char *zl, zrangespec *range) {
-    // ӱͷʼ
-    unsigned char *eptr = ziplistIndex(zl,0), *sptr;
-    double score;
+    unsigned char *eptr;
 
     /* If everything is out of range, return early. */
     if (!zzlIsInRange(zl,range)) return NULL;
 
-    // ֵ ziplist ǴСе
-    // ӱͷβ
-    while (eptr != NULL) {
-        sptr = ziplistNext(zl,eptr);
-        redisAssert(sptr != NULL);
-
-        score = zzlGetScore(sptr);
-        if (zslValueGteMin(score,range)) {
-            /* Check if score <= max. */
-            // ϵһϷΧķֵ
-            // Ľڵָ
-            if (zslValueLteMax(score,range))
-                return eptr;
-            return NULL;
-        }
-
-        /* Move to next element. */
-        eptr = ziplistNext(zl,sptr);
-    }
+    // ֵ listpack ǴСе
+    // ҵһֵڵ min Ԫ
+    eptr = zzlSearch(zl,zzlScoreGteMin,range,NULL);
 
-    return NULL;
+    /* Check if score <= max. */
+    if (eptr == NULL || !zslValueLteMax(zzlGetScore(lpNext(zl,eptr)),range))
+        return NULL;
+    return eptr;
 }
 
 /* Find pointer to the last element contained in the specified range.
@@ -1201,53 +2052,51 @@ unsigned char *zzlFirstInRange(unsigned char *zl, zrangespec *range) {
  * ûԪذʱ NULL
  */
 unsigned char *zzlLastInRange(unsigned char *zl, zrangespec *range) {
-    // ӱβʼ
-    unsigned char *eptr = ziplistIndex(zl,-2), *sptr;
-    double score;
+    unsigned char *eptr, *sptr;
 
     /* If everything is out of range, return early. */
     if (!zzlIsInRange(zl,range)) return NULL;
 
-    //  ziplist ӱβͷ
-    while (eptr != NULL) {
-        sptr = ziplistNext(zl,eptr);
-        redisAssert(sptr != NULL);
-
-        // ȡڵ score ֵ
-        score = zzlGetScore(sptr);
-        if (zslValueLteMax(score,range)) {
-            /* Check if score >= min. */
-            if (zslValueGteMin(score,range))
-                return eptr;
-            return NULL;
-        }
-
+    // ҵһֵ max ԪأǰһԪؾǷΧڵһԪ
+    eptr = zzlSearch(zl,zzlScoreGtMax,range,NULL);
+    if (eptr == NULL) {
+        eptr = lpSeek(zl,-2);
+    } else {
         /* Move to previous element by moving to the score of previous element.
          * When this returns NULL, we know there also is no element. */
-        sptr = ziplistPrev(zl,eptr);
-        if (sptr != NULL)
-            redisAssert((eptr = ziplistPrev(zl,sptr)) != NULL);
-        else
-            eptr = NULL;
+        if ((sptr = lpPrev(zl,eptr)) == NULL) return NULL;
+        redisAssert((eptr = lpPrev(zl,sptr)) != NULL);
     }
 
-    return NULL;
+    /* Check if score >= min. */
+    if (!zslValueGteMin(zzlGetScore(lpNext(zl,eptr)),range)) return NULL;
+    return eptr;
 }
 
 static int zzlLexValueGteMin(unsigned char *p, zlexrangespec *spec) {
-    robj *value = ziplistGetObject(p);
+    robj *value = lpGetObject(p);
     int res = zslLexValueGteMin(value,spec);
     decrRefCount(value);
     return res;
 }
 
 static int zzlLexValueLteMax(unsigned char *p, zlexrangespec *spec) {
-    robj *value = ziplistGetObject(p);
+    robj *value = lpGetObject(p);
     int res = zslLexValueLteMax(value,spec);
     decrRefCount(value);
     return res;
 }
 
+static int zzlLexGteMin(unsigned char *eptr, unsigned char *sptr, void *arg) {
+    REDIS_NOTUSED(sptr);
+    return zzlLexValueGteMin(eptr,arg);
+}
+
+static int zzlLexGtMax(unsigned char *eptr, unsigned char *sptr, void *arg) {
+    REDIS_NOTUSED(sptr);
+    return !zzlLexValueLteMax(eptr,arg);
+}
+
 /* Returns if there is a part of the zset is in range. Should only be used
  * internally by zzlFirstInRange and zzlLastInRange. */
 int zzlIsInLexRange(unsigned char *zl, zlexrangespec *range) {
@@ -1259,12 +2108,12 @@ int zzlIsInLexRange(unsigned char *zl, zlexrangespec *range) {
             (range->minex || range->maxex)))
         return 0;
 
-    p = ziplistIndex(zl,-2); /* Last element. */
+    p = lpSeek(zl,-2); /* Last element. */
     if (p == NULL) return 0;
     if (!zzlLexValueGteMin(p,range))
         return 0;
 
-    p = ziplistIndex(zl,0); /* First element. */
+    p = lpFirst(zl); /* First element. */
     redisAssert(p != NULL);
     if (!zzlLexValueLteMax(p,range))
         return 0;
@@ -1275,79 +2124,87 @@ int zzlIsInLexRange(unsigned char *zl, zlexrangespec *range) {
 /* Find pointer to the first element contained in the specified lex range.
  * Returns NULL when no element is contained in the range. */
 unsigned char *zzlFirstInLexRange(unsigned char *zl, zlexrangespec *range) {
-    unsigned char *eptr = ziplistIndex(zl,0), *sptr;
+    unsigned char *eptr;
 
     /* If everything is out of range, return early. */
-    if (!zzlIsInLexRange(zl,range)) return NULL;
-
-    while (eptr != NULL) {
-        if (zzlLexValueGteMin(eptr,range)) {
-            /* Check if score <= max. */
-            if (zzlLexValueLteMax(eptr,range))
-                return eptr;
-            return NULL;
-        }
-
-        /* Move to next element. */
-        sptr = ziplistNext(zl,eptr); /* This element score. Skip it. */
-        redisAssert(sptr != NULL);
-        eptr = ziplistNext(zl,sptr); /* Next element. */
-    }
+    if (!zzlIsInLexRange(zl,range)) return NULL;
 
-    return NULL;
+    eptr = zzlSearch(zl,zzlLexGteMin,range,NULL);
+
+    /* Check if score <= max. */
+    if (eptr == NULL || !zzlLexValueLteMax(eptr,range)) return NULL;
+    return eptr;
 }
 
 /* Find pointer to the last element contained in the specified lex range.
  * Returns NULL when no element is contained in the range. */
 unsigned char *zzlLastInLexRange(unsigned char *zl, zlexrangespec *range) {
-    unsigned char *eptr = ziplistIndex(zl,-2), *sptr;
+    unsigned char *eptr, *sptr;
 
     /* If everything is out of range, return early. */
     if (!zzlIsInLexRange(zl,range)) return NULL;
 
-    while (eptr != NULL) {
-        if (zzlLexValueLteMax(eptr,range)) {
-            /* Check if score >= min. */
-            // ҵһϷΧֵ
-            // ָ
-            if (zzlLexValueGteMin(eptr,range))
-                return eptr;
-            return NULL;
-        }
-
-        /* Move to previous element by moving to the score of previous element.
-         * When this returns NULL, we know there also is no element. */
-        sptr = ziplistPrev(zl,eptr);
-        if (sptr != NULL)
-            redisAssert((eptr = ziplistPrev(zl,sptr)) != NULL);
-        else
-            eptr = NULL;
+    eptr = zzlSearch(zl,zzlLexGtMax,range,NULL);
+    if (eptr == NULL) {
+        eptr = lpSeek(zl,-2);
+    } else {
+        if ((sptr = lpPrev(zl,eptr)) == NULL) return NULL;
+        redisAssert((eptr = lpPrev(zl,sptr)) != NULL);
     }
 
-    return NULL;
+    /* Check if score >= min. */
+    // ҵһϷΧֵ
+    // ָ
+    if (!zzlLexValueGteMin(eptr,range)) return NULL;
+    return eptr;
+}
+
+/* Return the number of elements in the specified range, using the ranks of
+ * the first element in range and of the first element after the range.
+ *
+ * طֵڸΧڵԪ */
+unsigned long zzlCountInRange(unsigned char *zl, zrangespec *range) {
+    unsigned long first, last;
+
+    if (!zzlIsInRange(zl,range)) return 0;
+    zzlSearch(zl,zzlScoreGteMin,range,&first);
+    zzlSearch(zl,zzlScoreGtMax,range,&last);
+    return (last > first) ? last-first : 0;
+}
+
+/* Like zzlCountInRange() for lex ranges.
+ *
+ * سԱڸֵΧڵԪ */
+unsigned long zzlCountInLexRange(unsigned char *zl, zlexrangespec *range) {
+    unsigned long first, last;
+
+    if (!zzlIsInLexRange(zl,range)) return 0;
+    zzlSearch(zl,zzlLexGteMin,range,&first);
+    zzlSearch(zl,zzlLexGtMax,range,&last);
+    return (last > first) ? last-first : 0;
 }
 
 /*
- *  ziplist 򼯺в ele Աķֵ浽 score 
+ *  listpack 򼯺в ele Աķֵ浽 score 
  *
  * ѰҳɹָԱ ele ָ룬ʧܷ NULL 
  */
 unsigned char *zzlFind(unsigned char *zl, robj *ele, double *score) {
 
     // λ׸Ԫ
-    unsigned char *eptr = ziplistIndex(zl,0), *sptr;
+    unsigned char *eptr = lpFirst(zl), *sptr;
 
     // Ա
     ele = getDecodedObject(ele);
 
-    //  ziplist ԪأȷϳԱڣȡķֵ
+    //  listpack ԪأȷϳԱڣȡķֵ
     while (eptr != NULL) {
         // ֵָ
-        sptr = ziplistNext(zl,eptr);
+        sptr = lpNext(zl,eptr);
         redisAssertWithInfo(NULL,ele,sptr != NULL);
 
         // ȶԳԱ
-        if (ziplistCompare(eptr,ele->ptr,sdslen(ele->ptr))) {
+        if (lpCompare(eptr,ele->ptr,sdslen(ele->ptr))) {
             /* Matching element, pull out score. */
             // Աƥ䣬ȡֵ
             if (score != NULL) *score = zzlGetScore(sptr);
@@ -1356,7 +2213,7 @@ unsigned char *zzlFind(unsigned char *zl, robj *ele, double *score) {
         }
 
         /* Move to next element. */
-        eptr = ziplistNext(zl,sptr);
+        eptr = lpNext(zl,sptr);
     }
 
     decrRefCount(ele);
@@ -1365,25 +2222,25 @@ unsigned char *zzlFind(unsigned char *zl, robj *ele, double *score) {
     return NULL;
 }
 
-/* Delete (element,score) pair from ziplist. Use local copy of eptr because we
+/* Delete (element,score) pair from listpack. Use local copy of eptr because we
  * don't want to modify the one given as argument. 
  *
- *  ziplist ɾ eptr ָ򼯺ԪأԱͷֵ
+ *  listpack ɾ eptr ָ򼯺ԪأԱͷֵ
  */
 unsigned char *zzlDelete(unsigned char *zl, unsigned char *eptr) {
     unsigned char *p = eptr;
 
-    /* TODO: add function to ziplist API to delete N elements from offset. */
-    zl = ziplistDelete(zl,&p);
-    zl = ziplistDelete(zl,&p);
+    /* TODO: add function to listpack API to delete N elements from offset. */
+    zl = lpDelete(zl,&p);
+    zl = lpDelete(zl,&p);
     return zl;
 }
 
 /*
  * иԱͷֵ½ڵ뵽 eptr ָĽڵǰ棬
- *  eptr Ϊ NULL ô½ڵ뵽 ziplist ĩˡ
+ *  eptr Ϊ NULL ô½ڵ뵽 listpack ĩˡ
  *
- * ز֮ ziplist
+ * ز֮ listpack
  */
 unsigned char *zzlInsertAt(unsigned char *zl, unsigned char *eptr, robj *ele, double score) {
     unsigned char *sptr;
@@ -1399,118 +2256,94 @@ unsigned char *zzlInsertAt(unsigned char *zl, unsigned char *eptr, robj *ele, do
     if (eptr == NULL) {
         // | member-1 | score-1 | member-2 | score-2 | ... | member-N | score-N |
         // Ԫ
-        zl = ziplistPush(zl,ele->ptr,sdslen(ele->ptr),ZIPLIST_TAIL);
+        zl = lpPush(zl,ele->ptr,sdslen(ele->ptr),LISTPACK_TAIL);
         // ֵ
-        zl = ziplistPush(zl,(unsigned char*)scorebuf,scorelen,ZIPLIST_TAIL);
+        zl = lpPush(zl,(unsigned char*)scorebuf,scorelen,LISTPACK_TAIL);
 
     // 뵽ĳڵǰ
     } else {
         /* Keep offset relative to zl, as it might be re-allocated. */
         // Ա
         offset = eptr-zl;
-        zl = ziplistInsert(zl,eptr,ele->ptr,sdslen(ele->ptr));
+        zl = lpInsert(zl,eptr,ele->ptr,sdslen(ele->ptr));
         eptr = zl+offset;
 
         /* Insert score after the element. */
         // ֵڳԱ֮
-        redisAssertWithInfo(NULL,ele,(sptr = ziplistNext(zl,eptr)) != NULL);
-        zl = ziplistInsert(zl,sptr,(unsigned char*)scorebuf,scorelen);
+        redisAssertWithInfo(NULL,ele,(sptr = lpNext(zl,eptr)) != NULL);
+        zl = lpInsert(zl,sptr,(unsigned char*)scorebuf,scorelen);
     }
 
     return zl;
 }
 
-/* Insert (element,score) pair in ziplist. 
+/* Position of a new (element,score) pair, used by zzlInsert().
+ *
+ * ԪصĲλã zzlInsert() ʹá */
+typedef struct {
+    double score;
+    sds ele;
+} zzlInsertPos;
+
+static int zzlAfterInsertPos(unsigned char *eptr, unsigned char *sptr, void *arg) {
+    zzlInsertPos *pos = arg;
+    double s = zzlGetScore(sptr);
+
+    if (s != pos->score) return s > pos->score;
+    /* Ensure lexicographical ordering for elements. */
+    return zzlCompareElements(eptr,(unsigned char*)pos->ele,sdslen(pos->ele)) > 0;
+}
+
+/* Insert (element,score) pair in listpack. 
  *
- *  ele Աķֵ score ӵ ziplist 
+ *  ele Աķֵ score ӵ listpack 
  *
- * ziplist ĸڵ㰴 score ֵС
+ * listpack ĸڵ㰴 score ֵС
  *
  * This function assumes the element is not yet present in the list. 
  *
  *  elem 
  */
 unsigned char *zzlInsert(unsigned char *zl, robj *ele, double score) {
-
-    // ָ ziplist һڵ㣨Ҳ򼯵 member 
-    unsigned char *eptr = ziplistIndex(zl,0), *sptr;
-    double s;
+    zzlInsertPos pos;
+    unsigned char *eptr;
 
     // ֵ
     ele = getDecodedObject(ele);
 
-    //  ziplist
-    while (eptr != NULL) {
-
-        // ȡֵ
-        sptr = ziplistNext(zl,eptr);
-        redisAssertWithInfo(NULL,ele,sptr != NULL);
-        s = zzlGetScore(sptr);
-
-        if (s > score) {
-            /* First element with score larger than score for element to be
-             * inserted. This means we should take its spot in the list to
-             * maintain ordering. */
-            // һ score ֵ score Ľڵ
-            // ½ڵڵǰ棬
-            // ýڵ ziplist  score С
-            zl = zzlInsertAt(zl,eptr,ele,score);
-            break;
-        } else if (s == score) {
-            /* Ensure lexicographical ordering for elements. */
-            //  score ͽڵ score ͬ
-            // ô member ַλ½ڵĲλ
-            if (zzlCompareElements(eptr,ele->ptr,sdslen(ele->ptr)) > 0) {
-                zl = zzlInsertAt(zl,eptr,ele,score);
-                break;
-            }
-        }
-
-        /* Move to next element. */
-        //  score Ƚڵ score ֵҪ
-        // ƶһڵ
-        eptr = ziplistNext(zl,sptr);
-    }
-
-    /* Push on tail of list when it was not yet inserted. */
-    if (eptr == NULL)
-        zl = zzlInsertAt(zl,NULL,ele,score);
+    /* Find the first element with a score larger than score, or with the
+     * same score and a larger member, and take its spot in the list to
+     * maintain ordering. Push on tail of list when there is none. */
+    // ҵһ score ֵ score 
+    //  score ֵͬԱ ele Ľڵ㣬
+    // ½ڵڵǰ棬ûĽڵʱ뵽β
+    pos.score = score;
+    pos.ele = ele->ptr;
+    eptr = zzlSearch(zl,zzlAfterInsertPos,&pos,NULL);
+    zl = zzlInsertAt(zl,eptr,ele,score);
 
     decrRefCount(ele);
     return zl;
 }
 
 /*
- * ɾ ziplist зֵָΧڵԪ
+ * ɾ listpack зֵָΧڵԪ
  *
  * deleted Ϊ NULL ʱɾ֮󣬽ɾԪص浽 *deleted С
  */
 unsigned char *zzlDeleteRangeByScore(unsigned char *zl, zrangespec *range, unsigned long *deleted) {
-    unsigned char *eptr, *sptr;
-    double score;
-    unsigned long num = 0;
+    unsigned long first, last, num = 0;
 
     if (deleted != NULL) *deleted = 0;
 
-    // ָ ziplist еһϷΧĽڵ
-    eptr = zzlFirstInRange(zl,range);
-    if (eptr == NULL) return zl;
-
-    /* When the tail of the ziplist is deleted, eptr will point to the sentinel
-     * byte and ziplistNext will return NULL. */
-    // һֱɾڵ㣬ֱڷΧڵֵΪֹ
-    // ڵеֵ
-    while ((sptr = ziplistNext(zl,eptr)) != NULL) {
-        score = zzlGetScore(sptr);
-        if (zslValueLteMax(score,range)) {
-            /* Delete both the element and the score. */
-            zl = ziplistDelete(zl,&eptr);
-            zl = ziplistDelete(zl,&eptr);
-            num++;
-        } else {
-            /* No longer in range. */
-            break;
-        }
+    // ҵһϷΧԪأԼΧ֮ĵһԪصλ
+    // Ȼһɾ֮нڵ
+    if (!zzlIsInRange(zl,range)) return zl;
+    zzlSearch(zl,zzlScoreGteMin,range,&first);
+    zzlSearch(zl,zzlScoreGtMax,range,&last);
+    if (last > first) {
+        num = last-first;
+        zl = lpDeleteRange(zl,2*first,2*num);
     }
 
     if (deleted != NULL) *deleted = num;
@@ -1518,26 +2351,16 @@ unsigned char *zzlDeleteRangeByScore(unsigned char *zl, zrangespec *range, unsig
 }
 
 unsigned char *zzlDeleteRangeByLex(unsigned char *zl, zlexrangespec *range, unsigned long *deleted) {
-    unsigned char *eptr, *sptr;
-    unsigned long num = 0;
+    unsigned long first, last, num = 0;
 
     if (deleted != NULL) *deleted = 0;
 
-    eptr = zzlFirstInLexRange(zl,range);
-    if (eptr == NULL) return zl;
-
-    /* When the tail of the ziplist is deleted, eptr will point to the sentinel
-     * byte and ziplistNext will return NULL. */
-    while ((sptr = ziplistNext(zl,eptr)) != NULL) {
-        if (zzlLexValueLteMax(eptr,range)) {
-            /* Delete both the element and the score. */
-            zl = ziplistDelete(zl,&eptr);
-            zl = ziplistDelete(zl,&eptr);
-            num++;
-        } else {
-            /* No longer in range. */
-            break;
-        }
+    if (!zzlIsInLexRange(zl,range)) return zl;
+    zzlSearch(zl,zzlLexGteMin,range,&first);
+    zzlSearch(zl,zzlLexGtMax,range,&last);
+    if (last > first) {
+        num = last-first;
+        zl = lpDeleteRange(zl,2*first,2*num);
     }
 
     if (deleted != NULL) *deleted = num;
@@ -1547,7 +2370,7 @@ unsigned char *zzlDeleteRangeByLex(unsigned char *zl, zlexrangespec *range, unsi
 
 /* Delete all the elements with rank between start and end from the skiplist.
  *
- * ɾ ziplist ڸλΧڵԪء
+ * ɾ listpack ڸλΧڵԪء
  *
  * Start and end are inclusive. Note that start and end need to be 1-based 
  *
@@ -1561,9 +2384,9 @@ unsigned char *zzlDeleteRangeByRank(unsigned char *zl, unsigned int start, unsig
     if (deleted) *deleted = num;
 
     // ÿԪռڵ㣬ɾʵλҪ 2 
-    // Ϊ ziplist  0 Ϊʼֵ zzl ʼֵΪ 1 
+    // Ϊ listpack  0 Ϊʼֵ zzl ʼֵΪ 1 
     // Ҫ start - 1 
-    zl = ziplistDeleteRange(zl,2*(start-1),2*num);
+    zl = lpDeleteRange(zl,2*(start-1),2*num);
 
     return zl;
 }
@@ -1576,12 +2399,15 @@ unsigned int zsetLength(robj *zobj) {
 
     int length = -1;
 
-    if (zobj->encoding == REDIS_ENCODING_ZIPLIST) {
+    if (zobj->encoding == REDIS_ENCODING_LISTPACK) {
         length = zzlLength(zobj->ptr);
 
     } else if (zobj->encoding == REDIS_ENCODING_SKIPLIST) {
         length = ((zset*)zobj->ptr)->zsl->length;
 
+    } else if (zobj->encoding == REDIS_ENCODING_BTREE) {
+        length = ((zset*)zobj->ptr)->zbt->length;
+
     } else {
         redisPanic("Unknown sorted set encoding");
     }
@@ -1589,6 +2415,53 @@ unsigned int zsetLength(robj *zobj) {
     return length;
 }
 
+/* Encoding used for sorted sets that don't fit in a listpack.
+ *
+ * زʹ listpack 򼯺ʹõı롣
+ */
+int zsetLargeEncoding(void) {
+    return server.zset_btree ? REDIS_ENCODING_BTREE : REDIS_ENCODING_SKIPLIST;
+}
+
+/* Add / remove an element to / from the ordered index of a zset structure,
+ * the B+tree when there is one, the skiplist otherwise. Like zslInsert()
+ * the insertion takes over a reference of 'ele'.
+ *
+ *  zset ṹB+ ԾӻɾԪء
+ */
+static void zsetIndexInsert(zset *zs, double score, robj *ele) {
+    if (zs->zbt)
+        zbtInsert(zs->zbt,score,ele);
+    else
+        zslInsert(zs->zsl,score,ele);
+}
+
+static int zsetIndexDelete(zset *zs, double score, robj *ele) {
+    if (zs->zbt)
+        return zbtDelete(zs->zbt,score,ele);
+    else
+        return zslDelete(zs->zsl,score,ele);
+}
+
+/* Add a new member to a zset structure, both to the index and to the
+ * dictionary, that holds the score by value. The member gets a reference
+ * for each of them.
+ *
+ * һ³Աӵ zset ṹֵУֱֵӱֵ
+ * ԱüΡ
+ */
+void zsetInsert(zset *zs, double score, robj *ele) {
+    dictEntry *de;
+
+    zsetIndexInsert(zs,score,ele);
+    incrRefCount(ele); /* Added to the index. */
+
+    de = dictAddRaw(zs->dict,ele);
+    redisAssert(de != NULL);
+    dictSetDoubleVal(de,score);
+    incrRefCount(ele); /* Added to dictionary. */
+}
+
 /*
  * Ծ zobj ĵײתΪ encoding 
  */
@@ -1601,75 +2474,80 @@ void zsetConvert(robj *zobj, int encoding) {
     if (zobj->encoding == encoding) return;
 
     //  ZIPLIST תΪ SKIPLIST 
-    if (zobj->encoding == REDIS_ENCODING_ZIPLIST) {
+    if (zobj->encoding == REDIS_ENCODING_LISTPACK) {
         unsigned char *zl = zobj->ptr;
         unsigned char *eptr, *sptr;
         unsigned char *vstr;
         unsigned int vlen;
         long long vlong;
 
-        if (encoding != REDIS_ENCODING_SKIPLIST)
+        if (encoding != REDIS_ENCODING_SKIPLIST &&
+            encoding != REDIS_ENCODING_BTREE)
             redisPanic("Unknown target encoding");
 
         // 򼯺Ͻṹ
         zs = zmalloc(sizeof(*zs));
         // ֵ
         zs->dict = dictCreate(&zsetDictType,NULL);
-        // Ծ
-        zs->zsl = zslCreate();
+        // Ծ B+ 
+        if (encoding == REDIS_ENCODING_BTREE) {
+            zs->zsl = NULL;
+            zs->zbt = zbtCreate();
+        } else {
+            zs->zsl = zslCreate();
+            zs->zbt = NULL;
+        }
 
-        // 򼯺 ziplist еУ
+        // 򼯺 listpack еУ
         //
         // | member-1 | score-1 | member-2 | score-2 | ... |
         //
-        // ָ ziplist е׸ڵ㣨ԪسԱ
-        eptr = ziplistIndex(zl,0);
+        // ָ listpack е׸ڵ㣨ԪسԱ
+        eptr = lpFirst(zl);
         redisAssertWithInfo(NULL,zobj,eptr != NULL);
-        // ָ ziplist еĵڶڵ㣨Ԫطֵ
-        sptr = ziplistNext(zl,eptr);
+        // ָ listpack еĵڶڵ㣨Ԫطֵ
+        sptr = lpNext(zl,eptr);
         redisAssertWithInfo(NULL,zobj,sptr != NULL);
 
-        //  ziplist ڵ㣬ԪصĳԱͷֵӵ򼯺
+        //  listpack ڵ㣬ԪصĳԱͷֵӵ򼯺
         while (eptr != NULL) {
             
             // ȡֵ
             score = zzlGetScore(sptr);
 
             // ȡԱ
-            redisAssertWithInfo(NULL,zobj,ziplistGet(eptr,&vstr,&vlen,&vlong));
+            redisAssertWithInfo(NULL,zobj,lpGet(eptr,&vstr,&vlen,&vlong));
             if (vstr == NULL)
                 ele = createStringObjectFromLongLong(vlong);
             else
                 ele = createStringObject((char*)vstr,vlen);
 
-            /* Has incremented refcount since it was just created. */
-            // ԱͷֱֵԾֵ
-            node = zslInsert(zs->zsl,score,ele);
-            redisAssertWithInfo(NULL,zobj,dictAdd(zs->dict,ele,&node->score) == DICT_OK);
-            incrRefCount(ele); /* Added to dictionary. */
+            // Աͷֱֵֵ
+            zsetInsert(zs,score,ele);
+            decrRefCount(ele);
 
             // ƶָ룬ָ¸Ԫ
             zzlNext(zl,&eptr,&sptr);
         }
 
-        // ͷԭ ziplist
+        // ͷԭ listpack
         zfree(zobj->ptr);
 
         // ¶ֵԼ뷽ʽ
         zobj->ptr = zs;
-        zobj->encoding = REDIS_ENCODING_SKIPLIST;
+        zobj->encoding = encoding;
 
     //  SKIPLIST תΪ ZIPLIST 
     } else if (zobj->encoding == REDIS_ENCODING_SKIPLIST) {
 
-        // µ ziplist
-        unsigned char *zl = ziplistNew();
+        // µ listpack
+        unsigned char *zl = lpNew();
 
-        if (encoding != REDIS_ENCODING_ZIPLIST)
+        if (encoding != REDIS_ENCODING_LISTPACK)
             redisPanic("Unknown target encoding");
 
         /* Approach similar to zslFree(), since we want to free the skiplist at
-         * the same time as creating the ziplist. */
+         * the same time as creating the listpack. */
         // ָԾ
         zs = zobj->ptr;
 
@@ -1683,13 +2561,13 @@ void zsetConvert(robj *zobj, int encoding) {
         zfree(zs->zsl->header);
         zfree(zs->zsl);
 
-        // ԾȡԪأӵ ziplist
+        // ԾȡԪأӵ listpack
         while (node) {
 
             // ȡֵ
             ele = getDecodedObject(node->obj);
 
-            // Ԫص ziplist
+            // Ԫص listpack
             zl = zzlInsertAt(zl,NULL,ele,node->score);
             decrRefCount(ele);
 
@@ -1704,7 +2582,37 @@ void zsetConvert(robj *zobj, int encoding) {
 
         // ¶ֵԼı뷽ʽ
         zobj->ptr = zl;
-        zobj->encoding = REDIS_ENCODING_ZIPLIST;
+        zobj->encoding = REDIS_ENCODING_LISTPACK;
+
+    //  BTREE תΪ LISTPACK 
+    } else if (zobj->encoding == REDIS_ENCODING_BTREE) {
+
+        // µ listpack
+        unsigned char *zl = lpNew();
+        zbtreeLeaf *leaf;
+        int j;
+
+        if (encoding != REDIS_ENCODING_LISTPACK)
+            redisPanic("Unknown target encoding");
+
+        zs = zobj->ptr;
+
+        // ˳Ҷӽڵ㣬Ԫӵ listpack
+        for (leaf = zs->zbt->head; leaf; leaf = leaf->next) {
+            for (j = 0; j < leaf->count; j++) {
+                ele = getDecodedObject(leaf->obj[j]);
+                zl = zzlInsertAt(zl,NULL,ele,leaf->score[j]);
+                decrRefCount(ele);
+            }
+        }
+
+        // ͷֵ䡢 B+ 򼯺Ͻṹ
+        dictRelease(zs->dict);
+        zbtFree(zs->zbt);
+        zfree(zs);
+
+        zobj->ptr = zl;
+        zobj->encoding = REDIS_ENCODING_LISTPACK;
     } else {
         redisPanic("Unknown sorted set encoding");
     }
@@ -1753,7 +2661,7 @@ void zaddGenericCommand(redisClient *c, int incr) {
         {
             zobj = createZsetObject();
         } else {
-            zobj = createZsetZiplistObject();
+            zobj = createZsetListpackObject();
         }
         // ݿ
         dbAdd(c->db,key,zobj);
@@ -1769,11 +2677,11 @@ void zaddGenericCommand(redisClient *c, int incr) {
     for (j = 0; j < elements; j++) {
         score = scores[j];
 
-        // 򼯺Ϊ ziplist 
-        if (zobj->encoding == REDIS_ENCODING_ZIPLIST) {
+        // 򼯺Ϊ listpack 
+        if (zobj->encoding == REDIS_ENCODING_LISTPACK) {
             unsigned char *eptr;
 
-            /* Prefer non-encoded element when dealing with ziplists. */
+            /* Prefer non-encoded element when dealing with listpacks. */
             // ҳԱ
             ele = c->argv[3+j*2];
             if ((eptr = zzlFind(zobj->ptr,ele,&curscore)) != NULL) {
@@ -1810,21 +2718,21 @@ void zaddGenericCommand(redisClient *c, int incr) {
                 // 鿴Ԫص
                 // ǷҪ ZIPLIST תΪ򼯺
                 if (zzlLength(zobj->ptr) > server.zset_max_ziplist_entries)
-                    zsetConvert(zobj,REDIS_ENCODING_SKIPLIST);
+                    zsetConvert(zobj,zsetLargeEncoding());
 
                 // 鿴Ԫصĳ
                 // ǷҪ ZIPLIST תΪ򼯺
                 if (sdslen(ele->ptr) > server.zset_max_ziplist_value)
-                    zsetConvert(zobj,REDIS_ENCODING_SKIPLIST);
+                    zsetConvert(zobj,zsetLargeEncoding());
 
                 server.dirty++;
                 added++;
             }
 
-        // 򼯺Ϊ SKIPLIST 
-        } else if (zobj->encoding == REDIS_ENCODING_SKIPLIST) {
+        // 򼯺Ϊ SKIPLIST  BTREE 
+        } else if (zobj->encoding == REDIS_ENCODING_SKIPLIST ||
+                   zobj->encoding == REDIS_ENCODING_BTREE) {
             zset *zs = zobj->ptr;
-            zskiplistNode *znode;
             dictEntry *de;
 
             // 
@@ -1839,7 +2747,7 @@ void zaddGenericCommand(redisClient *c, int incr) {
                 // ȡԱ
                 curobj = dictGetKey(de);
                 // ȡֵ
-                curscore = *(double*)dictGetVal(de);
+                curscore = dictGetDoubleVal(de);
 
                 // ZINCRYBY ʱִ
                 if (incr) {
@@ -1853,33 +2761,28 @@ void zaddGenericCommand(redisClient *c, int incr) {
                 }
 
                 /* Remove and re-insert when score changed. We can safely
-                 * delete the key object from the skiplist, since the
+                 * delete the key object from the index, since the
                  * dictionary still has a reference to it. */
                 // ִ ZINCRYBY ʱ
                 // ûͨ ZADD ޸ĳԱķֵʱִ
                 if (score != curscore) {
                     // ɾԭԪ
-                    redisAssertWithInfo(c,curobj,zslDelete(zs->zsl,curscore,curobj));
+                    redisAssertWithInfo(c,curobj,zsetIndexDelete(zs,curscore,curobj));
 
                     // ²Ԫ
-                    znode = zslInsert(zs->zsl,score,curobj);
-                    incrRefCount(curobj); /* Re-inserted in skiplist. */
+                    zsetIndexInsert(zs,score,curobj);
+                    incrRefCount(curobj); /* Re-inserted in the index. */
 
-                    // ֵķֵָ
-                    dictGetVal(de) = &znode->score; /* Update score ptr. */
+                    // ֵеķֵ
+                    dictSetDoubleVal(de,score);
 
                     server.dirty++;
                     updated++;
                 }
             } else {
 
-                // ԪزڣֱӵԾ
-                znode = zslInsert(zs->zsl,score,ele);
-                incrRefCount(ele); /* Inserted in skiplist. */
-
-                // Ԫعֵ
-                redisAssertWithInfo(c,NULL,dictAdd(zs->dict,ele,&znode->score) == DICT_OK);
-                incrRefCount(ele); /* Added to dictionary. */
+                // Ԫزڣֱӵֵ
+                zsetInsert(zs,score,ele);
 
                 server.dirty++;
                 added++;
@@ -1920,20 +2823,20 @@ void zremCommand(redisClient *c) {
     if ((zobj = lookupKeyWriteOrReply(c,key,shared.czero)) == NULL ||
         checkType(c,zobj,REDIS_ZSET)) return;
 
-    //  ziplist ɾ
-    if (zobj->encoding == REDIS_ENCODING_ZIPLIST) {
+    //  listpack ɾ
+    if (zobj->encoding == REDIS_ENCODING_LISTPACK) {
         unsigned char *eptr;
 
         // Ԫ
         for (j = 2; j < c->argc; j++) {
-            // Ԫ ziplist дڵĻ
+            // Ԫ listpack дڵĻ
             if ((eptr = zzlFind(zobj->ptr,c->argv[j],NULL)) != NULL) {
                 // Ԫشʱɾһ
                 deleted++;
                 // ôɾ
                 zobj->ptr = zzlDelete(zobj->ptr,eptr);
                 
-                // ziplist գ򼯺ϴݿɾ
+                // listpack գ򼯺ϴݿɾ
                 if (zzlLength(zobj->ptr) == 0) {
                     dbDelete(c->db,key);
                     break;
@@ -1941,8 +2844,9 @@ void zremCommand(redisClient *c) {
             }
         }
 
-    // Ծֵɾ
-    } else if (zobj->encoding == REDIS_ENCODING_SKIPLIST) {
+    // Ծ B+ ֵɾ
+    } else if (zobj->encoding == REDIS_ENCODING_SKIPLIST ||
+               zobj->encoding == REDIS_ENCODING_BTREE) {
         zset *zs = zobj->ptr;
         dictEntry *de;
         double score;
@@ -1957,10 +2861,10 @@ void zremCommand(redisClient *c) {
                 // Ԫشʱɾһ
                 deleted++;
 
-                /* Delete from the skiplist */
-                // ԪشԾɾ
-                score = *(double*)dictGetVal(de);
-                redisAssertWithInfo(c,c->argv[j],zslDelete(zs->zsl,score,c->argv[j]));
+                /* Delete from the skiplist / B+tree */
+                // Ԫشɾ
+                score = dictGetDoubleVal(de);
+                redisAssertWithInfo(c,c->argv[j],zsetIndexDelete(zs,score,c->argv[j]));
 
                 /* Delete from the hash table */
                 // Ԫشֵɾ
@@ -2048,7 +2952,7 @@ void zremrangeGenericCommand(redisClient *c, int rangetype) {
     }
 
     /* Step 3: Perform the range deletion operation. */
-    if (zobj->encoding == REDIS_ENCODING_ZIPLIST) {
+    if (zobj->encoding == REDIS_ENCODING_LISTPACK) {
         switch(rangetype) {
         case ZRANGE_RANK:
             zobj->ptr = zzlDeleteRangeByRank(zobj->ptr,start+1,end+1,&deleted);
@@ -2081,6 +2985,28 @@ void zremrangeGenericCommand(redisClient *c, int rangetype) {
         }
         if (htNeedsResize(zs->dict)) dictResize(zs->dict);
 
+        // գݿɾ
+        if (dictSize(zs->dict) == 0) {
+            dbDelete(c->db,key);
+            keyremoved = 1;
+        }
+
+    //  B+ ֵɾ
+    } else if (zobj->encoding == REDIS_ENCODING_BTREE) {
+        zset *zs = zobj->ptr;
+        switch(rangetype) {
+        case ZRANGE_RANK:
+            deleted = zbtDeleteRangeByRank(zs->zbt,start+1,end+1,zs->dict);
+            break;
+        case ZRANGE_SCORE:
+            deleted = zbtDeleteRangeByScore(zs->zbt,&range,zs->dict);
+            break;
+        case ZRANGE_LEX:
+            deleted = zbtDeleteRangeByLex(zs->zbt,&lexrange,zs->dict);
+            break;
+        }
+        if (htNeedsResize(zs->dict)) dictResize(zs->dict);
+
         // գݿɾ
         if (dictSize(zs->dict) == 0) {
             dbDelete(c->db,key);
@@ -2162,9 +3088,9 @@ typedef struct {
         /* Sorted set iterators. */
         // 򼯺ϵ
         union _iterzset {
-            // ziplist 
+            // listpack 
             struct {
-                //  ziplist
+                //  listpack
                 unsigned char *zl;
                 // ǰԱָ͵ǰֵָ
                 unsigned char *eptr, *sptr;
@@ -2176,6 +3102,13 @@ typedef struct {
                 // ǰԾڵ
                 zskiplistNode *node;
             } sl;
+            // B+ 
+            struct {
+                //  zset
+                zset *zs;
+                // ǰԪصλãʱ it.leaf Ϊ NULL
+                zbtreeIter it;
+            } bt;
         } zset;
     } iter;
 } zsetopsrc;
@@ -2264,12 +3197,12 @@ void zuiInitIterator(zsetopsrc *op) {
 
         iterzset *it = &op->iter.zset;
 
-        //  ziplist
-        if (op->encoding == REDIS_ENCODING_ZIPLIST) {
+        //  listpack
+        if (op->encoding == REDIS_ENCODING_LISTPACK) {
             it->zl.zl = op->subject->ptr;
-            it->zl.eptr = ziplistIndex(it->zl.zl,0);
+            it->zl.eptr = lpFirst(it->zl.zl);
             if (it->zl.eptr != NULL) {
-                it->zl.sptr = ziplistNext(it->zl.zl,it->zl.eptr);
+                it->zl.sptr = lpNext(it->zl.zl,it->zl.eptr);
                 redisAssert(it->zl.sptr != NULL);
             }
 
@@ -2278,6 +3211,12 @@ void zuiInitIterator(zsetopsrc *op) {
             it->sl.zs = op->subject->ptr;
             it->sl.node = it->sl.zs->zsl->header->level[0].forward;
 
+        //  B+ 
+        } else if (op->encoding == REDIS_ENCODING_BTREE) {
+            it->bt.zs = op->subject->ptr;
+            it->bt.it.leaf = it->bt.zs->zbt->length ? it->bt.zs->zbt->head : NULL;
+            it->bt.it.idx = 0;
+
         } else {
             redisPanic("Unknown sorted set encoding");
         }
@@ -2314,10 +3253,11 @@ void zuiClearIterator(zsetopsrc *op) {
 
         iterzset *it = &op->iter.zset;
 
-        if (op->encoding == REDIS_ENCODING_ZIPLIST) {
+        if (op->encoding == REDIS_ENCODING_LISTPACK) {
             REDIS_NOTUSED(it); /* skip */
 
-        } else if (op->encoding == REDIS_ENCODING_SKIPLIST) {
+        } else if (op->encoding == REDIS_ENCODING_SKIPLIST ||
+                   op->encoding == REDIS_ENCODING_BTREE) {
             REDIS_NOTUSED(it); /* skip */
 
         } else {
@@ -2348,11 +3288,14 @@ int zuiLength(zsetopsrc *op) {
 
     } else if (op->type == REDIS_ZSET) {
 
-        if (op->encoding == REDIS_ENCODING_ZIPLIST) {
+        if (op->encoding == REDIS_ENCODING_LISTPACK) {
             return zzlLength(op->subject->ptr);
         } else if (op->encoding == REDIS_ENCODING_SKIPLIST) {
             zset *zs = op->subject->ptr;
             return zs->zsl->length;
+        } else if (op->encoding == REDIS_ENCODING_BTREE) {
+            zset *zs = op->subject->ptr;
+            return zs->zbt->length;
         } else {
             redisPanic("Unknown sorted set encoding");
         }
@@ -2390,7 +3333,7 @@ int zuiNext(zsetopsrc *op, zsetopval *val) {
 
         iterset *it = &op->iter.set;
 
-        // ziplist ļ
+        // listpack ļ
         if (op->encoding == REDIS_ENCODING_INTSET) {
             int64_t ell;
 
@@ -2427,8 +3370,8 @@ int zuiNext(zsetopsrc *op, zsetopval *val) {
 
         iterzset *it = &op->iter.zset;
 
-        // ziplist 򼯺
-        if (op->encoding == REDIS_ENCODING_ZIPLIST) {
+        // listpack 򼯺
+        if (op->encoding == REDIS_ENCODING_LISTPACK) {
 
             /* No need to check both, but better be explicit. */
             // Ϊգ
@@ -2436,7 +3379,7 @@ int zuiNext(zsetopsrc *op, zsetopval *val) {
                 return 0;
 
             // ȡԱ
-            redisAssert(ziplistGet(it->zl.eptr,&val->estr,&val->elen,&val->ell));
+            redisAssert(lpGet(it->zl.eptr,&val->estr,&val->elen,&val->ell));
             // ȡֵ
             val->score = zzlGetScore(it->zl.sptr);
 
@@ -2454,6 +3397,18 @@ int zuiNext(zsetopsrc *op, zsetopval *val) {
 
             /* Move to next element. */
             it->sl.node = it->sl.node->level[0].forward;
+
+        // BTREE 򼯺
+        } else if (op->encoding == REDIS_ENCODING_BTREE) {
+
+            if (it->bt.it.leaf == NULL)
+                return 0;
+
+            val->ele = zbtIterObj(&it->bt.it);
+            val->score = zbtIterScore(&it->bt.it);
+
+            /* Move to next element. */
+            zbtNext(&it->bt.it);
         } else {
             redisPanic("Unknown sorted set encoding");
         }
@@ -2489,7 +3444,7 @@ int zuiLongLongFromValue(zsetopval *val) {
                 redisPanic("Unsupported element encoding");
             }
 
-        //  ziplist ڵȡֵ
+        //  listpack ڵȡֵ
         } else if (val->estr != NULL) {
             // ڵֵһַתΪ
             if (string2ll((char*)val->estr,val->elen,&val->ell))
@@ -2592,81 +3547,555 @@ int zuiFind(zsetopsrc *op, zsetopval *val, double *score) {
             redisPanic("Unknown set encoding");
         }
 
-    // 򼯺
-    } else if (op->type == REDIS_ZSET) {
-        // ȡ
-        zuiObjectFromValue(val);
+    // 򼯺
+    } else if (op->type == REDIS_ZSET) {
+        // ȡ
+        zuiObjectFromValue(val);
+
+        // listpack
+        if (op->encoding == REDIS_ENCODING_LISTPACK) {
+
+            // ȡԱͷֵ
+            if (zzlFind(op->subject->ptr,val->ele,score) != NULL) {
+                /* Score is already set by zzlFind. */
+                return 1;
+            } else {
+                return 0;
+            }
+
+        // SKIPLIST  BTREE 
+        } else if (op->encoding == REDIS_ENCODING_SKIPLIST ||
+                   op->encoding == REDIS_ENCODING_BTREE) {
+            zset *zs = op->subject->ptr;
+            dictEntry *de;
+
+            // ֵвҳԱ
+            if ((de = dictFind(zs->dict,val->ele)) != NULL) {
+                // ȡֵ
+                *score = dictGetDoubleVal(de);
+                return 1;
+            } else {
+                return 0;
+            }
+        } else {
+            redisPanic("Unknown sorted set encoding");
+        }
+    } else {
+        redisPanic("Unsupported type");
+    }
+}
+
+/*
+ * ԱĻ
+ */
+int zuiCompareByCardinality(const void *s1, const void *s2) {
+    return zuiLength((zsetopsrc*)s1) - zuiLength((zsetopsrc*)s2);
+}
+
+#define REDIS_AGGR_SUM 1
+#define REDIS_AGGR_MIN 2
+#define REDIS_AGGR_MAX 3
+#define zunionInterDictValue(_e) (dictGetVal(_e) == NULL ? 1.0 : *(double*)dictGetVal(_e))
+
+/*
+ *  aggregate ֵζ *target  val оۺϼ㡣
+ */
+inline static void zunionInterAggregate(double *target, double val, int aggregate) {
+
+    // 
+    if (aggregate == REDIS_AGGR_SUM) {
+        *target = *target + val;
+        /* The result of adding two doubles is NaN when one variable
+         * is +inf and the other is -inf. When these numbers are added,
+         * we maintain the convention of the result being 0.0. */
+        // Ƿ
+        if (isnan(*target)) *target = 0.0;
+
+    // С
+    } else if (aggregate == REDIS_AGGR_MIN) {
+        *target = val < *target ? val : *target;
+
+    // ߴ
+    } else if (aggregate == REDIS_AGGR_MAX) {
+        *target = val > *target ? val : *target;
+
+    } else {
+        /* safety net */
+        redisPanic("Unknown ZUNION/INTER aggregate type");
+    }
+}
+
+/* State of a ZUNIONSTORE / ZINTERSTORE computation.
+ *
+ * Big aggregations are not computed in a single call: the command blocks
+ * the client and the result is built in time slices of
+ * REDIS_ZSET_AGGR_SLICE_DURATION microseconds from a time event, so the
+ * server keeps serving the other clients. The destination key is replaced
+ * only when the result is complete, and the command is propagated at that
+ * time, so for the rest of the world it is executed when it completes.
+ *
+ * The input objects are iterated in place, so they must not change while
+ * the job is pending: every write command touching an input or the
+ * destination key, and every deletion of an input, completes the job
+ * synchronously first (see zsetAggrFinishJobs()).
+ *
+ * ZUNIONSTORE / ZINTERSTORE ļ״̬
+ *
+ * ľۺϼ㲻һεɣ
+ * ͻˣȻʱ¼ REDIS_ZSET_AGGR_SLICE_DURATION ΢ΪһƬ
+ * ֶιϣڴڼͻˡ
+ * ֮滻ĿҲʱű
+ * Զ˵ɵһִеġ
+ *
+ * Ǳԭصģڼ֮ǰǲܱ޸ģ
+ * κ漰ĿдԼκζɾ
+ * ͬɼ㣨 zsetAggrFinishJobs()
+ */
+typedef struct zsetAggrJob {
+
+    // ȴظĿͻˣͻѾϿʱΪ NULL
+    redisClient *client;
+
+    // ݿ
+    redisDb *db;
+
+    // Ͳĸʱ
+    struct redisCommand *cmd;
+    robj **argv;
+    int argc;
+
+    // Ŀ
+    robj *dstkey;
+
+    // REDIS_OP_UNION  REDIS_OP_INTER
+    int op;
+
+    // ۺϷʽ
+    int aggregate;
+
+    // 뼯
+    zsetopsrc *src;
+    long setnum;
+
+    // ڵ뼯ϣԼĵǷѾʼ
+    long cur;
+    int iterating;
+
+    // ȡĵǰֵ
+    zsetopval zval;
+
+    // 
+    robj *dstobj;
+
+    // гԱ󳤶
+    unsigned int maxelelen;
+
+} zsetAggrJob;
+
+/* Add the current element of the smallest input to the result if it is
+ * present in every input.
+ *
+ * СļϵĵǰԪ뼯жڣô뵽С */
+static void zinterAddElement(zsetAggrJob *job) {
+    zsetopsrc *src = job->src;
+    zsetopval *zval = &job->zval;
+    zset *dstzset = job->dstobj->ptr;
+    double score, value;
+    robj *tmp;
+    long j;
+
+    // Ȩֵ
+    score = src[0].weight * zval->score;
+    if (isnan(score)) score = 0;
+
+    //  src[0] еԪغеԪȨۺϼ
+    for (j = 1; j < job->setnum; j++) {
+        /* It is not safe to access the zset we are
+         * iterating, so explicitly check for equal object. */
+        // ǰ src[j] Ķ src[0] Ķһ
+        // ô src[0] ֵԪرȻҲ src[j]
+        // ôǿֱӼۺֵ
+        // ؽ zuiFind ȥȷԪǷ
+        // ĳ key Σ
+        //  key 뼯лСļʱ
+        if (src[j].subject == src[0].subject) {
+            value = zval->score*src[j].weight;
+            zunionInterAggregate(&score,value,job->aggregate);
+
+        // ҵǰԪصĻ
+        // ôоۺϼ
+        } else if (zuiFind(&src[j],zval,&value)) {
+            value *= src[j].weight;
+            zunionInterAggregate(&score,value,job->aggregate);
+
+        // ǰԪûĳϣôԪ
+        } else {
+            return;
+        }
+    }
+
+    /* Only continue when present in every input. */
+    // ֻڽԪسʱִ´
+    // ȡֵ
+    tmp = zuiObjectFromValue(zval);
+    // 뵽򼯺
+    zsetInsert(dstzset,score,tmp);
+
+    // ַ󳤶
+    if (sdsEncodedObject(tmp)) {
+        if (sdslen(tmp->ptr) > job->maxelelen)
+            job->maxelelen = sdslen(tmp->ptr);
+    }
+}
+
+/* Add the current element of input 'i' to the result, aggregating the
+ * scores it has in the inputs after 'i', unless it was already added.
+ *
+ * 뼯 i ĵǰԪؼ뵽У
+ * ֵ i ֮뼯еķֵۺ϶
+ * ѾԪػᱻ */
+static void zunionAddElement(zsetAggrJob *job, long i) {
+    zsetopsrc *src = job->src;
+    zsetopval *zval = &job->zval;
+    zset *dstzset = job->dstobj->ptr;
+    double score, value;
+    robj *tmp;
+    long j;
+
+    /* Skip an element that when already processed */
+    // ѴԪ
+    if (dictFind(dstzset->dict,zuiObjectFromValue(zval)) != NULL)
+        return;
+
+    /* Initialize score */
+    // ʼֵ
+    score = src[i].weight * zval->score;
+    // ʱΪ 0
+    if (isnan(score)) score = 0;
+
+    /* We need to check only next sets to see if this element
+     * exists, since we process every element just one time so
+     * it can't exist in a previous set (otherwise it would be
+     * already processed). */
+    for (j = (i+1); j < job->setnum; j++) {
+        /* It is not safe to access the zset we are
+         * iterating, so explicitly check for equal object. */
+        // ǰԪصļϺͱһ
+        // ͬһԪرȻ src[j]  src[i]
+        // ֱӼǵľۺֵ
+        // ʹ zuiFind ԪǷ
+        if(src[j].subject == src[i].subject) {
+            value = zval->score*src[j].weight;
+            zunionInterAggregate(&score,value,job->aggregate);
+
+        // ԱǷ
+        } else if (zuiFind(&src[j],zval,&value)) {
+            value *= src[j].weight;
+            zunionInterAggregate(&score,value,job->aggregate);
+        }
+    }
+
+    // ȡԱ
+    tmp = zuiObjectFromValue(zval);
+    // 벢Ԫص򼯺
+    zsetInsert(dstzset,score,tmp);
+
+    // ַ󳤶
+    if (sdsEncodedObject(tmp)) {
+        if (sdslen(tmp->ptr) > job->maxelelen)
+            job->maxelelen = sdslen(tmp->ptr);
+    }
+}
+
+/* Build the result for about 'us' microseconds, or until it is complete if
+ * 'us' is zero. Returns 1 when the result is complete, 0 otherwise.
+ *
+ * ϣִ us ΢룬us Ϊ 0 ʱһֱִеΪֹ
+ *
+ * ʱ 1 򷵻 0  */
+static int zunionInterProcess(zsetAggrJob *job, long long us) {
+    long long start = us ? ustime() : 0;
+    unsigned long count = 0;
+
+    while (job->cur < job->setnum) {
+        zsetopsrc *op = &job->src[job->cur];
+
+        if (!job->iterating) {
+            /* Skip empty inputs. Only the smallest input is iterated by
+             * ZINTERSTORE, and everything is skipped if it is empty: as the
+             * inputs are ordered by size, all the others are non-empty. */
+            // ZINTERSTORE ֻС src[0] ϣΪʱʲôҲ
+            // ZUNIONSTORE 뼯ϣռ
+            if (zuiLength(op) == 0 ||
+                (job->op == REDIS_OP_INTER && job->cur > 0))
+            {
+                job->cur = (job->op == REDIS_OP_INTER) ? job->setnum : job->cur+1;
+                continue;
+            }
+            zuiInitIterator(op);
+            job->iterating = 1;
+        }
+
+        // ǰ뼯Ѿ
+        if (!zuiNext(op,&job->zval)) {
+            zuiClearIterator(op);
+            job->iterating = 0;
+            job->cur++;
+            continue;
+        }
+
+        if (job->op == REDIS_OP_INTER)
+            zinterAddElement(job);
+        else if (job->op == REDIS_OP_UNION)
+            zunionAddElement(job,job->cur);
+        else
+            redisPanic("Unknown operator");
+
+        // ÿһԪؼһʱ
+        if (us && (++count & 255) == 0 && ustime()-start >= us) return 0;
+    }
+
+    return 1;
+}
+
+/* Replace the destination key with the complete result, and reply to the
+ * client if it is still connected.
+ *
+ * üɵĽ滻ĿͻȻӣôػظ */
+static void zunionInterStore(zsetAggrJob *job) {
+    redisClient *c = job->client;
+    redisDb *db = job->db;
+    robj *dstkey = job->dstkey;
+    robj *dstobj = job->dstobj;
+    zset *dstzset = dstobj->ptr;
+    int touched = 0;
+
+    // Ȩݿ⣨߱ͷţ
+    job->dstobj = NULL;
+
+    // ɾѴڵ dstkey ȴ¶
+    if (dbDelete(db,dstkey)) {
+        signalModifiedKey(db,dstkey);
+        touched = 1;
+        server.dirty++;
+    }
+
+    // ϵĳȲΪ 0 
+    if (dictSize(dstzset->dict)) {
+        /* Convert to listpack when in limits. */
+        // ǷҪԽϽбת
+        if (dictSize(dstzset->dict) <= server.zset_max_ziplist_entries &&
+            job->maxelelen <= server.zset_max_ziplist_value)
+                zsetConvert(dstobj,REDIS_ENCODING_LISTPACK);
 
-        // ziplist
-        if (op->encoding == REDIS_ENCODING_ZIPLIST) {
+        // Ϲݿ
+        dbAdd(db,dstkey,dstobj);
 
-            // ȡԱͷֵ
-            if (zzlFind(op->subject->ptr,val->ele,score) != NULL) {
-                /* Score is already set by zzlFind. */
-                return 1;
-            } else {
-                return 0;
-            }
+        // ظϵĳ
+        if (c) addReplyLongLong(c,zsetLength(dstobj));
 
-        // SKIPLIST 
-        } else if (op->encoding == REDIS_ENCODING_SKIPLIST) {
-            zset *zs = op->subject->ptr;
-            dictEntry *de;
+        if (!touched) signalModifiedKey(db,dstkey);
 
-            // ֵвҳԱ
-            if ((de = dictFind(zs->dict,val->ele)) != NULL) {
-                // ȡֵ
-                *score = *(double*)dictGetVal(de);
-                return 1;
-            } else {
-                return 0;
-            }
-        } else {
-            redisPanic("Unknown sorted set encoding");
-        }
+        notifyKeyspaceEvent(REDIS_NOTIFY_ZSET,
+            (job->op == REDIS_OP_UNION) ? "zunionstore" : "zinterstore",
+            dstkey,db->id);
+
+        server.dirty++;
+
+    // Ϊ
     } else {
-        redisPanic("Unsupported type");
+
+        decrRefCount(dstobj);
+
+        if (c) addReply(c,shared.czero);
+
+        if (touched)
+            notifyKeyspaceEvent(REDIS_NOTIFY_GENERIC,"del",dstkey,db->id);
     }
 }
 
 /*
- * ԱĻ
+ * ͷż״̬
  */
-int zuiCompareByCardinality(const void *s1, const void *s2) {
-    return zuiLength((zsetopsrc*)s1) - zuiLength((zsetopsrc*)s2);
+static void zsetAggrFreeJob(zsetAggrJob *job) {
+    long j;
+
+    if (job->iterating) zuiClearIterator(&job->src[job->cur]);
+    if (job->zval.flags & OPVAL_DIRTY_ROBJ) decrRefCount(job->zval.ele);
+    if (job->dstobj) decrRefCount(job->dstobj);
+
+    // 첽ִеļ
+    if (job->argv) {
+        for (j = 0; j < job->setnum; j++)
+            if (job->src[j].subject) decrRefCount(job->src[j].subject);
+        for (j = 0; j < job->argc; j++)
+            decrRefCount(job->argv[j]);
+        zfree(job->argv);
+    }
+    zfree(job->src);
+    zfree(job);
 }
 
-#define REDIS_AGGR_SUM 1
-#define REDIS_AGGR_MIN 2
-#define REDIS_AGGR_MAX 3
-#define zunionInterDictValue(_e) (dictGetVal(_e) == NULL ? 1.0 : *(double*)dictGetVal(_e))
+/* Complete a pending job, that was already removed from the list of
+ * pending jobs, store the result, propagate the command and unblock the
+ * client.
+ *
+ * һѾӵȴƳ첽㣺
+ * ͻ˵ */
+static void zsetAggrCompleteJob(zsetAggrJob *job) {
+    long long dirty = server.dirty;
+
+    zunionInterProcess(job,0);
+    zunionInterStore(job);
+
+    // ʱűݿӰʱһ
+    if (server.dirty != dirty)
+        propagate(job->cmd,job->db->id,job->argv,job->argc,
+                  REDIS_PROPAGATE_AOF|REDIS_PROPAGATE_REPL);
+
+    if (job->client) unblockClient(job->client);
+    server.stat_zset_aggr_async++;
+    zsetAggrFreeJob(job);
+}
 
-/*
- *  aggregate ֵζ *target  val оۺϼ㡣
- */
-inline static void zunionInterAggregate(double *target, double val, int aggregate) {
+/* Time event handler: work on the oldest pending job for a time slice,
+ * and on every call until no job is left.
+ *
+ * ʱ¼ÿεö첽ִһʱƬ
+ * ֱûеȴеļΪֹ */
+static int zsetAggrCron(struct aeEventLoop *eventLoop, long long id, void *clientData) {
+    REDIS_NOTUSED(eventLoop);
+    REDIS_NOTUSED(id);
+    REDIS_NOTUSED(clientData);
+
+    if (listLength(server.zset_aggr_jobs)) {
+        listNode *ln = listFirst(server.zset_aggr_jobs);
+        zsetAggrJob *job = ln->value;
+
+        if (zunionInterProcess(job,REDIS_ZSET_AGGR_SLICE_DURATION)) {
+            listDelNode(server.zset_aggr_jobs,ln);
+            zsetAggrCompleteJob(job);
+        }
+    }
 
-    // 
-    if (aggregate == REDIS_AGGR_SUM) {
-        *target = *target + val;
-        /* The result of adding two doubles is NaN when one variable
-         * is +inf and the other is -inf. When these numbers are added,
-         * we maintain the convention of the result being 0.0. */
-        // Ƿ
-        if (isnan(*target)) *target = 0.0;
+    if (listLength(server.zset_aggr_jobs) == 0) {
+        server.zset_aggr_timer = -1;
+        return AE_NOMORE;
+    }
 
-    // С
-    } else if (aggregate == REDIS_AGGR_MIN) {
-        *target = val < *target ? val : *target;
+    /* Run again as soon as the pending file events are served. */
+    // ڴѾļ¼֮ٴִ
+    return 0;
+}
 
-    // ߴ
-    } else if (aggregate == REDIS_AGGR_MAX) {
-        *target = val > *target ? val : *target;
+/* Return true if 'key' in 'db' is an input of 'job', or its destination
+ * when 'inputsonly' is false.
+ *
+ *  key ǷΪ job inputsonly ΪʱҲĿ */
+static int zsetAggrJobUsesKey(zsetAggrJob *job, redisDb *db, robj *key, int inputsonly) {
+    long j, numkeys;
+
+    if (job->db != db) return 0;
+    if (!inputsonly && equalStringObjects(job->dstkey,key)) return 1;
+
+    // ʽΪ dstkey numkeys key [key ...]
+    numkeys = job->setnum;
+    for (j = 0; j < numkeys; j++)
+        if (equalStringObjects(job->argv[3+j],key)) return 1;
+    return 0;
+}
+
+/* Synchronously complete the pending jobs using 'key' in 'db', as input or
+ * (if 'inputsonly' is false) as destination. When 'db' is NULL all the
+ * pending jobs are completed.
+ *
+ * ͬʹ db  key 첽㣬
+ * key inputsonly ΪʱҲĿ
+ *
+ * db Ϊ NULL ʱ첽㡣 */
+void zsetAggrFinishJobs(redisDb *db, robj *key, int inputsonly) {
+    listIter li;
+    listNode *ln;
+
+    if (listLength(server.zset_aggr_jobs) == 0) return;
+
+    /* Completing a job deletes its destination key, which may complete
+     * other jobs, so the list is walked again from the head every time. */
+    // һʱɾĿܻ㣬
+    // ÿһ㶼ӱͷ¿ʼ
+again:
+    listRewind(server.zset_aggr_jobs,&li);
+    while ((ln = listNext(&li)) != NULL) {
+        zsetAggrJob *job = ln->value;
+
+        if (db == NULL || zsetAggrJobUsesKey(job,db,key,inputsonly)) {
+            listDelNode(server.zset_aggr_jobs,ln);
+            zsetAggrCompleteJob(job);
+            goto again;
+        }
+    }
+}
 
+/* Called before a write command is executed: complete the pending jobs
+ * using any of its keys. Write commands without keys, like FLUSHDB,
+ * complete all of them.
+ *
+ * ִд֮ǰãʹøļ첽㡣
+ * ûмд FLUSHDB첽㡣 */
+void zsetAggrFinishJobsForCommand(redisClient *c) {
+    int *keys, numkeys, j;
+
+    if (listLength(server.zset_aggr_jobs) == 0) return;
+
+    keys = getKeysFromCommand(c->cmd,c->argv,c->argc,&numkeys);
+    if (numkeys == 0) {
+        zsetAggrFinishJobs(NULL,NULL,0);
     } else {
-        /* safety net */
-        redisPanic("Unknown ZUNION/INTER aggregate type");
+        for (j = 0; j < numkeys; j++)
+            zsetAggrFinishJobs(c->db,c->argv[keys[j]],0);
+    }
+    getKeysFreeResult(keys);
+}
+
+/* Called by unblockClient() when a client blocked by a pending job is
+ * freed: the job is completed anyway, without a reply.
+ *
+ * Ŀͻ˱ͷʱ unblockClient() ã
+ * Ȼɣֻǲٷͻظ */
+void zsetAggrUnblockClient(redisClient *c) {
+    listIter li;
+    listNode *ln;
+
+    listRewind(server.zset_aggr_jobs,&li);
+    while ((ln = listNext(&li)) != NULL) {
+        zsetAggrJob *job = ln->value;
+
+        if (job->client == c) job->client = NULL;
+    }
+}
+
+/* Return true if the job should run in time slices: it must be big enough,
+ * and it must not be part of a script, a transaction, or the replication
+ * stream, which are expected to execute atomically. Inputs with a TTL are
+ * also computed synchronously, since they may expire in the meantime.
+ *
+ * жϼǷӦ÷Ƭ첽ִУԪص㹻࣬
+ * ԽűΪҪԭӵִС
+ * йʱڼڼڣҲʹͬ㡣 */
+static int zsetAggrShouldBlock(redisClient *c, zsetAggrJob *job) {
+    unsigned long long elements = 0;
+    long j;
+
+    if (server.zset_async_aggregate_threshold == 0 || server.loading ||
+        c->flags & (REDIS_LUA_CLIENT|REDIS_MULTI|REDIS_MASTER) ||
+        c->fd == -1) return 0;
+
+    for (j = 0; j < job->setnum; j++) {
+        elements += zuiLength(&job->src[j]);
+        if (job->src[j].subject && getExpire(c->db,c->argv[3+j]) != -1)
+            return 0;
     }
+    return elements >= server.zset_async_aggregate_threshold;
 }
 
 void zunionInterGenericCommand(redisClient *c, robj *dstkey, int op) {
@@ -2674,13 +4103,7 @@ void zunionInterGenericCommand(redisClient *c, robj *dstkey, int op) {
     long setnum;
     int aggregate = REDIS_AGGR_SUM;
     zsetopsrc *src;
-    zsetopval zval;
-    robj *tmp;
-    unsigned int maxelelen = 0;
-    robj *dstobj;
-    zset *dstzset;
-    zskiplistNode *znode;
-    int touched = 0;
+    zsetAggrJob *job;
 
     /* expect setnum input keys to be given */
     // ȡҪ򼯺ϵĸ setnum
@@ -2772,193 +4195,51 @@ void zunionInterGenericCommand(redisClient *c, robj *dstkey, int op) {
         }
     }
 
+    // ״̬
+    job = zcalloc(sizeof(*job));
+    job->client = c;
+    job->db = c->db;
+    job->dstkey = dstkey;
+    job->op = op;
+    job->aggregate = aggregate;
+    job->src = src;
+    job->setnum = setnum;
+
+    // Ԫ㹻ʱͻ˲Ƭ
+    if (zsetAggrShouldBlock(c,job)) {
+        job->cmd = c->cmd;
+        job->argc = c->argc;
+        job->argv = zmalloc(sizeof(robj*)*c->argc);
+        for (j = 0; j < c->argc; j++) {
+            job->argv[j] = c->argv[j];
+            incrRefCount(c->argv[j]);
+        }
+        job->dstkey = job->argv[1];
+        for (i = 0; i < setnum; i++)
+            if (src[i].subject) incrRefCount(src[i].subject);
+    }
+
     /* sort sets from the smallest to largest, this will improve our
      * algorithm's performance */
     // мϽԼ㷨ĳ
     qsort(src,setnum,sizeof(zsetopsrc),zuiCompareByCardinality);
 
     // 
-    dstobj = createZsetObject();
-    dstzset = dstobj->ptr;
-    memset(&zval, 0, sizeof(zval));
-
-    // ZINTERSTORE 
-    if (op == REDIS_OP_INTER) {
-
-        /* Skip everything if the smallest input is empty. */
-        // ֻǿռ
-        if (zuiLength(&src[0]) > 0) {
-
-            /* Precondition: as src[0] is non-empty and the inputs are ordered
-             * by size, all src[i > 0] are non-empty too. */
-            // С src[0] 
-            zuiInitIterator(&src[0]);
-            while (zuiNext(&src[0],&zval)) {
-                double score, value;
-
-                // Ȩֵ
-                score = src[0].weight * zval.score;
-                if (isnan(score)) score = 0;
-
-                //  src[0] еԪغеԪȨۺϼ
-                for (j = 1; j < setnum; j++) {
-                    /* It is not safe to access the zset we are
-                     * iterating, so explicitly check for equal object. */
-                    // ǰ src[j] Ķ src[0] Ķһ
-                    // ô src[0] ֵԪرȻҲ src[j]
-                    // ôǿֱӼۺֵ
-                    // ؽ zuiFind ȥȷԪǷ
-                    // ĳ key Σ
-                    //  key 뼯лСļʱ
-                    if (src[j].subject == src[0].subject) {
-                        value = zval.score*src[j].weight;
-                        zunionInterAggregate(&score,value,aggregate);
-
-                    // ҵǰԪصĻ
-                    // ôоۺϼ
-                    } else if (zuiFind(&src[j],&zval,&value)) {
-                        value *= src[j].weight;
-                        zunionInterAggregate(&score,value,aggregate);
-
-                    // ǰԪûĳϣô for ѭ
-                    // ¸Ԫ
-                    } else {
-                        break;
-                    }
-                }
-
-                /* Only continue when present in every input. */
-                // ֻڽԪسʱִ´
-                if (j == setnum) {
-                    // ȡֵ
-                    tmp = zuiObjectFromValue(&zval);
-                    // 뵽򼯺
-                    znode = zslInsert(dstzset->zsl,score,tmp);
-                    incrRefCount(tmp); /* added to skiplist */
-                    // 뵽ֵ
-                    dictAdd(dstzset->dict,tmp,&znode->score);
-                    incrRefCount(tmp); /* added to dictionary */
-
-                    // ַ󳤶
-                    if (sdsEncodedObject(tmp)) {
-                        if (sdslen(tmp->ptr) > maxelelen)
-                            maxelelen = sdslen(tmp->ptr);
-                    }
-                }
-            }
-            zuiClearIterator(&src[0]);
-        }
-
-    // ZUNIONSTORE
-    } else if (op == REDIS_OP_UNION) {
-
-        // 뼯
-        for (i = 0; i < setnum; i++) {
-
-            // ռ
-            if (zuiLength(&src[i]) == 0)
-                continue;
-
-            // мԪ
-            zuiInitIterator(&src[i]);
-            while (zuiNext(&src[i],&zval)) {
-                double score, value;
-
-                /* Skip an element that when already processed */
-                // ѴԪ
-                if (dictFind(dstzset->dict,zuiObjectFromValue(&zval)) != NULL)
-                    continue;
-
-                /* Initialize score */
-                // ʼֵ
-                score = src[i].weight * zval.score;
-                // ʱΪ 0
-                if (isnan(score)) score = 0;
-
-                /* We need to check only next sets to see if this element
-                 * exists, since we process every element just one time so
-                 * it can't exist in a previous set (otherwise it would be
-                 * already processed). */
-                for (j = (i+1); j < setnum; j++) {
-                    /* It is not safe to access the zset we are
-                     * iterating, so explicitly check for equal object. */
-                    // ǰԪصļϺͱһ
-                    // ͬһԪرȻ src[j]  src[i]
-                    // ֱӼǵľۺֵ
-                    // ʹ zuiFind ԪǷ
-                    if(src[j].subject == src[i].subject) {
-                        value = zval.score*src[j].weight;
-                        zunionInterAggregate(&score,value,aggregate);
-
-                    // ԱǷ
-                    } else if (zuiFind(&src[j],&zval,&value)) {
-                        value *= src[j].weight;
-                        zunionInterAggregate(&score,value,aggregate);
-                    }
-                }
-
-                // ȡԱ
-                tmp = zuiObjectFromValue(&zval);
-                // 벢ԪصԾ
-                znode = zslInsert(dstzset->zsl,score,tmp);
-                incrRefCount(zval.ele); /* added to skiplist */
-                // Ԫصֵ
-                dictAdd(dstzset->dict,tmp,&znode->score);
-                incrRefCount(zval.ele); /* added to dictionary */
-
-                // ַ󳤶
-                if (sdsEncodedObject(tmp)) {
-                    if (sdslen(tmp->ptr) > maxelelen)
-                        maxelelen = sdslen(tmp->ptr);
-                }
-            }
-            zuiClearIterator(&src[i]);
-        }
-    } else {
-        redisPanic("Unknown operator");
-    }
-
-    // ɾѴڵ dstkey ȴ¶
-    if (dbDelete(c->db,dstkey)) {
-        signalModifiedKey(c->db,dstkey);
-        touched = 1;
-        server.dirty++;
-    }
-
-    // ϵĳȲΪ 0 
-    if (dstzset->zsl->length) {
-        /* Convert to ziplist when in limits. */
-        // ǷҪԽϽбת
-        if (dstzset->zsl->length <= server.zset_max_ziplist_entries &&
-            maxelelen <= server.zset_max_ziplist_value)
-                zsetConvert(dstobj,REDIS_ENCODING_ZIPLIST);
-
-        // Ϲݿ
-        dbAdd(c->db,dstkey,dstobj);
-
-        // ظϵĳ
-        addReplyLongLong(c,zsetLength(dstobj));
-
-        if (!touched) signalModifiedKey(c->db,dstkey);
-
-        notifyKeyspaceEvent(REDIS_NOTIFY_ZSET,
-            (op == REDIS_OP_UNION) ? "zunionstore" : "zinterstore",
-            dstkey,c->db->id);
-
-        server.dirty++;
-
-    // Ϊ
-    } else {
-
-        decrRefCount(dstobj);
-
-        addReply(c,shared.czero);
-
-        if (touched)
-            notifyKeyspaceEvent(REDIS_NOTIFY_GENERIC,"del",dstkey,c->db->id);
+    job->dstobj = createZsetObject();
+
+    if (job->argv) {
+        c->bpop.timeout = 0;
+        blockClient(c,REDIS_BLOCKED_ZSET_AGGR);
+        listAddNodeTail(server.zset_aggr_jobs,job);
+        if (server.zset_aggr_timer == -1)
+            server.zset_aggr_timer = aeCreateTimeEvent(server.el,0,
+                zsetAggrCron,NULL,NULL);
+        return;
     }
 
-    zfree(src);
+    zunionInterProcess(job,0);
+    zunionInterStore(job);
+    zsetAggrFreeJob(job);
 }
 
 void zunionstoreCommand(redisClient *c) {
@@ -3014,7 +4295,7 @@ void zrangeGenericCommand(redisClient *c, int reverse) {
     /* Return the result in form of a multi-bulk reply */
     addReplyMultiBulkLen(c, withscores ? (rangelen*2) : rangelen);
 
-    if (zobj->encoding == REDIS_ENCODING_ZIPLIST) {
+    if (zobj->encoding == REDIS_ENCODING_LISTPACK) {
         unsigned char *zl = zobj->ptr;
         unsigned char *eptr, *sptr;
         unsigned char *vstr;
@@ -3023,17 +4304,17 @@ void zrangeGenericCommand(redisClient *c, int reverse) {
 
         // ķ
         if (reverse)
-            eptr = ziplistIndex(zl,-2-(2*start));
+            eptr = lpSeek(zl,-2-(2*start));
         else
-            eptr = ziplistIndex(zl,2*start);
+            eptr = lpSeek(zl,2*start);
 
         redisAssertWithInfo(c,zobj,eptr != NULL);
-        sptr = ziplistNext(zl,eptr);
+        sptr = lpNext(zl,eptr);
 
         // ȡԪ
         while (rangelen--) {
             redisAssertWithInfo(c,zobj,eptr != NULL && sptr != NULL);
-            redisAssertWithInfo(c,zobj,ziplistGet(eptr,&vstr,&vlen,&vlong));
+            redisAssertWithInfo(c,zobj,lpGet(eptr,&vstr,&vlen,&vlong));
             if (vstr == NULL)
                 addReplyBulkLongLong(c,vlong);
             else
@@ -3075,6 +4356,21 @@ void zrangeGenericCommand(redisClient *c, int reverse) {
                 addReplyDouble(c,ln->score);
             ln = reverse ? ln->backward : ln->level[0].forward;
         }
+
+    } else if (zobj->encoding == REDIS_ENCODING_BTREE) {
+        zbtree *t = ((zset*)zobj->ptr)->zbt;
+        zbtreeIter it;
+        int valid;
+
+        // λλʼԪأȻҶӽڵ
+        valid = zbtGetElementByRank(t,reverse ? llen-start : start+1,&it);
+        while(rangelen--) {
+            redisAssertWithInfo(c,zobj,valid);
+            addReplyBulk(c,zbtIterObj(&it));
+            if (withscores)
+                addReplyDouble(c,zbtIterScore(&it));
+            valid = reverse ? zbtPrev(&it) : zbtNext(&it);
+        }
     } else {
         redisPanic("Unknown sorted set encoding");
     }
@@ -3141,7 +4437,7 @@ void genericZrangebyscoreCommand(redisClient *c, int reverse) {
     if ((zobj = lookupKeyReadOrReply(c,key,shared.emptymultibulk)) == NULL ||
         checkType(c,zobj,REDIS_ZSET)) return;
 
-    if (zobj->encoding == REDIS_ENCODING_ZIPLIST) {
+    if (zobj->encoding == REDIS_ENCODING_LISTPACK) {
         unsigned char *zl = zobj->ptr;
         unsigned char *eptr, *sptr;
         unsigned char *vstr;
@@ -3166,7 +4462,7 @@ void genericZrangebyscoreCommand(redisClient *c, int reverse) {
 
         /* Get score pointer for the first element. */
         redisAssertWithInfo(c,zobj,eptr != NULL);
-        sptr = ziplistNext(zl,eptr);
+        sptr = lpNext(zl,eptr);
 
         /* We don't know in advance how many matching elements there are in the
          * list, so we push this object that will represent the multi-bulk
@@ -3198,8 +4494,8 @@ void genericZrangebyscoreCommand(redisClient *c, int reverse) {
                 if (!zslValueLteMax(score,&range)) break;
             }
 
-            /* We know the element exists, so ziplistGet should always succeed */
-            redisAssertWithInfo(c,zobj,ziplistGet(eptr,&vstr,&vlen,&vlong));
+            /* We know the element exists, so lpGet should always succeed */
+            redisAssertWithInfo(c,zobj,lpGet(eptr,&vstr,&vlen,&vlong));
 
             rangelen++;
             if (vstr == NULL) {
@@ -3279,6 +4575,50 @@ void genericZrangebyscoreCommand(redisClient *c, int reverse) {
                 ln = ln->level[0].forward;
             }
         }
+
+    } else if (zobj->encoding == REDIS_ENCODING_BTREE) {
+        zbtree *t = ((zset*)zobj->ptr)->zbt;
+        zbtreeIter it;
+        int valid;
+
+        /* If reversed, get the last element in range as starting point. */
+        if (reverse) {
+            valid = zbtLastInRange(t,&range,&it);
+        } else {
+            valid = zbtFirstInRange(t,&range,&it);
+        }
+
+        /* No "first" element in the specified interval. */
+        if (!valid) {
+            addReply(c, shared.emptymultibulk);
+            return;
+        }
+
+        replylen = addDeferredMultiBulkLength(c);
+
+        /* The offset is skipped with rank lookups, in O(log N). */
+        // ʹλ offset ָԪ
+        valid = zbtSkip(t,&it,offset,reverse);
+
+        while (valid && limit--) {
+            double score = zbtIterScore(&it);
+
+            /* Abort when the element is no longer in range. */
+            if (reverse) {
+                if (!zslValueGteMin(score,&range)) break;
+            } else {
+                if (!zslValueLteMax(score,&range)) break;
+            }
+
+            rangelen++;
+            addReplyBulk(c,zbtIterObj(&it));
+
+            if (withscores) {
+                addReplyDouble(c,score);
+            }
+
+            valid = reverse ? zbtPrev(&it) : zbtNext(&it);
+        }
     } else {
         redisPanic("Unknown sorted set encoding");
     }
@@ -3316,46 +4656,9 @@ void zcountCommand(redisClient *c) {
     if ((zobj = lookupKeyReadOrReply(c, key, shared.czero)) == NULL ||
         checkType(c, zobj, REDIS_ZSET)) return;
 
-    if (zobj->encoding == REDIS_ENCODING_ZIPLIST) {
-        unsigned char *zl = zobj->ptr;
-        unsigned char *eptr, *sptr;
-        double score;
-
-        /* Use the first element in range as the starting point */
-        // ָָΧڵһԪصĳԱ
-        eptr = zzlFirstInRange(zl,&range);
-
-        /* No "first" element */
-        // ûκԪΧڣֱӷ
-        if (eptr == NULL) {
-            addReply(c, shared.czero);
-            return;
-        }
-
-        /* First element is in range */
-        // ȡֵ
-        sptr = ziplistNext(zl,eptr);
-        score = zzlGetScore(sptr);
-        redisAssertWithInfo(c,zobj,zslValueLteMax(score,&range));
-
-        /* Iterate over elements in range */
-        // ΧڵԪ
-        while (eptr) {
-
-            score = zzlGetScore(sptr);
-
-            /* Abort when the node is no longer in range. */
-            // ֵϷΧ
-            if (!zslValueLteMax(score,&range)) {
-                break;
-
-            // ֵϷΧ count 
-            // ȻָһԪ
-            } else {
-                count++;
-                zzlNext(zl,&eptr,&sptr);
-            }
-        }
+    if (zobj->encoding == REDIS_ENCODING_LISTPACK) {
+        // ͨΧ˵λԪ
+        count = zzlCountInRange(zobj->ptr,&range);
 
     } else if (zobj->encoding == REDIS_ENCODING_SKIPLIST) {
         zset *zs = zobj->ptr;
@@ -3391,6 +4694,18 @@ void zcountCommand(redisClient *c) {
             }
         }
 
+    } else if (zobj->encoding == REDIS_ENCODING_BTREE) {
+        zbtree *t = ((zset*)zobj->ptr)->zbt;
+        zbtreeIter first, last;
+
+        // ΧԪصһ͵һԪصλ֮һ
+        if (zbtFirstInRange(t,&range,&first) &&
+            zbtLastInRange(t,&range,&last))
+        {
+            count = zbtGetRank(t,zbtIterScore(&last),zbtIterObj(&last)) -
+                    zbtGetRank(t,zbtIterScore(&first),zbtIterObj(&first)) + 1;
+        }
+
     } else {
         redisPanic("Unknown sorted set encoding");
     }
@@ -3418,34 +4733,8 @@ void zlexcountCommand(redisClient *c) {
         return;
     }
 
-    if (zobj->encoding == REDIS_ENCODING_ZIPLIST) {
-        unsigned char *zl = zobj->ptr;
-        unsigned char *eptr, *sptr;
-
-        /* Use the first element in range as the starting point */
-        eptr = zzlFirstInLexRange(zl,&range);
-
-        /* No "first" element */
-        if (eptr == NULL) {
-            zslFreeLexRange(&range);
-            addReply(c, shared.czero);
-            return;
-        }
-
-        /* First element is in range */
-        sptr = ziplistNext(zl,eptr);
-        redisAssertWithInfo(c,zobj,zzlLexValueLteMax(eptr,&range));
-
-        /* Iterate over elements in range */
-        while (eptr) {
-            /* Abort when the node is no longer in range. */
-            if (!zzlLexValueLteMax(eptr,&range)) {
-                break;
-            } else {
-                count++;
-                zzlNext(zl,&eptr,&sptr);
-            }
-        }
+    if (zobj->encoding == REDIS_ENCODING_LISTPACK) {
+        count = zzlCountInLexRange(zobj->ptr,&range);
     } else if (zobj->encoding == REDIS_ENCODING_SKIPLIST) {
         zset *zs = zobj->ptr;
         zskiplist *zsl = zs->zsl;
@@ -3469,6 +4758,16 @@ void zlexcountCommand(redisClient *c) {
                 count -= (zsl->length - rank);
             }
         }
+    } else if (zobj->encoding == REDIS_ENCODING_BTREE) {
+        zbtree *t = ((zset*)zobj->ptr)->zbt;
+        zbtreeIter first, last;
+
+        if (zbtFirstInLexRange(t,&range,&first) &&
+            zbtLastInLexRange(t,&range,&last))
+        {
+            count = zbtGetRank(t,zbtIterScore(&last),zbtIterObj(&last)) -
+                    zbtGetRank(t,zbtIterScore(&first),zbtIterObj(&first)) + 1;
+        }
     } else {
         redisPanic("Unknown sorted set encoding");
     }
@@ -3528,7 +4827,7 @@ void genericZrangebylexCommand(redisClient *c, int reverse) {
         return;
     }
 
-    if (zobj->encoding == REDIS_ENCODING_ZIPLIST) {
+    if (zobj->encoding == REDIS_ENCODING_LISTPACK) {
         unsigned char *zl = zobj->ptr;
         unsigned char *eptr, *sptr;
         unsigned char *vstr;
@@ -3551,7 +4850,7 @@ void genericZrangebylexCommand(redisClient *c, int reverse) {
 
         /* Get score pointer for the first element. */
         redisAssertWithInfo(c,zobj,eptr != NULL);
-        sptr = ziplistNext(zl,eptr);
+        sptr = lpNext(zl,eptr);
 
         /* We don't know in advance how many matching elements there are in the
          * list, so we push this object that will represent the multi-bulk
@@ -3576,9 +4875,9 @@ void genericZrangebylexCommand(redisClient *c, int reverse) {
                 if (!zzlLexValueLteMax(eptr,&range)) break;
             }
 
-            /* We know the element exists, so ziplistGet should always
+            /* We know the element exists, so lpGet should always
              * succeed. */
-            redisAssertWithInfo(c,zobj,ziplistGet(eptr,&vstr,&vlen,&vlong));
+            redisAssertWithInfo(c,zobj,lpGet(eptr,&vstr,&vlen,&vlong));
 
             rangelen++;
             if (vstr == NULL) {
@@ -3646,6 +4945,40 @@ void genericZrangebylexCommand(redisClient *c, int reverse) {
                 ln = ln->level[0].forward;
             }
         }
+    } else if (zobj->encoding == REDIS_ENCODING_BTREE) {
+        zbtree *t = ((zset*)zobj->ptr)->zbt;
+        zbtreeIter it;
+        int valid;
+
+        /* If reversed, get the last element in range as starting point. */
+        if (reverse) {
+            valid = zbtLastInLexRange(t,&range,&it);
+        } else {
+            valid = zbtFirstInLexRange(t,&range,&it);
+        }
+
+        /* No "first" element in the specified interval. */
+        if (!valid) {
+            addReply(c, shared.emptymultibulk);
+            zslFreeLexRange(&range);
+            return;
+        }
+
+        replylen = addDeferredMultiBulkLength(c);
+        valid = zbtSkip(t,&it,offset,reverse);
+
+        while (valid && limit--) {
+            /* Abort when the element is no longer in range. */
+            if (reverse) {
+                if (!zslLexValueGteMin(zbtIterObj(&it),&range)) break;
+            } else {
+                if (!zslLexValueLteMax(zbtIterObj(&it),&range)) break;
+            }
+
+            rangelen++;
+            addReplyBulk(c,zbtIterObj(&it));
+            valid = reverse ? zbtPrev(&it) : zbtNext(&it);
+        }
     } else {
         redisPanic("Unknown sorted set encoding");
     }
@@ -3682,8 +5015,8 @@ void zscoreCommand(redisClient *c) {
     if ((zobj = lookupKeyReadOrReply(c,key,shared.nullbulk)) == NULL ||
         checkType(c,zobj,REDIS_ZSET)) return;
 
-    // ziplist
-    if (zobj->encoding == REDIS_ENCODING_ZIPLIST) {
+    // listpack
+    if (zobj->encoding == REDIS_ENCODING_LISTPACK) {
         // ȡԪ
         if (zzlFind(zobj->ptr,c->argv[2],&score) != NULL)
             // ظֵ
@@ -3691,8 +5024,9 @@ void zscoreCommand(redisClient *c) {
         else
             addReply(c,shared.nullbulk);
 
-    // SKIPLIST
-    } else if (zobj->encoding == REDIS_ENCODING_SKIPLIST) {
+    // SKIPLIST  BTREE
+    } else if (zobj->encoding == REDIS_ENCODING_SKIPLIST ||
+               zobj->encoding == REDIS_ENCODING_BTREE) {
         zset *zs = zobj->ptr;
         dictEntry *de;
 
@@ -3700,7 +5034,7 @@ void zscoreCommand(redisClient *c) {
         // ֱӴֵȡطֵ
         de = dictFind(zs->dict,c->argv[2]);
         if (de != NULL) {
-            score = *(double*)dictGetVal(de);
+            score = dictGetDoubleVal(de);
             addReplyDouble(c,score);
         } else {
             addReply(c,shared.nullbulk);
@@ -3727,19 +5061,19 @@ void zrankGenericCommand(redisClient *c, int reverse) {
 
     redisAssertWithInfo(c,ele,sdsEncodedObject(ele));
 
-    if (zobj->encoding == REDIS_ENCODING_ZIPLIST) {
+    if (zobj->encoding == REDIS_ENCODING_LISTPACK) {
         unsigned char *zl = zobj->ptr;
         unsigned char *eptr, *sptr;
 
-        eptr = ziplistIndex(zl,0);
+        eptr = lpFirst(zl);
         redisAssertWithInfo(c,zobj,eptr != NULL);
-        sptr = ziplistNext(zl,eptr);
+        sptr = lpNext(zl,eptr);
         redisAssertWithInfo(c,zobj,sptr != NULL);
 
         // 
         rank = 1;
         while(eptr != NULL) {
-            if (ziplistCompare(eptr,ele->ptr,sdslen(ele->ptr)))
+            if (lpCompare(eptr,ele->ptr,sdslen(ele->ptr)))
                 break;
             rank++;
             zzlNext(zl,&eptr,&sptr);
@@ -3755,9 +5089,9 @@ void zrankGenericCommand(redisClient *c, int reverse) {
             addReply(c,shared.nullbulk);
         }
 
-    } else if (zobj->encoding == REDIS_ENCODING_SKIPLIST) {
+    } else if (zobj->encoding == REDIS_ENCODING_SKIPLIST ||
+               zobj->encoding == REDIS_ENCODING_BTREE) {
         zset *zs = zobj->ptr;
-        zskiplist *zsl = zs->zsl;
         dictEntry *de;
         double score;
 
@@ -3767,10 +5101,13 @@ void zrankGenericCommand(redisClient *c, int reverse) {
         if (de != NULL) {
 
             // ȡԪصķֵ
-            score = *(double*)dictGetVal(de);
+            score = dictGetDoubleVal(de);
 
-            // ԾмԪصλ
-            rank = zslGetRank(zsl,score,ele);
+            // Ծ B+ мԪصλ
+            if (zs->zbt)
+                rank = zbtGetRank(zs->zbt,score,ele);
+            else
+                rank = zslGetRank(zs->zsl,score,ele);
             redisAssertWithInfo(c,ele,rank); /* Existing elements always have a rank. */
 
             // ZRANK  ZREVRANK 
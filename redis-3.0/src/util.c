@@ -320,6 +320,7 @@ int string2l(const char *s, size_t slen, long *lval) {
     return 1;
 }
 
+
 /* Convert a double to a string representation. Returns the number of bytes
  * required. The representation should always be parsable by stdtod(3). */
 int d2string(char *buf, size_t len, double value) {
@@ -468,6 +469,13 @@ int pathIsBaseName(char *path) {
 #ifdef UTIL_TEST_MAIN
 #include <assert.h>
 
+/* Build with:
+ *
+ *   cc -O2 -DUTIL_TEST_MAIN util.c sds.c zmalloc.c -lm -o util-test
+ *
+ * 'util-test file.aof' also benchmarks the protocol parsing of the given
+ * file, an AOF being a recorded pipeline of multi bulk requests. */
+
 void test_string2ll(void) {
     char buf[32];
     long long v;
@@ -572,9 +580,150 @@ void test_string2l(void) {
 #endif
 }
 
+/* Check parseProtocolLength() against string2ll() for lengths of every
+ * size, valid or not, and both with short and long buffers. */
+void test_parseProtocolLength(void) {
+    const char *samples[] = {"0","1","9","10","99","100","12345678",
+        "99999999","123456789","999999999999999999","1000000000000000000",
+        "9223372036854775807","9223372036854775808","99999999999999999999",
+        "-1","-0","-","01","00","1a","a1"," 1","1 ","+1","",":","/"};
+    int nsamples = sizeof(samples)/sizeof(samples[0]);
+    char buf[64], digits[32];
+    long long v1, v2;
+    int j, k, pad, ok, len;
+
+    for (j = 0; j < nsamples+100000; j++) {
+        if (j < nsamples) {
+            strcpy(digits,samples[j]);
+        } else {
+            /* Random strings mostly made of digits. */
+            len = rand() % 12;
+            for (k = 0; k < len; k++)
+                digits[k] = (rand() % 20) ? '0'+rand()%10 : rand()%256;
+            digits[len] = '\0';
+            if (strchr(digits,'\r')) continue;
+        }
+        ok = string2ll(digits,strlen(digits),&v1);
+        for (pad = 0; pad < 20; pad++) {
+            len = snprintf(buf,sizeof(buf),"$%s\r\n",digits);
+            memset(buf+len,'x',pad);
+            if (parseProtocolLength(buf,len+pad,&v2) == -1) {
+                assert(!ok);
+            } else {
+                assert(ok && v1 == v2);
+            }
+            /* Incomplete lines. */
+            assert(parseProtocolLength(buf,len-1,&v2) == 0);
+        }
+    }
+    assert(parseProtocolLength("*3\r\n$3\r\nSET\r\n",14,&v1) == 4 && v1 == 3);
+    assert(parseProtocolLength("*3\r",3,&v1) == 0);
+    assert(parseProtocolLength("*",1,&v1) == 0);
+}
+
+static long long usec(void) {
+    struct timeval tv;
+    gettimeofday(&tv,NULL);
+    return (((long long)tv.tv_sec)*1000000)+tv.tv_usec;
+}
+
+/* Walk all the requests of the multi bulk stream in 'buf' like
+ * processMultibulkBuffer() does, returning the number of arguments, or -1
+ * on protocol errors. With 'fast' set the headers are parsed by
+ * parseProtocolLength(), otherwise by strchr() and string2ll() as it was
+ * done before. */
+static long long parseStream(char *buf, size_t len, int fast) {
+    long long args = 0, count, bulklen;
+    size_t pos = 0;
+    char *newline;
+    int n;
+
+    while (pos < len) {
+        if (fast) {
+            if ((n = parseProtocolLength(buf+pos,len-pos,&count)) <= 0)
+                return -1;
+        } else {
+            if ((newline = strchr(buf+pos,'\r')) == NULL ||
+                !string2ll(buf+pos+1,newline-(buf+pos+1),&count)) return -1;
+            n = newline-(buf+pos)+2;
+        }
+        pos += n;
+        while (count--) {
+            if (fast) {
+                if ((n = parseProtocolLength(buf+pos,len-pos,&bulklen)) <= 0)
+                    return -1;
+            } else {
+                if ((newline = strchr(buf+pos,'\r')) == NULL ||
+                    !string2ll(buf+pos+1,newline-(buf+pos+1),&bulklen))
+                    return -1;
+                n = newline-(buf+pos)+2;
+            }
+            pos += n+bulklen+2;
+            args++;
+        }
+    }
+    return args;
+}
+
+/* Benchmark the parsing of a recorded pipeline (an AOF file), or of a
+ * pipeline of typical small requests when no file is given. */
+void bench_parseProtocolLength(char *filename) {
+    sds stream = sdsempty();
+    long long args, start, elapsed[2];
+    int j, fast, rounds;
+
+    if (filename) {
+        FILE *fp = fopen(filename,"r");
+        char chunk[4096];
+        size_t nread;
+
+        if (fp == NULL) {
+            perror("fopen");
+            exit(1);
+        }
+        while ((nread = fread(chunk,1,sizeof(chunk),fp)) > 0)
+            stream = sdscatlen(stream,chunk,nread);
+        fclose(fp);
+    } else {
+        for (j = 0; j < 100000; j++) {
+            char key[32];
+            int klen = snprintf(key,sizeof(key),"key:%012d",rand()%100000);
+
+            if (j % 2)
+                stream = sdscatprintf(stream,"*2\r\n$3\r\nGET\r\n$%d\r\n%s\r\n",
+                                      klen,key);
+            else
+                stream = sdscatprintf(stream,
+                    "*3\r\n$3\r\nSET\r\n$%d\r\n%s\r\n$3\r\nxxx\r\n",klen,key);
+        }
+    }
+
+    rounds = 100000000/(sdslen(stream)+1)+1;
+    for (fast = 0; fast <= 1; fast++) {
+        start = usec();
+        for (j = 0; j < rounds; j++) {
+            args = parseStream(stream,sdslen(stream),fast);
+            assert(args > 0);
+        }
+        elapsed[fast] = usec()-start;
+    }
+    printf("  %s: %zu bytes, %lld arguments\n",
+        filename ? filename : "GET/SET pipeline",sdslen(stream),args);
+    for (fast = 0; fast <= 1; fast++) {
+        printf("  %-22s %6.2f ns/argument, %7.1f MB/s\n",
+            fast ? "parseProtocolLength():" : "strchr()+string2ll():",
+            (double)elapsed[fast]*1000/(args*rounds),
+            (double)sdslen(stream)*rounds/elapsed[fast]);
+    }
+    sdsfree(stream);
+}
+
 int main(int argc, char **argv) {
     test_string2ll();
     test_string2l();
+    test_parseProtocolLength();
+    printf("Protocol parsing benchmark:\n");
+    bench_parseProtocolLength(argc > 1 ? argv[1] : NULL);
     return 0;
 }
 #endif
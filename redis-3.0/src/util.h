@@ -30,6 +30,11 @@
 #ifndef __REDIS_UTIL_H
 #define __REDIS_UTIL_H
 
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "sds.h"
 
 int stringmatchlen(const char *p, int plen, const char *s, int slen, int nocase);
@@ -42,4 +47,56 @@ int d2string(char *buf, size_t len, double value);
 sds getAbsolutePath(char *filename);
 int pathIsBaseName(char *path);
 
+/* Parse the header line of a multi bulk or bulk request, that is the type
+ * byte at 's' ('*' or '$') followed by the length and "\r\n", with 'len'
+ * bytes available at 's'.
+ *
+ * Returns the size of the header including the trailing "\r\n" and sets
+ * *value to the length, 0 if the line is not complete yet, or -1 if the
+ * length is not a number accepted by string2ll().
+ *
+ * Headers are almost always shorter than 16 bytes, so the '\r' is found by
+ * a single SSE2 compare, and plain lengths are converted by a loop that
+ * can't overflow. Anything unusual (a sign, leading zeroes, more than 18
+ * digits) goes through string2ll(). Being inline, the function costs no
+ * call in the hot loop of processMultibulkBuffer().
+ *
+ * 解析协议中的 *<count>\r\n 或者 $<len>\r\n 头部，
+ * 返回头部（包括 \r\n ）的长度，头部不完整时返回 0 ，长度不合法时返回 -1 */
+static inline int parseProtocolLength(const char *s, size_t len, long long *value) {
+    const char *p = s+1, *end = s+len, *cr;
+    unsigned long long v = 0;
+    size_t digits, j;
+
+    if (len < 2) return 0;
+#if defined(__SSE2__)
+    /* The 16 bytes after the type byte are readable. */
+    if (len >= 17) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)p);
+        int bits = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk,_mm_set1_epi8('\r')));
+
+        cr = bits ? p+__builtin_ctz(bits) : memchr(p+16,'\r',end-(p+16));
+    } else
+#endif
+    cr = memchr(p,'\r',end-p);
+
+    /* The "\n" must be there as well. */
+    if (cr == NULL || cr+1 >= end) return 0;
+
+    digits = cr-p;
+    if (digits >= 1 && digits <= 18 && (p[0] != '0' || digits == 1)) {
+        for (j = 0; j < digits; j++) {
+            unsigned int d = (unsigned char)p[j]-'0';
+
+            if (d > 9) break;
+            v = v*10+d;
+        }
+        if (j == digits) {
+            *value = (long long)v;
+            return (int)(digits+3);
+        }
+    }
+    return string2ll(p,digits,value) ? (int)(digits+3) : -1;
+}
+
 #endif
@@ -74,6 +74,7 @@ __sync_fetch_and_addϵ
 #ifdef HAVE_ATOMIC
 #define update_zmalloc_stat_add(__n) __sync_add_and_fetch(&used_memory, (__n))
 #define update_zmalloc_stat_sub(__n) __sync_sub_and_fetch(&used_memory, (__n))
+#define update_zmalloc_stat_calls() __sync_add_and_fetch(&alloc_calls, 1)
 #else
 #define update_zmalloc_stat_add(__n) do { \
     pthread_mutex_lock(&used_memory_mutex); \
@@ -87,6 +88,12 @@ __sync_fetch_and_addϵ
     pthread_mutex_unlock(&used_memory_mutex); \
 } while(0)
 
+#define update_zmalloc_stat_calls() do { \
+    pthread_mutex_lock(&used_memory_mutex); \
+    alloc_calls++; \
+    pthread_mutex_unlock(&used_memory_mutex); \
+} while(0)
+
 #endif
 
 #define update_zmalloc_stat_alloc(__n) do { \
@@ -99,6 +106,16 @@ __sync_fetch_and_addϵ
     } \
 } while(0)
 
+/* Count a call to the allocator (malloc, calloc or realloc). */
+// ¼һڴ
+#define update_zmalloc_stat_count() do { \
+    if (zmalloc_thread_safe) { \
+        update_zmalloc_stat_calls(); \
+    } else { \
+        alloc_calls++; \
+    } \
+} while(0)
+
 #define update_zmalloc_stat_free(__n) do { \
     size_t _n = (__n); \
     if (_n&(sizeof(long)-1)) _n += sizeof(long)-(_n&(sizeof(long)-1)); \
@@ -110,6 +127,8 @@ __sync_fetch_and_addϵ
 } while(0)
 
 static size_t used_memory = 0; //zmalloc->update_zmalloc_stat_allocÿοڴռʱ򶼻ӶӦĿٿռ
+//  malloc  calloc  realloc ܴ
+static size_t alloc_calls = 0;
 static int zmalloc_thread_safe = 0; //Ĭzmalloc_enable_thread_safeness1
 pthread_mutex_t used_memory_mutex = PTHREAD_MUTEX_INITIALIZER;
 
@@ -126,6 +145,7 @@ void *zmalloc(size_t size) {
     void *ptr = malloc(size+PREFIX_SIZE);
 
     if (!ptr) zmalloc_oom_handler(size);
+    update_zmalloc_stat_count();
 #ifdef HAVE_MALLOC_SIZE
     update_zmalloc_stat_alloc(zmalloc_size(ptr));
     return ptr;
@@ -140,6 +160,7 @@ void *zcalloc(size_t size) {
     void *ptr = calloc(1, size+PREFIX_SIZE);
 
     if (!ptr) zmalloc_oom_handler(size);
+    update_zmalloc_stat_count();
 #ifdef HAVE_MALLOC_SIZE
     update_zmalloc_stat_alloc(zmalloc_size(ptr));
     return ptr;
@@ -162,6 +183,7 @@ void *zrealloc(void *ptr, size_t size) {
     oldsize = zmalloc_size(ptr);
     newptr = realloc(ptr,size);
     if (!newptr) zmalloc_oom_handler(size);
+    update_zmalloc_stat_count();
 
     update_zmalloc_stat_free(oldsize);
     update_zmalloc_stat_alloc(zmalloc_size(newptr));
@@ -171,6 +193,7 @@ void *zrealloc(void *ptr, size_t size) {
     oldsize = *((size_t*)realptr);
     newptr = realloc(realptr,size+PREFIX_SIZE);
     if (!newptr) zmalloc_oom_handler(size);
+    update_zmalloc_stat_count();
 
     *((size_t*)newptr) = size;
     update_zmalloc_stat_free(oldsize);
@@ -238,6 +261,26 @@ size_t zmalloc_used_memory(void) {
     return um;
 }
 
+/* Return the number of calls to the allocator (malloc, calloc or realloc)
+ * done since the process started. */
+// ؽ malloc  calloc  realloc ܴ
+size_t zmalloc_alloc_calls(void) {
+    size_t calls;
+
+    if (zmalloc_thread_safe) {
+#ifdef HAVE_ATOMIC
+        calls = __sync_add_and_fetch(&alloc_calls, 0);
+#else
+        pthread_mutex_lock(&used_memory_mutex);
+        calls = alloc_calls;
+        pthread_mutex_unlock(&used_memory_mutex);
+#endif
+    } else {
+        calls = alloc_calls;
+    }
+    return calls;
+}
+
 void zmalloc_enable_thread_safeness(void) {
     zmalloc_thread_safe = 1;
 }
@@ -140,4 +140,71 @@ tags {"aof"} {
             r expire x -1
         }
     }
+
+    start_server {overrides {appendonly {yes} appendfilename {appendonly.aof}
+                             appendfsync {always} aof-group-commit {yes}}} {
+        test {AOF group commit: replies of concurrent clients after the fsync} {
+            set clients {}
+            for {set j 0} {$j < 5} {incr j} {
+                set rd [redis_deferring_client]
+                for {set i 0} {$i < 100} {incr i} {
+                    $rd incr counter
+                    $rd rpush list:$j $i
+                }
+                lappend clients $rd
+            }
+            foreach rd $clients {
+                for {set i 0} {$i < 100} {incr i} {
+                    $rd read
+                    assert_equal [expr {$i+1}] [$rd read]
+                }
+                $rd close
+            }
+            assert_equal 500 [r get counter]
+            assert {[status r aof_group_fsyncs] > 0}
+            assert_equal 0 [status r aof_fsync_waiting_clients]
+            assert_equal {yes} [lindex [r config get aof-group-commit] 1]
+        }
+
+        test {AOF group commit: the AOF has all the acknowledged writes} {
+            set digest [r debug digest]
+            r debug loadaof
+            assert_equal $digest [r debug digest]
+            assert_equal 500 [r get counter]
+        }
+
+        test {AOF group commit: replies are released across an AOF rewrite} {
+            set rd [redis_deferring_client]
+            r bgrewriteaof
+            for {set i 0} {$i < 1000} {incr i} {
+                $rd set key:$i $i
+            }
+            for {set i 0} {$i < 1000} {incr i} {
+                assert_equal {OK} [$rd read]
+            }
+            waitForBgrewriteaof r
+            $rd incr counter
+            assert_equal 501 [$rd read]
+            $rd close
+            set digest [r debug digest]
+            r debug loadaof
+            assert_equal $digest [r debug digest]
+        }
+
+        test {AOF group commit: switching the fsync policy releases replies} {
+            set rd [redis_deferring_client]
+            r config set appendfsync everysec
+            $rd incr counter
+            assert_equal 502 [$rd read]
+            r config set appendfsync always
+            r config set aof-group-commit no
+            $rd incr counter
+            assert_equal 503 [$rd read]
+            r config set aof-group-commit yes
+            $rd incr counter
+            assert_equal 504 [$rd read]
+            $rd close
+            assert_equal 0 [status r aof_fsync_waiting_clients]
+        }
+    }
 }
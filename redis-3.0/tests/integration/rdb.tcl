@@ -3,8 +3,9 @@ set server_path [tmpdir "server.rdb-encoding-test"]
 # Copy RDB with different encodings in server path
 exec cp tests/assets/encodings.rdb $server_path
 
-start_server [list overrides [list "dir" $server_path "dbfilename" "encodings.rdb"]] {
-  test "RDB encoding loading test" {
+foreach threads {0 4} {
+start_server [list overrides [list "dir" $server_path "dbfilename" "encodings.rdb" "rdb-load-threads" $threads]] {
+  test "RDB encoding loading test (rdb-load-threads $threads)" {
     r select 0
     csvdump r
   } {"compressible","string","aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"
@@ -22,6 +23,60 @@ start_server [list overrides [list "dir" $server_path "dbfilename" "encodings.rd
 "zset_zipped","zset","a","1","b","2","c","3",
 }
 }
+}
+
+start_server {tags {"rdb"} overrides {"rdb-load-threads" 4}} {
+    test {Threaded RDB loading preserves every data type} {
+        r select 9
+        createComplexDataset r 10000
+        # Values big enough to span many batches, with every encoding.
+        r config set list-max-ziplist-entries 128
+        for {set j 0} {$j < 2000} {incr j} {
+            r sadd bigset $j [randstring 0 20 alpha]
+            r rpush biglist [randstring 0 100 alpha]
+            r hset bighash $j [randstring 0 100 binary]
+            r zadd bigzset $j [randstring 0 20 alpha]
+        }
+        r set bigstring [string repeat x 5000000]
+        r select 3
+        for {set j 0} {$j < 1000} {incr j} {
+            r set key:$j $j
+            r expire key:$j 1000
+        }
+        set digest [r debug digest]
+        r debug reload
+        assert_equal $digest [r debug digest]
+        assert_equal 1000 [r dbsize]
+        assert {[r ttl key:500] > 900}
+        r config set rdb-load-threads 1
+        r debug reload
+        assert_equal $digest [r debug digest]
+        r config set rdb-load-threads 0
+        r debug reload
+        r config set rdb-load-threads 4
+        r select 9
+        assert_equal $digest [r debug digest]
+    }
+}
+
+set server_path [tmpdir "server.rdb-expire-test"]
+
+start_server [list overrides [list "dir" $server_path]] {
+    for {set j 0} {$j < 100} {incr j} {
+        r set key:$j $j
+        r pexpire key:$j [expr {$j < 50 ? 500 : 100000}]
+    }
+    r save
+}
+
+# Half of the keys expire while the server is down.
+after 1000
+
+start_server [list overrides [list "dir" $server_path "rdb-load-threads" 4]] {
+    test {Keys already expired are not loaded (threaded load)} {
+        r dbsize
+    } {50}
+}
 
 set server_path [tmpdir "server.rdb-startup-test"]
 
@@ -96,3 +151,124 @@ start_server_and_kill_it [list "dir" $server_path] {
         }
     }
 }
+
+start_server_and_kill_it [list "dir" $server_path "rdb-load-threads" 2] {
+    test {Server should not start if RDB is corrupted (threaded load)} {
+        wait_for_condition 50 100 {
+            [string match {*RDB checksum*} \
+                [exec tail -n1 < [dict get $srv stdout]]]
+        } else {
+            fail "Server started even if RDB was corrupted!"
+        }
+    }
+}
+
+set server_path [tmpdir "server.rdb-truncated-test"]
+
+start_server [list overrides [list "dir" $server_path]] {
+    r debug populate 10000
+    r save
+}
+
+# Truncate the file in the middle of a key.
+set filesize [file size [file join $server_path dump.rdb]]
+set fd [open [file join $server_path dump.rdb] r+]
+chan truncate $fd [expr {$filesize/2}]
+close $fd
+
+start_server_and_kill_it [list "dir" $server_path "rdb-load-threads" 2] {
+    test {Server should not start if RDB is truncated (threaded load)} {
+        wait_for_condition 50 100 {
+            [string match {*Short read*} \
+                [exec tail -n1 < [dict get $srv stdout]]]
+        } else {
+            fail "Server started even if RDB was truncated!"
+        }
+    }
+}
+
+set server_path [tmpdir "server.rdb-sections-test"]
+
+start_server [list overrides [list "dir" $server_path "rdb-save-threads" 4]] {
+    test {RDB saved in sections preserves every data type} {
+        r select 9
+        createComplexDataset r 10000
+        r select 3
+        for {set j 0} {$j < 1000} {incr j} {
+            r set key:$j $j
+            r expire key:$j 1000
+        }
+        # A single key in a database: some sections don't have it.
+        r select 5
+        r set lonely value
+        r select 9
+        set digest [r debug digest]
+        r debug reload
+        assert_equal $digest [r debug digest]
+        r config set rdb-load-threads 4
+        r debug reload
+        assert_equal $digest [r debug digest]
+        r select 3
+        assert_equal 1000 [r dbsize]
+        assert {[r ttl key:500] > 900}
+        r select 5
+        r get lonely
+    } {value}
+
+    test {redis-check-dump verifies an RDB saved in sections} {
+        r bgsave
+        waitForBgsave r
+        set out [exec src/redis-check-dump [file join $server_path dump.rdb]]
+        assert_match {*CRC64 of 4 sections is OK*} $out
+        assert_match {*CRC64 checksum is OK*} $out
+    }
+
+    # A big uncompressed value to corrupt in the next test.
+    r config set rdbcompression no
+    r set bigstring [string repeat x 100000]
+    r save
+}
+
+# Corrupt a byte in the middle of the big value.
+set fd [open [file join $server_path dump.rdb] r+]
+fconfigure $fd -translation binary
+set offset [string first [string repeat x 1000] [read $fd]]
+seek $fd [expr {$offset+50000}]
+puts -nonewline $fd "y"
+close $fd
+
+start_server_and_kill_it [list "dir" $server_path "rdb-load-threads" 2] {
+    test {Server should not start if a section is corrupted (threaded load)} {
+        wait_for_condition 50 100 {
+            [string match {*RDB checksum*} \
+                [exec tail -n1 < [dict get $srv stdout]]]
+        } else {
+            fail "Server started even if RDB was corrupted!"
+        }
+    }
+}
+
+foreach codec {no yes lz4} {
+    set server_path [tmpdir "server.rdb-compression-test"]
+
+    start_server [list overrides [list "dir" $server_path "rdbcompression" $codec]] {
+        test "RDB strings saved with rdbcompression $codec are loaded back" {
+            r select 9
+            createComplexDataset r 5000
+            for {set j 0} {$j < 1000} {incr j} {
+                r set json:$j "{\"id\":$j,\"name\":\"user$j\",\"tags\":\[\"a\",\"b\"\],\"bio\":\"[string repeat {lorem ipsum } [expr {$j%20}]]\"}"
+            }
+            r set big [string repeat "abcdefgh" 100000]
+            set digest [r debug digest]
+            r debug reload
+            assert_equal $digest [r debug digest]
+            r config set rdb-load-threads 2
+            r debug reload
+            assert_equal $digest [r debug digest]
+            assert_equal $codec [lindex [r config get rdbcompression] 1]
+            set out [exec src/redis-check-dump [file join $server_path dump.rdb]]
+            assert_match {*CRC64 checksum is OK*} $out
+            assert {![string match {*Error*} $out]}
+        }
+    }
+}
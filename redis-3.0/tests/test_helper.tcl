@@ -16,6 +16,7 @@ set ::all_tests {
     unit/dump
     unit/auth
     unit/protocol
+    unit/threaded-io
     unit/basic
     unit/scan
     unit/type/list